@@ -0,0 +1,52 @@
+// Copyright 2003-2026 Omni Development, Inc. All rights reserved.
+//
+// This software may only be used and reproduced according to the
+// terms in the file OmniSourceLicense.html, which should be
+// distributed with this project and can also be found at
+// <http://www.omnigroup.com/developer/sourcecode/sourcelicense/>.
+
+#import <OmniFoundation/OFObject.h>
+
+@class /* Foundation */ NSCountedSet, NSLock, NSMutableArray, NSMutableSet;
+@class /* OmniFoundation */ OFDelayedEvent;
+@class /* OmniSQLite */ OSLDatabaseController;
+@class /* OWF */ OWStaticArc;
+
+#import <OWF/OWContentCacheProtocols.h> // For OWCacheArcProvider and OWCacheContentProvider
+#import <os/lock.h>
+
+/*
+ A persistent cache of content and arcs, kept in an SQLite database inside a cache bundle.
+
+ Writes are buffered: -addArc: and -storeContent: return as soon as the arc or content is in an in-memory write buffer, and the buffer is written out in a single transaction shortly afterwards (or straight away once enough is waiting). Until then, lookups find buffered arcs in the buffer. A non-nil return only means the cache has accepted the item, not that it is on disk. If writing the buffer fails, its contents are logged and dropped; since this is a cache, all that is lost is a later hit. Callers which need to know can call -flushWriteBuffer themselves.
+ */
+@interface OWDiskCache : OFObject <OWCacheArcProvider, OWCacheContentProvider>
+{
+    OSLDatabaseController *databaseController;
+    NSLock *dbLock;
+    NSString *bundlePath;
+
+    // Handles our content has given out, so we know what is still in use.
+    os_unfair_lock retainedHandlesLock;
+    NSCountedSet *retainedHandles;
+
+    // A few recently used pieces of content, most recent last, so that repeated lookups of the same content don't have to go to the database.
+    NSMutableArray *recentlyUsedContent;
+
+    // Deferred cleanup, done by the preen event.
+    NSMutableSet *arcsToRemove;
+    NSMutableSet *contentToGC;
+    OFDelayedEvent *preenEvent;
+}
+
++ (OWDiskCache *)createCacheAtPath:(NSString *)newBundlePath;
++ (OWDiskCache *)openCacheAtPath:(NSString *)oldBundlePath;
+
+- (void)close; // Writes out the write buffer and closes the database. The cache can't be used afterwards.
+
+// Writes out the write buffer now, along with the access times of recently read content. Returns NO if the write failed, in which case the buffered arcs and content have been dropped.
+- (BOOL)flushWriteBuffer;
+
+- (void)removeEntriesDominatedByArc:(OWStaticArc *)newArc;
+
+@end
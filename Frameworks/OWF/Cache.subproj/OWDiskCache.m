@@ -1,4 +1,4 @@
-// Copyright 2003-2019 Omni Development, Inc. All rights reserved.
+// Copyright 2003-2026 Omni Development, Inc. All rights reserved.
 //
 // This software may only be used and reproduced according to the
 // terms in the file OmniSourceLicense.html, which should be
@@ -16,12 +16,15 @@
 #import <OWF/OWContentInfo.h>
 #import <OWF/OWURL.h>
 #import <OWF/OWDataStream.h>
+#import <OWF/OWDataStreamCursor.h>
 #import <OWF/OWPipeline.h>
 #import <OWF/OWStaticArc.h>
 
-
 #import "OWDiskCacheInternal.h"
 
+#include <fcntl.h>
+#include <unistd.h>
+
 RCS_ID("$Id$");
 
 // OWDiskCache maintains a small LRU cache of retrieved objects
@@ -29,22 +32,23 @@ RCS_ID("$Id$");
 #define LRUContentHighWater  24
 #define LRUContentLowWater    5
 
-// OX wants a hint as to how many pages of the database to keep in-core at a given time. Greg says 100 is a reasonable number (and that at some point in the future OX should be able to figure this out for itself).
-#define OmniIndexPagesInCache (100)
-
-// Maximum number of bytes long a Content's value can be before it's stored in a blob. 
-#define MAXIMUM_INTUPLE_DATA_SIZE (100)
+// Arcs and content are buffered in memory and written in one transaction, either shortly after the first one arrives or as soon as this many are waiting.
+#define WriteBufferFlushDelay (1.0)
+#define WriteBufferHighWater (256)
 
-#define TOTAL_CONTENT_SIZE_FILE_INFO_INDEX (20)
+// When the cache goes over its limit, evict down to this fraction of it so that we aren't evicting again on the very next flush.
+#define EvictionLowWaterFraction (0.9)
 
-@interface OWDiskCache (Private) <OFWeakRetain>
+// Pages given back to the filesystem per compaction step. The lock is dropped between steps, so lookups never wait on a whole vacuum.
+#define CompactionPagesPerStep (64)
+#define CompactionStepDelay (0.1)
 
-// BOOL OWDiskCacheDeferLoadingContent = YES;
+@interface OWDiskCache (Private)
 
 + (BOOL)_initializeDatabase:(OSLDatabaseController *)newDB;
 + (NSString *)_indexFilenameForBundlePath:(NSString *)aBundlePath;
 - (NSString *)_indexFilename;
-- (id)_initWithDatabaseController:(OSLDatabaseController *)aDatabaseController bundle:(NSString *)aBundlePath;
+- (id)_initWithDatabaseController:(OSLDatabaseController *)aDatabaseController bundle:(NSString *)aBundlePath lockFileDescriptor:(int)aLockFileDescriptor;
 - (NSNumber *)_keyForContent:(OWContent *)someContent insert:(BOOL)shouldInsert;
 - (OWContent *)_contentForKey:(NSNumber *)contentID;
 - (id <OWConcreteCacheEntry>)_r_concreteContentFromRow:(NSDictionary *)row;
@@ -55,19 +59,58 @@ RCS_ID("$Id$");
 - (void)controllerWillTerminate:(OFController *)controller;
 - (void)_flushCache:(NSNotification *)note;
 - (int)_deleteContentRow:(NSDictionary *)contentRow andReferences:(BOOL)mayHaveReferences;
-- (int)_deleteOldestContent;
+- (unsigned long long int)_deleteOldestContentFreeingBytes:(unsigned long long int)bytesToFree;
 - (void)_deletePendingArcs;
 - (void)_deleteArcID:(NSNumber *)anArcId;
+- (void)_deleteUnreferencedContent;
+- (unsigned long long int)_totalContentSize;
 - (void)_reduceCacheSize;
 - (void)_lockedCancelPreenEvent;
 - (void)_preenCache;
+- (NSArray *)_bufferedArcsWithRelation:(OWCacheArcRelationship)relation toEntry:(OWContent *)anEntry;
+- (void)_writeAccessTimes;
+- (void)_discardWriteBuffer;
+- (void)_compactStep;
 
 static enum OWDiskCacheConcreteContentType concreteTypeOfContent(OWContent *content);
 
 @end
 
+@interface OWDiskCache ()
+{
+    // Held for as long as the cache is open, so that no other process opens it too.
+    int lockFileDescriptor;
+
+    // Guards the write buffer, so that adding to it never waits on the database. Take dbLock first if you need both.
+    NSLock *bufferLock;
+    NSMutableArray *pendingArcs;
+    NSMutableArray *pendingArcInfo; // -serialize of each of pendingArcs
+    NSMutableArray *pendingContent;
+    OFDelayedEvent *flushEvent;
+
+    // Content read since the last flush, whose access times get brought up to date at the next one so that eviction goes in least-recently-used order.
+    NSMutableSet *touchedContentIDs;
+
+    unsigned long long int totalContentSize;
+    BOOL totalContentSizeIsValid;
+
+    OFDelayedEvent *compactEvent;
+    enum { CompactionUnknown, CompactionUnavailable, CompactionAvailable } compactionState;
+}
+@end
+
 static NSString *CorruptDatabaseException = @"CorruptDatabaseException";
 
+// The lock goes away with the file descriptor, so a cache left behind by a process which crashed can be opened again.
+static int _lockIndexFile(NSString *indexFile)
+{
+    NSString *lockFile = [indexFile stringByAppendingPathExtension:@"lock"];
+    int fd = open([lockFile fileSystemRepresentation], O_RDONLY|O_CREAT|O_EXLOCK|O_NONBLOCK|O_CLOEXEC, 0600);
+    if (fd < 0 && errno != EWOULDBLOCK)
+        NSLog(@"OWDiskCache: Unable to lock %@: %s", lockFile, strerror(errno));
+    return fd;
+}
+
 @implementation OWDiskCache
 
 + (OWDiskCache *)createCacheAtPath:(NSString *)newBundlePath;
@@ -84,7 +127,7 @@ static NSString *CorruptDatabaseException = @"CorruptDatabaseException";
     NSDictionary *privAttrs = [NSDictionary dictionaryWithObjectsAndKeys:
         [NSNumber numberWithInt: 0700], NSFilePosixPermissions,
         nil];
-    
+
     NSString *contents = [newBundlePath stringByAppendingPathComponent:@"Contents"];
     NSString *dataDir = [contents stringByAppendingPathComponent:@"Data"];
     NSString *indexFile = [self _indexFilenameForBundlePath:newBundlePath];
@@ -98,52 +141,47 @@ static NSString *CorruptDatabaseException = @"CorruptDatabaseException";
     [infoPlist setObject:@"OmniWeb Cache File" forKey:@"CFBundleName"];
     [infoPlist setIntValue:OWDiskCache_DBVersion forKey:OWDiskCache_DBVersion_Key];
 
-    NSData *infoPlistXml = (NSData *)CFPropertyListCreateXMLData(kCFAllocatorDefault, infoPlist);
-    [infoPlist release];
-    [infoPlistXml autorelease];
+    NSData *infoPlistXml = [NSPropertyListSerialization dataWithPropertyList:infoPlist format:NSPropertyListXMLFormat_v1_0 options:0 error:NULL];
+    if (!infoPlistXml)
+        return nil;
 
     NSMutableData *pkgInfo = [[NSMutableData alloc] initWithCapacity:8];
-    [pkgInfo autorelease];
     [pkgInfo appendBytes:"BNDL" length:4];
     [pkgInfo appendBytes:"OWEB" length:4];
-    
+
     NSFileManager *fileManager = [NSFileManager defaultManager];
-    if ([fileManager fileExistsAtPath:newBundlePath])
-        [fileManager removeFileAtPath:newBundlePath handler:nil];
+    if ([fileManager fileExistsAtPath:newBundlePath] && ![fileManager removeItemAtPath:newBundlePath error:NULL])
+        return nil;
 
-    BOOL ok = [fileManager createDirectoryAtPath:newBundlePath attributes:dirAttrs];
-    if (!ok)
+    if (![fileManager createDirectoryAtPath:newBundlePath withIntermediateDirectories:NO attributes:dirAttrs error:NULL])
         return nil;
 
-    ok = [fileManager createDirectoryAtPath:contents attributes:dirAttrs];
-    if (!ok)
+    if (![fileManager createDirectoryAtPath:contents withIntermediateDirectories:NO attributes:dirAttrs error:NULL])
         return nil;
 
-    ok = [fileManager createFileAtPath:[contents stringByAppendingPathComponent:@"Info.plist"] contents:infoPlistXml attributes:pubAttrs];
-    if (!ok)
+    if (![fileManager createFileAtPath:[contents stringByAppendingPathComponent:@"Info.plist"] contents:infoPlistXml attributes:pubAttrs])
         return nil;
-    ok = [fileManager createFileAtPath:[contents stringByAppendingPathComponent:@"PkgInfo"] contents:pkgInfo attributes:pubAttrs];
-    if (!ok)
+    if (![fileManager createFileAtPath:[contents stringByAppendingPathComponent:@"PkgInfo"] contents:pkgInfo attributes:pubAttrs])
         return nil;
-    
-    ok = [fileManager createDirectoryAtPath:dataDir attributes:privAttrs];
-    if (!ok)
+
+    if (![fileManager createDirectoryAtPath:dataDir withIntermediateDirectories:NO attributes:privAttrs error:NULL])
         return nil;
 
-    NSDictionary *lockinfo = [fileManager lockFileAtPath:indexFile overridingExistingLock:NO];
-    if (lockinfo != nil)
+    int lockFileDescriptor = _lockIndexFile(indexFile);
+    if (lockFileDescriptor < 0)
         return nil;
 
-    OSLDatabaseController *newDB = [[OSLDatabaseController alloc] initWithDatabasePath:indexFile];
+    __autoreleasing NSError *error;
+    OSLDatabaseController *newDB = [[OSLDatabaseController alloc] initWithDatabasePath:indexFile error:&error];
     if (newDB == nil || ![self _initializeDatabase:newDB]) {
+        if (newDB == nil)
+            [error log:@"Unable to create disk cache %@", newBundlePath];
         [newDB deleteDatabase];
-        [fileManager unlockFileAtPath:indexFile];
+        close(lockFileDescriptor);
         return nil;
     }
 
-    OWDiskCache *result = [[self alloc] _initWithDatabaseController:newDB bundle:newBundlePath];
-    [newDB release];
-    return [result autorelease];
+    return [[self alloc] _initWithDatabaseController:newDB bundle:newBundlePath lockFileDescriptor:lockFileDescriptor];
 }
 
 + (OWDiskCache *)openCacheAtPath:(NSString *)oldBundlePath;
@@ -151,12 +189,12 @@ static NSString *CorruptDatabaseException = @"CorruptDatabaseException";
     NSString *contents = [oldBundlePath stringByAppendingPathComponent:@"Contents"];
     NSString *plistFile = [contents stringByAppendingPathComponent:@"Info.plist"];
     NSString *indexFile = [self _indexFilenameForBundlePath:oldBundlePath];
-    
+
     NSFileManager *fileManager = [NSFileManager defaultManager];
-    NSDictionary *fileAttributes = [fileManager fileAttributesAtPath:oldBundlePath traverseLink:YES];
-    if (![[fileAttributes fileType] isEqualToString:NSFileTypeDirectory])
+    BOOL isDirectory = NO;
+    if (![fileManager fileExistsAtPath:oldBundlePath isDirectory:&isDirectory] || !isDirectory)
         return nil;
-    fileAttributes = [fileManager fileAttributesAtPath:plistFile traverseLink:NO];
+    NSDictionary *fileAttributes = [fileManager attributesOfItemAtPath:plistFile error:NULL];
     if (![[fileAttributes fileType] isEqualToString:NSFileTypeRegular])
         return nil;
 
@@ -170,40 +208,44 @@ static NSString *CorruptDatabaseException = @"CorruptDatabaseException";
     if ([infoPlist intForKey:OWDiskCache_DBVersion_Key] != OWDiskCache_DBVersion)
         return nil;
 
-    NSDictionary *lockInfo = [fileManager lockFileAtPath:indexFile overridingExistingLock:NO];
-    if (lockInfo)
+    int lockFileDescriptor = _lockIndexFile(indexFile);
+    if (lockFileDescriptor < 0)
         return nil;
 
-    OSLDatabaseController *aDatabaseController;
-    NS_DURING {
-        aDatabaseController = [[OSLDatabaseController alloc] initWithDatabasePath:indexFile];
-    } NS_HANDLER {
-        NSLog(@"Unable to open disk cache %@: OSLDatabaseController init: %@", oldBundlePath, [localException reason]);
-        aDatabaseController = nil;
-    } NS_ENDHANDLER;
+    __autoreleasing NSError *error;
+    OSLDatabaseController *aDatabaseController = [[OSLDatabaseController alloc] initWithDatabasePath:indexFile error:&error];
     if (!aDatabaseController) {
-        [fileManager unlockFileAtPath:indexFile];
+        [error log:@"Unable to open disk cache %@", oldBundlePath];
+        close(lockFileDescriptor);
         return nil;
     }
 
-    OWDiskCache *result = [[self alloc] _initWithDatabaseController:aDatabaseController bundle:oldBundlePath];
-    [aDatabaseController release];
-    return [result autorelease];
+    return [[self alloc] _initWithDatabaseController:aDatabaseController bundle:oldBundlePath lockFileDescriptor:lockFileDescriptor];
 }
 
 - (void)close
 {
     [OWContentCacheGroup removeContentCacheObserver:self];
-    
-    if (databaseController != nil) {
+
+    if (lockFileDescriptor >= 0) {
+        [self flushWriteBuffer];
+
         [dbLock lock];
         [self _lockedCancelPreenEvent];
-        // [databaseController commitTransaction];
-        [databaseController release];
         databaseController = nil;
         [dbLock unlock];
-        [[NSFileManager defaultManager] unlockFileAtPath:[self _indexFilename]];
+
+        [[OFController sharedController] removeStatusObserver:(id)self];
+
+        close(lockFileDescriptor);
+        lockFileDescriptor = -1;
     }
+
+    // The events' invocations hold on to us, so let them go.
+    [flushEvent cancelIfPending];
+    flushEvent = nil;
+    [compactEvent cancelIfPending];
+    compactEvent = nil;
 }
 
 - (void)dealloc
@@ -212,22 +254,13 @@ static NSString *CorruptDatabaseException = @"CorruptDatabaseException";
     [self close];
 
     OBASSERT(databaseController == nil); // This was done by -close
-    [dbLock release];
-    dbLock = nil;
-    [bundlePath release];
-    bundlePath = nil;
-    
-    [arcsToRemove release];
-    [contentToGC release];
-    
-    [super dealloc];
 }
 
 - (BOOL)canStoreContent:(OWContent *)someContent;
 {
     if (![someContent isHashable] || ![someContent isStorable])
         return NO;
-        
+
     switch (concreteTypeOfContent(someContent)) {
         case OWDiskCacheBytesConcreteType:
             if ([[someContent objectValue] hasThrownAwayData])
@@ -251,11 +284,8 @@ static NSString *CorruptDatabaseException = @"CorruptDatabaseException";
     if ([anArc arcType] == OWCacheArcDerivedContent)
         return NO;
 
-    NSArray *relatedContent = [anArc entriesWithRelation:OWCacheArcAnyRelation];
-    unsigned int relatedContentCount = [relatedContent count];
-    unsigned int relatedContentIndex;
-    for (relatedContentIndex = 0; relatedContentIndex < relatedContentCount; relatedContentIndex++) {
-        if (![self canStoreContent:[relatedContent objectAtIndex:relatedContentIndex]])
+    for (OWContent *relatedContent in [anArc entriesWithRelation:OWCacheArcAnyRelation]) {
+        if (![self canStoreContent:relatedContent])
             return NO;
     }
 
@@ -264,68 +294,26 @@ static NSString *CorruptDatabaseException = @"CorruptDatabaseException";
 
 - (id <OWCacheArc>)addArc:(OWStaticArc *)anArc;
 {
-    NSNumber *subjHandle, *srcHandle, *objHandle;
     NSData *arcInfo;
-    NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+    NSUInteger pendingCount;
 
-    // The serialize call sometimes raises, so do it before we start the database transaction
+    // The serialize call sometimes raises, so do it before the arc goes into the write buffer
     arcInfo = [anArc serialize];
     if (!arcInfo)
         return nil;
 
     [self removeEntriesDominatedByArc:anArc];
-    
-    [dbLock lock];
-
-    NS_DURING {
-        [databaseController beginTransaction];
-        [self _reduceCacheSize];
-        
-        subjHandle = [self _keyForContent:[anArc subject] insert:YES];
-        srcHandle  = [self _keyForContent:[anArc source ] insert:YES];
-        objHandle  = [self _keyForContent:[anArc object ] insert:YES];
-
-        OBASSERT(subjHandle && srcHandle && objHandle);
-        OBASSERT(arcInfo != nil);
-        if (!(subjHandle && srcHandle && objHandle && arcInfo)) {
-            [databaseController rollbackTransaction];
-            [dbLock unlock];
-            NS_VALUERETURN(nil, id);
-        }
-
-        // CREATE TABLE Arc (arc_id integer primary key, source integer, subject integer, object integer, metadata);
-        OSLPreparedStatement *insertStatement = [databaseController prepareStatement:@"insert into Arc values (?, ?, ?, ?, ?);"];
-
-        [insertStatement bindNull]; // arc_id
-        [insertStatement bindInt:[srcHandle unsignedIntValue]]; // source
-        [insertStatement bindInt:[subjHandle unsignedIntValue]]; // subject
-        [insertStatement bindInt:[objHandle unsignedIntValue]]; // object
-        [insertStatement bindBlob:arcInfo]; // metadata
-        [insertStatement step];
-        [insertStatement reset];
-
-        [contentToGC removeObject:subjHandle];
-        [contentToGC removeObject:srcHandle];
-        [contentToGC removeObject:objHandle];
 
-    } NS_HANDLER {
-#ifdef DEBUG
-        NSLog(@"-[%@ %s], caught exception %@", OBShortObjectDescription(self), _cmd, [localException reason]);
-#endif
-        [databaseController rollbackTransaction];
-        [localException retain];
-        [pool release];
-        [localException autorelease];
-        [dbLock unlock];
-        if ([[localException name] isEqualToString:CorruptDatabaseException])
-            [self _flushCache:nil];
-        [localException raise];
-    } NS_ENDHANDLER;
+    [bufferLock lock];
+    [pendingArcs addObject:anArc];
+    [pendingArcInfo addObject:arcInfo];
+    pendingCount = [pendingArcs count] + [pendingContent count];
+    [bufferLock unlock];
 
-    [databaseController commitTransaction];
-    [pool release];
-    [dbLock unlock];
-    
+    if (pendingCount >= WriteBufferHighWater)
+        [self flushWriteBuffer];
+    else
+        [flushEvent invokeLater];
 
     [preenEvent invokeLater];
 
@@ -335,23 +323,33 @@ static NSString *CorruptDatabaseException = @"CorruptDatabaseException";
 - (NSArray *)allArcs;
 {
     NSMutableArray *allArcs = [[NSMutableArray alloc] init];
-    OSLPreparedStatement *selectStatement = [databaseController prepareStatement:@"select * from Arc;\n"];
+
+    [dbLock lock];
+
+    [bufferLock lock];
+    [allArcs addObjectsFromArray:pendingArcs];
+    [bufferLock unlock];
+
+    OSLPreparedStatement *selectStatement = [databaseController prepareStatement:@"select * from Arc;\n" error:NULL];
     NSDictionary *arcRow;
     while ((arcRow = [selectStatement step]) != nil) {
         OWStaticArc *arc = [self _r_arcFromRow:arcRow];
-        [allArcs addObject:arc];
-        [arc release];
+        if (arc != nil)
+            [allArcs addObject:arc];
     }
     [selectStatement reset];
-    return [allArcs autorelease];
+
+    [dbLock unlock];
+
+    return allArcs;
 }
 
 - (NSArray *)arcsWithRelation:(OWCacheArcRelationship)relation toEntry:(OWContent *)anEntry inPipeline:(OWPipeline *)pipe;
 {
     NSMutableArray *arcs;
-    id handle;
+    NSNumber *handle;
     NSString *cacheControl;
-    NSAutoreleasePool *pool;
+    NSException *corruptionException = nil;
 
     // This method can block on disk I/O and take a while...
     OBASSERT(![OWPipeline isLockHeldByCallingThread]);
@@ -360,67 +358,70 @@ static NSString *CorruptDatabaseException = @"CorruptDatabaseException";
     cacheControl = [pipe contextObjectForKey:OWCacheArcCacheBehaviorKey];
     if (cacheControl &&
         ([cacheControl isEqual:OWCacheArcReload] || [cacheControl isEqual:OWCacheArcRevalidate]))
-        return nil;    
-
-    pool = [[NSAutoreleasePool alloc] init];
-    [dbLock lock];
-    NS_DURING {
-        handle = [self _keyForContent:anEntry insert:NO];
-    } NS_HANDLER {
-#ifdef DEBUG
-        NSLog(@"-[%@ %s]: %@", OBShortObjectDescription(self), _cmd, [localException description]);
-#endif
-        if ([[localException name] isEqualToString:CorruptDatabaseException])
-            [self _flushCache:nil];
-        handle = nil;
-    } NS_ENDHANDLER;
-
-    if (!handle) {
-        // The source content wasn't found in our database
-        [pool release];
-        [dbLock unlock];
         return nil;
-    }
-    
-    OBASSERT([handle isKindOfClass:[NSNumber class]]);
 
     arcs = [[NSMutableArray alloc] init];
 
-    NS_DURING {
-    
-        if (relation & OWCacheArcSubject)
-            [self _pullArcsIntoMutableArray:arcs contentId:handle column:@"subject"];
-        if (relation & OWCacheArcObject)
-            [self _pullArcsIntoMutableArray:arcs contentId:handle column:@"object"];
-        if (relation & OWCacheArcSource)
-            [self _pullArcsIntoMutableArray:arcs contentId:handle column:@"source"];
+    // Try not to let database objects dealloc outside of the lock.
+    @autoreleasepool {
+        [dbLock lock];
+
+        // Arcs which haven't been written yet. We look while holding dbLock, so a flush can't move them into the database between here and the queries below.
+        NSArray *bufferedArcs = [self _bufferedArcsWithRelation:relation toEntry:anEntry];
+        if (bufferedArcs != nil)
+            [arcs addObjectsFromArray:bufferedArcs];
 
-    } NS_HANDLER {
+        @try {
+            handle = [self _keyForContent:anEntry insert:NO];
+        } @catch (NSException *exc) {
 #ifdef DEBUG
-        NSLog(@"-[%@ %s]: %@", OBShortObjectDescription(self), _cmd, [localException description]);
+            NSLog(@"-[%@ %@]: %@", OBShortObjectDescription(self), NSStringFromSelector(_cmd), [exc description]);
 #endif
-        if ([[localException name] isEqualToString:CorruptDatabaseException]) {
-            [arcs removeAllObjects];
-            [localException retain];
-            [pool release];
-            [localException autorelease];
-            [dbLock unlock];
-            [self _flushCache:nil];
-            [localException raise];
+            if ([[exc name] isEqualToString:CorruptDatabaseException]) {
+                [dbLock unlock];
+                [self _flushCache:nil];
+                [dbLock lock];
+            }
+            handle = nil;
         }
-    } NS_ENDHANDLER;
 
-    // Try not to let database objects dealloc outside of the lock.
-    [pool release];
-    [dbLock unlock];
-    
+        // If there's no handle, the source content wasn't found in our database
+        if (handle != nil) {
+            OBASSERT([handle isKindOfClass:[NSNumber class]]);
+
+            @try {
+                if (relation & OWCacheArcSubject)
+                    [self _pullArcsIntoMutableArray:arcs contentId:handle column:@"subject"];
+                if (relation & OWCacheArcObject)
+                    [self _pullArcsIntoMutableArray:arcs contentId:handle column:@"object"];
+                if (relation & OWCacheArcSource)
+                    [self _pullArcsIntoMutableArray:arcs contentId:handle column:@"source"];
+            } @catch (NSException *exc) {
+#ifdef DEBUG
+                NSLog(@"-[%@ %@]: %@", OBShortObjectDescription(self), NSStringFromSelector(_cmd), [exc description]);
+#endif
+                if ([[exc name] isEqualToString:CorruptDatabaseException]) {
+                    [arcs removeAllObjects];
+                    corruptionException = exc;
+                }
+            }
+        }
+
+        [dbLock unlock];
+    }
+
+    if (corruptionException != nil) {
+        [self _flushCache:nil];
+        [corruptionException raise];
+    }
+
 #ifdef DEBUG_wiml
     if ([arcs count])
-        NSLog(@"%@ found %d arcs with relation 0x%02x to entry %@",
+        NSLog(@"%@ found %lu arcs with relation 0x%02x to entry %@",
               OBShortObjectDescription(self), [arcs count], relation, OBShortObjectDescription(anEntry));
 #endif
 
-    return [arcs autorelease];
+    return arcs;
 }
 
 - (float)cost;
@@ -433,7 +434,7 @@ static NSString *CorruptDatabaseException = @"CorruptDatabaseException";
 {
     OBASSERT([aHandle isKindOfClass:[NSNumber class]]);
 
-    OFSimpleLock(&retainedHandlesLock);
+    os_unfair_lock_lock(&retainedHandlesLock);
 
     while (referenceCountOffset > 0) {
         [retainedHandles addObject:aHandle];
@@ -444,26 +445,24 @@ static NSString *CorruptDatabaseException = @"CorruptDatabaseException";
         referenceCountOffset++;
     }
 
-    OFSimpleUnlock(&retainedHandlesLock);
+    os_unfair_lock_unlock(&retainedHandlesLock);
 }
 
 - (unsigned)contentHashForHandle:(id)aHandle;
 {
-    NSDictionary *row;
-    NSNumber *resultNumber;
+    NSNumber *resultNumber = nil;
 
     [dbLock lock];
-    resultNumber = nil;
-    NS_DURING {
-        row = [self _r_rowForId:aHandle];
+    @try {
+        NSDictionary *row = [self _r_rowForId:aHandle];
         OBASSERT(row != nil);
         resultNumber = [row objectForKey:@"valuehash"];
-    } NS_HANDLER {
+    } @catch (NSException *exc) {
         [dbLock unlock];
-        if ([[localException name] isEqualToString:CorruptDatabaseException])
+        if ([[exc name] isEqualToString:CorruptDatabaseException])
             [self _flushCache:nil];
-        [localException raise];
-    } NS_ENDHANDLER;
+        @throw;
+    }
     [dbLock unlock];
 
     OBASSERT(resultNumber != nil);
@@ -475,66 +474,57 @@ static NSString *CorruptDatabaseException = @"CorruptDatabaseException";
 
 - (id <OWConcreteCacheEntry>)contentForHandle:(id)aHandle;
 {
-    NSAutoreleasePool *pool;
     id <OWConcreteCacheEntry> result = nil;
 
-    pool = [[NSAutoreleasePool alloc] init];
-    [dbLock lock];
-    NS_DURING {
-        NSDictionary *row = [self _r_rowForId:aHandle];
-
-        if (row == nil)  // should never actually happen
-            NS_VALUERETURN(nil, id);
+    @autoreleasepool {
+        [dbLock lock];
+        @try {
+            NSDictionary *row = [self _r_rowForId:aHandle];
 
-        result = [self _r_concreteContentFromRow:row];
-        time_t newAccessTime = time(NULL);
-        [databaseController executeSQL:[NSString stringWithFormat:@"update Content set time = %u where content_id = %llu;\n", newAccessTime, [aHandle unsignedLongLongValue]] withCallback:NULL context:NULL];
-    } NS_HANDLER {
-        [pool release];
+            if (row != nil) { // should never actually be nil
+                result = [self _r_concreteContentFromRow:row];
+                [touchedContentIDs addObject:aHandle];
+                [flushEvent invokeLater];
+            }
+        } @catch (NSException *exc) {
+            [dbLock unlock];
+            if ([[exc name] isEqualToString:CorruptDatabaseException])
+                [self _flushCache:nil];
+            @throw;
+        }
         [dbLock unlock];
-        if ([[localException name] isEqualToString:CorruptDatabaseException])
-            [self _flushCache:nil];
-        [localException raise];
-    } NS_ENDHANDLER;
-    [pool release];
-    [dbLock unlock];
-    return [result autorelease];
+    }
+
+    return result;
 }
 
 - (OWContent *)storeContent:(OWContent *)someContent;
 {
-    id handle;
-    NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+    NSUInteger pendingCount;
 
-    [dbLock lock];
-    handle = nil;
-    NS_DURING {
-        [databaseController beginTransaction];
-        
-        [self _reduceCacheSize];
-        handle = [self _keyForContent:someContent insert:YES];
-        [databaseController commitTransaction];
-    } NS_HANDLER {
-        [databaseController rollbackTransaction];
-        [localException retain];
-        [pool release];
-        [localException autorelease];
-        [dbLock unlock];
-        if ([[localException name] isEqualToString:CorruptDatabaseException])
-            [self _flushCache:nil];
-        [localException raise];
-    } NS_ENDHANDLER;
-    [pool release];
-    [dbLock unlock];
-    if (handle)
-        return someContent;
-    else
+    // The same conditions under which -_keyForContent:insert: will be able to write it out.
+    if (concreteTypeOfContent(someContent) == OWDiskCacheUnknownConcreteType)
+        return nil;
+    if (![someContent endOfData] || ![someContent endOfHeaders])
         return nil;
+
+    // See the header: this only means the content has been accepted into the write buffer.
+    [bufferLock lock];
+    [pendingContent addObject:someContent];
+    pendingCount = [pendingArcs count] + [pendingContent count];
+    [bufferLock unlock];
+
+    if (pendingCount >= WriteBufferHighWater)
+        [self flushWriteBuffer];
+    else
+        [flushEvent invokeLater];
+
+    return someContent;
 }
 
 - (NSArray *)_contentRowsForResource:(OWURL *)resourceIdentifier;
 {
-    OSLPreparedStatement *selectStatement = [databaseController prepareStatement:@"select content_id from URI where uri = ?;\n"];
+    OSLPreparedStatement *selectStatement = [databaseController prepareStatement:@"select content_id from URI where uri = ?;\n" error:NULL];
     [selectStatement bindString:[[resourceIdentifier urlWithoutUsernamePasswordOrFragment] compositeString]];
 
     NSMutableArray *contentIds = [NSMutableArray array];
@@ -545,16 +535,19 @@ static NSString *CorruptDatabaseException = @"CorruptDatabaseException";
     [selectStatement reset];
 
     NSMutableArray *contents = [[NSMutableArray alloc] initWithCapacity:[contentIds count]];
-    [contents autorelease];
-    OFForEachInArray(contentIds, NSNumber *, contentId, {
-        [contents addObject:[self _r_rowForId:contentId]];
-    });
-        
+    for (NSNumber *contentId in contentIds) {
+        NSDictionary *contentRow = [self _r_rowForId:contentId];
+        if (contentRow != nil)
+            [contents addObject:contentRow];
+    }
+
     return contents;
 }
 
 - (void)invalidateResource:(OWURL *)resource beforeDate:(NSDate *)invalidationDate;
 {
+    BOOL shouldFlushCache = NO;
+
     if (invalidationDate == nil)
         invalidationDate = [NSDate date];
 
@@ -562,115 +555,110 @@ static NSString *CorruptDatabaseException = @"CorruptDatabaseException";
     NSLog(@"%@ invalidation note: %@", [self shortDescription], [resource description]);
 #endif
 
-    NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
-    [dbLock lock];
+    @autoreleasepool {
+        [dbLock lock];
 
-    NS_DURING {
-        [databaseController beginTransaction];
+        @try {
+            [databaseController beginTransaction];
+
+            NSArray *addresses = [self _contentRowsForResource:resource];
 
-        NSArray *addresses = [self _contentRowsForResource:resource];
-    
 #ifdef DEBUG_wiml
-        NSLog(@"%@ deleting arcs from %d addresses", [self shortDescription], [addresses count]);
+            NSLog(@"%@ deleting arcs from %lu addresses", [self shortDescription], [addresses count]);
 #endif
-    
-        // This is really the sledgehammer method. We should be cleverer than this! (i.e., pay attention to invalidationDate, and keep any resources that are re-validatable.)
-        OFForEachInArray(addresses, NSDictionary *, addressRow, {
-            [self _deleteContentRow:addressRow andReferences:YES];
-        });
-
-        [databaseController commitTransaction];
-        [pool release];
-        [dbLock unlock];
-    } NS_HANDLER {
-        BOOL shouldFlushCache = [[localException name] isEqualToString:CorruptDatabaseException];
+
+            // This is really the sledgehammer method. We should be cleverer than this! (i.e., pay attention to invalidationDate, and keep any resources that are re-validatable.)
+            for (NSDictionary *addressRow in addresses)
+                [self _deleteContentRow:addressRow andReferences:YES];
+
+            [databaseController commitTransaction];
+        } @catch (NSException *exc) {
+            shouldFlushCache = [[exc name] isEqualToString:CorruptDatabaseException];
 #ifdef DEBUG
-        NSLog(@"-[%@ %s]: transaction failed: %@", [self shortDescription], _cmd, localException);
+            NSLog(@"-[%@ %@]: transaction failed: %@", [self shortDescription], NSStringFromSelector(_cmd), exc);
 #endif
-        NS_DURING {
             [databaseController rollbackTransaction];
-        } NS_HANDLER {
-#ifdef DEBUG
-            NSLog(@"-[%@ %s]: rollback failed: %@", [self shortDescription], _cmd, localException);
-#endif
-        } NS_ENDHANDLER;
-        [pool release];  // blows away localException
+        }
+
         [dbLock unlock];
-        if (shouldFlushCache)
-            [self _flushCache:nil];
-    } NS_ENDHANDLER;
+    }
+
+    if (shouldFlushCache)
+        [self _flushCache:nil];
 }
 
 - (void)removeEntriesDominatedByArc:(OWStaticArc *)newArc;
 {
-    NSArray *sourceIds;
-    NSMutableDictionary *relatedArcs;
-    NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+    BOOL shouldFlushCache = NO;
+
+    // Dominated arcs which haven't been written yet can just be dropped.
+    [bufferLock lock];
+    NSUInteger pendingArcIndex = [pendingArcs count];
+    while (pendingArcIndex--) {
+        if ([newArc dominatesArc:[pendingArcs objectAtIndex:pendingArcIndex]]) {
+            [pendingArcs removeObjectAtIndex:pendingArcIndex];
+            [pendingArcInfo removeObjectAtIndex:pendingArcIndex];
+        }
+    }
+    [bufferLock unlock];
 
-    [dbLock lock];
+    @autoreleasepool {
+        [dbLock lock];
 
-    NS_DURING {
+        @try {
+            NSArray *sourceIds;
+
+            if ([[newArc subject] isAddress]) {
+                OWURL *url = [[[newArc subject] address] url];
+                NSArray *addresses = [self _contentRowsForResource:url];
+                sourceIds = [addresses arrayByPerformingSelector:@selector(objectForKey:) withObject:@"content_id"];
+            } else {
+                NSNumber *sourceId = [self _keyForContent:[newArc source] insert:NO];
+                sourceIds = [NSArray arrayWithObjects:sourceId, nil]; // sourceId may be nil
+            }
 
-        if ([[newArc subject] isAddress]) {
-            OWURL *url = [[[newArc subject] address] url];
-            NSArray *addresses = [self _contentRowsForResource:url];
-            sourceIds = [addresses arrayByPerformingSelector:@selector(objectForKey:) withObject:@"content_id"];
-        } else {
-            NSNumber *sourceId = [self _keyForContent:[newArc source] insert:NO];
-            sourceIds = [NSArray arrayWithObjects:sourceId, nil]; // sourceId may be nil
-        }
-    
 #if defined(DEBUG_wiml) || defined(DEBUG_kc0)
-        NSLog(@"%@ checking arcs for possible domination: source content ids %@", [self shortDescription], [sourceIds description]);
+            NSLog(@"%@ checking arcs for possible domination: source content ids %@", [self shortDescription], [sourceIds description]);
 #endif
-    
-        relatedArcs = [[NSMutableDictionary alloc] init];
-        [relatedArcs autorelease];
-        
-        OFForEachInArray(sourceIds, NSNumber *, sourceId, {
-            OSLPreparedStatement *selectStatement = [databaseController prepareStatement:@"select * from Arc where source = ?;\n"];
-            if (selectStatement == nil)
-                continue;
-    
-            [selectStatement bindLongLongInt:[sourceId unsignedLongLongValue]];
-
-            NSDictionary *arcRow;
-            while ((arcRow = [selectStatement step]) != nil ) {
-                OWStaticArc *anArc = [self _r_arcFromRow:arcRow];
-                [relatedArcs setObject:anArc forKey:[arcRow objectForKey:@"arc_id"]];
-                [anArc release];
+
+            NSMutableDictionary *relatedArcs = [[NSMutableDictionary alloc] init];
+            OSLPreparedStatement *selectStatement = [databaseController prepareStatement:@"select * from Arc where source = ?;\n" error:NULL];
+            if (selectStatement != nil) {
+                for (NSNumber *sourceId in sourceIds) {
+                    [selectStatement bindLongLongInt:[sourceId longLongValue]];
+
+                    NSDictionary *arcRow;
+                    while ((arcRow = [selectStatement step]) != nil ) {
+                        OWStaticArc *anArc = [self _r_arcFromRow:arcRow];
+                        if (anArc != nil)
+                            [relatedArcs setObject:anArc forKey:[arcRow objectForKey:@"arc_id"]];
+                    }
+                    [selectStatement reset];
+                }
             }
-            [selectStatement reset];
-        });
-
-        [preenEvent invokeLater];
-    
-        OFForEachInArray([relatedArcs allKeys], OWStaticArc *, existingArcID, {
-            if ([newArc dominatesArc:[relatedArcs objectForKey:existingArcID]])
-                [arcsToRemove addObject:existingArcID];
+
+            [preenEvent invokeLater];
+
+            [relatedArcs enumerateKeysAndObjectsUsingBlock:^(NSNumber *existingArcID, OWStaticArc *existingArc, BOOL *stop) {
+                if ([newArc dominatesArc:existingArc])
+                    [arcsToRemove addObject:existingArcID];
+            }];
+
 #if 0
-            else
-                NSLog(@"%@ arc not dominated = %@", [self shortDescription], existingArcID);
+            NSLog(@"%@ arcsToRemove = %@", [self shortDescription], [arcsToRemove description]);
 #endif
-        });
-            
-#if 0
-        NSLog(@"%@ arcsToRemove = %@", [self shortDescription], [arcsToRemove description]);
-#endif    
-
-        [pool release];
-        [dbLock unlock];
-    } NS_HANDLER {
+        } @catch (NSException *exc) {
 #ifdef DEBUG
-        NSLog(@"-[%@ %s] - %@", [self shortDescription], _cmd, localException);
+            NSLog(@"-[%@ %@] - %@", [self shortDescription], NSStringFromSelector(_cmd), exc);
 #endif
-        [localException retain];
-        [pool release];
-        [localException autorelease];
+            shouldFlushCache = [[exc name] isEqualToString:CorruptDatabaseException];
+        }
+
         [dbLock unlock];
-        if ([[localException name] isEqualToString:CorruptDatabaseException])
-            [self _flushCache:nil];
-    } NS_ENDHANDLER;
+    }
+
+    if (shouldFlushCache)
+        [self _flushCache:nil];
 }
 
 - (void)invalidateArc:(id <OWCacheArc>)arcToWriteBack;
@@ -678,6 +666,110 @@ static NSString *CorruptDatabaseException = @"CorruptDatabaseException";
     // TODO
 }
 
+- (BOOL)flushWriteBuffer;
+{
+    BOOL shouldFlushCache = NO;
+    BOOL success = YES;
+
+    [dbLock lock];
+
+    @autoreleasepool {
+        // Readers look at the buffer while holding dbLock too, so they see these arcs in the buffer or in the database, never neither.
+        [bufferLock lock];
+        NSArray *arcs = [pendingArcs copy];
+        NSArray *arcInfos = [pendingArcInfo copy];
+        NSArray *contents = [pendingContent copy];
+        [pendingArcs removeAllObjects];
+        [pendingArcInfo removeAllObjects];
+        [pendingContent removeAllObjects];
+        [bufferLock unlock];
+
+        if (databaseController == nil) {
+            if ([arcs count] != 0 || [contents count] != 0) {
+                NSLog(@"OWDiskCache: Dropping %lu arcs and %lu content, since the cache at %@ is not open", [arcs count], [contents count], bundlePath);
+                success = NO;
+            }
+        } else if ([arcs count] != 0 || [contents count] != 0 || [touchedContentIDs count] != 0) {
+            @try {
+                if (![databaseController beginTransaction])
+                    [NSException raise:NSGenericException format:@"Unable to begin a transaction"];
+
+                [self _reduceCacheSize];
+
+                for (OWContent *someContent in contents)
+                    [self _keyForContent:someContent insert:YES];
+
+                // CREATE TABLE Arc (arc_id integer primary key, source integer, subject integer, object integer, metadata);
+                OSLPreparedStatement *insertStatement = [databaseController prepareStatement:@"insert into Arc values (?, ?, ?, ?, ?);" error:NULL];
+                NSUInteger arcIndex, arcCount = [arcs count];
+                for (arcIndex = 0; arcIndex < arcCount; arcIndex++) {
+                    OWStaticArc *anArc = [arcs objectAtIndex:arcIndex];
+                    NSNumber *subjHandle = [self _keyForContent:[anArc subject] insert:YES];
+                    NSNumber *srcHandle  = [self _keyForContent:[anArc source ] insert:YES];
+                    NSNumber *objHandle  = [self _keyForContent:[anArc object ] insert:YES];
+
+                    OBASSERT(subjHandle && srcHandle && objHandle);
+                    if (!(subjHandle && srcHandle && objHandle))
+                        continue;
+
+                    [insertStatement bindNull]; // arc_id
+                    [insertStatement bindLongLongInt:[srcHandle longLongValue]]; // source
+                    [insertStatement bindLongLongInt:[subjHandle longLongValue]]; // subject
+                    [insertStatement bindLongLongInt:[objHandle longLongValue]]; // object
+                    [insertStatement bindBlob:[arcInfos objectAtIndex:arcIndex]]; // metadata
+                    [insertStatement step];
+                    [insertStatement reset];
+
+                    [contentToGC removeObject:subjHandle];
+                    [contentToGC removeObject:srcHandle];
+                    [contentToGC removeObject:objHandle];
+                }
+
+                [self _writeAccessTimes];
+
+                if (![databaseController commitTransaction])
+                    [NSException raise:NSGenericException format:@"Unable to commit the transaction"];
+            } @catch (NSException *exc) {
+                // Nobody is waiting on these to hear how it went, so say so here. It's only a cache: dropping them just costs a later hit.
+                NSLog(@"OWDiskCache: Dropping %lu arcs and %lu content after failing to write them to %@: %@", [arcs count], [contents count], bundlePath, [exc reason]);
+                [databaseController rollbackTransaction];
+                success = NO;
+                shouldFlushCache = [[exc name] isEqualToString:CorruptDatabaseException];
+
+                // Some of what we remember may be about rows which were just rolled back.
+                [recentlyUsedContent removeAllObjects];
+                [touchedContentIDs removeAllObjects];
+                totalContentSizeIsValid = NO;
+            }
+        }
+    }
+
+    [dbLock unlock];
+
+    if (shouldFlushCache)
+        [self _flushCache:nil];
+
+    return success;
+}
+
+@end
+
+
+@implementation OWDiskCache (Internal)
+
+- (unsigned long long int)totalContentSize;
+{
+    [dbLock lock];
+    unsigned long long int size = [self _totalContentSize];
+    [dbLock unlock];
+    return size;
+}
+
+- (time_t)accessTime;
+{
+    return time(NULL);
+}
+
 @end
 
 
@@ -688,49 +780,44 @@ static NSString *CorruptDatabaseException = @"CorruptDatabaseException";
 /* Database schema
 
     Table Content:
-      content_id - OXKeyValue - content OID, used to refer to this content
-      time - OXIntValue - time() at which this content was last accessed
-      type - OXIntValue - content's concrete type, according to enum
-      valuehash - OXIntValue - hash of the concrete content value
-      size - OXIntValue - length of the concrete content value
-      metadata - OWXPlistValue - content's metadata dictionary
-      value - OXBinaryValue - content's (non meta-)data, serialized
-      longvalue - OXBlobValue - blob, for larger contents
-    
+      content_id - integer primary key - content OID, used to refer to this content
+      time - integer - time() at which this content was last accessed
+      type - integer - content's concrete type, according to enum
+      valuehash - integer - hash of the concrete content value
+      size - integer - length of the concrete content value
+      metadata - blob - content's metadata dictionary, as an XML property list
+      value - blob - content's (non meta-)data, serialized
+
     Table URI:
-      content_id - OXIntValue - OID of this content
-      uri - OXStringValue - URI for indexing address content
+      content_id - integer - OID of this content
+      uri - text - URI for indexing address content
 
     Table Arc:
-      arc_id - OXKeyValue - arc OID
-      subject, source, object - OXIntValue - content_ids of relevant content
-      metadata - OXBinaryValue - arc information, serialized
-    
+      arc_id - integer primary key - arc OID
+      subject, source, object - integer - content_ids of relevant content
+      metadata - blob - arc information, serialized
+
 */
 
-    [newDB executeSQL:
-	@"PRAGMA synchronous = OFF;\n"
-	@"PRAGMA temp_store = MEMORY;\n" 
-	withCallback:NULL context:NULL];
+    // This has to be set before the first table is created. It lets -_compactStep give the space freed by eviction back a few pages at a time, rather than with a VACUUM which rewrites the whole file while holding the lock.
+    [newDB executeSQL:@"PRAGMA auto_vacuum = INCREMENTAL;\n" withCallback:NULL context:NULL error:NULL];
 
-    [newDB executeSQL:
+    return [newDB executeSQL:
 	@"CREATE TABLE Content (content_id integer primary key, time integer, type integer, valuehash integer, size integer, metadata, value);\n"
 	@"CREATE TABLE Arc (arc_id integer primary key, source integer, subject integer, object integer, metadata);\n"
 	@"CREATE TABLE URI (content_id integer, uri);\n"
 
-	@"CREATE INDEX Arc_source on Arc (source);\n" 
+	@"CREATE INDEX Arc_source on Arc (source);\n"
         @"CREATE INDEX Arc_subject on Arc (subject);\n"
         @"CREATE INDEX Arc_object on Arc (object);\n"
 
-	@"CREATE INDEX Content_time on content (time);\n" 
-	@"CREATE INDEX Content_valuehash on content (valuehash);\n" 
+	@"CREATE INDEX Content_time on content (time);\n"
+	@"CREATE INDEX Content_valuehash on content (valuehash);\n"
 
-	@"CREATE INDEX URI_content_id on URI (content_id);\n" 
+	@"CREATE INDEX URI_content_id on URI (content_id);\n"
 	@"CREATE INDEX URI_uri on URI (uri);\n"
 
-	withCallback:NULL context:NULL];
-
-    return YES;
+	withCallback:NULL context:NULL error:NULL];
 }
 
 + (NSString *)_indexFilenameForBundlePath:(NSString *)aBundlePath;
@@ -743,29 +830,40 @@ static NSString *CorruptDatabaseException = @"CorruptDatabaseException";
 
 - (NSString *)_indexFilename;
 {
-    return [isa _indexFilenameForBundlePath:bundlePath];
+    return [[self class] _indexFilenameForBundlePath:bundlePath];
 }
 
-- _initWithDatabaseController:(OSLDatabaseController *)aDatabaseController bundle:(NSString *)aBundlePath;
+- _initWithDatabaseController:(OSLDatabaseController *)aDatabaseController bundle:(NSString *)aBundlePath lockFileDescriptor:(int)aLockFileDescriptor;
 {
 #ifdef DEBUG_kc
-    NSLog(@"-[%@ %s]: aDatabaseController = %@", OBShortObjectDescription(self), _cmd, aDatabaseController);
+    NSLog(@"-[%@ %@]: aDatabaseController = %@", OBShortObjectDescription(self), NSStringFromSelector(_cmd), aDatabaseController);
 #endif
 
-    if ([super init] == nil)
+    if (!(self = [super init])) {
+        close(aLockFileDescriptor);
         return nil;
+    }
 
-    databaseController = [aDatabaseController retain];
+    databaseController = aDatabaseController;
     bundlePath = [aBundlePath copy];
-    NSZone *thisZone = [self zone];
-    retainedHandles = [[NSCountedSet allocWithZone:thisZone] init];
-    recentlyUsedContent = [[NSMutableArray allocWithZone:thisZone] init];
+    lockFileDescriptor = aLockFileDescriptor;
+    retainedHandlesLock = OS_UNFAIR_LOCK_INIT;
+    retainedHandles = [[NSCountedSet alloc] init];
+    recentlyUsedContent = [[NSMutableArray alloc] init];
     arcsToRemove = [[NSMutableSet alloc] init];
     contentToGC = [[NSMutableSet alloc] init];
     dbLock = [[NSLock alloc] init];
-    preenEvent = [[OFDelayedEvent alloc] initWithInvocation:[[[OFInvocation alloc] initForObject:self selector:@selector(_preenCache)] autorelease] delayInterval:0.5 scheduler:[OWContentCacheGroup scheduler] fireOnTermination:NO];
+    preenEvent = [[OFDelayedEvent alloc] initForObject:self selector:@selector(_preenCache) withObject:nil delayInterval:0.5 scheduler:[OWContentCacheGroup scheduler] fireOnTermination:NO];
 
-    [[OFController sharedController] addObserver:(id)self];
+    bufferLock = [[NSLock alloc] init];
+    pendingArcs = [[NSMutableArray alloc] init];
+    pendingArcInfo = [[NSMutableArray alloc] init];
+    pendingContent = [[NSMutableArray alloc] init];
+    touchedContentIDs = [[NSMutableSet alloc] init];
+    flushEvent = [[OFDelayedEvent alloc] initForObject:self selector:@selector(flushWriteBuffer) withObject:nil delayInterval:WriteBufferFlushDelay scheduler:[OWContentCacheGroup scheduler] fireOnTermination:YES];
+    compactEvent = [[OFDelayedEvent alloc] initForObject:self selector:@selector(_compactStep) withObject:nil delayInterval:CompactionStepDelay scheduler:[OWContentCacheGroup scheduler] fireOnTermination:NO];
+
+    [[OFController sharedController] addStatusObserver:(id)self];
     [OWContentCacheGroup addContentCacheObserver:self];
     [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(_flushCache:) name:OWContentCacheFlushNotification object:nil];
 
@@ -782,8 +880,8 @@ static NSString *CorruptDatabaseException = @"CorruptDatabaseException";
     if (![someContent endOfData] || ![someContent endOfHeaders])
         return nil;
 
-    unsigned recentlyUsedContentCount = [recentlyUsedContent count];
-    unsigned recentlyUsedContentIndex;
+    NSUInteger recentlyUsedContentCount = [recentlyUsedContent count];
+    NSUInteger recentlyUsedContentIndex;
     for (recentlyUsedContentIndex = recentlyUsedContentCount; recentlyUsedContentIndex > 0; recentlyUsedContentIndex --) {
         OWContent *possible = [recentlyUsedContent objectAtIndex:recentlyUsedContentIndex - 1];
         if ([possible isEqual:someContent]) {
@@ -792,50 +890,48 @@ static NSString *CorruptDatabaseException = @"CorruptDatabaseException";
                 [recentlyUsedContent addObject:possible];
                 [recentlyUsedContent removeObjectAtIndex:(recentlyUsedContentIndex - 1)];
             }
-            return [possible handleForCache:self];
+            NSNumber *handle = [possible handleForCache:self];
+            if (handle != nil)
+                [touchedContentIDs addObject:handle];
+            return handle;
         }
     }
 
     if (recentlyUsedContentCount >= LRUContentHighWater)
         [recentlyUsedContent removeObjectsInRange:(NSRange){0, recentlyUsedContentCount - LRUContentLowWater}];
 
-    unsigned int valueHash = [someContent contentHash];
-    
-    OSLPreparedStatement *selectStatement = [databaseController prepareStatement:@"select * from Content where valuehash = ?;\n"];
-    [selectStatement bindInt:valueHash];
+    // The hash is stored in (and compared as) 32 bits, which is what -contentHashForHandle: can give back.
+    unsigned int valueHash = (unsigned int)[someContent contentHash];
+
+    OSLPreparedStatement *selectStatement = [databaseController prepareStatement:@"select * from Content where valuehash = ?;\n" error:NULL];
+    [selectStatement bindInt:(int)valueHash];
 
     NSDictionary *row;
     while ((row = [selectStatement step]) != nil ) {
-        BOOL match = YES;
-        NSNumber *cid = nil;
-
-        if ([(NSNumber *)[row objectForKey:@"type"] unsignedIntValue] != enumType)
-            match = NO;
-
-        if (match) {
-            OWContent *possibility = [self _contentFromRow:row];
-            if (!possibility || ![possibility isEqual:someContent])
-                match = NO;
-            else {
-                cid = (id)[row objectForKey:@"content_id"];
-            }
-        }
+        if ((enum OWDiskCacheConcreteContentType)[(NSNumber *)[row objectForKey:@"type"] intValue] != enumType)
+            continue;
+
+        OWContent *possibility = [self _contentFromRow:row];
+        if (!possibility || ![possibility isEqual:someContent])
+            continue;
 
-        if (match)
-            return cid;
+        NSNumber *cid = [row objectForKey:@"content_id"];
+        [selectStatement reset];
+        [touchedContentIDs addObject:cid];
+        return cid;
     }
+    [selectStatement reset];
 
     if (shouldInsert) {
         NSNumber *cid;
         NSDictionary *meta;
         NSData *contentValue;
-        int contentLength;
+        NSUInteger contentLength;
         OWDataStream *stream;
 
-
         switch(enumType) {
             case OWDiskCacheAddressConcreteType:
-                contentValue = [NSKeyedArchiver archivedDataWithRootObject:[someContent address]];
+                contentValue = [NSKeyedArchiver archivedDataWithRootObject:[someContent address] requiringSecureCoding:NO error:NULL];
                 break;
             case OWDiskCacheBytesConcreteType:
                 // We do this rather than ask for the -dataCursor so that we get the compressed version if any
@@ -846,33 +942,36 @@ static NSString *CorruptDatabaseException = @"CorruptDatabaseException";
 #ifdef DEBUG_kc0
                 NSLog(@"Archiving exception content: %@", [someContent objectValue]);
 #endif
-                contentValue = [NSKeyedArchiver archivedDataWithRootObject:[someContent objectValue]];
+                contentValue = [NSKeyedArchiver archivedDataWithRootObject:[someContent objectValue] requiringSecureCoding:NO error:NULL];
                 break;
             default:
                 return nil; // can't store other kinds of content
         }
+        if (contentValue == nil)
+            return nil;
         contentLength = [contentValue length];
 #ifdef DEBUG_toon0
-            NSLog(@"Inserted %d byte content. %d total content size", contentLength, totalContentSize);
-#endif                
+        NSLog(@"Inserted %lu byte content. %llu total content size", contentLength, totalContentSize);
+#endif
         meta = [someContent headersAsPropertyList];
         if ([meta count] == 0)
             meta = nil;
-        
+
 	// CREATE TABLE Content (content_id integer primary key, time integer, type integer, valuehash integer, size integer, metadata, value);
-        OSLPreparedStatement *insertStatement = [databaseController prepareStatement:@"insert into Content values (?, ?, ?, ?, ?, ?, ?);"];
-        
+        OSLPreparedStatement *insertStatement = [databaseController prepareStatement:@"insert into Content values (?, ?, ?, ?, ?, ?, ?);" error:NULL];
+
         [insertStatement bindNull]; // content_id
-        [insertStatement bindInt:time(NULL)]; // time
+        [insertStatement bindLongLongInt:[self accessTime]]; // time
         [insertStatement bindInt:enumType]; // type
-        [insertStatement bindInt:valueHash]; // valuehash
-        [insertStatement bindInt:contentLength]; // size
+        [insertStatement bindInt:(int)valueHash]; // valuehash
+        [insertStatement bindLongLongInt:contentLength]; // size
         [insertStatement bindPropertyList:meta]; // metadata
         [insertStatement bindBlob:contentValue]; // value
         [insertStatement step];
         [insertStatement reset];
 
         cid = [[NSNumber alloc] initWithUnsignedLongLong:[databaseController lastInsertRowID]];
+        totalContentSize += contentLength;
 
 #ifdef DEBUG_wiml
         NSLog(@"Inserted obj handle=%@ ct=%d vh=%u", cid, enumType, valueHash);
@@ -883,18 +982,18 @@ static NSString *CorruptDatabaseException = @"CorruptDatabaseException";
             OWURL *resourceIdentifier = [[[someContent address] url] urlWithoutUsernamePasswordOrFragment];
 
             // CREATE TABLE URI (content_id integer, uri);
-            OSLPreparedStatement *insertStatement = [databaseController prepareStatement:@"insert into URI values (?, ?);"];
-            
-            [insertStatement bindLongLongInt:[cid unsignedLongLongValue]]; // content_id
-            [insertStatement bindString:[resourceIdentifier compositeString]]; // uri
-            [insertStatement step];
-            [insertStatement reset];
+            OSLPreparedStatement *uriInsertStatement = [databaseController prepareStatement:@"insert into URI values (?, ?);" error:NULL];
+
+            [uriInsertStatement bindLongLongInt:[cid longLongValue]]; // content_id
+            [uriInsertStatement bindString:[resourceIdentifier compositeString]]; // uri
+            [uriInsertStatement step];
+            [uriInsertStatement reset];
         }
 
         [someContent useHandle:cid forCache:self];
         [recentlyUsedContent addObject:someContent];
 
-        return [cid autorelease];
+        return cid;
     }
 
     return nil;
@@ -903,15 +1002,35 @@ static NSString *CorruptDatabaseException = @"CorruptDatabaseException";
 - (OWContent *)_contentForKey:(NSNumber *)contentID;
 {
     OBPRECONDITION(contentID != nil);
-    
-    OFForEachInArray(recentlyUsedContent, OWContent *, someContent, {
+
+    [touchedContentIDs addObject:contentID];
+
+    for (OWContent *someContent in recentlyUsedContent) {
         if ([contentID isEqual:[someContent handleForCache:self]])
             return someContent;
-    });
-    
+    }
+
     return [self _contentFromRow:[self _r_rowForId:contentID]];
 }
 
+static id _unarchivedRowObject(NSData *rowData)
+{
+    __autoreleasing NSError *error;
+    NSKeyedUnarchiver *unarchiver = [[NSKeyedUnarchiver alloc] initForReadingFromData:rowData error:&error];
+    if (unarchiver == nil) {
+#ifdef DEBUG
+        [error log:@"Unable to unarchive disk cache row"];
+#endif
+        return nil;
+    }
+
+    // We wrote these ourselves, and OWAddress doesn't adopt NSSecureCoding.
+    unarchiver.requiresSecureCoding = NO;
+    id object = [unarchiver decodeObjectForKey:NSKeyedArchiveRootObjectKey];
+    [unarchiver finishDecoding];
+    return object;
+}
+
 - (id <OWConcreteCacheEntry>)_r_concreteContentFromRow:(NSDictionary *)row;
 {
     enum OWDiskCacheConcreteContentType rowType = [(NSNumber *)[row objectForKey:@"type"] intValue];
@@ -924,7 +1043,7 @@ static NSString *CorruptDatabaseException = @"CorruptDatabaseException";
         OBASSERT([storedConcreteValue isKindOfClass:[NSData class]]);
         rowData = (NSData *)storedConcreteValue;
     }
-    
+
     switch (rowType) {
         case OWDiskCacheAddressConcreteType:
         case OWDiskCacheExceptionConcreteType:
@@ -932,11 +1051,11 @@ static NSString *CorruptDatabaseException = @"CorruptDatabaseException";
 #ifdef DEBUG_kc0
             NSLog(@"Unarchiving disk cache row: %@", row );
 #endif
-            NSObject *rowEntry = [NSKeyedUnarchiver unarchiveObjectWithData:rowData];
+            id <OWConcreteCacheEntry> rowEntry = _unarchivedRowObject(rowData);
 #ifdef DEBUG_kc0
             NSLog(@"Unarchived disk cache row: %@ -> %@", row, rowEntry);
 #endif
-            return [rowEntry retain];
+            return rowEntry;
         }
 
         case OWDiskCacheBytesConcreteType:
@@ -956,8 +1075,8 @@ static NSString *CorruptDatabaseException = @"CorruptDatabaseException";
 {
     OBPRECONDITION([aHandle isKindOfClass:[NSNumber class]]);
 
-    OSLPreparedStatement *selectStatement = [databaseController prepareStatement:@"select * from Content where content_id = ?;\n"];
-    [selectStatement bindLongLongInt:[aHandle unsignedLongLongValue]];
+    OSLPreparedStatement *selectStatement = [databaseController prepareStatement:@"select * from Content where content_id = ?;\n" error:NULL];
+    [selectStatement bindLongLongInt:[aHandle longLongValue]];
     NSDictionary *row = [selectStatement step];
     [selectStatement reset];
     return row;
@@ -970,29 +1089,29 @@ static NSString *CorruptDatabaseException = @"CorruptDatabaseException";
 
     NSObject *contentHandle = [row objectForKey:@"content_id"];
     id <OWConcreteCacheEntry> innerContent = [self _r_concreteContentFromRow:row];
+    if (innerContent == nil)
+        return nil;
     OWContent *result = [[OWContent alloc] initWithContent:innerContent];
-    [innerContent release];
     [result useHandle:contentHandle forCache:self];
-    
-    NSData *headerData = [row objectForKey:@"headerData"];
+
+    NSData *headerData = [row objectForKey:@"metadata"];
     if (headerData != nil) {
-        CFStringRef errorString = NULL;
-        CFPropertyListRef parsedHeaders = CFPropertyListCreateFromXMLData(kCFAllocatorDefault, (CFDataRef)headerData, kCFPropertyListImmutable, &errorString);
+        __autoreleasing NSError *error;
+        id parsedHeaders = [NSPropertyListSerialization propertyListWithData:headerData options:NSPropertyListImmutable format:NULL error:&error];
         if (parsedHeaders != nil) {
-            [result addHeadersFromPropertyList:(id)parsedHeaders];
+            [result addHeadersFromPropertyList:parsedHeaders];
         } else {
 #ifdef DEBUG
-            NSLog(@"-[%@ %s]: Failed to parse header data: %@; headerData=%@", errorString, headerData);
+            NSLog(@"-[%@ %@]: Failed to parse header data: %@; headerData=%@", OBShortObjectDescription(self), NSStringFromSelector(_cmd), error, headerData);
 #endif
         }
     }
     [result markEndOfHeaders];
 
-    OBASSERT([result contentHash] == [(NSNumber *)[row objectForKey:@"valuehash"] unsignedIntValue]);
+    OBASSERT((unsigned int)[result contentHash] == [(NSNumber *)[row objectForKey:@"valuehash"] unsignedIntValue]);
 
     [recentlyUsedContent addObject:result];
 
-    [result autorelease];
     return result;
 }
 
@@ -1000,11 +1119,11 @@ static NSString *CorruptDatabaseException = @"CorruptDatabaseException";
 {
     // TODO: Use an 'Or' qualifier of some sort here instead of making three scans and merging them. (Actually, we almost never do more than one column, so this isn't actually too inefficient.)
 
-    OSLPreparedStatement *selectStatement = [databaseController prepareStatement:[NSString stringWithFormat:@"select * from Arc where %@ = ?;\n", columnName]];
+    OSLPreparedStatement *selectStatement = [databaseController prepareStatement:[NSString stringWithFormat:@"select * from Arc where %@ = ?;\n", columnName] error:NULL];
     if (selectStatement == nil)
         return;
 
-    [selectStatement bindLongLongInt:[contentId unsignedLongLongValue]];
+    [selectStatement bindLongLongInt:[contentId longLongValue]];
 
     NSDictionary *row;
     while ((row = [selectStatement step]) != nil ) {
@@ -1012,40 +1131,37 @@ static NSString *CorruptDatabaseException = @"CorruptDatabaseException";
             continue;
 
         OWStaticArc *anArc = [self _r_arcFromRow:row];
+        if (anArc == nil)
+            continue;
         [targetArray addObject:anArc];
 #ifdef DEBUG_kc
         NSLog(@"%@ pulled arc %@  ->  %@", [self shortDescription], [row objectForKey:@"arc_id"], anArc);
 #endif
-        [anArc release];
     }
     [selectStatement reset];
 }
 
 - (OWStaticArc *)_r_arcFromRow:(NSDictionary *)row;
 {
-    struct OWStaticArcInitialization i;
-    OWStaticArc *newArc;
-    NSObject *subjectKey, *sourceKey, *objectKey;
-
-    bzero(&i, sizeof(i));
+    OWStaticArcInitialization *i = [[OWStaticArcInitialization alloc] init];
 
-    if (![OWStaticArc deserializeProperties:&i fromBuffer:(NSData *)[row objectForKey:@"metadata"]])
+    if (![OWStaticArc deserializeProperties:i fromBuffer:(NSData *)[row objectForKey:@"metadata"]])
         return nil;
 
-    subjectKey = [row objectForKey:@"subject"];
-    sourceKey = [row objectForKey:@"source"];
-    objectKey = [row objectForKey:@"object"];
-    i.subject = [self _contentForKey:(NSNumber *)subjectKey];
-    i.source  = [self _contentForKey:(NSNumber *)sourceKey];
-    i.object  = [self _contentForKey:(NSNumber *)objectKey];
-
-    newArc = [[OWStaticArc alloc] initWithArcInitializationProperties:i];
+    NSNumber *subjectKey = [row objectForKey:@"subject"];
+    NSNumber *sourceKey = [row objectForKey:@"source"];
+    NSNumber *objectKey = [row objectForKey:@"object"];
+    i.subject = [self _contentForKey:subjectKey];
+    i.source  = [self _contentForKey:sourceKey];
+    i.object  = [self _contentForKey:objectKey];
+    if (i.subject == nil || i.source == nil || i.object == nil)
+        return nil; // Some of its content is gone; the preen will get rid of it
 
     [contentToGC removeObject:subjectKey];
     [contentToGC removeObject:sourceKey];
     [contentToGC removeObject:objectKey];
 
-    return newArc;  /* preretained */
+    return [[OWStaticArc alloc] initWithArcInitializationProperties:i];
 }
 
 static enum OWDiskCacheConcreteContentType concreteTypeOfContent(OWContent *content)
@@ -1072,7 +1188,6 @@ static enum OWDiskCacheConcreteContentType concreteTypeOfContent(OWContent *cont
 - (void)_flushCache:(NSNotification *)note;
 {
     BOOL removeAll;
-    NSAutoreleasePool *pool;
 
 #ifdef DEBUG_wiml
     NSLog(@"Flushing cache: %@", note);
@@ -1080,61 +1195,59 @@ static enum OWDiskCacheConcreteContentType concreteTypeOfContent(OWContent *cont
 
     removeAll = [OWContentCacheFlush_Remove isEqual:[[note userInfo] objectForKey:OWContentCacheInvalidateOrRemoveNotificationInfoKey]];
 
-    OFLockRegion_Begin(dbLock);
+    [dbLock lock];
 
     if (removeAll || note == nil) {
-        NSString *indexFile;
-        NSFileManager *fileManager;
+        @autoreleasepool {
+            [self _discardWriteBuffer];
+            [recentlyUsedContent removeAllObjects];
+            [arcsToRemove removeAllObjects];
+            [contentToGC removeAllObjects];
+            [touchedContentIDs removeAllObjects];
+            totalContentSize = 0;
+            totalContentSizeIsValid = YES;
+            [compactEvent cancelIfPending];
+            compactionState = CompactionUnknown;
+            [preenEvent cancelIfPending];
 
-        pool = [[NSAutoreleasePool alloc] init];
-        [recentlyUsedContent removeAllObjects];
-        [arcsToRemove removeAllObjects];
-        [contentToGC removeAllObjects];
-        [self _lockedCancelPreenEvent];
-        
-        [databaseController release];
-        databaseController = nil;
-
-        [pool release];
+            databaseController = nil;
+        }
 
-        OFSimpleLock(&retainedHandlesLock);
+        os_unfair_lock_lock(&retainedHandlesLock);
 #ifdef DEBUG
-        unsigned int count = [retainedHandles count];
+        NSUInteger count = [retainedHandles count];
 #endif
         [retainedHandles removeAllObjects];
-        OFSimpleUnlock(&retainedHandlesLock);
+        os_unfair_lock_unlock(&retainedHandlesLock);
 #ifdef DEBUG
         if (count > 0) {
-            NSLog(@"Warning, %d dangling handles when flushing disk cache.", count);
+            NSLog(@"Warning, %lu dangling handles when flushing disk cache.", count);
         }
 #endif
 
-        pool = [[NSAutoreleasePool alloc] init];
+        @autoreleasepool {
+            NSString *indexFile = [self _indexFilename];
 
-        indexFile = [self _indexFilename];
-        
-        fileManager = [NSFileManager defaultManager];
-        [fileManager removeFileAtPath:indexFile handler:nil];
-        [fileManager removeFileAtPath:[indexFile stringByAppendingPathExtension:@"log"] handler:nil];
+            NSFileManager *fileManager = [NSFileManager defaultManager];
+            [fileManager removeItemAtPath:indexFile error:NULL];
+            [fileManager removeItemAtPath:[indexFile stringByAppendingString:@"-journal"] error:NULL];
 
-        databaseController = [[OSLDatabaseController alloc] initWithDatabasePath:indexFile];
-        if (databaseController == nil || ![isa _initializeDatabase:databaseController]) {
-            [databaseController deleteDatabase];
-            [databaseController release];
-            databaseController = nil;
-            NSLog(@"OWDiskCache: Unable to initialize disk cache database %@", indexFile);
-            /* ... ??? ... */
+            databaseController = [[OSLDatabaseController alloc] initWithDatabasePath:indexFile error:NULL];
+            if (databaseController == nil || ![[self class] _initializeDatabase:databaseController]) {
+                [databaseController deleteDatabase];
+                databaseController = nil;
+                NSLog(@"OWDiskCache: Unable to initialize disk cache database %@", indexFile);
+                /* ... ??? ... */
+            }
         }
 
-        [pool release];
-        
     } else {
 #ifdef DEBUG
-        NSLog(@"-[%@ %s]: don't understand notification %@", OBShortObjectDescription(self), _cmd, note);
+        NSLog(@"-[%@ %@]: don't understand notification %@", OBShortObjectDescription(self), NSStringFromSelector(_cmd), note);
 #endif
     }
 
-    OFLockRegion_End(dbLock);
+    [dbLock unlock];
 }
 
 - (int)_deleteContentRow:(NSDictionary *)contentRow andReferences:(BOOL)mayHaveReferences
@@ -1148,8 +1261,8 @@ static enum OWDiskCacheConcreteContentType concreteTypeOfContent(OWContent *cont
 
     if (mayHaveReferences) {
         // select arc_id from Arc where subject = ? or object = ? or source = ?
-        OSLPreparedStatement *selectStatement = [databaseController prepareStatement:@"select arc_id from Arc where source = ?;\n"];
-        [selectStatement bindLongLongInt:[cid unsignedLongLongValue]];
+        OSLPreparedStatement *selectStatement = [databaseController prepareStatement:@"select arc_id from Arc where source = ?;\n" error:NULL];
+        [selectStatement bindLongLongInt:[cid longLongValue]];
 
         NSDictionary *arcRow;
         while ((arcRow = [selectStatement step]) != nil ) {
@@ -1162,14 +1275,18 @@ static enum OWDiskCacheConcreteContentType concreteTypeOfContent(OWContent *cont
     }
 
     [contentToGC removeObject:cid];
+    [touchedContentIDs removeObject:cid];
+
+    unsigned long long int size = [[contentRow objectForKey:@"size"] unsignedLongLongValue];
+    totalContentSize -= MIN(size, totalContentSize);
 
     [databaseController executeSQL:
-        [NSString stringWithFormat:@"delete from URI where content_id = %llu;\n", [cid unsignedLongLongValue]]
-                      withCallback:NULL context:NULL];
+        [NSString stringWithFormat:@"delete from URI where content_id = %lld;\n", [cid longLongValue]]
+                      withCallback:NULL context:NULL error:NULL];
 
     [databaseController executeSQL:
-        [NSString stringWithFormat:@"delete from Content where content_id = %llu;\n", [cid unsignedLongLongValue]]
-                      withCallback:NULL context:NULL];
+        [NSString stringWithFormat:@"delete from Content where content_id = %lld;\n", [cid longLongValue]]
+                      withCallback:NULL context:NULL error:NULL];
 
     return YES;
 }
@@ -1189,8 +1306,8 @@ static enum OWDiskCacheConcreteContentType concreteTypeOfContent(OWContent *cont
     NSLog(@"%@ deleting arc id=%@", [self shortDescription], anArcId);
 #endif
 
-    OSLPreparedStatement *selectStatement = [databaseController prepareStatement:@"select * from Arc where arc_id = ?;\n"];
-    [selectStatement bindLongLongInt:[anArcId unsignedLongLongValue]];
+    OSLPreparedStatement *selectStatement = [databaseController prepareStatement:@"select * from Arc where arc_id = ?;\n" error:NULL];
+    [selectStatement bindLongLongInt:[anArcId longLongValue]];
     NSDictionary *row = [selectStatement step];
     [selectStatement reset];
     if (row == nil)
@@ -1201,8 +1318,8 @@ static enum OWDiskCacheConcreteContentType concreteTypeOfContent(OWContent *cont
     [contentToGC addObject:[row objectForKey:@"object"]];
 
     [databaseController executeSQL:
-        [NSString stringWithFormat:@"delete from Arc where arc_id = %llu;\n", [anArcId unsignedLongLongValue]]
-                      withCallback:NULL context:NULL];
+        [NSString stringWithFormat:@"delete from Arc where arc_id = %lld;\n", [anArcId longLongValue]]
+                      withCallback:NULL context:NULL error:NULL];
 }
 
 - (void)_deleteUnreferencedContent
@@ -1214,127 +1331,244 @@ static enum OWDiskCacheConcreteContentType concreteTypeOfContent(OWContent *cont
     NSLog(@"%@ before: contentToGC=%@", [self shortDescription], [contentToGC description]);
 #endif
 
-    /* Remove any content IDs from contentToGC if there is an arc referring to them */
-    OSLPreparedStatement *selectStatement = [databaseController prepareStatement:@"select * from Arc;\n"];
-    unsigned int rowCount = 0;
-    NSDictionary *arcRow;
-    while ((arcRow = [selectStatement step]) != nil ) {
-        rowCount++;
-        [contentToGC removeObject:[arcRow objectForKey:@"source"]];
-        [contentToGC removeObject:[arcRow objectForKey:@"subject"]];
-        [contentToGC removeObject:[arcRow objectForKey:@"object"]];
-        if ([contentToGC count] == 0)
-            break;
+    // Put the candidates in a temporary table so that the Arc indexes can be asked about all of them at once, rather than reading through every arc.
+    [databaseController executeSQL:
+        @"create temp table if not exists GC (content_id integer primary key);\n"
+        @"delete from GC;\n"
+                      withCallback:NULL context:NULL error:NULL];
+
+    OSLPreparedStatement *insertStatement = [databaseController prepareStatement:@"insert or ignore into GC values (?);" error:NULL];
+    for (NSNumber *contentId in contentToGC) {
+        [insertStatement bindLongLongInt:[contentId longLongValue]];
+        [insertStatement step];
+        [insertStatement reset];
     }
-    [selectStatement reset];
+    [contentToGC removeAllObjects];
 
-#if defined(DEBUG_wiml) || defined(DEBUG_kc0)
-    NSLog(@"%@ after: %u arcs, contentToGC=%@", [self shortDescription], rowCount, [contentToGC description]);
-#endif
+    /* Remove any content IDs from GC if there is an arc referring to them */
+    [databaseController executeSQL:
+        @"delete from GC where exists (select 1 from Arc where source = GC.content_id)"
+        @" or exists (select 1 from Arc where subject = GC.content_id)"
+        @" or exists (select 1 from Arc where object = GC.content_id);\n"
+                      withCallback:NULL context:NULL error:NULL];
 
-#if 0
-    // Check that the content we're about to delete actually exists
-    {
-        NSMutableSet *cts = [contentToGC mutableCopy];
-        OXSQLCommand *cQuery = [db parseSQLCommand:@"select content_id from Content"];
-        unsigned int rowCount;
-        OSLPreparedStatement *selectStatement = [cQuery nextResultSetInDatabase:db rowCount:&rowCount];
-        NSDictionary *cRow;
-        while ( (cRow = [selectStatement nextRow]) != nil ) {
-            [cts removeObject:[cRow objectForKey:@"content_id"]];
-        }
+    OSLPreparedStatement *sizeStatement = [databaseController prepareStatement:@"select count(*) as count, sum(size) as size from Content where content_id in (select content_id from GC);\n" error:NULL];
+    NSDictionary *sizeRow = [sizeStatement step];
+    [sizeStatement reset];
+    unsigned long long int size = [[sizeRow objectForKey:@"size"] unsignedLongLongValue];
+    totalContentSize -= MIN(size, totalContentSize);
 
-        OBASSERT([cts count] == 0);
-        [cts release];
-    }
+#if defined(DEBUG_wiml) || defined(DEBUG_kc0)
+    NSLog(@"%@ deleting %@ unreferenced content rows, %llu bytes", [self shortDescription], [sizeRow objectForKey:@"count"], size);
 #endif
 
-    while ([contentToGC count]) {
-        NSNumber *contentId = [contentToGC anyObject];
-        NSDictionary *contentRow = [self _r_rowForId:contentId];
-        [contentToGC removeObject:contentId];
+    [databaseController executeSQL:
+        @"delete from URI where content_id in (select content_id from GC);\n"
+        @"delete from Content where content_id in (select content_id from GC);\n"
+        @"delete from GC;\n"
+                      withCallback:NULL context:NULL error:NULL];
 
-        if (contentRow != nil)
-            [self _deleteContentRow:contentRow andReferences:NO];
-    }
+    // The handles of our recently used content may be among those just deleted.
+    [recentlyUsedContent removeAllObjects];
 }
 
-- (int)_deleteOldestContent;
+// Deletes content in least-recently-used order until at least bytesToFree have been freed. The victims are collected in a temporary table, and then each table is cleaned out with a single statement.
+- (unsigned long long int)_deleteOldestContentFreeingBytes:(unsigned long long int)bytesToFree;
 {
-    NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+    unsigned long long int bytesFreed = 0;
+
+    @autoreleasepool {
+        [databaseController executeSQL:
+            @"create temp table if not exists Evict (content_id integer primary key);\n"
+            @"delete from Evict;\n"
+                          withCallback:NULL context:NULL error:NULL];
+
+        // This walks the Content_time index, so it only reads as many rows as it evicts.
+        OSLPreparedStatement *selectStatement = [databaseController prepareStatement:@"select content_id, size from Content order by time;\n" error:NULL];
+        OSLPreparedStatement *insertStatement = [databaseController prepareStatement:@"insert into Evict values (?);" error:NULL];
+        NSDictionary *row;
+        while (bytesFreed < bytesToFree && (row = [selectStatement step]) != nil) {
+            bytesFreed += [[row objectForKey:@"size"] unsignedLongLongValue];
+            [insertStatement bindLongLongInt:[[row objectForKey:@"content_id"] longLongValue]];
+            [insertStatement step];
+            [insertStatement reset];
+            [touchedContentIDs removeObject:[row objectForKey:@"content_id"]];
+        }
+        [selectStatement reset];
 
-    OSLPreparedStatement *selectStatement = [databaseController prepareStatement:@"select * from Content order by time limit 1;\n"];
-    NSDictionary *oldestRow = [selectStatement step];
-    [selectStatement reset];
+        // Whatever else the doomed arcs refer to may now be unreferenced.
+        selectStatement = [databaseController prepareStatement:
+            @"select source, subject, object from Arc where source in (select content_id from Evict)"
+            @" or subject in (select content_id from Evict)"
+            @" or object in (select content_id from Evict);\n" error:NULL];
+        while ((row = [selectStatement step]) != nil) {
+            [contentToGC addObject:[row objectForKey:@"source"]];
+            [contentToGC addObject:[row objectForKey:@"subject"]];
+            [contentToGC addObject:[row objectForKey:@"object"]];
+        }
+        [selectStatement reset];
 
-    if (oldestRow == nil)
-        return 0;
-    
-    int sizeRemoved = [[oldestRow objectForKey:@"size"] intValue];
-    BOOL didRemove = [self _deleteContentRow:oldestRow andReferences:YES];
-    [pool release];
+        [databaseController executeSQL:
+            @"delete from Arc where source in (select content_id from Evict)"
+            @" or subject in (select content_id from Evict)"
+            @" or object in (select content_id from Evict);\n"
+            @"delete from URI where content_id in (select content_id from Evict);\n"
+            @"delete from Content where content_id in (select content_id from Evict);\n"
+            @"delete from Evict;\n"
+                          withCallback:NULL context:NULL error:NULL];
 
-    return didRemove ? sizeRemoved : 0;
+        [recentlyUsedContent removeAllObjects];
+        totalContentSize -= MIN(bytesFreed, totalContentSize);
+
+#ifdef DEBUG_toon0
+        NSLog(@"Removed %llu bytes of content. %llu total size remaining", bytesFreed, totalContentSize);
+#endif
+    }
+
+    return bytesFreed;
 }
 
 - (unsigned long long int)_totalContentSize;
 {
-    return 0ULL; // TODO: Write a select statement which calculates this size
+    if (!totalContentSizeIsValid) {
+        // Only needed once per open; after that we keep it up to date as content is inserted and deleted.
+        OSLPreparedStatement *selectStatement = [databaseController prepareStatement:@"select sum(size) as size from Content;\n" error:NULL];
+        NSDictionary *row = [selectStatement step];
+        [selectStatement reset];
+        totalContentSize = [[row objectForKey:@"size"] unsignedLongLongValue];
+        totalContentSizeIsValid = YES;
+    }
+    return totalContentSize;
 }
 
 - (void)_reduceCacheSize;
 {
     // guess at about 70% efficiency so only 700,000 content bytes per megabyte of disk cache limit
-    unsigned long long int desiredTotalContentSize = [[NSUserDefaults standardUserDefaults] integerForKey:@"OWDiskCacheLimit"] * 700000ULL;
-    unsigned long long int totalContentSize = [self _totalContentSize];
-    if (totalContentSize < desiredTotalContentSize)
+    NSInteger limit = [[NSUserDefaults standardUserDefaults] integerForKey:OWDiskCacheLimitDefaultsKey];
+    if (limit <= 0)
+        return; // No limit set
+    unsigned long long int desiredTotalContentSize = (unsigned long long int)limit * 700000ULL;
+    if ([self _totalContentSize] < desiredTotalContentSize)
         return;
-    
+
+    [self _deletePendingArcs];
     [self _deleteUnreferencedContent];
-    
-    while (totalContentSize > desiredTotalContentSize) {
-        int removed = [self _deleteOldestContent];
-        if (!removed)
-            break;
-#ifdef DEBUG_toon0
-        NSLog(@"Removed %d byte content. %d total size remaining", removed, totalContentSize);
-#endif
-        [self _deletePendingArcs];
+
+    unsigned long long int lowWaterContentSize = (unsigned long long int)(desiredTotalContentSize * EvictionLowWaterFraction);
+    if (totalContentSize > lowWaterContentSize) {
+        [self _deleteOldestContentFreeingBytes:totalContentSize - lowWaterContentSize];
         [self _deleteUnreferencedContent];
     }
+
+    [compactEvent invokeLater];
 }
 
 - (void)_lockedCancelPreenEvent;
 {
     [preenEvent cancelIfPending];
-    [preenEvent release];
     preenEvent = nil;
 }
 
 - (void)_preenCache;
 {
-    NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
-    
-    [dbLock lock];
+    @autoreleasepool {
+        [dbLock lock];
 
-    NS_DURING {
-        [databaseController beginTransaction];
-        [self _deletePendingArcs];
-        [databaseController commitTransaction];
-        
-        [self _deleteUnreferencedContent];
-    } NS_HANDLER {
+        @try {
+            [databaseController beginTransaction];
+            [self _deletePendingArcs];
+            [databaseController commitTransaction];
+
+            [self _deleteUnreferencedContent];
+        } @catch (NSException *exc) {
 #ifdef DEBUG
-        NSLog(@"-[%@ %s]: %@", [self shortDescription], _cmd, localException);
+            NSLog(@"-[%@ %@]: %@", [self shortDescription], NSStringFromSelector(_cmd), exc);
 #endif
-        [pool release];
+        }
+
         [dbLock unlock];
+    }
+}
+
+- (NSArray *)_bufferedArcsWithRelation:(OWCacheArcRelationship)relation toEntry:(OWContent *)anEntry;
+{
+    NSMutableArray *matches = nil;
+
+    [bufferLock lock];
+    for (OWStaticArc *pendingArc in pendingArcs) {
+        if ([pendingArc relationsOfEntry:anEntry intern:NULL] & relation) {
+            if (matches == nil)
+                matches = [NSMutableArray array];
+            [matches addObject:pendingArc];
+        }
+    }
+    [bufferLock unlock];
+
+    return matches;
+}
+
+// Must be called inside a transaction.
+- (void)_writeAccessTimes;
+{
+    if ([touchedContentIDs count] == 0)
         return;
-    } NS_ENDHANDLER;
-    [pool release];
-    [dbLock unlock];
+
+    OSLPreparedStatement *updateStatement = [databaseController prepareStatement:@"update Content set time = ? where content_id = ?;" error:NULL];
+    time_t now = [self accessTime];
+    for (NSNumber *contentId in touchedContentIDs) {
+        [updateStatement bindLongLongInt:now];
+        [updateStatement bindLongLongInt:[contentId longLongValue]];
+        [updateStatement step];
+        [updateStatement reset];
+    }
+    [touchedContentIDs removeAllObjects];
 }
 
-OFWeakRetainConcreteImplementation_NULL_IMPLEMENTATION
+- (void)_discardWriteBuffer;
+{
+    [flushEvent cancelIfPending];
+
+    [bufferLock lock];
+    [pendingArcs removeAllObjects];
+    [pendingArcInfo removeAllObjects];
+    [pendingContent removeAllObjects];
+    [bufferLock unlock];
+}
+
+// One small step of giving free pages back to the filesystem; reschedules itself until there are none left.
+- (void)_compactStep;
+{
+    BOOL moreToDo = NO;
+
+    @autoreleasepool {
+        [dbLock lock];
+        @try {
+            if (databaseController != nil && compactionState == CompactionUnknown) {
+                // Caches created before we turned on incremental auto-vacuum can't do this. Their free pages still get reused, just not returned.
+                OSLPreparedStatement *modeStatement = [databaseController prepareStatement:@"PRAGMA auto_vacuum;\n" error:NULL];
+                NSDictionary *modeRow = [modeStatement step];
+                [modeStatement reset];
+                compactionState = ([[modeRow objectForKey:@"auto_vacuum"] intValue] == 2) ? CompactionAvailable : CompactionUnavailable;
+            }
+
+            if (databaseController != nil && compactionState == CompactionAvailable) {
+                [databaseController executeSQL:[NSString stringWithFormat:@"PRAGMA incremental_vacuum(%d);\n", CompactionPagesPerStep] withCallback:NULL context:NULL error:NULL];
+
+                OSLPreparedStatement *freelistStatement = [databaseController prepareStatement:@"PRAGMA freelist_count;\n" error:NULL];
+                NSDictionary *freelistRow = [freelistStatement step];
+                [freelistStatement reset];
+                moreToDo = [[freelistRow objectForKey:@"freelist_count"] intValue] > 0;
+            }
+        } @catch (NSException *exc) {
+#ifdef DEBUG
+            NSLog(@"-[%@ %@]: %@", [self shortDescription], NSStringFromSelector(_cmd), exc);
+#endif
+        }
+        [dbLock unlock];
+    }
+
+    if (moreToDo)
+        [compactEvent invokeLater];
+}
 
 @end
@@ -0,0 +1,28 @@
+// Copyright 2003-2026 Omni Development, Inc. All rights reserved.
+//
+// This software may only be used and reproduced according to the
+// terms in the file OmniSourceLicense.html, which should be
+// distributed with this project and can also be found at
+// <http://www.omnigroup.com/developer/sourcecode/sourcelicense/>.
+
+#import "OWDiskCache.h"
+
+// The version of the cache bundle's database layout, stored in its Info.plist. Caches with any other version are not opened, and get replaced by a new one.
+#define OWDiskCache_DBVersion_Key (@"OWDiskCacheVersion")
+#define OWDiskCache_DBVersion (5)
+
+// How each row of the Content table stores its value. These are stored in the database, so don't renumber them.
+enum OWDiskCacheConcreteContentType {
+    OWDiskCacheUnknownConcreteType = 0,
+    OWDiskCacheAddressConcreteType = 1,    // An archived OWAddress
+    OWDiskCacheBytesConcreteType = 2,      // The bytes of an OWDataStream
+    OWDiskCacheExceptionConcreteType = 3,  // An archived NSException
+};
+
+// The size limit comes from this default, in megabytes of disk.
+#define OWDiskCacheLimitDefaultsKey (@"OWDiskCacheLimit")
+
+@interface OWDiskCache (Internal)
+- (unsigned long long int)totalContentSize; // Bytes of content values in the database, not counting anything still in the write buffer
+- (time_t)accessTime; // The time recorded when content is written or read; tests override this rather than waiting for the clock
+@end
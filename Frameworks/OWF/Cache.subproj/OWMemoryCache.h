@@ -7,8 +7,8 @@
 
 #import <OmniFoundation/OFObject.h>
 
-@class /* Foundation */ NSMutableDictionary, NSMutableSet, NSLock;
-@class /* OmniFoundation */ OFMultiValueDictionary, OFScheduledEvent;
+@class /* Foundation */ NSCountedSet, NSMutableArray, NSMutableDictionary, NSMutableSet, NSLock;
+@class /* OmniFoundation */ OFHeap, OFMultiValueDictionary, OFScheduledEvent;
 @class /* OWF */ OWStaticArc;
 
 #import <OWF/OWContentCacheProtocols.h> // For OWCacheArcProvider and OWCacheContentProvider
@@ -19,7 +19,18 @@
 
     // Memory cache is organized by subject.
     NSMutableDictionary *arcsBySubject;
-    NSMutableSet *knownOtherContent;
+    NSCountedSet *knownOtherContent;
+
+    // The same entries, indexed by their source and object content, so that lookups by those relations don't have to scan every row.
+    NSMutableDictionary *arcsBySource;
+    NSMutableDictionary *arcsByObject;
+
+    // Entries ordered by the deadline they were last scheduled to expire at. An entry which has been used since then is rescheduled when it reaches the top, rather than being moved on every use. Purged entries stay until they reach the top, but without their arcs.
+    OFHeap *expiryHeap;
+
+    // Changes since the last sweep: entries which were added or superseded, and rows with entries marked for removal.
+    NSMutableArray *entriesToReview;
+    NSMutableSet *rowsToPurge;
     
     // Cache arcs and content soon get migrated over to the persistent cache (if it exists).
     id <OWCacheArcProvider, OWCacheContentProvider> backingCache;
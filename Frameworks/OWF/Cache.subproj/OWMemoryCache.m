@@ -5,7 +5,7 @@
 // distributed with this project and can also be found at
 // <http://www.omnigroup.com/developer/sourcecode/sourcelicense/>.
 
-#import <OWF/OWMemoryCache.h>
+#import "OWMemoryCacheInternal.h"
 
 #import <Foundation/Foundation.h>
 #import <OmniBase/OmniBase.h>
@@ -21,12 +21,17 @@
 
 RCS_ID("$Id$");
 
+@class OWMemoryCacheEntry;
+
 @interface OWMemoryCache (Private)
 
 - (void)_scanArcsForSubject:(OWContent *)anEntry giving:(NSMutableArray *)arcsOut;
 - (void)_scanArcsFor:(OWContent *)anEntry relation:(OWCacheArcRelationship)aRelation giving:(NSMutableArray *)arcsOut;
 
 - (id)_keyForSubject:(OWContent *)subject;
+- (void)_lockedIndexEntry:(OWMemoryCacheEntry *)entry;
+- (void)_lockedUnindexEntry:(OWMemoryCacheEntry *)entry;
+- (void)_lockedResetIndexes;
 - (void)_scheduleExpireBeforeDate:(NSDate *)deadline;
 - (void)_expire;
 - (void)_flushCache:(NSNotification *)note;
@@ -40,10 +45,12 @@ RCS_ID("$Id$");
 @interface OWMemoryCacheEntry : OFObject
 {
 @public
-    OWStaticArc *arc;
+    OWStaticArc *arc; // Released once the entry is unindexed, which can be well before it leaves the expiry heap
     OWMemoryCacheEntry *next;
+    id rowKey; // The key of the arcsBySubject row this entry is in
     NSTimeInterval lastUsed;
     NSTimeInterval reasonableLifetime;
+    NSTimeInterval scheduledDeadline; // Our position in the expiry heap; only changed while we're out of it
     struct {
         unsigned int hasBeenOfferedToNextCache:1;
         unsigned int superseded:1;
@@ -52,11 +59,11 @@ RCS_ID("$Id$");
     } flags;
 }
 
-- initWithArc:(OWStaticArc *)anArc;
+- initWithArc:(OWStaticArc *)anArc time:(NSTimeInterval)now;
 - (OWStaticArc *)arc;
-- (void)touch;
+- (void)touchAtTime:(NSTimeInterval)now;
 - (void)invalidate;
-- (void)substituteArc:(OWStaticArc *)anArc;
+- (OWMemoryCacheEntry *)substituteArc:(OWStaticArc *)anArc time:(NSTimeInterval)now;
 
 @end
 
@@ -64,14 +71,14 @@ RCS_ID("$Id$");
 
 #define DEFAULT_DEFAULT_LIFETIME_A_DOO_WOP 60
 
-- initWithArc:(OWStaticArc *)anArc;
+- initWithArc:(OWStaticArc *)anArc time:(NSTimeInterval)now;
 {
     if (!(self = [super init]))
         return nil;
 
     arc = anArc;
     next = nil;
-    lastUsed = [NSDate timeIntervalSinceReferenceDate];
+    lastUsed = now;
     reasonableLifetime = DEFAULT_DEFAULT_LIFETIME_A_DOO_WOP;
     flags.hasBeenOfferedToNextCache = NO;
     flags.superseded = NO;
@@ -86,9 +93,9 @@ RCS_ID("$Id$");
     return arc;
 }
 
-- (void)touch;
+- (void)touchAtTime:(NSTimeInterval)now;
 {
-    lastUsed = [NSDate timeIntervalSinceReferenceDate];
+    lastUsed = now;
 }
 
 - (void)invalidate
@@ -102,14 +109,16 @@ RCS_ID("$Id$");
     //NSLog(@"%@: %@", [self shortDescription], m);
 }
 
-- (void)substituteArc:(OWStaticArc *)anArc;
+// Returns the new entry, which the cache needs to index, or nil if there was nothing to substitute.
+- (OWMemoryCacheEntry *)substituteArc:(OWStaticArc *)anArc time:(NSTimeInterval)now;
 {
     OWMemoryCacheEntry *newEntry;
     
     if (anArc == arc)
-        return;
+        return nil;
 
-    newEntry = [[OWMemoryCacheEntry alloc] initWithArc:anArc];
+    newEntry = [[OWMemoryCacheEntry alloc] initWithArc:anArc time:now];
+    newEntry->rowKey = rowKey;
     if (flags.superseded)
         newEntry->flags.superseded = YES;
     if (flags.hasBeenOfferedToNextCache)
@@ -120,6 +129,8 @@ RCS_ID("$Id$");
     next = newEntry;
 
     flags.shouldRemove = YES;
+    
+    return newEntry;
 }
 
 @end
@@ -133,8 +144,7 @@ RCS_ID("$Id$");
         return nil;
 
     lock = [[NSLock alloc] init];
-    arcsBySubject = CFBridgingRelease(CFDictionaryCreateMutable(kCFAllocatorDefault, 0, &OFNSObjectDictionaryKeyCallbacks, &OFNSObjectDictionaryValueCallbacks));
-    knownOtherContent = [[NSMutableSet alloc] init];
+    [self _lockedResetIndexes];
     [OWContentCacheGroup addContentCacheObserver:self];
 
     return self;
@@ -149,7 +159,21 @@ RCS_ID("$Id$");
 
 - (void)setResultCache:(id <OWCacheArcProvider, OWCacheContentProvider>)newBackingCache;
 {
+    [lock lock];
+    
     backingCache = newBackingCache;
+    
+    // The next sweep only looks at entries that have changed, so have it look at everything which hasn't been offered to a backing cache yet.
+    if (backingCache != nil) {
+        for (OWMemoryCacheEntry *rowEntry in [arcsBySubject objectEnumerator]) {
+            for (OWMemoryCacheEntry *entry = rowEntry; entry != nil; entry = entry->next) {
+                if (!entry->flags.hasBeenOfferedToNextCache)
+                    [entriesToReview addObject:entry];
+            }
+        }
+    }
+    
+    [lock unlock];
 }
 
 - (id <OWCacheArcProvider>)resultCache;
@@ -197,7 +221,9 @@ RCS_ID("$Id$");
         [self _scanArcsForSubject:anEntry giving:result];  // Most common case.
 
     if ([result count] > 0) {
-        [result makeObjectsPerformSelector:@selector(touch)];
+        NSTimeInterval now = [self currentTime];
+        for (OWMemoryCacheEntry *entry in result)
+            [entry touchAtTime:now];
         [result replaceObjectsInRange:(NSRange){0, [result count]} byApplyingSelector:@selector(arc)];
     } else {
         result = nil;
@@ -231,16 +257,20 @@ RCS_ID("$Id$");
 
 
     // add arc to list
-    OWMemoryCacheEntry *newEntry = [[OWMemoryCacheEntry alloc] initWithArc:anArc];
+    OWMemoryCacheEntry *newEntry = [[OWMemoryCacheEntry alloc] initWithArc:anArc time:[self currentTime]];
     id cacheRow = [self _keyForSubject:[anArc subject]];
+    newEntry->rowKey = cacheRow;
     OWMemoryCacheEntry *existingEntry = [arcsBySubject objectForKey:cacheRow];
-    NSMutableArray *priorArcs;
+    NSMutableArray *priorArcs, *priorArcObjects; // The entries, and their arcs, which may still be needed after the entries are purged
     if (existingEntry != nil) {
         //... look for possibly duplicate/superseded arcs while walking to the end of the list
         priorArcs = [[NSMutableArray alloc] init];
+        priorArcObjects = [[NSMutableArray alloc] init];
         for (;;) {
-            if (!(existingEntry->flags.shouldRemove) && !(existingEntry->flags.superseded))
+            if (!(existingEntry->flags.shouldRemove) && !(existingEntry->flags.superseded)) {
                 [priorArcs addObject:existingEntry];
+                [priorArcObjects addObject:existingEntry->arc];
+            }
             if (!(existingEntry->next)) {
                 existingEntry->next = newEntry;
                 break;
@@ -250,14 +280,12 @@ RCS_ID("$Id$");
     } else {
         // ... we don't have any entries for this subject yet.
         priorArcs = nil;
+        priorArcObjects = nil;
         CFDictionarySetValue((CFMutableDictionaryRef)arcsBySubject, CFBridgingRetain(cacheRow), CFBridgingRetain(newEntry));
         OBASSERT(newEntry->next == nil);
     }
-    [newEntry touch];
-
-    [knownOtherContent addObject:[anArc object]];
-    if ([anArc source] != nil)
-        [knownOtherContent addObject:[anArc source]];
+    [self _lockedIndexEntry:newEntry];
+    [entriesToReview addObject:newEntry];
 
     [lock unlock];
 
@@ -268,12 +296,13 @@ RCS_ID("$Id$");
         [OWPipeline lock];
 
         for (arcIndex = arcCount; arcIndex > 0; arcIndex --) {
-            OWMemoryCacheEntry *priorArcEntry = [priorArcs objectAtIndex:arcIndex - 1];
-            if (![anArc dominatesArc:[priorArcEntry arc]]) {
+            OWStaticArc *priorArc = [priorArcObjects objectAtIndex:arcIndex - 1];
+            if (![anArc dominatesArc:priorArc]) {
                 [priorArcs removeObjectAtIndex:arcIndex - 1];
+                [priorArcObjects removeObjectAtIndex:arcIndex - 1];
             } else {
 #ifdef DEBUG_wiml
-                NSLog(@"%@ supersedes %@", [anArc shortDescription], [priorArcEntry->arc shortDescription]);
+                NSLog(@"%@ supersedes %@", [anArc shortDescription], [priorArc shortDescription]);
 #endif
             }
         }
@@ -286,10 +315,12 @@ RCS_ID("$Id$");
             [lock lock];
             for (arcIndex = 0; arcIndex < arcCount; arcIndex++)
                 ((OWMemoryCacheEntry *)[priorArcs objectAtIndex:arcIndex])->flags.superseded = YES;
+            [entriesToReview addObjectsFromArray:priorArcs];
             [lock unlock];
         }
     }
     priorArcs = nil;
+    priorArcObjects = nil;
     
     // TODO: adjust expiration according to arc info, destination content type, and all sorts of extremely clever things like that. Hey, maybe lifetime should be an attribute of the arc.
     
@@ -396,6 +427,8 @@ RCS_ID("$Id$");
         if ([invalidationDate compare:[anArc creationDate]] == NSOrderedDescending) {
             scheduleExpiration = YES;
             [cursor invalidate];
+            if (cursor->flags.shouldRemove)
+                [rowsToPurge addObject:cursor->rowKey];
         }
         cursor = cursor->next;
     }
@@ -421,6 +454,8 @@ RCS_ID("$Id$");
         [debugDictionary setObject:arcsBySubject forKey:@"arcsBySubject"];
     if (knownOtherContent != nil)
         [debugDictionary setObject:knownOtherContent forKey:@"knownOtherContent"];
+    if (expiryHeap != nil)
+        [debugDictionary setObject:[NSNumber numberWithUnsignedInteger:[expiryHeap count]] forKey:@"expiryHeapCount"];
     if (backingCache != nil)
         [debugDictionary setObject:OBShortObjectDescription(backingCache) forKey:@"backingCache"];
     if (expireEvent != nil)
@@ -431,6 +466,15 @@ RCS_ID("$Id$");
 
 @end
 
+@implementation OWMemoryCache (Internal)
+
+- (NSTimeInterval)currentTime;
+{
+    return [NSDate timeIntervalSinceReferenceDate];
+}
+
+@end
+
 @implementation OWMemoryCache (Private)
 
 - (void)_scanArcsForSubject:(OWContent *)anEntry giving:(NSMutableArray *)arcsOut
@@ -449,28 +493,31 @@ RCS_ID("$Id$");
 
 - (void)_scanArcsFor:(OWContent *)anEntry relation:(OWCacheArcRelationship)lookForRelationship giving:(NSMutableArray *)matchedArcs
 {
-    NSEnumerator *cacheRowEnumerator;
-    OWMemoryCacheEntry *cacheEntry;
-
     // Must be called with the cache lock held.
 
-    cacheRowEnumerator = [arcsBySubject objectEnumerator];
-    cacheEntry = nil;
-
-    for(;;) {
-        if (cacheEntry != nil)
-            cacheEntry = cacheEntry->next;
-        if (cacheEntry == nil)
-            cacheEntry = [cacheRowEnumerator nextObject];
-        if (cacheEntry == nil)
-            break;
-
-        if (!cacheEntry->flags.shouldRemove) {
-            OWCacheArcRelationship arcMatches = [cacheEntry->arc relationsOfEntry:anEntry intern:NULL];
-            if (arcMatches & lookForRelationship) {
-                [cacheEntry touch];
-                [matchedArcs addObject:cacheEntry];
-            }
+    // Gather the candidates from the row and indexes for each relation we're looking for. An arc can be in more than one of those (its source is often its subject), so only take each once.
+    NSMutableArray *candidates = [[NSMutableArray alloc] init];
+    if (lookForRelationship & OWCacheArcSubject) {
+        for (OWMemoryCacheEntry *cacheEntry = [arcsBySubject objectForKey:[self _keyForSubject:anEntry]]; cacheEntry != nil; cacheEntry = cacheEntry->next)
+            [candidates addObject:cacheEntry];
+    }
+    if (lookForRelationship & OWCacheArcSource)
+        [candidates addObjectsFromArray:[arcsBySource objectForKey:anEntry]];
+    if (lookForRelationship & OWCacheArcObject)
+        [candidates addObjectsFromArray:[arcsByObject objectForKey:anEntry]];
+
+    NSHashTable *matched = [NSHashTable hashTableWithOptions:NSPointerFunctionsObjectPointerPersonality];
+    NSTimeInterval now = [self currentTime];
+    for (OWMemoryCacheEntry *cacheEntry in candidates) {
+        if (cacheEntry->flags.shouldRemove || [matched containsObject:cacheEntry])
+            continue;
+
+        // The row and indexes go by equality of the content (or, for rows, of the resource), so check the actual relation.
+        OWCacheArcRelationship arcMatches = [cacheEntry->arc relationsOfEntry:anEntry intern:NULL];
+        if (arcMatches & lookForRelationship) {
+            [cacheEntry touchAtTime:now];
+            [matched addObject:cacheEntry];
+            [matchedArcs addObject:cacheEntry];
         }
     }
 }
@@ -485,6 +532,84 @@ RCS_ID("$Id$");
         return subject;
 }
 
+static void _addEntryToIndex(NSMutableDictionary *index, OWContent *content, OWMemoryCacheEntry *entry)
+{
+    if (content == nil)
+        return;
+
+    NSMutableArray *entries = [index objectForKey:content];
+    if (entries == nil) {
+        entries = [[NSMutableArray alloc] init];
+        CFDictionarySetValue((CFMutableDictionaryRef)index, (__bridge const void *)content, (__bridge const void *)entries);
+    }
+    [entries addObject:entry];
+}
+
+static void _removeEntryFromIndex(NSMutableDictionary *index, OWContent *content, OWMemoryCacheEntry *entry)
+{
+    if (content == nil)
+        return;
+
+    NSMutableArray *entries = [index objectForKey:content];
+    OBASSERT(entries != nil);
+    [entries removeObjectIdenticalTo:entry];
+    if ([entries count] == 0)
+        [index removeObjectForKey:content];
+}
+
+// Adds a new entry, which must already be linked into its row, to the expiry heap and the other indexes.
+- (void)_lockedIndexEntry:(OWMemoryCacheEntry *)entry;
+{
+    OWStaticArc *arc = entry->arc;
+
+    entry->scheduledDeadline = entry->lastUsed + entry->reasonableLifetime;
+    [expiryHeap addObject:entry];
+
+    _addEntryToIndex(arcsBySource, [arc source], entry);
+    _addEntryToIndex(arcsByObject, [arc object], entry);
+
+    [knownOtherContent addObject:[arc object]];
+    if ([arc source] != nil)
+        [knownOtherContent addObject:[arc source]];
+}
+
+// Called as an entry is unlinked from its row. The heap can't remove an entry from the middle, so the entry stays there until it comes to the top; its arc and row key are released now so that the heap doesn't keep the arc's content alive until then.
+- (void)_lockedUnindexEntry:(OWMemoryCacheEntry *)entry;
+{
+    OWStaticArc *arc = entry->arc;
+    OBPRECONDITION(arc != nil);
+
+    _removeEntryFromIndex(arcsBySource, [arc source], entry);
+    _removeEntryFromIndex(arcsByObject, [arc object], entry);
+
+    [knownOtherContent removeObject:[arc object]];
+    if ([arc source] != nil)
+        [knownOtherContent removeObject:[arc source]];
+
+    entry->arc = nil;
+    entry->rowKey = nil;
+    entry->next = nil;
+}
+
+- (void)_lockedResetIndexes;
+{
+    arcsBySubject = CFBridgingRelease(CFDictionaryCreateMutable(kCFAllocatorDefault, 0, &OFNSObjectDictionaryKeyCallbacks, &OFNSObjectDictionaryValueCallbacks));
+    arcsBySource = CFBridgingRelease(CFDictionaryCreateMutable(kCFAllocatorDefault, 0, &OFNSObjectDictionaryKeyCallbacks, &OFNSObjectDictionaryValueCallbacks));
+    arcsByObject = CFBridgingRelease(CFDictionaryCreateMutable(kCFAllocatorDefault, 0, &OFNSObjectDictionaryKeyCallbacks, &OFNSObjectDictionaryValueCallbacks));
+    knownOtherContent = [[NSCountedSet alloc] init];
+
+    expiryHeap = [[OFHeap alloc] initWithComparator:^NSComparisonResult(OWMemoryCacheEntry *entry1, OWMemoryCacheEntry *entry2) {
+        if (entry1->scheduledDeadline < entry2->scheduledDeadline)
+            return NSOrderedAscending;
+        else if (entry1->scheduledDeadline > entry2->scheduledDeadline)
+            return NSOrderedDescending;
+        else
+            return NSOrderedSame;
+    }];
+    entriesToReview = [[NSMutableArray alloc] init];
+    rowsToPurge = [[NSMutableSet alloc] init];
+}
+
 - (void)_flushCache:(NSNotification *)note
 {
 #ifdef DEBUG_kc0
@@ -524,29 +649,27 @@ RCS_ID("$Id$");
     BOOL anExpire = NO;
     unsigned arcsAccepted = 0;
     NSMutableArray *entriesToOffer = [[NSMutableArray alloc] init];
-    NSMutableSet *shouldPurge = [NSMutableSet set];
-    [knownOtherContent removeAllObjects];
-    NSTimeInterval now = [NSDate timeIntervalSinceReferenceDate];
-
-    NSEnumerator *cacheRowEnumerator = [arcsBySubject keyEnumerator];
-    OWMemoryCacheEntry *entry = nil;
-    id thisRowKey = nil;
-
-    for (;;) {
-        NSTimeInterval timeToLive;
-
-        if (entry != nil)
-            entry = entry->next;
-        if (entry == nil) {
-            thisRowKey = [cacheRowEnumerator nextObject];
-            entry = [arcsBySubject objectForKey:thisRowKey];
-        }
-        if (entry == nil)
-            break;
+    NSMutableArray *arcsToOffer = [[NSMutableArray alloc] init]; // Taken while the lock is held, since the entries can be purged once it is released
+    NSMutableSet *shouldPurge = rowsToPurge;
+    rowsToPurge = [[NSMutableSet alloc] init];
+    NSTimeInterval now = [self currentTime];
+    OWMemoryCacheEntry *entry;
+
+    // Entries that were added or superseded since the last sweep.
+    for (entry in entriesToReview) {
+        // Already purged
+        if (entry->arc == nil)
+            continue;
 
         // Ignore entries that have already been marked for deletion
         if (entry->flags.shouldRemove) {
-            [shouldPurge addObject:thisRowKey];
+            [shouldPurge addObject:entry->rowKey];
+            continue;
+        }
+
+        if (entry->flags.superseded && !entry->flags.hasValidator) {
+            entry->flags.shouldRemove = YES;
+            [shouldPurge addObject:entry->rowKey];
             continue;
         }
 
@@ -554,33 +677,48 @@ RCS_ID("$Id$");
         if (backingCache != nil && !(entry->flags.hasBeenOfferedToNextCache) && !(entry->flags.superseded)) {
             entry->flags.hasBeenOfferedToNextCache = YES;
             [entriesToOffer addObject:entry];
+            [arcsToOffer addObject:entry->arc];
+        }
+    }
+    [entriesToReview removeAllObjects];
+
+    // Arcs that haven't been used in a while. Anything used since it was scheduled goes back in at its new deadline.
+    while ((entry = [expiryHeap peekObject]) != nil && entry->scheduledDeadline <= now) {
+        [expiryHeap removeObject];
+
+        // Purged since it was scheduled; this was the last reference to it.
+        if (entry->arc == nil)
+            continue;
+
+        if (entry->flags.shouldRemove) {
+            [shouldPurge addObject:entry->rowKey];
+            continue;
         }
 
-        // Arcs that haven't been used in a while.
-        timeToLive = entry->reasonableLifetime - (now - entry->lastUsed);
-        if (timeToLive < 0 || (entry->flags.superseded && !entry->flags.hasValidator)) {
+        NSTimeInterval deadline = entry->lastUsed + entry->reasonableLifetime;
+        if (deadline > now) {
+            entry->scheduledDeadline = deadline;
+            [expiryHeap addObject:entry];
+        } else {
             // I've ... seen things you ... people wouldn't believe. (etc, etc) Time... to die.  *flappity flappity flappity*
-            // ?
             entry->flags.shouldRemove = YES;
-            [shouldPurge addObject:thisRowKey];
-        } else {
-            nextExpire = MIN(nextExpire, timeToLive);
-            anExpire = YES;
+            [shouldPurge addObject:entry->rowKey];
         }
+    }
 
-        if (!entry->flags.shouldRemove) {
-            [knownOtherContent addObject:[entry->arc object]];
-            [knownOtherContent addObject:[entry->arc source]];
-        }            
+    if ((entry = [expiryHeap peekObject]) != nil) {
+        nextExpire = MIN(nextExpire, entry->scheduledDeadline - now);
+        anExpire = YES;
     }
 
     [lock unlock];
 
     [OWPipeline lock];
     for (unsigned arcIndex = 0; arcIndex < [entriesToOffer count]; arcIndex ++) {
-        BOOL storable = [backingCache canStoreArc:[[entriesToOffer objectAtIndex:arcIndex] arc]];
+        BOOL storable = [backingCache canStoreArc:[arcsToOffer objectAtIndex:arcIndex]];
         if (!storable) {
             [entriesToOffer removeObjectAtIndex:arcIndex];
+            [arcsToOffer removeObjectAtIndex:arcIndex];
             arcIndex --;
         }
     }
@@ -589,17 +727,22 @@ RCS_ID("$Id$");
     NS_DURING {
         // Without camping on the cache lock, offer any cacheable arcs to the next cache.
         for (unsigned arcIndex = 0; arcIndex < [entriesToOffer count]; arcIndex ++) {
-            OWStaticArc *storedArc;
+            OWStaticArc *offeredArc, *storedArc;
 
             entry = [entriesToOffer objectAtIndex:arcIndex];
-            storedArc = (OWStaticArc *)[backingCache addArc:entry->arc];
+            offeredArc = [arcsToOffer objectAtIndex:arcIndex];
+            storedArc = (OWStaticArc *)[backingCache addArc:offeredArc];
             if (storedArc != nil) {
                 arcsAccepted++;
 
-                if (storedArc != entry->arc && [storedArc isKindOfClass:[OWStaticArc class]]) {
+                if (storedArc != offeredArc && [storedArc isKindOfClass:[OWStaticArc class]]) {
                     [lock lock];
-                    [shouldPurge addObject:[entry->arc subject]];
-                    [entry substituteArc:storedArc];
+                    if (entry->arc != nil) {
+                        [shouldPurge addObject:entry->rowKey];
+                        OWMemoryCacheEntry *newEntry = [entry substituteArc:storedArc time:now];
+                        if (newEntry != nil)
+                            [self _lockedIndexEntry:newEntry];
+                    }
                     [lock unlock];
                 }
             }
@@ -655,9 +798,11 @@ RCS_ID("$Id$");
 
             if (cursor->flags.shouldRemove) {
                 entriesRemoved++;
+                OWMemoryCacheEntry *removedEntry = cursor;
+                cursor = cursor->next;
+                [self _lockedUnindexEntry:removedEntry];
                 
                 if (lastEntry == nil) {
-                    cursor = cursor->next;
                     if (cursor == nil) {
                         rowsEmptied++;
                         [arcsBySubject removeObjectForKey:purgeRow];
@@ -665,9 +810,8 @@ RCS_ID("$Id$");
                         CFDictionarySetValue((CFMutableDictionaryRef)arcsBySubject, CFBridgingRetain(purgeRow), CFBridgingRetain(cursor));
                     }
                 } else {
-                    OBASSERT(lastEntry->next == cursor);
-                    lastEntry->next = cursor->next;
-                    cursor = lastEntry->next;
+                    OBASSERT(lastEntry->next == removedEntry);
+                    lastEntry->next = cursor;
                 }
             } else {
                 lastEntry = cursor;
@@ -703,14 +847,19 @@ RCS_ID("$Id$");
 
     // Clear out our instance variables inside the lock, but don't actually release their contents yet
     NSMutableDictionary *retainedArcsBySubject = arcsBySubject;
-    NSMutableSet *retainedKnownOtherContent = knownOtherContent;
-    arcsBySubject = CFBridgingRelease(CFDictionaryCreateMutable(kCFAllocatorDefault, 0, &OFNSObjectDictionaryKeyCallbacks, &OFNSObjectDictionaryValueCallbacks));
-    knownOtherContent = [[NSMutableSet alloc] init];
+    NSMutableDictionary *retainedArcsBySource = arcsBySource;
+    NSMutableDictionary *retainedArcsByObject = arcsByObject;
+    NSCountedSet *retainedKnownOtherContent = knownOtherContent;
+    OFHeap *retainedExpiryHeap = expiryHeap;
+    [self _lockedResetIndexes];
     [lock unlock];
 
     // OK, now release those former instance variables
     retainedArcsBySubject = nil;
+    retainedArcsBySource = nil;
+    retainedArcsByObject = nil;
     retainedKnownOtherContent = nil;
+    retainedExpiryHeap = nil;
 }
 
 - (void)_invalidateAllArcs;
@@ -0,0 +1,12 @@
+// Copyright 2026 Omni Development, Inc. All rights reserved.
+//
+// This software may only be used and reproduced according to the
+// terms in the file OmniSourceLicense.html, which should be
+// distributed with this project and can also be found at
+// <http://www.omnigroup.com/developer/sourcecode/sourcelicense/>.
+
+#import <OWF/OWMemoryCache.h>
+
+@interface OWMemoryCache (Internal)
+- (NSTimeInterval)currentTime; // When entries are used and expired; tests override this rather than waiting for the clock
+@end
@@ -22,6 +22,7 @@ typedef struct _OWDataStreamBufferDescriptor {
     size_t bufferSize;
     volatile size_t bufferUsed;
     struct _OWDataStreamBufferDescriptor * volatile next;
+    BOOL isMapped;          // buffer is a mapping of the stream's temporary file rather than allocated memory
 } OWDataStreamBufferDescriptor;
 
 enum OWStringEncodingProvenance {
@@ -43,6 +44,8 @@ enum OWStringEncodingProvenance {
     pthread_cond_t lengthChangedCondition;
     
     OWDataStreamBufferDescriptor *_first, *_last;
+    struct _OWDataStreamBlockIndex * volatile blockIndex;  // start offset of each block, for finding the block containing an offset without walking the list
+    volatile NSUInteger blockIndexCount;
     NSUInteger dataLength;      // total number of bytes in stream, if EOF reached or if known ahead of time
     NSUInteger readLength;      // total number of bytes written to stream (available for reading) so far
 
@@ -64,6 +67,10 @@ enum OWStringEncodingProvenance {
     
     unsigned int savedInBuffer;
     OWDataStreamBufferDescriptor *savedBuffer;
+
+    NSUInteger mappedFileThreshold;
+    int mappedFileDescriptor;
+    off_t mappedFileLength;
 }
 
 - init;
@@ -82,6 +89,9 @@ enum OWStringEncodingProvenance {
 - (void)wroteBytesToUnderlyingBuffer:(NSUInteger)count;    
     // Tell the data stream how many bytes you actually wrote
 
+- (void)setMappedFileThreshold:(NSUInteger)byteCount;
+    // Once this many bytes have been written, new blocks are mapped from an unlinked temporary file instead of being allocated, so that the kernel can page a very large stream out to its own file rather than to swap. Defaults to the OWDataStreamMappedFileThreshold user default; 0 turns mapping off. Call this before writing to the stream.
+
 - (NSData *)bufferedData;
 - (NSUInteger)bufferedDataLength;
 
@@ -41,7 +41,20 @@ static size_t DataBufferBlockSize;
 #define BUFFER_OOL_THRESHOLD      ( 4096 - sizeof(OWDataStreamBufferDescriptor) )    // fits on one VM page
 #define BUFFER_MAXIMUM_SEGMENT_SIZE   ( 16 * 1024 * 1024 )                           // small compared to total VM address space; large compared to most data streams
 
+// The block index is only ever appended to, by the writer. When it grows, the old array is kept (linked from the new one) until the stream is deallocated, since a reader on another thread may still be searching it; the arrays double in size, so this at most doubles the index's footprint.
+typedef struct {
+    NSUInteger offset;
+    OWDataStreamBufferDescriptor *descriptor;
+} OWDataStreamBlockIndexEntry;
+
+struct _OWDataStreamBlockIndex {
+    struct _OWDataStreamBlockIndex *previous;
+    NSUInteger capacity;
+    OWDataStreamBlockIndexEntry entries[];
+};
+
 static OWContentType *unencodedContentEncoding;
+static NSUInteger DefaultMappedFileThreshold;
 
 + (void)initialize;
 {
@@ -49,6 +62,7 @@ static OWContentType *unencodedContentEncoding;
 
     unencodedContentEncoding = [OWContentType contentTypeForString:@"encoding/identity"];
     DataBufferBlockSize = 4 * NSPageSize();
+    DefaultMappedFileThreshold = [[NSUserDefaults standardUserDefaults] integerForKey:@"OWDataStreamMappedFileThreshold"];
 }
 
 static inline void _raiseNoLongerValidException()
@@ -64,24 +78,30 @@ static inline void _raiseIfInvalid(OWDataStream *self)
 
 static inline OWDataStreamBufferDescriptor *descriptorForBlockContainingOffset(OWDataStream *self, NSUInteger offset, NSUInteger *offsetWithinBlock)
 {
-    OWDataStreamBufferDescriptor *cursor;
-    NSUInteger cursorOffset = 0;
-
     _raiseIfInvalid(self);
-    cursor = self->_first;
-    while (cursor != NULL) {
-        OWDataStreamBufferDescriptor cursorBlock = *cursor;
-        
-        if (cursorOffset <= offset && (cursorOffset + cursorBlock.bufferUsed) > offset) {
-            *offsetWithinBlock = ( offset - cursorOffset );
-            return cursor;
-        }
-        
-        cursor = cursorBlock.next;
-        cursorOffset += cursorBlock.bufferUsed;
+
+    // Load the count before the index: whichever index we then see has at least that many entries filled in.
+    NSUInteger count = __atomic_load_n(&self->blockIndexCount, __ATOMIC_ACQUIRE);
+    if (count == 0)
+        return NULL;
+    const struct _OWDataStreamBlockIndex *index = __atomic_load_n(&self->blockIndex, __ATOMIC_ACQUIRE);
+
+    // Find the last block starting at or before the offset
+    NSUInteger low = 0, high = count;
+    while (high - low > 1) {
+        NSUInteger middle = low + (high - low) / 2;
+        if (index->entries[middle].offset <= offset)
+            low = middle;
+        else
+            high = middle;
     }
-    
-    return NULL;
+
+    OWDataStreamBlockIndexEntry entry = index->entries[low];
+    if (entry.offset > offset || offset - entry.offset >= entry.descriptor->bufferUsed)
+        return NULL;
+
+    *offsetWithinBlock = offset - entry.offset;
+    return entry.descriptor;
 }
 
 static inline BOOL copyBuffersOut(OWDataStreamBufferDescriptor *dsBuffer, NSUInteger offsetIntoBlock, void *outBuffer, NSUInteger length)
@@ -103,27 +123,90 @@ static inline BOOL copyBuffersOut(OWDataStreamBufferDescriptor *dsBuffer, NSUInt
     return YES;
 }
 
+// Only called from the writing thread.
+static void addBlockToIndex(OWDataStream *self, OWDataStreamBufferDescriptor *descriptor, NSUInteger offset)
+{
+    struct _OWDataStreamBlockIndex *index = self->blockIndex;
+    NSUInteger count = self->blockIndexCount;
+
+    if (index == NULL || count == index->capacity) {
+        NSUInteger capacity = index ? 2 * index->capacity : 16;
+        struct _OWDataStreamBlockIndex *newIndex = malloc(sizeof(*newIndex) + capacity * sizeof(newIndex->entries[0]));
+        newIndex->previous = index;
+        newIndex->capacity = capacity;
+        if (count != 0)
+            memcpy(newIndex->entries, index->entries, count * sizeof(newIndex->entries[0]));
+        __atomic_store_n(&self->blockIndex, newIndex, __ATOMIC_RELEASE);
+        index = newIndex;
+    }
+
+    index->entries[count] = (OWDataStreamBlockIndexEntry){ .offset = offset, .descriptor = descriptor };
+    __atomic_store_n(&self->blockIndexCount, count + 1, __ATOMIC_RELEASE);
+}
+
+// Maps another byteCount bytes of the stream's temporary file, creating the file if need be. Returns NULL (and stops mapping for this stream) if that fails, so the caller can fall back to allocating memory.
+static void *allocateMappedPages(OWDataStream *self, size_t byteCount)
+{
+    if (self->mappedFileDescriptor < 0) {
+        NSString *template = [NSTemporaryDirectory() stringByAppendingPathComponent:@"OWDataStream.XXXXXX"];
+        char *path = strdup([template fileSystemRepresentation]);
+        int fd = mkstemp(path);
+        if (fd >= 0)
+            unlink(path); // Nobody else needs to see it, and this way it goes away with the stream (or the process)
+        free(path);
+        
+        if (fd < 0) {
+            NSLog(@"OWDataStream: unable to create a temporary file to hold stream data: %s", strerror(OMNI_ERRNO()));
+            self->mappedFileThreshold = 0;
+            return NULL;
+        }
+        self->mappedFileDescriptor = fd;
+    }
+
+    off_t offset = self->mappedFileLength;
+    void *pages = MAP_FAILED;
+    if (ftruncate(self->mappedFileDescriptor, offset + byteCount) == 0)
+        pages = mmap(NULL, byteCount, PROT_READ | PROT_WRITE, MAP_SHARED, self->mappedFileDescriptor, offset);
+    if (pages == MAP_FAILED) {
+        NSLog(@"OWDataStream: unable to map %lu bytes of stream data: %s", (unsigned long)byteCount, strerror(OMNI_ERRNO()));
+        self->mappedFileThreshold = 0;
+        return NULL;
+    }
+
+    self->mappedFileLength = offset + byteCount;
+    return pages;
+}
+
 // Allocates another buffer and links it into self's list of buffers. bytesToAllocate is merely a hint; the allocated buffer may be larger or smaller than this for various reasons. In particular:
 // Buffers may be rounded up to a multiple of the VM page size.
 // Individual buffers have a maximum size (BUFFER_MAXIMUM_SEGMENT_SIZE). This has two benefits:
 //    1. We are less sensitive to address-space fragmentation, which is a real problem for users which are in the habit of downloading gigabyte disk images, etc.
 //    2. If we are streaming to disk (hasIssuedCursor=0, hasThrownAwayData=1, saveFileHandle!=nil) then this allows us to deallocate individual buffers that are no longer needed, rather than forcing the system to swap them out an incidentally tickling a bug in 10.2.x's virtual-memory system. 
+// Once the stream passes its mappedFileThreshold, large buffers are mapped from a temporary file (see allocateMappedPages()), and are always full-sized segments when the length of the stream isn't known, since each one costs a mapping.
 static void allocateAnotherBuffer(OWDataStream *self, size_t bytesToAllocate)
 {
     OWDataStreamBufferDescriptor *newBuffer;
+    NSUInteger startOffset = self->readLength; // Every earlier buffer is full
 
     // Create a new buffer descriptor & allocate its data. If the buffer to be allocated is less than BUFFER_OOL_THRESHOLD, we allocate it inline using malloc; if it is larger, we use a large out-of-line buffer to avoid page thrashing while traversing the descriptor list.
 
     if (bytesToAllocate < BUFFER_OOL_THRESHOLD) {
         newBuffer = malloc(sizeof(*newBuffer) + bytesToAllocate);
         newBuffer->buffer = (void *)( newBuffer + 1 );
+        newBuffer->isMapped = NO;
     } else {
+        BOOL shouldMap = (self->mappedFileThreshold != 0 && startOffset >= self->mappedFileThreshold);
+        if (shouldMap && self->dataLength == OWDataStreamUnknownLength)
+            bytesToAllocate = BUFFER_MAXIMUM_SEGMENT_SIZE;
         bytesToAllocate = ROUNDED_ALLOCATION_SIZE(bytesToAllocate);
         if (bytesToAllocate > BUFFER_MAXIMUM_SEGMENT_SIZE)
             bytesToAllocate = BUFFER_MAXIMUM_SEGMENT_SIZE;
         newBuffer = malloc(sizeof(*newBuffer));
         OBASSERT(bytesToAllocate >= BUFFER_OOL_THRESHOLD);
-        newBuffer->buffer = NSAllocateMemoryPages(bytesToAllocate);
+        newBuffer->buffer = shouldMap ? allocateMappedPages(self, bytesToAllocate) : NULL;
+        newBuffer->isMapped = (newBuffer->buffer != NULL);
+        if (!newBuffer->isMapped)
+            newBuffer->buffer = NSAllocateMemoryPages(bytesToAllocate);
     }
     newBuffer->bufferSize = bytesToAllocate;
     newBuffer->bufferUsed = 0;
@@ -138,6 +221,7 @@ static void allocateAnotherBuffer(OWDataStream *self, size_t bytesToAllocate)
         OBASSERT(!self->_first);
         self->_first = self->_last = newBuffer;
     }
+    addBlockToIndex(self, newBuffer, startOffset);
     
     OBPOSTCONDITION(self->_last != NULL);
     OBPOSTCONDITION(self->_last->bufferUsed < self->_last->bufferSize);
@@ -148,7 +232,10 @@ static void deallocateBuffer(OWDataStreamBufferDescriptor *oldBuffer)
     if (oldBuffer->bufferSize < BUFFER_OOL_THRESHOLD)
         free(oldBuffer);
     else {
-        NSDeallocateMemoryPages(oldBuffer->buffer, oldBuffer->bufferSize);
+        if (oldBuffer->isMapped)
+            munmap(oldBuffer->buffer, oldBuffer->bufferSize);
+        else
+            NSDeallocateMemoryPages(oldBuffer->buffer, oldBuffer->bufferSize);
         free(oldBuffer);
     }
 }
@@ -174,6 +261,9 @@ static void deallocateBuffer(OWDataStreamBufferDescriptor *oldBuffer)
     
     saveFilename = nil;
     saveFileHandle = nil;
+
+    mappedFileThreshold = DefaultMappedFileThreshold;
+    mappedFileDescriptor = -1;
     
     if (dataLength != OWDataStreamUnknownLength && dataLength != 0)
         allocateAnotherBuffer(self, dataLength);
@@ -207,6 +297,15 @@ static void deallocateBuffer(OWDataStreamBufferDescriptor *oldBuffer)
     }
     _first = _last = NULL;
 
+    struct _OWDataStreamBlockIndex *index, *previousIndex;
+    for (index = blockIndex; index != NULL; index = previousIndex) {
+        previousIndex = index->previous;
+        free(index);
+    }
+
+    if (mappedFileDescriptor >= 0)
+        close(mappedFileDescriptor);
+
     pthread_cond_destroy(&lengthChangedCondition);
     pthread_mutex_destroy(&lengthMutex);
 }
@@ -512,6 +611,12 @@ static void deallocateBuffer(OWDataStreamBufferDescriptor *oldBuffer)
         [self flushContentsToFile];
 }
 
+- (void)setMappedFileThreshold:(NSUInteger)byteCount;
+{
+    OBPRECONDITION(readLength == 0);
+    mappedFileThreshold = byteCount;
+}
+
 - (BOOL)pipeToFilename:(NSString *)aFilename contentType:(OWContentType *)myType shouldPreservePartialFile:(BOOL)shouldPreserve;
 {
     NSMutableDictionary *someAttributes;
@@ -8,9 +8,11 @@
 #import <OWF/OWCursor.h>
 
 @class NSArray, NSData;
+@class OFByteSet;
 @class OWContentType, OWDataStream;
 
 #import <OmniFoundation/OFByte.h>
+#import <OmniFoundation/OFByteSearch.h>
 #import <OmniFoundation/OFBundleRegistryTarget.h>
 
 typedef long OFByteOrder;
@@ -22,6 +24,8 @@ typedef long OFByteOrder;
     NSUInteger dataOffset;
     OFByte partialByte;
     unsigned int bitsLeft;
+
+    OFByteSearchTable byteSetSearchTable; // For the last byte set we were asked to scan for
 }
 
 + (OWDataStreamCursor *)cursorToRemoveEncoding:(OWContentType *)coding fromCursor:(OWDataStreamCursor *)aCursor;
@@ -90,6 +94,8 @@ typedef long OFByteOrder;
 
 - (NSUInteger)scanUpToByte:(OFByte)byteMatch; // Positions the offset _before_ the byte. Returns the number of bytes skipped. If not found, positions the offset at EOF and raises underflow exception.
 - (NSData *)readUpToByte:(OFByte)byteMatch; // Returns all data up to but not including the byte. If not found, reads to EOF and returns the bytes read.
+- (NSUInteger)scanUpToByteInSet:(OFByteSet *)byteSet; // As -scanUpToByte:, stopping at any byte in the set.
+- (NSData *)readUpToByteInSet:(OFByteSet *)byteSet; // As -readUpToByte:, stopping at any byte in the set.
 
 - (OWDataStream *)underlyingDataStream;
 
@@ -353,9 +353,19 @@ PEEK_DATA_OF_TYPE(double, Double);
     bitsLeft = 0;
 }
 
-- (NSUInteger)scanUpToByte:(OFByte)byteMatch
+- (NSUInteger)readUnderlyingBuffer:(void **)returnedBufferPtr;
+{
+    NSUInteger count = [self peekUnderlyingBuffer:returnedBufferPtr];
+    dataOffset += count;
+    return count;
+}
+
+// 'search' returns the offset of the first match in the buffer it is given, or the buffer's length if there is none.
+typedef size_t (^OWDataStreamCursorSearch)(const void *bytes, size_t length);
+
+static NSUInteger _scanUpToMatch(OWDataStreamCursor *self, NS_NOESCAPE OWDataStreamCursorSearch search)
 {
-    NSUInteger scanOffset = dataOffset;
+    NSUInteger scanOffset = self->dataOffset;
 
     while (![self isAtEOF]) {
         void *fetch;
@@ -364,11 +374,11 @@ PEEK_DATA_OF_TYPE(double, Double);
         if (bufferSize == 0)
             continue;
 
-        void *found = memchr(fetch, byteMatch, bufferSize);
-        if (found) {
+        size_t found = search(fetch, bufferSize);
+        if (found < bufferSize) {
             // rewind to just before the byte we found
-            [self seekToOffset: ( found - fetch ) - bufferSize fromPosition:OWCursorSeekFromCurrent];
-            return dataOffset - scanOffset;
+            [self seekToOffset:(NSInteger)found - (NSInteger)bufferSize fromPosition:OWCursorSeekFromCurrent];
+            return self->dataOffset - scanOffset;
         }
     }
 
@@ -378,14 +388,7 @@ PEEK_DATA_OF_TYPE(double, Double);
     return 0;
 }
 
-- (NSUInteger)readUnderlyingBuffer:(void **)returnedBufferPtr;
-{
-    NSUInteger count = [self peekUnderlyingBuffer:returnedBufferPtr];
-    dataOffset += count;
-    return count;
-}
-
-- (NSData *)readUpToByte:(OFByte)byteMatch
+static NSData *_readUpToMatch(OWDataStreamCursor *self, NS_NOESCAPE OWDataStreamCursorSearch search)
 {
     if ([self isAtEOF])
         return [NSData data];
@@ -393,11 +396,11 @@ PEEK_DATA_OF_TYPE(double, Double);
     void *fetch;
     NSUInteger bufferSize = [self readUnderlyingBuffer:&fetch];
 
-    void *found = memchr(fetch, byteMatch, bufferSize);
-    if (found) {
+    size_t found = search(fetch, bufferSize);
+    if (found < bufferSize) {
         // rewind to just before the byte we found
-        [self seekToOffset: ( found - fetch ) - bufferSize fromPosition:OWCursorSeekFromCurrent];
-        return [NSData dataWithBytes:fetch length: (found - fetch)];
+        [self seekToOffset:(NSInteger)found - (NSInteger)bufferSize fromPosition:OWCursorSeekFromCurrent];
+        return [NSData dataWithBytes:fetch length:found];
     }
 
     NSMutableData *accumulator = [[NSMutableData alloc] initWithBytes:fetch length:bufferSize];
@@ -408,11 +411,11 @@ PEEK_DATA_OF_TYPE(double, Double);
         if (bufferSize == 0)
             continue;
 
-        found = memchr(fetch, byteMatch, bufferSize);
-        if (found) {
+        found = search(fetch, bufferSize);
+        if (found < bufferSize) {
             // rewind to just before the byte we found
-            [self seekToOffset: ( found - fetch ) - bufferSize fromPosition:OWCursorSeekFromCurrent];
-            [accumulator appendBytes:fetch length: (found - fetch)];
+            [self seekToOffset:(NSInteger)found - (NSInteger)bufferSize fromPosition:OWCursorSeekFromCurrent];
+            [accumulator appendBytes:fetch length:found];
             return accumulator;
         } else {
             [accumulator appendBytes:fetch length:bufferSize];
@@ -423,6 +426,38 @@ PEEK_DATA_OF_TYPE(double, Double);
     return accumulator;
 }
 
+- (NSUInteger)scanUpToByte:(OFByte)byteMatch
+{
+    return _scanUpToMatch(self, ^size_t(const void *bytes, size_t length) {
+        return OFByteSearchForByte(bytes, length, byteMatch);
+    });
+}
+
+- (NSData *)readUpToByte:(OFByte)byteMatch
+{
+    return _readUpToMatch(self, ^size_t(const void *bytes, size_t length) {
+        return OFByteSearchForByte(bytes, length, byteMatch);
+    });
+}
+
+- (NSUInteger)scanUpToByteInSet:(OFByteSet *)byteSet;
+{
+    OFByteSearchTable *table = &byteSetSearchTable;
+    OFByteSearchTableUpdate(table, byteSet);
+    return _scanUpToMatch(self, ^size_t(const void *bytes, size_t length) {
+        return OFByteSearchForByteInSet(bytes, length, table);
+    });
+}
+
+- (NSData *)readUpToByteInSet:(OFByteSet *)byteSet;
+{
+    OFByteSearchTable *table = &byteSetSearchTable;
+    OFByteSearchTableUpdate(table, byteSet);
+    return _readUpToMatch(self, ^size_t(const void *bytes, size_t length) {
+        return OFByteSearchForByteInSet(bytes, length, table);
+    });
+}
+
 // OWCursor subclass
 
 - (NSUInteger)seekToOffset:(NSInteger)offset fromPosition:(OWCursorSeekPosition)position;
@@ -21,7 +21,6 @@
     NSUInteger hash;
     NSMutableArray *links;
     NSMutableSet *reverseLinks;
-    NSMutableDictionary *bestPathByType;
     NSArray *extensions;
     OSType hfsType, hfsCreator;
     NSTimeInterval expirationTimeInterval;
@@ -86,7 +85,7 @@
 // Links
 - (void)linkToContentType:(OWContentType *)targetContentType usingProcessorDescription:(OWProcessorDescription *)aProcessorDescription cost:(float)aCost;
 - (OWConversionPathElement *)bestPathForTargetContentType:(OWContentType *)targetType;
-    // Returns the lowest total cost path from the receiving content type to the specified target content type, or nil if there is no possible path.
+    // Returns the lowest total cost path from the receiving content type to the specified target content type, or nil if there is no possible path. Paths come from a precomputed table, so this doesn't take any locks unless links have been registered since the table was built.
 - (NSArray *)directTargetContentTypes;
     // Returns an array of OWContentTypeLinks, not OWContentTypes as the name might suggest.
 - (NSSet *)directSourceContentTypes;
@@ -106,8 +106,16 @@ typedef struct {
 + (void)registerFlagsDictionary:(NSDictionary *)iconsDictionary;
 - _initWithContentTypeString:(NSString *)aString;
 - (void)_addReverseContentType:(OWContentType *)sourceContentType;
-- (void)_locked_flushConversionPaths;
-- (OWConversionPathElement *)_locked_computeBestPathForType:(OWContentType *)targetType visitedTypes:(NSMutableSet *)visitedTypes recursionLevel:(unsigned int)recursionLevel;
++ (void)_rebuildRoutingTable;
+@end
+
+/*
+ The lowest-cost conversion path between every pair of content types, computed all at once from the registered links. A table is never modified once built, so -bestPathForTargetContentType: can read the current one without taking contentTypeLock.
+ */
+@interface OWContentTypeRoutingTable : NSObject
+- (instancetype)initWithContentTypes:(NSArray *)contentTypes generation:(NSUInteger)generation;
+@property (nonatomic, readonly) NSUInteger generation; // The linkGeneration it was built from
+- (OWConversionPathElement *)pathFromType:(OWContentType *)sourceType toType:(OWContentType *)targetType;
 @end
 
 @implementation OWContentType
@@ -132,6 +140,11 @@ static OWContentType *errorContentType;
 static OWContentType *nothingContentType;
 static NSTimeInterval defaultExpirationTimeInterval = 0.0;
 
+// Registering a link bumps linkGeneration (under contentTypeLock). Lookups use routingTable, without the lock, as long as it was built from the current generation; otherwise the first one to notice builds a new table and swaps it in. Replaced tables are released a minute later, since another thread may still be reading one.
+static NSUInteger linkGeneration = 0;
+static void *routingTable = NULL; // OWContentTypeRoutingTable, retained
+static BOOL routingTableRebuildScheduled = NO;
+
 // This is a hack.
 static NSString *privateSupertypes[] = {
     @"documenttitle", @"omniaddress", @"objectstream", @"omni", @"owftpdirectory", @"owdatastream", @"timestamp", @"url", @"gopher", nil
@@ -616,32 +629,47 @@ got_path:
         }
     }
 
-    // We could probably figure out an algorithm to flush the minimum number of paths, but this is safer and this shouldn't happen very often (if at all) since content links are registered at startup.
-    {
-        NSEnumerator *typeEnum;
-        OWContentType *type;
-        
-        typeEnum = [contentTypeDictionary objectEnumerator];
-        while ((type = [typeEnum nextObject]))
-            [type _locked_flushConversionPaths];
-    }
-
     link = [[OWContentTypeLink alloc] initWithProcessorDescription:aProcessorDescription sourceContentType:self targetContentType:targetContentType cost:aCost];
     [links addObject:link];
     [targetContentType _addReverseContentType:self];
+
+    // Links are mostly registered in a burst at startup, so rather than rebuilding the routing table for each one, rebuild it once things have been quiet for a moment. A lookup before then will rebuild it itself.
+    __atomic_store_n(&linkGeneration, linkGeneration + 1, __ATOMIC_RELEASE);
+    if (!routingTableRebuildScheduled) {
+        routingTableRebuildScheduled = YES;
+        [[OFScheduler dedicatedThreadScheduler] scheduleSelector:@selector(_rebuildRoutingTable) onObject:[OWContentType class] afterTime:0.25];
+    }
     
     [contentTypeLock unlock];
 }
 
+static OWContentTypeRoutingTable *_locked_currentRoutingTable(void)
+{
+    OWContentTypeRoutingTable *table = (__bridge OWContentTypeRoutingTable *)routingTable;
+    if (table != nil && table.generation == linkGeneration)
+        return table;
+
+    // Aliases put some types in the dictionary more than once.
+    NSArray *contentTypes = [[NSSet setWithArray:[contentTypeDictionary allValues]] allObjects];
+    OWContentTypeRoutingTable *newTable = [[OWContentTypeRoutingTable alloc] initWithContentTypes:contentTypes generation:linkGeneration];
+    __atomic_store_n(&routingTable, (__bridge_retained void *)newTable, __ATOMIC_RELEASE);
+
+    if (table != nil)
+        [[OFScheduler mainScheduler] scheduleSelector:@selector(self) onObject:CFBridgingRelease((__bridge CFTypeRef)table) withObject:nil afterTime:60.0];
+
+    return newTable;
+}
+
 - (OWConversionPathElement *)bestPathForTargetContentType: (OWContentType *) targetType;
 {
-    [contentTypeLock lock];
-    OWConversionPathElement *path = [self _locked_computeBestPathForType:targetType visitedTypes:nil recursionLevel:0];
-    if (path == nil)
-        [bestPathByType setObject:[NSNull null] forKey:targetType];
-    [contentTypeLock unlock];
+    OWContentTypeRoutingTable *table = (__bridge OWContentTypeRoutingTable *)__atomic_load_n(&routingTable, __ATOMIC_ACQUIRE);
+    if (table == nil || table.generation != __atomic_load_n(&linkGeneration, __ATOMIC_ACQUIRE)) {
+        [contentTypeLock lock];
+        table = _locked_currentRoutingTable();
+        [contentTypeLock unlock];
+    }
 
-    return path;
+    return [table pathFromType:self toType:targetType];
 }
 
 - (NSArray *)directTargetContentTypes;
@@ -1016,89 +1044,169 @@ got_path:
     [reverseLinks addObject:sourceContentType];
 }
 
-- (void)_locked_flushConversionPaths;
++ (void)_rebuildRoutingTable;
 {
-    bestPathByType = nil;
+    [contentTypeLock lock];
+    routingTableRebuildScheduled = NO;
+    _locked_currentRoutingTable();
+    [contentTypeLock unlock];
 }
 
-- (OWConversionPathElement *)_locked_computeBestPathForType:(OWContentType *)targetType visitedTypes:(NSMutableSet *)visitedTypes recursionLevel:(unsigned int)recursionLevel;
+@end
+
+#pragma mark -
+
+typedef struct {
+    float cost;
+    NSUInteger typeIndex;
+} OWRoutingQueueEntry;
+
+static void _routingQueuePush(OWRoutingQueueEntry *queue, NSUInteger *count, OWRoutingQueueEntry entry)
 {
-    float cost, bestCost = FLT_MAX;
-    OWContentTypeLink *bestLink;
-    OWConversionPathElement *bestPath;
+    NSUInteger entryIndex = (*count)++;
+    while (entryIndex > 0) {
+        NSUInteger parentIndex = (entryIndex - 1) / 2;
+        if (queue[parentIndex].cost <= entry.cost)
+            break;
+        queue[entryIndex] = queue[parentIndex];
+        entryIndex = parentIndex;
+    }
+    queue[entryIndex] = entry;
+}
 
-    // Check for a cached result (positive or negative)
-    bestPath = [bestPathByType objectForKey:targetType];
-    if (bestPath) {
-        if ((id)bestPath == [NSNull null])
-            return nil;
-        else
-            return bestPath;
+static OWRoutingQueueEntry _routingQueuePop(OWRoutingQueueEntry *queue, NSUInteger *count)
+{
+    OWRoutingQueueEntry top = queue[0];
+    OWRoutingQueueEntry last = queue[--(*count)];
+    NSUInteger entryIndex = 0;
+    while (YES) {
+        NSUInteger childIndex = 2 * entryIndex + 1;
+        if (childIndex >= *count)
+            break;
+        if (childIndex + 1 < *count && queue[childIndex + 1].cost < queue[childIndex].cost)
+            childIndex++;
+        if (last.cost <= queue[childIndex].cost)
+            break;
+        queue[entryIndex] = queue[childIndex];
+        entryIndex = childIndex;
     }
-    
-    // No cached result, if we are at the top of the recursion, allocate a visited set
-#ifdef DEBUG_PATHS
-    NSLog(@"%@Compute best path: checking %@ -> %@", [NSString spacesOfLength:4 * recursionLevel], [self contentTypeString], [targetType contentTypeString]);
-#endif
+    queue[entryIndex] = last;
+    return top;
+}
 
-    if (!visitedTypes)
-        visitedTypes = [NSMutableSet set];
-    else if ([visitedTypes member:self]) {
-        // Detect and eliminate loops
-#ifdef DEBUG_PATHS
-        NSLog(@"%@Short-circuit: visited types contains %@", [NSString spacesOfLength:4 * recursionLevel], [self contentTypeString], [targetType contentTypeString]);
-#endif
+@implementation OWContentTypeRoutingTable
+{
+    NSDictionary *_pathsByTargetType; // target type -> source type -> OWConversionPathElement
+}
+
+// Runs Dijkstra's algorithm backwards from each type that something can be converted to, following links from their targets to their sources. Each type's path then starts with the link that reached it, continuing with the path from that link's target, so paths to the same target share their tails.
+- (instancetype)initWithContentTypes:(NSArray *)contentTypes generation:(NSUInteger)generation;
+{
+    if (!(self = [super init]))
         return nil;
+
+    _generation = generation;
+
+    NSUInteger typeCount = [contentTypes count];
+    NSMutableDictionary *indexByType = [[NSMutableDictionary alloc] initWithCapacity:typeCount];
+    NSMutableArray *incomingLinksByTypeIndex = [[NSMutableArray alloc] initWithCapacity:typeCount];
+    for (NSUInteger typeIndex = 0; typeIndex < typeCount; typeIndex++) {
+        [indexByType setObject:[NSNumber numberWithUnsignedInteger:typeIndex] forKey:[contentTypes objectAtIndex:typeIndex]];
+        [incomingLinksByTypeIndex addObject:[NSMutableArray array]];
     }
-    [visitedTypes addObject:self];
 
-    // Lazily allocate this dictionary to store cached results
-    if (!bestPathByType)
-        bestPathByType = [[NSMutableDictionary alloc] init];
+    NSUInteger linkCount = 0;
+    for (OWContentType *type in contentTypes) {
+        for (OWContentTypeLink *link in [type directTargetContentTypes]) {
+            NSNumber *targetIndex = [indexByType objectForKey:[link targetContentType]];
+            if (targetIndex == nil)
+                continue;
+            OBASSERT([link cost] >= 0.0f); // Dijkstra's algorithm needs this
+            [[incomingLinksByTypeIndex objectAtIndex:[targetIndex unsignedIntegerValue]] addObject:link];
+            linkCount++;
+        }
+    }
 
+    float *costs = malloc(typeCount * sizeof(*costs));
+    NSUInteger *settledTypeIndexes = malloc(typeCount * sizeof(*settledTypeIndexes));
+    __unsafe_unretained OWContentTypeLink **firstLinks = (__unsafe_unretained OWContentTypeLink **)calloc(typeCount, sizeof(*firstLinks));
+    OWRoutingQueueEntry *queue = malloc((linkCount + 1) * sizeof(*queue)); // Each link is pushed at most once per search
+    NSMutableDictionary *pathsByTargetType = [[NSMutableDictionary alloc] init];
+
+    for (NSUInteger targetIndex = 0; targetIndex < typeCount; targetIndex++) {
+        if ([[incomingLinksByTypeIndex objectAtIndex:targetIndex] count] == 0)
+            continue; // Nothing converts to this type
+
+        OWContentType *targetType = [contentTypes objectAtIndex:targetIndex];
+        for (NSUInteger typeIndex = 0; typeIndex < typeCount; typeIndex++)
+            costs[typeIndex] = FLT_MAX;
+
+        NSUInteger queueCount = 0, settledCount = 0;
+        costs[targetIndex] = 0.0f;
+        _routingQueuePush(queue, &queueCount, (OWRoutingQueueEntry){.cost = 0.0f, .typeIndex = targetIndex});
+        while (queueCount > 0) {
+            OWRoutingQueueEntry entry = _routingQueuePop(queue, &queueCount);
+            if (entry.cost > costs[entry.typeIndex])
+                continue; // We've since found a cheaper way from this type
+            settledTypeIndexes[settledCount++] = entry.typeIndex;
+
+            for (OWContentTypeLink *link in [incomingLinksByTypeIndex objectAtIndex:entry.typeIndex]) {
+                NSUInteger sourceIndex = [[indexByType objectForKey:[link sourceContentType]] unsignedIntegerValue];
+                float cost = entry.cost + [link cost];
+                if (cost < costs[sourceIndex]) {
+                    costs[sourceIndex] = cost;
+                    firstLinks[sourceIndex] = link;
+                    _routingQueuePush(queue, &queueCount, (OWRoutingQueueEntry){.cost = cost, .typeIndex = sourceIndex});
+                }
+            }
+        }
 
-    bestLink = nil;
-    bestPath = nil;
-    bestCost = FLT_MAX;
-    
-    for (OWContentTypeLink *link in links) {
-        OWContentType *type = [link targetContentType];
-        
-        OWConversionPathElement *path;
-        if (type == targetType) {
-            // direct link
-            path = nil;
-            cost = [link cost];
-        } else {
-            path = [type _locked_computeBestPathForType:targetType visitedTypes:visitedTypes recursionLevel:recursionLevel + 1];
-            if (path) {
-                // indirect link through this type
-                cost = [link cost] + [path totalCost];
-            } else {
-                // no link at all
+        // Types settle in order of increasing cost, so the path a type's path continues with has already been made. (The first to settle is the target itself.)
+        NSMutableDictionary *pathsBySourceType = [[NSMutableDictionary alloc] initWithCapacity:settledCount];
+        for (NSUInteger settledIndex = 1; settledIndex < settledCount; settledIndex++) {
+            NSUInteger sourceIndex = settledTypeIndexes[settledIndex];
+            OWContentTypeLink *link = firstLinks[sourceIndex];
+            OWContentType *nextType = [link targetContentType];
+            OWConversionPathElement *nextElement = (nextType == targetType) ? nil : [pathsBySourceType objectForKey:nextType];
+            [pathsBySourceType setObject:[OWConversionPathElement elementLink:link nextElement:nextElement] forKey:[contentTypes objectAtIndex:sourceIndex]];
+        }
+
+        // The path from a type to itself is the cheapest cycle back to it, if there is one.
+        OWContentTypeLink *bestLink = nil;
+        float bestCost = FLT_MAX;
+        for (OWContentTypeLink *link in [targetType directTargetContentTypes]) {
+            OWContentType *nextType = [link targetContentType];
+            NSNumber *nextIndex = [indexByType objectForKey:nextType];
+            if (nextIndex == nil || costs[[nextIndex unsignedIntegerValue]] == FLT_MAX)
                 continue;
+            float cost = [link cost] + ((nextType == targetType) ? 0.0f : costs[[nextIndex unsignedIntegerValue]]);
+            if (cost < bestCost) {
+                bestCost = cost;
+                bestLink = link;
             }
         }
-        if (cost < bestCost) {
-            bestCost = cost;
-            bestLink = link;
-            bestPath = path; // might be nil in a direct link
+        if (bestLink != nil) {
+            OWContentType *nextType = [bestLink targetContentType];
+            OWConversionPathElement *nextElement = (nextType == targetType) ? nil : [pathsBySourceType objectForKey:nextType];
+            [pathsBySourceType setObject:[OWConversionPathElement elementLink:bestLink nextElement:nextElement] forKey:targetType];
         }
-    }
-    
-    if (bestLink) {
-        bestPath = [OWConversionPathElement elementLink:bestLink nextElement:bestPath];
-        [bestPathByType setObject:bestPath forKey:targetType];
+
+        [pathsByTargetType setObject:[pathsBySourceType copy] forKey:targetType];
     }
 
-#ifdef DEBUG_PATHS
-    if (bestLink)
-        NSLog(@"%@Calculated best path from %@ -> %@: %@ (%1.1f) creates %@", [NSString spacesOfLength:4 * recursionLevel], [self contentTypeString], [targetType contentTypeString], [bestLink processorClassName], bestCost, [[bestLink targetContentType] contentTypeString]);
-    else
-        NSLog(@"%@No path from %@ -> %@", [NSString spacesOfLength:4 * recursionLevel], [self contentTypeString], [targetType contentTypeString]);
-#endif
+    free(costs);
+    free(settledTypeIndexes);
+    free(firstLinks);
+    free(queue);
 
-    return bestPath;
+    _pathsByTargetType = [pathsByTargetType copy];
+
+    return self;
+}
+
+- (OWConversionPathElement *)pathFromType:(OWContentType *)sourceType toType:(OWContentType *)targetType;
+{
+    return [[_pathsByTargetType objectForKey:targetType] objectForKey:sourceType];
 }
 
 @end
@@ -13,7 +13,6 @@
 {
     unsigned char *delimiter;
     NSUInteger delimiterLength, inputBufferSize;
-    NSUInteger delimiterSkipTable[256];
 }
 
 // This method is overridden by concrete subclasses
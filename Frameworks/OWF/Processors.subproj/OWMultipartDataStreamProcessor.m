@@ -59,12 +59,6 @@ static NSString *PartFormatString = nil;
     if (inputBufferSize % delimiterLength != 0)
 	inputBufferSize += delimiterLength - inputBufferSize % delimiterLength;
 
-    unsigned int characterIndex, delimiterIndex;
-    for (characterIndex = 0; characterIndex < 256; characterIndex++)
-	delimiterSkipTable[characterIndex] = delimiterLength;
-    for (delimiterIndex = 0; delimiterIndex < delimiterLength; delimiterIndex++)
-	delimiterSkipTable[delimiter[delimiterIndex]] = delimiterLength - delimiterIndex - 1;
-
     return YES;
 }
 
@@ -72,36 +66,24 @@ static NSString *PartFormatString = nil;
 {
     BOOL foundDelimiter = NO;
     unsigned char inputBuffer[inputBufferSize];
-    unsigned char *currentCharacter;
-    NSUInteger charactersRead, charactersToSkip, charactersToWrite;
+    NSUInteger charactersRead, charactersToWrite;
     NSUInteger lastDelimiterCharacter = delimiterLength - 1;
 
     do {
 	[dataCursor bufferBytes:delimiterLength];
 	charactersRead = [dataCursor readMaximumBytes:inputBufferSize intoBuffer:inputBuffer];
-// OmniLog(@"Read %d characters", charactersRead);
-	currentCharacter = inputBuffer + lastDelimiterCharacter;
-	while (currentCharacter < inputBuffer + charactersRead) {
-	    charactersToSkip = delimiterSkipTable[*currentCharacter];
-// OmniLog(@"currentCharacter = '%c', skipping %d", *currentCharacter, charactersToSkip);
-	    if (charactersToSkip == 0) {
-// OmniLog(@"strcmp('%s','%s')", currentCharacter - lastDelimiterCharacter, delimiter);
-		if (strncmp((char *)currentCharacter - lastDelimiterCharacter, (char *)delimiter, delimiterLength) == 0) {
-		    foundDelimiter = YES;
-// OmniLog(@"Found delimiter!");
-		    break;
-		} else {
-		    charactersToSkip = 1;
-		}
-	    }
-	    currentCharacter += charactersToSkip;
-	}
-	charactersToWrite = currentCharacter - lastDelimiterCharacter - inputBuffer;
-// OmniLog(@"Writing %d characters, skipping %d", charactersToWrite, charactersToWrite - charactersRead);
+        size_t delimiterOffset = OFByteSearchForBytes(inputBuffer, charactersRead, delimiter, delimiterLength);
+        if (delimiterOffset < charactersRead) {
+            foundDelimiter = YES;
+            charactersToWrite = delimiterOffset;
+        } else {
+            // The last few characters could be the start of a delimiter, so look at them again along with the next buffer.
+            charactersToWrite = charactersRead > lastDelimiterCharacter ? charactersRead - lastDelimiterCharacter : 0;
+        }
 	[outputDataStream writeData:
 	 [NSData dataWithBytes:inputBuffer length:charactersToWrite]];
-	if (charactersToWrite - charactersRead != 0)
-	    [dataCursor seekToOffset:charactersToWrite - charactersRead fromPosition:OWCursorSeekFromCurrent];
+	if (charactersToWrite != charactersRead)
+	    [dataCursor seekToOffset:(NSInteger)charactersToWrite - (NSInteger)charactersRead fromPosition:OWCursorSeekFromCurrent];
     } while (!foundDelimiter);
     [dataCursor skipBytes:delimiterLength];
     [dataCursor scanUpToByte:'\n'];
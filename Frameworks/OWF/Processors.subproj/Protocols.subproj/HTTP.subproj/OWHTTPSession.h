@@ -37,6 +37,7 @@
     } flags;
     unsigned int failedRequests;
     unsigned int requestsSentThisConnection;
+    NSMutableArray *requestSendTimes;     // When each request in processorQueue was sent, oldest first, for the queue's time-to-first-byte metric
 
     // holdover from an interrupted fetch
     OWDataStream *interruptedDataStream;
@@ -381,6 +381,7 @@ static NSComparisonResult acceptEncodingHeaderOrdering(id a, id b, void *ctxt)
     proxyLocation = [proxyURL parsedNetLocation];
     processorQueue = [[NSMutableArray alloc] initWithCapacity:[queue maximumNumberOfRequestsToPipeline]];
     processorQueueLock = [[NSLock alloc] init];
+    requestSendTimes = [[NSMutableArray alloc] init];
     flags.pipeliningRequests = NO;
     failedRequests = 0;
 
@@ -551,6 +552,7 @@ static NSComparisonResult acceptEncodingHeaderOrdering(id a, id b, void *ctxt)
     OBASSERT(!socketStream);
     socketStream = [[ONSocketStream alloc] initWithSocket:socket];
     [socket connectToHost:host port:port ? [port intValue] : [[self class] defaultPort]];
+    [queue sessionDidConnect:self];
 
     [self setStatusFormat:NSLocalizedStringFromTableInBundle(@"Contacted %@", @"OWF", myBundle, @"session status"), [proxyLocation shortDisplayString]];
     if (OWHTTPDebug)
@@ -563,6 +565,7 @@ static NSComparisonResult acceptEncodingHeaderOrdering(id a, id b, void *ctxt)
     [processorQueueLock lock];
     NSArray *processorQueueSnapshot = processorQueue;
     processorQueue = [[NSMutableArray alloc] initWithCapacity:[queue maximumNumberOfRequestsToPipeline]];
+    [requestSendTimes removeAllObjects];
     [processorQueueLock unlock];
 
     // Requeue all the processors in the snapshot
@@ -586,11 +589,23 @@ static NSComparisonResult acceptEncodingHeaderOrdering(id a, id b, void *ctxt)
     interruptedDataStream = [aProcessor dataStream];
 
     @try {
+        // Wait for the first line of the response, so the queue can see how long the server took to start answering
+        NSString *firstLine = [socketStream peekLine];
+        [processorQueueLock lock];
+        NSNumber *sendTime = [requestSendTimes firstObject];
+        if (sendTime != nil)
+            [requestSendTimes removeObjectAtIndex:0];
+        [processorQueueLock unlock];
+        if (firstLine != nil && sendTime != nil)
+            [queue session:self didBeginResponseAfterTimeInterval:CFAbsoluteTimeGetCurrent() - [sendTime doubleValue]];
+
         if ([[fetchAddress methodString] isEqualToString:@"HEAD"])
             finishedProcessing = [self readHeadForProcessor:aProcessor];
         else
             finishedProcessing = [self readResponseForProcessor:aProcessor];
         failedRequests = 0;
+        if (flags.pipeliningRequests)
+            [queue sessionDidCompletePipelinedResponse:self];
     } @catch (NSException *localException) {
 #ifdef DEBUG
         NSLog(@"%@(%@): Caught exception: name='%@', posixErrorNumber=%d, reason='%@'", [fetchAddress addressString], OBShortObjectDescription(self), [localException name], [localException posixErrorNumber], [localException reason]);
@@ -602,13 +617,9 @@ static NSComparisonResult acceptEncodingHeaderOrdering(id a, id b, void *ctxt)
             if (flags.pipeliningRequests) {
                 // This HTTP 1.1 connection was reset by the server
                 if ([interruptedDataStream bufferedDataLength] < 1024) {
-                    failedRequests++;
-                    if (failedRequests > 0) {
-                        // We've been dropped by this server without getting much data:  let's try a traditional HTTP/1.0 connection instead.
-                        // NSLog(@"%@: Switching to HTTP/1.0", OBShortObjectDescription(self));
-                        [queue setServerCannotHandlePipelinedRequestsReliably];
-                        failedRequests = 0;
-                    }
+                    // We've been dropped by this server without getting much data:  back off to a shallower pipeline, and eventually to a traditional HTTP/1.0 connection.
+                    [queue sessionDidFailPipelinedRequests:self];
+                    failedRequests = 0;
                 } else {
                     // Well, we got _some_ data...
                     failedRequests = 0;
@@ -928,6 +939,11 @@ static NSComparisonResult acceptEncodingHeaderOrdering(id a, id b, void *ctxt)
                 [aProcessor flagResult:OWProcessorContentNoDiskCache];
             
             requestsSentThisConnection++;
+            [processorQueueLock lock];
+            [requestSendTimes addObject:[NSNumber numberWithDouble:CFAbsoluteTimeGetCurrent()]];
+            NSUInteger outstandingRequestCount = [processorQueue count] - newRequestCount + newRequestIndex + 1;
+            [processorQueueLock unlock];
+            [queue session:self didSendRequestAtPipelineDepth:outstandingRequestCount];
         }
     }
 
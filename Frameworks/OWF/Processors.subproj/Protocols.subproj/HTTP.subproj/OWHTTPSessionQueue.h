@@ -9,11 +9,13 @@
 
 @class OWAddress;
 @class NSMutableArray;
+@class NSDictionary;
 @class NSMutableSet;
 @class NSLock;
 @class OWHTTPProcessor;
 @class OWHTTPSession;
-@class OFDatedMutableDictionary;
+
+#define OWHTTPSessionQueuePipelineDepthHistogramSize (16) // The last bucket counts everything at least that deep
 
 @interface OWHTTPSessionQueue : OFObject
 {
@@ -27,13 +29,25 @@
         unsigned int serverUnderstandsPipelinedRequests:1;
         unsigned int serverCannotHandlePipelinedRequestsReliably:1;
     } flags;
+
+    // Pipelining depth, which grows by one after a full pipeline's worth of responses and halves when a pipelined connection is dropped
+    NSUInteger pipelineDepth;
+    NSUInteger responsesAtPipelineDepth;
+
+    // Metrics, guarded by lock
+    NSUInteger connectionCount;
+    NSUInteger requestCount;
+    NSUInteger pipelineDepthCounts[OWHTTPSessionQueuePipelineDepthHistogramSize];
+    NSUInteger responseCount;
+    NSTimeInterval totalTimeToFirstByte;
+    NSTimeInterval maximumTimeToFirstByte;
 }
 
 + (OWHTTPSessionQueue *)httpSessionQueueForAddress:(OWAddress *)anAddress;
 + (NSString *)cacheKeyForSessionQueueForAddress:(OWAddress *)anAddress;
 + (Class)sessionClass;
-+ (OFDatedMutableDictionary *)cache;
 + (NSUInteger)maximumSessionsPerServer;
++ (NSUInteger)maximumPipelineDepth;
 
 - initWithAddress:(OWAddress *)anAddress;
 - (BOOL)queueProcessor:(OWHTTPProcessor *)aProcessor;
@@ -54,5 +68,24 @@
 - (BOOL)serverCannotHandlePipelinedRequestsReliably;
 - (BOOL)shouldPipelineRequests;
 - (NSUInteger)maximumNumberOfRequestsToPipeline;
+    // The current pipelining depth, between 1 and +maximumPipelineDepth
+
+// Reported by sessions
+- (void)sessionDidCompletePipelinedResponse:(OWHTTPSession *)session;
+- (void)sessionDidFailPipelinedRequests:(OWHTTPSession *)session;
+- (void)sessionDidConnect:(OWHTTPSession *)session;
+- (void)session:(OWHTTPSession *)session didSendRequestAtPipelineDepth:(NSUInteger)depth;
+- (void)session:(OWHTTPSession *)session didBeginResponseAfterTimeInterval:(NSTimeInterval)timeToFirstByte;
+
+- (NSDictionary *)metrics;
+    // A snapshot of this queue's counters, under the keys below
 
 @end
+
+extern NSString * const OWHTTPSessionQueueConnectionCountMetric; // NSNumber
+extern NSString * const OWHTTPSessionQueueRequestCountMetric; // NSNumber
+extern NSString * const OWHTTPSessionQueueRequestsPerConnectionMetric; // NSNumber, a double
+extern NSString * const OWHTTPSessionQueuePipelineDepthMetric; // NSNumber, the current depth
+extern NSString * const OWHTTPSessionQueuePipelineDepthHistogramMetric; // NSArray of NSNumber; element N is the number of requests sent with N + 1 outstanding
+extern NSString * const OWHTTPSessionQueueMeanTimeToFirstByteMetric; // NSNumber, seconds
+extern NSString * const OWHTTPSessionQueueMaximumTimeToFirstByteMetric; // NSNumber, seconds
@@ -22,17 +22,38 @@ RCS_ID("$Id$")
 
 @interface OWHTTPSessionQueue (Private)
 + (void)_contentCacheFlushedNotification:(NSNotification *)notification;
-+ (void)_lockedCleanSessionQueuesOlderThanTimeoutExcludingQueue:(OWHTTPSessionQueue *)excludedQueue;
-+ (void)_lockedFlushSessionQueuesOlderThanDate:(NSDate *)aDate excludingQueue:(OWHTTPSessionQueue *)excludedQueue;
++ (void)_lockedCleanSessionQueuesInStripe:(NSUInteger)stripeIndex olderThanTimeoutExcludingQueue:(OWHTTPSessionQueue *)excludedQueue;
++ (void)_lockedFlushSessionQueuesInStripe:(NSUInteger)stripeIndex olderThanDate:(NSDate *)aDate excludingQueue:(OWHTTPSessionQueue *)excludedQueue;
 - (NSArray *)_queuedProcessorsSnapshot;
 @end
 
 @implementation OWHTTPSessionQueue
 
-static OFDatedMutableDictionary *queues;
-static NSLock *queueLock;
+NSString * const OWHTTPSessionQueueConnectionCountMetric = @"connectionCount";
+NSString * const OWHTTPSessionQueueRequestCountMetric = @"requestCount";
+NSString * const OWHTTPSessionQueueRequestsPerConnectionMetric = @"requestsPerConnection";
+NSString * const OWHTTPSessionQueuePipelineDepthMetric = @"pipelineDepth";
+NSString * const OWHTTPSessionQueuePipelineDepthHistogramMetric = @"pipelineDepthHistogram";
+NSString * const OWHTTPSessionQueueMeanTimeToFirstByteMetric = @"meanTimeToFirstByte";
+NSString * const OWHTTPSessionQueueMaximumTimeToFirstByteMetric = @"maximumTimeToFirstByte";
+
+// Every page load looks up a queue for each of its hosts, so rather than one lock around one dictionary, the queues are spread over several, each with its own lock, by a hash of the key. Queues for subclasses (HTTPS) live in the same tables, under keys prefixed with their class name.
+#define SessionQueueStripeCount (16)
+static OFDatedMutableDictionary *queueStripes[SessionQueueStripeCount];
+static NSLock *queueStripeLocks[SessionQueueStripeCount];
+static NSDate *queueStripeLastCleanDates[SessionQueueStripeCount];
 static NSTimeInterval sessionTimeout;
 
+static NSString *_stripeKey(Class cls, NSString *cacheKey)
+{
+    return [NSString stringWithFormat:@"%@ %@", NSStringFromClass(cls), cacheKey];
+}
+
+static NSUInteger _stripeIndex(NSString *stripeKey)
+{
+    return [stripeKey hash] % SessionQueueStripeCount;
+}
+
 + (void)initialize;
 {
     static BOOL initialized = NO;
@@ -48,8 +69,10 @@ static NSTimeInterval sessionTimeout;
     initialized = YES;
 
     sessionTimeout = [[NSUserDefaults standardUserDefaults] floatForKey:@"OWHTTPSessionTimeout"];
-    queues = [[OFDatedMutableDictionary alloc] init];
-    queueLock = [[NSLock alloc] init];
+    for (NSUInteger stripeIndex = 0; stripeIndex < SessionQueueStripeCount; stripeIndex++) {
+        queueStripes[stripeIndex] = [[OFDatedMutableDictionary alloc] init];
+        queueStripeLocks[stripeIndex] = [[NSLock alloc] init];
+    }
 }
 
 + (OWHTTPSessionQueue *)httpSessionQueueForAddress:(OWAddress *)anAddress;
@@ -57,21 +80,23 @@ static NSTimeInterval sessionTimeout;
     OWHTTPSessionQueue *queue;
 
     @autoreleasepool {
-        OFDatedMutableDictionary *cache = [self cache];
         NSString *cacheKey = [self cacheKeyForSessionQueueForAddress:anAddress];
         OBASSERT(cacheKey != nil);
+        NSString *stripeKey = _stripeKey(self, cacheKey);
+        NSUInteger stripeIndex = _stripeIndex(stripeKey);
+        OFDatedMutableDictionary *stripe = queueStripes[stripeIndex];
         
-        [queueLock lock];
+        [queueStripeLocks[stripeIndex] lock];
         
         // Lookup the queue for this address, creating if neccesary
-        queue = [cache objectForKey:cacheKey];
+        queue = [stripe objectForKey:stripeKey];
         if (queue == nil) {
             queue = [[self alloc] initWithAddress:anAddress];
-            [cache setObject:queue forKey:cacheKey];
+            [stripe setObject:queue forKey:stripeKey];
         }
-        [self _lockedCleanSessionQueuesOlderThanTimeoutExcludingQueue:queue];
+        [self _lockedCleanSessionQueuesInStripe:stripeIndex olderThanTimeoutExcludingQueue:queue];
         
-        [queueLock unlock];
+        [queueStripeLocks[stripeIndex] unlock];
     }
 
     return queue;
@@ -90,15 +115,14 @@ static NSTimeInterval sessionTimeout;
     return [OWHTTPSession class];
 }
 
-+ (OFDatedMutableDictionary *)cache;
++ (NSUInteger)maximumSessionsPerServer;
 {
-    // This is subclassed by the HTTPS plug-in which has its own cache
-    return queues;
+    return [[NSUserDefaults standardUserDefaults] integerForKey:@"OWHTTPMaximumSessionsPerServer"];
 }
 
-+ (NSUInteger)maximumSessionsPerServer;
++ (NSUInteger)maximumPipelineDepth;
 {
-    return [[NSUserDefaults standardUserDefaults] integerForKey:@"OWHTTPMaximumSessionsPerServer"];
+    return MAX(1, [[NSUserDefaults standardUserDefaults] integerForKey:@"OWHTTPMaximumNumberOfRequestsToPipeline"]);
 }
 
 
@@ -115,6 +139,8 @@ static NSTimeInterval sessionTimeout;
     lock = [[NSLock alloc] init];
     flags.serverUnderstandsPipelinedRequests = NO;
     flags.serverCannotHandlePipelinedRequestsReliably = NO;
+    pipelineDepth = MIN(2U, [[self class] maximumPipelineDepth]);
+    responsesAtPipelineDepth = 0;
 
     return self;
 }
@@ -268,7 +294,80 @@ static NSTimeInterval sessionTimeout;
 
 - (NSUInteger)maximumNumberOfRequestsToPipeline;
 {
-    return [[NSUserDefaults standardUserDefaults] integerForKey:@"OWHTTPMaximumNumberOfRequestsToPipeline"];
+    // Not under lock: -runSession creates sessions (which ask this) while holding it, and a slightly stale depth is harmless.
+    return MIN(__atomic_load_n(&pipelineDepth, __ATOMIC_RELAXED), [[self class] maximumPipelineDepth]);
+}
+
+- (void)sessionDidCompletePipelinedResponse:(OWHTTPSession *)session;
+{
+    [lock lock];
+    if (++responsesAtPipelineDepth >= pipelineDepth && pipelineDepth < [[self class] maximumPipelineDepth]) {
+        // A full pipeline's worth of responses came back in order; try one more.
+        __atomic_store_n(&pipelineDepth, pipelineDepth + 1, __ATOMIC_RELAXED);
+        responsesAtPipelineDepth = 0;
+    }
+    [lock unlock];
+}
+
+- (void)sessionDidFailPipelinedRequests:(OWHTTPSession *)session;
+{
+    BOOL giveUp;
+
+    [lock lock];
+    giveUp = (pipelineDepth <= 1);
+    __atomic_store_n(&pipelineDepth, MAX(1U, pipelineDepth / 2), __ATOMIC_RELAXED);
+    responsesAtPipelineDepth = 0;
+    [lock unlock];
+
+    // We've been dropped even without pipelining anything: let's try a traditional HTTP/1.0 connection instead.
+    if (giveUp)
+        [self setServerCannotHandlePipelinedRequestsReliably];
+}
+
+- (void)sessionDidConnect:(OWHTTPSession *)session;
+{
+    [lock lock];
+    connectionCount++;
+    [lock unlock];
+}
+
+- (void)session:(OWHTTPSession *)session didSendRequestAtPipelineDepth:(NSUInteger)depth;
+{
+    OBPRECONDITION(depth > 0);
+
+    [lock lock];
+    requestCount++;
+    pipelineDepthCounts[MIN(MAX(depth, 1U), OWHTTPSessionQueuePipelineDepthHistogramSize) - 1]++;
+    [lock unlock];
+}
+
+- (void)session:(OWHTTPSession *)session didBeginResponseAfterTimeInterval:(NSTimeInterval)timeToFirstByte;
+{
+    [lock lock];
+    responseCount++;
+    totalTimeToFirstByte += timeToFirstByte;
+    maximumTimeToFirstByte = MAX(maximumTimeToFirstByte, timeToFirstByte);
+    [lock unlock];
+}
+
+- (NSDictionary *)metrics;
+{
+    NSMutableDictionary *metrics = [NSMutableDictionary dictionary];
+    NSMutableArray *histogram = [NSMutableArray arrayWithCapacity:OWHTTPSessionQueuePipelineDepthHistogramSize];
+
+    [lock lock];
+    [metrics setObject:[NSNumber numberWithUnsignedInteger:connectionCount] forKey:OWHTTPSessionQueueConnectionCountMetric];
+    [metrics setObject:[NSNumber numberWithUnsignedInteger:requestCount] forKey:OWHTTPSessionQueueRequestCountMetric];
+    [metrics setObject:[NSNumber numberWithDouble:connectionCount ? (double)requestCount / connectionCount : 0.0] forKey:OWHTTPSessionQueueRequestsPerConnectionMetric];
+    [metrics setObject:[NSNumber numberWithUnsignedInteger:pipelineDepth] forKey:OWHTTPSessionQueuePipelineDepthMetric];
+    for (NSUInteger depthIndex = 0; depthIndex < OWHTTPSessionQueuePipelineDepthHistogramSize; depthIndex++)
+        [histogram addObject:[NSNumber numberWithUnsignedInteger:pipelineDepthCounts[depthIndex]]];
+    [metrics setObject:[NSNumber numberWithDouble:responseCount ? totalTimeToFirstByte / responseCount : 0.0] forKey:OWHTTPSessionQueueMeanTimeToFirstByteMetric];
+    [metrics setObject:[NSNumber numberWithDouble:maximumTimeToFirstByte] forKey:OWHTTPSessionQueueMaximumTimeToFirstByteMetric];
+    [lock unlock];
+
+    [metrics setObject:histogram forKey:OWHTTPSessionQueuePipelineDepthHistogramMetric];
+    return metrics;
 }
 
 @end
@@ -277,41 +376,44 @@ static NSTimeInterval sessionTimeout;
 
 + (void)_contentCacheFlushedNotification:(NSNotification *)notification;
 {
-    // When the content cache is flushed, flush all cached HTTP sessions
-    [queueLock lock];
-    NS_DURING {
-        [self _lockedFlushSessionQueuesOlderThanDate:nil excludingQueue:nil];
-    } NS_HANDLER {
-        NSLog(@"+[%@ %@]: caught exception %@", NSStringFromClass(self), NSStringFromSelector(_cmd), localException);
-    } NS_ENDHANDLER;
-    [queueLock unlock];
+    // When the content cache is flushed, flush all cached HTTP sessions (HTTPS ones too, since they share our tables)
+    if (self != [OWHTTPSessionQueue class])
+        return;
+
+    for (NSUInteger stripeIndex = 0; stripeIndex < SessionQueueStripeCount; stripeIndex++) {
+        [queueStripeLocks[stripeIndex] lock];
+        NS_DURING {
+            [self _lockedFlushSessionQueuesInStripe:stripeIndex olderThanDate:nil excludingQueue:nil];
+        } NS_HANDLER {
+            NSLog(@"+[%@ %@]: caught exception %@", NSStringFromClass(self), NSStringFromSelector(_cmd), localException);
+        } NS_ENDHANDLER;
+        [queueStripeLocks[stripeIndex] unlock];
+    }
 }
 
-+ (void)_lockedCleanSessionQueuesOlderThanTimeoutExcludingQueue:(OWHTTPSessionQueue *)excludedQueue;
++ (void)_lockedCleanSessionQueuesInStripe:(NSUInteger)stripeIndex olderThanTimeoutExcludingQueue:(OWHTTPSessionQueue *)excludedQueue;
 {
-    static NSDate *lastCleanDate = nil;
-
-    // TODO: lastCleanDate is local to this class, but we need to clean up the HTTPS cache also.  Maybe we should just have a single cache with modified keys for each protocol, rather than maintaining separate caches.
     NSDate *currentDate = [[NSDate alloc] init];
+    NSDate *lastCleanDate = queueStripeLastCleanDates[stripeIndex];
     if (lastCleanDate != nil && [currentDate timeIntervalSinceDate:lastCleanDate] < sessionTimeout) {
         return;
     }
 
-    [self _lockedFlushSessionQueuesOlderThanDate:[NSDate dateWithTimeIntervalSinceNow:-sessionTimeout] excludingQueue:excludedQueue];
-    lastCleanDate = currentDate;
+    [self _lockedFlushSessionQueuesInStripe:stripeIndex olderThanDate:[NSDate dateWithTimeIntervalSinceNow:-sessionTimeout] excludingQueue:excludedQueue];
+    queueStripeLastCleanDates[stripeIndex] = currentDate;
 }
 
-+ (void)_lockedFlushSessionQueuesOlderThanDate:(NSDate *)aDate excludingQueue:(OWHTTPSessionQueue *)excludedQueue;
++ (void)_lockedFlushSessionQueuesInStripe:(NSUInteger)stripeIndex olderThanDate:(NSDate *)aDate excludingQueue:(OWHTTPSessionQueue *)excludedQueue;
 {
     OWHTTPSessionQueue *aQueue;
 
     if (!aDate)
         aDate = [NSDate distantFuture];
-    OFDatedMutableDictionary *cache = [self cache];
-    NSEnumerator *enumerator = [[cache objectsOlderThanDate:aDate] objectEnumerator];
+    OFDatedMutableDictionary *stripe = queueStripes[stripeIndex];
+    NSEnumerator *enumerator = [[stripe objectsOlderThanDate:aDate] objectEnumerator];
     while ((aQueue = [enumerator nextObject])) {
         if (aQueue != excludedQueue && [aQueue queueEmptyAndAllSessionsIdle]) {
-            [cache removeObjectForKey:[aQueue queueKey]];
+            [stripe removeObjectForKey:_stripeKey([aQueue class], [aQueue queueKey])];
         }
     }
 }
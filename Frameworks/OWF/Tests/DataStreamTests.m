@@ -12,6 +12,7 @@
 #import <XCTest/XCTest.h>
 #import <OmniBase/rcsid.h>
 #import <OmniFoundation/NSData-OFExtensions.h>
+#import <OmniFoundation/OFByteSet.h>
 
 RCS_ID("$Id$");
 
@@ -286,6 +287,102 @@ static NSData *someData;
     dataStream = nil;
 }
 
+static void writeInPieces(OWDataStream *stream, NSData *data)
+{
+    NSUInteger writePos = 0;
+    while (writePos < [data length]) {
+        NSUInteger pieceLength = MIN((NSUInteger)(random() % 0x5000) + 1, [data length] - writePos);
+        [stream writeData:[data subdataWithRange:(NSRange){writePos, pieceLength}]];
+        writePos += pieceLength;
+    }
+}
+
+- (void)checkRandomAccess
+{
+    NSUInteger totalLength = [inputData length];
+    NSUInteger probeIndex;
+
+    for(probeIndex = 0; probeIndex < 2000; probeIndex ++) {
+        NSRange range;
+        void *buffer;
+
+        range.location = random() % totalLength;
+        range.length = MIN((NSUInteger)(random() % 0x8000), totalLength - range.location);
+        XCTAssertEqualObjects([dataStream dataWithRange:range], [inputData subdataWithRange:range]);
+
+        NSUInteger available = [dataStream accessUnderlyingBuffer:&buffer startingAtLocation:range.location];
+        XCTAssertTrue(available > 0);
+        XCTAssertTrue(memcmp(buffer, (const char *)[inputData bytes] + range.location, MIN(available, totalLength - range.location)) == 0);
+    }
+
+    char byte;
+    XCTAssertFalse([dataStream getBytes:&byte range:(NSRange){totalLength, 1}]);
+    XCTAssertNil([dataStream dataWithRange:(NSRange){totalLength - 1, 2}]);
+}
+
+- (void)testRandomAccess
+{
+    inputData = [someData retain];
+    dataStream = [[OWDataStream alloc] init];
+    [dataStream setMappedFileThreshold:0];
+    writeInPieces(dataStream, inputData);
+    [dataStream dataEnd];
+
+    [self checkRandomAccess];
+}
+
+- (void)testMappedFileSpill
+{
+    inputData = [someData retain];
+    dataStream = [[OWDataStream alloc] init];
+    [dataStream setMappedFileThreshold:256 * 1024];
+    writeInPieces(dataStream, inputData);
+    [dataStream dataEnd];
+
+    [self checkRandomAccess];
+    XCTAssertEqualObjects([dataStream bufferedData], inputData);
+}
+
+- (void)testScanUpToByteInSet
+{
+    inputData = [someData retain];
+    dataStream = [[OWDataStream alloc] init];
+    writeInPieces(dataStream, inputData);
+    [dataStream dataEnd];
+
+    OFByteSet *delimiters = [[OFByteSet alloc] init];
+    [delimiters addBytesFromString:@"()" encoding:NSASCIIStringEncoding];
+
+    const OFByte *bytes = [inputData bytes];
+    NSUInteger totalLength = [inputData length];
+    OWDataStreamCursor *readCursor = [dataStream createCursor];
+    OWDataStreamCursor *scanCursor = [dataStream createCursor];
+
+    // Pieces are written at random lengths, so the delimiters land on and next to block boundaries.
+    NSUInteger start = 0;
+    while (YES) {
+        NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+        NSUInteger end = start;
+        while (end < totalLength && !isByteInByteSet(bytes[end], delimiters))
+            end++;
+
+        XCTAssertEqualObjects([readCursor readUpToByteInSet:delimiters], [inputData subdataWithRange:(NSRange){start, end - start}]);
+        [pool release];
+        if (end == totalLength)
+            break;
+
+        XCTAssertEqual([scanCursor scanUpToByteInSet:delimiters], end - start);
+        [readCursor skipBytes:1];
+        [scanCursor skipBytes:1];
+        start = end + 1;
+    }
+
+    XCTAssertTrue([readCursor isAtEOF]);
+    XCTAssertThrows([scanCursor scanUpToByteInSet:delimiters]);
+    [delimiters release];
+}
+
 @end
 
 
+
@@ -0,0 +1,154 @@
+// Copyright 2026 Omni Development, Inc. All rights reserved.
+//
+// This software may only be used and reproduced according to the
+// terms in the file OmniSourceLicense.html, which should be
+// distributed with this project and can also be found at
+// <http://www.omnigroup.com/developer/sourcecode/sourcelicense/>.
+
+#import <OWF/OWContentType.h>
+#import <OWF/OWContentTypeLink.h>
+#import <OWF/OWConversionPathElement.h>
+
+#import <Foundation/Foundation.h>
+#import <XCTest/XCTest.h>
+#import <OmniBase/rcsid.h>
+
+RCS_ID("$Id$");
+
+@interface OWContentTypeTests : XCTestCase
+@end
+
+@implementation OWContentTypeTests
+
+// Content types live forever, so each test makes its own.
+static NSArray *_makeTypes(NSString *prefix, NSUInteger count)
+{
+    NSMutableArray *types = [NSMutableArray array];
+    for (NSUInteger typeIndex = 0; typeIndex < count; typeIndex++)
+        [types addObject:[OWContentType contentTypeForString:[NSString stringWithFormat:@"x-owcontenttypetests-%@/t%lu", prefix, typeIndex]]];
+    return types;
+}
+
+static void _checkPath(XCTestCase *self, OWConversionPathElement *path, OWContentType *sourceType, OWContentType *targetType)
+{
+    float totalCost = 0.0f;
+    OWContentType *type = sourceType;
+    for (OWConversionPathElement *element = path; element != nil; element = [element nextElement]) {
+        XCTAssertEqual([[element link] sourceContentType], type);
+        totalCost += [[element link] cost];
+        type = [[element link] targetContentType];
+    }
+    XCTAssertEqual(type, targetType);
+    XCTAssertEqual([path totalCost], totalCost);
+}
+
+- (void)testPathsMatchBellmanFord;
+{
+    static const NSUInteger typeCount = 40, linkCount = 120;
+    NSArray *types = _makeTypes(@"random", typeCount);
+
+    // Whole-number costs, so that sums are exact and equal-cost paths compare equal.
+    float linkCosts[typeCount][typeCount];
+    for (NSUInteger sourceIndex = 0; sourceIndex < typeCount; sourceIndex++)
+        for (NSUInteger targetIndex = 0; targetIndex < typeCount; targetIndex++)
+            linkCosts[sourceIndex][targetIndex] = FLT_MAX;
+
+    srandom(1997);
+    for (NSUInteger linkIndex = 0; linkIndex < linkCount; linkIndex++) {
+        NSUInteger sourceIndex = random() % typeCount, targetIndex = random() % typeCount;
+        float cost = (float)(random() % 10);
+        [[types objectAtIndex:sourceIndex] linkToContentType:[types objectAtIndex:targetIndex] usingProcessorDescription:nil cost:cost];
+        linkCosts[sourceIndex][targetIndex] = MIN(linkCosts[sourceIndex][targetIndex], cost); // The cheaper link wins
+    }
+
+    for (NSUInteger targetIndex = 0; targetIndex < typeCount; targetIndex++) {
+        OWContentType *targetType = [types objectAtIndex:targetIndex];
+
+        // Cheapest cost of at least one link from each type to the target.
+        float costs[typeCount];
+        for (NSUInteger typeIndex = 0; typeIndex < typeCount; typeIndex++)
+            costs[typeIndex] = linkCosts[typeIndex][targetIndex];
+        BOOL changed = YES;
+        while (changed) {
+            changed = NO;
+            for (NSUInteger sourceIndex = 0; sourceIndex < typeCount; sourceIndex++) {
+                for (NSUInteger nextIndex = 0; nextIndex < typeCount; nextIndex++) {
+                    if (linkCosts[sourceIndex][nextIndex] == FLT_MAX || costs[nextIndex] == FLT_MAX)
+                        continue;
+                    float cost = linkCosts[sourceIndex][nextIndex] + costs[nextIndex];
+                    if (cost < costs[sourceIndex]) {
+                        costs[sourceIndex] = cost;
+                        changed = YES;
+                    }
+                }
+            }
+        }
+
+        for (NSUInteger sourceIndex = 0; sourceIndex < typeCount; sourceIndex++) {
+            OWContentType *sourceType = [types objectAtIndex:sourceIndex];
+            OWConversionPathElement *path = [sourceType bestPathForTargetContentType:targetType];
+            if (costs[sourceIndex] == FLT_MAX) {
+                XCTAssertNil(path, @"%@ -> %@", sourceType, targetType);
+            } else {
+                XCTAssertNotNil(path, @"%@ -> %@", sourceType, targetType);
+                XCTAssertEqual([path totalCost], costs[sourceIndex], @"%@ -> %@", sourceType, targetType);
+                _checkPath(self, path, sourceType, targetType);
+            }
+        }
+    }
+}
+
+- (void)testNewLinksAreSeen;
+{
+    NSArray *types = _makeTypes(@"relink", 3);
+    OWContentType *a = [types objectAtIndex:0], *b = [types objectAtIndex:1], *c = [types objectAtIndex:2];
+
+    [a linkToContentType:b usingProcessorDescription:nil cost:1.0f];
+    [b linkToContentType:c usingProcessorDescription:nil cost:1.0f];
+    XCTAssertEqual([[a bestPathForTargetContentType:c] totalCost], 2.0f);
+    XCTAssertNil([c bestPathForTargetContentType:a]);
+
+    // A direct link that's cheaper than going through b, and a way back.
+    [a linkToContentType:c usingProcessorDescription:nil cost:1.5f];
+    [c linkToContentType:a usingProcessorDescription:nil cost:1.0f];
+    OWConversionPathElement *path = [a bestPathForTargetContentType:c];
+    XCTAssertEqual([path totalCost], 1.5f);
+    XCTAssertNil([path nextElement]);
+    XCTAssertEqual([[c bestPathForTargetContentType:a] totalCost], 1.0f);
+
+    // From a type to itself is the cheapest cycle through it.
+    path = [a bestPathForTargetContentType:a];
+    XCTAssertEqual([path totalCost], 2.5f);
+    _checkPath(self, path, a, a);
+}
+
+- (void)testLookupsDuringRegistration;
+{
+    static const NSUInteger typeCount = 200;
+    NSArray *types = _makeTypes(@"concurrent", typeCount);
+    OWContentType *lastType = [types lastObject];
+
+    // A chain, registered from the far end, while other threads look up paths along it.
+    dispatch_group_t group = dispatch_group_create();
+    __block BOOL done = NO;
+    for (NSUInteger readerIndex = 0; readerIndex < 4; readerIndex++) {
+        dispatch_group_async(group, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+            while (!done) {
+                OWContentType *sourceType = [types objectAtIndex:random() % typeCount];
+                OWConversionPathElement *path = [sourceType bestPathForTargetContentType:lastType];
+                if (path != nil)
+                    _checkPath(self, path, sourceType, lastType);
+            }
+        });
+    }
+
+    for (NSUInteger typeIndex = typeCount - 1; typeIndex > 0; typeIndex--)
+        [[types objectAtIndex:typeIndex - 1] linkToContentType:[types objectAtIndex:typeIndex] usingProcessorDescription:nil cost:1.0f];
+    done = YES;
+    dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+    dispatch_release(group);
+
+    XCTAssertEqual([[[types objectAtIndex:0] bestPathForTargetContentType:lastType] totalCost], (float)(typeCount - 1));
+}
+
+@end
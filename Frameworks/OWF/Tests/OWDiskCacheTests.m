@@ -0,0 +1,158 @@
+// Copyright 2026 Omni Development, Inc. All rights reserved.
+//
+// This software may only be used and reproduced according to the
+// terms in the file OmniSourceLicense.html, which should be
+// distributed with this project and can also be found at
+// <http://www.omnigroup.com/developer/sourcecode/sourcelicense/>.
+
+#import <OWF/OWAddress.h>
+#import <OWF/OWContent.h>
+#import <OWF/OWStaticArc.h>
+#import <OWF/OWURL.h>
+
+#import "OWDiskCacheInternal.h"
+
+#import <Foundation/Foundation.h>
+#import <XCTest/XCTest.h>
+#import <OmniBase/OBTestCase.h>
+#import <OmniBase/rcsid.h>
+
+RCS_ID("$Id$");
+
+// Records whatever access time the test sets, so that least-recently-used order doesn't depend on the wall clock.
+@interface OWDiskCacheTestsCache : OWDiskCache
+@property (nonatomic) time_t now;
+@end
+
+@implementation OWDiskCacheTestsCache
+
+- (time_t)accessTime;
+{
+    return _now;
+}
+
+@end
+
+@interface OWDiskCacheTests : XCTestCase
+@end
+
+@implementation OWDiskCacheTests
+{
+    NSString *_cachePath;
+    OWDiskCacheTestsCache *_cache;
+}
+
+- (void)setUp;
+{
+    [super setUp];
+
+    _cachePath = [NSTemporaryDirectory() stringByAppendingPathComponent:[NSString stringWithFormat:@"OWDiskCacheTests-%@.cache", [[NSUUID UUID] UUIDString]]];
+    _cache = (OWDiskCacheTestsCache *)[OWDiskCacheTestsCache createCacheAtPath:_cachePath];
+    XCTAssertNotNil(_cache);
+    _cache.now = 1000;
+}
+
+- (void)tearDown;
+{
+    [_cache close];
+    _cache = nil;
+    [[NSFileManager defaultManager] removeItemAtPath:_cachePath error:NULL];
+    [[NSUserDefaults standardUserDefaults] removeObjectForKey:OWDiskCacheLimitDefaultsKey];
+
+    [super tearDown];
+}
+
+static OWContent *_addressContent(NSUInteger number)
+{
+    OWURL *url = [OWURL urlFromString:[NSString stringWithFormat:@"http://www.example.com/OWDiskCacheTests/%lu", number]];
+    return [OWContent contentWithAddress:[OWAddress addressWithURL:url]];
+}
+
+static OWStaticArc *_retrievedArc(NSUInteger number, NSUInteger objectLength)
+{
+    NSMutableData *objectData = [NSMutableData dataWithLength:objectLength];
+    NSData *tag = [[NSString stringWithFormat:@"object %lu", number] dataUsingEncoding:NSUTF8StringEncoding];
+    [objectData replaceBytesInRange:NSMakeRange(0, MIN([tag length], objectLength)) withBytes:[tag bytes]];
+
+    OWContent *address = _addressContent(number);
+
+    OWStaticArcInitialization *i = [[OWStaticArcInitialization alloc] init];
+    i.arcType = OWCacheArcRetrievedContent;
+    i.subject = address;
+    i.source = address;
+    i.object = [OWContent contentWithData:objectData headers:nil];
+    i.creationDate = [NSDate date];
+
+    return [[OWStaticArc alloc] initWithArcInitializationProperties:i];
+}
+
+- (NSUInteger)_arcCountForAddressNumber:(NSUInteger)number;
+{
+    return [[_cache arcsWithRelation:OWCacheArcSubject toEntry:_addressContent(number) inPipeline:nil] count];
+}
+
+- (void)_addArcsNumbered:(NSRange)numbers objectLength:(NSUInteger)objectLength;
+{
+    @autoreleasepool {
+        for (NSUInteger arcNumber = numbers.location; arcNumber < NSMaxRange(numbers); arcNumber++)
+            XCTAssertNotNil([_cache addArc:_retrievedArc(arcNumber, objectLength)]);
+        XCTAssertTrue([_cache flushWriteBuffer]);
+    }
+}
+
+- (void)testInsertIntoLargeCachePerformance;
+{
+    if (![OBTestCase shouldRunSlowUnitTests]) {
+        NSLog(@"*** SKIPPING slow test [%@ %@]", [self class], NSStringFromSelector(_cmd));
+        return;
+    }
+
+    // No limit, so every insert lands in an ever-growing table and nothing is evicted.
+    [[NSUserDefaults standardUserDefaults] setInteger:0 forKey:OWDiskCacheLimitDefaultsKey];
+
+    // Each arc adds two content rows, a URI row and an arc row, so this fills the cache to about 160,000 rows before measuring.
+    const NSUInteger arcsPerBatch = 1000;
+    __block NSUInteger arcNumber = 0;
+    for (NSUInteger batchIndex = 0; batchIndex < 40; batchIndex++) {
+        [self _addArcsNumbered:NSMakeRange(arcNumber, arcsPerBatch) objectLength:64];
+        arcNumber += arcsPerBatch;
+    }
+
+    [self measureBlock:^{
+        [self _addArcsNumbered:NSMakeRange(arcNumber, arcsPerBatch) objectLength:64];
+        arcNumber += arcsPerBatch;
+    }];
+
+    XCTAssertEqual([self _arcCountForAddressNumber:0], 1UL);
+    XCTAssertEqual([self _arcCountForAddressNumber:arcNumber - 1], 1UL);
+    XCTAssertEqual([[_cache allArcs] count], arcNumber);
+}
+
+- (void)testEvictionIsLeastRecentlyUsed;
+{
+    // One megabyte of disk allows 700,000 bytes of content; eviction goes down to 90% of that.
+    [[NSUserDefaults standardUserDefaults] setInteger:1 forKey:OWDiskCacheLimitDefaultsKey];
+    const NSUInteger objectLength = 50000;
+
+    [self _addArcsNumbered:NSMakeRange(0, 10) objectLength:objectLength];
+
+    // Reading the first arc records a later access time for its content at the next flush.
+    _cache.now = 2000;
+    XCTAssertEqual([self _arcCountForAddressNumber:0], 1UL);
+    XCTAssertTrue([_cache flushWriteBuffer]);
+
+    _cache.now = 3000;
+    [self _addArcsNumbered:NSMakeRange(10, 10) objectLength:objectLength];
+    XCTAssertGreaterThan([_cache totalContentSize], 700000ULL);
+
+    // The cache is shrunk at the start of the next write.
+    [self _addArcsNumbered:NSMakeRange(20, 1) objectLength:objectLength];
+
+    XCTAssertEqual([self _arcCountForAddressNumber:0], 1UL, @"Recently read content should survive eviction");
+    XCTAssertEqual([self _arcCountForAddressNumber:1], 0UL, @"The least recently used content should be evicted first");
+    XCTAssertEqual([self _arcCountForAddressNumber:19], 1UL);
+    XCTAssertEqual([self _arcCountForAddressNumber:20], 1UL);
+    XCTAssertLessThanOrEqual([_cache totalContentSize], 700000ULL);
+}
+
+@end
@@ -39,6 +39,15 @@ static unsigned int startedCount = 0;
 
 @end
 
+@interface OWFWebPounder (CacheStress)
++ (void)stressMemoryCacheWithArcCount:(NSUInteger)arcCount;
+@end
+
+// Normally run by the memory cache's own scheduled event; the stress test calls it directly so it can time it.
+@interface OWMemoryCache (OWFWebPounderPrivate)
+- (void)_expire;
+@end
+
 int main(int argc, char *argv[])
 {
     NSMutableArray *addressStrings;
@@ -46,6 +55,7 @@ int main(int argc, char *argv[])
     
     if (argc < 2) {
         fprintf(stderr, "usage: %s [ url | delay ] ...\n", argv[0]);
+        fprintf(stderr, "       %s -cache-stress arc-count\n", argv[0]);
         exit(1);
     }
 
@@ -62,6 +72,11 @@ int main(int argc, char *argv[])
         [[OFController sharedController] startedRunning];
         [[OFScheduler dedicatedThreadScheduler] setInvokesEventsInMainThread:NO];
 
+        if (argc == 3 && strcmp(argv[1], "-cache-stress") == 0) {
+            [OWFWebPounder stressMemoryCacheWithArcCount:strtoul(argv[2], NULL, 10)];
+            exit(0);
+        }
+
         addressStrings = [NSMutableArray array];
         for (argumentIndex = 1; argumentIndex < argc; argumentIndex++)
             [addressStrings addObject:[NSString stringWithCString:argv[argumentIndex]]];
@@ -272,6 +287,77 @@ static NSMutableDictionary *anchorStringsCache;
 
 @end
 
+@implementation OWFWebPounder (CacheStress)
+
+static NSTimeInterval _elapsedSince(NSTimeInterval start)
+{
+    return [NSDate timeIntervalSinceReferenceDate] - start;
+}
+
+// Fills a memory cache with synthetic arcs (one subject per address, several addresses sharing each source and object), then times adding them, looking them up by each relation, and a sweep that has nothing to expire.
++ (void)stressMemoryCacheWithArcCount:(NSUInteger)arcCount;
+{
+    OWMemoryCache *cache = [[OWMemoryCache alloc] init];
+    [cache setFlush:YES];
+    NSMutableArray *subjects = [NSMutableArray arrayWithCapacity:arcCount];
+    NSMutableArray *objects = [NSMutableArray array];
+    NSDate *now = [NSDate date];
+    NSTimeInterval start;
+
+    start = [NSDate timeIntervalSinceReferenceDate];
+    for (NSUInteger arcIndex = 0; arcIndex < arcCount; arcIndex++) {
+        OMNI_POOL_START {
+            OWContent *subject = [OWContent contentWithAddress:[OWAddress addressForDirtyString:[NSString stringWithFormat:@"http://host%lu.example.com/page/%lu", arcIndex % 97, arcIndex]]];
+            if (arcIndex % 4 == 0)
+                [objects addObject:[OWContent contentWithString:[NSString stringWithFormat:@"object %lu", arcIndex] contentType:@"text/plain" isSource:NO]];
+
+            OWStaticArcInitialization *initialization = [[OWStaticArcInitialization alloc] init];
+            initialization.arcType = OWCacheArcRetrievedContent;
+            initialization.subject = subject;
+            initialization.source = subject;
+            initialization.object = [objects lastObject];
+            initialization.creationDate = now;
+
+            OWStaticArc *arc = [[OWStaticArc alloc] initWithArcInitializationProperties:initialization];
+            [cache addArc:arc];
+            [arc release];
+            [initialization release];
+
+            [subjects addObject:subject];
+        } OMNI_POOL_END;
+    }
+    printf("Added %lu arcs in %.3f seconds\n", (unsigned long)arcCount, _elapsedSince(start));
+
+    static const NSUInteger probeCount = 10000;
+    OWCacheArcRelationship relations[] = {OWCacheArcSubject, OWCacheArcSource, OWCacheArcObject, OWCacheArcAnyRelation};
+    const char *relationNames[] = {"subject", "source", "object", "any"};
+    for (NSUInteger relationIndex = 0; relationIndex < sizeof(relations) / sizeof(*relations); relationIndex++) {
+        NSUInteger matchCount = 0;
+        start = [NSDate timeIntervalSinceReferenceDate];
+        for (NSUInteger probeIndex = 0; probeIndex < probeCount; probeIndex++) {
+            OMNI_POOL_START {
+                NSArray *probeEntries = relations[relationIndex] == OWCacheArcObject ? objects : subjects;
+                OWContent *entry = [probeEntries objectAtIndex:(probeIndex * 7919) % [probeEntries count]];
+                matchCount += [[cache arcsWithRelation:relations[relationIndex] toEntry:entry inPipeline:nil] count];
+            } OMNI_POOL_END;
+        }
+        printf("%lu %s lookups in %.3f seconds, %lu matches\n", (unsigned long)probeCount, relationNames[relationIndex], _elapsedSince(start), (unsigned long)matchCount);
+    }
+
+    start = [NSDate timeIntervalSinceReferenceDate];
+    [cache _expire];
+    printf("Expiry sweep in %.3f seconds\n", _elapsedSince(start));
+
+    start = [NSDate timeIntervalSinceReferenceDate];
+    [self flushCache];
+    printf("Flush in %.3f seconds\n", _elapsedSince(start));
+
+    [cache setFlush:NO];
+    [cache release];
+}
+
+@end
+
 @interface OWFWebPounderObserver (Private)
 - (void)_pipelineFetchedNotification:(NSNotification *)notification;
 @end
@@ -0,0 +1,128 @@
+// Copyright 2026 Omni Development, Inc. All rights reserved.
+//
+// This software may only be used and reproduced according to the
+// terms in the file OmniSourceLicense.html, which should be
+// distributed with this project and can also be found at
+// <http://www.omnigroup.com/developer/sourcecode/sourcelicense/>.
+
+#import <OWF/OWAddress.h>
+#import <OWF/OWHTTPSessionQueue.h>
+
+#import <Foundation/Foundation.h>
+#import <XCTest/XCTest.h>
+#import <OmniBase/rcsid.h>
+
+RCS_ID("$Id$");
+
+@interface OWHTTPSessionQueueTests : XCTestCase
+@end
+
+@implementation OWHTTPSessionQueueTests
+
+static NSString * const MaximumPipelineDepthDefault = @"OWHTTPMaximumNumberOfRequestsToPipeline";
+
+- (void)setUp;
+{
+    [super setUp];
+    [[NSUserDefaults standardUserDefaults] setInteger:8 forKey:MaximumPipelineDepthDefault];
+}
+
+- (void)tearDown;
+{
+    [[NSUserDefaults standardUserDefaults] removeObjectForKey:MaximumPipelineDepthDefault];
+    [super tearDown];
+}
+
+- (void)testQueueLookup;
+{
+    OWHTTPSessionQueue *queue = [OWHTTPSessionQueue httpSessionQueueForAddress:[OWAddress addressForString:@"http://www.omnigroup.com/"]];
+    XCTAssertNotNil(queue);
+    XCTAssertEqual([OWHTTPSessionQueue httpSessionQueueForAddress:[OWAddress addressForString:@"http://www.omnigroup.com/products/"]], queue);
+
+    // Enough hosts to land in every stripe, each with its own queue.
+    NSMutableSet *queues = [NSMutableSet setWithObject:queue];
+    for (NSUInteger hostIndex = 0; hostIndex < 100; hostIndex++) {
+        OWAddress *address = [OWAddress addressForString:[NSString stringWithFormat:@"http://host%lu.example.com/", hostIndex]];
+        OWHTTPSessionQueue *hostQueue = [OWHTTPSessionQueue httpSessionQueueForAddress:address];
+        XCTAssertFalse([queues containsObject:hostQueue]);
+        XCTAssertEqual([OWHTTPSessionQueue httpSessionQueueForAddress:address], hostQueue);
+        [queues addObject:hostQueue];
+    }
+}
+
+- (void)testAdaptivePipelineDepth;
+{
+    OWHTTPSessionQueue *queue = [[OWHTTPSessionQueue alloc] initWithAddress:[OWAddress addressForString:@"http://pipeline.example.com/"]];
+    XCTAssertEqual([queue maximumNumberOfRequestsToPipeline], 2UL);
+
+    // Each full pipeline's worth of responses deepens it by one...
+    for (NSUInteger expectedDepth = 2; expectedDepth < 8; expectedDepth++) {
+        for (NSUInteger responseIndex = 0; responseIndex < expectedDepth; responseIndex++) {
+            XCTAssertEqual([queue maximumNumberOfRequestsToPipeline], expectedDepth);
+            [queue sessionDidCompletePipelinedResponse:nil];
+        }
+    }
+    // ...up to the limit.
+    for (NSUInteger responseIndex = 0; responseIndex < 20; responseIndex++)
+        [queue sessionDidCompletePipelinedResponse:nil];
+    XCTAssertEqual([queue maximumNumberOfRequestsToPipeline], 8UL);
+    XCTAssertEqualObjects([[queue metrics] objectForKey:OWHTTPSessionQueuePipelineDepthMetric], @8);
+
+    // Dropped connections halve it, and only give up on pipelining once it's down to one.
+    [queue sessionDidFailPipelinedRequests:nil];
+    XCTAssertEqual([queue maximumNumberOfRequestsToPipeline], 4UL);
+    [queue sessionDidFailPipelinedRequests:nil];
+    [queue sessionDidFailPipelinedRequests:nil];
+    XCTAssertEqual([queue maximumNumberOfRequestsToPipeline], 1UL);
+    XCTAssertFalse([queue serverCannotHandlePipelinedRequestsReliably]);
+    [queue sessionDidFailPipelinedRequests:nil];
+    XCTAssertTrue([queue serverCannotHandlePipelinedRequestsReliably]);
+
+    // Lowering the limit takes effect right away.
+    [[NSUserDefaults standardUserDefaults] setInteger:1 forKey:MaximumPipelineDepthDefault];
+    OWHTTPSessionQueue *shallowQueue = [[OWHTTPSessionQueue alloc] initWithAddress:[OWAddress addressForString:@"http://shallow.example.com/"]];
+    XCTAssertEqual([shallowQueue maximumNumberOfRequestsToPipeline], 1UL);
+    [shallowQueue sessionDidCompletePipelinedResponse:nil];
+    XCTAssertEqual([shallowQueue maximumNumberOfRequestsToPipeline], 1UL);
+
+    [shallowQueue release];
+    [queue release];
+}
+
+- (void)testMetrics;
+{
+    OWHTTPSessionQueue *queue = [[OWHTTPSessionQueue alloc] initWithAddress:[OWAddress addressForString:@"http://metrics.example.com/"]];
+
+    NSDictionary *metrics = [queue metrics];
+    XCTAssertEqualObjects([metrics objectForKey:OWHTTPSessionQueueConnectionCountMetric], @0);
+    XCTAssertEqualObjects([metrics objectForKey:OWHTTPSessionQueueRequestsPerConnectionMetric], @0.0);
+    XCTAssertEqualObjects([metrics objectForKey:OWHTTPSessionQueueMeanTimeToFirstByteMetric], @0.0);
+
+    [queue sessionDidConnect:nil];
+    [queue sessionDidConnect:nil];
+    for (NSUInteger depth = 1; depth <= 3; depth++)
+        [queue session:nil didSendRequestAtPipelineDepth:depth];
+    [queue session:nil didSendRequestAtPipelineDepth:1];
+    [queue session:nil didSendRequestAtPipelineDepth:OWHTTPSessionQueuePipelineDepthHistogramSize + 10];
+    [queue session:nil didBeginResponseAfterTimeInterval:0.25];
+    [queue session:nil didBeginResponseAfterTimeInterval:0.75];
+
+    metrics = [queue metrics];
+    XCTAssertEqualObjects([metrics objectForKey:OWHTTPSessionQueueConnectionCountMetric], @2);
+    XCTAssertEqualObjects([metrics objectForKey:OWHTTPSessionQueueRequestCountMetric], @5);
+    XCTAssertEqualObjects([metrics objectForKey:OWHTTPSessionQueueRequestsPerConnectionMetric], @2.5);
+    XCTAssertEqualObjects([metrics objectForKey:OWHTTPSessionQueueMeanTimeToFirstByteMetric], @0.5);
+    XCTAssertEqualObjects([metrics objectForKey:OWHTTPSessionQueueMaximumTimeToFirstByteMetric], @0.75);
+
+    NSArray *histogram = [metrics objectForKey:OWHTTPSessionQueuePipelineDepthHistogramMetric];
+    XCTAssertEqual([histogram count], (NSUInteger)OWHTTPSessionQueuePipelineDepthHistogramSize);
+    XCTAssertEqualObjects([histogram objectAtIndex:0], @2);
+    XCTAssertEqualObjects([histogram objectAtIndex:1], @1);
+    XCTAssertEqualObjects([histogram objectAtIndex:2], @1);
+    XCTAssertEqualObjects([histogram objectAtIndex:3], @0);
+    XCTAssertEqualObjects([histogram lastObject], @1);
+
+    [queue release];
+}
+
+@end
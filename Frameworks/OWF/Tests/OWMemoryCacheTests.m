@@ -0,0 +1,180 @@
+// Copyright 2026 Omni Development, Inc. All rights reserved.
+//
+// This software may only be used and reproduced according to the
+// terms in the file OmniSourceLicense.html, which should be
+// distributed with this project and can also be found at
+// <http://www.omnigroup.com/developer/sourcecode/sourcelicense/>.
+
+#import <OWF/OWAddress.h>
+#import <OWF/OWContent.h>
+#import <OWF/OWStaticArc.h>
+#import <OWF/OWURL.h>
+
+#import "OWMemoryCacheInternal.h"
+
+#import <Foundation/Foundation.h>
+#import <XCTest/XCTest.h>
+#import <OmniBase/rcsid.h>
+
+RCS_ID("$Id$");
+
+// Uses whatever time the test sets, so that expiry doesn't depend on the wall clock.
+@interface OWMemoryCacheTestsCache : OWMemoryCache
+@property (nonatomic) NSTimeInterval now;
+@end
+
+@implementation OWMemoryCacheTestsCache
+
+- (NSTimeInterval)currentTime;
+{
+    return _now;
+}
+
+@end
+
+// The sweep normally runs from a scheduled event; the tests run it themselves.
+@interface OWMemoryCache (OWMemoryCacheTests)
+- (void)_expire;
+@end
+
+@interface OWMemoryCacheTests : XCTestCase
+@end
+
+@implementation OWMemoryCacheTests
+{
+    OWMemoryCacheTestsCache *_cache;
+}
+
+- (void)setUp;
+{
+    [super setUp];
+
+    _cache = [[OWMemoryCacheTestsCache alloc] init];
+    _cache.now = 1000;
+}
+
+- (void)tearDown;
+{
+    _cache = nil;
+
+    [super tearDown];
+}
+
+static OWURL *_url(NSUInteger number)
+{
+    return [OWURL urlFromString:[NSString stringWithFormat:@"http://www.example.com/OWMemoryCacheTests/%lu", number]];
+}
+
+static OWContent *_addressContent(NSUInteger number)
+{
+    return [OWContent contentWithAddress:[OWAddress addressWithURL:_url(number)]];
+}
+
+static OWStaticArc *_retrievedArc(NSUInteger number, OWContent *object)
+{
+    OWContent *address = _addressContent(number);
+
+    OWStaticArcInitialization *i = [[OWStaticArcInitialization alloc] init];
+    i.arcType = OWCacheArcRetrievedContent;
+    i.subject = address;
+    i.source = address;
+    i.object = object;
+    i.creationDate = [NSDate dateWithTimeIntervalSinceNow:-60.0]; // Before any invalidation the test does
+
+    return [[OWStaticArc alloc] initWithArcInitializationProperties:i];
+}
+
+static OWContent *_objectContent(NSString *string)
+{
+    return [OWContent contentWithData:[string dataUsingEncoding:NSUTF8StringEncoding] headers:nil];
+}
+
+- (NSArray *)_arcsWithRelation:(OWCacheArcRelationship)relation toEntry:(OWContent *)entry;
+{
+    return [_cache arcsWithRelation:relation toEntry:entry inPipeline:nil];
+}
+
+- (NSUInteger)_expiryHeapCount;
+{
+    return [[[_cache debugDictionary] objectForKey:@"expiryHeapCount"] unsignedIntegerValue];
+}
+
+- (void)testLookupsBySourceAndObject;
+{
+    OWContent *sharedObject = _objectContent(@"shared");
+    OWStaticArc *firstArc = _retrievedArc(1, sharedObject);
+    OWStaticArc *secondArc = _retrievedArc(2, sharedObject);
+    [_cache addArc:firstArc];
+    [_cache addArc:secondArc];
+
+    NSArray *arcs = [self _arcsWithRelation:OWCacheArcObject toEntry:sharedObject];
+    XCTAssertEqual([arcs count], 2UL);
+    XCTAssertTrue([arcs indexOfObjectIdenticalTo:firstArc] != NSNotFound);
+    XCTAssertTrue([arcs indexOfObjectIdenticalTo:secondArc] != NSNotFound);
+
+    XCTAssertEqualObjects([self _arcsWithRelation:OWCacheArcSource toEntry:_addressContent(1)], @[firstArc]);
+    XCTAssertNil([self _arcsWithRelation:OWCacheArcSource toEntry:_addressContent(3)]);
+    XCTAssertNil([self _arcsWithRelation:OWCacheArcObject toEntry:_objectContent(@"other")]);
+
+    // The source is also the subject, and is found through both the row and the source index; it should only come back once.
+    XCTAssertEqualObjects([self _arcsWithRelation:OWCacheArcSubject | OWCacheArcSource toEntry:_addressContent(1)], @[firstArc]);
+
+    // Once an arc is purged, the indexes don't find it either.
+    [_cache invalidateResource:_url(1) beforeDate:nil];
+    [_cache _expire];
+    XCTAssertNil([self _arcsWithRelation:OWCacheArcSource toEntry:_addressContent(1)]);
+    XCTAssertEqualObjects([self _arcsWithRelation:OWCacheArcObject toEntry:sharedObject], @[secondArc]);
+}
+
+- (void)testPurgedEntryReleasesArcBeforeItsDeadline;
+{
+    __weak OWStaticArc *weakArc;
+    @autoreleasepool {
+        OWStaticArc *arc = _retrievedArc(1, _objectContent(@"purged"));
+        weakArc = arc;
+        [_cache addArc:arc];
+        XCTAssertEqual([[self _arcsWithRelation:OWCacheArcSubject toEntry:_addressContent(1)] count], 1UL);
+
+        [_cache invalidateResource:_url(1) beforeDate:nil];
+        [_cache _expire];
+    }
+
+    // The entry is still waiting in the expiry heap for its deadline, but it no longer holds on to the arc.
+    XCTAssertEqual([self _expiryHeapCount], 1UL);
+    XCTAssertNil(weakArc);
+    XCTAssertNil([self _arcsWithRelation:OWCacheArcSubject toEntry:_addressContent(1)]);
+
+    // Reaching the deadline drops the entry itself.
+    _cache.now += 120;
+    [_cache _expire];
+    XCTAssertEqual([self _expiryHeapCount], 0UL);
+}
+
+- (void)testExpiryFollowsLastUse;
+{
+    [_cache addArc:_retrievedArc(1, _objectContent(@"used"))];
+    [_cache addArc:_retrievedArc(2, _objectContent(@"unused"))];
+    XCTAssertEqual([self _expiryHeapCount], 2UL);
+
+    // Nothing is due yet.
+    _cache.now = 1030;
+    [_cache _expire];
+    XCTAssertEqual([[_cache allArcs] count], 2UL);
+
+    // Using the first arc pushes its deadline back; the second reaches its deadline unused.
+    XCTAssertEqual([[self _arcsWithRelation:OWCacheArcSubject toEntry:_addressContent(1)] count], 1UL);
+    _cache.now = 1061;
+    [_cache _expire];
+    XCTAssertEqual([[self _arcsWithRelation:OWCacheArcSubject toEntry:_addressContent(1)] count], 1UL);
+    XCTAssertNil([self _arcsWithRelation:OWCacheArcSubject toEntry:_addressContent(2)]);
+    XCTAssertEqual([self _expiryHeapCount], 1UL);
+
+    // The lookup just now counts as a use too.
+    _cache.now = 1122;
+    [_cache _expire];
+    XCTAssertNil([self _arcsWithRelation:OWCacheArcSubject toEntry:_addressContent(1)]);
+    XCTAssertEqual([self _expiryHeapCount], 0UL);
+    XCTAssertEqual([[_cache allArcs] count], 0UL);
+}
+
+@end
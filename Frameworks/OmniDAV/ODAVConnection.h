@@ -24,6 +24,7 @@ typedef void (^ODAVConnectionURLAndDataCompletionHandler)(ODAVURLAndDataResult *
 typedef void (^ODAVConnectionStringCompletionHandler)(NSString * _Nullable resultString, NSError * _Nullable errorOrNil);
 typedef void (^ODAVConnectionMultipleFileInfoCompletionHandler)(ODAVMultipleFileInfoResult * _Nullable properties, NSError * _Nullable errorOrNil);
 typedef void (^ODAVConnectionSingleFileInfoCompletionHandler)(ODAVSingleFileInfoResult * _Nullable properties, NSError * _Nullable errorOrNil);
+typedef void (^ODAVConnectionFileInfoBatchHandler)(NSArray <ODAVFileInfo *> *fileInfos);
 
 typedef NS_ENUM(NSUInteger, ODAVDepth) {
     ODAVDepthLocal,
@@ -78,6 +79,8 @@ typedef NS_ENUM(NSUInteger, ODAVDepth) {
 - (void)makeCollectionAtURLIfMissing:(NSURL *)url baseURL:(nullable NSURL *)baseURL completionHandler:(ODAVConnectionURLCompletionHandler)completionHandler;
 
 - (void)fileInfosAtURL:(NSURL *)url ETag:(nullable NSString *)predicateETag depth:(ODAVDepth)depth completionHandler:(ODAVConnectionMultipleFileInfoCompletionHandler)completionHandler;
+// Hands the file infos to the batch handler (on the calling queue) as the response arrives, rather than collecting them all first, so listing a huge collection doesn't need memory for all of it at once. The completion handler is called after the last batch, and its result has no fileInfos. Since some batches may already have been delivered, this isn't retried automatically if the connection drops partway through.
+- (void)fileInfosAtURL:(NSURL *)url ETag:(nullable NSString *)predicateETag depth:(ODAVDepth)depth batchHandler:(ODAVConnectionFileInfoBatchHandler)batchHandler completionHandler:(ODAVConnectionMultipleFileInfoCompletionHandler)completionHandler;
 - (void)fileInfoAtURL:(NSURL *)url ETag:(nullable NSString *)predicateETag completionHandler:(void (^)(ODAVSingleFileInfoResult * _Nullable result, NSError * _Nullable error))completionHandler;
 
 // Removes the directory URL itself, "._" files, and does some more error checking for non-directory cases.
@@ -9,6 +9,7 @@
 
 #import <OmniDAV/ODAVErrors.h>
 #import <OmniDAV/ODAVFileInfo.h>
+#import <OmniDAV/ODAVMultistatusParser.h>
 #import <OmniFoundation/NSString-OFConversion.h>
 #import <OmniFoundation/NSString-OFURLEncoding.h>
 #import <OmniFoundation/NSURL-OFExtensions.h>
@@ -17,7 +18,6 @@
 #import <OmniFoundation/OFPreference.h>
 #import <OmniFoundation/OFSecurityUtilities.h>
 #import <OmniFoundation/OFVersionNumber.h>
-#import <OmniFoundation/OFXMLCursor.h>
 #import <OmniFoundation/OFXMLDocument.h>
 #import <OmniFoundation/OFXMLElement.h>
 #import <OmniFoundation/OFXMLString.h>
@@ -44,7 +44,11 @@ OFDeclareDebugLogLevel(ODAVConnectionDebug);
 OFDeclareDebugLogLevel(ODAVConnectionTaskDebug)
 
 static OFXMLDocument *ODAVParseXMLResult(NSObject *selfish, NSData *responseData, OBNSErrorOutType outError);
-static NSMutableArray <ODAVFileInfo *> * _Nullable ODAVParseMultistatus(OFXMLDocument *responseDocument, NSString *originDescription, NSURL *resultsBaseURL, NSInteger *outShortestEntryIndex, OBNSErrorOutType outError);
+static NSURL *_resultsBaseURLForOperation(ODAVOperation *operation, NSURL *url);
+static ODAVMultipleFileInfoResult *_multipleFileInfoResultForOperation(ODAVOperation *operation, NSURL *url);
+
+// How many file infos are handed to a streaming PROPFIND's batch handler at once.
+static const NSUInteger ODAVFileInfoBatchSize = 100;
 
 #define COMPLETE_AND_RETURN(...) do { \
     if (completionHandler) \
@@ -406,109 +410,120 @@ static NSString *ODAVDepthName(ODAVDepth depth)
 {
     OBPRECONDITION(url);
     
-    NSString *depthName = ODAVDepthName(depth);
-
-    DEBUG_DAV(1, @"operation: PROPFIND ETag:%@ depth=%@ %@", predicateETag, depthName, url);
+    DEBUG_DAV(1, @"operation: PROPFIND ETag:%@ depth=%@ %@", predicateETag, ODAVDepthName(depth), url);
     
     url = [url absoluteURL];
     
-    // Build the propfind request.  Can do this dynamically but for now we have a static request...
-    NSData *requestXML;
-    {
-        __autoreleasing NSError *error;
-        OFXMLDocument *requestDocument = [[OFXMLDocument alloc] initWithRootElementName:@"propfind"
-                                                                           namespaceURL:[NSURL URLWithString:DAVNamespaceString]
-                                                                     whitespaceBehavior:[OFXMLWhitespaceBehavior ignoreWhitespaceBehavior]
-                                                                         stringEncoding:kCFStringEncodingUTF8
-                                                                                  error:&error];
-        if (!requestDocument) {
-            COMPLETE_AND_RETURN(nil, error);
-        }
-        
-        //[[requestDocument topElement] setAttribute:@"xmlns" string:DAVNamespaceString];
-        [requestDocument pushElement:@"prop"];
-        {
-            [requestDocument pushElement:@"resourcetype"];
-            [requestDocument popElement];
-            [requestDocument pushElement:@"getcontentlength"];
-            [requestDocument popElement];
-            [requestDocument pushElement:@"getlastmodified"];
-            [requestDocument popElement];
-            [requestDocument pushElement:@"getetag"];
-            [requestDocument popElement];
-        }
-        [requestDocument popElement];
-        
-        requestXML = [requestDocument xmlData:&error];
-        
-        DEBUG_DAV(3, @"requestXML = %@", [NSString stringWithData:requestXML encoding:NSUTF8StringEncoding]);
-        
-        
-        if (!requestXML)
-            COMPLETE_AND_RETURN(nil, error);
-        
-        //NSData *requestXML = [@"<?xml version=\"1.0\" encoding=\"utf-8\"?>\n<propfind xmlns=\"DAV:\"><prop>\n<resourcetype xmlns=\"DAV:\"/>\n</prop></propfind>" dataUsingEncoding:NSUTF8StringEncoding];
-    }
-    
-    NSMutableURLRequest *request = [self _requestForURL:url];
-    {
-        [request setHTTPMethod:@"PROPFIND"];
-        [request setHTTPBody:requestXML];
-        [request setValue:depthName forHTTPHeaderField:@"Depth"];
-        
-        if (![NSString isEmptyString:predicateETag])
-            [request setValue:predicateETag forHTTPHeaderField:@"If-Match"];
-        
-        // Specify that we are sending XML
-        [request setValue:@"text/xml; charset=\"utf-8\"" forHTTPHeaderField:@"Content-Type"];
-        
-        // ... and that we want XML back
-        [request setValue:@"text/xml,application/xml" forHTTPHeaderField:@"Accept"];
-    }
+    __autoreleasing NSError *requestError;
+    NSMutableURLRequest *request = [self _propfindRequestForURL:url ETag:predicateETag depth:depth error:&requestError];
+    if (!request)
+        COMPLETE_AND_RETURN(nil, requestError);
     
     completionHandler = [completionHandler copy];
     
-    [self _runRequestExpectingDocument:request completionHandler:^(OFXMLDocument * _Nullable doc, ODAVOperation * _Nullable op, NSError * _Nullable errorOrNil){
-        DEBUG_DAV(2, @"PROPFIND doc = %@", doc);
-        if (!doc) {
-            OBASSERT(errorOrNil);
-            COMPLETE_AND_RETURN(nil, errorOrNil);
-        }
+    // The whole response is buffered (so that the operation can be retried if the connection drops), but it is parsed straight into file infos without building a document first.
+    [self _runRequest:request completionHandler:^(ODAVOperation *op) {
+        if (op.error)
+            COMPLETE_AND_RETURN(nil, op.error);
         
-        ODAVMultipleFileInfoResult *result = [ODAVMultipleFileInfoResult new];
+        DEBUG_DAV(3, @"PROPFIND xmlString: %@", [NSString stringWithData:op.resultData encoding:NSUTF8StringEncoding]);
         
-        // If we followed redirects while doing the PROPFIND, it's important to interpret the result URLs relative to the URL of the request we actually got them from, instead of from some earlier request which may have been to a different scheme/host/whatever.
-        NSURL *resultsBaseURL = url;
-        {
-            NSArray *redirs = op.redirects;
-            if ([redirs count]) {
-                result.redirects = redirs;
-                ODAVRedirect *lastRedirect = [redirs lastObject];
-                resultsBaseURL = lastRedirect.to;
-            }
-        }
+        ODAVMultipleFileInfoResult *result = _multipleFileInfoResultForOperation(op, url);
         
-        // Date header
-        {
-            // We could avoid parsing the Date header unless it is requested, but for now I'd like to get assertion failures when a server doesn't return it.
-            result.serverDate = _serverDateForOperation(op);
-            OBASSERT(result.serverDate);
-        }
-
-        NSInteger shortestEntryIndex = NSNotFound;
         NSError * __autoreleasing localError;
-        NSMutableArray <ODAVFileInfo *> *fileInfos = ODAVParseMultistatus(doc, [request shortDescription], resultsBaseURL, &shortestEntryIndex, &localError);
+        NSArray <ODAVFileInfo *> *fileInfos = [ODAVMultistatusParser fileInfosFromData:op.resultData ?: [NSData data] baseURL:_resultsBaseURLForOperation(op, url) originDescription:[request shortDescription] error:&localError];
         if (!fileInfos) {
             OBASSERT(localError);
+            NSLog(@"Unable to decode PROPFIND response: %@", [localError toPropertyList]);
             COMPLETE_AND_RETURN(nil, localError);
         }
-            
+        
         result.fileInfos = fileInfos;
         
         COMPLETE_AND_RETURN(result, nil);
     }];
 }
 
+- (void)fileInfosAtURL:(NSURL *)url ETag:(nullable NSString *)predicateETag depth:(ODAVDepth)depth batchHandler:(ODAVConnectionFileInfoBatchHandler)batchHandler completionHandler:(ODAVConnectionMultipleFileInfoCompletionHandler)completionHandler;
+{
+    OBPRECONDITION(url);
+    OBPRECONDITION(batchHandler);
+    
+    DEBUG_DAV(1, @"operation: PROPFIND (streaming) ETag:%@ depth=%@ %@", predicateETag, ODAVDepthName(depth), url);
+    
+    url = [url absoluteURL];
+    
+    __autoreleasing NSError *requestError;
+    NSMutableURLRequest *request = [self _propfindRequestForURL:url ETag:predicateETag depth:depth error:&requestError];
+    if (!request)
+        COMPLETE_AND_RETURN(nil, requestError);
+    
+    completionHandler = [completionHandler copy];
+    batchHandler = [batchHandler copy];
+    
+    // Parse on a private serial queue, so that the pieces of the response are handled in order and the caller's queue is only used for the results.
+    NSOperationQueue *callbackQueue = [NSOperationQueue currentQueue];
+    NSOperationQueue *parseQueue = [[NSOperationQueue alloc] init];
+    parseQueue.maxConcurrentOperationCount = 1;
+    parseQueue.name = @"com.omnigroup.OmniDAV.PROPFIND parsing";
+    
+    NSString *originDescription = [request shortDescription];
+    __block ODAVMultistatusParser *parser = nil;
+    __block NSError *parseError = nil;
+    
+    ODAVMultistatusParser *(^makeParser)(ODAVOperation *op) = ^(ODAVOperation *op){
+        // Any redirects have been followed by the time we have a body, so the base URL is settled.
+        return [[ODAVMultistatusParser alloc] initWithBaseURL:_resultsBaseURLForOperation(op, url) originDescription:originDescription batchSize:ODAVFileInfoBatchSize batchHandler:^(NSArray <ODAVFileInfo *> *fileInfos) {
+            [callbackQueue addOperationWithBlock:^{
+                batchHandler(fileInfos);
+            }];
+        }];
+    };
+    
+    ODAVOperation *operation = [self _makeOperationForRequest:request];
+    
+    operation.didReceiveData = ^(ODAVOperation *op, NSData *data) {
+        if (parseError)
+            return;
+        if (!parser)
+            parser = makeParser(op);
+        
+        __autoreleasing NSError *error;
+        if (![parser parseData:data error:&error]) {
+            // No point reading the rest of a response we can't understand.
+            parseError = error;
+            [op cancel];
+        }
+    };
+    
+    operation.didFinish = ^(ODAVOperation *op, NSError *errorOrNil) {
+        NSError *error = parseError ?: errorOrNil;
+        ODAVMultipleFileInfoResult *result = nil;
+        
+        if (!error) {
+            if (!parser)
+                parser = makeParser(op); // Empty body; finishing will report the error
+            
+            __autoreleasing NSError *finishError;
+            if ([parser finishParsing:&finishError])
+                result = _multipleFileInfoResultForOperation(op, url);
+            else
+                error = finishError;
+        }
+        if (error && error != errorOrNil)
+            NSLog(@"Unable to decode PROPFIND response: %@", [error toPropertyList]);
+        
+        parser = nil;
+        if (completionHandler) {
+            [callbackQueue addOperationWithBlock:^{
+                completionHandler(result, error);
+            }];
+        }
+    };
+    
+    [operation startWithCallbackQueue:parseQueue];
+}
+
 - (void)fileInfoAtURL:(NSURL *)url ETag:(nullable NSString *)predicateETag completionHandler:(void (^)(ODAVSingleFileInfoResult * _Nullable result, NSError * _Nullable error))completionHandler;
 {
     OBPRECONDITION(url);
@@ -1132,6 +1147,96 @@ static NSDate *_serverDateForOperation(ODAVOperation *operation)
         return nil;
 }
 
+- (nullable NSMutableURLRequest *)_propfindRequestForURL:(NSURL *)url ETag:(nullable NSString *)predicateETag depth:(ODAVDepth)depth error:(NSError **)outError;
+{
+    NSString *depthName = ODAVDepthName(depth);
+
+    // Build the propfind request.  Can do this dynamically but for now we have a static request...
+    NSData *requestXML;
+    {
+        __autoreleasing NSError *error;
+        OFXMLDocument *requestDocument = [[OFXMLDocument alloc] initWithRootElementName:@"propfind"
+                                                                           namespaceURL:[NSURL URLWithString:DAVNamespaceString]
+                                                                     whitespaceBehavior:[OFXMLWhitespaceBehavior ignoreWhitespaceBehavior]
+                                                                         stringEncoding:kCFStringEncodingUTF8
+                                                                                  error:&error];
+        if (!requestDocument) {
+            if (outError)
+                *outError = error;
+            return nil;
+        }
+        
+        //[[requestDocument topElement] setAttribute:@"xmlns" string:DAVNamespaceString];
+        [requestDocument pushElement:@"prop"];
+        {
+            [requestDocument pushElement:@"resourcetype"];
+            [requestDocument popElement];
+            [requestDocument pushElement:@"getcontentlength"];
+            [requestDocument popElement];
+            [requestDocument pushElement:@"getlastmodified"];
+            [requestDocument popElement];
+            [requestDocument pushElement:@"getetag"];
+            [requestDocument popElement];
+        }
+        [requestDocument popElement];
+        
+        requestXML = [requestDocument xmlData:&error];
+        
+        DEBUG_DAV(3, @"requestXML = %@", [NSString stringWithData:requestXML encoding:NSUTF8StringEncoding]);
+        
+        
+        if (!requestXML) {
+            if (outError)
+                *outError = error;
+            return nil;
+        }
+        
+        //NSData *requestXML = [@"<?xml version=\"1.0\" encoding=\"utf-8\"?>\n<propfind xmlns=\"DAV:\"><prop>\n<resourcetype xmlns=\"DAV:\"/>\n</prop></propfind>" dataUsingEncoding:NSUTF8StringEncoding];
+    }
+    
+    NSMutableURLRequest *request = [self _requestForURL:url];
+    {
+        [request setHTTPMethod:@"PROPFIND"];
+        [request setHTTPBody:requestXML];
+        [request setValue:depthName forHTTPHeaderField:@"Depth"];
+        
+        if (![NSString isEmptyString:predicateETag])
+            [request setValue:predicateETag forHTTPHeaderField:@"If-Match"];
+        
+        // Specify that we are sending XML
+        [request setValue:@"text/xml; charset=\"utf-8\"" forHTTPHeaderField:@"Content-Type"];
+        
+        // ... and that we want XML back
+        [request setValue:@"text/xml,application/xml" forHTTPHeaderField:@"Accept"];
+    }
+    
+    return request;
+}
+
+// If we followed redirects while doing the PROPFIND, it's important to interpret the result URLs relative to the URL of the request we actually got them from, instead of from some earlier request which may have been to a different scheme/host/whatever.
+static NSURL *_resultsBaseURLForOperation(ODAVOperation *operation, NSURL *url)
+{
+    ODAVRedirect *lastRedirect = [operation.redirects lastObject];
+    if (lastRedirect)
+        return lastRedirect.to;
+    return url;
+}
+
+static ODAVMultipleFileInfoResult *_multipleFileInfoResultForOperation(ODAVOperation *operation, NSURL *url)
+{
+    ODAVMultipleFileInfoResult *result = [ODAVMultipleFileInfoResult new];
+    
+    NSArray *redirs = operation.redirects;
+    if ([redirs count])
+        result.redirects = redirs;
+    
+    // We could avoid parsing the Date header unless it is requested, but for now I'd like to get assertion failures when a server doesn't return it.
+    result.serverDate = _serverDateForOperation(operation);
+    OBASSERT(result.serverDate);
+    
+    return result;
+}
+
 - (void)_runRequestExpectingResultData:(NSURLRequest *)request completionHandler:(ODAVConnectionURLAndDataCompletionHandler)completionHandler;
 {
     completionHandler = [completionHandler copy];
@@ -1833,162 +1938,4 @@ static OFXMLDocument * _Nullable ODAVParseXMLResult(NSObject *self, NSData *resp
     }
 }
 
-static BOOL wrongElementError(NSString *expected, NSString * _Nullable subreason, NSString *originDescription, NSURL * _Nullable underlyingURL, OBNSErrorOutType outError)
-{
-    if (outError) {
-        NSMutableDictionary *uinfo = [NSMutableDictionary dictionary];
-        [uinfo setObject:[NSString stringWithFormat:NSLocalizedStringFromTableInBundle(@"Expected “%@” element missing in multistatus result from %@", @"OmniDAV", OMNI_BUNDLE, @"parsing a multistatus response, expected a particular XML element but found something else"), expected, originDescription]
-                  forKey:NSLocalizedDescriptionKey];
-        if (subreason)
-            [uinfo setObject:subreason forKey:NSLocalizedFailureReasonErrorKey];
-        if (underlyingURL)
-            [uinfo setObject:underlyingURL forKey:NSURLErrorKey];
-        
-        *outError = [NSError errorWithDomain:ODAVErrorDomain
-                                        code:ODAVOperationInvalidMultiStatusResponse
-                                    userInfo:uinfo];
-    }
-    
-    return NO;
-}
-
-static BOOL checkExpectedElement(OFXMLCursor *cursor, NSString *expected, NSString *originDescription, NSURL *underlyingURL, OBNSErrorOutType outError)
-{
-    if (![[cursor name] isEqualToString:@"multistatus"]) {
-        NSString *reason = [NSString stringWithFormat:@"Expected <%@> but found <%@>", expected, cursor.name];
-        return wrongElementError(expected, reason, originDescription, underlyingURL, outError);
-    }
-    
-    return YES;
-}
-
-static NSMutableArray <ODAVFileInfo *> * _Nullable ODAVParseMultistatus(OFXMLDocument *doc, NSString *originDescription, NSURL *resultsBaseURL, NSInteger *outShortestEntryIndex, OBNSErrorOutType outError)
-{
-    NSMutableArray <ODAVFileInfo *> *fileInfos = [NSMutableArray array];
-    
-    NSString *shortestEntryPath = nil;
-    NSInteger shortestEntryIndex = NSNotFound;
-    
-    // We'll get back a <multistatus> with multiple <response> elements, each having <href> and <propstat>
-    OFXMLCursor *cursor = [doc cursor];
-    if (!checkExpectedElement(cursor, @"multistatus", originDescription, resultsBaseURL, outError))
-        return nil;
-    
-    while ([cursor openNextChildElementNamed:@"response"]) {
-        
-        OBASSERT([[cursor name] isEqualToString:@"response"]);
-        {
-            if (![cursor openNextChildElementNamed:@"href"]) {
-                wrongElementError(@"href", nil, originDescription, resultsBaseURL, outError);
-                return nil;
-            }
-            
-            NSString *responsePath = OFCharacterDataFromElement([cursor currentElement]);
-            [cursor closeElement]; // href
-            //NSLog(@"responsePath = %@", responsePath);
-            
-            // There will one propstat element per status.  If there is a directory, for example, we'll get one for the resource type with status200 and one for the getcontentlength with status=404.
-            // For files, there should be one propstat with both in the same <prop>.
-            
-            BOOL exists = NO;
-            BOOL directory = NO;
-            BOOL hasPropstat = NO;
-            off_t size = 0;
-            NSDate *dateModified = nil;
-            NSString *ETag = nil;
-            NSMutableArray *unexpectedPropstatElements = nil;
-            
-            while ([cursor openNextChildElementNamed:@"propstat"]) {
-                hasPropstat = YES;
-                
-                OFXMLElement *anElement;
-                while( (anElement = [cursor nextChild]) != nil ) {
-                    NSString *childName = [anElement name];
-                    if ([childName isEqualToString:@"prop"]) {
-                        OFXMLElement *propElement;
-                        if ([anElement firstChildAtPath:@"resourcetype/collection"])
-                            directory = YES;
-                        else if ( (propElement = [anElement firstChildNamed:@"getcontentlength"]) != nil ) {
-                            NSString *sizeString = OFCharacterDataFromElement(propElement);
-                            size = [sizeString unsignedLongLongValue];
-                        }
-                        
-                        if ( (propElement = [anElement firstChildNamed:@"getlastmodified"]) != nil ) {
-                            NSString *lastModified = OFCharacterDataFromElement(propElement);
-                            dateModified = [[NSDate alloc] initWithHTTPString:lastModified];
-                        }
-                        
-                        if ( (propElement = [anElement firstChildNamed:@"getetag"]) != nil ) {
-                            ETag = OFCharacterDataFromElement(propElement);
-                        }
-                    } else if ([childName isEqualToString:@"status"]) {
-                        NSString *statusLine = OFCharacterDataFromElement(anElement);
-                        // statusLine ~ "HTTP/1.1 200 OK we rule"
-                        NSRange l = [statusLine rangeOfString:@" "];
-                        if (l.length > 0 && [[statusLine substringWithRange:(NSRange){NSMaxRange(l), 1}] isEqualToString:@"2"])
-                            exists = YES;
-                        
-                        // If we get a 404, or other error, that doesn't mean this resource doesn't exist: it just means this property doesn't exist on this resource.
-                        // But every resource should have either a resourcetype or getcontentlength property, which will be returned to us with a 2xx status.
-                    } else {
-#ifdef OMNI_ASSERTIONS_ON
-                        // Always log the unexpected element if assertions are enabled.
-                        NSLog(@"Unexpected propstat element: %@", [anElement name]);
-#endif
-                        // Collect the unexpected propstat elements for logging later, if necessary.
-                        if (unexpectedPropstatElements == nil)
-                            unexpectedPropstatElements = [NSMutableArray array];
-                        
-                        [unexpectedPropstatElements addObject:anElement];
-                        
-                    }
-                }
-                [cursor closeElement]; // propstat
-            }
-            
-            if (!hasPropstat) {
-                NSLog(@"No propstat element found for path '%@' of PROPFIND of %@", responsePath, resultsBaseURL);
-                if ([unexpectedPropstatElements count] > 0)
-                    NSLog(@"Unexpected propstat elements: %@", [unexpectedPropstatElements valueForKey:@"name"]);
-                
-                continue;
-            }
-            
-            // We used to remove the trailing slash here to normalize, but now we do that closer to where we need it.
-            // If we make a request for this URL later, we should use the URL exactly as the server gave it to us, slash or not.
-            
-            NSURL *fullURL = [NSURL URLWithString:responsePath relativeToURL:resultsBaseURL];
-            if (fullURL == nil) {
-                // If a PROPFIND result's path comes back unencoded (as with Apache/2.2.26 + svn/1.8.10) then let's try encoding it.
-                fullURL = [NSURL URLWithString:[NSString encodeURLString:responsePath asQuery:NO leaveSlashes:YES leaveColons:YES] relativeToURL:resultsBaseURL];
-                if (fullURL == nil) {
-                    __autoreleasing NSError *error;
-                    NSString *reason = [NSString stringWithFormat:@"Unable to parse path “%@” in PROPFIND result from %@.", responsePath, originDescription];
-                    ODAVError(&error, ODAVOperationInvalidPath, @"Invalid path in PROPFIND result", reason);
-                    return nil;
-                }
-            }
-            
-            ODAVFileInfo *info = [[ODAVFileInfo alloc] initWithOriginalURL:fullURL name:nil exists:exists directory:directory size:size lastModifiedDate:dateModified ETag:ETag];
-            [fileInfos addObject:info];
-            
-            // When we PROPFIND a collection, we get the collection's info itself, mixed with the info of its contents.
-            // My reading of RFC4918 [5.2] is that all of the contained items MUST have URLs consisting of the container's URL plus one path component.
-            // (The resources may be available at other URLs as well, but I *think* those URLs will not be returned in our multistatus.)
-            // If so, and ignoring the possibility of resources with zero-length names, the container will be the item with the shortest path.
-            // Keep track of the shortest path, and tell the caller which one it was.
-            if (!shortestEntryPath || (shortestEntryPath.length > responsePath.length)) {
-                shortestEntryPath = responsePath;
-                shortestEntryIndex = [fileInfos count] - 1;
-            }
-        }
-        [cursor closeElement]; // response
-    }
-    
-    if (outShortestEntryIndex)
-        *outShortestEntryIndex = shortestEntryIndex;
-    
-    return fileInfos;
-}
-
 NS_ASSUME_NONNULL_END
@@ -0,0 +1,40 @@
+// Copyright 2026 Omni Development, Inc. All rights reserved.
+//
+// This software may only be used and reproduced according to the
+// terms in the file OmniSourceLicense.html, which should be
+// distributed with this project and can also be found at
+// <http://www.omnigroup.com/developer/sourcecode/sourcelicense/>.
+
+#import <Foundation/NSObject.h>
+
+@class NSArray, NSData, NSError, NSString, NSURL;
+@class ODAVFileInfo;
+
+NS_ASSUME_NONNULL_BEGIN
+
+typedef void (^ODAVMultistatusBatchHandler)(NSArray <ODAVFileInfo *> *fileInfos);
+
+/*
+ Parses the multistatus response to a PROPFIND as it arrives, handing each group of batchSize file infos to the batch handler as their <response> elements are closed. Only the <response> being parsed is kept around, so memory use doesn't grow with the size of the collection.
+ */
+@interface ODAVMultistatusParser : NSObject
+
+// Parses a complete response all at once, collecting the results into one array.
++ (nullable NSArray <ODAVFileInfo *> *)fileInfosFromData:(NSData *)data baseURL:(NSURL *)baseURL originDescription:(NSString *)originDescription error:(NSError **)outError;
+
+- (instancetype)init NS_UNAVAILABLE;
+// Results are resolved relative to baseURL, which should be the URL the response actually came from (after any redirects). The origin description is only used in error messages.
+- (instancetype)initWithBaseURL:(NSURL *)baseURL originDescription:(NSString *)originDescription batchSize:(NSUInteger)batchSize batchHandler:(ODAVMultistatusBatchHandler)batchHandler NS_DESIGNATED_INITIALIZER;
+
+// Returns NO if the data isn't part of a well-formed multistatus response, after which the parse is over.
+- (BOOL)parseData:(NSData *)data error:(NSError **)outError;
+
+// Checks that the response was complete and hands any remaining file infos to the batch handler.
+- (BOOL)finishParsing:(NSError **)outError;
+
+@property(nonatomic,readonly) NSUInteger fileInfoCount; // How many have been handed to the batch handler so far
+@property(nonatomic,readonly) NSUInteger shortestEntryIndex; // Index of the entry with the shortest path (the collection itself, when listing a collection), or NSNotFound
+
+@end
+
+NS_ASSUME_NONNULL_END
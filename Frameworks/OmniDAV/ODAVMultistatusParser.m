@@ -0,0 +1,392 @@
+// Copyright 2026 Omni Development, Inc. All rights reserved.
+//
+// This software may only be used and reproduced according to the
+// terms in the file OmniSourceLicense.html, which should be
+// distributed with this project and can also be found at
+// <http://www.omnigroup.com/developer/sourcecode/sourcelicense/>.
+
+#import <OmniDAV/ODAVMultistatusParser.h>
+
+#import <OmniDAV/ODAVErrors.h>
+#import <OmniDAV/ODAVFileInfo.h>
+#import <OmniFoundation/NSDate-OFExtensions.h>
+#import <OmniFoundation/NSString-OFConversion.h>
+#import <OmniFoundation/NSString-OFURLEncoding.h>
+#import <OmniFoundation/OFXMLParser.h>
+#import <OmniFoundation/OFXMLQName.h>
+#import <OmniFoundation/OFXMLWhitespaceBehavior.h>
+#import <OmniBase/OmniBase.h>
+
+RCS_ID("$Id$")
+
+OB_REQUIRE_ARC
+
+NS_ASSUME_NONNULL_BEGIN
+
+// Element depths in "<multistatus><response><propstat><prop><resourcetype><collection/>...". We only look at direct children, as the DOM-based parser this replaced did.
+enum {
+    MultistatusDepth = 1,
+    ResponseDepth,
+    ResponseChildDepth,
+    PropstatChildDepth,
+    PropChildDepth,
+    ResourceTypeChildDepth,
+};
+
+typedef NS_ENUM(NSUInteger, ODAVMultistatusText) {
+    ODAVMultistatusTextNone,
+    ODAVMultistatusTextHref,
+    ODAVMultistatusTextStatus,
+    ODAVMultistatusTextContentLength,
+    ODAVMultistatusTextLastModified,
+    ODAVMultistatusTextETag,
+};
+
+@interface ODAVMultistatusParser () <OFXMLParserTarget>
+@end
+
+@implementation ODAVMultistatusParser
+{
+    NSURL *_baseURL;
+    NSString *_originDescription;
+    NSUInteger _batchSize;
+    ODAVMultistatusBatchHandler _batchHandler;
+
+    OFXMLParser *_xmlParser; // nil once the parse is over
+    NSError *_error;
+    NSUInteger _depth;
+    NSMutableArray <ODAVFileInfo *> *_batch;
+    NSString *_shortestEntryPath;
+
+    // The character data we are currently collecting, if any
+    ODAVMultistatusText _textKind;
+    NSMutableString *_text;
+
+    // The current <response>
+    BOOL _inResponse;
+    NSString *_responsePath;
+    BOOL _hasPropstat;
+    BOOL _exists;
+    BOOL _directory;
+    off_t _size;
+    NSDate *_lastModifiedDate;
+    NSString *_ETag;
+
+    // The current <propstat> and <prop>. There will one propstat element per status. If there is a directory, for example, we'll get one for the resource type with status 200 and one for the getcontentlength with status 404. For files, there should be one propstat with both in the same <prop>.
+    BOOL _inPropstat;
+    BOOL _inProp;
+    BOOL _inResourceType;
+    BOOL _propIsCollection;
+    BOOL _propHasContentLength;
+    off_t _propContentLength;
+}
+
++ (nullable NSArray <ODAVFileInfo *> *)fileInfosFromData:(NSData *)data baseURL:(NSURL *)baseURL originDescription:(NSString *)originDescription error:(NSError **)outError;
+{
+    NSMutableArray <ODAVFileInfo *> *fileInfos = [NSMutableArray array];
+    ODAVMultistatusParser *parser = [[self alloc] initWithBaseURL:baseURL originDescription:originDescription batchSize:NSUIntegerMax batchHandler:^(NSArray <ODAVFileInfo *> *batch) {
+        [fileInfos addObjectsFromArray:batch];
+    }];
+
+    if (![parser parseData:data error:outError] || ![parser finishParsing:outError])
+        return nil;
+    return fileInfos;
+}
+
+- (instancetype)initWithBaseURL:(NSURL *)baseURL originDescription:(NSString *)originDescription batchSize:(NSUInteger)batchSize batchHandler:(ODAVMultistatusBatchHandler)batchHandler;
+{
+    OBPRECONDITION(baseURL);
+    OBPRECONDITION(batchSize > 0);
+    OBPRECONDITION(batchHandler);
+
+    if (!(self = [super init]))
+        return nil;
+
+    _baseURL = [baseURL copy];
+    _originDescription = [originDescription copy];
+    _batchSize = MAX(batchSize, 1UL);
+    _batchHandler = [batchHandler copy];
+
+    _xmlParser = [[OFXMLParser alloc] initWithWhitespaceBehavior:[OFXMLWhitespaceBehavior ignoreWhitespaceBehavior] defaultWhitespaceBehavior:OFXMLWhitespaceBehaviorTypeIgnore target:self];
+    _batch = [NSMutableArray array];
+    _shortestEntryIndex = NSNotFound;
+
+    return self;
+}
+
+- (BOOL)parseData:(NSData *)data error:(NSError **)outError;
+{
+    if (!_xmlParser) {
+        // Already failed or finished
+        ODAVError(outError, ODAVOperationInvalidMultiStatusResponse, @"Multistatus response already parsed", nil);
+        return NO;
+    }
+
+    BOOL success = [_xmlParser parseIncrementalData:data error:outError];
+    return [self _checkParseResult:success error:outError];
+}
+
+- (BOOL)finishParsing:(NSError **)outError;
+{
+    if (!_xmlParser) {
+        ODAVError(outError, ODAVOperationInvalidMultiStatusResponse, @"Multistatus response already parsed", nil);
+        return NO;
+    }
+
+    BOOL success = [_xmlParser finishIncrementalParse:outError];
+    if (![self _checkParseResult:success error:outError])
+        return NO;
+
+    _xmlParser = nil;
+    [self _flushBatch];
+    return YES;
+}
+
+#pragma mark - OFXMLParserTarget
+
+- (void)parser:(OFXMLParser *)parser startElementWithQName:(OFXMLQName *)qname attributeSlices:(const OFXMLParserAttributeSlice *)attributes count:(NSUInteger)attributeCount;
+{
+    _depth++;
+    if (_error)
+        return;
+
+    NSString *name = qname.name;
+    switch (_depth) {
+        case MultistatusDepth:
+            if (![name isEqualToString:@"multistatus"]) {
+                NSString *reason = [NSString stringWithFormat:@"Expected <multistatus> but found <%@>", name];
+                [self _wrongElement:@"multistatus" reason:reason];
+            }
+            break;
+        case ResponseDepth:
+            if ([name isEqualToString:@"response"])
+                [self _beginResponse];
+            break;
+        case ResponseChildDepth:
+            if (!_inResponse)
+                break;
+            if ([name isEqualToString:@"href"]) {
+                if (!_responsePath)
+                    [self _beginText:ODAVMultistatusTextHref];
+            } else if ([name isEqualToString:@"propstat"]) {
+                _inPropstat = YES;
+                _hasPropstat = YES;
+            }
+            break;
+        case PropstatChildDepth:
+            if (!_inPropstat)
+                break;
+            if ([name isEqualToString:@"prop"]) {
+                _inProp = YES;
+                _propIsCollection = NO;
+                _propHasContentLength = NO;
+            } else if ([name isEqualToString:@"status"]) {
+                [self _beginText:ODAVMultistatusTextStatus];
+            } else {
+#ifdef OMNI_ASSERTIONS_ON
+                NSLog(@"Unexpected propstat element: %@", name);
+#endif
+            }
+            break;
+        case PropChildDepth:
+            if (!_inProp)
+                break;
+            if ([name isEqualToString:@"resourcetype"])
+                _inResourceType = YES;
+            else if ([name isEqualToString:@"getcontentlength"])
+                [self _beginText:ODAVMultistatusTextContentLength];
+            else if ([name isEqualToString:@"getlastmodified"])
+                [self _beginText:ODAVMultistatusTextLastModified];
+            else if ([name isEqualToString:@"getetag"])
+                [self _beginText:ODAVMultistatusTextETag];
+            break;
+        case ResourceTypeChildDepth:
+            if (_inResourceType && [name isEqualToString:@"collection"])
+                _propIsCollection = YES;
+            break;
+        default:
+            break;
+    }
+}
+
+- (void)parser:(OFXMLParser *)parser addTextSlice:(OFXMLParserSlice)text;
+{
+    if (_textKind == ODAVMultistatusTextNone || _error)
+        return;
+
+    NSString *string = OFXMLParserSliceCopyString(text);
+    if (_text)
+        [_text appendString:string];
+    else
+        _text = [string mutableCopy];
+}
+
+- (void)parser:(OFXMLParser *)parser endElementWithQName:(OFXMLQName *)qname;
+{
+    NSUInteger depth = _depth;
+    _depth--;
+    if (_error)
+        return;
+
+    switch (depth) {
+        case ResponseDepth:
+            if (_inResponse)
+                [self _endResponse];
+            break;
+        case ResponseChildDepth:
+            if (_textKind == ODAVMultistatusTextHref)
+                _responsePath = [self _endText] ?: @"";
+            _inPropstat = NO;
+            break;
+        case PropstatChildDepth:
+            if (_textKind == ODAVMultistatusTextStatus) {
+                // statusLine ~ "HTTP/1.1 200 OK we rule"
+                NSString *statusLine = [self _endText];
+                NSRange l = [statusLine rangeOfString:@" "];
+                if (l.length > 0 && NSMaxRange(l) < [statusLine length] && [statusLine characterAtIndex:NSMaxRange(l)] == '2')
+                    _exists = YES;
+
+                // If we get a 404, or other error, that doesn't mean this resource doesn't exist: it just means this property doesn't exist on this resource.
+                // But every resource should have either a resourcetype or getcontentlength property, which will be returned to us with a 2xx status.
+            } else if (_inProp) {
+                if (_propIsCollection)
+                    _directory = YES;
+                else if (_propHasContentLength)
+                    _size = _propContentLength;
+                _inProp = NO;
+            }
+            break;
+        case PropChildDepth:
+            switch (_textKind) {
+                case ODAVMultistatusTextContentLength:
+                    _propContentLength = [[self _endText] unsignedLongLongValue];
+                    _propHasContentLength = YES;
+                    break;
+                case ODAVMultistatusTextLastModified:
+                    _lastModifiedDate = [[NSDate alloc] initWithHTTPString:[self _endText] ?: @""];
+                    break;
+                case ODAVMultistatusTextETag:
+                    _ETag = [self _endText];
+                    break;
+                default:
+                    break;
+            }
+            _inResourceType = NO;
+            break;
+        default:
+            break;
+    }
+}
+
+#pragma mark - Private
+
+- (BOOL)_checkParseResult:(BOOL)success error:(NSError **)outError;
+{
+    if (success && !_error)
+        return YES;
+
+    if (_error && outError)
+        *outError = _error;
+    _xmlParser = nil; // Abandons the rest of the document
+    return NO;
+}
+
+- (void)_wrongElement:(NSString *)expected reason:(nullable NSString *)reason;
+{
+    OBPRECONDITION(_error == nil);
+
+    NSMutableDictionary *userInfo = [NSMutableDictionary dictionary];
+    userInfo[NSLocalizedDescriptionKey] = [NSString stringWithFormat:NSLocalizedStringFromTableInBundle(@"Expected “%@” element missing in multistatus result from %@", @"OmniDAV", OMNI_BUNDLE, @"parsing a multistatus response, expected a particular XML element but found something else"), expected, _originDescription];
+    if (reason)
+        userInfo[NSLocalizedFailureReasonErrorKey] = reason;
+    userInfo[NSURLErrorKey] = _baseURL;
+
+    _error = [NSError errorWithDomain:ODAVErrorDomain code:ODAVOperationInvalidMultiStatusResponse userInfo:userInfo];
+}
+
+- (void)_beginText:(ODAVMultistatusText)kind;
+{
+    OBPRECONDITION(_textKind == ODAVMultistatusTextNone);
+    _textKind = kind;
+    _text = nil;
+}
+
+- (nullable NSString *)_endText;
+{
+    NSString *text = [_text copy];
+    _textKind = ODAVMultistatusTextNone;
+    _text = nil;
+    return text;
+}
+
+- (void)_beginResponse;
+{
+    _inResponse = YES;
+    _responsePath = nil;
+    _hasPropstat = NO;
+    _exists = NO;
+    _directory = NO;
+    _size = 0;
+    _lastModifiedDate = nil;
+    _ETag = nil;
+}
+
+- (void)_endResponse;
+{
+    _inResponse = NO;
+
+    if (!_responsePath) {
+        [self _wrongElement:@"href" reason:nil];
+        return;
+    }
+
+    if (!_hasPropstat) {
+        NSLog(@"No propstat element found for path '%@' of PROPFIND of %@", _responsePath, _baseURL);
+        return;
+    }
+
+    // We used to remove the trailing slash here to normalize, but now we do that closer to where we need it.
+    // If we make a request for this URL later, we should use the URL exactly as the server gave it to us, slash or not.
+    NSURL *fullURL = [NSURL URLWithString:_responsePath relativeToURL:_baseURL];
+    if (fullURL == nil) {
+        // If a PROPFIND result's path comes back unencoded (as with Apache/2.2.26 + svn/1.8.10) then let's try encoding it.
+        fullURL = [NSURL URLWithString:[NSString encodeURLString:_responsePath asQuery:NO leaveSlashes:YES leaveColons:YES] relativeToURL:_baseURL];
+        if (fullURL == nil) {
+            __autoreleasing NSError *error;
+            NSString *reason = [NSString stringWithFormat:@"Unable to parse path “%@” in PROPFIND result from %@.", _responsePath, _originDescription];
+            ODAVError(&error, ODAVOperationInvalidPath, @"Invalid path in PROPFIND result", reason);
+            _error = error;
+            return;
+        }
+    }
+
+    ODAVFileInfo *info = [[ODAVFileInfo alloc] initWithOriginalURL:fullURL name:nil exists:_exists directory:_directory size:_size lastModifiedDate:_lastModifiedDate ETag:_ETag];
+    [_batch addObject:info];
+
+    // When we PROPFIND a collection, we get the collection's info itself, mixed with the info of its contents.
+    // My reading of RFC4918 [5.2] is that all of the contained items MUST have URLs consisting of the container's URL plus one path component.
+    // (The resources may be available at other URLs as well, but I *think* those URLs will not be returned in our multistatus.)
+    // If so, and ignoring the possibility of resources with zero-length names, the container will be the item with the shortest path.
+    if (!_shortestEntryPath || (_shortestEntryPath.length > _responsePath.length)) {
+        _shortestEntryPath = _responsePath;
+        _shortestEntryIndex = _fileInfoCount + [_batch count] - 1;
+    }
+
+    if ([_batch count] >= _batchSize)
+        [self _flushBatch];
+}
+
+- (void)_flushBatch;
+{
+    if ([_batch count] == 0)
+        return;
+
+    NSArray <ODAVFileInfo *> *batch = _batch;
+    _batch = [NSMutableArray array];
+    _fileInfoCount += [batch count];
+    _batchHandler(batch);
+}
+
+@end
+
+NS_ASSUME_NONNULL_END
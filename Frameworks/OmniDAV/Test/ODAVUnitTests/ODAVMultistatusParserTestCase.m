@@ -0,0 +1,299 @@
+// Copyright 2026 Omni Development, Inc. All rights reserved.
+//
+// This software may only be used and reproduced according to the
+// terms in the file OmniSourceLicense.html, which should be
+// distributed with this project and can also be found at
+// <http://www.omnigroup.com/developer/sourcecode/sourcelicense/>.
+
+#import <OmniBase/OBTestCase.h>
+
+#import <OmniDAV/ODAVErrors.h>
+#import <OmniDAV/ODAVFileInfo.h>
+#import <OmniDAV/ODAVMultistatusParser.h>
+
+RCS_ID("$Id$")
+
+// Feeds canned PROPFIND responses to ODAVMultistatusParser in pieces, the way they arrive from the network. ODAVStreamingPropfindTestCase covers the same parser behind -fileInfosAtURL:ETag:depth:batchHandler:completionHandler:.
+@interface ODAVMultistatusParserTestCase : OBTestCase
+@end
+
+@implementation ODAVMultistatusParserTestCase
+
+static NSString * const LastModified = @"Sat, 17 Oct 2026 12:00:00 GMT";
+static const NSTimeInterval LastModifiedSince1970 = 1792238400;
+
+static NSURL *_baseURL(void)
+{
+    return [NSURL URLWithString:@"https://dav.example.com/dav/test/Docs/"];
+}
+
+static NSString *_fileResponse(NSString *href, off_t size, NSString *ETag)
+{
+    return [NSString stringWithFormat:
+            @"<D:response><D:href>%@</D:href>"
+            @"<D:propstat><D:prop><D:resourcetype/><D:getcontentlength>%lld</D:getcontentlength><D:getlastmodified>%@</D:getlastmodified><D:getetag>%@</D:getetag></D:prop>"
+            @"<D:status>HTTP/1.1 200 OK</D:status></D:propstat></D:response>\n", href, size, LastModified, ETag];
+}
+
+static NSString *_collectionResponse(NSString *href)
+{
+    // Collections have no content length, so servers report that property in a second propstat with a 404.
+    return [NSString stringWithFormat:
+            @"<D:response><D:href>%@</D:href>"
+            @"<D:propstat><D:prop><D:resourcetype><D:collection/></D:resourcetype><D:getlastmodified>%@</D:getlastmodified></D:prop><D:status>HTTP/1.1 200 OK</D:status></D:propstat>"
+            @"<D:propstat><D:prop><D:getcontentlength/></D:prop><D:status>HTTP/1.1 404 Not Found</D:status></D:propstat>"
+            @"</D:response>\n", href, LastModified];
+}
+
+static NSString *_multistatus(NSArray <NSString *> *responses)
+{
+    return [NSString stringWithFormat:@"<?xml version=\"1.0\" encoding=\"utf-8\"?>\n<D:multistatus xmlns:D=\"DAV:\">\n%@</D:multistatus>\n", [responses componentsJoinedByString:@""]];
+}
+
+// The collection itself is in the middle, as some servers do. The raw UTF-8 in one href puts multibyte characters in the body, so some splits land inside them.
+static NSData *_listingBody(void)
+{
+    NSString *body = _multistatus(@[
+        _fileResponse(@"/dav/test/Docs/a.txt", 10, @"\"a1\""),
+        _fileResponse(@"/dav/test/Docs/Résumé.txt", 2048, @"\"r2\""),
+        _collectionResponse(@"/dav/test/Docs/"),
+        _collectionResponse(@"/dav/test/Docs/Sub/"),
+        _fileResponse(@"/dav/test/Docs/z%20z.bin", 0, @"W/\"z3\""),
+    ]);
+    return [body dataUsingEncoding:NSUTF8StringEncoding];
+}
+
+static NSString *_summary(ODAVFileInfo *fileInfo)
+{
+    return [NSString stringWithFormat:@"%@ exists:%d directory:%d size:%lld ETag:%@ modified:%.0f", fileInfo.name, fileInfo.exists, fileInfo.isDirectory, fileInfo.size, fileInfo.ETag, [fileInfo.lastModifiedDate timeIntervalSince1970]];
+}
+
+// Parses the body in pieces ending at each of the split offsets, returning the batches delivered or nil on error.
+static NSArray <NSArray <ODAVFileInfo *> *> *_parse(NSData *body, NSArray <NSNumber *> *splitOffsets, NSUInteger batchSize, ODAVMultistatusParser **outParser, NSError **outError)
+{
+    NSMutableArray <NSArray <ODAVFileInfo *> *> *batches = [NSMutableArray array];
+    ODAVMultistatusParser *parser = [[ODAVMultistatusParser alloc] initWithBaseURL:_baseURL() originDescription:@"PROPFIND test" batchSize:batchSize batchHandler:^(NSArray <ODAVFileInfo *> *fileInfos) {
+        [batches addObject:fileInfos];
+    }];
+    if (outParser)
+        *outParser = parser;
+
+    NSUInteger offset = 0;
+    for (NSNumber *splitOffset in [splitOffsets arrayByAddingObject:@([body length])]) {
+        NSUInteger end = [splitOffset unsignedIntegerValue];
+        if (![parser parseData:[body subdataWithRange:NSMakeRange(offset, end - offset)] error:outError])
+            return nil;
+        offset = end;
+    }
+    if (![parser finishParsing:outError])
+        return nil;
+
+    return batches;
+}
+
+static NSArray <NSString *> *_summaries(NSArray <NSArray <ODAVFileInfo *> *> *batches)
+{
+    NSMutableArray <NSString *> *summaries = [NSMutableArray array];
+    for (NSArray <ODAVFileInfo *> *batch in batches) {
+        for (ODAVFileInfo *fileInfo in batch)
+            [summaries addObject:_summary(fileInfo)];
+    }
+    return summaries;
+}
+
+- (void)testFields;
+{
+    __autoreleasing NSError *error;
+    NSArray <ODAVFileInfo *> *fileInfos;
+    OBShouldNotError(fileInfos = [ODAVMultistatusParser fileInfosFromData:_listingBody() baseURL:_baseURL() originDescription:@"PROPFIND test" error:&error]);
+    XCTAssertEqual([fileInfos count], 5UL);
+
+    NSDate *lastModified = [NSDate dateWithTimeIntervalSince1970:LastModifiedSince1970];
+
+    ODAVFileInfo *file = fileInfos[0];
+    XCTAssertEqualObjects(file.originalURL, [NSURL URLWithString:@"https://dav.example.com/dav/test/Docs/a.txt"]);
+    XCTAssertEqualObjects(file.name, @"a.txt");
+    XCTAssertTrue(file.exists);
+    XCTAssertFalse(file.isDirectory);
+    XCTAssertEqual(file.size, 10);
+    XCTAssertEqualObjects(file.ETag, @"\"a1\"");
+    XCTAssertEqualObjects(file.lastModifiedDate, lastModified);
+
+    // An href that came back without percent escapes.
+    XCTAssertEqualObjects(fileInfos[1].name, @"Résumé.txt");
+    XCTAssertEqual(fileInfos[1].size, 2048);
+
+    ODAVFileInfo *collection = fileInfos[2];
+    XCTAssertEqualObjects(collection.name, @"Docs");
+    XCTAssertTrue(collection.exists, @"A 404 for one property shouldn't hide the resource");
+    XCTAssertTrue(collection.isDirectory);
+    XCTAssertEqual(collection.size, 0);
+    XCTAssertNil(collection.ETag);
+    XCTAssertEqualObjects(collection.lastModifiedDate, lastModified);
+
+    XCTAssertTrue(fileInfos[3].isDirectory);
+    XCTAssertEqualObjects(fileInfos[3].name, @"Sub");
+
+    XCTAssertEqualObjects(fileInfos[4].name, @"z z.bin");
+    XCTAssertEqual(fileInfos[4].size, 0);
+    XCTAssertFalse(fileInfos[4].isDirectory);
+    XCTAssertEqualObjects(fileInfos[4].ETag, @"W/\"z3\"");
+}
+
+- (void)testSplitAtEveryByte;
+{
+    NSData *body = _listingBody();
+
+    __autoreleasing NSError *error;
+    NSArray <NSString *> *expected;
+    OBShouldNotError(expected = _summaries(_parse(body, @[], NSUIntegerMax, NULL, &error)));
+    XCTAssertEqual([expected count], 5UL);
+
+    // Two pieces, split at every offset: inside tags, attribute values, text, and multibyte characters.
+    for (NSUInteger splitOffset = 1; splitOffset < [body length]; splitOffset++) {
+        NSArray <NSArray <ODAVFileInfo *> *> *batches = _parse(body, @[@(splitOffset)], NSUIntegerMax, NULL, &error);
+        XCTAssertNotNil(batches, @"Split at %lu failed with %@", splitOffset, error);
+        XCTAssertEqualObjects(_summaries(batches), expected, @"Split at %lu", splitOffset);
+    }
+
+    // One byte at a time.
+    NSMutableArray <NSNumber *> *everyByte = [NSMutableArray array];
+    for (NSUInteger offset = 1; offset < [body length]; offset++)
+        [everyByte addObject:@(offset)];
+    NSArray <NSArray <ODAVFileInfo *> *> *batches;
+    OBShouldNotError(batches = _parse(body, everyByte, NSUIntegerMax, NULL, &error));
+    XCTAssertEqualObjects(_summaries(batches), expected);
+}
+
+- (void)testBatchSizesAndOrder;
+{
+    NSData *body = _listingBody();
+
+    __autoreleasing NSError *error;
+    ODAVMultistatusParser *parser;
+    NSArray <NSArray <ODAVFileInfo *> *> *batches;
+    OBShouldNotError(batches = _parse(body, @[@([body length] / 3), @(2 * [body length] / 3)], 2, &parser, &error));
+
+    // Full batches as the responses close, and the rest when parsing finishes.
+    XCTAssertEqual([batches count], 3UL);
+    XCTAssertEqual([batches[0] count], 2UL);
+    XCTAssertEqual([batches[1] count], 2UL);
+    XCTAssertEqual([batches[2] count], 1UL);
+    XCTAssertEqual(parser.fileInfoCount, 5UL);
+
+    NSMutableArray <NSString *> *names = [NSMutableArray array];
+    for (NSArray <ODAVFileInfo *> *batch in batches) {
+        for (ODAVFileInfo *fileInfo in batch)
+            [names addObject:fileInfo.name];
+    }
+    NSArray <NSString *> *expectedNames = @[@"a.txt", @"Résumé.txt", @"Docs", @"Sub", @"z z.bin"];
+    XCTAssertEqualObjects(names, expectedNames, @"File infos should arrive in document order");
+}
+
+- (void)testShortestEntryIndex;
+{
+    __autoreleasing NSError *error;
+    ODAVMultistatusParser *parser;
+
+    // Counted across batches, not within one.
+    OBShouldNotError(_parse(_listingBody(), @[], 2, &parser, &error));
+    XCTAssertEqual(parser.shortestEntryIndex, 2UL);
+
+    NSData *collectionLast = [_multistatus(@[_fileResponse(@"/dav/test/Docs/a.txt", 1, @"\"a\""), _collectionResponse(@"/dav/test/Docs/")]) dataUsingEncoding:NSUTF8StringEncoding];
+    OBShouldNotError(_parse(collectionLast, @[], 1, &parser, &error));
+    XCTAssertEqual(parser.shortestEntryIndex, 1UL);
+
+    NSData *empty = [_multistatus(@[]) dataUsingEncoding:NSUTF8StringEncoding];
+    NSArray <NSArray <ODAVFileInfo *> *> *batches;
+    OBShouldNotError(batches = _parse(empty, @[], 1, &parser, &error));
+    XCTAssertEqual([batches count], 0UL);
+    XCTAssertEqual(parser.shortestEntryIndex, NSNotFound);
+}
+
+- (void)testFirstBatchArrivesBeforeBodyEnds;
+{
+    NSData *body = _listingBody();
+    NSData *firstResponseEnd = [@"</D:response>" dataUsingEncoding:NSUTF8StringEncoding];
+    NSRange range = [body rangeOfData:firstResponseEnd options:0 range:NSMakeRange(0, [body length])];
+    XCTAssertNotEqual(range.location, (NSUInteger)NSNotFound);
+
+    NSMutableArray <NSArray <ODAVFileInfo *> *> *batches = [NSMutableArray array];
+    ODAVMultistatusParser *parser = [[ODAVMultistatusParser alloc] initWithBaseURL:_baseURL() originDescription:@"PROPFIND test" batchSize:1 batchHandler:^(NSArray <ODAVFileInfo *> *fileInfos) {
+        [batches addObject:fileInfos];
+    }];
+
+    __autoreleasing NSError *error;
+
+    // Everything up to just before the first response closes.
+    NSUInteger offset = range.location;
+    OBShouldNotError([parser parseData:[body subdataWithRange:NSMakeRange(0, offset)] error:&error]);
+    XCTAssertEqual([batches count], 0UL);
+
+    // The close tag and a bit of the next response, but nowhere near the end.
+    NSUInteger end = NSMaxRange(range) + 20;
+    OBShouldNotError([parser parseData:[body subdataWithRange:NSMakeRange(offset, end - offset)] error:&error]);
+    XCTAssertEqual([batches count], 1UL, @"The first file info should be delivered as soon as its response is closed");
+    XCTAssertEqualObjects([batches[0][0] name], @"a.txt");
+
+    OBShouldNotError([parser parseData:[body subdataWithRange:NSMakeRange(end, [body length] - end)] error:&error]);
+    OBShouldNotError([parser finishParsing:&error]);
+    XCTAssertEqual([batches count], 5UL);
+}
+
+#pragma mark - Errors
+
+- (void)_checkInvalidMultistatus:(NSString *)body message:(NSString *)message;
+{
+    __autoreleasing NSError *error;
+    NSArray *batches = _parse([body dataUsingEncoding:NSUTF8StringEncoding], @[], 1, NULL, &error);
+    XCTAssertNil(batches, @"%@", message);
+    XCTAssertTrue([error hasUnderlyingErrorDomain:ODAVErrorDomain code:ODAVOperationInvalidMultiStatusResponse], @"%@: %@", message, error);
+}
+
+- (void)testWrongRootElement;
+{
+    [self _checkInvalidMultistatus:@"<?xml version=\"1.0\"?>\n<html><body>Service Unavailable</body></html>" message:@"An HTML error page"];
+}
+
+- (void)testResponseWithoutHref;
+{
+    NSString *body = _multistatus(@[@"<D:response><D:propstat><D:prop><D:resourcetype/></D:prop><D:status>HTTP/1.1 200 OK</D:status></D:propstat></D:response>"]);
+    [self _checkInvalidMultistatus:body message:@"A response without an href"];
+}
+
+- (void)testMalformedBodies;
+{
+    NSData *body = _listingBody();
+    NSArray <NSData *> *malformedBodies = @[
+        [NSData data],
+        [@"Internal Server Error" dataUsingEncoding:NSUTF8StringEncoding],
+        [body subdataWithRange:NSMakeRange(0, [body length] / 2)], // Cut off partway
+        [_multistatus(@[@"<D:response><D:href>/dav/test/Docs/</D:href></D:propstat></D:response>"]) dataUsingEncoding:NSUTF8StringEncoding], // Mismatched tags
+    ];
+
+    for (NSData *malformedBody in malformedBodies) {
+        __autoreleasing NSError *error;
+        XCTAssertNil(_parse(malformedBody, @[], 1, NULL, &error), @"Should reject %@", [[NSString alloc] initWithData:malformedBody encoding:NSUTF8StringEncoding]);
+        XCTAssertNotNil(error);
+    }
+}
+
+- (void)testNoParsingAfterFailure;
+{
+    ODAVMultistatusParser *parser = [[ODAVMultistatusParser alloc] initWithBaseURL:_baseURL() originDescription:@"PROPFIND test" batchSize:1 batchHandler:^(NSArray <ODAVFileInfo *> *fileInfos) {
+        XCTFail(@"Nothing should be delivered");
+    }];
+
+    __autoreleasing NSError *error;
+    XCTAssertFalse([parser parseData:[@"<?xml version=\"1.0\"?>\n<error/>" dataUsingEncoding:NSUTF8StringEncoding] error:&error]);
+
+    error = nil;
+    XCTAssertFalse([parser parseData:_listingBody() error:&error]);
+    XCTAssertTrue([error hasUnderlyingErrorDomain:ODAVErrorDomain code:ODAVOperationInvalidMultiStatusResponse]);
+
+    error = nil;
+    XCTAssertFalse([parser finishParsing:&error]);
+    XCTAssertNotNil(error);
+}
+
+@end
@@ -0,0 +1,165 @@
+// Copyright 2026 Omni Development, Inc. All rights reserved.
+//
+// This software may only be used and reproduced according to the
+// terms in the file OmniSourceLicense.html, which should be
+// distributed with this project and can also be found at
+// <http://www.omnigroup.com/developer/sourcecode/sourcelicense/>.
+
+#import "ODAVConcreteTestCase.h"
+
+#import <OmniDAV/ODAVConnection.h>
+#import <OmniDAV/ODAVErrors.h>
+#import <OmniDAV/ODAVFileInfo.h>
+
+RCS_ID("$Id$")
+
+// -fileInfosAtURL:ETag:depth:batchHandler:completionHandler: against a real server. ODAVMultistatusParserTestCase covers the parsing itself with canned responses.
+@interface ODAVStreamingPropfindTestCase : ODAVConcreteTestCase
+@end
+
+@implementation ODAVStreamingPropfindTestCase
+
+static const NSUInteger BatchSize = 100; // ODAVFileInfoBatchSize
+
+// Lists the URL, returning the batches in the order they were delivered.
+- (NSArray <NSArray <ODAVFileInfo *> *> *)_batchesAtURL:(NSURL *)url depth:(ODAVDepth)depth result:(ODAVMultipleFileInfoResult **)outResult error:(NSError **)outError;
+{
+    NSMutableArray <NSArray <ODAVFileInfo *> *> *batches = [NSMutableArray array];
+    __block ODAVMultipleFileInfoResult *returnResult;
+    __block NSError *returnError;
+    __block BOOL completed = NO;
+
+    ODAVSyncOperation(__FILE__, __LINE__, ^(ODAVOperationDone done){
+        [self.connection fileInfosAtURL:url ETag:nil depth:depth batchHandler:^(NSArray <ODAVFileInfo *> *fileInfos) {
+            XCTAssertFalse(completed, @"Batches should all be delivered before the completion handler");
+            [batches addObject:fileInfos];
+        } completionHandler:^(ODAVMultipleFileInfoResult *result, NSError *errorOrNil) {
+            completed = YES;
+            returnResult = result;
+            returnError = errorOrNil;
+            done();
+        }];
+    });
+
+    if (!returnResult) {
+        if (outError)
+            *outError = returnError;
+        return nil;
+    }
+    if (outResult)
+        *outResult = returnResult;
+    return batches;
+}
+
+- (void)testBatchesCoverCollection;
+{
+    __autoreleasing NSError *error;
+    NSURL *directory = [self.remoteBaseURL URLByAppendingPathComponent:@"dir" isDirectory:YES];
+    OBShouldNotError([self.connection synchronousMakeCollectionAtURL:directory error:&error]);
+
+    // Enough for a couple of full batches and a partial one, with a subdirectory and a name that needs escaping thrown in.
+    const NSUInteger fileCount = 2 * BatchSize + 37;
+    NSMutableDictionary <NSString *, NSNumber *> *expectedSizes = [NSMutableDictionary dictionary];
+    for (NSUInteger fileIndex = 0; fileIndex < fileCount; fileIndex++) {
+        NSString *name = (fileIndex == 0) ? @"Résumé ✓.txt" : [NSString stringWithFormat:@"file-%04lu", fileIndex];
+        NSData *data = [NSMutableData dataWithLength:fileIndex];
+        OBShouldNotError([self.connection synchronousPutData:data toURL:[directory URLByAppendingPathComponent:name] error:&error]);
+        expectedSizes[name] = @(fileIndex);
+    }
+    OBShouldNotError([self.connection synchronousMakeCollectionAtURL:[directory URLByAppendingPathComponent:@"sub" isDirectory:YES] error:&error]);
+
+    ODAVMultipleFileInfoResult *result;
+    NSArray <NSArray <ODAVFileInfo *> *> *batches;
+    OBShouldNotError(batches = [self _batchesAtURL:directory depth:ODAVDepthChildren result:&result error:&error]);
+    XCTAssertNil(result.fileInfos, @"Streamed results aren't collected again at the end");
+
+    // The files, the subdirectory and the directory itself.
+    NSUInteger totalCount = fileCount + 2;
+    XCTAssertEqual([batches count], (totalCount + BatchSize - 1) / BatchSize);
+    for (NSUInteger batchIndex = 0; batchIndex + 1 < [batches count]; batchIndex++)
+        XCTAssertEqual([batches[batchIndex] count], BatchSize);
+
+    NSMutableArray <ODAVFileInfo *> *fileInfos = [NSMutableArray array];
+    for (NSArray <ODAVFileInfo *> *batch in batches)
+        [fileInfos addObjectsFromArray:batch];
+    XCTAssertEqual([fileInfos count], totalCount);
+
+    NSMutableSet <NSString *> *seenNames = [NSMutableSet set];
+    for (ODAVFileInfo *fileInfo in fileInfos) {
+        XCTAssertTrue(fileInfo.exists);
+        XCTAssertFalse([seenNames containsObject:fileInfo.name], @"%@ was delivered twice", fileInfo.name);
+        [seenNames addObject:fileInfo.name];
+        XCTAssertNotNil(fileInfo.lastModifiedDate);
+
+        if ([fileInfo.name isEqual:@"dir"] || [fileInfo.name isEqual:@"sub"]) {
+            XCTAssertTrue(fileInfo.isDirectory, @"%@", fileInfo.name);
+            continue;
+        }
+
+        NSNumber *expectedSize = expectedSizes[fileInfo.name];
+        XCTAssertNotNil(expectedSize, @"Unexpected %@", fileInfo.name);
+        XCTAssertFalse(fileInfo.isDirectory);
+        XCTAssertEqual(fileInfo.size, [expectedSize longLongValue]);
+        XCTAssertNotNil(fileInfo.ETag);
+    }
+    XCTAssertTrue([seenNames containsObject:@"dir"]);
+    XCTAssertTrue([seenNames containsObject:@"sub"]);
+
+    // The same as the collected results. -directoryContentsAtURL: leaves out the directory itself.
+    ODAVMultipleFileInfoResult *collected;
+    OBShouldNotError(collected = [self.connection synchronousDirectoryContentsAtURL:directory withETag:nil error:&error]);
+    [seenNames removeObject:@"dir"];
+    XCTAssertEqualObjects(seenNames, [NSSet setWithArray:[collected.fileInfos valueForKey:@"name"]]);
+}
+
+- (void)testSingleFile;
+{
+    __autoreleasing NSError *error;
+    NSURL *file = [self.remoteBaseURL URLByAppendingPathComponent:@"file"];
+    OBShouldNotError([self.connection synchronousPutData:[NSMutableData dataWithLength:123] toURL:file error:&error]);
+
+    NSArray <NSArray <ODAVFileInfo *> *> *batches;
+    OBShouldNotError(batches = [self _batchesAtURL:file depth:ODAVDepthLocal result:NULL error:&error]);
+    XCTAssertEqual([batches count], 1UL);
+    XCTAssertEqual([batches[0] count], 1UL);
+
+    ODAVFileInfo *fileInfo = batches[0][0];
+    XCTAssertEqualObjects(fileInfo.name, @"file");
+    XCTAssertEqual(fileInfo.size, 123);
+    XCTAssertFalse(fileInfo.isDirectory);
+}
+
+- (void)testMissingCollectionReportsError;
+{
+    NSURL *missing = [self.remoteBaseURL URLByAppendingPathComponent:@"missing" isDirectory:YES];
+
+    __autoreleasing NSError *error;
+    NSArray <NSArray <ODAVFileInfo *> *> *batches = [self _batchesAtURL:missing depth:ODAVDepthChildren result:NULL error:&error];
+    XCTAssertNil(batches);
+    XCTAssertTrue([error hasUnderlyingErrorDomain:ODAVHTTPErrorDomain code:ODAV_HTTP_NOT_FOUND], @"%@", error);
+}
+
+- (void)testPreconditionFailure;
+{
+    __autoreleasing NSError *error;
+    NSURL *file = [self.remoteBaseURL URLByAppendingPathComponent:@"file"];
+    OBShouldNotError([self.connection synchronousPutData:[NSData data] toURL:file error:&error]);
+
+    __block NSUInteger batchCount = 0;
+    __block NSError *returnError;
+    ODAVSyncOperation(__FILE__, __LINE__, ^(ODAVOperationDone done){
+        [self.connection fileInfosAtURL:file ETag:@"\"not-the-etag\"" depth:ODAVDepthLocal batchHandler:^(NSArray <ODAVFileInfo *> *fileInfos) {
+            batchCount++;
+        } completionHandler:^(ODAVMultipleFileInfoResult *result, NSError *errorOrNil) {
+            XCTAssertNil(result);
+            returnError = errorOrNil;
+            done();
+        }];
+    });
+
+    // The error body isn't a multistatus response and shouldn't be parsed as one.
+    XCTAssertEqual(batchCount, 0UL);
+    XCTAssertTrue([returnError hasUnderlyingErrorDomain:ODAVHTTPErrorDomain code:ODAV_HTTP_PRECONDITION_FAILED], @"%@", returnError);
+}
+
+@end
@@ -42,6 +42,9 @@ extern NSInteger ODOSQLDebugLogLevel;
 
 @property(nullable, readonly) NSDictionary *committedMetadata;
 
+/// The number of extra read-only connections that the -fetchCommitted... methods may open, so that they can run concurrently with each other and with saves on the primary connection. Each query sees the most recently committed transaction as of when it started. Turning this on switches an on-disk database to write-ahead logging; in-memory databases always read through the primary connection. Defaults to the ODOReadOnlyConnectionCount user default, which is zero.
+@property (atomic) NSUInteger maximumReadOnlyConnectionCount;
+
 - (BOOL)fetchCommittedRowCount:(uint64_t *)outRowCount fromEntity:(ODOEntity *)entity matchingPredicate:(nullable NSPredicate *)predicate error:(NSError **)outError;
 
 - (BOOL)fetchCommitedInt64Sum:(int64_t *)outSum fromAttribute:(ODOAttribute *)attribute entity:(ODOEntity *)entity matchingPredicate:(nullable NSPredicate *)predicate error:(NSError **)outError;
@@ -118,9 +118,40 @@ static void ODOComparisonPredicateContainsFunction(sqlite3_context *ctx, int nAr
 
 OFDeclareDebugLogLevel(ODOSQLDebugLogLevel);
 
+// Every connection, including the read-only ones, needs these since predicates can be translated into calls to them.
+static BOOL _registerStringCompareFunctions(struct sqlite3 *sqlite, NSError **outError)
+{
+    int rc;
+    
+    rc = sqlite3_create_function(sqlite, ODOComparisonPredicateStartsWithFunctionName,
+                                 3/*nArg*/,
+                                 SQLITE_UTF8, NULL/*data*/,
+                                 ODOComparisonPredicateStartsWithFunction,
+                                 NULL /*step*/,
+                                 NULL /*final*/);
+    if (rc != SQLITE_OK) {
+        ODOSQLiteError(outError, rc, sqlite); // stack the underlying error
+        return NO;
+    }
+    
+    rc = sqlite3_create_function(sqlite, ODOComparisonPredicateContainsFunctionName,
+                                 3/*nArg*/,
+                                 SQLITE_UTF8, NULL/*data*/,
+                                 ODOComparisonPredicateContainsFunction,
+                                 NULL /*step*/,
+                                 NULL /*final*/);
+    if (rc != SQLITE_OK) {
+        ODOSQLiteError(outError, rc, sqlite); // stack the underlying error
+        return NO;
+    }
+    
+    return YES;
+}
+
 static BOOL ODOAsynchronousWrites = NO;
 static BOOL ODOKeepTemporaryStoreInMemory = NO;
 static BOOL ODOVacuumOnDisconnect = NO;
+static NSUInteger ODOReadOnlyConnectionCount = 0;
 
 @interface ODODatabase (/*Private*/)
 
@@ -129,6 +160,8 @@ static BOOL ODOVacuumOnDisconnect = NO;
 - (BOOL)_setupNewDatabase:(NSError **)outError;
 - (BOOL)_populateCachedMetadata:(NSError **)outError;
 - (BOOL)_disconnectWithoutNotifying:(NSError **)outError;
+- (ODOSQLConnection *)_checkOutReadOnlyConnection:(NSError **)outError;
+- (void)_checkInReadOnlyConnection:(ODOSQLConnection *)connection;
 
 @end
 
@@ -145,6 +178,13 @@ static BOOL ODOVacuumOnDisconnect = NO;
     NSMutableDictionary<NSString *, id> *_pendingMetadataChanges;
     
     BOOL _isFreshlyCreated; // YES if we just made the schema and -didSave hasn't been called (which should be called the first time we save a transaction; presumably having an INSERT).
+    
+    // Read-only connections for the -fetchCommitted... methods, which may be called from any thread. The condition guards everything below it.
+    NSCondition *_readOnlyConnectionsCondition;
+    NSMutableArray<ODOSQLConnection *> *_idleReadOnlyConnections;
+    NSUInteger _readOnlyConnectionCount; // Idle, checked out, or being opened
+    NSUInteger _maximumReadOnlyConnectionCount;
+    BOOL _writeAheadLoggingEnabled;
 }
 
 + (void)initialize;
@@ -153,6 +193,7 @@ static BOOL ODOVacuumOnDisconnect = NO;
     ODOAsynchronousWrites = [[NSUserDefaults standardUserDefaults] boolForKey:@"ODOAsynchronousWrites"];
     ODOKeepTemporaryStoreInMemory = [[NSUserDefaults standardUserDefaults] boolForKey:@"ODOKeepTemporaryStoreInMemory"];
     ODOVacuumOnDisconnect = [[NSUserDefaults standardUserDefaults] boolForKey:@"ODOVacuumOnDisconnect"];
+    ODOReadOnlyConnectionCount = (NSUInteger)MAX(0, [[NSUserDefaults standardUserDefaults] integerForKey:@"ODOReadOnlyConnectionCount"]);
 }
 
 - (instancetype)initWithModel:(ODOModel *)model;
@@ -165,6 +206,10 @@ static BOOL ODOVacuumOnDisconnect = NO;
     _model = [model retain];
     _cachedStatements = [[NSMutableDictionary alloc] init];
     
+    _readOnlyConnectionsCondition = [[NSCondition alloc] init];
+    _idleReadOnlyConnections = [[NSMutableArray alloc] init];
+    _maximumReadOnlyConnectionCount = ODOReadOnlyConnectionCount;
+    
     return self;
 }
 
@@ -190,6 +235,10 @@ static BOOL ODOVacuumOnDisconnect = NO;
     OBASSERT(_commitTransactionStatement == nil);
     OBASSERT(_metadataInsertStatement == nil);
 
+    OBASSERT(_readOnlyConnectionCount == 0);
+    [_idleReadOnlyConnections release];
+    [_readOnlyConnectionsCondition release];
+    
     OBASSERT(_pendingMetadataChanges == nil); // Why didn't they get saved and cleared?
     [_pendingMetadataChanges release]; // ... in case.
     [_committedMetadata release];
@@ -243,34 +292,9 @@ static BOOL ODOVacuumOnDisconnect = NO;
     }
     
     // Set up string compare functions
-    BOOL stringCompareSuccess = [_connection performSQLAndWaitWithError:outError block:^BOOL(struct sqlite3 *sqlite, NSError **blockError) {
-        int rc;
-        
-        rc = sqlite3_create_function(sqlite, ODOComparisonPredicateStartsWithFunctionName,
-                                     3/*nArg*/,
-                                     SQLITE_UTF8, NULL/*data*/,
-                                     ODOComparisonPredicateStartsWithFunction,
-                                     NULL /*step*/,
-                                     NULL /*final*/);
-        if (rc != SQLITE_OK) {
-            ODOSQLiteError(blockError, rc, sqlite); // stack the underlying error
-            return NO;
-        }
-        
-        rc = sqlite3_create_function(sqlite, ODOComparisonPredicateContainsFunctionName,
-                                     3/*nArg*/,
-                                     SQLITE_UTF8, NULL/*data*/,
-                                     ODOComparisonPredicateContainsFunction,
-                                     NULL /*step*/,
-                                     NULL /*final*/);
-        if (rc != SQLITE_OK) {
-            ODOSQLiteError(blockError, rc, sqlite); // stack the underlying error
-            return NO;
-        }
-        
-        return YES;
-    }];
-    if (!stringCompareSuccess) {
+    if (![_connection performSQLAndWaitWithError:outError block:^BOOL(struct sqlite3 *sqlite, NSError **blockError) {
+        return _registerStringCompareFunctions(sqlite, blockError);
+    }]) {
         return NO;
     }
     
@@ -413,11 +437,17 @@ static BOOL _fetchRowCountCallback(struct sqlite3 *sqlite, ODOSQLStatement *stat
 
 - (BOOL)fetchCommittedRowCount:(uint64_t *)outRowCount fromEntity:(ODOEntity *)entity matchingPredicate:(NSPredicate *)predicate error:(NSError **)outError;
 {
-    ODOSQLStatement *statement = [[ODOSQLStatement alloc] initRowCountFromEntity:entity connection:self.connection predicate:predicate error:outError];
-    if (!statement)
+    ODOSQLConnection *connection = [self _checkOutReadOnlyConnection:outError];
+    if (!connection)
         return NO;
     
-    BOOL success = [self.connection performSQLAndWaitWithError:outError block:^BOOL(struct sqlite3 *sqlite, NSError **blockError) {
+    ODOSQLStatement *statement = [[ODOSQLStatement alloc] initRowCountFromEntity:entity connection:connection predicate:predicate error:outError];
+    if (!statement) {
+        [self _checkInReadOnlyConnection:connection];
+        return NO;
+    }
+    
+    BOOL success = [connection performSQLAndWaitWithError:outError block:^BOOL(struct sqlite3 *sqlite, NSError **blockError) {
         ODOSQLStatementCallbacks callbacks;
         memset(&callbacks, 0, sizeof(callbacks));
         callbacks.row = _fetchRowCountCallback;
@@ -427,6 +457,7 @@ static BOOL _fetchRowCountCallback(struct sqlite3 *sqlite, ODOSQLStatement *stat
     
     OBExpectDeallocation(statement);
     [statement release];
+    [self _checkInReadOnlyConnection:connection];
     return success;
 }
 
@@ -446,12 +477,18 @@ static BOOL _fetchSumCallback(struct sqlite3 *sqlite, ODOSQLStatement *statement
         OBFinishPorting;
     }
     
+    ODOSQLConnection *connection = [self _checkOutReadOnlyConnection:outError];
+    if (!connection)
+        return NO;
+    
     NSString *sql = [NSString stringWithFormat:@"SELECT SUM(%@) FROM %@", [attribute name], [entity name]];
-    ODOSQLStatement *statement = [[ODOSQLStatement alloc] initWithConnection:self.connection sql:sql error:outError];
-    if (!statement)
+    ODOSQLStatement *statement = [[ODOSQLStatement alloc] initWithConnection:connection sql:sql error:outError];
+    if (!statement) {
+        [self _checkInReadOnlyConnection:connection];
         return NO;
+    }
     
-    BOOL success = [self.connection performSQLAndWaitWithError:outError block:^BOOL(struct sqlite3 *sqlite, NSError **blockError) {
+    BOOL success = [connection performSQLAndWaitWithError:outError block:^BOOL(struct sqlite3 *sqlite, NSError **blockError) {
         ODOSQLStatementCallbacks callbacks;
         memset(&callbacks, 0, sizeof(callbacks));
         callbacks.row = _fetchSumCallback;
@@ -461,6 +498,7 @@ static BOOL _fetchSumCallback(struct sqlite3 *sqlite, ODOSQLStatement *statement
     
     OBExpectDeallocation(statement);
     [statement release];
+    [self _checkInReadOnlyConnection:connection];
     return success;
 }
 
@@ -496,12 +534,18 @@ static BOOL _fetchAttributesCallback(struct sqlite3 *sqlite, ODOSQLStatement *st
     OBPRECONDITION(attributes != nil);
     NSMutableArray *results = [NSMutableArray array];
     
-    ODOSQLStatement *statement = [[ODOSQLStatement alloc] initSelectProperties:attributes fromEntity:entity connection:self.connection predicate:predicate error:outError];
+    ODOSQLConnection *connection = [self _checkOutReadOnlyConnection:outError];
+    if (connection == nil) {
+        return nil;
+    }
+    
+    ODOSQLStatement *statement = [[ODOSQLStatement alloc] initSelectProperties:attributes fromEntity:entity connection:connection predicate:predicate error:outError];
     if (statement == nil) {
+        [self _checkInReadOnlyConnection:connection];
         return nil;
     }
     
-    BOOL success = [self.connection performSQLAndWaitWithError:outError block:^BOOL(struct sqlite3 *sqlite, NSError **blockError) {
+    BOOL success = [connection performSQLAndWaitWithError:outError block:^BOOL(struct sqlite3 *sqlite, NSError **blockError) {
         ODOSQLStatementCallbacks callbacks;
         memset(&callbacks, 0, sizeof(callbacks));
         callbacks.row = _fetchAttributesCallback;
@@ -514,9 +558,34 @@ static BOOL _fetchAttributesCallback(struct sqlite3 *sqlite, ODOSQLStatement *st
     
     OBExpectDeallocation(statement);
     [statement release];
+    [self _checkInReadOnlyConnection:connection];
     return (success ? results : nil);
 }
 
+- (NSUInteger)maximumReadOnlyConnectionCount;
+{
+    [_readOnlyConnectionsCondition lock];
+    NSUInteger count = _maximumReadOnlyConnectionCount;
+    [_readOnlyConnectionsCondition unlock];
+    return count;
+}
+
+- (void)setMaximumReadOnlyConnectionCount:(NSUInteger)count;
+{
+    [_readOnlyConnectionsCondition lock];
+    _maximumReadOnlyConnectionCount = count;
+    
+    // Connections that are checked out are closed as they come back.
+    while (_readOnlyConnectionCount > count && [_idleReadOnlyConnections count] > 0) {
+        [[_idleReadOnlyConnections lastObject] close];
+        [_idleReadOnlyConnections removeLastObject];
+        _readOnlyConnectionCount--;
+    }
+    
+    [_readOnlyConnectionsCondition broadcast]; // Waiters may now be able to fall back to the primary connection
+    [_readOnlyConnectionsCondition unlock];
+}
+
 #pragma mark Dangerous API
 
 - (BOOL)executeSQLWithoutResults:(NSString *)sql error:(NSError **)outError;
@@ -526,6 +595,132 @@ static BOOL _fetchAttributesCallback(struct sqlite3 *sqlite, ODOSQLStatement *st
 
 #pragma mark Private
 
+static BOOL _journalModeCallback(struct sqlite3 *sqlite, ODOSQLStatement *statement, void *context, NSError **outError)
+{
+    OBASSERT(sqlite3_column_count(statement->_statement) == 1);
+    const unsigned char *journalMode = sqlite3_column_text(statement->_statement, 0);
+    *(BOOL *)context = (journalMode != NULL && strcmp((const char *)journalMode, "wal") == 0);
+    return YES;
+}
+
+// Readers on other connections only get their own snapshot, instead of being locked out by a writer, once the database is in WAL mode. The mode is stored in the file, so this only has to work once per file, but it needs to happen before any other connection is open.
+- (BOOL)_enableWriteAheadLogging:(NSError **)outError;
+{
+    ODOSQLStatement *statement = [[ODOSQLStatement alloc] initWithConnection:_connection sql:@"PRAGMA journal_mode = WAL" error:outError];
+    if (!statement)
+        return NO;
+    
+    __block BOOL enabled = NO;
+    BOOL success = [_connection performSQLAndWaitWithError:outError block:^BOOL(struct sqlite3 *sqlite, NSError **blockError) {
+        ODOSQLStatementCallbacks callbacks;
+        memset(&callbacks, 0, sizeof(callbacks));
+        callbacks.row = _journalModeCallback;
+        
+        return ODOSQLStatementRun(sqlite, statement, callbacks, &enabled, blockError);
+    }];
+    
+    OBExpectDeallocation(statement);
+    [statement release];
+    
+    if (success && !enabled) {
+        NSString *description = NSLocalizedStringFromTableInBundle(@"Unable to connect to database.", @"OmniDataObjects", OMNI_BUNDLE, @"error description");
+        NSString *reason = [NSString stringWithFormat:NSLocalizedStringFromTableInBundle(@"Unable to turn on write-ahead logging for '%@'.", @"OmniDataObjects", OMNI_BUNDLE, @"error reason"), [_connection.URL absoluteString]];
+        ODOError(outError, ODOUnableToConnectDatabase, description, reason);
+        return NO;
+    }
+    
+    return success;
+}
+
+// Returns a connection for running a read of committed data, which must be handed back to -_checkInReadOnlyConnection: afterward. This is the primary connection if there is no pool; otherwise it is an idle read-only connection, a newly opened one if we are under the limit, or else one that another thread checks in.
+- (ODOSQLConnection *)_checkOutReadOnlyConnection:(NSError **)outError;
+{
+    ODOSQLConnection *primaryConnection = self.connection;
+    if (primaryConnection == nil || [[primaryConnection.URL absoluteString] isEqualToString:ODODatabaseInMemoryFileURLString]) {
+        // Nothing else can see an in-memory database.
+        return primaryConnection;
+    }
+    
+    [_readOnlyConnectionsCondition lock];
+    
+    while ([_idleReadOnlyConnections count] == 0 && _readOnlyConnectionCount >= _maximumReadOnlyConnectionCount && _maximumReadOnlyConnectionCount > 0)
+        [_readOnlyConnectionsCondition wait];
+    
+    if (_maximumReadOnlyConnectionCount == 0) {
+        [_readOnlyConnectionsCondition unlock];
+        return primaryConnection;
+    }
+    
+    ODOSQLConnection *connection = [_idleReadOnlyConnections lastObject];
+    if (connection) {
+        [[connection retain] autorelease];
+        [_idleReadOnlyConnections removeLastObject];
+        [_readOnlyConnectionsCondition unlock];
+        return connection;
+    }
+    
+    if (!_writeAheadLoggingEnabled) {
+        // Still holding the lock, so that no reader is opened before this is done.
+        if (![self _enableWriteAheadLogging:outError]) {
+            [_readOnlyConnectionsCondition unlock];
+            return nil;
+        }
+        _writeAheadLoggingEnabled = YES;
+    }
+    
+    // Reserve our slot and open the connection without holding the lock.
+    _readOnlyConnectionCount++;
+    [_readOnlyConnectionsCondition unlock];
+    
+    ODOSQLConnectionOptions options = ODOSQLConnectionReadOnly;
+    if (ODOKeepTemporaryStoreInMemory) {
+        options |= ODOSQLConnectionKeepTemporaryStoreInMemory;
+    }
+    
+    connection = [[[ODOSQLConnection alloc] initWithURL:primaryConnection.URL options:options error:outError] autorelease];
+    if (connection != nil && ![connection performSQLAndWaitWithError:outError block:^BOOL(struct sqlite3 *sqlite, NSError **blockError) {
+        return _registerStringCompareFunctions(sqlite, blockError);
+    }]) {
+        [connection close];
+        connection = nil;
+    }
+    
+    if (connection == nil) {
+        [_readOnlyConnectionsCondition lock];
+        _readOnlyConnectionCount--;
+        [_readOnlyConnectionsCondition signal];
+        [_readOnlyConnectionsCondition unlock];
+        return nil;
+    }
+    
+    if (ODOSQLDebugLogLevel > 0)
+        NSLog(@"Opened read-only connection %p to %@", connection, [connection.URL absoluteURL]);
+    
+    return connection;
+}
+
+- (void)_checkInReadOnlyConnection:(ODOSQLConnection *)connection;
+{
+    OBPRECONDITION(connection != nil);
+    
+    if (connection == self.connection)
+        return;
+    
+    [_readOnlyConnectionsCondition lock];
+    OBASSERT([_idleReadOnlyConnections indexOfObjectIdenticalTo:connection] == NSNotFound);
+    
+    if (_readOnlyConnectionCount > _maximumReadOnlyConnectionCount) {
+        // The limit was lowered while this connection was out.
+        [connection close];
+        _readOnlyConnectionCount--;
+    } else {
+        [_idleReadOnlyConnections addObject:connection];
+    }
+    
+    [_readOnlyConnectionsCondition signal];
+    [_readOnlyConnectionsCondition unlock];
+}
+
 NSNotificationName const ODODatabaseConnectedURLChangedNotification = @"ODODatabaseConnectedURLChanged";
 
 - (BOOL)_setupNewDatabase:(NSError **)outError;
@@ -628,6 +823,17 @@ static BOOL _populateCachedMetadataRowCallback(struct sqlite3 *sqlite, ODOSQLSta
     }
     [_cachedStatements removeAllObjects];
     
+    [_readOnlyConnectionsCondition lock];
+    OBASSERT(_readOnlyConnectionCount == [_idleReadOnlyConnections count], "Disconnecting while a committed fetch is running on another thread");
+    for (ODOSQLConnection *connection in _idleReadOnlyConnections) {
+        OBExpectDeallocation(connection);
+        [connection close];
+    }
+    _readOnlyConnectionCount -= [_idleReadOnlyConnections count];
+    [_idleReadOnlyConnections removeAllObjects];
+    _writeAheadLoggingEnabled = NO;
+    [_readOnlyConnectionsCondition unlock];
+    
     OBExpectDeallocation(_connection);
     [_connection close];
     [_connection release];
@@ -45,6 +45,8 @@ NS_ASSUME_NONNULL_BEGIN
     
     BOOL _avoidSettingSaveDates;
     NSDate *_saveDate;
+    
+    NSUInteger _fetchQueryCounter;
 }
 @end
 
@@ -79,6 +81,8 @@ void ODOUpdateResultSetForInMemoryChanges(ODOEditingContext *self, NSMutableArra
 void ODOFetchObjectFault(ODOEditingContext *self, ODOObject *object) OB_HIDDEN;
 NSMutableSet * ODOFetchSetFault(ODOEditingContext *self, ODOObject *owner, ODORelationship *rel) OB_HIDDEN;
 NSMutableArray <__kindof ODOObject *> * _Nullable ODOFetchObjects(ODOEditingContext *self, ODOEntity *entity, NSPredicate *predicate, NSString *reason, NSError **outError) OB_HIDDEN;
+BOOL ODOFetchObjectFaults(ODOEditingContext *self, NSArray <ODOObject *> *objects, NSError **outError) OB_HIDDEN;
+BOOL ODOFetchSetFaults(ODOEditingContext *self, NSArray <ODOObject *> *owners, ODORelationship *rel, NSError **outError) OB_HIDDEN;
 
 BOOL ODOEditingContextObjectIsInsertedNotConsideringDeletions(ODOEditingContext *self, ODOObject *object) OB_HIDDEN;
 
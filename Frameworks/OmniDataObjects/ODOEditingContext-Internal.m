@@ -15,6 +15,7 @@
 
 #import "ODODatabase-Internal.h"
 #import "ODOEntity-SQL.h"
+#import "ODOObject-Accessors.h"
 #import "ODOObject-Internal.h"
 #import "ODOSQLStatement.h"
 
@@ -551,6 +552,7 @@ static BOOL FetchObjectFaultWithContext(ODOEditingContext *self, ODOObject *obje
     id primaryKey = [objectID primaryKey];
     OBASSERT(primaryKey);
 
+    self->_fetchQueryCounter++;
     BOOL success = [database.connection performSQLAndWaitWithError:outError block:^BOOL(struct sqlite3 *sqlite, NSError **blockError) {
         ODOSQLStatement *query = [ctx->entity _queryByPrimaryKeyStatement:blockError database:database sqlite:sqlite];
         if (!query)
@@ -651,6 +653,7 @@ static BOOL FetchSetFaultWithContext(ODOEditingContext *self, ODOObject *owner,
 
     ODORelationship *inverseToOneRelationship = rel.inverseRelationship;
 
+    self->_fetchQueryCounter++;
     return [database.connection performSQLAndWaitWithError:outError block:^BOOL(struct sqlite3 *sqlite, NSError **blockError) {
         ODOSQLStatement *query = [ctx->entity _queryByForeignKeyStatement:blockError relationship:inverseToOneRelationship database:database sqlite:sqlite];
         if (!query)
@@ -778,6 +781,7 @@ NSMutableArray <__kindof ODOObject *> * _Nullable ODOFetchObjects(ODOEditingCont
             return nil;
         }
 
+        self->_fetchQueryCounter++;
         BOOL success = [database.connection performSQLAndWaitWithError:outError block:^BOOL(struct sqlite3 *sqlite, NSError **blockError) {
             // TODO: Append the sort descriptors as a 'order by'?  Can't if they have non-schema properties, so for now we can just sort in memory.
             ODOSQLStatementCallbacks callbacks;
@@ -827,6 +831,185 @@ NSMutableArray <__kindof ODOObject *> * _Nullable ODOFetchObjects(ODOEditingCont
     return ctx.results;
 }
 
+
+#pragma mark - Batch fault fulfillment
+
+// Keeps each IN (...) list well under SQLite's bound-variable limit, which defaults to 999 in older versions.
+#define ODOBatchFetchMaximumKeyCount (500)
+
+static void _initializeRowFetchContext(ODOEditingContext *self, ODOEntity *entity, ODORowFetchContext *ctx)
+{
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->entity = entity;
+    ctx->instanceClass = [entity instanceClass];
+    ctx->primaryKeyAttribute = [entity primaryKeyAttribute];
+    ctx->schemaProperties = [entity _schemaProperties];
+    ctx->primaryKeyColumnIndex = [ctx->schemaProperties indexOfObjectIdenticalTo:ctx->primaryKeyAttribute];
+    ctx->editingContext = self;
+    ctx->results = [NSMutableArray array];
+    ctx->fetched = [NSMutableArray array]; // Collect newly fetched objects to be send -awakeFromFetch:
+    
+    OBASSERT(ctx->primaryKeyColumnIndex != NSNotFound);
+}
+
+// Runs 'SELECT ... WHERE keyPath IN (keys)' against ctx's entity in chunks, adding the rows to ctx's results.
+static BOOL _fetchRowsWithKeysInBatches(ODOEditingContext *self, NSString *keyPath, NSArray *keys, ODORowFetchContext *ctx, NSError **outError)
+{
+    ODODatabase *database = self->_database;
+    NSUInteger keyIndex = 0, keyCount = [keys count];
+    
+    while (keyIndex < keyCount) {
+        NSRange keyRange = NSMakeRange(keyIndex, MIN(keyCount - keyIndex, (NSUInteger)ODOBatchFetchMaximumKeyCount));
+        NSPredicate *predicate = [NSPredicate predicateWithFormat:@"%K IN %@", keyPath, [keys subarrayWithRange:keyRange]];
+        
+        ODOSQLStatement *query = [[ODOSQLStatement alloc] initSelectProperties:ctx->schemaProperties fromEntity:ctx->entity connection:database.connection predicate:predicate error:outError];
+        if (query == nil)
+            return NO;
+        
+        self->_fetchQueryCounter++;
+        BOOL success = [database.connection performSQLAndWaitWithError:outError block:^BOOL(struct sqlite3 *sqlite, NSError **blockError) {
+            ODOSQLStatementCallbacks callbacks;
+            memset(&callbacks, 0, sizeof(callbacks));
+            callbacks.row = _fetchObjectCallback;
+            
+            return ODOSQLStatementRun(sqlite, query, callbacks, ctx, blockError);
+        }];
+        
+        [query invalidate];
+        [query release];
+        
+        if (!success)
+            return NO;
+        
+        keyIndex = NSMaxRange(keyRange);
+    }
+    
+    return YES;
+}
+
+static BOOL _canFetchFromDatabase(ODOEditingContext *self)
+{
+    if (self->_isResetting)
+        return NO;
+    
+    // If we are working in memory, there is nothing in the database to fetch.
+    ODODatabase *database = self->_database;
+    return [database connectedURL] != nil && ![database isFreshlyCreated];
+}
+
+// Like ODOFetchObjectFault, but for any number of objects at once.
+BOOL ODOFetchObjectFaults(ODOEditingContext *self, NSArray <ODOObject *> *objects, NSError **outError)
+{
+    OBPRECONDITION([self isKindOfClass:[ODOEditingContext class]]);
+
+    if (!_canFetchFromDatabase(self))
+        return YES;
+    
+    // Several objects can hold the same fault, so collect each primary key once.
+    NSMapTable <ODOEntity *, NSMutableSet *> *entityToPrimaryKeys = [NSMapTable strongToStrongObjectsMapTable];
+    for (ODOObject *object in objects) {
+        OBASSERT([object editingContext] == self);
+        
+        // Deleted objects are turned into faults until they are saved, and aren't ours to fetch.
+        if (![object isFault] || [object isInvalid] || [object isDeleted])
+            continue;
+        
+        ODOObjectID *objectID = [object objectID];
+        NSMutableSet *primaryKeys = [entityToPrimaryKeys objectForKey:[objectID entity]];
+        if (!primaryKeys) {
+            primaryKeys = [NSMutableSet set];
+            [entityToPrimaryKeys setObject:primaryKeys forKey:[objectID entity]];
+        }
+        [primaryKeys addObject:[objectID primaryKey]];
+    }
+    
+    for (ODOEntity *entity in entityToPrimaryKeys) {
+        NSArray *primaryKeys = [[entityToPrimaryKeys objectForKey:entity] allObjects];
+        
+        if (ODOSQLDebugLogLevel > 0)
+            ODOSQLStatementLogSQL(@"/* batch object fault %@ x %ld */ ", entity.name, [primaryKeys count]);
+        
+        // Unlike the single fault case, the objects are looked up by primary key as the rows come in, so a missing row just leaves its object a fault.
+        ODORowFetchContext ctx;
+        _initializeRowFetchContext(self, entity, &ctx);
+        
+        if (!_fetchRowsWithKeysInBatches(self, [ctx.primaryKeyAttribute name], primaryKeys, &ctx, outError))
+            return NO;
+        
+        ODOObjectAwakeObjectsFromFetch(ctx.fetched);
+    }
+    
+    return YES;
+}
+
+// Like ODOFetchSetFault, but fills in the to-many relationship for every owner whose relationship is still a lazy fault.
+BOOL ODOFetchSetFaults(ODOEditingContext *self, NSArray <ODOObject *> *owners, ODORelationship *rel, NSError **outError)
+{
+    OBPRECONDITION([self isKindOfClass:[ODOEditingContext class]]);
+    OBPRECONDITION([rel isToMany]);
+    
+    if (self->_isResetting) {
+        OBASSERT(!self->_isResetting); // Shouldn't try to clear object faults at all while resetting
+        return YES;
+    }
+    
+    NSMutableArray <ODOObject *> *faultedOwners = [NSMutableArray array];
+    NSMutableArray *ownerPrimaryKeys = [NSMutableArray array];
+    for (ODOObject *owner in owners) {
+        OBASSERT([owner editingContext] == self);
+        OBASSERT([owner entity] == [rel entity]);
+        
+        if ([owner isFault] || [owner isInvalid] || [owner isDeleted] || !ODOObjectToManyRelationshipIsFault(owner, rel))
+            continue;
+        
+        [faultedOwners addObject:owner];
+        [ownerPrimaryKeys addObject:[[owner objectID] primaryKey]];
+    }
+    
+    if ([faultedOwners count] == 0)
+        return YES;
+    
+    if (ODOSQLDebugLogLevel > 0)
+        ODOSQLStatementLogSQL(@"/* batch to-many fault %@.%@ x %ld */ ", [[rel entity] name], [rel name], [faultedOwners count]);
+    
+    ODOEntity *destinationEntity = [rel destinationEntity];
+    ODORelationship *inverseToOneRelationship = [rel inverseRelationship];
+    
+    ODORowFetchContext ctx;
+    _initializeRowFetchContext(self, destinationEntity, &ctx);
+    
+    if (_canFetchFromDatabase(self)) {
+        if (!_fetchRowsWithKeysInBatches(self, [inverseToOneRelationship name], ownerPrimaryKeys, &ctx, outError))
+            return NO;
+        
+        ODOObjectAwakeObjectsFromFetch(ctx.fetched);
+    }
+    
+    // Split the rows up by owner. Objects that were already in memory are grouped by their current (possibly edited) owner, as they would be by the single fault path.
+    NSMapTable <ODOObject *, NSMutableArray *> *ownerToResults = [NSMapTable strongToStrongObjectsMapTable];
+    for (ODOObject *owner in faultedOwners)
+        [ownerToResults setObject:[NSMutableArray array] forKey:owner];
+    for (ODOObject *object in ctx.results) {
+        ODOObject *owner = ODOObjectPrimitiveValueForProperty(object, inverseToOneRelationship);
+        if (owner)
+            [[ownerToResults objectForKey:owner] addObject:object];
+    }
+    
+    BOOL hasChanges = [self hasChanges];
+    for (ODOObject *owner in faultedOwners) {
+        NSMutableArray *results = [ownerToResults objectForKey:owner];
+        
+        if (hasChanges) {
+            NSPredicate *predicate = ODOKeyPathEqualToValuePredicate([inverseToOneRelationship name], owner);
+            ODOUpdateResultSetForInMemoryChanges(self, results, destinationEntity, predicate);
+        }
+        
+        _ODOObjectSetObjectValueForProperty(owner, rel, [NSMutableSet setWithArray:results]);
+    }
+    
+    return YES;
+}
+
 @end
 
 NS_ASSUME_NONNULL_END
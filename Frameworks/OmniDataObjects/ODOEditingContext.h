@@ -58,12 +58,18 @@ NS_ASSUME_NONNULL_BEGIN
 - (__kindof ODOObject *)insertObjectWithEntityName:(NSString *)entityName;
 - (nullable __kindof ODOObject *)fetchObjectWithObjectID:(ODOObjectID *)objectID error:(NSError **)outError NS_REFINED_FOR_SWIFT;
 
+/// Fulfills any faults in the objects, and then the faults along each relationship key path from them, with one `WHERE ... IN (...)` query per entity or relationship (batched to stay under SQLite's variable limit) rather than one query per object. Objects that are missing from the database are left as faults.
+- (BOOL)prefetchRelationshipKeyPaths:(NSArray <NSString *> *)keyPaths forObjects:(NSArray <ODOObject *> *)objects error:(NSError **)outError;
+
 /// Debugging label for differentiating between multiple editing contexts.
 @property (nonatomic, copy) NSString *label;
 
 // Incremented each time ODOEditingContextObjectsDidChangeNotification is posted.
 @property(nonatomic,readonly) NSUInteger objectDidChangeCounter;
 
+// Incremented each time a SELECT is run against the database for a fetch or to fulfill faults.
+@property(nonatomic,readonly) NSUInteger fetchQueryCounter;
+
 @end
 
 extern NSNotificationName const ODOEditingContextObjectsWillBeDeletedNotification;
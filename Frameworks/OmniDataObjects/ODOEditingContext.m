@@ -1138,8 +1138,6 @@ BOOL ODOEditingContextObjectIsInsertedNotConsideringDeletions(ODOEditingContext
         
         // TODO: CoreData will (erroneously IMO) resend -validateForInsert:, -validateForUpdate: for *redone* changes (undo followed by a redo).  It would be nice to avoid that if we can... of course, with our prohibitin on changes in validation the real issue is re-sending -willSave to redone changes.  Either way, if a redo can make edits, then the undo/redo stack can get b0rked.
         
-        // TODO: Batch deletes for the same entity with DELETE from Foo where pk in (...)?  On the other hand, maybe it is faster to have a single prepared statement and issue it multiple times?  Maybe we can have one for the IN case and one for the = case.  Or maybe the IN case is just as fast as the "=" case for single values.  Not even sure we can prepare a statement and bind multiple values into the IN clause with one '?'.
-        
         // note: docs for -[NSManagedObject willSave] have been updated to say that you should not use -setValue:forKey: but only -setPrimitiveValue:forKey: if you make changes since the former will generated more change notifications.  Of course, you have changed the object, so any listeners would really want to know about that!  Presumably, they want you to manually KVO and use primitive values to avoid telling the NSMOC that the object is edited while in the middle of saving.
 
         // Form a notification that specifies what we are going to do, but don't post it unless we sucessfully do so.
@@ -1275,9 +1273,73 @@ BOOL ODOEditingContextObjectIsInsertedNotConsideringDeletions(ODOEditingContext
     if ([sortDescriptors count] > 0)
         [results sortUsingDescriptors:sortDescriptors];
     
+    NSArray <NSString *> *prefetchKeyPaths = fetch.relationshipKeyPathsForPrefetching;
+    if ([prefetchKeyPaths count] > 0 && [results count] > 0) {
+        if (![self prefetchRelationshipKeyPaths:prefetchKeyPaths forObjects:results error:outError])
+            return nil;
+    }
+    
     return results;
 }
 
+- (BOOL)prefetchRelationshipKeyPaths:(NSArray <NSString *> *)keyPaths forObjects:(NSArray <ODOObject *> *)objects error:(NSError **)outError;
+{
+    OBPRECONDITION(keyPaths);
+    OBPRECONDITION(objects);
+    
+    if (!ODOFetchObjectFaults(self, objects, outError))
+        return NO;
+    
+    // Key paths that share a prefix will find its faults already cleared the second time through.
+    for (NSString *keyPath in keyPaths) {
+        NSArray <ODOObject *> *sources = objects;
+        
+        for (NSString *key in [keyPath componentsSeparatedByString:@"."]) {
+            // Destinations from the previous step might be of several entities, each with its own relationship for this key.
+            NSMapTable <ODOEntity *, NSMutableArray <ODOObject *> *> *entityToSources = [NSMapTable strongToStrongObjectsMapTable];
+            for (ODOObject *source in sources) {
+                if ([source isInvalid] || [source isDeleted] || [source isFault])
+                    continue; // Deleted, or missing from the database
+                
+                NSMutableArray *entitySources = [entityToSources objectForKey:source.entity];
+                if (!entitySources) {
+                    entitySources = [NSMutableArray array];
+                    [entityToSources setObject:entitySources forKey:source.entity];
+                }
+                [entitySources addObject:source];
+            }
+            
+            NSMutableSet <ODOObject *> *destinations = [NSMutableSet set];
+            for (ODOEntity *entity in entityToSources) {
+                NSArray <ODOObject *> *entitySources = [entityToSources objectForKey:entity];
+                ODORelationship *rel = [[entity relationshipsByName] objectForKey:key];
+                if (!rel)
+                    [NSException raise:NSInvalidArgumentException format:@"Entity %@ has no relationship named \"%@\" (in prefetch key path \"%@\").", entity.name, key, keyPath];
+                
+                if ([rel isToMany]) {
+                    if (!ODOFetchSetFaults(self, entitySources, rel, outError))
+                        return NO;
+                    for (ODOObject *source in entitySources)
+                        [destinations unionSet:ODOObjectPrimitiveValueForProperty(source, rel)];
+                } else {
+                    // This just registers faults for the destinations; they get fetched together below.
+                    for (ODOObject *source in entitySources) {
+                        ODOObject *destination = ODOObjectPrimitiveValueForProperty(source, rel);
+                        if (destination)
+                            [destinations addObject:destination];
+                    }
+                }
+            }
+            
+            sources = [destinations allObjects];
+            if (!ODOFetchObjectFaults(self, sources, outError))
+                return NO;
+        }
+    }
+    
+    return YES;
+}
+
 - (__kindof ODOObject *)insertObjectWithEntityName:(NSString *)entityName;
 {
     ODOEntity *entity = [self.database.model entityNamed:entityName];
@@ -1544,61 +1606,52 @@ static void _runLoopObserverCallBack(CFRunLoopObserverRef observer, CFRunLoopAct
 }
 
 typedef struct {
-    ODODatabase *database;
     NSSet *reinsertedObjects;
-    sqlite3 *sqlite;
-    BOOL errorOccurred;
-    NSError **outError;
-} WriteSQLApplierContext;
+    NSMutableSet *entities;
+    CFMutableDictionaryRef entityToInserts;
+    CFMutableDictionaryRef entityToUpdates;
+    CFMutableDictionaryRef entityToDeletes;
+} GroupObjectsByEntityContext;
 
-static void _writeInsertApplier(const void *value, void *context)
+static void _addObjectToEntityGroup(GroupObjectsByEntityContext *ctx, CFMutableDictionaryRef entityToObjects, ODOObject *object)
 {
-    ODOObject *object = (ODOObject *)value;
-    WriteSQLApplierContext *ctx = context;
-    
-    if (ctx->errorOccurred) {
-        return;
-    }
-    
-    BOOL isReinsert = ([ctx->reinsertedObjects member:object] == object);
-    
-    if (isReinsert) {
-        if (![object.entity _writeUpdate:ctx->sqlite database:ctx->database object:object error:ctx->outError]) {
-            ctx->errorOccurred = YES;
-        }
-    } else {
-        if (![object.entity _writeInsert:ctx->sqlite database:ctx->database object:object error:ctx->outError]) {
-            ctx->errorOccurred = YES;
-        }
+    ODOEntity *entity = object.entity;
+    NSMutableArray *objects = (NSMutableArray *)CFDictionaryGetValue(entityToObjects, entity);
+    if (!objects) {
+        objects = [[NSMutableArray alloc] init];
+        CFDictionarySetValue(entityToObjects, entity, objects);
+        [objects release];
+        [ctx->entities addObject:entity];
     }
+    [objects addObject:object];
 }
 
-static void _writeUpdateApplier(const void *value, void *context)
+static void _groupInsertApplier(const void *value, void *context)
 {
     ODOObject *object = (ODOObject *)value;
-    WriteSQLApplierContext *ctx = context;
+    GroupObjectsByEntityContext *ctx = context;
     
-    if (ctx->errorOccurred) {
-        return;
-    }
+    // Reinserted objects still have their rows in the database.
+    BOOL isReinsert = ([ctx->reinsertedObjects member:object] == object);
+    _addObjectToEntityGroup(ctx, isReinsert ? ctx->entityToUpdates : ctx->entityToInserts, object);
+}
 
-    if (![object.entity _writeUpdate:ctx->sqlite database:ctx->database object:object error:ctx->outError]) {
-        ctx->errorOccurred = YES;
-    }
+static void _groupUpdateApplier(const void *value, void *context)
+{
+    GroupObjectsByEntityContext *ctx = context;
+    _addObjectToEntityGroup(ctx, ctx->entityToUpdates, (ODOObject *)value);
 }
 
-static void _writeDeleteApplier(const void *value, void *context)
+static void _groupDeleteApplier(const void *value, void *context)
 {
-    ODOObject *object = (ODOObject *)value;
-    WriteSQLApplierContext *ctx = context;
-    
-    if (ctx->errorOccurred) {
-        return;
-    }
+    GroupObjectsByEntityContext *ctx = context;
+    _addObjectToEntityGroup(ctx, ctx->entityToDeletes, (ODOObject *)value);
+}
 
-    if (![object.entity _writeDelete:ctx->sqlite database:ctx->database object:object error:ctx->outError]) {
-        ctx->errorOccurred = YES;
-    }
+static CFMutableDictionaryRef _createEntityToObjects(void)
+{
+    // Entities are owned by the model, which outlives the save.
+    return CFDictionaryCreateMutable(kCFAllocatorDefault, 0, &OFNonOwnedPointerDictionaryKeyCallbacks, &OFNSObjectDictionaryValueCallbacks);
 }
 
 // Writes the changes, but doesn't clear them (the transaction may fail).
@@ -1612,39 +1665,62 @@ static void _writeDeleteApplier(const void *value, void *context)
     OBPRECONDITION([_database.connection checkExecutingOnDispatchQueue]);
     OBPRECONDITION([_database.connection checkIsManagedSQLite:sqlite]);
     
-    // For deletes, there might be a speed advantage to grouping by entity and then issuing a delete where pk in (...) but binding values wouldn't let us bind the set of values.  Maybe we could have a prepared statement for 'delete 10 things' and use that until we had < 10.  Or fill out the last N bindings in the statement with repeated PKs.  Also, angels on a pinhead.
-    WriteSQLApplierContext ctx;
+    // Group the changes by entity so that each entity can write its inserts and deletes with multi-row statements (see ODOEntity-SQL).
+    GroupObjectsByEntityContext ctx;
     memset(&ctx, 0, sizeof(ctx));
-    ctx.database = _database;
     ctx.reinsertedObjects = _reinsertedObjects;
-    ctx.sqlite = sqlite;
-    ctx.outError = outError;
+    ctx.entities = [NSMutableSet set];
+    ctx.entityToInserts = _createEntityToObjects();
+    ctx.entityToUpdates = _createEntityToObjects();
+    ctx.entityToDeletes = _createEntityToObjects();
     
     if (_processedInsertedObjects != nil) {
-        CFSetApplyFunction((CFSetRef)_processedInsertedObjects, _writeInsertApplier, &ctx);
-    }
-    
-    if (ctx.errorOccurred) {
-        return NO;
+        CFSetApplyFunction((CFSetRef)_processedInsertedObjects, _groupInsertApplier, &ctx);
     }
-    
     if (_processedUpdatedObjects != nil) {
-        CFSetApplyFunction((CFSetRef)_processedUpdatedObjects, _writeUpdateApplier, &ctx);
-    }
-    
-    if (ctx.errorOccurred) {
-        return NO;
+        CFSetApplyFunction((CFSetRef)_processedUpdatedObjects, _groupUpdateApplier, &ctx);
     }
-
     if (_processedDeletedObjects != nil) {
-        CFSetApplyFunction((CFSetRef)_processedDeletedObjects, _writeDeleteApplier, &ctx);
+        CFSetApplyFunction((CFSetRef)_processedDeletedObjects, _groupDeleteApplier, &ctx);
     }
     
-    if (ctx.errorOccurred) {
-        return NO;
+    // Write in a stable order, so that the logged timings are easier to compare between saves.
+    NSArray *entities = [[ctx.entities allObjects] sortedArrayUsingComparator:^NSComparisonResult(ODOEntity *entity1, ODOEntity *entity2) {
+        return [entity1.name compare:entity2.name];
+    }];
+    
+    BOOL success = YES;
+    for (ODOEntity *entity in entities) {
+        NSArray *inserts = (NSArray *)CFDictionaryGetValue(ctx.entityToInserts, entity);
+        NSArray *updates = (NSArray *)CFDictionaryGetValue(ctx.entityToUpdates, entity);
+        NSArray *deletes = (NSArray *)CFDictionaryGetValue(ctx.entityToDeletes, entity);
+        
+        CFAbsoluteTime start = CFAbsoluteTimeGetCurrent();
+        
+        if (inserts && ![entity _writeInserts:sqlite database:_database objects:inserts error:outError]) {
+            success = NO;
+            break;
+        }
+        if (updates && ![entity _writeUpdates:sqlite database:_database objects:updates error:outError]) {
+            success = NO;
+            break;
+        }
+        if (deletes && ![entity _writeDeletes:sqlite database:_database objects:deletes error:outError]) {
+            success = NO;
+            break;
+        }
+        
+        if (ODOSQLDebugLogLevel > 0) {
+            CFAbsoluteTime end = CFAbsoluteTimeGetCurrent();
+            ODOSQLStatementLogSQL(@"/* SQL save: %@  %ld inserted, %ld updated, %ld deleted, %g sec */\n", entity.name, [inserts count], [updates count], [deletes count], end - start);
+        }
     }
-
-    return YES;
+    
+    CFRelease(ctx.entityToInserts);
+    CFRelease(ctx.entityToUpdates);
+    CFRelease(ctx.entityToDeletes);
+    
+    return success;
 }
 
 static void _appendObjectID(const void *value, void *context)
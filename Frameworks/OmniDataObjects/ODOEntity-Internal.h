@@ -51,6 +51,8 @@
     NSString *_updateStatementKey;
     NSString *_deleteStatementKey;
     NSString *_queryByPrimaryKeyStatementKey;
+    NSArray <NSString *> *_batchInsertStatementKeys; // Indexed by log2 of the number of rows the statement writes
+    NSArray <NSString *> *_batchDeleteStatementKeys;
     
     NSSet *_derivedPropertyNameSet;
     NSSet *_nonDateModifyingPropertyNameSet;
@@ -61,6 +63,9 @@
 
 @end
 
+// Saves write each entity's inserts and deletes with statements that handle up to 1 << ODOEntityMaximumBatchRowCountShift rows at once.
+#define ODOEntityMaximumBatchRowCountShift (7)
+
 #pragma mark -
 
 static inline ODOStorageKey ODOEntityStorageKeyForSnapshotIndex(ODOEntity *self, NSUInteger snapshotIndex)
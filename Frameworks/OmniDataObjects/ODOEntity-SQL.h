@@ -16,9 +16,9 @@
 - (BOOL)_createIndexesInDatabase:(ODODatabase *)database error:(NSError **)outError;
 
 struct sqlite3;
-- (BOOL)_writeInsert:(struct sqlite3 *)sqlite database:(ODODatabase *)database object:(ODOObject *)object error:(NSError **)outError;
-- (BOOL)_writeUpdate:(struct sqlite3 *)sqlite database:(ODODatabase *)database object:(ODOObject *)object error:(NSError **)outError;
-- (BOOL)_writeDelete:(struct sqlite3 *)sqlite database:(ODODatabase *)database object:(ODOObject *)object error:(NSError **)outError;
+- (BOOL)_writeInserts:(struct sqlite3 *)sqlite database:(ODODatabase *)database objects:(NSArray <ODOObject *> *)objects error:(NSError **)outError;
+- (BOOL)_writeUpdates:(struct sqlite3 *)sqlite database:(ODODatabase *)database objects:(NSArray <ODOObject *> *)objects error:(NSError **)outError;
+- (BOOL)_writeDeletes:(struct sqlite3 *)sqlite database:(ODODatabase *)database objects:(NSArray <ODOObject *> *)objects error:(NSError **)outError;
 
 - (ODOSQLStatement *)_queryByPrimaryKeyStatement:(NSError **)outError database:(ODODatabase *)database sqlite:(struct sqlite3 *)sqlite;
 - (ODOSQLStatement *)_queryByForeignKeyStatement:(NSError **)outError relationship:(ODORelationship *)relationship database:(ODODatabase *)database sqlite:(struct sqlite3 *)sqlite;
@@ -18,6 +18,8 @@
 #import "ODODatabase-Internal.h"
 #import "ODOSQLStatement.h"
 
+#import <sqlite3.h>
+
 RCS_ID("$Id$")
 
 @implementation ODOEntity (ODO_SQL)
@@ -256,29 +258,65 @@ static BOOL _bindSchemaProperty(struct sqlite3 *sqlite, ODOSQLStatement *stateme
         return _bindPlainAttribute(sqlite, statement, object, zeroBasedPropertyIndex, (ODOAttribute *)prop, outError);
 }
 
-static BOOL _bindInsertSchemaProperties(struct sqlite3 *sqlite, ODOSQLStatement *statement, ODOObject *object, NSArray *schemaProperties, NSError **outError)
+static BOOL _bindInsertSchemaProperties(struct sqlite3 *sqlite, ODOSQLStatement *statement, ODOObject *object, NSArray *schemaProperties, NSUInteger firstBindIndex, NSError **outError)
 {
     NSUInteger propertyIndex = [schemaProperties count];
     while (propertyIndex--) {
         ODOProperty *prop = [schemaProperties objectAtIndex:propertyIndex];
-        if (!_bindSchemaProperty(sqlite, statement, object, propertyIndex, prop, outError))
+        if (!_bindSchemaProperty(sqlite, statement, object, firstBindIndex + propertyIndex, prop, outError))
             return NO;
     }
     
     return YES;
 }
 
-- (BOOL)_writeInsert:(struct sqlite3 *)sqlite database:(ODODatabase *)database object:(ODOObject *)object error:(NSError **)outError;
+// The largest batch we can use, given how many variables each row binds and how many SQLite allows in one statement.
+static NSUInteger _maximumBatchRowCountShift(struct sqlite3 *sqlite, NSUInteger bindingsPerRow)
 {
-    OBPRECONDITION(sqlite);
-    OBPRECONDITION(database);
-    OBPRECONDITION(object);
-    OBPRECONDITION([[object editingContext] database] == database);
+    OBPRECONDITION(bindingsPerRow > 0);
+    
+    NSUInteger bindingLimit = (NSUInteger)sqlite3_limit(sqlite, SQLITE_LIMIT_VARIABLE_NUMBER, -1/* negative means to not change*/);
+    NSUInteger shift = ODOEntityMaximumBatchRowCountShift;
+    while (shift > 0 && (bindingsPerRow << shift) > bindingLimit)
+        shift--;
+    return shift;
+}
 
-    ODOSQLStatement *insertStatement = [database _cachedStatementForKey:_insertStatementKey];
-    if (!insertStatement) {
-        NSMutableString *sql = [[NSMutableString alloc] initWithFormat:@"INSERT INTO %@ VALUES (", _name];
-        NSUInteger propertyIndex, propertyCount = [_schemaProperties count];
+// Batches are powers of two so that we only prepare a handful of statements per entity; a save of N rows takes N >> maximumShift full batches and then at most one of each smaller size.
+static NSUInteger _batchRowCountShift(NSUInteger remainingRowCount, NSUInteger maximumShift)
+{
+    OBPRECONDITION(remainingRowCount > 0);
+    
+    NSUInteger shift = 0;
+    while (shift < maximumShift && ((NSUInteger)2 << shift) <= remainingRowCount)
+        shift++;
+    return shift;
+}
+
+static ODOSQLStatement *_cachedStatement(ODODatabase *database, struct sqlite3 *sqlite, NSString *key, NSString *sql, NSError **outError)
+{
+    ODOSQLStatement *statement = [ODOSQLStatement preparedStatementWithConnection:database.connection SQLite:sqlite sql:sql error:outError];
+    if (!statement)
+        return nil;
+    
+    [database _setCachedStatement:statement forKey:key];
+    
+    // clang scan-build will issue a use-after release warning below if we don't do this (since it doesn't know that -_setCachedStatement:forKey: will retain.  Really, this makes sense since the method might do anything, including rejecting the new statement for some reason.  So, look it up again.
+    return [database _cachedStatementForKey:key];
+}
+
+- (ODOSQLStatement *)_insertStatementWithRowCountShift:(NSUInteger)shift database:(ODODatabase *)database sqlite:(struct sqlite3 *)sqlite error:(NSError **)outError;
+{
+    NSString *key = [_batchInsertStatementKeys objectAtIndex:shift];
+    ODOSQLStatement *insertStatement = [database _cachedStatementForKey:key];
+    if (insertStatement)
+        return insertStatement;
+    
+    NSMutableString *sql = [[NSMutableString alloc] initWithFormat:@"INSERT INTO %@ VALUES ", _name];
+    NSUInteger rowIndex, rowCount = (NSUInteger)1 << shift;
+    NSUInteger propertyIndex, propertyCount = [_schemaProperties count];
+    for (rowIndex = 0; rowIndex < rowCount; rowIndex++) {
+        [sql appendString:rowIndex == 0 ? @"(" : @", ("];
         for (propertyIndex = 0; propertyIndex < propertyCount; propertyIndex++) {
             if (propertyIndex == 0)
                 [sql appendString:@"?"];
@@ -286,24 +324,52 @@ static BOOL _bindInsertSchemaProperties(struct sqlite3 *sqlite, ODOSQLStatement
                 [sql appendString:@", ?"];
         }
         [sql appendString:@")"];
+    }
+    
+    insertStatement = _cachedStatement(database, sqlite, key, sql, outError);
+    [sql release];
+    return insertStatement;
+}
+
+- (BOOL)_writeInserts:(struct sqlite3 *)sqlite database:(ODODatabase *)database objects:(NSArray <ODOObject *> *)objects error:(NSError **)outError;
+{
+    OBPRECONDITION(sqlite);
+    OBPRECONDITION(database);
+    
+    NSUInteger propertyCount = [_schemaProperties count];
+    NSUInteger maximumShift = _maximumBatchRowCountShift(sqlite, propertyCount);
+    NSUInteger objectIndex = 0, objectCount = [objects count];
+    
+    while (objectIndex < objectCount) {
+        NSUInteger shift = _batchRowCountShift(objectCount - objectIndex, maximumShift);
+        NSUInteger rowIndex, rowCount = (NSUInteger)1 << shift;
         
-        insertStatement = [ODOSQLStatement preparedStatementWithConnection:database.connection SQLite:sqlite sql:sql error:outError];
-        [sql release];
-        if (!insertStatement) {
+        ODOSQLStatement *insertStatement = [self _insertStatementWithRowCountShift:shift database:database sqlite:sqlite error:outError];
+        if (!insertStatement)
             return NO;
+        
+        // Bind all the property values for each row.
+        for (rowIndex = 0; rowIndex < rowCount; rowIndex++) {
+            ODOObject *object = [objects objectAtIndex:objectIndex + rowIndex];
+            OBASSERT([object entity] == self);
+            OBASSERT([[object editingContext] database] == database);
+            
+            if (!_bindInsertSchemaProperties(sqlite, insertStatement, object, _schemaProperties, rowIndex * propertyCount, outError))
+                return NO;
         }
         
-        [database _setCachedStatement:insertStatement forKey:_insertStatementKey];
+        BOOL success = ODOSQLStatementRunWithoutResults(sqlite, insertStatement, outError);
+        
+        // Bindings aren't reset when the statement is, and the big batch statements might not be used again for a while; don't hang on to copies of all their strings and blobs.
+        if (shift > 0)
+            sqlite3_clear_bindings(insertStatement->_statement);
+        if (!success)
+            return NO;
         
-        // clang scan-build will issue a use-after release warning below if we don't do this (since it doesn't know that -_setCachedStatement:forKey: will retain.  Really, this makes sense since the method might do anything, including rejecting the new statement for some reason.  So, look it up again.
-        insertStatement = [database _cachedStatementForKey:_insertStatementKey];
+        objectIndex += rowCount;
     }
     
-    // Bind all the property values.
-    if (!_bindInsertSchemaProperties(sqlite, insertStatement, object, _schemaProperties, outError))
-        return NO;
-    
-    return ODOSQLStatementRunWithoutResults(sqlite, insertStatement, outError);
+    return YES;
 }
 
 // All the _non_ primary key values get bound first and then the pk.
@@ -330,12 +396,11 @@ static BOOL _bindUpdateSchemaProperties(struct sqlite3 *sqlite, ODOSQLStatement
     return _bindPlainAttribute(sqlite, statement, object, bindIndex, primaryKeyAttribute, outError);
 }
 
-- (BOOL)_writeUpdate:(struct sqlite3 *)sqlite database:(ODODatabase *)database object:(ODOObject *)object error:(NSError **)outError;
+// Updates change a different set of values in each row, so there is no multi-row form; we just run the one prepared statement for each object.
+- (BOOL)_writeUpdates:(struct sqlite3 *)sqlite database:(ODODatabase *)database objects:(NSArray <ODOObject *> *)objects error:(NSError **)outError;
 {
     OBPRECONDITION(sqlite);
     OBPRECONDITION(database);
-    OBPRECONDITION(object);
-    OBPRECONDITION([[object editingContext] database] == database);
 
     ODOSQLStatement *updateStatement = [database _cachedStatementForKey:_updateStatementKey];
     if (!updateStatement) {
@@ -355,60 +420,100 @@ static BOOL _bindUpdateSchemaProperties(struct sqlite3 *sqlite, ODOSQLStatement
         }
         [sql appendFormat:@" WHERE %@ = ?", [_primaryKeyAttribute name]];
         
-        updateStatement = [ODOSQLStatement preparedStatementWithConnection:database.connection SQLite:sqlite sql:sql error:outError];
+        updateStatement = _cachedStatement(database, sqlite, _updateStatementKey, sql, outError);
         [sql release];
         if (!updateStatement) {
             return NO;
         }
+    }
+    
+    for (ODOObject *object in objects) {
+        OBASSERT([object entity] == self);
+        OBASSERT([[object editingContext] database] == database);
 
-        [database _setCachedStatement:updateStatement forKey:_updateStatementKey];
-
-        // clang scan-build will issue a use-after release warning below if we don't do this (since it doesn't know that -_setCachedStatement:forKey: will retain.  Really, this makes sense since the method might do anything, including rejecting the new statement for some reason.  So, look it up again.
-        updateStatement = [database _cachedStatementForKey:_updateStatementKey];
+        // Bind all the property values.
+        if (!_bindUpdateSchemaProperties(sqlite, updateStatement, object, _schemaProperties, _primaryKeyAttribute, outError))
+            return NO;
+        
+        if (!ODOSQLStatementRunWithoutResults(sqlite, updateStatement, outError))
+            return NO;
+    }
+    
+    return YES;
 }
+
+- (ODOSQLStatement *)_deleteStatementWithRowCountShift:(NSUInteger)shift database:(ODODatabase *)database sqlite:(struct sqlite3 *)sqlite error:(NSError **)outError;
+{
+    NSString *key = [_batchDeleteStatementKeys objectAtIndex:shift];
+    ODOSQLStatement *statement = [database _cachedStatementForKey:key];
+    if (statement)
+        return statement;
     
-    // Bind all the property values.
-    if (!_bindUpdateSchemaProperties(sqlite, updateStatement, object, _schemaProperties, _primaryKeyAttribute, outError))
-        return NO;
+    NSMutableString *sql;
+    if (shift == 0) {
+        sql = [[NSMutableString alloc] initWithFormat:@"DELETE FROM %@ WHERE %@ = ?", _name, [_primaryKeyAttribute name]];
+    } else {
+        sql = [[NSMutableString alloc] initWithFormat:@"DELETE FROM %@ WHERE %@ IN (?", _name, [_primaryKeyAttribute name]];
+        NSUInteger rowIndex, rowCount = (NSUInteger)1 << shift;
+        for (rowIndex = 1; rowIndex < rowCount; rowIndex++)
+            [sql appendString:@", ?"];
+        [sql appendString:@")"];
+    }
     
-    return ODOSQLStatementRunWithoutResults(sqlite, updateStatement, outError);
+    statement = _cachedStatement(database, sqlite, key, sql, outError);
+    [sql release];
+    return statement;
+}
+
+#ifdef OMNI_ASSERTIONS_ON
+static BOOL _checkForChangedRowCount(struct sqlite3 *sqlite, ODOSQLStatement *statement, void *context, NSError **outError)
+{
+    // Each primary key we deleted by should have matched exactly one row.
+    OBASSERT((NSUInteger)sqlite3_changes(sqlite) == *(NSUInteger *)context);
+    return YES;
 }
+#endif
 
-- (BOOL)_writeDelete:(struct sqlite3 *)sqlite database:(ODODatabase *)database object:(ODOObject *)object error:(NSError **)outError;
+- (BOOL)_writeDeletes:(struct sqlite3 *)sqlite database:(ODODatabase *)database objects:(NSArray <ODOObject *> *)objects error:(NSError **)outError;
 {
     OBPRECONDITION(sqlite);
     OBPRECONDITION(database);
-    OBPRECONDITION(object);
-    OBPRECONDITION([[object editingContext] database] == database);
 
-    ODOSQLStatement *statement = [database _cachedStatementForKey:_deleteStatementKey];
-    if (!statement) {
-        NSMutableString *sql = [[NSMutableString alloc] initWithFormat:@"DELETE FROM %@ WHERE %@ = ?", _name, [_primaryKeyAttribute name]];
+    ODOSQLStatementCallbacks callbacks;
+    memset(&callbacks, 0, sizeof(callbacks));
+    callbacks.row = ODOSQLStatementIgnoreUnexpectedRow;
+#ifdef OMNI_ASSERTIONS_ON
+    callbacks.atEnd = _checkForChangedRowCount;
+#endif
+    
+    NSUInteger maximumShift = _maximumBatchRowCountShift(sqlite, 1);
+    NSUInteger objectIndex = 0, objectCount = [objects count];
+    
+    while (objectIndex < objectCount) {
+        NSUInteger shift = _batchRowCountShift(objectCount - objectIndex, maximumShift);
+        NSUInteger rowIndex, rowCount = (NSUInteger)1 << shift;
         
-        statement = [ODOSQLStatement preparedStatementWithConnection:database.connection SQLite:sqlite sql:sql error:outError];
-        [sql release];
-        if (!statement) {
+        ODOSQLStatement *statement = [self _deleteStatementWithRowCountShift:shift database:database sqlite:sqlite error:outError];
+        if (!statement)
             return NO;
+        
+        // Bind the primary keys in the slots for the WHERE
+        for (rowIndex = 0; rowIndex < rowCount; rowIndex++) {
+            ODOObject *object = [objects objectAtIndex:objectIndex + rowIndex];
+            OBASSERT([object entity] == self);
+            OBASSERT([[object editingContext] database] == database);
+            
+            if (!_bindPlainAttribute(sqlite, statement, object, rowIndex, _primaryKeyAttribute, outError))
+                return NO;
         }
         
-        [database _setCachedStatement:statement forKey:_deleteStatementKey];
+        if (!ODOSQLStatementRun(sqlite, statement, callbacks, &rowCount, outError))
+            return NO;
         
-        // clang scan-build will issue a use-after release warning below if we don't do this (since it doesn't know that -_setCachedStatement:forKey: will retain.  Really, this makes sense since the method might do anything, including rejecting the new statement for some reason.  So, look it up again.
-        statement = [database _cachedStatementForKey:_deleteStatementKey];
+        objectIndex += rowCount;
     }
     
-    // Bind the primary key attribute in the single slot for the WHERE
-    if (!_bindPlainAttribute(sqlite, statement, object, 0, _primaryKeyAttribute, outError))
-        return NO;
-    
-    ODOSQLStatementCallbacks callbacks;
-    memset(&callbacks, 0, sizeof(callbacks));
-    callbacks.row = ODOSQLStatementIgnoreUnexpectedRow;
-#ifdef OMNI_ASSERTIONS_ON
-    callbacks.atEnd = ODOSQLStatementCheckForSingleChangedRow;
-#endif
-    
-    return ODOSQLStatementRun(sqlite, statement, callbacks, NULL, outError);
+    return YES;
 }
 
 - (ODOSQLStatement *)_queryByProperty:(ODOProperty *)property statementKey:(NSString *)statementKey database:(ODODatabase *)database sqlite:(struct sqlite3 *)sqlite error:(NSError **)outError;
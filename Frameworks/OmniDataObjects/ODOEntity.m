@@ -49,6 +49,8 @@ RCS_ID("$Id$")
     [_updateStatementKey release];
     [_deleteStatementKey release];
     [_queryByPrimaryKeyStatementKey release];
+    [_batchInsertStatementKeys release];
+    [_batchDeleteStatementKeys release];
 
     [_derivedPropertyNameSet release];
     [_nonDateModifyingPropertyNameSet release];
@@ -346,6 +348,16 @@ extern ODOEntity *ODOEntityCreate(NSString *entityName, NSString *insertKey, NSS
     entity->_updateStatementKey = [updateKey copy];
     entity->_deleteStatementKey = [deleteKey copy];
     entity->_queryByPrimaryKeyStatementKey = [pkQueryKey copy];
+
+    // The single row statements are the plain insert and delete statements.
+    NSMutableArray <NSString *> *batchInsertKeys = [NSMutableArray arrayWithObject:entity->_insertStatementKey];
+    NSMutableArray <NSString *> *batchDeleteKeys = [NSMutableArray arrayWithObject:entity->_deleteStatementKey];
+    for (NSUInteger shift = 1; shift <= ODOEntityMaximumBatchRowCountShift; shift++) {
+        [batchInsertKeys addObject:[NSString stringWithFormat:@"%@x%lu", insertKey, (unsigned long)1 << shift]];
+        [batchDeleteKeys addObject:[NSString stringWithFormat:@"%@x%lu", deleteKey, (unsigned long)1 << shift]];
+    }
+    entity->_batchInsertStatementKeys = [batchInsertKeys copy];
+    entity->_batchDeleteStatementKeys = [batchDeleteKeys copy];
     
     OBASSERT(instanceClassName);
     entity->_instanceClass = NSClassFromString(instanceClassName);
@@ -21,6 +21,9 @@ NS_ASSUME_NONNULL_BEGIN
 @property (nonatomic, nullable, copy) NSArray *sortDescriptors;
 @property (nonatomic, nullable, copy) NSString *reason;
 
+/// Relationship key paths (like "details" or "details.master") whose destinations should be fetched along with the results, using one query per entity and relationship rather than one per object.
+@property (nonatomic, nullable, copy) NSArray <NSString *> *relationshipKeyPathsForPrefetching;
+
 @end
 
 NS_ASSUME_NONNULL_END
@@ -17,6 +17,7 @@ RCS_ID("$Id$")
     [_predicate release];
     [_sortDescriptors release];
     [_reason release];
+    [_relationshipKeyPathsForPrefetching release];
     [super dealloc];
 }
 
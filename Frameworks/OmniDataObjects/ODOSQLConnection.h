@@ -14,6 +14,7 @@ NS_ASSUME_NONNULL_BEGIN
 typedef NS_OPTIONS(NSUInteger, ODOSQLConnectionOptions) {
     ODOSQLConnectionAsynchronousWrites = 1 << 0,
     ODOSQLConnectionKeepTemporaryStoreInMemory = 1 << 1,
+    ODOSQLConnectionReadOnly = 1 << 2, // Opens the file with SQLITE_OPEN_READONLY and skips the pragmas that only matter to writers
 };
 
 typedef void (^ODOSQLPerformBlock)(struct sqlite3 *);
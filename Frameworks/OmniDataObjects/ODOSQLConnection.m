@@ -185,7 +185,11 @@ RCS_ID("$Id$");
     
     // Even on error the output sqlite will supposedly be set and we need to close it.
     sqlite3 *sql = NULL;
-    int rc = sqlite3_open([path UTF8String], &sql);
+    int rc;
+    if (options & ODOSQLConnectionReadOnly)
+        rc = sqlite3_open_v2([path UTF8String], &sql, SQLITE_OPEN_READONLY, NULL);
+    else
+        rc = sqlite3_open([path UTF8String], &sql);
     if (rc != SQLITE_OK) {
         ODOSQLiteError(outError, rc, sql); // stack the underlying error
         sqlite3_close(sql);
@@ -197,6 +201,14 @@ RCS_ID("$Id$");
     
     _sqlite = sql;
     
+    if (options & ODOSQLConnectionKeepTemporaryStoreInMemory) {
+        if (![self executeSQLWithoutResults:@"PRAGMA temp_store = memory" error:outError])
+            return NO;
+    }
+    
+    if (options & ODOSQLConnectionReadOnly)
+        return YES;
+    
     if (options & ODOSQLConnectionAsynchronousWrites) {
         if (![self executeSQLWithoutResults:@"PRAGMA synchronous = off" error:outError])
             return NO;
@@ -205,11 +217,6 @@ RCS_ID("$Id$");
             return NO;
     }
     
-    if (options & ODOSQLConnectionKeepTemporaryStoreInMemory) {
-        if (![self executeSQLWithoutResults:@"PRAGMA temp_store = memory" error:outError])
-            return NO;
-    }
-    
     if (![self executeSQLWithoutResults:@"PRAGMA auto_vacuum = none" error:outError]) // According to the sqlite documentation: "Auto-vacuum does not defragment the database nor repack individual database pages the way that the VACUUM command does. In fact, because it moves pages around within the file, auto-vacuum can actually make fragmentation worse."
         return NO;
     
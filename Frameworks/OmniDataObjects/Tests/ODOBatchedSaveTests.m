@@ -0,0 +1,166 @@
+// Copyright 2026 Omni Development, Inc. All rights reserved.
+//
+// This software may only be used and reproduced according to the
+// terms in the file OmniSourceLicense.html, which should be
+// distributed with this project and can also be found at
+// <http://www.omnigroup.com/developer/sourcecode/sourcelicense/>.
+
+#import "ODOTestCase.h"
+
+#import "ODOTestCaseModel.h"
+
+RCS_ID("$Id$")
+
+OB_REQUIRE_ARC;
+
+@interface ODOBatchedSaveTests : ODOTestCase
+@end
+
+@implementation ODOBatchedSaveTests
+
+- (ODOTestCaseMaster *)_insertMasterWithPrimaryKey:(NSString *)primaryKey;
+{
+    ODOTestCaseMaster *master = [[ODOTestCaseMaster alloc] initWithEntity:[ODOTestCaseModel() entityNamed:ODOTestCaseMasterEntityName] primaryKey:primaryKey insertingIntoEditingContext:_editingContext];
+    master.name = [@"name-" stringByAppendingString:primaryKey];
+    return master;
+}
+
+- (NSDictionary <NSString *, NSString *> *)_committedNamesForEntityName:(NSString *)entityName;
+{
+    [_editingContext reset];
+
+    ODOFetchRequest *fetch = [[ODOFetchRequest alloc] init];
+    [fetch setEntity:[ODOTestCaseModel() entityNamed:entityName]];
+
+    NSError *error = nil;
+    NSArray *results;
+    OBShouldNotError((results = [_editingContext executeFetchRequest:fetch error:&error]) != nil);
+
+    NSMutableDictionary <NSString *, NSString *> *names = [NSMutableDictionary dictionary];
+    for (ODOObject *object in results)
+        names[object.objectID.primaryKey] = [object valueForKey:@"name"];
+    return names;
+}
+
+// An odd number of rows, so that the save uses every batch size as well as the largest one.
+- (void)testBatchedInsertsUpdatesAndDeletes;
+{
+    static const NSUInteger masterCount = 1000 + 255;
+    NSMutableDictionary <NSString *, NSString *> *expectedMasterNames = [NSMutableDictionary dictionary];
+    NSMutableDictionary <NSString *, NSString *> *expectedDetailNames = [NSMutableDictionary dictionary];
+
+    for (NSUInteger masterIndex = 0; masterIndex < masterCount; masterIndex++) {
+        ODOTestCaseMaster *master = [self _insertMasterWithPrimaryKey:[NSString stringWithFormat:@"m%lu", masterIndex]];
+        expectedMasterNames[master.objectID.primaryKey] = master.name;
+
+        if (masterIndex % 3 == 0) {
+            ODOTestCaseDetail *detail = _insertDetail(_editingContext, [NSString stringWithFormat:@"d%lu", masterIndex], master);
+            detail.name = [@"detail-" stringByAppendingString:master.name];
+            expectedDetailNames[detail.objectID.primaryKey] = detail.name;
+        }
+    }
+
+    NSError *error = nil;
+    OBShouldNotError([self save:&error]);
+    XCTAssertEqualObjects([self _committedNamesForEntityName:ODOTestCaseMasterEntityName], expectedMasterNames);
+    XCTAssertEqualObjects([self _committedNamesForEntityName:ODOTestCaseDetailEntityName], expectedDetailNames);
+
+    // Delete every other master (cascading to their details), and rename the rest.
+    ODOFetchRequest *fetch = [[ODOFetchRequest alloc] init];
+    [fetch setEntity:[ODOTestCaseModel() entityNamed:ODOTestCaseMasterEntityName]];
+    NSArray *masters;
+    OBShouldNotError((masters = [_editingContext executeFetchRequest:fetch error:&error]) != nil);
+
+    for (ODOTestCaseMaster *master in masters) {
+        NSString *primaryKey = master.objectID.primaryKey;
+        if ([[primaryKey substringFromIndex:1] integerValue] % 2 == 0) {
+            for (ODOTestCaseDetail *detail in master.details)
+                [expectedDetailNames removeObjectForKey:detail.objectID.primaryKey];
+            [expectedMasterNames removeObjectForKey:primaryKey];
+            OBShouldNotError([_editingContext deleteObject:master error:&error]);
+        } else {
+            master.name = [@"renamed-" stringByAppendingString:primaryKey];
+            expectedMasterNames[primaryKey] = master.name;
+        }
+    }
+
+    OBShouldNotError([self save:&error]);
+    XCTAssertEqualObjects([self _committedNamesForEntityName:ODOTestCaseMasterEntityName], expectedMasterNames);
+    XCTAssertEqualObjects([self _committedNamesForEntityName:ODOTestCaseDetailEntityName], expectedDetailNames);
+}
+
+// Each row of a batch binds its values after the previous row's, so make sure every attribute type lands in the right column.
+- (void)testBatchedInsertOfAllAttributeTypes;
+{
+    static const NSUInteger objectCount = 300;
+    NSMutableArray <ODOObjectID *> *objectIDs = [NSMutableArray array];
+
+    for (NSUInteger objectIndex = 0; objectIndex < objectCount; objectIndex++) {
+        ODOTestCaseAllAttributeTypes *object = [[ODOTestCaseAllAttributeTypes alloc] initWithEntity:[ODOTestCaseModel() entityNamed:ODOTestCaseAllAttributeTypesEntityName] primaryKey:nil insertingIntoEditingContext:_editingContext];
+        object.int16 = (int16_t)objectIndex;
+        object.int32 = (int32_t)objectIndex * 1000;
+        object.int64 = (int64_t)objectIndex * 1000000000LL;
+        object.float32 = objectIndex / 4.0f;
+        object.float64 = objectIndex / 8.0;
+        object.string = [NSString stringWithFormat:@"string %lu", objectIndex];
+        object.boolean = (objectIndex % 2) == 1;
+        object.date = [NSDate dateWithTimeIntervalSinceReferenceDate:objectIndex];
+        object.data = [object.string dataUsingEncoding:NSUTF8StringEncoding];
+        [objectIDs addObject:object.objectID];
+    }
+
+    NSError *error = nil;
+    OBShouldNotError([self save:&error]);
+    [_editingContext reset];
+
+    [objectIDs enumerateObjectsUsingBlock:^(ODOObjectID *objectID, NSUInteger objectIndex, BOOL *stop) {
+        NSError *fetchError = nil;
+        ODOTestCaseAllAttributeTypes *object = (ODOTestCaseAllAttributeTypes *)[_editingContext fetchObjectWithObjectID:objectID error:&fetchError];
+        OBShouldNotError(object != nil);
+
+        XCTAssertEqual(object.int16, (int16_t)objectIndex);
+        XCTAssertEqual(object.int32, (int32_t)objectIndex * 1000);
+        XCTAssertEqual(object.int64, (int64_t)objectIndex * 1000000000LL);
+        XCTAssertEqual(object.float32, objectIndex / 4.0f);
+        XCTAssertEqual(object.float64, objectIndex / 8.0);
+        XCTAssertEqualObjects(object.string, ([NSString stringWithFormat:@"string %lu", objectIndex]));
+        XCTAssertEqual(object.boolean, (BOOL)((objectIndex % 2) == 1));
+        XCTAssertEqualObjects(object.date, [NSDate dateWithTimeIntervalSinceReferenceDate:objectIndex]);
+        XCTAssertEqualObjects(object.data, [object.string dataUsingEncoding:NSUTF8StringEncoding]);
+    }];
+}
+
+- (void)testInsertAndDeletePerformance;
+{
+    if (![[self class] shouldRunSlowUnitTests]) {
+        NSLog(@"*** SKIPPING slow test [%@ %@]", [self class], NSStringFromSelector(_cmd));
+        return;
+    }
+
+    static const NSUInteger masterCount = 100000;
+    __block NSUInteger iteration = 0;
+
+    // Don't time (or keep) a million undo registrations.
+    [_editingContext setUndoManager:nil];
+
+    [self measureBlock:^{
+        NSMutableArray <ODOTestCaseMaster *> *masters = [NSMutableArray arrayWithCapacity:masterCount];
+        for (NSUInteger masterIndex = 0; masterIndex < masterCount; masterIndex++)
+            [masters addObject:[self _insertMasterWithPrimaryKey:[NSString stringWithFormat:@"%lu-%lu", iteration, masterIndex]]];
+        iteration++;
+
+        NSError *error = nil;
+        OBShouldNotError([self save:&error]);
+
+        for (ODOTestCaseMaster *master in masters)
+            OBShouldNotError([_editingContext deleteObject:master error:&error]);
+        OBShouldNotError([self save:&error]);
+    }];
+
+    uint64_t rowCount = UINT64_MAX;
+    NSError *error = nil;
+    OBShouldNotError([_database fetchCommittedRowCount:&rowCount fromEntity:[ODOTestCaseModel() entityNamed:ODOTestCaseMasterEntityName] matchingPredicate:nil error:&error]);
+    XCTAssertEqual(rowCount, 0ULL);
+}
+
+@end
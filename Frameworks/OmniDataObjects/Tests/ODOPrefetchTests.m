@@ -0,0 +1,150 @@
+// Copyright 2026 Omni Development, Inc. All rights reserved.
+//
+// This software may only be used and reproduced according to the
+// terms in the file OmniSourceLicense.html, which should be
+// distributed with this project and can also be found at
+// <http://www.omnigroup.com/developer/sourcecode/sourcelicense/>.
+
+#import "ODOTestCase.h"
+
+#import "ODOTestCaseModel.h"
+
+RCS_ID("$Id$")
+
+OB_REQUIRE_ARC;
+
+@interface ODOPrefetchTests : ODOTestCase
+@end
+
+@implementation ODOPrefetchTests
+
+static const NSUInteger MasterCount = 50;
+static const NSUInteger DetailsPerMaster = 3;
+
+- (void)setUp;
+{
+    [super setUp];
+
+    for (NSUInteger masterIndex = 0; masterIndex < MasterCount; masterIndex++) {
+        ODOTestCaseMaster *master = [[ODOTestCaseMaster alloc] initWithEntity:[ODOTestCaseModel() entityNamed:ODOTestCaseMasterEntityName] primaryKey:[NSString stringWithFormat:@"m%lu", masterIndex] insertingIntoEditingContext:_editingContext];
+        master.name = [NSString stringWithFormat:@"master %lu", masterIndex];
+
+        for (NSUInteger detailIndex = 0; detailIndex < DetailsPerMaster; detailIndex++) {
+            ODOTestCaseDetail *detail = _insertDetail(_editingContext, [NSString stringWithFormat:@"m%lu-d%lu", masterIndex, detailIndex], master);
+            detail.name = [NSString stringWithFormat:@"detail %lu of %@", detailIndex, master.name];
+        }
+    }
+
+    NSError *error = nil;
+    OBShouldNotError([self save:&error]);
+    [_editingContext reset];
+}
+
+- (NSArray *)_fetchEntityNamed:(NSString *)entityName prefetching:(NSArray <NSString *> *)keyPaths;
+{
+    ODOFetchRequest *fetch = [[ODOFetchRequest alloc] init];
+    fetch.entity = [ODOTestCaseModel() entityNamed:entityName];
+    fetch.relationshipKeyPathsForPrefetching = keyPaths;
+
+    NSError *error = nil;
+    NSArray *results;
+    OBShouldNotError((results = [_editingContext executeFetchRequest:fetch error:&error]) != nil);
+    return results;
+}
+
+- (void)testWithoutPrefetchingEachRelationshipIsAQuery;
+{
+    NSUInteger queryCount = _editingContext.fetchQueryCounter;
+    NSArray <ODOTestCaseMaster *> *masters = [self _fetchEntityNamed:ODOTestCaseMasterEntityName prefetching:nil];
+    XCTAssertEqual(_editingContext.fetchQueryCounter - queryCount, 1UL);
+
+    for (ODOTestCaseMaster *master in masters)
+        XCTAssertEqual([master.details count], DetailsPerMaster);
+    XCTAssertEqual(_editingContext.fetchQueryCounter - queryCount, 1 + MasterCount);
+}
+
+- (void)testPrefetchingToMany;
+{
+    NSUInteger queryCount = _editingContext.fetchQueryCounter;
+    NSArray <ODOTestCaseMaster *> *masters = [self _fetchEntityNamed:ODOTestCaseMasterEntityName prefetching:@[ODOTestCaseMasterDetails]];
+    XCTAssertEqual([masters count], MasterCount);
+    XCTAssertEqual(_editingContext.fetchQueryCounter - queryCount, 2UL);
+
+    for (ODOTestCaseMaster *master in masters) {
+        XCTAssertEqual([master.details count], DetailsPerMaster);
+        for (ODOTestCaseDetail *detail in master.details) {
+            XCTAssertFalse([detail isFault]);
+            XCTAssertEqual(detail.master, master);
+            XCTAssertTrue([detail.name hasSuffix:master.name]);
+        }
+    }
+    XCTAssertEqual(_editingContext.fetchQueryCounter - queryCount, 2UL);
+}
+
+- (void)testPrefetchingToOne;
+{
+    NSUInteger queryCount = _editingContext.fetchQueryCounter;
+    NSArray <ODOTestCaseDetail *> *details = [self _fetchEntityNamed:ODOTestCaseDetailEntityName prefetching:@[ODOTestCaseDetailMaster]];
+    XCTAssertEqual([details count], MasterCount * DetailsPerMaster);
+    XCTAssertEqual(_editingContext.fetchQueryCounter - queryCount, 2UL);
+
+    for (ODOTestCaseDetail *detail in details) {
+        XCTAssertFalse([detail.master isFault]);
+        XCTAssertTrue([detail.name hasSuffix:detail.master.name]);
+    }
+    XCTAssertEqual(_editingContext.fetchQueryCounter - queryCount, 2UL);
+}
+
+- (void)testPrefetchingKeyPath;
+{
+    NSUInteger queryCount = _editingContext.fetchQueryCounter;
+    NSArray <ODOTestCaseDetail *> *details = [self _fetchEntityNamed:ODOTestCaseDetailEntityName prefetching:@[@"master.details"]];
+    XCTAssertEqual(_editingContext.fetchQueryCounter - queryCount, 3UL);
+
+    for (ODOTestCaseDetail *detail in details)
+        XCTAssertTrue([detail.master.details member:detail] == detail);
+    XCTAssertEqual(_editingContext.fetchQueryCounter - queryCount, 3UL);
+}
+
+- (void)testPrefetchingFaults;
+{
+    // Following the to-one relationships makes faults for the masters, but doesn't fetch them.
+    NSArray <ODOTestCaseDetail *> *details = [self _fetchEntityNamed:ODOTestCaseDetailEntityName prefetching:nil];
+    NSArray <ODOTestCaseMaster *> *masters = [details valueForKey:ODOTestCaseDetailMaster];
+    for (ODOTestCaseMaster *master in masters)
+        XCTAssertTrue([master isFault]);
+
+    NSUInteger queryCount = _editingContext.fetchQueryCounter;
+    NSError *error = nil;
+    OBShouldNotError([_editingContext prefetchRelationshipKeyPaths:@[] forObjects:masters error:&error]);
+    XCTAssertEqual(_editingContext.fetchQueryCounter - queryCount, 1UL);
+
+    for (ODOTestCaseMaster *master in masters)
+        XCTAssertFalse([master isFault]);
+}
+
+- (void)testPrefetchingIncludesUnsavedEdits;
+{
+    NSArray <ODOTestCaseDetail *> *details = [self _fetchEntityNamed:ODOTestCaseDetailEntityName prefetching:nil];
+    ODOTestCaseDetail *movedDetail = [details firstObject];
+    ODOTestCaseMaster *originalMaster = movedDetail.master;
+
+    NSArray <ODOTestCaseMaster *> *masters = [self _fetchEntityNamed:ODOTestCaseMasterEntityName prefetching:nil];
+    ODOTestCaseMaster *newMaster = [masters firstObject] == originalMaster ? [masters lastObject] : [masters firstObject];
+
+    // Move one detail and insert another; neither is saved, and the masters' to-many relationships are still faults.
+    movedDetail.master = newMaster;
+    ODOTestCaseDetail *insertedDetail = _insertDetail(_editingContext, @"inserted", originalMaster);
+    [_editingContext processPendingChanges];
+
+    NSError *error = nil;
+    OBShouldNotError([_editingContext prefetchRelationshipKeyPaths:@[ODOTestCaseMasterDetails] forObjects:masters error:&error]);
+
+    XCTAssertTrue([originalMaster.details member:insertedDetail] == insertedDetail);
+    XCTAssertNil([originalMaster.details member:movedDetail]);
+    XCTAssertTrue([newMaster.details member:movedDetail] == movedDetail);
+    XCTAssertEqual([originalMaster.details count], DetailsPerMaster);
+    XCTAssertEqual([newMaster.details count], DetailsPerMaster + 1);
+}
+
+@end
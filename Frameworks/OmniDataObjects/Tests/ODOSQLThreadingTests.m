@@ -11,6 +11,8 @@
 #import <OmniDataObjects/ODOSQLConnection.h>
 #import <OmniDataObjects/ODOSQLStatement.h>
 
+#import "ODOTestCaseModel.h"
+
 RCS_ID("$Id$");
 
 #if OB_ARC
@@ -115,4 +117,124 @@ RCS_ID("$Id$");
     [queue release];
 }
 
+- (void)_insertMasterCount:(NSUInteger)masterCount;
+{
+    for (NSUInteger masterIndex = 0; masterIndex < masterCount; masterIndex++) {
+        ODOTestCaseMaster *master = [[ODOTestCaseMaster alloc] initWithEntity:[ODOTestCaseModel() entityNamed:ODOTestCaseMasterEntityName] primaryKey:nil insertingIntoEditingContext:_editingContext];
+        master.name = [NSString stringWithFormat:@"master %lu", masterIndex];
+        [master release];
+    }
+    
+    NSError *error = nil;
+    OBShouldNotError([self save:&error]);
+}
+
+- (void)testManyConcurrentStatementsWithReadOnlyConnections;
+{
+    _database.maximumReadOnlyConnectionCount = 4;
+    [self _insertMasterCount:10];
+    
+    NSOperationQueue *queue = [[NSOperationQueue alloc] init];
+    queue.maxConcurrentOperationCount = 20;
+    queue.suspended = YES;
+    
+    ODOEntity *entity = [_database.model entityNamed:ODOTestCaseMasterEntityName];
+    NSArray *attributes = @[[entity attributesByName][ODOTestCaseMasterName]];
+    
+    for (NSUInteger i = 0; i < 2000; i++) {
+        [queue addOperationWithBlock:^{
+            uint64_t rowCount = UINT64_MAX;
+            NSError *error = nil;
+            XCTAssertTrue([_database fetchCommittedRowCount:&rowCount fromEntity:entity matchingPredicate:nil error:&error]);
+            XCTAssertNil(error);
+            XCTAssertEqual(10UL, rowCount);
+            
+            NSArray *rows = [_database fetchCommittedAttributes:attributes fromEntity:entity matchingPredicate:nil error:&error];
+            XCTAssertNil(error);
+            XCTAssertEqual([rows count], 10UL);
+        }];
+    }
+    
+    queue.suspended = NO;
+    [queue waitUntilAllOperationsAreFinished];
+    
+    [queue release];
+}
+
+- (void)testReadOnlyConnectionsSeeOnlyCommittedChanges;
+{
+    _database.maximumReadOnlyConnectionCount = 2;
+    ODOEntity *entity = [_database.model entityNamed:ODOTestCaseMasterEntityName];
+    
+    [self _insertMasterCount:5];
+    
+    uint64_t rowCount = UINT64_MAX;
+    NSError *error = nil;
+    OBShouldNotError([_database fetchCommittedRowCount:&rowCount fromEntity:entity matchingPredicate:nil error:&error]);
+    XCTAssertEqual(rowCount, 5ULL);
+    
+    // Unsaved inserts aren't visible, but become so once saved.
+    ODOTestCaseMaster *master = [[ODOTestCaseMaster alloc] initWithEntity:entity primaryKey:nil insertingIntoEditingContext:_editingContext];
+    [master release];
+    [_editingContext processPendingChanges];
+    OBShouldNotError([_database fetchCommittedRowCount:&rowCount fromEntity:entity matchingPredicate:nil error:&error]);
+    XCTAssertEqual(rowCount, 5ULL);
+    
+    OBShouldNotError([self save:&error]);
+    OBShouldNotError([_database fetchCommittedRowCount:&rowCount fromEntity:entity matchingPredicate:nil error:&error]);
+    XCTAssertEqual(rowCount, 6ULL);
+    
+    // Lowering the limit closes the idle connections; reads fall back to the primary connection.
+    _database.maximumReadOnlyConnectionCount = 0;
+    OBShouldNotError([_database fetchCommittedRowCount:&rowCount fromEntity:entity matchingPredicate:nil error:&error]);
+    XCTAssertEqual(rowCount, 6ULL);
+}
+
+#pragma mark Benchmarks
+
+// Runs batches of whole-table reads on several threads while the main thread keeps saving.
+- (void)_measureCommittedFetchesDuringSavesWithReadOnlyConnectionCount:(NSUInteger)connectionCount;
+{
+    if (![[self class] shouldRunSlowUnitTests]) {
+        NSLog(@"*** SKIPPING slow test [%@ %@]", [self class], NSStringFromSelector(_cmd));
+        return;
+    }
+    
+    _database.maximumReadOnlyConnectionCount = connectionCount;
+    [_editingContext setUndoManager:nil];
+    [self _insertMasterCount:20000];
+    
+    ODOEntity *entity = [_database.model entityNamed:ODOTestCaseMasterEntityName];
+    NSArray *attributes = @[[entity attributesByName][ODOTestCaseMasterName]];
+    
+    [self measureBlock:^{
+        NSOperationQueue *queue = [[NSOperationQueue alloc] init];
+        queue.maxConcurrentOperationCount = 8;
+        
+        for (NSUInteger i = 0; i < 64; i++) {
+            [queue addOperationWithBlock:^{
+                NSError *error = nil;
+                NSArray *rows = [_database fetchCommittedAttributes:attributes fromEntity:entity matchingPredicate:nil error:&error];
+                XCTAssertNotNil(rows);
+            }];
+        }
+        
+        while ([queue operationCount] > 0)
+            [self _insertMasterCount:100];
+        
+        [queue waitUntilAllOperationsAreFinished];
+        [queue release];
+    }];
+}
+
+- (void)testCommittedFetchesDuringSavesOnPrimaryConnectionPerformance;
+{
+    [self _measureCommittedFetchesDuringSavesWithReadOnlyConnectionCount:0];
+}
+
+- (void)testCommittedFetchesDuringSavesOnReadOnlyConnectionsPerformance;
+{
+    [self _measureCommittedFetchesDuringSavesWithReadOnlyConnectionCount:4];
+}
+
 @end
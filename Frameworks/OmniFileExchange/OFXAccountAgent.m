@@ -24,7 +24,7 @@
 #import "OFXContainerScan.h"
 #import "OFXDAVUtilities.h"
 #import "OFXFileItem-Internal.h"
-#import "OFXFileItemTransfers.h"
+#import "OFXTransferScheduler.h"
 #import "OFXFileSnapshotTransfer.h"
 
 #if defined(TARGET_OS_IPHONE) && TARGET_OS_IPHONE
@@ -103,9 +103,7 @@ static OFPreference *OFXRecentTransferErrorThresholdBeforeAutomaticallyStopping;
     NSURLCredential *_credentialsForCurrentSync;
     
     // Pending/running file transfers
-    OFXFileItemTransfers *_uploadFileItemTransfers;
-    OFXFileItemTransfers *_downloadFileItemTransfers;
-    OFXFileItemTransfers *_deleteFileItemTransfers;
+    OFXTransferScheduler *_transferScheduler;
     
     BOOL _needsToNilLastError; // accessed on the operation queue, used to keep from redundant blocks for setting lastError to nil on the main queue
     
@@ -425,14 +423,8 @@ static NSSet <NSString *> *_lowercasePathExtensions(id <NSFastEnumeration> pathE
         
         _runningTransfers = [NSMutableSet new];
         
-        OBASSERT(_uploadFileItemTransfers == nil);
-        _uploadFileItemTransfers = [OFXFileItemTransfers new];
-        
-        OBASSERT(_downloadFileItemTransfers == nil);
-        _downloadFileItemTransfers = [OFXFileItemTransfers new];
-        
-        OBASSERT(_deleteFileItemTransfers == nil);
-        _deleteFileItemTransfers = [OFXFileItemTransfers new];
+        OBASSERT(_transferScheduler == nil);
+        _transferScheduler = [[OFXTransferScheduler alloc] initWithMaximumTransferCount:_clientParameters.maximumTransferCount maximumTransferCountPerContainer:_clientParameters.maximumTransferCountPerContainer];
         
         NSMutableDictionary *unusedPathExtensionToLocalContainerURL = [NSMutableDictionary dictionary];
         for (NSURL *existingContainerDirectoryURL in existingContainerDirectoryURLs) {
@@ -519,9 +511,7 @@ static NSSet <NSString *> *_lowercasePathExtensions(id <NSFastEnumeration> pathE
         _runningTransfers = nil;
         
         // OBASSERT(_uploadRunningFileItems == nil); We can't assert this. We could have transfer operations that we are going to abandon. Even if we did wait for them, their completion handlers would come back to the queue we are currently running on (so we couldn't wait for them). Rather than convoluting stuff to allow waiting for the operations, we need to make all their completion handlers support abandonment.
-        _uploadFileItemTransfers = nil;
-        _downloadFileItemTransfers = nil;
-        _deleteFileItemTransfers = nil;
+        _transferScheduler = nil;
 
         [_containerIdentifierToContainerAgent enumerateKeysAndObjectsUsingBlock:^(NSString *identifier, OFXContainerAgent *containerAgent, BOOL *stop) {
             [containerAgent stop];
@@ -855,7 +845,7 @@ static NSSet <NSString *> *_lowercasePathExtensions(id <NSFastEnumeration> pathE
     _serverContainerIdentifiers = [serverContainerIdentifiers copy];
     
     // If no transfers were started already, try again. We might have some local files sitting around that need to be uploaded, but failed to due to a previous error (so no new changes, just previous failures).
-    if ([_runningTransfers count] == 0 && _uploadFileItemTransfers.empty && _downloadFileItemTransfers.empty && _deleteFileItemTransfers.empty) {
+    if ([_runningTransfers count] == 0 && _transferScheduler.empty) {
         [self containerNeedsFileTransfer:nil requestRecorded:^{
             // If someone is waiting on this block, let them proceed.
             DEBUG_TRANSFER(2, @"Transfer request recorded");
@@ -991,37 +981,33 @@ static NSSet <NSString *> *_lowercasePathExtensions(id <NSFastEnumeration> pathE
         [_containerIdentifierToContainerAgent enumerateKeysAndObjectsUsingBlock:^(NSString *identifier, OFXContainerAgent *container, BOOL *stop) {
             DEBUG_TRANSFER(2, @"Checking container %@", identifier);
             [container collectNeededFileTransfers:^(OFXFileItem *fileItem, OFXFileItemTransferKind kind){
-                OFXFileItemTransfers *transfers;
-                
                 NSString *kindName;
                 if (kind == OFXFileItemUploadTransferKind) {
                     // We have to handle doing an upload of missing+moved, which would otherwise not be valid for upload. The upload transfer handles this case.
                     OBASSERT(fileItem.isValidToUpload || (fileItem.localState.missing && fileItem.localState.userMoved && !fileItem.remoteState.missing && !fileItem.remoteState.deleted));
                     OBASSERT(fileItem.remoteState.missing || fileItem.localState.edited || fileItem.localState.userMoved);
-                    transfers = _uploadFileItemTransfers;
                     kindName = @"upload";
                 } else if (kind == OFXFileItemDownloadTransferKind) {
                     OBASSERT(fileItem.localState.missing || fileItem.remoteState.edited || fileItem.remoteState.userMoved);
-                    transfers = _downloadFileItemTransfers;
                     kindName = @"download";
                 } else if (kind == OFXFileItemDeleteTransferKind) {
                     OBASSERT(fileItem.localState.deleted);
-                    transfers = _deleteFileItemTransfers;
                     kindName = @"delete";
                 } else {
                     OBASSERT_NOT_REACHED("Unknown transfer kind %ld", kind);
                     return;
                 }
-                OBASSERT(transfers);
                 
                 // Make sure we don't start redundant transfers. When transfers end, the container should check if another is needed.
-                if ([transfers containsFileItem:fileItem]) {
+                if ([_transferScheduler containsFileItem:fileItem kind:kind]) {
                     DEBUG_TRANSFER(2, @"Skipping possibly redundant request for transfer of %@", fileItem);
+                    // The user may have asked for the contents of a file we were only going to fetch metadata for.
+                    [_transferScheduler updatePriorityOfRequestedFileItem:fileItem kind:kind];
                     return;
                 }
                 
                 DEBUG_TRANSFER(1, @"Requesting %@ of %@", kindName, fileItem.shortDescription);
-                [transfers addRequestedFileItem:fileItem];
+                [_transferScheduler addRequestedFileItem:fileItem kind:kind];
                 
                 if (!started) {
                     started = YES;
@@ -1189,9 +1175,7 @@ static NSSet <NSString *> *_lowercasePathExtensions(id <NSFastEnumeration> pathE
     // We report zero when stopped instead of an error, but we might change that later if it is more useful.
     NSUInteger count = 0;
     
-    count += _uploadFileItemTransfers.numberRequested + _uploadFileItemTransfers.numberRunning;
-    count += _downloadFileItemTransfers.numberRequested + _downloadFileItemTransfers.numberRunning;
-    count += _deleteFileItemTransfers.numberRequested + _deleteFileItemTransfers.numberRunning;
+    count += _transferScheduler.numberRequested + _transferScheduler.numberRunning;
     
     DEBUG_TRANSFER(2, @"Counting pending transfers: %lu", count);
     return count;
@@ -1710,30 +1694,48 @@ static NSString * const OFXContainerPathExtension = @"container";
     return containerAgent;
 }
 
-- (void)_startTransferOperations:(OFXFileItemTransfers *)transfers ofType:(NSString *)typeName byApplier:(OFXFileSnapshotTransfer *(^)(OFXContainerAgent *containerAgent, OFXFileItem *fileItem, NSError **outError))applier;
+- (void)_startTransferOperations;
 {
     OBPRECONDITION(self.backgroundState == OFXAccountAgentStateStarted);
     
     if (!self.backgroundSyncingEnabled)
         return;
-        
-    while (transfers.numberRunning < 2) {
-        OFXFileItem *fileItem = [transfers anyRequest];
-        if (!fileItem)
-            break; // Nothing to do.
-        
+    
+    // Pick up any changes to the limits.
+    _transferScheduler.maximumTransferCount = _clientParameters.maximumTransferCount;
+    _transferScheduler.maximumTransferCountPerContainer = _clientParameters.maximumTransferCountPerContainer;
+    
+    OFXTransferScheduler *scheduler = _transferScheduler;
+    OFXFileItem *fileItem;
+    OFXFileItemTransferKind kind;
+    while ((fileItem = [scheduler nextRequestedFileItem:&kind])) {
         OFXContainerAgent *containerAgent = fileItem.container;
         if (!containerAgent) {
             // Invalidated, possibly due to shutting down.
-            [transfers removeRequestedFileItem:fileItem];
+            [scheduler removeRequestedFileItem:fileItem kind:kind];
             continue;
         }
         
+        NSString *typeName;
+        OFXFileSnapshotTransfer *transfer;
         __autoreleasing NSError *error;
-        OFXFileSnapshotTransfer *transfer = applier(containerAgent, fileItem, &error);
+        switch (kind) {
+            case OFXFileItemUploadTransferKind:
+                typeName = @"upload";
+                transfer = [containerAgent prepareUploadTransferForFileItem:fileItem error:&error];
+                break;
+            case OFXFileItemDownloadTransferKind:
+                typeName = @"download";
+                transfer = [containerAgent prepareDownloadTransferForFileItem:fileItem error:&error];
+                break;
+            case OFXFileItemDeleteTransferKind:
+                typeName = @"delete";
+                transfer = [containerAgent prepareDeleteTransferForFileItem:fileItem error:&error];
+                break;
+        }
         if (!transfer) {
             [_account reportError:error format:@"Error starting %@ of %@", typeName, [fileItem shortDescription]];
-            [transfers removeRequestedFileItem:fileItem];
+            [scheduler removeRequestedFileItem:fileItem kind:kind];
             continue;
         }
         
@@ -1741,7 +1743,7 @@ static NSString * const OFXContainerPathExtension = @"container";
             OBASSERT([NSOperationQueue currentQueue] == _operationQueue);
             if ([_runningTransfers member:xfer] == nil) {
                 // Cancelled previously. We assume that if we've been restarted since the last stop, another transfer will complete that will provoke the next -_startTransferOperations.
-                OBASSERT(![transfers containsFileItem:fileItem]);
+                OBASSERT(![scheduler containsFileItem:fileItem kind:kind]);
             } else {
                 if ([errorOrNil causedByUserCancelling])
                     errorOrNil = nil;
@@ -1750,9 +1752,12 @@ static NSString * const OFXContainerPathExtension = @"container";
                     [_account reportError:errorOrNil];
                 }
 
-                [transfers finishedFileItem:fileItem];
+                [scheduler finishedFileItem:fileItem kind:kind byteCount:xfer.bytesTransferred];
                 [_runningTransfers removeObject:xfer];
                 
+                NSString *host = xfer.connection.baseURL.host;
+                DEBUG_TRANSFER(2, @"Finished %@ of %@, %lld bytes; %@ averaging %.0f bytes/second", typeName, [fileItem shortDescription], xfer.bytesTransferred, host, [scheduler bytesPerSecondForHost:host]);
+                
                 [_operationQueue addOperationWithBlock:^{
                     if (self.backgroundState != OFXAccountAgentStateStarted)
                         return;
@@ -1762,25 +1767,25 @@ static NSString * const OFXContainerPathExtension = @"container";
             return nil;
         }];
         
-        [transfers startedFileItem:fileItem];
+        DEBUG_TRANSFER(1, @"Starting %@ of %@", typeName, [fileItem shortDescription]);
+        [scheduler startedFileItem:fileItem kind:kind host:transfer.connection.baseURL.host];
         [_runningTransfers addObject:transfer];
-        [transfer start];
+        
+        NSTimeInterval latency = _clientParameters.simulatedTransferLatency;
+        if (latency > 0) {
+            // Testing hook; the transfer holds its place in the scheduler while it waits, as it would while waiting on a slow server.
+            NSOperationQueue *operationQueue = _operationQueue;
+            dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(latency * NSEC_PER_SEC)), dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+                [operationQueue addOperationWithBlock:^{
+                    if (!transfer.cancelled)
+                        [transfer start];
+                }];
+            });
+        } else
+            [transfer start];
     }
 }
 
-- (void)_startTransferOperations;
-{
-    [self _startTransferOperations:_uploadFileItemTransfers ofType:@"upload" byApplier:^OFXFileSnapshotTransfer *(OFXContainerAgent *containerAgent, OFXFileItem *fileItem, NSError **outError) {
-        return [containerAgent prepareUploadTransferForFileItem:fileItem error:outError];
-    }];
-    [self _startTransferOperations:_downloadFileItemTransfers ofType:@"download" byApplier:^OFXFileSnapshotTransfer *(OFXContainerAgent *containerAgent, OFXFileItem *fileItem, NSError **outError) {
-        return [containerAgent prepareDownloadTransferForFileItem:fileItem error:outError];
-    }];
-    [self _startTransferOperations:_deleteFileItemTransfers ofType:@"delete" byApplier:^OFXFileSnapshotTransfer *(OFXContainerAgent *containerAgent, OFXFileItem *fileItem, NSError **outError) {
-        return [containerAgent prepareDeleteTransferForFileItem:fileItem error:outError];
-    }];
-}
-
 - (void)_cancelTransfers;
 {
     OBPRECONDITION(self.backgroundState == OFXAccountAgentStateStarted);
@@ -1790,9 +1795,7 @@ static NSString * const OFXContainerPathExtension = @"container";
         [transfer cancelForShutdown:NO];
     OBASSERT([_runningTransfers count] == 0); // They should have called back...
     
-    [_uploadFileItemTransfers reset];
-    [_downloadFileItemTransfers reset];
-    [_deleteFileItemTransfers reset];
+    [_transferScheduler reset];
     [_runningTransfers removeAllObjects];
 }
 
@@ -16,8 +16,14 @@
 
 @property(nonatomic) NSTimeInterval metadataUpdateInterval; // How often OFXFileMetadata updates will be published.
 
+@property(nonatomic) NSUInteger maximumTransferCount; // How many uploads, downloads and deletes may run at once for the account.
+@property(nonatomic) NSUInteger maximumTransferCountPerContainer; // ... and for each container within it.
+
+@property(nonatomic) BOOL chunkedStorage; // Store large files as content-defined chunks so small edits upload and download only the chunks that changed. Off by default since every client of the account must understand chunked snapshots.
+
 // Testing hooks
 @property(nonatomic) BOOL deletePreviousFileVersionAfterNewVersionUploaded; // Allows us to test our clean up of stale files
 @property(nonatomic) BOOL deleteStaleFileVersionsWhenSyncing;
+@property(nonatomic) NSTimeInterval simulatedTransferLatency; // Delays the start of each transfer, to stand in for a distant server
 
 @end
@@ -17,6 +17,9 @@ static OFDeclareTimeInterval(OFXAccountInfoRemoteTemporaryFileCleanupInterval, 2
 
 static OFDeclareTimeInterval(OFXAccountMetadataUpdateInterval, 0.25, 0.01, 2.0); // How often file metadata updates will be published
 
+static OFDeclareIntegerConfigurationValue(OFXAccountMaximumTransferCount, 6, 1, 32); // Transfers mostly wait on the network, so running several helps on slow links.
+static OFDeclareIntegerConfigurationValue(OFXAccountMaximumTransferCountPerContainer, 4, 1, 32); // Leave room for other containers' transfers.
+
 @implementation OFXAccountClientParameters
 
 + (void)initialize;
@@ -37,6 +40,9 @@ static OFDeclareTimeInterval(OFXAccountMetadataUpdateInterval, 0.25, 0.01, 2.0);
     
     _metadataUpdateInterval = OFXAccountMetadataUpdateInterval;
     
+    _maximumTransferCount = OFXAccountMaximumTransferCount;
+    _maximumTransferCountPerContainer = OFXAccountMaximumTransferCountPerContainer;
+    
     // Testing hooks:
     
     _deletePreviousFileVersionAfterNewVersionUploaded = YES;
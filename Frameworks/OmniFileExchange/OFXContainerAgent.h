@@ -55,6 +55,7 @@ typedef NS_ENUM(NSUInteger, OFXFileItemTransferKind) {
 @property(nonatomic,readonly) BOOL hasCreatedRemoteContainerDirectory;
 
 @property(nonatomic,readonly) NSURL *localSnapshotsDirectory; // Internal directory for the client snapshot that originated from the server or needs to be uploaded, etc.
+@property(nonatomic,readonly) NSURL *localPartialDownloadsDirectory; // Internal directory for the contents of downloads that haven't finished, by file item identifier.
 
 @property(nonatomic,readonly) NSURL *remoteTemporaryDirectory;
 
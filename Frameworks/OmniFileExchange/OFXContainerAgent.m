@@ -138,6 +138,8 @@ static NSString * const OFXNoPathExtensionContainerIdentifier = @"no.extension";
     
     if (!(_localSnapshotsDirectory = _createContainerSubdirectory(_localContainerDirectory, @"Snapshots", outError)))
         return nil;
+    if (!(_localPartialDownloadsDirectory = _createContainerSubdirectory(_localContainerDirectory, @"PartialDownloads", outError)))
+        return nil;
     
     _remoteTemporaryDirectory = [[remoteTemporaryDirectory absoluteURL] copy];
     
@@ -1053,7 +1055,7 @@ tryAgain:
 
     completionHandler = [completionHandler copy];
     [self _operateOnFileAtURL:fileURL errorHandler:completionHandler withAction:^(OFXFileItem *fileItem){
-        [fileItem setContentsRequested];
+        [fileItem setContentsRequestedByUser];
         
         OFXAccountAgent *accountAgent = _weak_accountAgent;
         if (!accountAgent) {
@@ -1482,12 +1484,37 @@ tryAgain:
         [_documentIndex registerScannedLocalFileItem:fileItem];
     }
     
+    [self _removeAbandonedPartialDownloads];
+    
     DEBUG_SCAN(2, @"_documentIndex = %@", [_documentIndex debugDictionary]);
     
     [self _updatePublishedFileVersions];
     OBPOSTCONDITION([self _checkInvariants]);
 }
 
+// Partial downloads are kept around for the next attempt, but not for file items that have gone away since.
+- (void)_removeAbandonedPartialDownloads;
+{
+    OBPRECONDITION([self _runningOnAccountAgentQueue]);
+    
+    __autoreleasing NSError *error = nil;
+    NSArray <NSURL *> *partialDownloadURLs = [[NSFileManager defaultManager] contentsOfDirectoryAtURL:_localPartialDownloadsDirectory includingPropertiesForKeys:nil options:0 error:&error];
+    if (!partialDownloadURLs) {
+        [error log:@"Unable to determine contents of PartialDownloads directory %@", _localPartialDownloadsDirectory];
+        return;
+    }
+    
+    for (NSURL *partialDownloadURL in partialDownloadURLs) {
+        if ([_documentIndex fileItemWithIdentifier:[partialDownloadURL lastPathComponent]])
+            continue;
+        
+        DEBUG_SCAN(1, @"Removing abandoned partial download %@", partialDownloadURL);
+        __autoreleasing NSError *removeError = nil;
+        if (![[NSFileManager defaultManager] removeItemAtURL:partialDownloadURL error:&removeError])
+            [removeError log:@"Error removing abandoned partial download %@", partialDownloadURL];
+    }
+}
+
 - (OFXFileItem *)_handleNewLocalDocument:(NSURL *)fileURL;
 {
     OBPRECONDITION([self _checkInvariants]); // checks the queue too
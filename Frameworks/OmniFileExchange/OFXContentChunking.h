@@ -0,0 +1,43 @@
+// Copyright 2026 Omni Development, Inc. All rights reserved.
+//
+// This software may only be used and reproduced according to the
+// terms in the file OmniSourceLicense.html, which should be
+// distributed with this project and can also be found at
+// <http://www.omnigroup.com/developer/sourcecode/sourcelicense/>.
+
+#import <Foundation/NSObject.h>
+
+/*
+ Chunked snapshots store large files as a list of content-defined chunks instead of one object named by the hash of the whole file. Chunk boundaries are picked with a rolling hash (FastCDC), so they depend only on the bytes near them; a small edit changes the chunks around it and the rest keep their hashes. Uploads then only need to send chunks the previous version didn't have, and downloads only need to fetch chunks that can't be found in the document we already have.
+
+ The chunk lists live in the snapshot's Info.plist under kOFXInfo_ChunksKey, keyed by the hash of the whole file, so the Contents tree (and so content comparisons between snapshots) is the same whether or not a snapshot is chunked.
+
+ The chunker's parameters and gear table are part of the storage format; changing them won't break anything, but will keep new uploads from sharing chunks with old ones.
+ */
+
+#define kOFXChunk_MinimumSize (256*1024)
+#define kOFXChunk_AverageSize (1024*1024)
+#define kOFXChunk_MaximumSize (4*1024*1024)
+
+// Calls the applier with consecutive ranges covering the data.
+extern void OFXEnumerateChunkRanges(NSData *data, void (^applier)(NSRange chunkRange)) OB_HIDDEN;
+
+// Returns a chunk list (an array of dictionaries with kOFXContents_FileHashKey and kOFXContents_FileSizeKey) for the data, or nil if it is small enough to store whole.
+extern NSArray <NSDictionary *> *OFXChunkListForData(NSData *data) OB_HIDDEN;
+
+// Returns a dictionary mapping file hashes to chunk lists for each large file in the contents tree, suitable for kOFXInfo_ChunksKey.
+extern NSDictionary <NSString *, NSArray *> *OFXRecordChunks(NSDictionary *contents, NSURL *localContentsURL, NSError **outError) OB_HIDDEN;
+
+// The names of the objects stored in the remote snapshot directory (other than the Info.plist) for a snapshot with the given Info.plist.
+extern NSSet <NSString *> *OFXStoredObjectNames(NSDictionary *infoDictionary) OB_HIDDEN;
+
+/*
+ Finds stored objects (chunks, or whole files) in a local copy of a document, so downloads can avoid fetching them again. Everything returned has been checked against its hash, so it is fine if the document has been edited since the snapshot was made; edited parts just won't be found.
+ */
+@interface OFXLocalChunkStore : NSObject
+
+- initWithInfoDictionary:(NSDictionary *)infoDictionary documentURL:(NSURL *)documentURL;
+
+- (NSData *)dataForObjectNamed:(NSString *)name;
+
+@end
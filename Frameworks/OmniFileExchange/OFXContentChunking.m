@@ -0,0 +1,246 @@
+// Copyright 2026 Omni Development, Inc. All rights reserved.
+//
+// This software may only be used and reproduced according to the
+// terms in the file OmniSourceLicense.html, which should be
+// distributed with this project and can also be found at
+// <http://www.omnigroup.com/developer/sourcecode/sourcelicense/>.
+
+#import "OFXContentChunking.h"
+
+#import "OFXFileSnapshot-Internal.h"
+#import "OFXFileSnapshotContentsActions.h"
+#import "OFXFileSnapshotRemoteEncoding.h"
+
+RCS_ID("$Id$")
+
+// FastCDC's normalized chunking: a harder test (more mask bits) before the average size and an easier one after it, which pulls chunk sizes in towards the average. The hash shifts left a bit per byte, so the high bits depend on the last 64 bytes and that's where the masks look.
+static const uint64_t SmallChunkMask = ((1ULL << 22) - 1) << 42;
+static const uint64_t LargeChunkMask = ((1ULL << 18) - 1) << 46;
+
+static uint64_t Gear[256];
+
+static void _initializeGear(void)
+{
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        // splitmix64 from a fixed seed, so every client picks the same boundaries.
+        uint64_t state = 0x4f6d6e6953796e63ULL;
+        for (NSUInteger entryIndex = 0; entryIndex < 256; entryIndex++) {
+            uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+            Gear[entryIndex] = z ^ (z >> 31);
+        }
+    });
+}
+
+static size_t _nextChunkLength(const uint8_t *bytes, size_t length)
+{
+    if (length <= kOFXChunk_MinimumSize)
+        return length;
+
+    size_t normalLength = MIN(length, (size_t)kOFXChunk_AverageSize);
+    size_t maximumLength = MIN(length, (size_t)kOFXChunk_MaximumSize);
+
+    // No boundary can fall inside the minimum size, so don't bother hashing it.
+    uint64_t hash = 0;
+    size_t offset = kOFXChunk_MinimumSize;
+    for (; offset < normalLength; offset++) {
+        hash = (hash << 1) + Gear[bytes[offset]];
+        if ((hash & SmallChunkMask) == 0)
+            return offset + 1;
+    }
+    for (; offset < maximumLength; offset++) {
+        hash = (hash << 1) + Gear[bytes[offset]];
+        if ((hash & LargeChunkMask) == 0)
+            return offset + 1;
+    }
+    return maximumLength;
+}
+
+void OFXEnumerateChunkRanges(NSData *data, void (^applier)(NSRange chunkRange))
+{
+    _initializeGear();
+
+    const uint8_t *bytes = data.bytes;
+    size_t length = data.length;
+    size_t offset = 0;
+
+    while (offset < length) {
+        size_t chunkLength = _nextChunkLength(bytes + offset, length - offset);
+        applier(NSMakeRange(offset, chunkLength));
+        offset += chunkLength;
+    }
+}
+
+NSArray <NSDictionary *> *OFXChunkListForData(NSData *data)
+{
+    if (data.length <= kOFXChunk_MaximumSize)
+        return nil; // Would be a single chunk anyway
+
+    NSMutableArray <NSDictionary *> *chunks = [NSMutableArray array];
+    OFXEnumerateChunkRanges(data, ^(NSRange chunkRange){
+        @autoreleasepool {
+            NSData *chunkData = [data subdataWithRange:chunkRange];
+            [chunks addObject:@{kOFXContents_FileHashKey:OFXHashFileNameForData(chunkData), kOFXContents_FileSizeKey:@(chunkRange.length)}];
+        }
+    });
+    return chunks;
+}
+
+NSDictionary <NSString *, NSArray *> *OFXRecordChunks(NSDictionary *contents, NSURL *localContentsURL, NSError **outError)
+{
+    NSMutableDictionary <NSString *, NSArray *> *fileHashToChunks = [NSMutableDictionary dictionary];
+
+    OFXFileSnapshotContentsActions *chunkActions = [OFXFileSnapshotContentsActions new];
+    chunkActions[kOFXContents_FileTypeRegular] = ^BOOL(NSURL *actionURL, NSDictionary *fileContents, NSError **actionError){
+        if ([fileContents[kOFXContents_FileSizeKey] unsignedLongLongValue] <= kOFXChunk_MaximumSize)
+            return YES;
+
+        NSString *hash = fileContents[kOFXContents_FileHashKey];
+        if (fileHashToChunks[hash])
+            return YES; // Same contents as another file in the document
+
+        NSData *fileData = [[NSData alloc] initWithContentsOfURL:actionURL options:NSDataReadingMappedAlways|NSDataReadingUncached error:actionError];
+        if (!fileData)
+            return NO;
+
+        NSArray <NSDictionary *> *chunks = OFXChunkListForData(fileData);
+        if (chunks)
+            fileHashToChunks[hash] = chunks;
+        return YES;
+    };
+
+    if (![chunkActions applyToContents:contents localContentsURL:localContentsURL error:outError]) {
+        OBChainError(outError);
+        return nil;
+    }
+
+    return fileHashToChunks;
+}
+
+static void _addStoredObjectNames(NSMutableSet <NSString *> *names, NSDictionary *contents, NSDictionary *fileHashToChunks)
+{
+    NSString *fileType = contents[kOFXContents_FileTypeKey];
+
+    if ([fileType isEqualToString:kOFXContents_FileTypeRegular]) {
+        NSString *hash = contents[kOFXContents_FileHashKey];
+        NSArray <NSDictionary *> *chunks = fileHashToChunks[hash];
+        if (chunks) {
+            for (NSDictionary *chunk in chunks)
+                [names addObject:chunk[kOFXContents_FileHashKey]];
+        } else
+            [names addObject:hash];
+    } else if ([fileType isEqualToString:kOFXContents_FileTypeDirectory]) {
+        NSDictionary *children = contents[kOFXContents_DirectoryChildrenKey];
+        [children enumerateKeysAndObjectsUsingBlock:^(NSString *name, NSDictionary *childContents, BOOL *stop) {
+            _addStoredObjectNames(names, childContents, fileHashToChunks);
+        }];
+    }
+}
+
+NSSet <NSString *> *OFXStoredObjectNames(NSDictionary *infoDictionary)
+{
+    NSMutableSet <NSString *> *names = [NSMutableSet set];
+    _addStoredObjectNames(names, infoDictionary[kOFXInfo_ContentsKey], infoDictionary[kOFXInfo_ChunksKey]);
+    return names;
+}
+
+@interface OFXLocalChunkLocation : NSObject
+@property(nonatomic,strong) NSURL *fileURL;
+@property(nonatomic) NSRange range;
+@end
+
+@implementation OFXLocalChunkLocation
+@end
+
+@implementation OFXLocalChunkStore
+{
+    NSDictionary *_infoDictionary;
+    NSURL *_documentURL;
+
+    NSMutableDictionary <NSString *, OFXLocalChunkLocation *> *_nameToLocation; // Built on first use
+
+    NSURL *_mappedFileURL;
+    NSData *_mappedFileData;
+}
+
+- init;
+{
+    OBRejectUnusedImplementation(self, _cmd);
+}
+
+- initWithInfoDictionary:(NSDictionary *)infoDictionary documentURL:(NSURL *)documentURL;
+{
+    OBPRECONDITION(infoDictionary);
+    OBPRECONDITION(documentURL);
+
+    if (!(self = [super init]))
+        return nil;
+
+    _infoDictionary = [infoDictionary copy];
+    _documentURL = [documentURL copy];
+
+    return self;
+}
+
+- (NSData *)dataForObjectNamed:(NSString *)name;
+{
+    if (!_nameToLocation)
+        [self _buildIndex];
+
+    OFXLocalChunkLocation *location = _nameToLocation[name];
+    if (!location)
+        return nil;
+
+    if (![_mappedFileURL isEqual:location.fileURL]) {
+        _mappedFileURL = location.fileURL;
+        _mappedFileData = [[NSData alloc] initWithContentsOfURL:_mappedFileURL options:NSDataReadingMappedIfSafe|NSDataReadingUncached error:NULL];
+    }
+    if (!_mappedFileData || NSMaxRange(location.range) > _mappedFileData.length)
+        return nil; // Moved, deleted, or truncated since the snapshot was made
+
+    NSData *data = [_mappedFileData subdataWithRange:location.range];
+    if (![OFXHashFileNameForData(data) isEqualToString:name])
+        return nil; // Edited since the snapshot was made
+    return data;
+}
+
+#pragma mark - Private
+
+- (void)_buildIndex;
+{
+    _nameToLocation = [NSMutableDictionary dictionary];
+
+    NSDictionary *fileHashToChunks = _infoDictionary[kOFXInfo_ChunksKey];
+
+    OFXFileSnapshotContentsActions *indexActions = [OFXFileSnapshotContentsActions new];
+    indexActions[kOFXContents_FileTypeRegular] = ^BOOL(NSURL *actionURL, NSDictionary *contents, NSError **actionError){
+        NSString *hash = contents[kOFXContents_FileHashKey];
+        NSArray <NSDictionary *> *chunks = fileHashToChunks[hash];
+        if (!chunks) {
+            chunks = @[@{kOFXContents_FileHashKey:hash, kOFXContents_FileSizeKey:contents[kOFXContents_FileSizeKey]}];
+        }
+
+        NSUInteger offset = 0;
+        for (NSDictionary *chunk in chunks) {
+            NSUInteger length = [chunk[kOFXContents_FileSizeKey] unsignedIntegerValue];
+            NSString *name = chunk[kOFXContents_FileHashKey];
+            if (!_nameToLocation[name]) {
+                OFXLocalChunkLocation *location = [OFXLocalChunkLocation new];
+                location.fileURL = actionURL;
+                location.range = NSMakeRange(offset, length);
+                _nameToLocation[name] = location;
+            }
+            offset += length;
+        }
+        return YES;
+    };
+
+    // Only regular files have stored objects, and there is nothing to create, so this can't fail.
+    __autoreleasing NSError *error;
+    if (![indexActions applyToContents:_infoDictionary[kOFXInfo_ContentsKey] localContentsURL:_documentURL error:&error])
+        [error log:@"Error indexing local chunks in %@", _documentURL];
+}
+
+@end
@@ -57,6 +57,10 @@ typedef NS_ENUM(NSUInteger, OFXFileItemMoveSource) {
 
 - (void)setContentsRequested; // Turns on a sticky flag for this run of the app that says downloads should get the contents too.
 @property(nonatomic,readonly) BOOL contentsRequested;
+- (void)setContentsRequestedByUser; // Like -setContentsRequested, but also marks the download as something the user is waiting on, so it gets scheduled ahead of automatic transfers.
+@property(nonatomic,readonly) BOOL contentsRequestedByUser;
+
+@property(nonatomic,readonly) unsigned long long totalSize; // Of the current snapshot
 
 @property(nonatomic,readonly) OFXFileState *localState;
 @property(nonatomic,readonly) OFXFileState *remoteState;
@@ -533,6 +533,18 @@ static NSURL *_makeRemoteSnapshotURL(OFXContainerAgent *containerAgent, ODAVConn
     _contentsRequested = YES;
 }
 
+- (void)setContentsRequestedByUser;
+{
+    _contentsRequested = YES;
+    _contentsRequestedByUser = YES;
+}
+
+- (unsigned long long)totalSize;
+{
+    OBPRECONDITION(_snapshot);
+    return _snapshot.totalSize;
+}
+
 - (OFXFileState *)localState;
 {
     OBPRECONDITION(_snapshot);
@@ -649,9 +661,7 @@ static NSURL *_makeRemoteSnapshotURL(OFXContainerAgent *containerAgent, ODAVConn
     OBASSERT([_snapshot.localSnapshotURL isEqual:_makeLocalSnapshotURL(containerAgent, _identifier)]);
 
     OFXFileState *localState = _snapshot.localState;
-#ifdef OMNI_ASSERTIONS_ON
     OFXFileState *remoteState = _snapshot.remoteState;
-#endif
     OBASSERT(remoteState.missing || localState.edited || localState.userMoved, @"Why are we uploading, otherwise?");
 
     NSURL *currentRemoteSnapshotURL = _makeRemoteSnapshotURL(containerAgent, connection, self, _snapshot);
@@ -662,8 +672,11 @@ static NSURL *_makeRemoteSnapshotURL(OFXContainerAgent *containerAgent, ODAVConn
     if (localState.missing && localState.userMoved)
         // Doing a rename of a file that hasn't been downloaded. In this case, we don't have a local copy of the document to use as the basis for an upload (and there is no chance of its contents having been changed).
         uploadTransfer = [[OFXFileSnapshotUploadRenameTransfer alloc] initWithConnection:connection currentSnapshot:_snapshot remoteTemporaryDirectory:containerAgent.remoteTemporaryDirectory currentRemoteSnapshotURL:currentRemoteSnapshotURL error:outPrepareUploadError];
-    else
-        uploadTransfer = [[OFXFileSnapshotUploadContentsTransfer alloc] initWithConnection:connection currentSnapshot:_snapshot forUploadingVersionOfDocumentAtURL:_localDocumentURL localRelativePath:_localRelativePath remoteTemporaryDirectory:containerAgent.remoteTemporaryDirectory error:outPrepareUploadError];
+    else {
+        // Anything the version we are replacing already stored on the server can be copied from it rather than uploaded again.
+        NSURL *previousRemoteSnapshotURL = remoteState.missing ? nil : currentRemoteSnapshotURL;
+        uploadTransfer = [[OFXFileSnapshotUploadContentsTransfer alloc] initWithConnection:connection currentSnapshot:_snapshot forUploadingVersionOfDocumentAtURL:_localDocumentURL localRelativePath:_localRelativePath previousRemoteSnapshotURL:previousRemoteSnapshotURL chunked:containerAgent.clientParameters.chunkedStorage remoteTemporaryDirectory:containerAgent.remoteTemporaryDirectory error:outPrepareUploadError];
+    }
     if (!uploadTransfer)
         return nil;
     uploadTransfer.debugName = self.debugName;
@@ -924,7 +937,7 @@ static NSURL *_makeRemoteSnapshotURL(OFXContainerAgent *containerAgent, ODAVConn
 
     DEBUG_CONTENT(2, @"Starting download with local content \"%@\"", OFXLookupDisplayNameForContentIdentifier(_snapshot.currentContentIdentifier));
     
-    OFXFileSnapshotDownloadTransfer *downloadTransfer = [[OFXFileSnapshotDownloadTransfer alloc] initWithConnection:connection remoteSnapshotURL:targetRemoteSnapshotURL localTemporaryDocumentContentsURL:localTemporaryDocumentContentsURL currentSnapshot:_snapshot];
+    OFXFileSnapshotDownloadTransfer *downloadTransfer = [[OFXFileSnapshotDownloadTransfer alloc] initWithConnection:connection remoteSnapshotURL:targetRemoteSnapshotURL localTemporaryDocumentContentsURL:localTemporaryDocumentContentsURL currentSnapshot:_snapshot localDocumentURL:(_snapshot.localState.missing ? nil : _localDocumentURL) partialDownloadURL:[container.localPartialDownloadsDirectory URLByAppendingPathComponent:_identifier isDirectory:YES]];
     downloadTransfer.debugName = self.debugName;
 
     __weak OFXFileSnapshotDownloadTransfer *weakTransfer = downloadTransfer;
@@ -13,7 +13,6 @@
 
 - (void)addRequestedFileItem:(OFXFileItem *)fileItem;
 - (void)removeRequestedFileItem:(OFXFileItem *)fileItem;
-- (OFXFileItem *)anyRequest;
 @property(nonatomic,readonly) NSUInteger numberRequested;
 
 - (void)startedFileItem:(OFXFileItem *)fileItem;
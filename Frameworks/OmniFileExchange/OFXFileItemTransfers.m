@@ -38,11 +38,6 @@ RCS_ID("$Id$")
     [_requested removeObject:fileItem];
 }
 
-- (OFXFileItem *)anyRequest;
-{
-    return [_requested anyObject];
-}
-
 - (NSUInteger)numberRequested;
 {
     return [_requested count];
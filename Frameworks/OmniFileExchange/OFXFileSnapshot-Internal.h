@@ -33,12 +33,16 @@ extern BOOL OFXFileItemRecordContents(OFXContentsType type, NSMutableDictionary
 // Info.plist keys and constants
 //
 #define kOFXInfo_ArchiveVersion (0)
+#define kOFXInfo_ChunkedArchiveVersion (1) // Written instead when kOFXInfo_ChunksKey is present, so that clients which don't know about chunks reject the snapshot as an unknown version rather than failing partway through downloading it
 #define kOFXInfo_ArchiveVersionKey @"Version"
 
 // The desired relative path of the user-visible document. It may get published to a different relative path if there is a conflict.
 #define kOFXInfo_PathKey @"Path"
 
 #define kOFXInfo_ContentsKey @"Contents"
+
+// Optional; present only in chunked snapshots (see OFXContentChunking.h), which have kOFXInfo_ChunkedArchiveVersion. Maps the hash of each large file to its chunk list. Older clients can't read these snapshots, so it is only written when OFXAccountClientParameters.chunkedStorage is on.
+#define kOFXInfo_ChunksKey @"Chunks"
 //#define kOFXInfo_ContentsIsDirectoryKey @"ContentsIsDirectory"
 
 // Optional info about the author (not written by earlier versions), used in building conflict names if present.
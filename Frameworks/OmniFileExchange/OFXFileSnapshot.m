@@ -121,8 +121,8 @@ static BOOL OFXValidateInfoDictionary(NSDictionary *infoDictionary, NSError **ou
         return NO;
     }
     
-    if (![infoDictionary[kOFXInfo_ArchiveVersionKey] isEqual:@(kOFXInfo_ArchiveVersion)]) {
-        // TODO: If we ever add a second storage format, we'll need to handle loading the old version.
+    id archiveVersion = infoDictionary[kOFXInfo_ArchiveVersionKey];
+    if (![archiveVersion isEqual:@(kOFXInfo_ArchiveVersion)] && ![archiveVersion isEqual:@(kOFXInfo_ChunkedArchiveVersion)]) {
         OFXError(outError, OFXSnapshotInfoCorrupt, ([NSString stringWithFormat:@"Info property list has unrecognized version number %@", infoDictionary[kOFXInfo_ArchiveVersionKey]]), nil);
         return NO;
     }
@@ -132,6 +132,16 @@ static BOOL OFXValidateInfoDictionary(NSDictionary *infoDictionary, NSError **ou
         return NO;
     }
 
+    id chunks = infoDictionary[kOFXInfo_ChunksKey];
+    if (chunks && ![archiveVersion isEqual:@(kOFXInfo_ChunkedArchiveVersion)]) {
+        OFXError(outError, OFXSnapshotInfoCorrupt, ([NSString stringWithFormat:@"Info property list has chunk lists but version number %@", archiveVersion]), nil);
+        return NO;
+    }
+    if (chunks && ![chunks isKindOfClass:[NSDictionary class]]) {
+        OFXError(outError, OFXSnapshotInfoCorrupt, ([NSString stringWithFormat:@"Info property list has bad chunk lists: %@", chunks]), nil);
+        return NO;
+    }
+
     return YES;
 }
 
@@ -11,7 +11,7 @@
 
 @interface OFXFileSnapshotDownloadTransfer : OFXFileSnapshotTransfer
 
-- initWithConnection:(ODAVConnection *)connection remoteSnapshotURL:(NSURL *)remoteSnapshotURL localTemporaryDocumentContentsURL:(NSURL *)localTemporaryDocumentContentsURL currentSnapshot:(OFXFileSnapshot *)currentSnapshot;
+- initWithConnection:(ODAVConnection *)connection remoteSnapshotURL:(NSURL *)remoteSnapshotURL localTemporaryDocumentContentsURL:(NSURL *)localTemporaryDocumentContentsURL currentSnapshot:(OFXFileSnapshot *)currentSnapshot localDocumentURL:(NSURL *)localDocumentURL partialDownloadURL:(NSURL *)partialDownloadURL; // localDocumentURL is the downloaded document for currentSnapshot, if any, which can supply unchanged chunks. partialDownloadURL is where contents are collected, and where an earlier failed download left off.
 
 @property(nonatomic,readonly) OFXFileSnapshot *downloadedSnapshot;
 @property(nonatomic,readonly) NSURL *localTemporaryDocumentContentsURL;
@@ -8,26 +8,71 @@
 #import "OFXFileSnapshotDownloadTransfer.h"
 
 #import <OmniDAV/ODAVConnection.h>
+#import <OmniDAV/ODAVErrors.h>
 #import <OmniDAV/ODAVFileInfo.h>
 #import <OmniDAV/ODAVOperation.h>
 #import <OmniFoundation/NSFileManager-OFTemporaryPath.h>
+#import <OmniFoundation/OFPreference.h>
 
+#import "OFXContentChunking.h"
 #import "OFXDownloadFileSnapshot.h"
+#import "OFXFileSnapshot-Internal.h"
 #import "OFXFileState.h"
 #import "OFXFileSnapshotRemoteEncoding.h"
+#import "OFXPartialDownload.h"
+#import "OFXTrace.h"
 
 RCS_ID("$Id$")
 
+static OFDeclareIntegerConfigurationValue(OFXDownloadMaximumConcurrentReads, 4, 1, 16); // Keeps several requests in flight so one slow response doesn't stall the whole download.
+static OFDeclareIntegerConfigurationValue(OFXDownloadRangeSize, 4*1024*1024, 64*1024, 64*1024*1024); // Large objects are fetched in ranges of this size.
+static OFDeclareIntegerConfigurationValue(OFXDownloadMaximumReadRetries, 3, 0, 100); // How many times a dropped connection can be picked up again before the transfer fails (and gets retried from the partial download).
+
+/*
+ Downloads the contents of a snapshot into a partial download (see OFXPartialDownload.h) and then, once every file is done, moves them all into the temporary document. Large stored objects are fetched as several byte ranges in parallel, and each piece is written into place as it arrives. If the transfer fails or is cancelled, the next one for the file item only fetches what is still missing.
+ */
+
+// One stored object (a whole file, or one chunk of a file in a chunked snapshot), and where it goes in its file.
+@interface OFXDownloadObject : NSObject
+@property(nonatomic,copy) NSString *name;
+@property(nonatomic,copy) NSString *fileHash;
+@property(nonatomic) NSRange rangeInFile;
+@property(nonatomic) NSUInteger remainingReadCount;
+@end
+
+@implementation OFXDownloadObject
+@end
+
+// A GET of all or part of a stored object.
+@interface OFXDownloadRead : NSObject
+@property(nonatomic,strong) OFXDownloadObject *object;
+@property(nonatomic) NSRange rangeInObject;
+@property(nonatomic) NSUInteger receivedLength;
+@property(nonatomic,strong) ODAVOperation *operation;
+@property(nonatomic) BOOL checkedResponse;
+@end
+
+@implementation OFXDownloadRead
+@end
+
 @implementation OFXFileSnapshotDownloadTransfer
 {
     NSURL *_remoteSnapshotURL;
     NSURL *_localTemporaryDocumentContentsURL;
+    NSURL *_partialDownloadURL;
     OFXFileSnapshot *_currentSnapshot;
+    OFXLocalChunkStore *_localChunkStore;
     
     OFXDownloadFileSnapshot *_downloadingSnapshot;
-    NSMutableDictionary <ODAVOperation *, NSURL *> *_readOperationToLocalFileURL;
-    ODAVOperation *_runningOperation;
-    NSMutableData *_resultData; // Would need a separate map for op->results if we run more than one at a time.
+    OFXPartialDownload *_partialDownload;
+    NSMutableDictionary <NSString *, NSMutableArray <NSURL *> *> *_fileHashToFileURLs;
+    NSMutableDictionary <NSString *, NSNumber *> *_fileHashToSize;
+    NSMutableDictionary <NSString *, NSNumber *> *_fileHashToRemainingObjectCount;
+    
+    NSMutableArray <OFXDownloadRead *> *_pendingReads;
+    NSMutableArray <OFXDownloadRead *> *_runningReads;
+    NSUInteger _readRetryCount;
+    BOOL _serverIgnoresRanges;
     
     BOOL _cancelled;
     BOOL _hasCreatedLocalTemporaryDocumentContentsURL;
@@ -36,10 +81,11 @@ RCS_ID("$Id$")
     long long _totalBytesRead;
 }
 
-- initWithConnection:(ODAVConnection *)connection remoteSnapshotURL:(NSURL *)remoteSnapshotURL localTemporaryDocumentContentsURL:(NSURL *)localTemporaryDocumentContentsURL currentSnapshot:(OFXFileSnapshot *)currentSnapshot;
+- initWithConnection:(ODAVConnection *)connection remoteSnapshotURL:(NSURL *)remoteSnapshotURL localTemporaryDocumentContentsURL:(NSURL *)localTemporaryDocumentContentsURL currentSnapshot:(OFXFileSnapshot *)currentSnapshot localDocumentURL:(NSURL *)localDocumentURL partialDownloadURL:(NSURL *)partialDownloadURL;
 {
     OBPRECONDITION(currentSnapshot, "should at least be a metadata stub");
     OBPRECONDITION(remoteSnapshotURL);
+    OBPRECONDITION(!localTemporaryDocumentContentsURL || partialDownloadURL, "Need somewhere to put the contents as they come in");
     
     if (!(self = [super initWithConnection:connection]))
         return nil;
@@ -47,7 +93,16 @@ RCS_ID("$Id$")
     _currentSnapshot = currentSnapshot;
     _localTemporaryDocumentContentsURL = [localTemporaryDocumentContentsURL copy];
     _remoteSnapshotURL = [remoteSnapshotURL copy];
-    _readOperationToLocalFileURL = [NSMutableDictionary new];
+    _partialDownloadURL = [partialDownloadURL copy];
+    _fileHashToFileURLs = [NSMutableDictionary new];
+    _fileHashToSize = [NSMutableDictionary new];
+    _fileHashToRemainingObjectCount = [NSMutableDictionary new];
+    _pendingReads = [NSMutableArray new];
+    _runningReads = [NSMutableArray new];
+    
+    // Reading the published document without coordination is OK since everything we take from it is checked against its hash; if the user is editing it, we'll just fetch more.
+    if (localDocumentURL && localTemporaryDocumentContentsURL)
+        _localChunkStore = [[OFXLocalChunkStore alloc] initWithInfoDictionary:currentSnapshot.infoDictionary documentURL:localDocumentURL];
 
     return self;
 }
@@ -97,37 +152,18 @@ RCS_ID("$Id$")
 
         _hasCreatedLocalTemporaryDocumentContentsURL = NO;
         if (![_downloadingSnapshot makeDownloadStructureAt:_localTemporaryDocumentContentsURL didCreateDirectoryOrLink:&_hasCreatedLocalTemporaryDocumentContentsURL error:&error withFileApplier:^(NSURL *fileURL, long long fileSize, NSString *hash){
-            // TODO: Avoid redownloading data we've already downloaded. This is not terribly likely, but we could have a document with the same image attached multiple times.
-
-            NSURL *remoteFileURL = [_remoteSnapshotURL URLByAppendingPathComponent:hash];
-            
-            DEBUG_TRANSFER(2, @"  Reading %@ -> %@", remoteFileURL, fileURL);
-            
-            // No need to use an ETag here since the data is SHA-1 indexed.
-            ODAVOperation *readOperation = [connection asynchronousGetContentsOfURL:remoteFileURL];
-            
-            __weak OFXFileSnapshotDownloadTransfer *weakSelf = self;
-            readOperation.didFinish = ^(ODAVOperation *op, NSError *errorOrNil){
-                OFXFileSnapshotDownloadTransfer *strongSelf = weakSelf;
-                if (!strongSelf)
-                    return; // Operation cancelled.
-                [strongSelf.operationQueue addOperationWithBlock:^{
-                    [strongSelf _readOperation:op finishedWithError:errorOrNil];
-                }];
-            };
-            
-            readOperation.didReceiveData = ^(ODAVOperation *op, NSData *data){
-                OFXFileSnapshotDownloadTransfer *strongSelf = weakSelf;
-                if (!strongSelf)
-                    return; // Operation cancelled.
-                [strongSelf.operationQueue addOperationWithBlock:^{
-                    [strongSelf _readOperation:op didReceiveData:data];
-                }];
-            };
-            _readOperationToLocalFileURL[readOperation] = fileURL;
+            DEBUG_TRANSFER(2, @"  Reading %@ -> %@", [_remoteSnapshotURL URLByAppendingPathComponent:hash], fileURL);
             
+            // A document with the same image attached multiple times only needs it downloaded once.
+            NSMutableArray <NSURL *> *fileURLs = _fileHashToFileURLs[hash];
+            if (fileURLs) {
+                [fileURLs addObject:fileURL];
+                return;
+            }
+            _fileHashToFileURLs[hash] = [NSMutableArray arrayWithObject:fileURL];
+            _fileHashToSize[hash] = @(fileSize);
             _totalBytesToRead += fileSize;
-        }]) {
+        }] || ![self _queueReads:&error]) {
             // It might have been partially created... clean up after ourselves if something was created already
             if (_hasCreatedLocalTemporaryDocumentContentsURL) {
                 [[NSFileManager defaultManager] removeItemAtURL:_localTemporaryDocumentContentsURL error:NULL];
@@ -141,11 +177,15 @@ RCS_ID("$Id$")
         }
     }
 
-    [self _startReadOperation];
+    [self _startReads];
 }
 
 - (void)finished:(NSError *)errorOrNil;
 {
+    // Leave the partial download for the next attempt.
+    [self _stopReads];
+    [_partialDownload close];
+    
     if (errorOrNil)
         [self _cleanupDownloadingSnapshot];
 
@@ -158,8 +198,9 @@ RCS_ID("$Id$")
     
     // We *might* get more delegate messages, or we might not. In particular we might get -fileManager:operationDidFinish:withError:, which could call -finished:...
     _cancelled = YES;
+    [self _stopReads];
+    [_partialDownload close];
     [self _cleanupDownloadingSnapshot];
-    [_runningOperation cancel];
 }
 
 - (void)invalidate;
@@ -189,80 +230,439 @@ RCS_ID("$Id$")
     }
 }
 
-- (void)_readOperation:(ODAVOperation *)operation didReceiveData:(NSData *)data;
+- (BOOL)_queueReads:(NSError **)outError;
 {
-    OBPRECONDITION([NSOperationQueue currentQueue] == self.operationQueue);
-    OBPRECONDITION(operation == _runningOperation);
-    OBPRECONDITION([_readOperationToLocalFileURL objectForKey:operation] != nil);
-    OBPRECONDITION(_resultData);
+    OBPRECONDITION(_partialDownloadURL);
     
-    [_resultData appendData:data];
-    _totalBytesRead += [data length];
+    _partialDownload = [[OFXPartialDownload alloc] initWithDirectoryURL:_partialDownloadURL];
     
-    double percentComplete = (double)_totalBytesRead/(double)_totalBytesToRead;
-    OBASSERT(percentComplete > 0); // we just wrote some...
-    OBASSERT(percentComplete <= 1.0);
+    NSDictionary <NSString *, NSArray *> *fileHashToChunks = _downloadingSnapshot.infoDictionary[kOFXInfo_ChunksKey];
     
-    [self updatePercentCompleted:CLAMP(percentComplete, 0.0, 1.0)];
+    for (NSString *fileHash in _fileHashToFileURLs) {
+        unsigned long long fileSize = [_fileHashToSize[fileHash] unsignedLongLongValue];
+        if (![_partialDownload prepareFileWithHash:fileHash size:fileSize error:outError])
+            return NO;
+        
+        NSArray <NSDictionary *> *chunks = fileHashToChunks[fileHash];
+        if (!chunks)
+            chunks = @[@{kOFXContents_FileHashKey:fileHash, kOFXContents_FileSizeKey:@(fileSize)}];
+        _fileHashToRemainingObjectCount[fileHash] = @([chunks count]);
+        
+        NSUInteger offset = 0;
+        for (NSDictionary *chunk in chunks) {
+            OFXDownloadObject *object = [OFXDownloadObject new];
+            object.name = chunk[kOFXContents_FileHashKey];
+            object.fileHash = fileHash;
+            object.rangeInFile = NSMakeRange(offset, [chunk[kOFXContents_FileSizeKey] unsignedIntegerValue]);
+            offset += object.rangeInFile.length;
+            
+            if (![self _queueReadsForObject:object error:outError])
+                return NO;
+        }
+        OBASSERT(offset == fileSize);
+    }
+    
+    return YES;
 }
 
-- (void)_readOperation:(ODAVOperation *)operation finishedWithError:(NSError *)errorOrNil;
+- (BOOL)_queueReadsForObject:(OFXDownloadObject *)object error:(NSError **)outError;
 {
-    OBPRECONDITION([NSOperationQueue currentQueue] == self.operationQueue);
-    OBPRECONDITION(operation == _runningOperation);
-    OBPRECONDITION([_readOperationToLocalFileURL objectForKey:operation] != nil);
+    NSRange rangeInFile = object.rangeInFile;
+    NSArray <NSValue *> *missingRanges = [_partialDownload missingRangesOfFileWithHash:object.fileHash inRange:rangeInFile];
     
-    if (errorOrNil) {
-        [self finished:errorOrNil];
-        return;
+    if ([missingRanges count] == 0) {
+        // An earlier attempt got all of this, or it is empty.
+        if ([self _verifyObject:object]) {
+            DEBUG_TRANSFER(2, @"  Found %@ in partial download", object.name);
+            [self _readByteCount:rangeInFile.length];
+            return [self _completedObject:object error:outError];
+        }
+        missingRanges = @[[NSValue valueWithRange:rangeInFile]];
+    }
+    
+    // Use our local copy, if it has this object.
+    NSData *localData = [_localChunkStore dataForObjectNamed:object.name];
+    if (localData) {
+        DEBUG_TRANSFER(2, @"  Found %@ locally", object.name);
+        if (![_partialDownload writeData:localData toFileWithHash:object.fileHash atOffset:rangeInFile.location error:outError])
+            return NO;
+        [_partialDownload addCompletedRange:rangeInFile toFileWithHash:object.fileHash];
+        [self _readByteCount:rangeInFile.length];
+        return [self _completedObject:object error:outError];
+    }
+    
+    NSUInteger missingLength = 0;
+    for (NSValue *rangeValue in missingRanges)
+        missingLength += [rangeValue rangeValue].length;
+    if (missingLength < rangeInFile.length) {
+        DEBUG_TRANSFER(2, @"  Resuming %@ with %lu of %lu bytes", object.name, rangeInFile.length - missingLength, rangeInFile.length);
+        [self _readByteCount:rangeInFile.length - missingLength];
+    }
+    
+    if (_serverIgnoresRanges) {
+        [_partialDownload removeCompletedRange:rangeInFile fromFileWithHash:object.fileHash];
+        missingRanges = @[[NSValue valueWithRange:rangeInFile]];
     }
-    if (_cancelled)
-        return;
     
-    NSURL *fileURL = _readOperationToLocalFileURL[operation];
+    NSUInteger rangeSize = OFXDownloadRangeSize;
+    for (NSValue *rangeValue in missingRanges) {
+        NSRange missingRange = [rangeValue rangeValue];
+        NSUInteger location = missingRange.location - rangeInFile.location;
+        NSUInteger end = location + missingRange.length;
+        
+        while (location < end) {
+            OFXDownloadRead *read = [OFXDownloadRead new];
+            read.object = object;
+            read.rangeInObject = _serverIgnoresRanges ? NSMakeRange(0, rangeInFile.length) : NSMakeRange(location, MIN(rangeSize, end - location));
+            object.remainingReadCount++;
+            [_pendingReads addObject:read];
+            
+            location = NSMaxRange(read.rangeInObject);
+        }
+    }
+    
+    return YES;
+}
+
+- (void)_startReads;
+{
+    OBPRECONDITION([NSOperationQueue currentQueue] == self.operationQueue);
     
-    // One downside to always using Info.plist is that we lose this check for the main plist. Random bit corruption on disk would have a relatively low chance of clobbering XML structure. If we gzip the plist, this'll be more likely to be noticed.
-    // Validate the hash.
-    // TODO: Queue this so that the hash validation can run concurrently with the next file download.
-    NSString *expectedHash = OFXHashFileNameForData(_resultData);
-    if (![expectedHash isEqualToString:[operation.url lastPathComponent]]) {
-        __autoreleasing NSError *corruptionError = nil;
-        OFXError(&corruptionError, OFXSnapshotCorrupt, @"Possible document corruption", ([NSString stringWithFormat:@"Expected hash (%@) does not match the last path component of \"%@\"", expectedHash, operation.url]));
-        [self finished:corruptionError];
+    if (_cancelled)
         return;
+    
+    NSUInteger maximumReadCount = OFXDownloadMaximumConcurrentReads;
+    while ([_runningReads count] < maximumReadCount && [_pendingReads count] > 0) {
+        OFXDownloadRead *read = [_pendingReads firstObject];
+        [_pendingReads removeObjectAtIndex:0];
+        
+        OFXDownloadObject *object = read.object;
+        BOOL wholeObject = (read.rangeInObject.location == 0 && read.rangeInObject.length == object.rangeInFile.length);
+        
+        if (_serverIgnoresRanges && !wholeObject) {
+            // Replaces the rest of this object's reads with one for all of it.
+            [self _restartObject:object];
+            continue;
+        }
+        
+        NSString *range = nil;
+        if (!wholeObject)
+            range = [NSString stringWithFormat:@"bytes=%lu-%lu", read.rangeInObject.location, NSMaxRange(read.rangeInObject) - 1];
+        
+        // The objects are named by their hash, so their contents don't change. But if the server's copy has been replaced (say, restored from a backup), we shouldn't trust that the bytes we already have line up with the ones it is sending.
+        NSString *ETag = [_partialDownload ETagForObjectNamed:object.name];
+        
+        NSURL *remoteURL = [_remoteSnapshotURL URLByAppendingPathComponent:object.name];
+        ODAVOperation *operation = [self.connection asynchronousGetContentsOfURL:remoteURL withETag:ETag range:range];
+        read.operation = operation;
+        [_runningReads addObject:read];
+        
+        __weak OFXFileSnapshotDownloadTransfer *weakSelf = self;
+        operation.didFinish = ^(ODAVOperation *op, NSError *errorOrNil){
+            OFXFileSnapshotDownloadTransfer *strongSelf = weakSelf;
+            if (!strongSelf)
+                return; // Operation cancelled.
+            [strongSelf.operationQueue addOperationWithBlock:^{
+                [strongSelf _read:read finishedWithError:errorOrNil];
+            }];
+        };
+        
+        operation.didReceiveData = ^(ODAVOperation *op, NSData *data){
+            OFXFileSnapshotDownloadTransfer *strongSelf = weakSelf;
+            if (!strongSelf)
+                return; // Operation cancelled.
+            [strongSelf.operationQueue addOperationWithBlock:^{
+                [strongSelf _read:read didReceiveData:data];
+            }];
+        };
+        
+        [operation startWithCallbackQueue:self.transferOperationQueue];
     }
     
-    // We expect to be writing to a temporary location, so no 'atomic' flag needed.
-    __autoreleasing NSError *writeError;
-    if (![_resultData writeToURL:fileURL options:0 error:&writeError])
-        OFXFileSnapshotTransferReturnWithError(writeError);
+    if ([_runningReads count] == 0 && [_pendingReads count] == 0)
+        [self _finishedReading];
+}
+
+- (void)_stopReads;
+{
+    NSArray <OFXDownloadRead *> *runningReads = [_runningReads copy];
+    [_runningReads removeAllObjects];
+    [_pendingReads removeAllObjects];
+    
+    for (OFXDownloadRead *read in runningReads)
+        [read.operation cancel];
+}
 
-    // This might be the root of our download (for a flat file) or somewhere down in a directory (in which case this flag will have been set already).
-    _hasCreatedLocalTemporaryDocumentContentsURL = YES;
+- (void)_failWithError:(NSError *)error;
+{
+    [self _stopReads];
+    
+    __autoreleasing NSError *saveError;
+    if (![_partialDownload saveState:&saveError])
+        [saveError log:@"Error saving partial download state in %@", _partialDownloadURL];
+    
+    [self finished:error];
+}
 
-    [_readOperationToLocalFileURL removeObjectForKey:operation];
-    _runningOperation = nil;
-    _resultData = nil;
-    [self _startReadOperation];
+// Throws away what we have of the object and fetches it again in one piece.
+- (void)_restartObject:(OFXDownloadObject *)object;
+{
+    DEBUG_TRANSFER(1, @"  Restarting download of %@", object.name);
+    
+    for (OFXDownloadRead *read in [_runningReads copy]) {
+        if (read.object == object) {
+            [_runningReads removeObject:read];
+            [read.operation cancel];
+        }
+    }
+    [_pendingReads filterUsingPredicate:[NSPredicate predicateWithBlock:^BOOL(OFXDownloadRead *read, NSDictionary *bindings) {
+        return read.object != object;
+    }]];
+    
+    [_partialDownload removeCompletedRange:object.rangeInFile fromFileWithHash:object.fileHash];
+    [_partialDownload setETag:nil forObjectNamed:object.name];
+    
+    OFXDownloadRead *read = [OFXDownloadRead new];
+    read.object = object;
+    read.rangeInObject = NSMakeRange(0, object.rangeInFile.length);
+    object.remainingReadCount = 1;
+    [_pendingReads insertObject:read atIndex:0];
 }
 
-- (void)_startReadOperation;
+// Returns NO if the read was abandoned.
+- (BOOL)_checkResponseForRead:(OFXDownloadRead *)read;
+{
+    OBPRECONDITION(!read.checkedResponse);
+    read.checkedResponse = YES;
+    
+    ODAVOperation *operation = read.operation;
+    OFXDownloadObject *object = read.object;
+    NSInteger statusCode = operation.statusCode;
+    
+    if (statusCode == ODAV_HTTP_PARTIAL_CONTENT) {
+        NSString *contentRange = [operation valueForResponseHeader:@"Content-Range"];
+        unsigned long long firstByte, lastByte;
+        if (!ODAVParseContentRangeBytes(contentRange, &firstByte, &lastByte, NULL) || firstByte != read.rangeInObject.location || lastByte + 1 != NSMaxRange(read.rangeInObject)) {
+            NSError *error = [NSError errorWithDomain:ODAVErrorDomain code:ODAVInvalidPartialResponse userInfo:@{@"Content-Range":(contentRange ? contentRange : @"(missing)"), NSURLErrorFailingURLErrorKey:operation.url}];
+            [self _failWithError:error];
+            return NO;
+        }
+    } else if (read.rangeInObject.location != 0 || read.rangeInObject.length != object.rangeInFile.length) {
+        // The server sent the whole object instead of the range we asked for. Stop asking.
+        DEBUG_TRANSFER(1, @"  Server ignored range request for %@ (status %ld)", operation.url, statusCode);
+        _serverIgnoresRanges = YES;
+        [self _restartObject:object];
+        [self _startReads];
+        return NO;
+    }
+    
+    NSString *ETag = [operation valueForResponseHeader:@"ETag"];
+    NSString *previousETag = [_partialDownload ETagForObjectNamed:object.name];
+    if (ETag && previousETag && ![ETag isEqual:previousETag]) {
+        [self _restartObject:object];
+        [self _startReads];
+        return NO;
+    }
+    if (ETag && !previousETag)
+        [_partialDownload setETag:ETag forObjectNamed:object.name];
+    
+    return YES;
+}
+
+- (void)_read:(OFXDownloadRead *)read didReceiveData:(NSData *)data;
 {
     OBPRECONDITION([NSOperationQueue currentQueue] == self.operationQueue);
+    
+    if (_cancelled || [_runningReads indexOfObjectIdenticalTo:read] == NSNotFound)
+        return; // Abandoned
+    
+    if (!read.checkedResponse && ![self _checkResponseForRead:read])
+        return;
+    
+    OFXDownloadObject *object = read.object;
+    NSUInteger length = [data length];
+    if (read.receivedLength + length > read.rangeInObject.length) {
+        __autoreleasing NSError *error;
+        OFXError(&error, OFXDownloadFailed, @"Server sent more data than expected", ([NSString stringWithFormat:@"Expected %lu bytes from \"%@\"", read.rangeInObject.length, read.operation.url]));
+        [self _failWithError:error];
+        return;
+    }
+    
+    __autoreleasing NSError *writeError;
+    unsigned long long offset = object.rangeInFile.location + read.rangeInObject.location + read.receivedLength;
+    if (![_partialDownload writeData:data toFileWithHash:object.fileHash atOffset:offset error:&writeError]) {
+        [self _failWithError:writeError];
+        return;
+    }
+    
+    read.receivedLength += length;
+    [self addTransferredByteCount:length];
+    [self _readByteCount:length];
+}
 
-    if (_cancelled)
+- (void)_read:(OFXDownloadRead *)read finishedWithError:(NSError *)errorOrNil;
+{
+    OBPRECONDITION([NSOperationQueue currentQueue] == self.operationQueue);
+    
+    if (_cancelled || [_runningReads indexOfObjectIdenticalTo:read] == NSNotFound)
+        return; // Abandoned
+    
+    OFXDownloadObject *object = read.object;
+    
+    if (errorOrNil && [errorOrNil hasUnderlyingErrorDomain:ODAVHTTPErrorDomain code:ODAV_HTTP_PRECONDITION_FAILED]) {
+        // The ETag from an earlier attempt is out of date.
+        [self _restartObject:object];
+        [self _startReads];
+        return;
+    }
+    
+    if (!errorOrNil && !read.checkedResponse && ![self _checkResponseForRead:read])
         return;
     
-    _runningOperation = [[_readOperationToLocalFileURL allKeys] lastObject];
-    if (_runningOperation) {
-        _resultData = [NSMutableData new];
-        [_runningOperation startWithCallbackQueue:self.transferOperationQueue];
+    [_runningReads removeObjectIdenticalTo:read];
+    
+    // Keep whatever we did get.
+    NSRange receivedRange = NSMakeRange(object.rangeInFile.location + read.rangeInObject.location, read.receivedLength);
+    [_partialDownload addCompletedRange:receivedRange toFileWithHash:object.fileHash];
+    
+    if (!errorOrNil && read.receivedLength < read.rangeInObject.length) {
+        __autoreleasing NSError *truncatedError;
+        OFXError(&truncatedError, OFXDownloadFailed, @"Download was cut short", ([NSString stringWithFormat:@"Expected %lu bytes from \"%@\", but got %lu", read.rangeInObject.length, read.operation.url, read.receivedLength]));
+        errorOrNil = truncatedError;
+    }
+    
+    if (errorOrNil) {
+        BOOL retryable = ([errorOrNil causedByNetworkConnectionLost] || [errorOrNil hasUnderlyingErrorDomain:OFXErrorDomain code:OFXDownloadFailed]);
+        if (!retryable || _readRetryCount >= (NSUInteger)OFXDownloadMaximumReadRetries) {
+            [self _failWithError:errorOrNil];
+            return;
+        }
+        
+        // Pick up where this read left off.
+        _readRetryCount++;
+        DEBUG_TRANSFER(1, @"  Retrying the rest of %@ after %lu bytes (attempt %lu)", read.operation.url, read.receivedLength, _readRetryCount);
+        
+        OFXDownloadRead *retry = [OFXDownloadRead new];
+        retry.object = object;
+        retry.rangeInObject = NSMakeRange(read.rangeInObject.location + read.receivedLength, read.rangeInObject.length - read.receivedLength);
+        [_pendingReads insertObject:retry atIndex:0];
+        [self _startReads];
         return;
     }
     
+    __autoreleasing NSError *saveError;
+    if (![_partialDownload saveState:&saveError])
+        [saveError log:@"Error saving partial download state in %@", _partialDownloadURL]; // We can go on, but won't be able to resume
+    
+    OBASSERT(object.remainingReadCount > 0);
+    object.remainingReadCount--;
+    if (object.remainingReadCount == 0) {
+        // One downside to always using Info.plist is that we lose this check for the main plist. Random bit corruption on disk would have a relatively low chance of clobbering XML structure. If we gzip the plist, this'll be more likely to be noticed.
+        // TODO: Queue this so that the hash validation can run concurrently with the next file download.
+        if (![self _verifyObject:object]) {
+            [_partialDownload saveState:NULL];
+            
+            __autoreleasing NSError *corruptionError = nil;
+            OFXError(&corruptionError, OFXSnapshotCorrupt, @"Possible document corruption", ([NSString stringWithFormat:@"Downloaded data does not match the hash in the last path component of \"%@\"", [_remoteSnapshotURL URLByAppendingPathComponent:object.name]]));
+            [self _failWithError:corruptionError];
+            return;
+        }
+        
+        __autoreleasing NSError *error;
+        if (![self _completedObject:object error:&error]) {
+            [self _failWithError:error];
+            return;
+        }
+    }
+    
+    [self _startReads];
+}
+
+// Checks the written bytes of the object against its name, forgetting them if they don't match.
+- (BOOL)_verifyObject:(OFXDownloadObject *)object;
+{
+    NSRange rangeInFile = object.rangeInFile;
+    
+    NSData *data;
+    if (rangeInFile.length == 0)
+        data = [NSData data];
+    else {
+        __autoreleasing NSError *readError;
+        data = [_partialDownload dataOfFileWithHash:object.fileHash range:rangeInFile error:&readError];
+        if (!data)
+            [readError log:@"Error reading partial download of %@", object.name];
+    }
+    
+    if (data && [OFXHashFileNameForData(data) isEqualToString:object.name])
+        return YES;
+    
+    DEBUG_TRANSFER(1, @"  Partial download of %@ is bad; discarding it", object.name);
+    [_partialDownload removeCompletedRange:rangeInFile fromFileWithHash:object.fileHash];
+    [_partialDownload setETag:nil forObjectNamed:object.name];
+    return NO;
+}
+
+// Marks the object's file as finished once all its objects are done. It stays in the partial download until _finishedReading, so if anything else fails, the next attempt still has it.
+- (BOOL)_completedObject:(OFXDownloadObject *)object error:(NSError **)outError;
+{
+    NSString *fileHash = object.fileHash;
+    
+    NSUInteger remainingObjectCount = [_fileHashToRemainingObjectCount[fileHash] unsignedIntegerValue];
+    OBASSERT(remainingObjectCount > 0);
+    remainingObjectCount--;
+    _fileHashToRemainingObjectCount[fileHash] = @(remainingObjectCount);
+    if (remainingObjectCount > 0)
+        return YES;
+    
+    // Each chunk was checked, but make sure the chunk list itself was right.
+    if (![object.name isEqualToString:fileHash]) {
+        unsigned long long fileSize = [_fileHashToSize[fileHash] unsignedLongLongValue];
+        NSData *fileData = [_partialDownload dataOfFileWithHash:fileHash range:NSMakeRange(0, (NSUInteger)fileSize) error:outError];
+        if (!fileData)
+            return NO;
+        
+        NSString *assembledHash = OFXHashFileNameForData(fileData);
+        if (![assembledHash isEqualToString:fileHash]) {
+            [_partialDownload removeCompletedRange:NSMakeRange(0, (NSUInteger)fileSize) fromFileWithHash:fileHash];
+            OFXError(outError, OFXSnapshotCorrupt, @"Possible document corruption", ([NSString stringWithFormat:@"Hash of the assembled chunks (%@) does not match the expected hash %@", assembledHash, fileHash]));
+            return NO;
+        }
+    }
+    
+    [_partialDownload finishFileWithHash:fileHash];
+    return YES;
+}
+
+- (void)_readByteCount:(NSUInteger)byteCount;
+{
+    _totalBytesRead += byteCount;
+    
+    // Restarted objects get counted again, so this can overshoot a little.
+    double percentComplete = (double)_totalBytesRead/(double)_totalBytesToRead;
+    OBASSERT(percentComplete >= 0);
+    
+    [self updatePercentCompleted:CLAMP(percentComplete, 0.0, 1.0)];
+}
+
+- (void)_finishedReading;
+{
+    OBPRECONDITION([NSOperationQueue currentQueue] == self.operationQueue);
+    OBPRECONDITION([_runningReads count] == 0);
+    OBPRECONDITION([_pendingReads count] == 0);
+    
     __autoreleasing NSError *error;
 
     if (_localTemporaryDocumentContentsURL) {
+        OBASSERT(_partialDownload.finishedFileCount == [_fileHashToFileURLs count]);
+        
+        // This might be the root of our download (for a flat file) or somewhere down in a directory (in which case this flag will have been set already). Either way, from here on a failure needs to clean it up.
+        _hasCreatedLocalTemporaryDocumentContentsURL = YES;
+        if (![_partialDownload moveFinishedFilesToURLs:_fileHashToFileURLs error:&error]) {
+            [_partialDownload saveState:NULL]; // Keep whatever didn't get moved
+            OFXFileSnapshotTransferReturnWithError(error);
+        }
+        [_partialDownload remove];
+        
         if (![_downloadingSnapshot finishedDownloadingToURL:_localTemporaryDocumentContentsURL error:&error])
             OFXFileSnapshotTransferReturnWithError(error);
         
@@ -275,6 +675,9 @@ RCS_ID("$Id$")
         OFXFileSnapshotTransferReturnWithError(error);
     DEBUG_TRANSFER(2, @"  reloaded downloaded snapshot %@", [_downloadedSnapshot shortDescription]);
     
+    if (_localTemporaryDocumentContentsURL)
+        TRACE_APPEND(OFXFileSnapshotDownloadTransfer.bytes_downloaded, @(self.bytesTransferred));
+    
     [self finished:nil];
 }
 
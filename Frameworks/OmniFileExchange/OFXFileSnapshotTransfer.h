@@ -33,6 +33,10 @@ typedef NSError * (^OFXFileSnapshotTransferDone)(OFXFileSnapshotTransfer *transf
 
 // Called by subclasses to provoke transferProgress invocations
 - (void)updatePercentCompleted:(float)percentCompleted;
+
+// Document bytes sent or received so far, for the account agent's bandwidth accounting. Subclasses should call -addTransferredByteCount: as data goes over the wire.
+@property(nonatomic,readonly) long long bytesTransferred;
+- (void)addTransferredByteCount:(long long)byteCount;
 - (void)finished:(NSError *)errorOrNil;
 - (void)cancelForShutdown:(BOOL)isShuttingDown;
 
@@ -77,6 +77,14 @@ RCS_ID("$Id$")
         _transferProgress();
 }
 
+- (void)addTransferredByteCount:(long long)byteCount;
+{
+    OBPRECONDITION([NSOperationQueue currentQueue] == _operationQueue);
+    OBPRECONDITION(byteCount >= 0);
+    
+    _bytesTransferred += byteCount;
+}
+
 static BOOL _shouldLogError(NSError *error)
 {
     OBPRECONDITION(error);
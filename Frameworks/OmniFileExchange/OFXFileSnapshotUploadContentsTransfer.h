@@ -8,5 +8,5 @@
 #import "OFXFileSnapshotUploadTransfer.h"
 
 @interface OFXFileSnapshotUploadContentsTransfer : OFXFileSnapshotUploadTransfer
-- (id)initWithConnection:(ODAVConnection *)connection currentSnapshot:(OFXFileSnapshot *)currentSnapshot forUploadingVersionOfDocumentAtURL:(NSURL *)localDocumentURL localRelativePath:(NSString *)localRelativePath remoteTemporaryDirectory:(NSURL *)remoteTemporaryDirectory error:(NSError **)outError;
+- (id)initWithConnection:(ODAVConnection *)connection currentSnapshot:(OFXFileSnapshot *)currentSnapshot forUploadingVersionOfDocumentAtURL:(NSURL *)localDocumentURL localRelativePath:(NSString *)localRelativePath previousRemoteSnapshotURL:(NSURL *)previousRemoteSnapshotURL chunked:(BOOL)chunked remoteTemporaryDirectory:(NSURL *)remoteTemporaryDirectory error:(NSError **)outError;
 @end
@@ -8,24 +8,43 @@
 #import "OFXFileSnapshotUploadContentsTransfer.h"
 
 #import <OmniDAV/ODAVConnection.h>
+#import <OmniDAV/ODAVErrors.h>
 #import <OmniDAV/ODAVFileInfo.h>
 #import <OmniDAV/ODAVOperation.h>
 
 #import "OFXUploadContentsFileSnapshot.h"
+#import "OFXContentChunking.h"
+#import "OFXFileSnapshot-Internal.h"
 #import "OFXFileSnapshotRemoteEncoding.h"
 #import "OFXFileState.h"
+#import "OFXTrace.h"
 
 RCS_ID("$Id$")
 
 /*
  Uploads a snapshot to a temporary location on the remote server. This is explicitly a *temporary* location; after the completion of this operation, the completion handler will be used to commit the operation by moving the upload to its final location (or abandoning/deleting it).
+ 
+ Objects (whole files or chunks) that the previous version of the snapshot already stored on the server are copied from it on the server rather than sent again.
  */
 
+// One object to store in the temporary snapshot directory.
+@interface OFXSnapshotObjectWrite : NSObject
+@property(nonatomic,strong) NSURL *destinationURL;
+@property(nonatomic,strong) NSData *data; // Possibly a mapped file, of which we send only the range
+@property(nonatomic) NSRange range;
+@property(nonatomic,strong) NSURL *copySourceURL; // If set, we try a server-side COPY before sending the data
+@end
+
+@implementation OFXSnapshotObjectWrite
+@end
+
 @implementation OFXFileSnapshotUploadContentsTransfer
 {
     OFXUploadContentsFileSnapshot *_uploadingSnapshot;
+    NSURL *_previousRemoteSnapshotURL;
     
-    NSMutableArray <ODAVOperation *> *_writeOperations;
+    NSMutableArray <OFXSnapshotObjectWrite *> *_writes;
+    OFXSnapshotObjectWrite *_runningWrite;
     id <ODAVAsynchronousOperation> _runningOperation;
     BOOL _cancelled;
     
@@ -33,15 +52,18 @@ RCS_ID("$Id$")
     long long _totalBytesWritten;
 }
 
-- (id)initWithConnection:(ODAVConnection *)connection currentSnapshot:(OFXFileSnapshot *)currentSnapshot forUploadingVersionOfDocumentAtURL:(NSURL *)localDocumentURL localRelativePath:(NSString *)localRelativePath remoteTemporaryDirectory:(NSURL *)remoteTemporaryDirectory error:(NSError **)outError;
+- (id)initWithConnection:(ODAVConnection *)connection currentSnapshot:(OFXFileSnapshot *)currentSnapshot forUploadingVersionOfDocumentAtURL:(NSURL *)localDocumentURL localRelativePath:(NSString *)localRelativePath previousRemoteSnapshotURL:(NSURL *)previousRemoteSnapshotURL chunked:(BOOL)chunked remoteTemporaryDirectory:(NSURL *)remoteTemporaryDirectory error:(NSError **)outError;
 {    
+    OBPRECONDITION(!previousRemoteSnapshotURL || !currentSnapshot.remoteState.missing, "Shouldn't have a previous version to copy from if it was never uploaded");
+
     if (!(self = [super initWithConnection:connection currentSnapshot:currentSnapshot remoteTemporaryDirectory:remoteTemporaryDirectory]))
         return nil;
     
-    _writeOperations = [NSMutableArray new];
+    _previousRemoteSnapshotURL = [previousRemoteSnapshotURL copy];
+    _writes = [NSMutableArray new];
     
     // This does a coordinated read of the document and captures a copy of the current document contents as well as local filesystem state (so we can tell if the local document changes later).
-    _uploadingSnapshot = [[OFXUploadContentsFileSnapshot alloc] initWithTargetLocalSnapshotURL:currentSnapshot.localSnapshotURL forUploadingVersionOfDocumentAtURL:localDocumentURL localRelativePath:localRelativePath previousSnapshot:currentSnapshot error:outError];
+    _uploadingSnapshot = [[OFXUploadContentsFileSnapshot alloc] initWithTargetLocalSnapshotURL:currentSnapshot.localSnapshotURL forUploadingVersionOfDocumentAtURL:localDocumentURL localRelativePath:localRelativePath previousSnapshot:currentSnapshot chunked:chunked error:outError];
     if (!_uploadingSnapshot)
         return nil;
     
@@ -65,11 +87,31 @@ RCS_ID("$Id$")
     if (!temporaryRemoteSnapshotURL)
         OFXFileSnapshotTransferReturnWithError(error);
 
-    // Collect async write operations        
-    BOOL success = [_uploadingSnapshot iterateFiles:&error withApplier:^BOOL(NSURL *fileURL, NSString *hash, NSError **applierError){
-        NSURL *remoteFileURL = [temporaryRemoteSnapshotURL URLByAppendingPathComponent:hash];
+    // Objects the previous version stored can be copied on the server instead of uploaded. Identical files or chunks within this version only need to be stored once.
+    NSSet <NSString *> *previousObjectNames = _previousRemoteSnapshotURL ? OFXStoredObjectNames(self.currentSnapshot.infoDictionary) : nil;
+    NSDictionary <NSString *, NSArray *> *fileHashToChunks = _uploadingSnapshot.infoDictionary[kOFXInfo_ChunksKey];
+    NSMutableSet <NSString *> *writtenObjectNames = [NSMutableSet set];
+    
+    void (^addWrite)(NSString *name, NSData *data, NSRange range) = ^(NSString *name, NSData *data, NSRange range){
+        if ([writtenObjectNames member:name])
+            return;
+        [writtenObjectNames addObject:name];
         
-        DEBUG_TRANSFER(2, @"  Writing %@ -> %@", fileURL, remoteFileURL);
+        OFXSnapshotObjectWrite *write = [OFXSnapshotObjectWrite new];
+        write.destinationURL = [temporaryRemoteSnapshotURL URLByAppendingPathComponent:name];
+        write.data = data;
+        write.range = range;
+        if ([previousObjectNames member:name])
+            write.copySourceURL = [_previousRemoteSnapshotURL URLByAppendingPathComponent:name];
+        else
+            _totalBytesToWrite += range.length;
+        
+        [_writes addObject:write];
+    };
+    
+    // Collect async writes
+    BOOL success = [_uploadingSnapshot iterateFiles:&error withApplier:^BOOL(NSURL *fileURL, NSString *hash, NSError **applierError){
+        DEBUG_TRANSFER(2, @"  Writing %@ -> %@", fileURL, [temporaryRemoteSnapshotURL URLByAppendingPathComponent:hash]);
         
         // Require that we file map since we pre-read these. OmniFileExchange directories should always be on local filesystems (so file coordination works) and we should always be reading from a private snapshot here (so there should be no editors).
         NSData *fileData = [[NSData alloc] initWithContentsOfURL:fileURL options:NSDataReadingMappedAlways|NSDataReadingUncached error:applierError];
@@ -78,10 +120,17 @@ RCS_ID("$Id$")
             return NO;
         }
         
-        _totalBytesToWrite += [fileData length];
-        
-        ODAVOperation *writeOperation = [self.connection asynchronousPutData:fileData toURL:remoteFileURL];
-        [_writeOperations addObject:writeOperation];
+        NSArray <NSDictionary *> *chunks = fileHashToChunks[hash];
+        if (chunks) {
+            NSUInteger offset = 0;
+            for (NSDictionary *chunk in chunks) {
+                NSUInteger length = [chunk[kOFXContents_FileSizeKey] unsignedIntegerValue];
+                addWrite(chunk[kOFXContents_FileHashKey], fileData, NSMakeRange(offset, length));
+                offset += length;
+            }
+            OBASSERT(offset == [fileData length]);
+        } else
+            addWrite(hash, fileData, NSMakeRange(0, [fileData length]));
         
         return YES;
     }];
@@ -99,8 +148,11 @@ RCS_ID("$Id$")
         
         _totalBytesToWrite += [infoData length];
 
-        ODAVOperation *writeOperation = [self.connection asynchronousPutData:infoData toURL:infoURL];
-        [_writeOperations addObject:writeOperation];
+        OFXSnapshotObjectWrite *write = [OFXSnapshotObjectWrite new];
+        write.destinationURL = infoURL;
+        write.data = infoData;
+        write.range = NSMakeRange(0, [infoData length]);
+        [_writes addObject:write];
     }
     
     [self _startWriteOperation];
@@ -191,9 +243,29 @@ RCS_ID("$Id$")
     if (_cancelled)
         return;
 
-    _runningOperation = [_writeOperations lastObject];
-    if (_runningOperation) {
+    _runningWrite = [_writes lastObject];
+    if (_runningWrite) {
         __weak OFXFileSnapshotUploadContentsTransfer *weakSelf = self;
+        OFXSnapshotObjectWrite *write = _runningWrite;
+        
+        if (write.copySourceURL) {
+            DEBUG_TRANSFER(2, @"  Copying %@ -> %@", write.copySourceURL, write.destinationURL);
+            [self.connection copyURL:write.copySourceURL toURL:write.destinationURL withSourceETag:nil overwrite:NO completionHandler:^(ODAVURLResult *result, NSError *errorOrNil) {
+                OFXFileSnapshotUploadContentsTransfer *strongSelf = weakSelf;
+                if (!strongSelf)
+                    return; // Cancelled, presumably
+                [strongSelf.operationQueue addOperationWithBlock:^{
+                    [strongSelf _write:write didCopy:errorOrNil];
+                }];
+            }];
+            return;
+        }
+        
+        NSData *data = write.data;
+        if (write.range.location != 0 || write.range.length != [data length])
+            data = [data subdataWithRange:write.range];
+        
+        _runningOperation = [self.connection asynchronousPutData:data toURL:write.destinationURL];
         _runningOperation.didFinish = ^(ODAVOperation *op, NSError *errorOrNil){
             OFXFileSnapshotUploadContentsTransfer *strongSelf = weakSelf;
             if (!strongSelf)
@@ -221,6 +293,7 @@ RCS_ID("$Id$")
         OFXFileSnapshotTransferReturnWithError(error);
     
     DEBUG_TRANSFER(1, @"Uploaded %@", self.temporaryRemoteSnapshotURL);
+    TRACE_APPEND(OFXFileSnapshotUploadContentsTransfer.bytes_uploaded, @(self.bytesTransferred));
     
     // Our superclass wants this called on the transfer queue...
     [self finished:nil];
@@ -230,7 +303,7 @@ RCS_ID("$Id$")
 {
     OBPRECONDITION([NSOperationQueue currentQueue] == self.operationQueue);
     OBPRECONDITION(operation == _runningOperation);
-    OBPRECONDITION([_writeOperations indexOfObject:operation] != NSNotFound);
+    OBPRECONDITION(_runningWrite != nil);
     
     if (error) {
         [self finished:error];
@@ -239,17 +312,47 @@ RCS_ID("$Id$")
     if (_cancelled)
         return;
     
-    [_writeOperations removeObject:operation];
+    [_writes removeObject:_runningWrite];
+    _runningWrite = nil;
     _runningOperation = nil;
     
     [self _startWriteOperation];
 }
 
+- (void)_write:(OFXSnapshotObjectWrite *)write didCopy:(NSError *)error;
+{
+    OBPRECONDITION([NSOperationQueue currentQueue] == self.operationQueue);
+    OBPRECONDITION(write == _runningWrite);
+    
+    if (_cancelled)
+        return;
+    
+    if (error) {
+        if (![error hasUnderlyingErrorDomain:ODAVHTTPErrorDomain code:ODAV_HTTP_NOT_FOUND]) {
+            [self finished:error];
+            return;
+        }
+        
+        // The previous version was replaced or deleted while we were uploading; send our copy instead.
+        DEBUG_TRANSFER(2, @"  Previous version is gone, uploading %@", write.destinationURL);
+        write.copySourceURL = nil;
+        _totalBytesToWrite += write.range.length;
+        [self _startWriteOperation];
+        return;
+    }
+    
+    [_writes removeObject:write];
+    _runningWrite = nil;
+    
+    [self _startWriteOperation];
+}
+
 - (void)_writeOperation:(ODAVOperation *)operation didSendBytes:(long long)processedBytes;
 {
     OBPRECONDITION([NSOperationQueue currentQueue] == self.operationQueue);
     
     _totalBytesWritten += processedBytes;
+    [self addTransferredByteCount:processedBytes];
     
     double percentComplete = (double)_totalBytesWritten/(double)_totalBytesToWrite;
     OBASSERT(percentComplete > 0); // we just wrote some...
@@ -0,0 +1,49 @@
+// Copyright 2026 Omni Development, Inc. All rights reserved.
+//
+// This software may only be used and reproduced according to the
+// terms in the file OmniSourceLicense.html, which should be
+// distributed with this project and can also be found at
+// <http://www.omnigroup.com/developer/sourcecode/sourcelicense/>.
+
+#import <Foundation/NSObject.h>
+
+/*
+ The files of a download, written in place as their bytes arrive, along with a record of which byte ranges have been written and the ETags of the stored objects they came from. Everything lives in one directory per file item, so if a download transfer fails or is cancelled, the next one for the item can pick up where it left off.
+
+ Files are named by the hash of their contents rather than their path in the document, so a later version of the document (or a renamed one) still gets the benefit of a partial download of an unchanged file.
+
+ Saving the state doesn't sync the file contents, so after a crash the recorded ranges might not really be there. Callers must check each stored object against its hash once all of it has been written, and forget the ranges of any that don't match.
+ */
+@interface OFXPartialDownload : NSObject
+
+- initWithDirectoryURL:(NSURL *)directoryURL;
+
+@property(nonatomic,readonly) NSURL *directoryURL;
+
+// Keeps the file if an earlier attempt left one of the right size, or creates an empty (sparse) one. Files are only opened while they are being written, and only a few at a time, so a package with more members than the process may have open file descriptors can still be downloaded.
+- (BOOL)prepareFileWithHash:(NSString *)fileHash size:(unsigned long long)fileSize error:(NSError **)outError;
+@property(nonatomic,readonly) NSUInteger openFileCount;
+
+- (NSArray <NSValue *> *)missingRangesOfFileWithHash:(NSString *)fileHash inRange:(NSRange)range; // NSValues wrapping NSRanges
+- (void)addCompletedRange:(NSRange)range toFileWithHash:(NSString *)fileHash;
+- (void)removeCompletedRange:(NSRange)range fromFileWithHash:(NSString *)fileHash;
+
+- (BOOL)writeData:(NSData *)data toFileWithHash:(NSString *)fileHash atOffset:(unsigned long long)offset error:(NSError **)outError;
+- (NSData *)dataOfFileWithHash:(NSString *)fileHash range:(NSRange)range error:(NSError **)outError;
+
+- (NSString *)ETagForObjectNamed:(NSString *)objectName;
+- (void)setETag:(NSString *)ETag forObjectNamed:(NSString *)objectName;
+
+- (BOOL)saveState:(NSError **)outError;
+
+// Closes a file whose contents have all been written and checked. It stays here, with all of its bytes recorded as completed, until -moveFinishedFilesToURLs:error:, so that a failed or cancelled transfer doesn't lose it.
+- (void)finishFileWithHash:(NSString *)fileHash;
+@property(nonatomic,readonly) NSUInteger finishedFileCount;
+
+// Moves each finished file to the last of its URLs (copying it to the others) and forgets about it. Every file must have been finished.
+- (BOOL)moveFinishedFilesToURLs:(NSDictionary <NSString *, NSArray <NSURL *> *> *)fileHashToURLs error:(NSError **)outError;
+
+- (void)close; // Closes any open files, leaving them and the state for a later attempt
+- (void)remove; // Closes and removes everything
+
+@end
@@ -0,0 +1,350 @@
+// Copyright 2026 Omni Development, Inc. All rights reserved.
+//
+// This software may only be used and reproduced according to the
+// terms in the file OmniSourceLicense.html, which should be
+// distributed with this project and can also be found at
+// <http://www.omnigroup.com/developer/sourcecode/sourcelicense/>.
+
+#import "OFXPartialDownload.h"
+
+#import <OmniFoundation/CFPropertyList-OFExtensions.h>
+#import <OmniFoundation/OFPreference.h>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+RCS_ID("$Id$")
+
+static OFDeclareIntegerConfigurationValue(OFXPartialDownloadMaximumOpenFiles, 16, 1, 128); // Writes are spread over the files being read at the moment, so this only needs to be a bit more than the number of concurrent reads.
+
+static NSString * const StateFileName = @"State.plist";
+
+#define kOFXPartialDownload_FilesKey @"Files"
+#define kOFXPartialDownload_ETagsKey @"ETags"
+#define kOFXPartialDownload_SizeKey @"Size"
+#define kOFXPartialDownload_CompletedKey @"Completed" // Flattened array of location/length pairs
+
+@interface OFXPartialDownloadFile : NSObject
+@property(nonatomic) unsigned long long size;
+@property(nonatomic,strong) NSMutableIndexSet *completed;
+@property(nonatomic) int fileDescriptor;
+@property(nonatomic) BOOL finished;
+@end
+
+@implementation OFXPartialDownloadFile
+@end
+
+@implementation OFXPartialDownload
+{
+    NSMutableDictionary <NSString *, OFXPartialDownloadFile *> *_files;
+    NSMutableDictionary <NSString *, NSString *> *_objectNameToETag;
+    NSMutableArray <NSString *> *_openFileHashes; // Least recently written first
+}
+
+- init;
+{
+    OBRejectUnusedImplementation(self, _cmd);
+}
+
+- initWithDirectoryURL:(NSURL *)directoryURL;
+{
+    OBPRECONDITION(directoryURL);
+
+    if (!(self = [super init]))
+        return nil;
+
+    _directoryURL = [directoryURL copy];
+    _files = [NSMutableDictionary new];
+    _objectNameToETag = [NSMutableDictionary new];
+    _openFileHashes = [NSMutableArray new];
+
+    // Anything unreadable just means starting over.
+    NSDictionary *state = OFReadNSPropertyListFromURL([_directoryURL URLByAppendingPathComponent:StateFileName isDirectory:NO], NULL);
+    if ([state isKindOfClass:[NSDictionary class]]) {
+        NSDictionary *files = state[kOFXPartialDownload_FilesKey];
+        if ([files isKindOfClass:[NSDictionary class]]) {
+            [files enumerateKeysAndObjectsUsingBlock:^(NSString *fileHash, NSDictionary *fileState, BOOL *stop) {
+                if (![fileState isKindOfClass:[NSDictionary class]])
+                    return;
+                NSArray <NSNumber *> *completedValues = fileState[kOFXPartialDownload_CompletedKey];
+                if (![completedValues isKindOfClass:[NSArray class]] || ([completedValues count] % 2) != 0)
+                    return;
+
+                OFXPartialDownloadFile *file = [OFXPartialDownloadFile new];
+                file.size = [fileState[kOFXPartialDownload_SizeKey] unsignedLongLongValue];
+                file.completed = [NSMutableIndexSet indexSet];
+                file.fileDescriptor = -1;
+                for (NSUInteger valueIndex = 0; valueIndex < [completedValues count]; valueIndex += 2)
+                    [file.completed addIndexesInRange:NSMakeRange([completedValues[valueIndex] unsignedIntegerValue], [completedValues[valueIndex + 1] unsignedIntegerValue])];
+                _files[fileHash] = file;
+            }];
+        }
+        NSDictionary *ETags = state[kOFXPartialDownload_ETagsKey];
+        if ([ETags isKindOfClass:[NSDictionary class]])
+            [_objectNameToETag addEntriesFromDictionary:ETags];
+    }
+
+    return self;
+}
+
+- (void)dealloc;
+{
+    [self close];
+}
+
+- (BOOL)prepareFileWithHash:(NSString *)fileHash size:(unsigned long long)fileSize error:(NSError **)outError;
+{
+    OBPRECONDITION(_files[fileHash].fileDescriptor < 0, "Already open");
+
+    if (![[NSFileManager defaultManager] createDirectoryAtURL:_directoryURL withIntermediateDirectories:YES attributes:nil error:outError])
+        return NO;
+
+    NSString *path = [[self _fileURLWithHash:fileHash] path];
+    OFXPartialDownloadFile *file = _files[fileHash];
+
+    if (file && file.size == fileSize) {
+        struct stat sbuf;
+        if (stat([path fileSystemRepresentation], &sbuf) == 0 && (sbuf.st_mode & S_IFMT) == S_IFREG && (unsigned long long)sbuf.st_size == fileSize)
+            return YES;
+    }
+
+    // Nothing usable from before. Setting the length up front leaves the file sparse until the data comes in, and means we can write the pieces in whatever order they arrive.
+    int fd = open([path fileSystemRepresentation], O_RDWR|O_CREAT|O_TRUNC, 0644);
+    if (fd < 0) {
+        OBErrorWithErrno(outError, errno, "open", path, @"Unable to create file for download");
+        return NO;
+    }
+    if (ftruncate(fd, (off_t)fileSize) != 0) {
+        OBErrorWithErrno(outError, errno, "ftruncate", path, @"Unable to create file for download");
+        close(fd);
+        return NO;
+    }
+    close(fd);
+
+    file = [OFXPartialDownloadFile new];
+    file.size = fileSize;
+    file.completed = [NSMutableIndexSet indexSet];
+    file.fileDescriptor = -1;
+    _files[fileHash] = file;
+
+    return YES;
+}
+
+- (NSUInteger)openFileCount;
+{
+    return [_openFileHashes count];
+}
+
+- (NSArray <NSValue *> *)missingRangesOfFileWithHash:(NSString *)fileHash inRange:(NSRange)range;
+{
+    OFXPartialDownloadFile *file = _files[fileHash];
+    OBPRECONDITION(file);
+    OBPRECONDITION(NSMaxRange(range) <= file.size);
+
+    NSMutableIndexSet *missing = [NSMutableIndexSet indexSetWithIndexesInRange:range];
+    [missing removeIndexes:file.completed];
+
+    NSMutableArray <NSValue *> *ranges = [NSMutableArray array];
+    [missing enumerateRangesUsingBlock:^(NSRange missingRange, BOOL *stop) {
+        [ranges addObject:[NSValue valueWithRange:missingRange]];
+    }];
+    return ranges;
+}
+
+- (void)addCompletedRange:(NSRange)range toFileWithHash:(NSString *)fileHash;
+{
+    OBPRECONDITION(_files[fileHash]);
+    [_files[fileHash].completed addIndexesInRange:range];
+}
+
+- (void)removeCompletedRange:(NSRange)range fromFileWithHash:(NSString *)fileHash;
+{
+    OBPRECONDITION(_files[fileHash]);
+    [_files[fileHash].completed removeIndexesInRange:range];
+}
+
+- (BOOL)writeData:(NSData *)data toFileWithHash:(NSString *)fileHash atOffset:(unsigned long long)offset error:(NSError **)outError;
+{
+    OFXPartialDownloadFile *file = _files[fileHash];
+    OBPRECONDITION(file);
+    OBPRECONDITION(!file.finished);
+    OBPRECONDITION(offset + [data length] <= file.size);
+
+    int fd = [self _fileDescriptorForFileWithHash:fileHash error:outError];
+    if (fd < 0)
+        return NO;
+
+    const uint8_t *bytes = [data bytes];
+    size_t remaining = [data length];
+    while (remaining > 0) {
+        ssize_t written = pwrite(fd, bytes, remaining, (off_t)offset);
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            OBErrorWithErrno(outError, errno, "pwrite", [[self _fileURLWithHash:fileHash] path], @"Unable to write downloaded data");
+            return NO;
+        }
+        bytes += written;
+        remaining -= written;
+        offset += written;
+    }
+    return YES;
+}
+
+- (NSData *)dataOfFileWithHash:(NSString *)fileHash range:(NSRange)range error:(NSError **)outError;
+{
+    OFXPartialDownloadFile *file = _files[fileHash];
+    OBPRECONDITION(file);
+    OBPRECONDITION(NSMaxRange(range) <= file.size);
+
+    NSData *data = [[NSData alloc] initWithContentsOfURL:[self _fileURLWithHash:fileHash] options:NSDataReadingMappedAlways|NSDataReadingUncached error:outError];
+    if (!data)
+        return nil;
+    if ([data length] != file.size) {
+        OFXError(outError, OFXDownloadFailed, @"Partially downloaded file changed size", ([NSString stringWithFormat:@"Expected %llu bytes in %@, but found %lu", file.size, [self _fileURLWithHash:fileHash], [data length]]));
+        return nil;
+    }
+    if (range.location == 0 && range.length == [data length])
+        return data;
+    return [data subdataWithRange:range];
+}
+
+- (NSString *)ETagForObjectNamed:(NSString *)objectName;
+{
+    return _objectNameToETag[objectName];
+}
+
+- (void)setETag:(NSString *)ETag forObjectNamed:(NSString *)objectName;
+{
+    _objectNameToETag[objectName] = ETag;
+}
+
+- (BOOL)saveState:(NSError **)outError;
+{
+    NSMutableDictionary *files = [NSMutableDictionary dictionary];
+    [_files enumerateKeysAndObjectsUsingBlock:^(NSString *fileHash, OFXPartialDownloadFile *file, BOOL *stop) {
+        NSMutableArray <NSNumber *> *completedValues = [NSMutableArray array];
+        [file.completed enumerateRangesUsingBlock:^(NSRange range, BOOL *stopRanges) {
+            [completedValues addObject:@(range.location)];
+            [completedValues addObject:@(range.length)];
+        }];
+        files[fileHash] = @{kOFXPartialDownload_SizeKey:@(file.size), kOFXPartialDownload_CompletedKey:completedValues};
+    }];
+
+    NSDictionary *state = @{kOFXPartialDownload_FilesKey:files, kOFXPartialDownload_ETagsKey:_objectNameToETag};
+    return OFWriteNSPropertyListToURL(state, [_directoryURL URLByAppendingPathComponent:StateFileName isDirectory:NO], outError);
+}
+
+- (void)finishFileWithHash:(NSString *)fileHash;
+{
+    OFXPartialDownloadFile *file = _files[fileHash];
+    OBPRECONDITION(file);
+    OBPRECONDITION([file.completed containsIndexesInRange:NSMakeRange(0, (NSUInteger)file.size)] || file.size == 0);
+
+    [self _closeFileWithHash:fileHash];
+    file.finished = YES;
+}
+
+- (NSUInteger)finishedFileCount;
+{
+    NSUInteger finishedFileCount = 0;
+    for (OFXPartialDownloadFile *file in [_files objectEnumerator]) {
+        if (file.finished)
+            finishedFileCount++;
+    }
+    return finishedFileCount;
+}
+
+- (BOOL)moveFinishedFilesToURLs:(NSDictionary <NSString *, NSArray <NSURL *> *> *)fileHashToURLs error:(NSError **)outError;
+{
+    NSFileManager *fileManager = [NSFileManager defaultManager];
+
+    for (NSString *fileHash in fileHashToURLs) {
+        NSArray <NSURL *> *fileURLs = fileHashToURLs[fileHash];
+        OBASSERT([fileURLs count] > 0);
+        OBASSERT(_files[fileHash].finished);
+
+        NSURL *fileURL = [self _fileURLWithHash:fileHash];
+
+        // The same contents can appear more than once in a package.
+        NSUInteger fileURLCount = [fileURLs count];
+        for (NSUInteger fileURLIndex = 0; fileURLIndex < fileURLCount - 1; fileURLIndex++) {
+            if (![fileManager copyItemAtURL:fileURL toURL:fileURLs[fileURLIndex] error:outError])
+                return NO;
+        }
+        if (![fileManager moveItemAtURL:fileURL toURL:[fileURLs lastObject] error:outError])
+            return NO;
+
+        [_files removeObjectForKey:fileHash];
+    }
+
+    return YES;
+}
+
+- (void)close;
+{
+    for (NSString *fileHash in [_openFileHashes copy])
+        [self _closeFileWithHash:fileHash];
+}
+
+- (void)remove;
+{
+    [self close];
+    [_files removeAllObjects];
+    [_objectNameToETag removeAllObjects];
+
+    __autoreleasing NSError *removeError;
+    if (![[NSFileManager defaultManager] removeItemAtURL:_directoryURL error:&removeError]) {
+        if (![removeError causedByMissingFile])
+            [removeError log:@"Error removing partial download at %@", _directoryURL];
+    }
+}
+
+#pragma mark - Private
+
+- (NSURL *)_fileURLWithHash:(NSString *)fileHash;
+{
+    return [_directoryURL URLByAppendingPathComponent:fileHash isDirectory:NO];
+}
+
+// Opens the file for writing if it isn't already, first closing the least recently written one if too many are open.
+- (int)_fileDescriptorForFileWithHash:(NSString *)fileHash error:(NSError **)outError;
+{
+    OFXPartialDownloadFile *file = _files[fileHash];
+
+    if (file.fileDescriptor >= 0) {
+        if (![[_openFileHashes lastObject] isEqualToString:fileHash]) {
+            [_openFileHashes removeObject:fileHash];
+            [_openFileHashes addObject:fileHash];
+        }
+        return file.fileDescriptor;
+    }
+
+    while ([_openFileHashes count] >= (NSUInteger)OFXPartialDownloadMaximumOpenFiles)
+        [self _closeFileWithHash:[_openFileHashes firstObject]];
+
+    NSString *path = [[self _fileURLWithHash:fileHash] path];
+    int fd = open([path fileSystemRepresentation], O_RDWR);
+    if (fd < 0) {
+        OBErrorWithErrno(outError, errno, "open", path, @"Unable to open file for download");
+        return -1;
+    }
+
+    file.fileDescriptor = fd;
+    [_openFileHashes addObject:fileHash];
+    return fd;
+}
+
+- (void)_closeFileWithHash:(NSString *)fileHash;
+{
+    OFXPartialDownloadFile *file = _files[fileHash];
+    if (file.fileDescriptor < 0)
+        return;
+
+    close(file.fileDescriptor);
+    file.fileDescriptor = -1;
+    [_openFileHashes removeObject:fileHash];
+}
+
+@end
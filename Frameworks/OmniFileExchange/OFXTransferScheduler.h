@@ -0,0 +1,60 @@
+// Copyright 2026 Omni Development, Inc. All rights reserved.
+//
+// This software may only be used and reproduced according to the
+// terms in the file OmniSourceLicense.html, which should be
+// distributed with this project and can also be found at
+// <http://www.omnigroup.com/developer/sourcecode/sourcelicense/>.
+
+#import <Foundation/NSObject.h>
+
+#import "OFXContainerAgent.h" // OFXFileItemTransferKind
+
+@class OFXFileItem;
+
+typedef NS_ENUM(NSUInteger, OFXTransferPriority) {
+    OFXTransferPriorityUserRequested, // Downloads the user explicitly asked for, in the order they were asked for
+    OFXTransferPriorityMetadata, // Deletes, renames of non-downloaded files, and downloads that only update metadata
+    OFXTransferPriorityContents, // Everything else, smallest first
+};
+
+/*
+ Decides which of the requested uploads, downloads and deletes the account agent should start next. Transfers don't tie up the account agent's serial queue (they run on their own transfer queues), so several can be in flight at once, up to a limit for the whole account and a smaller one for each container. Within those limits, higher priority requests go first.
+
+ Only one transfer runs for a file item at a time, and requests for the same file item start in the order they were made, regardless of their priority. So, an upload of new contents will finish before a later rename or delete of the same file starts.
+
+ Also keeps track of how many bytes go to and from each host and for how long transfers to that host were in flight, as a rough measure of the bandwidth we're getting.
+
+ All methods should be called on the account agent's operation queue.
+ */
+@interface OFXTransferScheduler : NSObject
+
+- initWithMaximumTransferCount:(NSUInteger)maximumTransferCount maximumTransferCountPerContainer:(NSUInteger)maximumTransferCountPerContainer;
+
+@property(nonatomic) NSUInteger maximumTransferCount;
+@property(nonatomic) NSUInteger maximumTransferCountPerContainer;
+
++ (OFXTransferPriority)priorityForTransferOfFileItem:(OFXFileItem *)fileItem kind:(OFXFileItemTransferKind)kind;
+
+- (void)addRequestedFileItem:(OFXFileItem *)fileItem kind:(OFXFileItemTransferKind)kind;
+- (void)removeRequestedFileItem:(OFXFileItem *)fileItem kind:(OFXFileItemTransferKind)kind;
+- (void)updatePriorityOfRequestedFileItem:(OFXFileItem *)fileItem kind:(OFXFileItemTransferKind)kind; // No-op if the transfer isn't waiting to start
+- (BOOL)containsFileItem:(OFXFileItem *)fileItem kind:(OFXFileItemTransferKind)kind; // Requested or running
+
+// Returns the request that should be started next, or nil if there are none or none can start until a running transfer finishes. The caller should either start it or remove it.
+- (OFXFileItem *)nextRequestedFileItem:(OFXFileItemTransferKind *)outKind;
+
+- (void)startedFileItem:(OFXFileItem *)fileItem kind:(OFXFileItemTransferKind)kind host:(NSString *)host;
+- (void)finishedFileItem:(OFXFileItem *)fileItem kind:(OFXFileItemTransferKind)kind byteCount:(long long)byteCount;
+
+@property(nonatomic,readonly) NSUInteger numberRequested;
+@property(nonatomic,readonly) NSUInteger numberRunning;
+@property(nonatomic,readonly,getter=isEmpty) BOOL empty;
+- (void)reset; // Forgets all requested and running transfers, but keeps the host statistics
+
+// Bandwidth accounting
+@property(nonatomic,readonly) NSArray <NSString *> *hosts;
+- (long long)byteCountForHost:(NSString *)host;
+- (NSTimeInterval)activeTimeForHost:(NSString *)host; // Time during which at least one transfer to the host was running
+- (double)bytesPerSecondForHost:(NSString *)host;
+
+@end
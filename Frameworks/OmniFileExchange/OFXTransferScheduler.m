@@ -0,0 +1,400 @@
+// Copyright 2026 Omni Development, Inc. All rights reserved.
+//
+// This software may only be used and reproduced according to the
+// terms in the file OmniSourceLicense.html, which should be
+// distributed with this project and can also be found at
+// <http://www.omnigroup.com/developer/sourcecode/sourcelicense/>.
+
+#import "OFXTransferScheduler.h"
+
+#import "OFXFileItem.h"
+#import "OFXFileItemTransfers.h"
+#import "OFXFileState.h"
+
+RCS_ID("$Id$")
+
+@interface OFXTransferRequest : NSObject
+@property(nonatomic,strong) OFXFileItem *fileItem;
+@property(nonatomic) OFXFileItemTransferKind kind;
+@property(nonatomic) OFXTransferPriority priority;
+@property(nonatomic) unsigned long long size;
+@property(nonatomic) NSUInteger sequence;
+@property(nonatomic,copy) NSString *containerIdentifier; // Set once started
+@property(nonatomic,copy) NSString *host;
+@end
+
+@implementation OFXTransferRequest
+@end
+
+@interface OFXTransferHostStatistics : NSObject
+{
+@public
+    NSUInteger _runningCount;
+    NSTimeInterval _activeSince;
+    NSTimeInterval _activeTime;
+    long long _byteCount;
+}
+@end
+
+@implementation OFXTransferHostStatistics
+@end
+
+static NSTimeInterval _currentTime(void)
+{
+    return [[NSProcessInfo processInfo] systemUptime];
+}
+
+static NSComparisonResult _compareRequests(OFXTransferRequest *request1, OFXTransferRequest *request2)
+{
+    if (request1.priority != request2.priority)
+        return request1.priority < request2.priority ? NSOrderedAscending : NSOrderedDescending;
+
+    // The user is waiting on the first thing they asked for, not the smallest.
+    if (request1.priority != OFXTransferPriorityUserRequested && request1.size != request2.size)
+        return request1.size < request2.size ? NSOrderedAscending : NSOrderedDescending;
+
+    if (request1.sequence != request2.sequence)
+        return request1.sequence < request2.sequence ? NSOrderedAscending : NSOrderedDescending;
+    return NSOrderedSame;
+}
+
+@implementation OFXTransferScheduler
+{
+    OFXFileItemTransfers *_uploadTransfers;
+    OFXFileItemTransfers *_downloadTransfers;
+    OFXFileItemTransfers *_deleteTransfers;
+
+    NSMutableArray <OFXTransferRequest *> *_pendingRequests; // Sorted by _compareRequests
+    NSMapTable <OFXFileItem *, NSMutableArray <OFXTransferRequest *> *> *_fileItemToPendingRequests; // In the order they were requested
+    NSMapTable <OFXFileItem *, OFXTransferRequest *> *_fileItemToRunningRequest;
+    NSCountedSet <NSString *> *_runningContainerIdentifiers;
+    NSUInteger _nextSequence;
+
+    NSMutableDictionary <NSString *, OFXTransferHostStatistics *> *_hostToStatistics;
+}
+
++ (OFXTransferPriority)priorityForTransferOfFileItem:(OFXFileItem *)fileItem kind:(OFXFileItemTransferKind)kind;
+{
+    OFXFileState *localState = fileItem.localState;
+
+    switch (kind) {
+        case OFXFileItemDeleteTransferKind:
+            return OFXTransferPriorityMetadata;
+        case OFXFileItemUploadTransferKind:
+            // Non-downloaded files can only be renamed, which doesn't move any contents.
+            if (localState.missing && localState.userMoved)
+                return OFXTransferPriorityMetadata;
+            return OFXTransferPriorityContents;
+        case OFXFileItemDownloadTransferKind:
+            // Once the contents are here, later updates aren't something the user is waiting on.
+            if (fileItem.contentsRequestedByUser && localState.missing)
+                return OFXTransferPriorityUserRequested;
+            // Same test the file item uses to decide whether to download contents.
+            if (!fileItem.contentsRequested && localState.missing)
+                return OFXTransferPriorityMetadata;
+            return OFXTransferPriorityContents;
+    }
+
+    OBASSERT_NOT_REACHED("Unknown transfer kind %ld", kind);
+    return OFXTransferPriorityContents;
+}
+
+- init;
+{
+    OBRejectUnusedImplementation(self, _cmd);
+}
+
+- initWithMaximumTransferCount:(NSUInteger)maximumTransferCount maximumTransferCountPerContainer:(NSUInteger)maximumTransferCountPerContainer;
+{
+    OBPRECONDITION(maximumTransferCount > 0);
+    OBPRECONDITION(maximumTransferCountPerContainer > 0);
+
+    if (!(self = [super init]))
+        return nil;
+
+    _maximumTransferCount = maximumTransferCount;
+    _maximumTransferCountPerContainer = maximumTransferCountPerContainer;
+
+    _uploadTransfers = [OFXFileItemTransfers new];
+    _downloadTransfers = [OFXFileItemTransfers new];
+    _deleteTransfers = [OFXFileItemTransfers new];
+
+    _pendingRequests = [NSMutableArray new];
+    _fileItemToPendingRequests = [NSMapTable strongToStrongObjectsMapTable];
+    _fileItemToRunningRequest = [NSMapTable strongToStrongObjectsMapTable];
+    _runningContainerIdentifiers = [NSCountedSet new];
+
+    _hostToStatistics = [NSMutableDictionary new];
+
+    return self;
+}
+
+- (void)addRequestedFileItem:(OFXFileItem *)fileItem kind:(OFXFileItemTransferKind)kind;
+{
+    OBPRECONDITION(fileItem);
+    OBPRECONDITION(![self containsFileItem:fileItem kind:kind]);
+
+    [[self _transfersOfKind:kind] addRequestedFileItem:fileItem];
+
+    OFXTransferRequest *request = [OFXTransferRequest new];
+    request.fileItem = fileItem;
+    request.kind = kind;
+    request.priority = [[self class] priorityForTransferOfFileItem:fileItem kind:kind];
+    request.size = fileItem.totalSize;
+    request.sequence = _nextSequence++;
+
+    [self _insertPendingRequest:request];
+
+    NSMutableArray <OFXTransferRequest *> *fileItemRequests = [_fileItemToPendingRequests objectForKey:fileItem];
+    if (!fileItemRequests) {
+        fileItemRequests = [NSMutableArray new];
+        [_fileItemToPendingRequests setObject:fileItemRequests forKey:fileItem];
+    }
+    [fileItemRequests addObject:request];
+}
+
+- (void)removeRequestedFileItem:(OFXFileItem *)fileItem kind:(OFXFileItemTransferKind)kind;
+{
+    OFXTransferRequest *request = [self _pendingRequestForFileItem:fileItem kind:kind];
+    OBPRECONDITION(request, "Should have been requested and not yet started");
+    if (!request)
+        return;
+
+    [[self _transfersOfKind:kind] removeRequestedFileItem:fileItem];
+    [self _removePendingRequest:request];
+}
+
+- (void)updatePriorityOfRequestedFileItem:(OFXFileItem *)fileItem kind:(OFXFileItemTransferKind)kind;
+{
+    OFXTransferRequest *request = [self _pendingRequestForFileItem:fileItem kind:kind];
+    if (!request)
+        return; // Already running
+
+    OFXTransferPriority priority = [[self class] priorityForTransferOfFileItem:fileItem kind:kind];
+    unsigned long long size = fileItem.totalSize;
+    if (request.priority == priority && request.size == size)
+        return;
+
+    // Keep the sequence number, so this is still ordered correctly with respect to other requests for the same file item.
+    [_pendingRequests removeObjectAtIndex:[self _indexOfPendingRequest:request]];
+    request.priority = priority;
+    request.size = size;
+    [self _insertPendingRequest:request];
+}
+
+- (BOOL)containsFileItem:(OFXFileItem *)fileItem kind:(OFXFileItemTransferKind)kind;
+{
+    return [[self _transfersOfKind:kind] containsFileItem:fileItem];
+}
+
+- (OFXFileItem *)nextRequestedFileItem:(OFXFileItemTransferKind *)outKind;
+{
+    OBPRECONDITION(outKind);
+
+    if ([_fileItemToRunningRequest count] >= _maximumTransferCount)
+        return nil;
+
+    for (OFXTransferRequest *request in _pendingRequests) {
+        OFXFileItem *fileItem = request.fileItem;
+
+        // One transfer at a time for each file item, started in the order they were requested.
+        if ([_fileItemToRunningRequest objectForKey:fileItem] != nil)
+            continue;
+        if ([[_fileItemToPendingRequests objectForKey:fileItem] firstObject] != request)
+            continue;
+
+        // If the file item has lost its container, hand it back anyway so the caller can discard it.
+        OFXContainerAgent *container = fileItem.container;
+        if (container && [_runningContainerIdentifiers countForObject:container.identifier] >= _maximumTransferCountPerContainer)
+            continue;
+
+        *outKind = request.kind;
+        return fileItem;
+    }
+
+    return nil;
+}
+
+- (void)startedFileItem:(OFXFileItem *)fileItem kind:(OFXFileItemTransferKind)kind host:(NSString *)host;
+{
+    OFXTransferRequest *request = [self _pendingRequestForFileItem:fileItem kind:kind];
+    OBPRECONDITION(request, "Should have been requested and not yet started");
+    OBPRECONDITION([_fileItemToRunningRequest objectForKey:fileItem] == nil, "Only one transfer should run for a file item at a time");
+    if (!request)
+        return;
+
+    [[self _transfersOfKind:kind] startedFileItem:fileItem];
+    [self _removePendingRequest:request];
+
+    request.containerIdentifier = fileItem.container.identifier;
+    request.host = host;
+    [_fileItemToRunningRequest setObject:request forKey:fileItem];
+    if (request.containerIdentifier)
+        [_runningContainerIdentifiers addObject:request.containerIdentifier];
+
+    if (host) {
+        OFXTransferHostStatistics *statistics = _hostToStatistics[host];
+        if (!statistics) {
+            statistics = [OFXTransferHostStatistics new];
+            _hostToStatistics[host] = statistics;
+        }
+        if (statistics->_runningCount == 0)
+            statistics->_activeSince = _currentTime();
+        statistics->_runningCount++;
+    }
+}
+
+- (void)finishedFileItem:(OFXFileItem *)fileItem kind:(OFXFileItemTransferKind)kind byteCount:(long long)byteCount;
+{
+    OFXTransferRequest *request = [_fileItemToRunningRequest objectForKey:fileItem];
+    OBPRECONDITION(request && request.kind == kind, "Should be running");
+    if (!request || request.kind != kind)
+        return;
+
+    [[self _transfersOfKind:kind] finishedFileItem:fileItem];
+    [_fileItemToRunningRequest removeObjectForKey:fileItem];
+    if (request.containerIdentifier)
+        [_runningContainerIdentifiers removeObject:request.containerIdentifier];
+
+    NSString *host = request.host;
+    if (host) {
+        OFXTransferHostStatistics *statistics = _hostToStatistics[host];
+        OBASSERT(statistics && statistics->_runningCount > 0);
+        statistics->_byteCount += byteCount;
+        if (statistics->_runningCount > 0 && --statistics->_runningCount == 0)
+            statistics->_activeTime += _currentTime() - statistics->_activeSince;
+    }
+}
+
+- (NSUInteger)numberRequested;
+{
+    return [_pendingRequests count];
+}
+
+- (NSUInteger)numberRunning;
+{
+    return [_fileItemToRunningRequest count];
+}
+
+- (BOOL)isEmpty;
+{
+    return [_pendingRequests count] == 0 && [_fileItemToRunningRequest count] == 0;
+}
+
+- (void)reset;
+{
+    [_uploadTransfers reset];
+    [_downloadTransfers reset];
+    [_deleteTransfers reset];
+
+    [_pendingRequests removeAllObjects];
+    [_fileItemToPendingRequests removeAllObjects];
+    [_fileItemToRunningRequest removeAllObjects];
+    [_runningContainerIdentifiers removeAllObjects];
+
+    NSTimeInterval now = _currentTime();
+    [_hostToStatistics enumerateKeysAndObjectsUsingBlock:^(NSString *host, OFXTransferHostStatistics *statistics, BOOL *stop) {
+        if (statistics->_runningCount > 0) {
+            statistics->_activeTime += now - statistics->_activeSince;
+            statistics->_runningCount = 0;
+        }
+    }];
+}
+
+#pragma mark - Bandwidth accounting
+
+- (NSArray <NSString *> *)hosts;
+{
+    return [_hostToStatistics allKeys];
+}
+
+- (long long)byteCountForHost:(NSString *)host;
+{
+    OFXTransferHostStatistics *statistics = _hostToStatistics[host];
+    return statistics ? statistics->_byteCount : 0;
+}
+
+- (NSTimeInterval)activeTimeForHost:(NSString *)host;
+{
+    OFXTransferHostStatistics *statistics = _hostToStatistics[host];
+    if (!statistics)
+        return 0;
+
+    NSTimeInterval activeTime = statistics->_activeTime;
+    if (statistics->_runningCount > 0)
+        activeTime += _currentTime() - statistics->_activeSince;
+    return activeTime;
+}
+
+- (double)bytesPerSecondForHost:(NSString *)host;
+{
+    NSTimeInterval activeTime = [self activeTimeForHost:host];
+    if (activeTime <= 0)
+        return 0;
+    return [self byteCountForHost:host] / activeTime;
+}
+
+#pragma mark - Debugging
+
+- (NSString *)shortDescription;
+{
+    return [NSString stringWithFormat:@"<%@:%p %ld requested, %ld running>", NSStringFromClass([self class]), self, [_pendingRequests count], [_fileItemToRunningRequest count]];
+}
+
+#pragma mark - Private
+
+- (OFXFileItemTransfers *)_transfersOfKind:(OFXFileItemTransferKind)kind;
+{
+    switch (kind) {
+        case OFXFileItemUploadTransferKind:
+            return _uploadTransfers;
+        case OFXFileItemDownloadTransferKind:
+            return _downloadTransfers;
+        case OFXFileItemDeleteTransferKind:
+            return _deleteTransfers;
+    }
+    OBASSERT_NOT_REACHED("Unknown transfer kind %ld", kind);
+    return nil;
+}
+
+- (OFXTransferRequest *)_pendingRequestForFileItem:(OFXFileItem *)fileItem kind:(OFXFileItemTransferKind)kind;
+{
+    for (OFXTransferRequest *request in [_fileItemToPendingRequests objectForKey:fileItem]) {
+        if (request.kind == kind)
+            return request;
+    }
+    return nil;
+}
+
+- (NSUInteger)_indexOfPendingRequest:(OFXTransferRequest *)request;
+{
+    NSUInteger requestIndex = [_pendingRequests indexOfObject:request inSortedRange:NSMakeRange(0, [_pendingRequests count]) options:NSBinarySearchingFirstEqual usingComparator:^NSComparisonResult(OFXTransferRequest *request1, OFXTransferRequest *request2) {
+        return _compareRequests(request1, request2);
+    }];
+    OBASSERT(requestIndex != NSNotFound);
+    OBASSERT(requestIndex == NSNotFound || _pendingRequests[requestIndex] == request);
+    return requestIndex;
+}
+
+- (void)_insertPendingRequest:(OFXTransferRequest *)request;
+{
+    NSUInteger insertionIndex = [_pendingRequests indexOfObject:request inSortedRange:NSMakeRange(0, [_pendingRequests count]) options:NSBinarySearchingInsertionIndex usingComparator:^NSComparisonResult(OFXTransferRequest *request1, OFXTransferRequest *request2) {
+        return _compareRequests(request1, request2);
+    }];
+    [_pendingRequests insertObject:request atIndex:insertionIndex];
+}
+
+- (void)_removePendingRequest:(OFXTransferRequest *)request;
+{
+    NSUInteger requestIndex = [self _indexOfPendingRequest:request];
+    if (requestIndex != NSNotFound)
+        [_pendingRequests removeObjectAtIndex:requestIndex];
+
+    OFXFileItem *fileItem = request.fileItem;
+    NSMutableArray <OFXTransferRequest *> *fileItemRequests = [_fileItemToPendingRequests objectForKey:fileItem];
+    [fileItemRequests removeObjectIdenticalTo:request];
+    if ([fileItemRequests count] == 0)
+        [_fileItemToPendingRequests removeObjectForKey:fileItem];
+}
+
+@end
@@ -15,7 +15,8 @@
 
 @interface OFXUploadContentsFileSnapshot : OFXFileSnapshot
 
-- (instancetype)initWithTargetLocalSnapshotURL:(NSURL *)localTargetURL forUploadingVersionOfDocumentAtURL:(NSURL *)localDocumentURL localRelativePath:(NSString *)localRelativePath previousSnapshot:(OFXFileSnapshot *)previousSnapshot error:(NSError **)outError;
+// If chunked is set, large files get chunk lists in the Info.plist (see OFXContentChunking.h).
+- (instancetype)initWithTargetLocalSnapshotURL:(NSURL *)localTargetURL forUploadingVersionOfDocumentAtURL:(NSURL *)localDocumentURL localRelativePath:(NSString *)localRelativePath previousSnapshot:(OFXFileSnapshot *)previousSnapshot chunked:(BOOL)chunked error:(NSError **)outError;
 
 // Helpers for transfers
 - (BOOL)iterateFiles:(NSError **)outError withApplier:(BOOL (^)(NSURL *fileURL, NSString *hash, NSError **outError))applier;
@@ -10,6 +10,7 @@
 #import <OmniFoundation/NSFileManager-OFTemporaryPath.h>
 #import <OmniFoundation/NSFileCoordinator-OFExtensions.h>
 
+#import "OFXContentChunking.h"
 #import "OFXFileSnapshot-Internal.h"
 #import "OFXFileState.h"
 #import "OFXFileSnapshotContentsActions.h"
@@ -22,7 +23,7 @@ RCS_ID("$Id$")
     NSURL *_documentVersionContentsURL;
 }
 
-- (instancetype)initWithTargetLocalSnapshotURL:(NSURL *)localTargetURL forUploadingVersionOfDocumentAtURL:(NSURL *)localDocumentURL localRelativePath:(NSString *)localRelativePath previousSnapshot:(OFXFileSnapshot *)previousSnapshot error:(NSError **)outError;
+- (instancetype)initWithTargetLocalSnapshotURL:(NSURL *)localTargetURL forUploadingVersionOfDocumentAtURL:(NSURL *)localDocumentURL localRelativePath:(NSString *)localRelativePath previousSnapshot:(OFXFileSnapshot *)previousSnapshot chunked:(BOOL)chunked error:(NSError **)outError;
 {
     OBPRECONDITION(localDocumentURL);
     OBPRECONDITION([[[localDocumentURL absoluteURL] path] hasSuffix:([NSString stringWithFormat:@"/%@", localRelativePath])]);
@@ -189,6 +190,27 @@ RCS_ID("$Id$")
         return nil;
     }
     
+    if (chunked) {
+        NSDictionary *fileHashToChunks = OFXRecordChunks(contents, _documentVersionContentsURL, &error);
+        if (!fileHashToChunks) {
+            NSLog(@"Error recording chunks of file contents at %@: %@", _documentVersionContentsURL, [error toPropertyList]);
+            
+            [[NSFileManager defaultManager] removeItemAtURL:_documentVersionContentsURL error:NULL];
+            _documentVersionContentsURL = nil;
+            
+            [[NSFileManager defaultManager] removeItemAtURL:self.localSnapshotURL error:NULL];
+            
+            if (outError)
+                *outError = error;
+            OBChainError(outError);
+            return nil;
+        }
+        if ([fileHashToChunks count] > 0) {
+            infoDictionary[kOFXInfo_ChunksKey] = fileHashToChunks;
+            infoDictionary[kOFXInfo_ArchiveVersionKey] = @(kOFXInfo_ChunkedArchiveVersion);
+        }
+    }
+    
     if (![self _updateVersionDictionary:versionDictionary reason:@"init upload contents" error:outError])
         return nil;
     if (![self _updateInfoDictionary:infoDictionary error:outError])
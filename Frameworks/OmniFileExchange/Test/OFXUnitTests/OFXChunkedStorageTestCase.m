@@ -0,0 +1,104 @@
+// Copyright 2026 Omni Development, Inc. All rights reserved.
+//
+// This software may only be used and reproduced according to the
+// terms in the file OmniSourceLicense.html, which should be
+// distributed with this project and can also be found at
+// <http://www.omnigroup.com/developer/sourcecode/sourcelicense/>.
+
+#import "OFXTestCase.h"
+
+#import <OmniFileExchange/OFXAccountClientParameters.h>
+
+#import "OFXTrace.h"
+
+RCS_ID("$Id$")
+
+// Checks how many bytes go over the wire when one byte changes in a 100 MB package that both agents have downloaded, with and without chunked storage.
+@interface OFXChunkedStorageTestCase : OFXTestCase
+@end
+
+@implementation OFXChunkedStorageTestCase
+
+static const NSUInteger MemberCount = 10;
+static const NSUInteger MemberSize = 10*1024*1024;
+
+- (OFXAccountClientParameters *)accountClientParametersForAgentName:(NSString *)agentName;
+{
+    OFXAccountClientParameters *clientParameters = [super accountClientParametersForAgentName:agentName];
+
+    if (self.invocation.selector == @selector(testSmallEditOfLargePackageChunked))
+        clientParameters.chunkedStorage = YES;
+
+    return clientParameters;
+}
+
+static long long _sumOfTrace(NSString *tag)
+{
+    long long byteCount = 0;
+    for (NSNumber *value in OFXTraceCopy(tag))
+        byteCount += [value longLongValue];
+    return byteCount;
+}
+
+- (void)_editOneByteOfLargePackage:(long long *)outUploadedByteCount downloadedByteCount:(long long *)outDownloadedByteCount;
+{
+    OFXAgent *agentA = self.agentA;
+    OFXAgent *agentB = self.agentB;
+
+    OFXFileMetadata *uploadedMetadata = [self makeRandomPackageNamed:@"random.package" memberCount:MemberCount memberSize:MemberSize];
+
+    // Too big to download automatically, so ask for it.
+    OFXFileMetadata *metadataB = [self waitForFileMetadata:agentB where:^BOOL(OFXFileMetadata *metadata) {
+        return [metadata.fileIdentifier isEqual:uploadedMetadata.fileIdentifier];
+    }];
+    [self downloadWithMetadata:metadataB agent:agentB];
+
+    OFXTraceReset();
+
+    // Change a byte in the middle of one member.
+    NSURL *memberURL = [uploadedMetadata.fileURL URLByAppendingPathComponent:@"file-3"];
+    {
+        __autoreleasing NSError *error;
+        NSMutableData *data;
+        OBShouldNotError(data = [[self readDataFromURL:memberURL options:0 error:&error] mutableCopy]);
+
+        uint8_t *bytes = data.mutableBytes;
+        bytes[MemberSize/2] ^= 0xff;
+
+        OBShouldNotError([self writeData:data toURL:memberURL options:0 error:&error]);
+    }
+
+    [self waitForFileMetadata:agentA where:^BOOL(OFXFileMetadata *metadata) {
+        return ![metadata.editIdentifier isEqual:uploadedMetadata.editIdentifier] && metadata.uploaded;
+    }];
+    [self waitForAgentsEditsToAgree];
+    [self waitForFileMetadata:agentB where:^BOOL(OFXFileMetadata *metadata) {
+        return metadata.downloaded;
+    }];
+    [self requireAgentsToHaveSameFilesByName];
+
+    *outUploadedByteCount = _sumOfTrace(@"OFXFileSnapshotUploadContentsTransfer.bytes_uploaded");
+    *outDownloadedByteCount = _sumOfTrace(@"OFXFileSnapshotDownloadTransfer.bytes_downloaded");
+}
+
+- (void)testSmallEditOfLargePackage;
+{
+    long long uploadedByteCount, downloadedByteCount;
+    [self _editOneByteOfLargePackage:&uploadedByteCount downloadedByteCount:&downloadedByteCount];
+
+    // Unchanged members are copied on the server and found in the downloaded copy, so only the edited member should move.
+    XCTAssertLessThan(uploadedByteCount, 2*(long long)MemberSize);
+    XCTAssertLessThan(downloadedByteCount, 2*(long long)MemberSize);
+}
+
+- (void)testSmallEditOfLargePackageChunked;
+{
+    long long uploadedByteCount, downloadedByteCount;
+    [self _editOneByteOfLargePackage:&uploadedByteCount downloadedByteCount:&downloadedByteCount];
+
+    // Only the one or two chunks around the edit should move, each at most 4 MB.
+    XCTAssertLessThan(uploadedByteCount, (long long)MemberSize);
+    XCTAssertLessThan(downloadedByteCount, (long long)MemberSize);
+}
+
+@end
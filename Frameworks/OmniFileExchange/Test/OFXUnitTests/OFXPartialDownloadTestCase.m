@@ -0,0 +1,274 @@
+// Copyright 2026 Omni Development, Inc. All rights reserved.
+//
+// This software may only be used and reproduced according to the
+// terms in the file OmniSourceLicense.html, which should be
+// distributed with this project and can also be found at
+// <http://www.omnigroup.com/developer/sourcecode/sourcelicense/>.
+
+#import <OmniBase/OBTestCase.h>
+#import <OmniFoundation/OFRandom.h>
+
+#import "OFXPartialDownload.h"
+
+RCS_ID("$Id$")
+
+// Bookkeeping of OFXPartialDownload on its own; OFXResumedDownloadTestCase covers its use by the download transfer.
+@interface OFXPartialDownloadTestCase : OBTestCase
+@end
+
+@implementation OFXPartialDownloadTestCase
+{
+    NSURL *_directoryURL;
+}
+
+static NSString * const FileHash = @"file-hash";
+static const NSUInteger FileSize = 1000;
+
+- (void)setUp;
+{
+    [super setUp];
+
+    NSString *name = [NSString stringWithFormat:@"OFXPartialDownloadTestCase-%@", [[NSUUID UUID] UUIDString]];
+    _directoryURL = [[NSURL fileURLWithPath:NSTemporaryDirectory() isDirectory:YES] URLByAppendingPathComponent:name isDirectory:YES];
+}
+
+- (void)tearDown;
+{
+    [[NSFileManager defaultManager] removeItemAtURL:_directoryURL error:NULL];
+    _directoryURL = nil;
+
+    [super tearDown];
+}
+
+static NSArray <NSValue *> *_ranges(NSRange first, ...)
+{
+    NSMutableArray <NSValue *> *ranges = [NSMutableArray arrayWithObject:[NSValue valueWithRange:first]];
+
+    va_list args;
+    va_start(args, first);
+    NSRange range;
+    while ((range = va_arg(args, NSRange)).length > 0)
+        [ranges addObject:[NSValue valueWithRange:range]];
+    va_end(args);
+
+    return ranges;
+}
+#define RANGES(...) _ranges(__VA_ARGS__, NSMakeRange(0, 0))
+
+- (OFXPartialDownload *)_openPartialDownload;
+{
+    OFXPartialDownload *partialDownload = [[OFXPartialDownload alloc] initWithDirectoryURL:_directoryURL];
+
+    __autoreleasing NSError *error;
+    OBShouldNotError([partialDownload prepareFileWithHash:FileHash size:FileSize error:&error]);
+
+    return partialDownload;
+}
+
+- (NSURL *)_fileURL;
+{
+    return [_directoryURL URLByAppendingPathComponent:FileHash isDirectory:NO];
+}
+
+- (void)testRangeBookkeeping;
+{
+    OFXPartialDownload *partialDownload = [self _openPartialDownload];
+    NSRange wholeFile = NSMakeRange(0, FileSize);
+
+    XCTAssertEqualObjects([partialDownload missingRangesOfFileWithHash:FileHash inRange:wholeFile], RANGES(wholeFile));
+
+    [partialDownload addCompletedRange:NSMakeRange(100, 100) toFileWithHash:FileHash];
+    [partialDownload addCompletedRange:NSMakeRange(300, 100) toFileWithHash:FileHash];
+    XCTAssertEqualObjects([partialDownload missingRangesOfFileWithHash:FileHash inRange:wholeFile], RANGES(NSMakeRange(0, 100), NSMakeRange(200, 100), NSMakeRange(400, 600)));
+
+    // Only the part of the file that was asked about.
+    XCTAssertEqualObjects([partialDownload missingRangesOfFileWithHash:FileHash inRange:NSMakeRange(150, 200)], RANGES(NSMakeRange(200, 100)));
+    XCTAssertEqualObjects([partialDownload missingRangesOfFileWithHash:FileHash inRange:NSMakeRange(100, 100)], @[]);
+
+    // Adjacent and overlapping ranges merge.
+    [partialDownload addCompletedRange:NSMakeRange(150, 200) toFileWithHash:FileHash];
+    XCTAssertEqualObjects([partialDownload missingRangesOfFileWithHash:FileHash inRange:wholeFile], RANGES(NSMakeRange(0, 100), NSMakeRange(400, 600)));
+
+    [partialDownload removeCompletedRange:NSMakeRange(150, 10) fromFileWithHash:FileHash];
+    XCTAssertEqualObjects([partialDownload missingRangesOfFileWithHash:FileHash inRange:wholeFile], RANGES(NSMakeRange(0, 100), NSMakeRange(150, 10), NSMakeRange(400, 600)));
+
+    [partialDownload close];
+}
+
+- (void)testStateRoundTrip;
+{
+    NSData *data = OFRandomCreateDataOfLength(FileSize);
+    __autoreleasing NSError *error;
+
+    {
+        OFXPartialDownload *partialDownload = [self _openPartialDownload];
+
+        // Written out of order, as parallel range requests would.
+        OBShouldNotError([partialDownload writeData:[data subdataWithRange:NSMakeRange(600, 200)] toFileWithHash:FileHash atOffset:600 error:&error]);
+        [partialDownload addCompletedRange:NSMakeRange(600, 200) toFileWithHash:FileHash];
+        OBShouldNotError([partialDownload writeData:[data subdataWithRange:NSMakeRange(0, 100)] toFileWithHash:FileHash atOffset:0 error:&error]);
+        [partialDownload addCompletedRange:NSMakeRange(0, 100) toFileWithHash:FileHash];
+
+        [partialDownload setETag:@"\"etag-1\"" forObjectNamed:@"object-1"];
+        [partialDownload setETag:@"\"etag-2\"" forObjectNamed:@"object-2"];
+        [partialDownload setETag:nil forObjectNamed:@"object-2"];
+
+        OBShouldNotError([partialDownload saveState:&error]);
+        [partialDownload close];
+    }
+
+    OFXPartialDownload *partialDownload = [self _openPartialDownload];
+
+    XCTAssertEqualObjects([partialDownload missingRangesOfFileWithHash:FileHash inRange:NSMakeRange(0, FileSize)], RANGES(NSMakeRange(100, 500), NSMakeRange(800, 200)));
+    XCTAssertEqualObjects([partialDownload ETagForObjectNamed:@"object-1"], @"\"etag-1\"");
+    XCTAssertNil([partialDownload ETagForObjectNamed:@"object-2"]);
+
+    NSData *readData;
+    OBShouldNotError(readData = [partialDownload dataOfFileWithHash:FileHash range:NSMakeRange(600, 200) error:&error]);
+    XCTAssertEqualObjects(readData, [data subdataWithRange:NSMakeRange(600, 200)]);
+    OBShouldNotError(readData = [partialDownload dataOfFileWithHash:FileHash range:NSMakeRange(0, 100) error:&error]);
+    XCTAssertEqualObjects(readData, [data subdataWithRange:NSMakeRange(0, 100)]);
+
+    [partialDownload close];
+}
+
+- (void)testReopeningWithWrongSizeOnDiskStartsOver;
+{
+    __autoreleasing NSError *error;
+
+    {
+        OFXPartialDownload *partialDownload = [self _openPartialDownload];
+        OBShouldNotError([partialDownload writeData:OFRandomCreateDataOfLength(500) toFileWithHash:FileHash atOffset:0 error:&error]);
+        [partialDownload addCompletedRange:NSMakeRange(0, 500) toFileWithHash:FileHash];
+        [partialDownload setETag:@"\"etag\"" forObjectNamed:FileHash];
+        OBShouldNotError([partialDownload saveState:&error]);
+        [partialDownload close];
+    }
+
+    // Something else cut the file short, so the recorded ranges can't be trusted.
+    NSFileHandle *fileHandle;
+    OBShouldNotError(fileHandle = [NSFileHandle fileHandleForWritingToURL:[self _fileURL] error:&error]);
+    [fileHandle truncateFileAtOffset:200];
+    [fileHandle closeFile];
+
+    OFXPartialDownload *partialDownload = [self _openPartialDownload];
+    XCTAssertEqualObjects([partialDownload missingRangesOfFileWithHash:FileHash inRange:NSMakeRange(0, FileSize)], RANGES(NSMakeRange(0, FileSize)));
+
+    NSNumber *fileSize;
+    OBShouldNotError([[self _fileURL] getResourceValue:&fileSize forKey:NSURLFileSizeKey error:&error]);
+    XCTAssertEqual([fileSize unsignedIntegerValue], FileSize);
+
+    [partialDownload close];
+}
+
+- (void)testReopeningWithDifferentExpectedSizeStartsOver;
+{
+    __autoreleasing NSError *error;
+
+    {
+        OFXPartialDownload *partialDownload = [self _openPartialDownload];
+        [partialDownload addCompletedRange:NSMakeRange(0, 500) toFileWithHash:FileHash];
+        OBShouldNotError([partialDownload saveState:&error]);
+        [partialDownload close];
+    }
+
+    OFXPartialDownload *partialDownload = [[OFXPartialDownload alloc] initWithDirectoryURL:_directoryURL];
+    OBShouldNotError([partialDownload prepareFileWithHash:FileHash size:2*FileSize error:&error]);
+    XCTAssertEqualObjects([partialDownload missingRangesOfFileWithHash:FileHash inRange:NSMakeRange(0, 2*FileSize)], RANGES(NSMakeRange(0, 2*FileSize)));
+    [partialDownload close];
+}
+
+- (void)testUnreadableStateStartsOver;
+{
+    __autoreleasing NSError *error;
+
+    OBShouldNotError([[NSFileManager defaultManager] createDirectoryAtURL:_directoryURL withIntermediateDirectories:YES attributes:nil error:&error]);
+    OBShouldNotError([[@"not a property list" dataUsingEncoding:NSUTF8StringEncoding] writeToURL:[_directoryURL URLByAppendingPathComponent:@"State.plist"] options:0 error:&error]);
+
+    OFXPartialDownload *partialDownload = [self _openPartialDownload];
+    XCTAssertEqualObjects([partialDownload missingRangesOfFileWithHash:FileHash inRange:NSMakeRange(0, FileSize)], RANGES(NSMakeRange(0, FileSize)));
+    [partialDownload close];
+}
+
+- (void)testMoreFilesThanFileDescriptors;
+{
+    // More members than the default per-process limit on open files, written round-robin as interleaved range requests would.
+    const NSUInteger fileCount = 300;
+    const NSUInteger pieceLength = 10;
+    const NSUInteger pieceCount = 3;
+    __autoreleasing NSError *error;
+
+    OFXPartialDownload *partialDownload = [[OFXPartialDownload alloc] initWithDirectoryURL:_directoryURL];
+    for (NSUInteger fileIndex = 0; fileIndex < fileCount; fileIndex++)
+        OBShouldNotError([partialDownload prepareFileWithHash:[NSString stringWithFormat:@"file-%lu", fileIndex] size:pieceLength * pieceCount error:&error]);
+    XCTAssertEqual(partialDownload.openFileCount, 0UL);
+
+    NSMutableDictionary <NSString *, NSData *> *contents = [NSMutableDictionary dictionary];
+    for (NSUInteger fileIndex = 0; fileIndex < fileCount; fileIndex++)
+        contents[[NSString stringWithFormat:@"file-%lu", fileIndex]] = OFRandomCreateDataOfLength(pieceLength * pieceCount);
+
+    for (NSUInteger pieceIndex = 0; pieceIndex < pieceCount; pieceIndex++) {
+        NSRange range = NSMakeRange(pieceIndex * pieceLength, pieceLength);
+        for (NSUInteger fileIndex = 0; fileIndex < fileCount; fileIndex++) {
+            NSString *fileHash = [NSString stringWithFormat:@"file-%lu", fileIndex];
+            OBShouldNotError([partialDownload writeData:[contents[fileHash] subdataWithRange:range] toFileWithHash:fileHash atOffset:range.location error:&error]);
+            [partialDownload addCompletedRange:range toFileWithHash:fileHash];
+        }
+        XCTAssertLessThan(partialDownload.openFileCount, fileCount);
+    }
+
+    [contents enumerateKeysAndObjectsUsingBlock:^(NSString *fileHash, NSData *data, BOOL *stop) {
+        [partialDownload finishFileWithHash:fileHash];
+
+        __autoreleasing NSError *readError;
+        NSData *readData;
+        OBShouldNotError(readData = [partialDownload dataOfFileWithHash:fileHash range:NSMakeRange(0, [data length]) error:&readError]);
+        XCTAssertEqualObjects(readData, data, @"%@", fileHash);
+    }];
+    XCTAssertEqual(partialDownload.openFileCount, 0UL);
+    XCTAssertEqual(partialDownload.finishedFileCount, fileCount);
+
+    [partialDownload close];
+}
+
+- (void)testFinishedFilesStayUntilMoved;
+{
+    NSData *data = OFRandomCreateDataOfLength(FileSize);
+    __autoreleasing NSError *error;
+
+    {
+        OFXPartialDownload *partialDownload = [self _openPartialDownload];
+        OBShouldNotError([partialDownload writeData:data toFileWithHash:FileHash atOffset:0 error:&error]);
+        [partialDownload addCompletedRange:NSMakeRange(0, FileSize) toFileWithHash:FileHash];
+        [partialDownload finishFileWithHash:FileHash];
+        XCTAssertEqual(partialDownload.finishedFileCount, 1UL);
+
+        // The transfer fails before it gets to move anything.
+        OBShouldNotError([partialDownload saveState:&error]);
+        [partialDownload close];
+    }
+
+    XCTAssertEqualObjects([NSData dataWithContentsOfURL:[self _fileURL]], data);
+
+    // The next attempt finds all of it.
+    OFXPartialDownload *partialDownload = [self _openPartialDownload];
+    XCTAssertEqualObjects([partialDownload missingRangesOfFileWithHash:FileHash inRange:NSMakeRange(0, FileSize)], @[]);
+    [partialDownload finishFileWithHash:FileHash];
+
+    // The same contents can be at more than one place in a package.
+    NSURL *destinationDirectoryURL = [_directoryURL URLByAppendingPathComponent:@"Destination" isDirectory:YES];
+    OBShouldNotError([[NSFileManager defaultManager] createDirectoryAtURL:destinationDirectoryURL withIntermediateDirectories:NO attributes:nil error:&error]);
+    NSURL *firstURL = [destinationDirectoryURL URLByAppendingPathComponent:@"first" isDirectory:NO];
+    NSURL *secondURL = [destinationDirectoryURL URLByAppendingPathComponent:@"second" isDirectory:NO];
+
+    OBShouldNotError([partialDownload moveFinishedFilesToURLs:@{FileHash:@[firstURL, secondURL]} error:&error]);
+    XCTAssertEqual(partialDownload.finishedFileCount, 0UL);
+    XCTAssertEqualObjects([NSData dataWithContentsOfURL:firstURL], data);
+    XCTAssertEqualObjects([NSData dataWithContentsOfURL:secondURL], data);
+    XCTAssertFalse([[self _fileURL] checkResourceIsReachableAndReturnError:NULL]);
+
+    [partialDownload remove];
+    XCTAssertFalse([_directoryURL checkResourceIsReachableAndReturnError:NULL]);
+}
+
+@end
@@ -0,0 +1,446 @@
+// Copyright 2026 Omni Development, Inc. All rights reserved.
+//
+// This software may only be used and reproduced according to the
+// terms in the file OmniSourceLicense.html, which should be
+// distributed with this project and can also be found at
+// <http://www.omnigroup.com/developer/sourcecode/sourcelicense/>.
+
+#import "OFXTestCase.h"
+
+#import <OmniDAV/ODAVConnection.h>
+#import <OmniDAV/ODAVOperation.h>
+#import <OmniFoundation/OFPreference.h>
+
+#import "OFXPartialDownload.h"
+#import "OFXServerAccountRegistry-Internal.h"
+#import "OFXTrace.h"
+
+RCS_ID("$Id$")
+
+// Ranged downloads of snapshot contents: resuming from PartialDownloads, and recovering when the server or the connection misbehaves. The misbehavior is injected by wrapping the GET operations that OFXFileSnapshotDownloadTransfer makes.
+
+typedef NS_ENUM(NSUInteger, OFXDownloadFault) {
+    OFXDownloadFaultNone,
+    OFXDownloadFaultIgnoreRange, // Every GET is sent without its Range header, as a server without range support would see it.
+    OFXDownloadFaultStaleETag, // The first GET is sent with an If-Match that can't match, so it fails with a 412.
+    OFXDownloadFaultChangedETag, // The first GET that has an ETag gets a response with a different one.
+    OFXDownloadFaultTruncate, // The first ranged GET ends cleanly after half of its bytes.
+};
+
+static OFXDownloadFault Fault;
+static BOOL FaultApplied;
+static NSString *ExpectedRetryRange;
+static NSMutableArray <NSDictionary *> *Requests;
+static IMP OriginalGetContents;
+
+static NSString * const RequestRangeKey = @"Range";
+static NSString * const RequestETagKey = @"ETag";
+static NSString * const StaleETag = @"\"ofx-test-stale\"";
+static NSString * const ChangedETag = @"\"ofx-test-changed\"";
+
+static const NSUInteger FlatFileSize = 1024*1024;
+
+@interface OFXFaultyDownloadOperation : NSProxy
+- initWithOperation:(ODAVOperation *)operation truncateAfterLength:(NSUInteger)truncateAfterLength changedETag:(NSString *)changedETag;
+@end
+
+@implementation OFXFaultyDownloadOperation
+{
+    ODAVOperation *_operation;
+    NSUInteger _truncateAfterLength;
+    NSString *_changedETag;
+
+    NSUInteger _receivedLength;
+    BOOL _truncated;
+    void (^_didFinish)(id <ODAVAsynchronousOperation> op, NSError *errorOrNil);
+}
+
+- initWithOperation:(ODAVOperation *)operation truncateAfterLength:(NSUInteger)truncateAfterLength changedETag:(NSString *)changedETag;
+{
+    // No -[super init] for NSProxy.
+    _operation = operation;
+    _truncateAfterLength = truncateAfterLength;
+    _changedETag = [changedETag copy];
+    return self;
+}
+
+// The operation's callbacks keep us alive until it finishes and drops them.
+- (void)setDidFinish:(void (^)(id <ODAVAsynchronousOperation> op, NSError *errorOrNil))didFinish;
+{
+    _didFinish = [didFinish copy];
+
+    OFXFaultyDownloadOperation *proxy = self;
+    _operation.didFinish = ^(id <ODAVAsynchronousOperation> op, NSError *errorOrNil){
+        if (proxy->_truncated)
+            return; // Already reported as finished
+        proxy->_didFinish(proxy, errorOrNil);
+    };
+}
+
+- (void)setDidReceiveData:(void (^)(id <ODAVAsynchronousOperation> op, NSData *data))didReceiveData;
+{
+    didReceiveData = [didReceiveData copy];
+
+    OFXFaultyDownloadOperation *proxy = self;
+    _operation.didReceiveData = ^(id <ODAVAsynchronousOperation> op, NSData *data){
+        if (proxy->_truncated)
+            return;
+
+        if (proxy->_truncateAfterLength != NSNotFound && proxy->_receivedLength + [data length] >= proxy->_truncateAfterLength) {
+            // Like a connection that closes early without reporting an error.
+            proxy->_truncated = YES;
+            NSData *head = [data subdataWithRange:NSMakeRange(0, proxy->_truncateAfterLength - proxy->_receivedLength)];
+            if ([head length] > 0)
+                didReceiveData(proxy, head);
+            proxy->_didFinish(proxy, nil);
+            [proxy->_operation cancel];
+            return;
+        }
+
+        proxy->_receivedLength += [data length];
+        didReceiveData(proxy, data);
+    };
+}
+
+- (NSString *)valueForResponseHeader:(NSString *)header;
+{
+    if (_changedETag && [header caseInsensitiveCompare:@"ETag"] == NSOrderedSame)
+        return _changedETag;
+    return [_operation valueForResponseHeader:header];
+}
+
+- (NSMethodSignature *)methodSignatureForSelector:(SEL)sel;
+{
+    return [_operation methodSignatureForSelector:sel];
+}
+
+- (void)forwardInvocation:(NSInvocation *)invocation;
+{
+    [invocation invokeWithTarget:_operation];
+}
+
+@end
+
+@implementation ODAVConnection (OFXResumedDownloadTestCase)
+
+- (ODAVOperation *)OFXResumedDownloadTestCase_asynchronousGetContentsOfURL:(NSURL *)url withETag:(NSString *)ETag range:(NSString *)range;
+{
+    NSUInteger truncateAfterLength = NSNotFound;
+    NSString *changedETag = nil;
+    NSString *requestedRange = range;
+
+    @synchronized(Requests) {
+        switch (Fault) {
+            case OFXDownloadFaultNone:
+                break;
+            case OFXDownloadFaultIgnoreRange:
+                range = nil;
+                break;
+            case OFXDownloadFaultStaleETag:
+                if (!FaultApplied) {
+                    FaultApplied = YES;
+                    ETag = StaleETag;
+                }
+                break;
+            case OFXDownloadFaultChangedETag:
+                if (!FaultApplied && ETag) {
+                    FaultApplied = YES;
+                    changedETag = ChangedETag;
+                }
+                break;
+            case OFXDownloadFaultTruncate:
+                if (!FaultApplied && range) {
+                    unsigned long long firstByte, lastByte;
+                    NSScanner *scanner = [NSScanner scannerWithString:range];
+                    if ([scanner scanString:@"bytes=" intoString:NULL] && [scanner scanUnsignedLongLong:&firstByte] && [scanner scanString:@"-" intoString:NULL] && [scanner scanUnsignedLongLong:&lastByte]) {
+                        FaultApplied = YES;
+                        truncateAfterLength = (NSUInteger)(lastByte - firstByte + 1) / 2;
+                        ExpectedRetryRange = [NSString stringWithFormat:@"bytes=%llu-%llu", firstByte + truncateAfterLength, lastByte];
+                    }
+                }
+                break;
+        }
+
+        // What the transfer asked for, except for an ETag we replaced.
+        [Requests addObject:@{RequestRangeKey:(requestedRange ? requestedRange : (id)[NSNull null]), RequestETagKey:(ETag ? ETag : (id)[NSNull null])}];
+    }
+
+    ODAVOperation *operation = ((ODAVOperation *(*)(id, SEL, NSURL *, NSString *, NSString *))OriginalGetContents)(self, @selector(asynchronousGetContentsOfURL:withETag:range:), url, ETag, range);
+    if (truncateAfterLength != NSNotFound || changedETag)
+        operation = (ODAVOperation *)[[OFXFaultyDownloadOperation alloc] initWithOperation:operation truncateAfterLength:truncateAfterLength changedETag:changedETag];
+    return operation;
+}
+
+@end
+
+@interface OFXResumedDownloadTestCase : OFXTestCase
+@end
+
+@implementation OFXResumedDownloadTestCase
+
+static void _setConfigurationValue(NSString *key, double value)
+{
+    for (OFConfigurationValue *configurationValue in [OFConfigurationValue configurationValues]) {
+        if ([configurationValue.key isEqual:key]) {
+            [configurationValue setValueFromDouble:value];
+            return;
+        }
+    }
+    OBASSERT_NOT_REACHED("Unknown configuration value %@", key);
+}
+
+static long long _bytesDownloaded(void)
+{
+    long long byteCount = 0;
+    for (NSNumber *value in OFXTraceCopy(@"OFXFileSnapshotDownloadTransfer.bytes_downloaded"))
+        byteCount += [value longLongValue];
+    return byteCount;
+}
+
+static NSArray <NSDictionary *> *_requests(void)
+{
+    @synchronized(Requests) {
+        return [Requests copy];
+    }
+}
+
+- (BOOL)automaticallyDownloadFileContents;
+{
+    return NO; // Each test asks for the download it wants to watch.
+}
+
+- (void)setUp;
+{
+    Fault = OFXDownloadFaultNone;
+    FaultApplied = NO;
+    ExpectedRetryRange = nil;
+    Requests = [NSMutableArray array];
+    OriginalGetContents = OBReplaceMethodImplementationWithSelector([ODAVConnection class], @selector(asynchronousGetContentsOfURL:withETag:range:), @selector(OFXResumedDownloadTestCase_asynchronousGetContentsOfURL:withETag:range:));
+
+    // The smallest allowed, so that a modest file takes many reads.
+    _setConfigurationValue(@"OFXDownloadRangeSize", 64*1024);
+
+    [super setUp];
+}
+
+- (void)tearDown;
+{
+    [super tearDown];
+
+    OBReplaceMethodImplementation([ODAVConnection class], @selector(asynchronousGetContentsOfURL:withETag:range:), OriginalGetContents);
+    OriginalGetContents = NULL;
+    [OFConfigurationValue restoreAllConfigurationValuesToDefaults];
+}
+
+- (void)_downloadFlatFileWithFault:(OFXDownloadFault)fault;
+{
+    OFXFileMetadata *uploadedMetadata = [self makeRandomFlatFile:@"random.data" withSize:FlatFileSize];
+    OFXFileMetadata *metadata = [self waitForFileMetadata:self.agentB where:^BOOL(OFXFileMetadata *candidate) {
+        return OFISEQUAL(candidate.fileIdentifier, uploadedMetadata.fileIdentifier);
+    }];
+
+    @synchronized(Requests) {
+        Fault = fault;
+        [Requests removeAllObjects];
+    }
+    OFXTraceReset();
+
+    [self downloadWithMetadata:metadata agent:self.agentB];
+    [self requireAgentsToHaveSameFilesByName];
+}
+
+static NSUInteger _indexOfWholeObjectRequest(NSArray <NSDictionary *> *requests, NSUInteger startIndex)
+{
+    for (NSUInteger requestIndex = startIndex; requestIndex < [requests count]; requestIndex++) {
+        NSDictionary *request = requests[requestIndex];
+        if (OFISNULL(request[RequestRangeKey]) && OFISNULL(request[RequestETagKey]))
+            return requestIndex;
+    }
+    return NSNotFound;
+}
+
+- (void)testRangedDownload;
+{
+    [self _downloadFlatFileWithFault:OFXDownloadFaultNone];
+
+    NSArray <NSDictionary *> *requests = _requests();
+    XCTAssertEqual([requests count], FlatFileSize / (64*1024));
+    for (NSDictionary *request in requests)
+        XCTAssertFalse(OFISNULL(request[RequestRangeKey]));
+    XCTAssertEqual(_bytesDownloaded(), (long long)FlatFileSize);
+}
+
+- (void)testServerIgnoringRangeFallsBackToWholeObjectGets;
+{
+    [self _downloadFlatFileWithFault:OFXDownloadFaultIgnoreRange];
+
+    // Only the first batch of concurrent reads asks for a range before the first whole-object response turns ranges off.
+    NSArray <NSDictionary *> *requests = _requests();
+    NSUInteger rangedRequestCount = 0;
+    for (NSDictionary *request in requests) {
+        if (!OFISNULL(request[RequestRangeKey]))
+            rangedRequestCount++;
+    }
+    XCTAssertGreaterThan(rangedRequestCount, 0UL);
+    XCTAssertLessThanOrEqual(rangedRequestCount, 4UL);
+    XCTAssertNotEqual(_indexOfWholeObjectRequest(requests, 0), NSNotFound);
+}
+
+- (void)testPreconditionFailureRestartsObject;
+{
+    [self _downloadFlatFileWithFault:OFXDownloadFaultStaleETag];
+
+    NSArray <NSDictionary *> *requests = _requests();
+    XCTAssertEqualObjects(requests[0][RequestETagKey], StaleETag);
+    XCTAssertNotEqual(_indexOfWholeObjectRequest(requests, 1), NSNotFound, @"A 412 should restart the object with a plain GET");
+}
+
+- (void)testChangedETagRestartsObject;
+{
+    [self _downloadFlatFileWithFault:OFXDownloadFaultChangedETag];
+
+    NSArray <NSDictionary *> *requests = _requests();
+    NSUInteger changedIndex = [requests indexOfObjectPassingTest:^BOOL(NSDictionary *request, NSUInteger requestIndex, BOOL *stop) {
+        return !OFISNULL(request[RequestETagKey]);
+    }];
+    XCTAssertNotEqual(changedIndex, NSNotFound);
+    XCTAssertNotEqual(_indexOfWholeObjectRequest(requests, changedIndex + 1), NSNotFound, @"A new ETag should restart the object with a plain GET");
+
+    // The bytes from before the restart were thrown away and fetched again.
+    XCTAssertGreaterThan(_bytesDownloaded(), (long long)FlatFileSize);
+}
+
+- (void)testTruncatedReadIsRetriedFromWhereItStopped;
+{
+    [self _downloadFlatFileWithFault:OFXDownloadFaultTruncate];
+
+    XCTAssertNotNil(ExpectedRetryRange);
+    NSArray <NSDictionary *> *requests = _requests();
+    NSUInteger retryIndex = [requests indexOfObjectPassingTest:^BOOL(NSDictionary *request, NSUInteger requestIndex, BOOL *stop) {
+        return OFISEQUAL(request[RequestRangeKey], ExpectedRetryRange);
+    }];
+    XCTAssertNotEqual(retryIndex, NSNotFound, @"Expected a retry of %@ in %@", ExpectedRetryRange, requests);
+
+    // Nothing was fetched twice.
+    XCTAssertEqual(_bytesDownloaded(), (long long)FlatFileSize);
+}
+
+#pragma mark - Resuming a package
+
+- (NSURL *)_partialDownloadURLForFileIdentifier:(NSString *)fileIdentifier agent:(OFXAgent *)agent;
+{
+    OFXServerAccountRegistry *registry = agent.accountRegistry;
+    NSURL *storeURL = [registry localStoreURLForAccount:[registry.validCloudSyncAccounts lastObject]];
+
+    for (NSURL *url in [[NSFileManager defaultManager] enumeratorAtURL:storeURL includingPropertiesForKeys:nil options:0 errorHandler:nil]) {
+        if ([[url lastPathComponent] isEqual:fileIdentifier] && [[[url URLByDeletingLastPathComponent] lastPathComponent] isEqual:@"PartialDownloads"])
+            return url;
+    }
+    return nil;
+}
+
+// Starts downloading a large package on B, pauses B partway through and returns what the partial download has kept.
+- (OFXFileMetadata *)_pausePackageDownload:(NSURL **)outPartialDownloadURL completedByteCount:(long long *)outCompletedByteCount totalByteCount:(long long *)outTotalByteCount finishedMemberHashes:(NSArray <NSString *> **)outFinishedMemberHashes;
+{
+    [OFConfigurationValue restoreAllConfigurationValuesToDefaults]; // Ranges of 64KB would make this very slow
+
+    OFXFileMetadata *uploadedMetadata = [self makeRandomLargePackage:@"random.package"];
+    OFXAgent *agentB = self.agentB;
+
+    [self downloadFileWithIdentifier:uploadedMetadata.fileIdentifier untilPercentage:0.5 agent:agentB];
+    agentB.syncSchedule = OFXSyncScheduleNone;
+    [self waitForFileMetadata:agentB where:^BOOL(OFXFileMetadata *metadata) {
+        return OFISEQUAL(metadata.fileIdentifier, uploadedMetadata.fileIdentifier) && metadata.downloading == NO && metadata.percentDownloaded == 0;
+    }];
+
+    NSURL *partialDownloadURL = [self _partialDownloadURLForFileIdentifier:uploadedMetadata.fileIdentifier agent:agentB];
+    XCTAssertNotNil(partialDownloadURL, @"A cancelled download should leave its partial download behind");
+
+    __autoreleasing NSError *error;
+    NSArray <NSURL *> *fileURLs;
+    OBShouldNotError(fileURLs = [[NSFileManager defaultManager] contentsOfDirectoryAtURL:partialDownloadURL includingPropertiesForKeys:@[NSURLFileSizeKey] options:0 error:&error]);
+
+    OFXPartialDownload *partialDownload = [[OFXPartialDownload alloc] initWithDirectoryURL:partialDownloadURL];
+    long long completedByteCount = 0, totalByteCount = 0;
+    NSMutableArray <NSString *> *finishedMemberHashes = [NSMutableArray array];
+    for (NSURL *fileURL in fileURLs) {
+        NSString *fileHash = [fileURL lastPathComponent];
+        if ([fileHash isEqual:@"State.plist"])
+            continue;
+
+        NSNumber *fileSize;
+        OBShouldNotError([fileURL getResourceValue:&fileSize forKey:NSURLFileSizeKey error:&error]);
+
+        NSUInteger missingByteCount = 0;
+        for (NSValue *rangeValue in [partialDownload missingRangesOfFileWithHash:fileHash inRange:NSMakeRange(0, [fileSize unsignedIntegerValue])])
+            missingByteCount += [rangeValue rangeValue].length;
+
+        completedByteCount += [fileSize longLongValue] - missingByteCount;
+        if (missingByteCount == 0)
+            [finishedMemberHashes addObject:fileHash];
+    }
+    for (NSURL *memberURL in [[NSFileManager defaultManager] enumeratorAtURL:uploadedMetadata.fileURL includingPropertiesForKeys:nil options:0 errorHandler:nil]) {
+        NSNumber *fileSize;
+        if ([memberURL getResourceValue:&fileSize forKey:NSURLFileSizeKey error:NULL] && fileSize)
+            totalByteCount += [fileSize longLongValue];
+    }
+
+    // Members that were finished before the pause must not have been moved out and lost.
+    XCTAssertGreaterThan([finishedMemberHashes count], 0UL);
+    XCTAssertLessThan(completedByteCount, totalByteCount);
+
+    *outPartialDownloadURL = partialDownloadURL;
+    *outCompletedByteCount = completedByteCount;
+    *outTotalByteCount = totalByteCount;
+    *outFinishedMemberHashes = finishedMemberHashes;
+    return uploadedMetadata;
+}
+
+- (void)_resumeDownloadOfMetadata:(OFXFileMetadata *)uploadedMetadata;
+{
+    OFXTraceReset();
+    self.agentB.syncSchedule = OFXSyncScheduleAutomatic;
+    [self waitForFileMetadata:self.agentB where:^BOOL(OFXFileMetadata *metadata) {
+        return OFISEQUAL(metadata.fileIdentifier, uploadedMetadata.fileIdentifier) && metadata.downloading == NO && metadata.downloaded;
+    }];
+    [self requireAgentsToHaveSameFilesByName];
+}
+
+- (void)testResumedPackageKeepsFinishedMembers;
+{
+    NSURL *partialDownloadURL;
+    long long completedByteCount, totalByteCount;
+    NSArray <NSString *> *finishedMemberHashes;
+    OFXFileMetadata *uploadedMetadata = [self _pausePackageDownload:&partialDownloadURL completedByteCount:&completedByteCount totalByteCount:&totalByteCount finishedMemberHashes:&finishedMemberHashes];
+
+    [self _resumeDownloadOfMetadata:uploadedMetadata];
+
+    long long bytesDownloaded = _bytesDownloaded();
+    XCTAssertGreaterThan(bytesDownloaded, 0);
+    XCTAssertLessThanOrEqual(bytesDownloaded, totalByteCount - completedByteCount);
+    XCTAssertFalse([partialDownloadURL checkResourceIsReachableAndReturnError:NULL]);
+}
+
+- (void)testResumedMemberWithWrongHashIsFetchedAgain;
+{
+    NSURL *partialDownloadURL;
+    long long completedByteCount, totalByteCount;
+    NSArray <NSString *> *finishedMemberHashes;
+    OFXFileMetadata *uploadedMetadata = [self _pausePackageDownload:&partialDownloadURL completedByteCount:&completedByteCount totalByteCount:&totalByteCount finishedMemberHashes:&finishedMemberHashes];
+
+    // Flip a byte in a finished member, as if the disk had corrupted it.
+    NSURL *corruptedURL = [partialDownloadURL URLByAppendingPathComponent:[finishedMemberHashes firstObject] isDirectory:NO];
+    NSMutableData *contents = [NSMutableData dataWithContentsOfURL:corruptedURL];
+    XCTAssertGreaterThan([contents length], 0UL);
+    ((uint8_t *)[contents mutableBytes])[[contents length] / 2] ^= 0xff;
+
+    __autoreleasing NSError *error;
+    OBShouldNotError([contents writeToURL:corruptedURL options:0 error:&error]);
+
+    [self _resumeDownloadOfMetadata:uploadedMetadata];
+
+    long long bytesDownloaded = _bytesDownloaded();
+    XCTAssertGreaterThanOrEqual(bytesDownloaded, totalByteCount - completedByteCount + (long long)[contents length], @"The corrupted member should have been fetched again");
+}
+
+@end
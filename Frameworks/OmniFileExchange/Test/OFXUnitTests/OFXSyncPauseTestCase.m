@@ -7,6 +7,8 @@
 
 #import "OFXTestCase.h"
 
+#import "OFXTrace.h"
+
 RCS_ID("$Id$")
 
 @interface OFXInterruptSyncTestCase : OFXTestCase
@@ -135,11 +137,21 @@ RCS_ID("$Id$")
     }
     
     // Turn syncing back on. Since we'd previously requested that the file download, it will restart (bug? should we clear this in OFXFileItem when sync is turned off?)
+    OFXTraceReset();
     [self enableAgent:agentB];
     [self waitForFileMetadata:agentB where:^BOOL(OFXFileMetadata *metadata) {
         return (metadata.downloading == NO && metadata.percentDownloaded >= 1);
     }];
     
+    // The restarted download should have picked up where the first one left off.
+    {
+        long long bytesDownloaded = 0;
+        for (NSNumber *byteCount in OFXTraceCopy(@"OFXFileSnapshotDownloadTransfer.bytes_downloaded"))
+            bytesDownloaded += [byteCount longLongValue];
+        XCTAssertGreaterThan(bytesDownloaded, 0);
+        XCTAssertLessThan(bytesDownloaded, (long long)[randomText length]);
+    }
+    
     // Check that the contents are the same.
     {
         OFXServerAccount *account = [agentB.accountRegistry.validCloudSyncAccounts lastObject];
@@ -0,0 +1,79 @@
+// Copyright 2026 Omni Development, Inc. All rights reserved.
+//
+// This software may only be used and reproduced according to the
+// terms in the file OmniSourceLicense.html, which should be
+// distributed with this project and can also be found at
+// <http://www.omnigroup.com/developer/sourcecode/sourcelicense/>.
+
+#import "OFXTestCase.h"
+
+#import <OmniFileExchange/OFXAccountClientParameters.h>
+
+RCS_ID("$Id$")
+
+// Uploads a batch of small files with latency added to the start of each transfer, so the test server behaves like one on the far side of a slow link.
+@interface OFXTransferConcurrencyTestCase : OFXTestCase
+@end
+
+@implementation OFXTransferConcurrencyTestCase
+
+static const NSUInteger FileCount = 16;
+static const NSTimeInterval SimulatedLatency = 0.25;
+
+- (NSSet *)automaticallyStartedAgentNames;
+{
+    return [NSSet setWithObject:@"A"];
+}
+
+- (OFXAccountClientParameters *)accountClientParametersForAgentName:(NSString *)agentName;
+{
+    OFXAccountClientParameters *clientParameters = [super accountClientParametersForAgentName:agentName];
+
+    clientParameters.simulatedTransferLatency = SimulatedLatency;
+    if (self.invocation.selector == @selector(testUploadSpeedOneAtATime)) {
+        clientParameters.maximumTransferCount = 1;
+        clientParameters.maximumTransferCountPerContainer = 1;
+    }
+
+    return clientParameters;
+}
+
+- (void)_measureUploads;
+{
+    OFXAgent *agent = self.agentA;
+    OFXServerAccount *account = [self singleAccountInAgent:agent];
+
+    __block NSUInteger round = 0;
+    [self measureMetrics:[[self class] defaultPerformanceMetrics] automaticallyStartMeasuring:NO forBlock:^{
+        NSUInteger expectedCount = (round + 1) * FileCount;
+
+        [self startMeasuring];
+        for (NSUInteger fileIndex = 0; fileIndex < FileCount; fileIndex++)
+            [self copyRandomTextFileOfLength:1024 toPath:[NSString stringWithFormat:@"round%lu-file%lu.txt", round, fileIndex] ofAccount:account];
+
+        [self waitForFileMetadataItems:agent where:^BOOL(NSSet *metadataItems) {
+            if ([metadataItems count] != expectedCount)
+                return NO;
+            for (OFXFileMetadata *metadata in metadataItems) {
+                if (!metadata.uploaded)
+                    return NO;
+            }
+            return YES;
+        }];
+        [self stopMeasuring];
+
+        round++;
+    }];
+}
+
+- (void)testUploadSpeedOneAtATime;
+{
+    [self _measureUploads];
+}
+
+- (void)testUploadSpeedConcurrently;
+{
+    [self _measureUploads];
+}
+
+@end
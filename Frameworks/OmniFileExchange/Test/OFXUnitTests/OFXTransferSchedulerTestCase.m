@@ -0,0 +1,353 @@
+// Copyright 2026 Omni Development, Inc. All rights reserved.
+//
+// This software may only be used and reproduced according to the
+// terms in the file OmniSourceLicense.html, which should be
+// distributed with this project and can also be found at
+// <http://www.omnigroup.com/developer/sourcecode/sourcelicense/>.
+
+#import <OmniBase/OBTestCase.h>
+#import <OmniFileExchange/OFXAccountClientParameters.h>
+#import <OmniFileExchange/OFXAgent.h>
+
+#import "OFXTransferScheduler.h"
+
+RCS_ID("$Id$")
+
+// OFXTransferScheduler on its own, with stand-ins for the few file item, file state and container properties it looks at. OFXTransferConcurrencyTestCase covers its use by a running agent.
+
+@interface OFXSchedulerTestFileState : NSObject
+@property(nonatomic) BOOL missing;
+@property(nonatomic) BOOL userMoved;
+@end
+@implementation OFXSchedulerTestFileState
+@end
+
+@interface OFXSchedulerTestContainer : NSObject
+@property(nonatomic,copy) NSString *identifier;
+@end
+@implementation OFXSchedulerTestContainer
+@end
+
+@interface OFXSchedulerTestFileItem : NSObject
+@property(nonatomic,copy) NSString *name;
+@property(nonatomic,strong) OFXSchedulerTestContainer *container;
+@property(nonatomic,strong) OFXSchedulerTestFileState *localState;
+@property(nonatomic) BOOL contentsRequested;
+@property(nonatomic) BOOL contentsRequestedByUser;
+@property(nonatomic) unsigned long long totalSize;
+@end
+@implementation OFXSchedulerTestFileItem
+- (NSString *)description;
+{
+    return _name;
+}
+@end
+
+@interface OFXTransferSchedulerTestCase : OBTestCase
+@end
+
+@implementation OFXTransferSchedulerTestCase
+{
+    NSMutableDictionary <NSString *, OFXSchedulerTestContainer *> *_containers;
+}
+
+- (void)setUp;
+{
+    [super setUp];
+    _containers = [NSMutableDictionary dictionary];
+}
+
+- (OFXFileItem *)_fileItemNamed:(NSString *)name container:(NSString *)containerIdentifier size:(unsigned long long)size;
+{
+    OFXSchedulerTestContainer *container = _containers[containerIdentifier];
+    if (!container) {
+        container = [OFXSchedulerTestContainer new];
+        container.identifier = containerIdentifier;
+        _containers[containerIdentifier] = container;
+    }
+
+    OFXSchedulerTestFileItem *fileItem = [OFXSchedulerTestFileItem new];
+    fileItem.name = name;
+    fileItem.container = container;
+    fileItem.localState = [OFXSchedulerTestFileState new];
+    fileItem.contentsRequested = YES;
+    fileItem.totalSize = size;
+    return (OFXFileItem *)fileItem;
+}
+
+- (OFXFileItem *)_fileItemNamed:(NSString *)name size:(unsigned long long)size;
+{
+    return [self _fileItemNamed:name container:@"container" size:size];
+}
+
+static OFXSchedulerTestFileItem *_testItem(OFXFileItem *fileItem)
+{
+    return (OFXSchedulerTestFileItem *)fileItem;
+}
+
+// A download of contents the user asked for and doesn't have yet.
+- (OFXFileItem *)_userRequestedDownloadNamed:(NSString *)name size:(unsigned long long)size;
+{
+    OFXFileItem *fileItem = [self _fileItemNamed:name size:size];
+    _testItem(fileItem).localState.missing = YES;
+    _testItem(fileItem).contentsRequestedByUser = YES;
+    return fileItem;
+}
+
+// Starts whatever the scheduler will start, without finishing any of it, returning the file item names in order.
+static NSArray <NSString *> *_startAll(OFXTransferScheduler *scheduler)
+{
+    NSMutableArray <NSString *> *names = [NSMutableArray array];
+    OFXFileItemTransferKind kind;
+    OFXFileItem *fileItem;
+    while ((fileItem = [scheduler nextRequestedFileItem:&kind])) {
+        [names addObject:_testItem(fileItem).name];
+        [scheduler startedFileItem:fileItem kind:kind host:nil];
+    }
+    return names;
+}
+
+- (void)testPriorityForTransfer;
+{
+    OFXFileItem *fileItem = [self _fileItemNamed:@"item" size:100];
+    OFXSchedulerTestFileItem *testItem = _testItem(fileItem);
+    Class cls = [OFXTransferScheduler class];
+
+    XCTAssertEqual([cls priorityForTransferOfFileItem:fileItem kind:OFXFileItemDeleteTransferKind], OFXTransferPriorityMetadata);
+    XCTAssertEqual([cls priorityForTransferOfFileItem:fileItem kind:OFXFileItemUploadTransferKind], OFXTransferPriorityContents);
+    XCTAssertEqual([cls priorityForTransferOfFileItem:fileItem kind:OFXFileItemDownloadTransferKind], OFXTransferPriorityContents, @"An update of contents we already have");
+
+    testItem.localState.missing = YES;
+    XCTAssertEqual([cls priorityForTransferOfFileItem:fileItem kind:OFXFileItemDownloadTransferKind], OFXTransferPriorityContents, @"An automatic download of contents");
+
+    testItem.localState.userMoved = YES;
+    XCTAssertEqual([cls priorityForTransferOfFileItem:fileItem kind:OFXFileItemUploadTransferKind], OFXTransferPriorityMetadata, @"A rename of a file that isn't downloaded");
+
+    testItem.contentsRequested = NO;
+    XCTAssertEqual([cls priorityForTransferOfFileItem:fileItem kind:OFXFileItemDownloadTransferKind], OFXTransferPriorityMetadata, @"A download of just the metadata");
+
+    testItem.contentsRequested = YES;
+    testItem.contentsRequestedByUser = YES;
+    XCTAssertEqual([cls priorityForTransferOfFileItem:fileItem kind:OFXFileItemDownloadTransferKind], OFXTransferPriorityUserRequested);
+
+    testItem.localState.missing = NO;
+    XCTAssertEqual([cls priorityForTransferOfFileItem:fileItem kind:OFXFileItemDownloadTransferKind], OFXTransferPriorityContents, @"Once the contents are here, updates aren't urgent");
+}
+
+- (void)testPriorityOrder;
+{
+    OFXTransferScheduler *scheduler = [[OFXTransferScheduler alloc] initWithMaximumTransferCount:100 maximumTransferCountPerContainer:100];
+
+    // Added lowest priority first, so nothing comes out in order by accident.
+    [scheduler addRequestedFileItem:[self _fileItemNamed:@"upload-300" size:300] kind:OFXFileItemUploadTransferKind];
+    [scheduler addRequestedFileItem:[self _fileItemNamed:@"upload-100-first" size:100] kind:OFXFileItemUploadTransferKind];
+    [scheduler addRequestedFileItem:[self _fileItemNamed:@"upload-200" size:200] kind:OFXFileItemUploadTransferKind];
+    [scheduler addRequestedFileItem:[self _fileItemNamed:@"upload-100-second" size:100] kind:OFXFileItemUploadTransferKind];
+
+    [scheduler addRequestedFileItem:[self _fileItemNamed:@"delete" size:5000] kind:OFXFileItemDeleteTransferKind];
+    OFXFileItem *metadataDownload = [self _fileItemNamed:@"metadata-download" size:10];
+    _testItem(metadataDownload).localState.missing = YES;
+    _testItem(metadataDownload).contentsRequested = NO;
+    [scheduler addRequestedFileItem:metadataDownload kind:OFXFileItemDownloadTransferKind];
+
+    // Below user requests, size decides, then the order of the requests. But the user asked for the big one first, so it goes first.
+    [scheduler addRequestedFileItem:[self _userRequestedDownloadNamed:@"user-big" size:1000000] kind:OFXFileItemDownloadTransferKind];
+    [scheduler addRequestedFileItem:[self _userRequestedDownloadNamed:@"user-small" size:1] kind:OFXFileItemDownloadTransferKind];
+
+    XCTAssertEqual(scheduler.numberRequested, 8UL);
+
+    NSArray <NSString *> *expected = @[@"user-big", @"user-small", @"metadata-download", @"delete", @"upload-100-first", @"upload-100-second", @"upload-200", @"upload-300"];
+    XCTAssertEqualObjects(_startAll(scheduler), expected);
+    XCTAssertEqual(scheduler.numberRequested, 0UL);
+    XCTAssertEqual(scheduler.numberRunning, 8UL);
+}
+
+- (void)testUpdatedPriority;
+{
+    OFXTransferScheduler *scheduler = [[OFXTransferScheduler alloc] initWithMaximumTransferCount:100 maximumTransferCountPerContainer:100];
+
+    OFXFileItem *automatic = [self _fileItemNamed:@"automatic" size:100];
+    _testItem(automatic).localState.missing = YES;
+    [scheduler addRequestedFileItem:automatic kind:OFXFileItemDownloadTransferKind];
+    [scheduler addRequestedFileItem:[self _fileItemNamed:@"small" size:1] kind:OFXFileItemUploadTransferKind];
+
+    // The user opens the file that was going to download in the background anyway.
+    _testItem(automatic).contentsRequestedByUser = YES;
+    [scheduler updatePriorityOfRequestedFileItem:automatic kind:OFXFileItemDownloadTransferKind];
+
+    NSArray <NSString *> *expected = @[@"automatic", @"small"];
+    XCTAssertEqualObjects(_startAll(scheduler), expected);
+}
+
+- (void)testOneTransferPerFileItemInRequestOrder;
+{
+    OFXTransferScheduler *scheduler = [[OFXTransferScheduler alloc] initWithMaximumTransferCount:100 maximumTransferCountPerContainer:100];
+
+    // New contents, then a delete of the same file. The delete has the higher priority, but has to wait.
+    OFXFileItem *edited = [self _fileItemNamed:@"edited" size:1000];
+    [scheduler addRequestedFileItem:edited kind:OFXFileItemUploadTransferKind];
+    [scheduler addRequestedFileItem:edited kind:OFXFileItemDeleteTransferKind];
+    OFXFileItem *other = [self _fileItemNamed:@"other" size:10];
+    [scheduler addRequestedFileItem:other kind:OFXFileItemUploadTransferKind];
+
+    OFXFileItemTransferKind kind;
+    XCTAssertEqual([scheduler nextRequestedFileItem:&kind], other, @"The delete can't go before the upload, and the smaller upload goes first");
+    [scheduler startedFileItem:other kind:kind host:nil];
+
+    XCTAssertEqual([scheduler nextRequestedFileItem:&kind], edited);
+    XCTAssertEqual(kind, OFXFileItemUploadTransferKind);
+    [scheduler startedFileItem:edited kind:kind host:nil];
+
+    XCTAssertNil([scheduler nextRequestedFileItem:&kind], @"Only one transfer at a time for a file item");
+    XCTAssertTrue([scheduler containsFileItem:edited kind:OFXFileItemUploadTransferKind]);
+    XCTAssertTrue([scheduler containsFileItem:edited kind:OFXFileItemDeleteTransferKind]);
+    XCTAssertEqual(scheduler.numberRequested, 1UL);
+    XCTAssertEqual(scheduler.numberRunning, 2UL);
+
+    [scheduler finishedFileItem:edited kind:OFXFileItemUploadTransferKind byteCount:1000];
+    XCTAssertFalse([scheduler containsFileItem:edited kind:OFXFileItemUploadTransferKind]);
+
+    XCTAssertEqual([scheduler nextRequestedFileItem:&kind], edited);
+    XCTAssertEqual(kind, OFXFileItemDeleteTransferKind);
+    [scheduler startedFileItem:edited kind:kind host:nil];
+    [scheduler finishedFileItem:edited kind:OFXFileItemDeleteTransferKind byteCount:0];
+    [scheduler finishedFileItem:other kind:OFXFileItemUploadTransferKind byteCount:10];
+
+    XCTAssertTrue(scheduler.empty);
+}
+
+- (void)testRemovedRequestUnblocksLaterOnes;
+{
+    OFXTransferScheduler *scheduler = [[OFXTransferScheduler alloc] initWithMaximumTransferCount:100 maximumTransferCountPerContainer:100];
+
+    OFXFileItem *fileItem = [self _fileItemNamed:@"item" size:1000];
+    [scheduler addRequestedFileItem:fileItem kind:OFXFileItemUploadTransferKind];
+    [scheduler addRequestedFileItem:fileItem kind:OFXFileItemDeleteTransferKind];
+
+    // The caller decided not to start the upload after all.
+    OFXFileItemTransferKind kind;
+    XCTAssertEqual([scheduler nextRequestedFileItem:&kind], fileItem);
+    XCTAssertEqual(kind, OFXFileItemUploadTransferKind);
+    [scheduler removeRequestedFileItem:fileItem kind:kind];
+
+    XCTAssertEqual([scheduler nextRequestedFileItem:&kind], fileItem);
+    XCTAssertEqual(kind, OFXFileItemDeleteTransferKind);
+}
+
+- (void)testDefaultLimits;
+{
+    OFXAccountClientParameters *clientParameters = [OFXAgent defaultClientParameters];
+    XCTAssertEqual(clientParameters.maximumTransferCount, 6UL);
+    XCTAssertEqual(clientParameters.maximumTransferCountPerContainer, 4UL);
+}
+
+- (void)testAccountLimit;
+{
+    OFXTransferScheduler *scheduler = [[OFXTransferScheduler alloc] initWithMaximumTransferCount:6 maximumTransferCountPerContainer:4];
+
+    NSMutableArray <OFXFileItem *> *fileItems = [NSMutableArray array];
+    for (NSUInteger containerIndex = 0; containerIndex < 3; containerIndex++) {
+        for (NSUInteger itemIndex = 0; itemIndex < 3; itemIndex++) {
+            NSString *containerIdentifier = [NSString stringWithFormat:@"container-%lu", containerIndex];
+            OFXFileItem *fileItem = [self _fileItemNamed:[NSString stringWithFormat:@"%@-item-%lu", containerIdentifier, itemIndex] container:containerIdentifier size:100];
+            [scheduler addRequestedFileItem:fileItem kind:OFXFileItemUploadTransferKind];
+            [fileItems addObject:fileItem];
+        }
+    }
+
+    XCTAssertEqual([_startAll(scheduler) count], 6UL);
+    XCTAssertEqual(scheduler.numberRunning, 6UL);
+    XCTAssertEqual(scheduler.numberRequested, 3UL);
+
+    // Finishing any one lets exactly one more start.
+    [scheduler finishedFileItem:fileItems[0] kind:OFXFileItemUploadTransferKind byteCount:100];
+    XCTAssertEqual([_startAll(scheduler) count], 1UL);
+
+    // The limit can be changed while transfers are running.
+    scheduler.maximumTransferCount = 8;
+    XCTAssertEqual([_startAll(scheduler) count], 2UL);
+    XCTAssertEqual(scheduler.numberRequested, 0UL);
+}
+
+- (void)testContainerLimit;
+{
+    OFXTransferScheduler *scheduler = [[OFXTransferScheduler alloc] initWithMaximumTransferCount:6 maximumTransferCountPerContainer:4];
+
+    // The busy container's items are all smaller, so they'd go first if it weren't for the limit.
+    NSMutableArray <OFXFileItem *> *busyItems = [NSMutableArray array];
+    for (NSUInteger itemIndex = 0; itemIndex < 6; itemIndex++) {
+        OFXFileItem *fileItem = [self _fileItemNamed:[NSString stringWithFormat:@"busy-%lu", itemIndex] container:@"busy" size:10 + itemIndex];
+        [scheduler addRequestedFileItem:fileItem kind:OFXFileItemUploadTransferKind];
+        [busyItems addObject:fileItem];
+    }
+    [scheduler addRequestedFileItem:[self _fileItemNamed:@"quiet" container:@"quiet" size:1000] kind:OFXFileItemUploadTransferKind];
+
+    NSArray <NSString *> *expected = @[@"busy-0", @"busy-1", @"busy-2", @"busy-3", @"quiet"];
+    XCTAssertEqualObjects(_startAll(scheduler), expected);
+    XCTAssertEqual(scheduler.numberRunning, 5UL, @"Under the account limit, but the busy container is at its own");
+
+    [scheduler finishedFileItem:busyItems[1] kind:OFXFileItemUploadTransferKind byteCount:11];
+    expected = @[@"busy-4"];
+    XCTAssertEqualObjects(_startAll(scheduler), expected);
+}
+
+- (void)testHostAccounting;
+{
+    OFXTransferScheduler *scheduler = [[OFXTransferScheduler alloc] initWithMaximumTransferCount:100 maximumTransferCountPerContainer:100];
+    const NSTimeInterval step = 0.2;
+
+    OFXFileItem *first = [self _fileItemNamed:@"first" size:1000];
+    OFXFileItem *second = [self _fileItemNamed:@"second" size:3000];
+    OFXFileItem *elsewhere = [self _fileItemNamed:@"elsewhere" size:500];
+    OFXFileItem *nowhere = [self _fileItemNamed:@"nowhere" size:1];
+    for (OFXFileItem *fileItem in @[first, second, elsewhere, nowhere])
+        [scheduler addRequestedFileItem:fileItem kind:OFXFileItemDownloadTransferKind];
+
+    [scheduler startedFileItem:first kind:OFXFileItemDownloadTransferKind host:@"a.example.com"];
+    [scheduler startedFileItem:second kind:OFXFileItemDownloadTransferKind host:@"a.example.com"];
+    [scheduler startedFileItem:elsewhere kind:OFXFileItemDownloadTransferKind host:@"b.example.com"];
+    [scheduler startedFileItem:nowhere kind:OFXFileItemDownloadTransferKind host:nil];
+
+    [NSThread sleepForTimeInterval:step];
+    [scheduler finishedFileItem:first kind:OFXFileItemDownloadTransferKind byteCount:1000];
+    [scheduler finishedFileItem:elsewhere kind:OFXFileItemDownloadTransferKind byteCount:500];
+    XCTAssertGreaterThanOrEqual([scheduler activeTimeForHost:@"a.example.com"], step, @"Still running, so the time so far counts");
+
+    [NSThread sleepForTimeInterval:step];
+    [scheduler finishedFileItem:second kind:OFXFileItemDownloadTransferKind byteCount:3000];
+    [scheduler finishedFileItem:nowhere kind:OFXFileItemDownloadTransferKind byteCount:1];
+
+    NSArray <NSString *> *hosts = [scheduler.hosts sortedArrayUsingSelector:@selector(compare:)];
+    NSArray <NSString *> *expectedHosts = @[@"a.example.com", @"b.example.com"];
+    XCTAssertEqualObjects(hosts, expectedHosts);
+
+    XCTAssertEqual([scheduler byteCountForHost:@"a.example.com"], 4000LL);
+    XCTAssertEqual([scheduler byteCountForHost:@"b.example.com"], 500LL);
+    XCTAssertEqual([scheduler byteCountForHost:@"c.example.com"], 0LL);
+
+    // Overlapping transfers to a host count once: two steps, not the three the two transfers add up to.
+    NSTimeInterval activeTime = [scheduler activeTimeForHost:@"a.example.com"];
+    XCTAssertGreaterThanOrEqual(activeTime, 2 * step);
+    XCTAssertLessThan(activeTime, 3 * step);
+    XCTAssertGreaterThanOrEqual([scheduler activeTimeForHost:@"b.example.com"], step);
+    XCTAssertLessThan([scheduler activeTimeForHost:@"b.example.com"], 2 * step);
+    XCTAssertEqualWithAccuracy([scheduler bytesPerSecondForHost:@"a.example.com"], 4000 / activeTime, 1e-6);
+    XCTAssertEqual([scheduler bytesPerSecondForHost:@"c.example.com"], 0.0);
+
+    // Idle time doesn't count.
+    [NSThread sleepForTimeInterval:step];
+    XCTAssertEqual([scheduler activeTimeForHost:@"a.example.com"], activeTime);
+
+    // Resetting forgets the transfers, but not what was learned about the hosts.
+    [scheduler addRequestedFileItem:first kind:OFXFileItemUploadTransferKind];
+    [scheduler startedFileItem:first kind:OFXFileItemUploadTransferKind host:@"a.example.com"];
+    [scheduler reset];
+    XCTAssertTrue(scheduler.empty);
+    XCTAssertEqual([scheduler byteCountForHost:@"a.example.com"], 4000LL);
+    NSTimeInterval activeTimeAfterReset = [scheduler activeTimeForHost:@"a.example.com"];
+    XCTAssertGreaterThanOrEqual(activeTimeAfterReset, activeTime);
+    [NSThread sleepForTimeInterval:step];
+    XCTAssertEqual([scheduler activeTimeForHost:@"a.example.com"], activeTimeAfterReset, @"Reset transfers are no longer running");
+}
+
+@end
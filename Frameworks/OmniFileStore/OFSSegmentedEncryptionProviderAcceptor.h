@@ -12,7 +12,7 @@
 #import <stdint.h>
 
 @class OFSDocumentKey, OFSSegmentEncryptWorker;
-@class NSData, NSError;
+@class NSData, NSError, NSURL;
 
 @interface OFSSegmentDecryptingByteProvider : NSObject <OFByteProvider>
 
@@ -22,6 +22,12 @@
 - (BOOL)unwrapKey:(NSRange)wrappedBlob using:(OFSDocumentKey *)unwrapper error:(NSError **)outError;
 - (BOOL)verifyFileMAC;
 
+/* Memory-maps an encrypted file (as written by -[OFSSegmentEncryptWorker encryptData:error:] or OFSEncryptingFileManager), parses its header, and unwraps its file key. Segments are only verified and decrypted as they are read, and the most recently used ones are kept decrypted, so reading a small part of a large file is cheap. It is safe to read from several threads at once. Call -verifyFileMAC to check that segments haven't been truncated or reordered. The file must not be modified while the provider is in use. */
+- (instancetype)initWithContentsOfURL:(NSURL *)fileURL documentKey:(OFSDocumentKey *)unwrapper error:(NSError **)outError;
+
+// Redeclared from OFByteProvider to make it non-@optional. Returns non-nil once a segment has failed verification; bytes read from such a segment are zero.
+- (NSError *)error;
+
 @end
 
 @interface OFSSegmentEncryptingByteAcceptor : NSObject <OFByteAcceptor>
@@ -27,11 +27,26 @@ OB_REQUIRE_ARC
 static NSError *unsupportedError_(int lineno, NSString *detail) __attribute__((cold,unused));
 #define unsupportedError(e, t) do{ if(e) { *(e) = unsupportedError_(__LINE__, t); } }while(0)
 
+/* The number of decrypted segments OFSSegmentDecryptingByteProvider keeps around. Zip readers tend to bounce between the central directory and a handful of entries, so a few is plenty. */
+#define DECRYPTED_PAGE_CACHE_SIZE 8
+
+@interface OFSDecryptedPage : NSObject
+{
+@public
+    NSUInteger _pageNumber;
+    NSData *_plaintext;
+}
+@end
+
+@implementation OFSDecryptedPage
+@end
+
 @implementation OFSSegmentDecryptingByteProvider
 {
     id <NSObject,OFByteProvider> _backingStore;
-    NSCache *_pages;
+    NSMutableArray <OFSDecryptedPage *> *_recentPages;  /* Most recently used first */
     NSMutableIndexSet *_verifiedPages;
+    NSError *_storedError;
     
     uint8_t _keyMaterial[kCCKeySizeAES128 + SEGMENTED_MAC_KEY_LEN];
 #define _bulkKey &(_keyMaterial[0])
@@ -58,7 +73,7 @@ static NSError *unsupportedError_(int lineno, NSString *detail) __attribute__((c
         return nil;
     }
     
-    if (segmentsAndFileMAC.length < (SEGMENTED_FILE_MAC_LEN + SEGMENT_HEADER_LEN)) {
+    if (segmentsAndFileMAC.length < SEGMENTED_FILE_MAC_LEN) {
         unsupportedError(outError, @"File is too short");
         return nil;
     }
@@ -80,9 +95,7 @@ static NSError *unsupportedError_(int lineno, NSString *detail) __attribute__((c
     dispatch_once_f(&testRADARsOnce, NULL, testRADAR18222014);
         
     _backingStore = underlying;
-    _pages = [[NSCache alloc] init];
-    _pages.name = NSStringFromClass([self class]);
-    _pages.countLimit = 5;
+    _recentPages = [[NSMutableArray alloc] initWithCapacity:DECRYPTED_PAGE_CACHE_SIZE];
     _verifiedPages = [[NSMutableIndexSet alloc] init];
     _offset = offsetOfFirstSegment;
     _segmentsLength = segmentsLength;
@@ -90,6 +103,27 @@ static NSError *unsupportedError_(int lineno, NSString *detail) __attribute__((c
     return self;
 }
 
+- (instancetype)initWithContentsOfURL:(NSURL *)fileURL documentKey:(OFSDocumentKey *)unwrapper error:(NSError **)outError;
+{
+    /* Mapping the file means that only the segments we actually read get paged in, and withBackingRange() can decrypt straight out of the mapping. */
+    NSData *mappedFile = [[NSData alloc] initWithContentsOfURL:fileURL options:NSDataReadingMappedAlways error:outError];
+    if (!mappedFile)
+        return nil;
+    
+    NSRange wrappedKeyRange = { 0, 0 };
+    size_t segmentsBegin = 0;
+    if (![OFSSegmentDecryptWorker parseHeader:mappedFile truncated:NO wrappedInfo:&wrappedKeyRange dataOffset:&segmentsBegin error:outError])
+        return nil;
+    
+    if (!(self = [self initWithByteProvider:mappedFile range:(NSRange){ segmentsBegin, [mappedFile length] - segmentsBegin } error:outError]))
+        return nil;
+    
+    if (![self unwrapKey:wrappedKeyRange using:unwrapper error:outError])
+        return nil;
+    
+    return self;
+}
+
 - (BOOL)unwrapKey:(NSRange)wrappedBlob using:(OFSDocumentKey *)unwrapper error:(NSError **)outError;
 {
     __block NSError *strongError = nil;
@@ -121,10 +155,22 @@ static NSError *unsupportedError_(int lineno, NSString *detail) __attribute__((c
     return _length;
 }
 
+- (NSError *)error;
+{
+    @synchronized(self) {
+        return _storedError;
+    }
+}
+
 static BOOL withBackingRange(id <OFByteProvider, NSObject> backingStore, NSRange backingRange, BOOL (^doWork)(const uint8_t *buffer))
 {
     BOOL rv;
     
+    /* NSData (in particular, a memory-mapped file) can hand us its bytes directly */
+    if ([backingStore isKindOfClass:[NSData class]] && NSMaxRange(backingRange) <= [(NSData *)backingStore length]) {
+        return doWork((const uint8_t *)[(NSData *)backingStore bytes] + backingRange.location);
+    }
+    
     if ([backingStore respondsToSelector:@selector(getBuffer:range:)]) {
         NSRange retrievedRange = backingRange;
         const uint8_t *backingBuffer = NULL;
@@ -165,16 +211,14 @@ static BOOL withBackingRange(id <OFByteProvider, NSObject> backingStore, NSRange
     
     [_backingStore getBytes:expected range:(NSRange){ _offset + _segmentsLength, SEGMENTED_FILE_MAC_LEN }];
     
-    uint32_t pageIndex = 0;
-    size_t position = 0;
-    while(position < _length) {
+    /* Step through the segments by their position in the backing store (stepping by plaintext page size against the plaintext length would skip a short final segment) */
+    size_t pageCount = ( _segmentsLength + SEGMENT_ENCRYPTED_PAGE_SIZE - 1 ) / SEGMENT_ENCRYPTED_PAGE_SIZE;
+    for (size_t pageIndex = 0; pageIndex < pageCount; pageIndex ++) {
         size_t underpos = _offset + ( pageIndex * (size_t)SEGMENT_ENCRYPTED_PAGE_SIZE );
         withBackingRange(_backingStore, (NSRange){ underpos + SEGMENTED_IV_LEN, SEGMENTED_MAC_LEN }, ^(const uint8_t *buffer){
             CCHmacUpdate(ctxt_ptr, buffer, SEGMENTED_MAC_LEN);
             return YES;
         });
-        position += SEGMENT_ENCRYPTED_PAGE_SIZE;
-        pageIndex ++;
     }
     
     if (finishAndVerifyHMAC256(&ctxt, expected, SEGMENTED_FILE_MAC_LEN) != 0)
@@ -183,19 +227,24 @@ static BOOL withBackingRange(id <OFByteProvider, NSObject> backingStore, NSRange
     return YES;
 }
 
-/* Retrieve a segment from the backing store, verifying it if we haven't seen it before, and decrypting it into the provided buffer. thisPageSize will normally be equal to SEGMENTED_PAGE_SIZE unless this is the last segment in the file. */
-- (void)_faultPage:(NSUInteger)pageNumber size:(size_t)thisPageSize toBuffer:(uint8_t *)plaintextBuffer
+/* Retrieve a segment from the backing store, verifying it if we haven't seen it before, and decrypting it into the provided buffer. thisPageSize will normally be equal to SEGMENTED_PAGE_SIZE unless this is the last segment in the file. If the segment fails verification, the buffer is zeroed and -error will return non-nil. */
+- (BOOL)_faultPage:(NSUInteger)pageNumber size:(size_t)thisPageSize toBuffer:(uint8_t *)plaintextBuffer
 {
-    withBackingRange(_backingStore,
+    BOOL ok = withBackingRange(_backingStore,
                      (NSRange){ _offset + ( pageNumber * (size_t)SEGMENT_ENCRYPTED_PAGE_SIZE ), SEGMENT_HEADER_LEN + thisPageSize },
                      ^(const uint8_t *retrievedSegmentBuffer){
-        BOOL verified = [_verifiedPages containsIndex:pageNumber];
+        BOOL verified;
+        @synchronized(self) {
+            verified = [_verifiedPages containsIndex:pageNumber];
+        }
         
         if (!verified) {
             verified = verifySegment(_hmacKey, pageNumber, retrievedSegmentBuffer, retrievedSegmentBuffer + SEGMENT_HEADER_LEN, thisPageSize);
             
             if (verified) {
-                [_verifiedPages addIndex:pageNumber];
+                @synchronized(self) {
+                    [_verifiedPages addIndex:pageNumber];
+                }
             }
         }
         
@@ -217,6 +266,58 @@ static BOOL withBackingRange(id <OFByteProvider, NSObject> backingStore, NSRange
         
         return YES;
     });
+    
+    if (!ok) {
+        memset(plaintextBuffer, 0, thisPageSize);
+        @synchronized(self) {
+            if (!_storedError) {
+                __autoreleasing NSError *error = nil;
+                unsupportedError(&error, ([NSString stringWithFormat:@"Segment %lu is corrupt", (unsigned long)pageNumber]));
+                _storedError = error;
+            }
+        }
+    }
+    
+    return ok;
+}
+
+/* Returns the decrypted contents of a page if it's in our cache, moving it to the front */
+- (NSData *)_cachedPage:(NSUInteger)pageNumber;
+{
+    @synchronized(self) {
+        NSUInteger pageCount = [_recentPages count];
+        for (NSUInteger cacheIndex = 0; cacheIndex < pageCount; cacheIndex ++) {
+            OFSDecryptedPage *page = _recentPages[cacheIndex];
+            if (page->_pageNumber == pageNumber) {
+                if (cacheIndex != 0) {
+                    [_recentPages removeObjectAtIndex:cacheIndex];
+                    [_recentPages insertObject:page atIndex:0];
+                }
+                return page->_plaintext;
+            }
+        }
+    }
+    
+    return nil;
+}
+
+- (void)_cachePage:(NSUInteger)pageNumber plaintext:(NSData *)plaintext;
+{
+    OFSDecryptedPage *page = [[OFSDecryptedPage alloc] init];
+    page->_pageNumber = pageNumber;
+    page->_plaintext = plaintext;
+    
+    @synchronized(self) {
+        /* Another thread may have faulted in the same page while we were decrypting it */
+        for (OFSDecryptedPage *existingPage in _recentPages) {
+            if (existingPage->_pageNumber == pageNumber)
+                return;
+        }
+        
+        if ([_recentPages count] >= DECRYPTED_PAGE_CACHE_SIZE)
+            [_recentPages removeLastObject];
+        [_recentPages insertObject:page atIndex:0];
+    }
 }
 
 - (void)getBytes:(void *)buffer range:(NSRange)range;
@@ -228,8 +329,7 @@ static BOOL withBackingRange(id <OFByteProvider, NSObject> backingStore, NSRange
     while (range.length > 0) {
         NSUInteger pageNumber = range.location / SEGMENTED_PAGE_SIZE;
         unsigned pageOffset = range.location % SEGMENTED_PAGE_SIZE;
-        NSNumber *pageKey = [NSNumber numberWithUnsignedInteger:pageNumber];
-        NSData *cachedPage = [_pages objectForKey:pageKey];
+        NSData *cachedPage = [self _cachedPage:pageNumber];
         NSUInteger bytesCopiedOut;
         size_t thisPageSize;
         
@@ -245,9 +345,10 @@ static BOOL withBackingRange(id <OFByteProvider, NSObject> backingStore, NSRange
         } else {
             if (!cachedPage) {
                 void *page = malloc(thisPageSize);
-                [self _faultPage:pageNumber size:thisPageSize toBuffer:page];
+                BOOL verified = [self _faultPage:pageNumber size:thisPageSize toBuffer:page];
                 cachedPage = (NSData *)dispatch_data_create(page, thisPageSize, NULL, DISPATCH_DATA_DESTRUCTOR_FREE);
-                [_pages setObject:cachedPage forKey:pageKey];
+                if (verified)
+                    [self _cachePage:pageNumber plaintext:cachedPage];
             }
 
             OBINVARIANT(cachedPage.length == thisPageSize);
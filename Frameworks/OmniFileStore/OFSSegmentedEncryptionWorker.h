@@ -15,6 +15,10 @@
 
 NS_ASSUME_NONNULL_BEGIN
 
+/* Callbacks used by the streaming methods below. A reader returns at most maximumLength bytes (fewer is fine), an empty data at the end of the stream, or nil on failure. A writer is handed each piece of output in order. */
+typedef NSData * _Nullable (^OFSSegmentedEncryptionReader)(size_t maximumLength, NSError **outError);
+typedef BOOL (^OFSSegmentedEncryptionWriter)(NSData *data, NSError **outError);
+
 @interface OFSSegmentDecryptWorker : NSObject
 
 + (size_t)maximumSlotOffset;
@@ -40,6 +44,14 @@ NS_ASSUME_NONNULL_BEGIN
 
 @end
 
+@interface OFSSegmentDecryptWorker (Streaming)
+
+/* Decrypts the segments and trailer of a file whose header has already been consumed (the reader should start at the dataOffset returned by +parseHeader:...). Segments are verified and decrypted on up to maximumConcurrency threads (0 means one per active processor) and handed to the writer in order; only a bounded window of segments is held in memory at once.
+ Each segment is authenticated before its plaintext is written, but truncation or reordering of whole segments is only detected by the file MAC at the very end. If this returns NO, the caller must discard whatever the writer received. */
+- (BOOL)decryptSegmentsFromReader:(OFSSegmentedEncryptionReader)reader toWriter:(OFSSegmentedEncryptionWriter)writer maximumConcurrency:(NSUInteger)maximumConcurrency error:(OBNSErrorOutType)outError;
+
+@end
+
 @interface OFSSegmentEncryptWorker : OFSSegmentDecryptWorker
 
 - (instancetype)init NS_UNAVAILABLE;
@@ -48,6 +60,9 @@ NS_ASSUME_NONNULL_BEGIN
 - (BOOL)encryptBuffer:(const uint8_t *)plaintext length:(size_t)len index:(uint32_t)order into:(uint8_t *)ciphertext header:(uint8_t *)hdr error:(OBNSErrorOutType)outError;
 - (nullable NSData *)encryptData:(NSData *)plaintext error:(OBNSErrorOutType)outError;
 
+/* Streaming counterpart of -encryptData:error:, producing identically formatted output (header, segments, file MAC) without holding the whole plaintext or ciphertext in memory. See -decryptSegmentsFromReader:... for the meaning of maximumConcurrency. */
+- (BOOL)encryptFromReader:(OFSSegmentedEncryptionReader)reader toWriter:(OFSSegmentedEncryptionWriter)writer maximumConcurrency:(NSUInteger)maximumConcurrency error:(OBNSErrorOutType)outError;
+
 @end
 
 
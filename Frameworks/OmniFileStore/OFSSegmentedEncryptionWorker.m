@@ -33,6 +33,14 @@ static NSError *badMagic(const char *detail) __attribute__((cold));
 static NSError *unsupportedError_(int lineno, NSString *detail) __attribute__((cold,unused));
 #define unsupportedError(e, t) do{ if(e) { *(e) = unsupportedError_(__LINE__, t); } }while(0)
 
+typedef NSData * (^OFSSegmentPipelineInput)(size_t segmentIndex, NSError **outError);
+typedef NSData * (^OFSSegmentPipelineTransform)(size_t segmentIndex, NSData *input, NSError **outError);
+typedef BOOL (^OFSSegmentPipelineOutput)(size_t segmentIndex, NSData *input, NSData *output, NSError **outError);
+static BOOL runSegmentPipeline(NSUInteger maximumConcurrency, OFSSegmentPipelineInput nextInput, OFSSegmentPipelineTransform transform, OFSSegmentPipelineOutput emit, NSError **outError);
+static NSData *fileHeader(NSData *keyInfo);
+static BOOL fillBuffer(NSMutableData *buffer, size_t wantedLength, OFSSegmentedEncryptionReader reader, BOOL *ioAtEnd, NSError **outError);
+static NSData *takeBytes(NSMutableData *buffer, size_t length);
+
 @implementation OFSSegmentDecryptWorker
 {
 @protected
@@ -313,6 +321,7 @@ static NSError *unsupportedError_(int lineno, NSString *detail) __attribute__((c
     
     // Ugly.
     const void **segments = calloc(MAX((size_t)1, segmentCount), sizeof(void *));
+    __block NSError *segmentError = nil;
     
     dispatch_apply(segmentCount, dispatch_get_global_queue(QOS_CLASS_DEFAULT, 0), ^(size_t segmentIndex){
         size_t plaintextLength = [plaintext length];
@@ -329,19 +338,15 @@ static NSError *unsupportedError_(int lineno, NSString *detail) __attribute__((c
             segments[segmentIndex] = CFBridgingRetain(dispatch_data_create(buffer, SEGMENT_HEADER_LEN + segmentLength, NULL, DISPATCH_DATA_DESTRUCTOR_FREE));
         } else {
             free(buffer);
-            NSLog(@"Segment %zu failed: %@", segmentIndex, localError);
+            @synchronized(self) {
+                if (!segmentError)
+                    segmentError = localError;
+            }
         }
     });
     
-    /* Header is: magic || infolength || info || padding */
-    size_t keyInfoLength = [keyInfo length];
-    size_t headerLength = FMT_V1_0_MAGIC_LEN + 2 + keyInfoLength;
-    headerLength = 16 * ((headerLength + 15)/16);
-    void *header = calloc(1, headerLength);
-    memcpy(header, magic_ver1_0, FMT_V1_0_MAGIC_LEN);
-    OSWriteBigInt16(header, FMT_V1_0_MAGIC_LEN, (uint16_t)keyInfoLength);
-    [keyInfo getBytes:header + (FMT_V1_0_MAGIC_LEN + 2) length:keyInfoLength];
-    dispatch_data_t result_data = dispatch_data_create(header, headerLength, NULL, DISPATCH_DATA_DESTRUCTOR_FREE);
+    NSData *header = fileHeader(keyInfo);
+    dispatch_data_t result_data = dispatch_data_create([header bytes], [header length], NULL, DISPATCH_DATA_DESTRUCTOR_DEFAULT);
     
     /* Concat the segments, and compute the file MAC */
     
@@ -364,10 +369,9 @@ static NSError *unsupportedError_(int lineno, NSString *detail) __attribute__((c
     
     if (failed) {
         /* This is completely unexpected - there's almost nothing that can generate an error in that loop. */
-        if (outError) {
-            *outError = nil;
-            _OBError(outError, NSOSStatusErrorDomain, errSecInternalComponent, __FILE__, __LINE__, nil);
-        }
+        OBASSERT(segmentError != nil);
+        if (outError)
+            *outError = segmentError;
         return nil;
     }
     
@@ -384,6 +388,59 @@ static NSError *unsupportedError_(int lineno, NSString *detail) __attribute__((c
     return (NSData *)final_result;
 }
 
+- (BOOL)encryptFromReader:(OFSSegmentedEncryptionReader)reader toWriter:(OFSSegmentedEncryptionWriter)writer maximumConcurrency:(NSUInteger)maximumConcurrency error:(NSError * __autoreleasing *)outError;
+{
+    NSData *keyInfo = [self wrappedKey];
+    if (!keyInfo) {
+        [NSException raise:NSInternalInconsistencyException format:@"%@.wrappedKey is nil", self];
+        return NO;
+    }
+    
+    if (!writer(fileHeader(keyInfo), outError))
+        return NO;
+    
+    NSMutableData *pending = [NSMutableData data];
+    __block BOOL atEnd = NO;
+    __block CCHmacContext fileMAC;
+    [self fileMACContext:&fileMAC];
+    
+    OFSSegmentPipelineInput nextInput = ^NSData *(size_t segmentIndex, NSError **outInputError){
+        if (!fillBuffer(pending, SEGMENTED_PAGE_SIZE, reader, &atEnd, outInputError))
+            return nil;
+        if ([pending length] == 0)
+            return [NSData data];
+        if (segmentIndex >= UINT32_MAX) {
+            unsupportedError(outInputError, @"File is too large to encrypt.");
+            return nil;
+        }
+        return takeBytes(pending, MIN((size_t)SEGMENTED_PAGE_SIZE, [pending length]));
+    };
+    
+    OFSSegmentPipelineTransform encryptSegment = ^NSData *(size_t segmentIndex, NSData *plaintext, NSError **outTransformError){
+        size_t segmentLength = [plaintext length];
+        NSMutableData *segment = [NSMutableData dataWithLength:SEGMENT_HEADER_LEN + segmentLength];
+        uint8_t *buffer = [segment mutableBytes];
+        if (![self encryptBuffer:[plaintext bytes] length:segmentLength index:(uint32_t)segmentIndex into:buffer + SEGMENT_HEADER_LEN header:buffer error:outTransformError])
+            return nil;
+        return segment;
+    };
+    
+    OFSSegmentPipelineOutput emitSegment = ^BOOL(size_t segmentIndex, NSData *plaintext, NSData *segment, NSError **outOutputError){
+        CCHmacUpdate(&fileMAC, [segment bytes] + SEGMENTED_IV_LEN, SEGMENTED_MAC_LEN);
+        return writer(segment, outOutputError);
+    };
+    
+    if (!runSegmentPipeline(maximumConcurrency, nextInput, encryptSegment, emitSegment, outError))
+        return NO;
+    
+    /* Trailer is just the file MAC */
+    uint8_t finalMAC[SEGMENTED_FILE_MAC_LEN];
+    _Static_assert(sizeof(finalMAC) == CC_SHA256_DIGEST_LENGTH, "");
+    CCHmacFinal(&fileMAC, finalMAC);
+    
+    return writer([NSData dataWithBytes:finalMAC length:SEGMENTED_FILE_MAC_LEN], outError);
+}
+
 @end
 
 @implementation OFSSegmentDecryptWorker (OneShot)
@@ -614,6 +671,232 @@ static NSRange checkHeaderMagic(NSData * __nonnull ciphertext, size_t ciphertext
 
 @end
 
+#pragma mark Streaming
+
+@implementation OFSSegmentDecryptWorker (Streaming)
+
+- (BOOL)decryptSegmentsFromReader:(OFSSegmentedEncryptionReader)reader toWriter:(OFSSegmentedEncryptionWriter)writer maximumConcurrency:(NSUInteger)maximumConcurrency error:(NSError * __autoreleasing *)outError;
+{
+    /* We can't know that a segment is the last one until we've seen the end of the stream, so we always read far enough ahead to have a full segment plus the trailer, plus one more byte. Whatever is left over once the reader runs dry is the file MAC. */
+    NSMutableData *pending = [NSMutableData data];
+    __block BOOL atEnd = NO;
+    __block CCHmacContext fileMAC;
+    [self fileMACContext:&fileMAC];
+    
+    OFSSegmentPipelineInput nextInput = ^NSData *(size_t segmentIndex, NSError **outInputError){
+        if (!fillBuffer(pending, SEGMENT_ENCRYPTED_PAGE_SIZE + SEGMENTED_FILE_MAC_LEN + 1, reader, &atEnd, outInputError))
+            return nil;
+        
+        size_t segmentLength;
+        if (!atEnd) {
+            segmentLength = SEGMENT_ENCRYPTED_PAGE_SIZE;
+        } else {
+            if ([pending length] < SEGMENTED_FILE_MAC_LEN) {
+                if (outInputError) *outInputError = headerError("File too short.");
+                return nil;
+            }
+            segmentLength = MIN((size_t)SEGMENT_ENCRYPTED_PAGE_SIZE, [pending length] - SEGMENTED_FILE_MAC_LEN);
+            if (segmentLength == 0)
+                return [NSData data];
+            if (segmentLength < SEGMENT_HEADER_LEN) {
+                // Impossible file length
+                if (outInputError) *outInputError = headerError("File too short.");
+                return nil;
+            }
+        }
+        
+        if (segmentIndex > UINT32_MAX) {
+            if (outInputError) *outInputError = headerError("Encrypted file is corrupt.");
+            return nil;
+        }
+        return takeBytes(pending, segmentLength);
+    };
+    
+    OFSSegmentPipelineTransform decryptSegment = ^NSData *(size_t segmentIndex, NSData *segment, NSError **outTransformError){
+        if (![self verifySegment:segmentIndex data:segment]) {
+            if (outTransformError) *outTransformError = headerError("Encrypted file is corrupt.");
+            return nil;
+        }
+        
+        size_t plaintextLength = [segment length] - SEGMENT_HEADER_LEN;
+        NSMutableData *plaintext = [NSMutableData dataWithLength:plaintextLength];
+        const uint8_t *segmentBegins = [segment bytes];
+        if (![self decryptBuffer:segmentBegins + SEGMENT_HEADER_LEN range:(NSRange){0, plaintextLength} index:(uint32_t)segmentIndex into:[plaintext mutableBytes] header:segmentBegins error:outTransformError])
+            return nil;
+        return plaintext;
+    };
+    
+    OFSSegmentPipelineOutput emitSegment = ^BOOL(size_t segmentIndex, NSData *segment, NSData *plaintext, NSError **outOutputError){
+        CCHmacUpdate(&fileMAC, [segment bytes] + SEGMENTED_IV_LEN, SEGMENTED_MAC_LEN);
+        if ([plaintext length] == 0)
+            return YES;
+        return writer(plaintext, outOutputError);
+    };
+    
+    if (!runSegmentPipeline(maximumConcurrency, nextInput, decryptSegment, emitSegment, outError)) {
+        return NO;
+    }
+    
+    /* Check the file MAC */
+    OBASSERT(atEnd);
+    OBASSERT([pending length] == SEGMENTED_FILE_MAC_LEN);
+    if (finishAndVerifyHMAC256(&fileMAC, [pending bytes], SEGMENTED_FILE_MAC_LEN) != 0) {
+        if (outError) *outError = headerError("Encrypted file is corrupt.");
+        return NO;
+    }
+    
+    return YES;
+}
+
+@end
+
+@interface OFSSegmentPipelineSlot : NSObject
+{
+@public
+    size_t _segmentIndex;
+    NSData *_input;
+    NSData *_output;
+    NSError *_error;
+    BOOL _busy;
+    dispatch_semaphore_t _finished;
+}
+@end
+
+@implementation OFSSegmentPipelineSlot
+@end
+
+static BOOL finishSlot(OFSSegmentPipelineSlot *slot, OFSSegmentPipelineOutput emit, NSError **outError)
+{
+    if (!slot->_busy)
+        return YES;
+    
+    dispatch_semaphore_wait(slot->_finished, DISPATCH_TIME_FOREVER);
+    slot->_busy = NO;
+    
+    BOOL ok;
+    if (!slot->_output) {
+        /* The transform failed; report its error rather than emitting anything. */
+        if (emit && outError)
+            *outError = slot->_error;
+        ok = (emit == nil);
+    } else {
+        ok = emit ? emit(slot->_segmentIndex, slot->_input, slot->_output, outError) : YES;
+    }
+    slot->_input = nil;
+    slot->_output = nil;
+    slot->_error = nil;
+    return ok;
+}
+
+/* Runs the transform over each input segment on up to maximumConcurrency serial queues, and hands the results to emit in segment order on the calling thread. If the transform fails for a segment, its error is returned in place of emitting that segment. At most twice maximumConcurrency segments are in flight at once; the slot for segment N is reused for segment N + windowSize, and is emitted just before that, which is what keeps the output in order. nextInput returns an empty data when there are no more segments. */
+static BOOL runSegmentPipeline(NSUInteger maximumConcurrency, OFSSegmentPipelineInput nextInput, OFSSegmentPipelineTransform transform, OFSSegmentPipelineOutput emit, NSError **outError)
+{
+    if (maximumConcurrency == 0)
+        maximumConcurrency = [[NSProcessInfo processInfo] activeProcessorCount];
+    NSUInteger windowSize = 2 * maximumConcurrency;
+    
+    NSMutableArray <dispatch_queue_t> *workQueues = [NSMutableArray arrayWithCapacity:maximumConcurrency];
+    for (NSUInteger queueIndex = 0; queueIndex < maximumConcurrency; queueIndex++)
+        [workQueues addObject:dispatch_queue_create("com.omnigroup.OmniFileStore.SegmentPipeline", DISPATCH_QUEUE_SERIAL)];
+    
+    NSMutableArray <OFSSegmentPipelineSlot *> *slots = [NSMutableArray arrayWithCapacity:windowSize];
+    for (NSUInteger slotIndex = 0; slotIndex < windowSize; slotIndex++) {
+        OFSSegmentPipelineSlot *slot = [[OFSSegmentPipelineSlot alloc] init];
+        slot->_finished = dispatch_semaphore_create(0);
+        [slots addObject:slot];
+    }
+    
+    NSError *failure = nil;
+    size_t segmentIndex = 0;
+    for (;;) {
+        BOOL keepGoing = YES;
+        
+        @autoreleasepool {
+            NSError * __autoreleasing localError = nil;
+            OFSSegmentPipelineSlot *slot = slots[segmentIndex % windowSize];
+            
+            NSData *input = nil;
+            if (!finishSlot(slot, emit, &localError) || !(input = nextInput(segmentIndex, &localError))) {
+                failure = localError;
+                keepGoing = NO;
+            } else if ([input length] == 0) {
+                keepGoing = NO;
+            } else {
+                slot->_segmentIndex = segmentIndex;
+                slot->_input = input;
+                slot->_busy = YES;
+                
+                size_t thisSegmentIndex = segmentIndex;
+                dispatch_async(workQueues[segmentIndex % maximumConcurrency], ^{
+                    @autoreleasepool {
+                        NSError * __autoreleasing transformError = nil;
+                        slot->_output = transform(thisSegmentIndex, input, &transformError);
+                        if (!slot->_output)
+                            slot->_error = transformError;
+                    }
+                    dispatch_semaphore_signal(slot->_finished);
+                });
+                segmentIndex++;
+            }
+        }
+        
+        if (!keepGoing)
+            break;
+    }
+    
+    /* Emit whatever is still in flight, oldest first. After a failure, we still wait for the workers, but don't emit anything further. */
+    for (NSUInteger drainIndex = 0; drainIndex < windowSize; drainIndex++) {
+        @autoreleasepool {
+            NSError * __autoreleasing localError = nil;
+            if (!finishSlot(slots[(segmentIndex + drainIndex) % windowSize], failure ? nil : emit, &localError))
+                failure = localError;
+        }
+    }
+    
+    if (failure) {
+        if (outError) *outError = failure;
+        return NO;
+    }
+    
+    return YES;
+}
+
+static NSData *fileHeader(NSData *keyInfo)
+{
+    /* Header is: magic || infolength || info || padding */
+    size_t keyInfoLength = [keyInfo length];
+    size_t headerLength = FMT_V1_0_MAGIC_LEN + 2 + keyInfoLength;
+    headerLength = 16 * ((headerLength + 15)/16);
+    NSMutableData *header = [NSMutableData dataWithLength:headerLength];
+    uint8_t *bytes = [header mutableBytes];
+    memcpy(bytes, magic_ver1_0, FMT_V1_0_MAGIC_LEN);
+    OSWriteBigInt16(bytes, FMT_V1_0_MAGIC_LEN, (uint16_t)keyInfoLength);
+    [keyInfo getBytes:bytes + (FMT_V1_0_MAGIC_LEN + 2) length:keyInfoLength];
+    return header;
+}
+
+/* Reads from the reader until the buffer holds at least wantedLength bytes or the stream ends. */
+static BOOL fillBuffer(NSMutableData *buffer, size_t wantedLength, OFSSegmentedEncryptionReader reader, BOOL *ioAtEnd, NSError **outError)
+{
+    while (!*ioAtEnd && [buffer length] < wantedLength) {
+        NSData *chunk = reader(wantedLength - [buffer length], outError);
+        if (!chunk)
+            return NO;
+        if ([chunk length] == 0)
+            *ioAtEnd = YES;
+        else
+            [buffer appendData:chunk];
+    }
+    return YES;
+}
+
+static NSData *takeBytes(NSMutableData *buffer, size_t length)
+{
+    NSData *result = [NSData dataWithBytes:[buffer bytes] length:length];
+    [buffer replaceBytesInRange:(NSRange){0, length} withBytes:NULL length:0];
+    return result;
+}
+
 #pragma mark Utility functions
 
 static NSError *headerError(const char *msg)
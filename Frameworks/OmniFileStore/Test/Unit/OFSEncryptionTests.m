@@ -778,6 +778,254 @@ static void wrXY(char *into, int x, int y)
     // N.B. I'm fairly sure that the range passed in above is incorrect, but since we expect to crash before actually decoding any data, I'm leaving it for now. A better reference point for readers is -[OFSSegmentDecryptWorker(OneShot) decryptData:dataOffset:error:].
 }
 
+- (void)testRandomAccessFile:(enum OFSDocumentKeySlotType)keyType;
+{
+    NSError * __autoreleasing error = nil;
+    
+    OFSMutableDocumentKey *docKey;
+    OBShouldNotError(docKey = [[OFSMutableDocumentKey alloc] initWithData:nil error:&error]);
+    [docKey.mutableKeySlots discardKeysExceptSlots:nil retireCurrent:NO generate:keyType];
+    
+    NSURL *fileURL = [NSURL fileURLWithPath:[NSTemporaryDirectory() stringByAppendingPathComponent:@"OFSEncryptionTests-testRandomAccessFile"]];
+    
+    static const size_t plaintextLengths[] = { 0, 100, 3 * SEGMENTED_PAGE_SIZE, 20 * SEGMENTED_PAGE_SIZE + 12345 };
+    for (size_t lengthIndex = 0; lengthIndex < sizeof(plaintextLengths)/sizeof(plaintextLengths[0]); lengthIndex++) {
+        size_t plaintextLength = plaintextLengths[lengthIndex];
+        NSData *plaintext = OFRandomCreateDataOfLength(plaintextLength);
+        NSData *ciphertext;
+        OBShouldNotError(ciphertext = [[docKey encryptionWorker:&error] encryptData:plaintext error:&error]);
+        OBShouldNotError([ciphertext writeToURL:fileURL options:0 error:&error]);
+        
+        OFSSegmentDecryptingByteProvider *reader;
+        OBShouldNotError(reader = [[OFSSegmentDecryptingByteProvider alloc] initWithContentsOfURL:fileURL documentKey:docKey error:&error]);
+        XCTAssertEqual([reader length], plaintextLength);
+        XCTAssertTrue([reader verifyFileMAC]);
+        
+        // Read the tail first, as a zip reader looking for its central directory would, then some scattered ranges, some of which straddle segment boundaries.
+        OFRandomState *state = OFRandomStateCreate();
+        for (unsigned readIndex = 0; readIndex < 50 && plaintextLength > 0; readIndex++) {
+            NSRange range;
+            if (readIndex == 0) {
+                range.length = MIN(plaintextLength, (size_t)1000);
+                range.location = plaintextLength - range.length;
+            } else {
+                range.location = OFRandomNextStateN(state, (unsigned int)plaintextLength);
+                range.length = MIN(plaintextLength - range.location, (size_t)OFRandomNextStateN(state, 2 * SEGMENTED_PAGE_SIZE));
+            }
+            
+            NSMutableData *buffer = [NSMutableData dataWithLength:range.length];
+            [reader getBytes:[buffer mutableBytes] range:range];
+            XCTAssertEqualObjects(buffer, [plaintext subdataWithRange:range]);
+        }
+        OFRandomStateDestroy(state);
+        XCTAssertNil([reader error]);
+    }
+    
+    // Damage one segment: reads from it fail (and produce zeroes), but the rest of the file is still readable.
+    {
+        NSData *plaintext = OFRandomCreateDataOfLength(4 * SEGMENTED_PAGE_SIZE);
+        NSData *ciphertext;
+        OBShouldNotError(ciphertext = [[docKey encryptionWorker:&error] encryptData:plaintext error:&error]);
+        size_t offset = 0;
+        OBShouldNotError([OFSSegmentDecryptWorker parseHeader:ciphertext truncated:NO wrappedInfo:NULL dataOffset:&offset error:&error]);
+        
+        NSMutableData *damaged = [ciphertext mutableCopy];
+        ((uint8_t *)[damaged mutableBytes])[offset + 2 * SEGMENT_ENCRYPTED_PAGE_SIZE + 100] ^= 0x01;
+        OBShouldNotError([damaged writeToURL:fileURL options:0 error:&error]);
+        
+        OFSSegmentDecryptingByteProvider *reader;
+        OBShouldNotError(reader = [[OFSSegmentDecryptingByteProvider alloc] initWithContentsOfURL:fileURL documentKey:docKey error:&error]);
+        
+        NSRange goodRange = { SEGMENTED_PAGE_SIZE - 10, 20 };
+        NSMutableData *buffer = [NSMutableData dataWithLength:goodRange.length];
+        [reader getBytes:[buffer mutableBytes] range:goodRange];
+        XCTAssertEqualObjects(buffer, [plaintext subdataWithRange:goodRange]);
+        XCTAssertNil([reader error]);
+        
+        NSRange badRange = { 2 * SEGMENTED_PAGE_SIZE + 50, 20 };
+        [reader getBytes:[buffer mutableBytes] range:badRange];
+        XCTAssertEqualObjects(buffer, [NSMutableData dataWithLength:badRange.length]);
+        XCTAssertNotNil([reader error]);
+    }
+    
+    [[NSFileManager defaultManager] removeItemAtURL:fileURL error:NULL];
+}
+
+/* Hands out the given data in chunks of at most chunkSize bytes, to make sure the streaming methods cope with short reads. */
+static OFSSegmentedEncryptionReader readerForData(NSData *data, size_t offset, size_t chunkSize)
+{
+    __block size_t position = offset;
+    return ^NSData *(size_t maximumLength, NSError **outError){
+        size_t length = MIN(MIN(maximumLength, chunkSize), [data length] - position);
+        NSData *chunk = [data subdataWithRange:(NSRange){position, length}];
+        position += length;
+        return chunk;
+    };
+}
+
+static OFSSegmentedEncryptionWriter writerForData(NSMutableData *data)
+{
+    return ^BOOL(NSData *chunk, NSError **outError){
+        [data appendData:chunk];
+        return YES;
+    };
+}
+
+static OFSSegmentDecryptWorker *decryptorForCiphertext(NSData *ciphertext, OFSDocumentKey *docKey, size_t *outOffset)
+{
+    NSError * __autoreleasing error = nil;
+    NSRange derivationInfoLocation = { 0, 0 };
+    OFSSegmentDecryptWorker *decryptor;
+    
+    OBShouldNotError([OFSSegmentDecryptWorker parseHeader:ciphertext truncated:NO wrappedInfo:&derivationInfoLocation dataOffset:outOffset error:&error]);
+    OBShouldNotError(decryptor = [OFSSegmentDecryptWorker decryptorForWrappedKey:[ciphertext subdataWithRange:derivationInfoLocation] documentKey:docKey.keySlots error:&error]);
+    return decryptor;
+}
+
+- (void)testStreaming:(enum OFSDocumentKeySlotType)keyType;
+{
+    NSError * __autoreleasing error = nil;
+    
+    OFSMutableDocumentKey *docKey;
+    OBShouldNotError(docKey = [[OFSMutableDocumentKey alloc] initWithData:nil error:&error]);
+    [docKey.mutableKeySlots discardKeysExceptSlots:nil retireCurrent:NO generate:keyType];
+    
+    static const size_t plaintextLengths[] = { 0, 1, SEGMENTED_PAGE_SIZE - 1, SEGMENTED_PAGE_SIZE, SEGMENTED_PAGE_SIZE + 1, 7 * SEGMENTED_PAGE_SIZE + 1000, 40 * SEGMENTED_PAGE_SIZE };
+    
+    for (size_t lengthIndex = 0; lengthIndex < sizeof(plaintextLengths)/sizeof(plaintextLengths[0]); lengthIndex++) {
+        NSData *plaintext = OFRandomCreateDataOfLength(plaintextLengths[lengthIndex]);
+        
+        for (NSUInteger threadCount = 1; threadCount <= 4; threadCount *= 2) {
+            // Streamed ciphertext should be readable by the one-shot decryptor...
+            NSMutableData *ciphertext = [NSMutableData data];
+            OBShouldNotError([[docKey encryptionWorker:&error] encryptFromReader:readerForData(plaintext, 0, 5000) toWriter:writerForData(ciphertext) maximumConcurrency:threadCount error:&error]);
+            
+            size_t offset = 0;
+            OFSSegmentDecryptWorker *decryptor = decryptorForCiphertext(ciphertext, docKey, &offset);
+            NSData *decrypted;
+            OBShouldNotError(decrypted = [decryptor decryptData:ciphertext dataOffset:offset error:&error]);
+            XCTAssertEqualObjects(plaintext, decrypted);
+            
+            // ... and one-shot ciphertext by the streaming decryptor.
+            NSData *oneShotCiphertext;
+            OBShouldNotError(oneShotCiphertext = [[docKey encryptionWorker:&error] encryptData:plaintext error:&error]);
+            XCTAssertEqual([oneShotCiphertext length], [ciphertext length]);
+            
+            decryptor = decryptorForCiphertext(oneShotCiphertext, docKey, &offset);
+            NSMutableData *streamDecrypted = [NSMutableData data];
+            OBShouldNotError([decryptor decryptSegmentsFromReader:readerForData(oneShotCiphertext, offset, 3000) toWriter:writerForData(streamDecrypted) maximumConcurrency:threadCount error:&error]);
+            XCTAssertEqualObjects(plaintext, streamDecrypted);
+        }
+    }
+}
+
+- (void)testStreamingDamage;
+{
+    NSError * __autoreleasing error = nil;
+    
+    OFSMutableDocumentKey *docKey;
+    OBShouldNotError(docKey = [[OFSMutableDocumentKey alloc] initWithData:nil error:&error]);
+    [docKey.mutableKeySlots discardKeysExceptSlots:nil retireCurrent:NO generate:SlotTypeActiveAES_CTR_HMAC];
+    
+    NSData *plaintext = OFRandomCreateDataOfLength(5 * SEGMENTED_PAGE_SIZE + 17);
+    NSData *ciphertext;
+    OBShouldNotError(ciphertext = [[docKey encryptionWorker:&error] encryptData:plaintext error:&error]);
+    
+    size_t offset = 0;
+    OFSSegmentDecryptWorker *decryptor = decryptorForCiphertext(ciphertext, docKey, &offset);
+    
+    // Flip a bit in each segment header, in the middle of each segment, and in the file MAC; also try dropping a whole segment and truncating the file.
+    NSMutableArray <NSData *> *damagedCiphertexts = [NSMutableArray array];
+    for (size_t position = offset; position < [ciphertext length]; position += SEGMENT_ENCRYPTED_PAGE_SIZE / 2) {
+        NSMutableData *damaged = [ciphertext mutableCopy];
+        ((uint8_t *)[damaged mutableBytes])[position] ^= 0x04;
+        [damagedCiphertexts addObject:damaged];
+    }
+    {
+        NSMutableData *damaged = [ciphertext mutableCopy];
+        ((uint8_t *)[damaged mutableBytes])[[damaged length] - 1] ^= 0x04;
+        [damagedCiphertexts addObject:damaged];
+        
+        damaged = [ciphertext mutableCopy];
+        [damaged replaceBytesInRange:(NSRange){offset + SEGMENT_ENCRYPTED_PAGE_SIZE, SEGMENT_ENCRYPTED_PAGE_SIZE} withBytes:NULL length:0];
+        [damagedCiphertexts addObject:damaged];
+        
+        [damagedCiphertexts addObject:[ciphertext subdataWithRange:(NSRange){0, [ciphertext length] - 1}]];
+        [damagedCiphertexts addObject:[ciphertext subdataWithRange:(NSRange){0, offset + SEGMENTED_FILE_MAC_LEN - 1}]];
+    }
+    
+    for (NSData *damaged in damagedCiphertexts) {
+        error = nil;
+        XCTAssertFalse([decryptor decryptSegmentsFromReader:readerForData(damaged, offset, SIZE_MAX) toWriter:writerForData([NSMutableData data]) maximumConcurrency:3 error:&error]);
+        XCTAssertEqualObjects(error.domain, OFSErrorDomain);
+    }
+    
+    // Errors from the reader and writer are passed back to the caller.
+    NSError *readError = [NSError errorWithDomain:NSPOSIXErrorDomain code:EIO userInfo:nil];
+    error = nil;
+    XCTAssertFalse([[docKey encryptionWorker:NULL] encryptFromReader:^NSData *(size_t maximumLength, NSError **outError){
+        *outError = readError;
+        return nil;
+    } toWriter:writerForData([NSMutableData data]) maximumConcurrency:2 error:&error]);
+    XCTAssertEqualObjects(error, readError);
+    
+    __block NSUInteger writeCount = 0;
+    error = nil;
+    XCTAssertFalse([decryptor decryptSegmentsFromReader:readerForData(ciphertext, offset, SIZE_MAX) toWriter:^BOOL(NSData *data, NSError **outError){
+        if (++writeCount < 3)
+            return YES;
+        *outError = readError;
+        return NO;
+    } maximumConcurrency:2 error:&error]);
+    XCTAssertEqualObjects(error, readError);
+    XCTAssertEqual(writeCount, 3u);
+}
+
+- (void)testStreamingThroughput;
+{
+    if (![OBTestCase shouldRunSlowUnitTests]) {
+        NSLog(@"*** SKIPPING slow test [%@ %@]", [self class], NSStringFromSelector(_cmd));
+        return;
+    }
+    
+    NSError * __autoreleasing error = nil;
+    
+    OFSMutableDocumentKey *docKey;
+    OBShouldNotError(docKey = [[OFSMutableDocumentKey alloc] initWithData:nil error:&error]);
+    [docKey.mutableKeySlots discardKeysExceptSlots:nil retireCurrent:NO generate:SlotTypeActiveAES_CTR_HMAC];
+    
+    static const size_t plaintextLength = 256 * 1024 * 1024;
+    NSData *plaintext = OFRandomCreateDataOfLength(plaintextLength);
+    NSData *ciphertext;
+    OBShouldNotError(ciphertext = [[docKey encryptionWorker:&error] encryptData:plaintext error:&error]);
+    size_t offset = 0;
+    OFSSegmentDecryptWorker *decryptor = decryptorForCiphertext(ciphertext, docKey, &offset);
+    
+    // The writers just count bytes, so that we're measuring the pipeline and not memory allocation.
+    __block size_t writtenLength = 0;
+    OFSSegmentedEncryptionWriter countingWriter = ^BOOL(NSData *data, NSError **outError){
+        writtenLength += [data length];
+        return YES;
+    };
+    
+    for (NSUInteger threadCount = 1; threadCount <= 8; threadCount *= 2) {
+        OFSSegmentEncryptWorker *encryptor;
+        OBShouldNotError(encryptor = [docKey encryptionWorker:&error]);
+        
+        NSTimeInterval start = [NSDate timeIntervalSinceReferenceDate];
+        OBShouldNotError([encryptor encryptFromReader:readerForData(plaintext, 0, SIZE_MAX) toWriter:countingWriter maximumConcurrency:threadCount error:&error]);
+        NSTimeInterval encryptTime = [NSDate timeIntervalSinceReferenceDate] - start;
+        
+        start = [NSDate timeIntervalSinceReferenceDate];
+        OBShouldNotError([decryptor decryptSegmentsFromReader:readerForData(ciphertext, offset, SIZE_MAX) toWriter:countingWriter maximumConcurrency:threadCount error:&error]);
+        NSTimeInterval decryptTime = [NSDate timeIntervalSinceReferenceDate] - start;
+        
+        NSLog(@"%lu threads: encrypt %.1f MB/s, decrypt %.1f MB/s", threadCount, plaintextLength / encryptTime / 1e6, plaintextLength / decryptTime / 1e6);
+    }
+    
+    XCTAssertEqual(writtenLength, 4 * ([ciphertext length] + plaintextLength));
+}
+
 @end
 
 @implementation OFSEncryptedDAVTests
@@ -38,6 +38,13 @@ struct _OFBTree {
     void *userInfo;
 };
 
+/*" OFBTreeCursor holds the path from the tree's root to a location in the tree. Its contents are private; it is only valid until the tree is next modified. "*/
+typedef struct _OFBTreeCursor {
+    union _OFBTreeChildPointer nodeStack[10];
+    void *selectionStack[10];
+    unsigned nodeStackDepth;
+} OFBTreeCursor;
+
 extern void OFBTreeInit(OFBTree *tree,
                         size_t nodeSize,
                         size_t elementSize,
@@ -53,12 +60,23 @@ extern void *OFBTreeFind(const OFBTree *tree, const void *value);
 extern void *OFBTreeFindNear(const OFBTree *tree, const void *value, int offset, BOOL afterMatch);
 extern void OFBTreeDeleteAll(OFBTree *tree);
 
+// Builds the tree bottom-up from elementCount elements which must already be sorted (and unique) according to the tree's comparator. The tree must be empty. Nodes are filled to roughly fillFactor (0 < fillFactor <= 1) of their capacity; use 1.0 for read-mostly trees, or leave some slack if many inserts will follow. If the fill factor would make the tree too tall for OFBTreeCursor, nodes are filled completely instead; if even that is too tall, this raises NSInvalidArgumentException and leaves the tree empty.
+extern void OFBTreeBulkLoad(OFBTree *tree, const void *elements, size_t elementCount, double fillFactor);
+
 extern void OFBTreeEnumerate(const OFBTree *tree, OFBTreeEnumerator enumerator);
 
 // This is not a terribly efficient API but it is reliable and does what I need
 extern void *OFBTreePrevious(const OFBTree *tree, const void *value);
 extern void *OFBTreeNext(const OFBTree *tree, const void *value);
 
+// Stateful range traversal. Seeking positions the cursor at the first element >= lowerBound (or the first/last element of the tree) and returns it, or NULL if there is no such element. Stepping returns the adjacent element in amortized O(1) without re-descending from the root; at either end of the tree NULL is returned and the cursor is left on the last element it returned.
+extern void *OFBTreeCursorSeek(const OFBTree *tree, OFBTreeCursor *cursor, const void *lowerBound);
+extern void *OFBTreeCursorSeekFirst(const OFBTree *tree, OFBTreeCursor *cursor);
+extern void *OFBTreeCursorSeekLast(const OFBTree *tree, OFBTreeCursor *cursor);
+extern void *OFBTreeCursorCurrent(const OFBTree *tree, const OFBTreeCursor *cursor);
+extern void *OFBTreeCursorNext(const OFBTree *tree, OFBTreeCursor *cursor);
+extern void *OFBTreeCursorPrevious(const OFBTree *tree, OFBTreeCursor *cursor);
+
 #ifdef DEBUG
 extern void OFBTreeDump(FILE *fp, const OFBTree *tree, void (*dumpValue)(FILE *fp, const OFBTree *btree, const void *value));
 #endif
@@ -7,6 +7,7 @@
 
 #import <OmniFoundation/OFBTree.h>
 
+#import <Foundation/NSException.h>
 #import <OmniBase/rcsid.h>
 
 RCS_ID("$Id$")
@@ -35,13 +36,6 @@ typedef struct _OFBTreeLeafNode {
     uint8_t contents[0];
 } OFBTreeLeafNode;
 
-/*" OFBTreeCursor holds the path from the tree's root to a location in the tree. "*/
-typedef struct _OFBTreeCursor {
-    OFBTreeChildPointer nodeStack[10];
-    void *selectionStack[10];
-    unsigned nodeStackDepth;
-} OFBTreeCursor;
-
 
 #ifdef DEBUG
 NSString *OFBTreeDescribeCursor(const OFBTree *tree, const OFBTreeCursor *cursor);
@@ -990,6 +984,238 @@ void *OFBTreeFindNear(const OFBTree *tree, const void *value, int offset, BOOL a
     return result;
 }
 
+/*"
+ Positions the cursor at the first element which compares greater than or equal to lowerBound, and returns that element. If there is no such element, returns NULL and the cursor should not be stepped.
+ "*/
+void *OFBTreeCursorSeek(const OFBTree *tree, OFBTreeCursor *cursor, const void *lowerBound)
+{
+    if (_OFBTreeFind(tree, cursor, lowerBound))
+        return cursor->selectionStack[cursor->nodeStackDepth];
+    
+    // The cursor is at a leaf, positioned at the notional insertion point. If that's a real element, it's our lower bound.
+    OBASSERT(_isAtLeafNode(tree, cursor));
+    unsigned depth = cursor->nodeStackDepth;
+    OFBTreeLeafNode *leaf = cursor->nodeStack[depth].leaf;
+    void *value = cursor->selectionStack[depth];
+    if (value < ELEMENT_AT_INDEX(leaf, LEAF_STRIDE(tree), leaf->elementCount))
+        return value;
+    
+    // Otherwise we're past the end of this leaf; the successor is the first ancestor selection which isn't past the end of its node.
+    ptrdiff_t stride = NODE_STRIDE(tree);
+    while (depth > 0) {
+        depth --;
+        OFBTreeNode *parent = cursor->nodeStack[depth].node;
+        value = cursor->selectionStack[depth];
+        if (value < ELEMENT_AT_INDEX(parent, stride, parent->elementCount)) {
+            cursor->nodeStackDepth = depth;
+            return value;
+        }
+    }
+    
+    return NULL;
+}
+
+void *OFBTreeCursorSeekFirst(const OFBTree *tree, OFBTreeCursor *cursor)
+{
+    cursor->nodeStackDepth = 0;
+    cursor->nodeStack[0] = tree->root;
+    return _OFBTreeSelectFirst(tree, cursor);
+}
+
+void *OFBTreeCursorSeekLast(const OFBTree *tree, OFBTreeCursor *cursor)
+{
+    cursor->nodeStackDepth = 0;
+    cursor->nodeStack[0] = tree->root;
+    return _OFBTreeSelectLast(tree, cursor);
+}
+
+void *OFBTreeCursorCurrent(const OFBTree *tree, const OFBTreeCursor *cursor)
+{
+    return cursor->selectionStack[cursor->nodeStackDepth];
+}
+
+void *OFBTreeCursorNext(const OFBTree *tree, OFBTreeCursor *cursor)
+{
+    return _OFBTreeCursorGreaterValue(tree, cursor);
+}
+
+void *OFBTreeCursorPrevious(const OFBTree *tree, OFBTreeCursor *cursor)
+{
+    return _OFBTreeCursorLesserValue(tree, cursor);
+}
+
+#pragma mark - Bulk loading
+
+/* Splits itemCount items (elements or separator entries) into nodes holding about targetCount items each, reserving one item between each pair of nodes to be promoted to the parent. Returns the number of nodes. */
+static size_t _OFBTreeBulkLoadNodeCount(size_t itemCount, size_t targetCount)
+{
+    size_t nodeCount = (itemCount + targetCount + 1) / (targetCount + 1); // ceil((itemCount + 1) / (targetCount + 1))
+    if (nodeCount < 1)
+        nodeCount = 1;
+    
+    // Every non-root node must end up with at least one item.
+    while (nodeCount > 1 && itemCount - (nodeCount - 1) < nodeCount)
+        nodeCount --;
+    
+    return nodeCount;
+}
+
+static size_t _OFBTreeBulkLoadTargetCount(size_t capacity, double fillFactor)
+{
+    size_t target = (size_t)(capacity * fillFactor);
+    if (target < 2)
+        target = 2;
+    if (target > capacity)
+        target = capacity;
+    return target;
+}
+
+/* The height of the tree that OFBTreeBulkLoad() would build with these targets. This follows the same arithmetic as the build itself. */
+static unsigned _OFBTreeBulkLoadHeight(const OFBTree *tree, size_t elementCount, size_t leafTarget, size_t internalTarget)
+{
+    size_t leafCount = _OFBTreeBulkLoadNodeCount(elementCount, leafTarget);
+    if (leafCount == 1 && elementCount <= tree->elementsPerLeafNode)
+        return 1;
+    
+    unsigned height = 1;
+    size_t entryCount = leafCount - 1;
+    while (entryCount > 0) {
+        size_t nodeCount = _OFBTreeBulkLoadNodeCount(entryCount, internalTarget);
+        if (nodeCount == 1 && entryCount > tree->elementsPerInternalNode)
+            nodeCount = 2;
+        entryCount = nodeCount - 1;
+        height ++;
+    }
+    return height;
+}
+
+#define OFBTreeMaximumHeight (sizeof(((OFBTreeCursor *)NULL)->nodeStack) / sizeof(OFBTreeChildPointer))
+
+void OFBTreeBulkLoad(OFBTree *tree, const void *elements, size_t elementCount, double fillFactor)
+{
+    OBPRECONDITION(tree->height == 1 && tree->root.leaf->elementCount == 0); // Only empty trees can be bulk loaded
+    OBPRECONDITION(fillFactor > 0 && fillFactor <= 1);
+    
+    const size_t elementSize = tree->elementSize;
+    const ptrdiff_t leafStride = LEAF_STRIDE(tree);
+    const ptrdiff_t nodeStride = NODE_STRIDE(tree);
+    
+#ifdef OMNI_ASSERTIONS_ON
+    for (size_t elementIndex = 1; elementIndex < elementCount; elementIndex ++) {
+        const void *a = elements + (elementIndex - 1) * elementSize;
+        const void *b = elements + elementIndex * elementSize;
+        OBASSERT(tree->elementCompare(tree, a, b) < 0, "Elements must be sorted and unique");
+    }
+#endif
+    
+    if (elementCount == 0)
+        return;
+    
+    size_t leafTarget = _OFBTreeBulkLoadTargetCount(tree->elementsPerLeafNode, fillFactor);
+    size_t internalTarget = _OFBTreeBulkLoadTargetCount(tree->elementsPerInternalNode, fillFactor);
+    
+    // A small fill factor can make the tree taller than a cursor can follow, in which case we fill the nodes completely instead. If even that is too tall, the tree couldn't hold these elements however they were added.
+    if (_OFBTreeBulkLoadHeight(tree, elementCount, leafTarget, internalTarget) > OFBTreeMaximumHeight) {
+        leafTarget = tree->elementsPerLeafNode;
+        internalTarget = tree->elementsPerInternalNode;
+        if (_OFBTreeBulkLoadHeight(tree, elementCount, leafTarget, internalTarget) > OFBTreeMaximumHeight)
+            [NSException raise:NSInvalidArgumentException format:@"OFBTreeBulkLoad: %zu elements would make the tree taller than %zu levels", elementCount, (size_t)OFBTreeMaximumHeight];
+    }
+    
+    size_t leafCount = _OFBTreeBulkLoadNodeCount(elementCount, leafTarget);
+    if (leafCount == 1 && elementCount <= tree->elementsPerLeafNode) {
+        // Everything fits in the existing root leaf.
+        memcpy(tree->root.leaf->contents, elements, elementCount * elementSize);
+        tree->root.leaf->elementCount = elementCount;
+        return;
+    }
+    
+    // Separator entries promoted from one level to the next, in the same layout as an internal node's contents: each element is followed by the pointer to the node on its right.
+    size_t entryCount = leafCount - 1;
+    void *entries = malloc(entryCount * nodeStride);
+    OFBTreeChildPointer leftmost;
+    
+    // Build the leaves, spreading the elements evenly so the last leaf isn't left nearly empty.
+    {
+        size_t perLeaf = (elementCount - entryCount) / leafCount;
+        size_t extra = (elementCount - entryCount) % leafCount;
+        const void *source = elements;
+        
+        tree->nodeDeallocator(tree, tree->root.leaf);
+        
+        for (size_t leafIndex = 0; leafIndex < leafCount; leafIndex ++) {
+            size_t count = perLeaf + (leafIndex < extra ? 1 : 0);
+            OBASSERT(count > 0 && count <= tree->elementsPerLeafNode);
+            
+            OFBTreeLeafNode *leaf = tree->nodeAllocator(tree);
+            leaf->elementCount = count;
+            memcpy(leaf->contents, source, count * leafStride);
+            source += count * leafStride;
+            
+            if (leafIndex == 0) {
+                leftmost.leaf = leaf;
+            } else {
+                // The previous separator's right child is this leaf
+                void *entry = entries + (leafIndex - 1) * nodeStride;
+                ((OFBTreeChildPointer *)(entry + elementSize))->leaf = leaf;
+            }
+            
+            if (leafIndex + 1 < leafCount) {
+                memcpy(entries + leafIndex * nodeStride, source, elementSize);
+                source += elementSize;
+            }
+        }
+        OBASSERT(source == elements + elementCount * elementSize);
+    }
+    
+    unsigned height = 1;
+    
+    // Build internal levels until everything fits under a single root. The entries buffer is rewritten in place, since each level consumes entries faster than it produces them.
+    while (entryCount > 0) {
+        size_t nodeCount = _OFBTreeBulkLoadNodeCount(entryCount, internalTarget);
+        if (nodeCount == 1 && entryCount > tree->elementsPerInternalNode)
+            nodeCount = 2;
+        size_t promotedCount = nodeCount - 1;
+        size_t perNode = (entryCount - promotedCount) / nodeCount;
+        size_t extra = (entryCount - promotedCount) % nodeCount;
+        const void *source = entries;
+        OFBTreeChildPointer childZero = leftmost;
+        
+        for (size_t nodeIndex = 0; nodeIndex < nodeCount; nodeIndex ++) {
+            size_t count = perNode + (nodeIndex < extra ? 1 : 0);
+            OBASSERT(count > 0 && count <= tree->elementsPerInternalNode);
+            
+            OFBTreeNode *node = tree->nodeAllocator(tree);
+            node->elementCount = count;
+            node->childZero = childZero;
+            memmove(node->contents, source, count * nodeStride);
+            source += count * nodeStride;
+            
+            if (nodeIndex == 0)
+                leftmost.node = node;
+            else
+                ((OFBTreeChildPointer *)(entries + (nodeIndex - 1) * nodeStride + elementSize))->node = node;
+            
+            if (nodeIndex + 1 < nodeCount) {
+                // Promote the next separator; its right child becomes the next node's childZero.
+                childZero = *(OFBTreeChildPointer *)(source + elementSize);
+                memmove(entries + nodeIndex * nodeStride, source, elementSize);
+                source += nodeStride;
+            }
+        }
+        
+        entryCount = promotedCount;
+        height ++;
+    }
+    
+    free(entries);
+    
+    OBASSERT(height == _OFBTreeBulkLoadHeight(tree, elementCount, leafTarget, internalTarget));
+    OBASSERT(height <= OFBTreeMaximumHeight);
+    tree->root = leftmost;
+    tree->height = height;
+}
+
 #ifdef DEBUG
 
 static void OFBTreeDumpElement(FILE *fp, const OFBTree *btree, const void *value)
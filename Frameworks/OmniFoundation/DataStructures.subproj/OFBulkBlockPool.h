@@ -47,6 +47,19 @@ extern void  OFBulkBlockPoolInitialize(OFBulkBlockPool *pool, size_t blockSize);
 extern void OFBulkBlockPoolDeallocateAllBlocks(OFBulkBlockPool *pool);
 // Frees all of the memory associated with the pool.  This does NOT deallocate the pool itself.  The caller is responsible for doing this.
 
+typedef struct _OFBulkBlockPoolStatistics {
+    size_t pageCount;
+    size_t blocksPerPage;
+    size_t liveBlockCount; // blocks handed out and not yet deallocated
+    size_t freeBlockCount; // blocks sitting on page free lists
+    size_t cachedBlockCount; // concurrent pools only: free blocks held in per-thread magazines and the depot
+    size_t reclaimedPageCount; // concurrent pools only: pages returned to the system after becoming completely free
+    double fragmentation; // fraction of the page capacity not occupied by live blocks
+} OFBulkBlockPoolStatistics;
+
+extern void OFBulkBlockPoolGetStatistics(OFBulkBlockPool *pool, OFBulkBlockPoolStatistics *statistics);
+// Fills in a summary of the pool's current memory use.
+
 extern void OFBulkBlockPoolReportStatistics(OFBulkBlockPool *pool);
 // Prints out a list of pages that are in use, how many blocks are used on each page and other interesting information
 
@@ -138,3 +151,30 @@ static inline void OFBulkBlockPoolDeallocate(OFByte *block)
 #endif
 }
 
+
+//
+// OFConcurrentBulkBlockPool is a thread-safe variant of OFBulkBlockPool for hot allocators that are shared between threads. Each thread allocates from and frees to its own pair of magazines (small stacks of free blocks) without taking any locks. Full and empty magazines are exchanged with the pool through a lock-free depot, so a block freed on a thread other than the one that allocated it just migrates to another thread's magazine. Only when the depot has nothing to offer (or is holding more free blocks than it should) is the page lock taken to carve blocks out of pages or return them. Pages whose blocks have all been returned are given back to the system.
+//
+// Blocks are page-aligned in the same way as OFBulkBlockPool, so OFConcurrentBulkBlockPoolDeallocate() does not need to be told which pool a block came from. Blocks from one kind of pool must never be passed to the other kind's deallocation function.
+
+typedef struct _OFConcurrentBulkBlockPool OFConcurrentBulkBlockPool;
+
+extern OFConcurrentBulkBlockPool *OFConcurrentBulkBlockPoolCreate(size_t blockSize);
+// Creates a pool which can allocate blocks of the given size.  No pages are allocated until the first block is requested.
+
+extern void OFConcurrentBulkBlockPoolDestroy(OFConcurrentBulkBlockPool *pool);
+// Frees all of the memory associated with the pool, including the pool itself.  No other thread may be using the pool when this is called.
+
+extern OFByte *OFConcurrentBulkBlockPoolAllocate(OFConcurrentBulkBlockPool *pool);
+// Allocates and returns a new block of memory.  The contents of the memory are indeterminant.  May be called from any thread.
+
+extern void OFConcurrentBulkBlockPoolDeallocate(OFByte *block);
+// Returns a block to its pool.  May be called from any thread, not just the one that allocated the block.
+
+extern void OFConcurrentBulkBlockPoolTrim(OFConcurrentBulkBlockPool *pool);
+// Returns the calling thread's cached blocks and every magazine in the depot to their pages, freeing any pages that become empty.
+
+extern void OFConcurrentBulkBlockPoolGetStatistics(OFConcurrentBulkBlockPool *pool, OFBulkBlockPoolStatistics *statistics);
+// Like OFBulkBlockPoolGetStatistics().  Other threads' magazines are sampled without stopping them, so the counts are approximate while the pool is in use.
+
+extern void OFConcurrentBulkBlockPoolReportStatistics(OFConcurrentBulkBlockPool *pool);
@@ -7,6 +7,11 @@
 
 #import <OmniFoundation/OFBulkBlockPool.h>
 
+#import <libkern/OSAtomic.h>
+#import <os/lock.h>
+#import <pthread.h>
+#import <stdatomic.h>
+
 RCS_ID("$Id$")
 
 size_t _OFBulkBlockPageSize;
@@ -130,10 +135,63 @@ void OFBulkBlockPoolDeallocateAllBlocks(OFBulkBlockPool *pool)
     }
 }
 
+static size_t _OFBulkBlockPoolBlocksPerPage(size_t allocationSize, size_t headerSize)
+{
+    return (_OFBulkBlockPageSize - headerSize) / allocationSize;
+}
+
+static size_t _OFBulkBlockPoolPageFreeCount(OFBulkBlockPool *pool, OFBulkBlockPage *page)
+{
+    size_t freeCount = 0;
+    void *freeBlock;
+    
+    if (page == pool->currentPage)
+        freeBlock = pool->freeList;
+    else
+        freeBlock = page->freeList;
+    while (freeBlock) {
+        freeBlock = *(void **)freeBlock;
+        freeCount++;
+    }
+    
+    return freeCount;
+}
+
+static void _OFBulkBlockPoolStatisticsFinish(OFBulkBlockPoolStatistics *statistics)
+{
+    size_t capacity = statistics->pageCount * statistics->blocksPerPage;
+    
+    statistics->liveBlockCount = capacity - statistics->freeBlockCount - statistics->cachedBlockCount;
+    if (capacity > 0)
+        statistics->fragmentation = 1.0 - (double)statistics->liveBlockCount / (double)capacity;
+    else
+        statistics->fragmentation = 0.0;
+}
+
+void OFBulkBlockPoolGetStatistics(OFBulkBlockPool *pool, OFBulkBlockPoolStatistics *statistics)
+{
+    memset(statistics, 0, sizeof(*statistics));
+    
+    statistics->pageCount = pool->pageCount;
+    statistics->blocksPerPage = _OFBulkBlockPoolBlocksPerPage(pool->allocationSize, sizeof(OFBulkBlockPage));
+    for (size_t pageIndex = 0; pageIndex < pool->pageCount; pageIndex++)
+        statistics->freeBlockCount += _OFBulkBlockPoolPageFreeCount(pool, pool->pages[pageIndex]);
+    
+    _OFBulkBlockPoolStatisticsFinish(statistics);
+}
+
+static void _OFBulkBlockPoolReportSummary(const OFBulkBlockPoolStatistics *statistics)
+{
+    fprintf(stderr, "  live blocks           = %" PRIiPTR "\n", statistics->liveBlockCount);
+    fprintf(stderr, "  free blocks           = %" PRIiPTR "\n", statistics->freeBlockCount);
+    fprintf(stderr, "  fragmentation         = %.1f%%\n", statistics->fragmentation * 100.0);
+}
+
 void OFBulkBlockPoolReportStatistics(OFBulkBlockPool *pool)
 {
     size_t pageIndex;
     size_t blocksPerPage;
+    OFBulkBlockPoolStatistics statistics;
 
     blocksPerPage = (NSPageSize() - sizeof(OFBulkBlockPage)) / pool->allocationSize;
     
@@ -143,25 +201,460 @@ void OFBulkBlockPoolReportStatistics(OFBulkBlockPool *pool)
     fprintf(stderr, "  blocks per page       = %" PRIiPTR "\n", blocksPerPage);
     fprintf(stderr, "  wasted bytes per page = %" PRIiPTR "\n", (size_t)NSPageSize() - blocksPerPage * pool->blockSize);
 
+    if (pool->pageCount > 0) {
+        OFBulkBlockPoolGetStatistics(pool, &statistics);
+        _OFBulkBlockPoolReportSummary(&statistics);
+    }
+
     for (pageIndex = 0; pageIndex < pool->pageCount; pageIndex++) {
         OFBulkBlockPage *page;
         size_t freeCount;
-        void *freeBlock;
         
         page = pool->pages[pageIndex];
-        freeCount = 0;
+        freeCount = _OFBulkBlockPoolPageFreeCount(pool, page);
 
-        if (page == pool->currentPage)
-            freeBlock = pool->freeList;
-        else
-            freeBlock = page->freeList;
-        while (freeBlock) {
-            freeBlock = *(void **)freeBlock;
-            freeCount++;
+        fprintf(stderr, "  page = %p, free blocks = %" PRIiPTR ", allocated blocks = %" PRIiPTR "\n", (void *)page, freeCount, blocksPerPage - freeCount);
+    }
+}
+
+#pragma mark - Concurrent pool
+
+// Number of blocks a magazine holds. Larger magazines mean fewer trips to the depot, but more memory parked in idle threads.
+#define OFBulkBlockMagazineCapacity (64)
+
+// The depot will hold at most this many full magazines; beyond that, returned magazines are drained back to their pages so that empty pages can be reclaimed.
+#define OFBulkBlockDepotFullMagazineLimit (16)
+
+typedef struct _OFBulkBlockMagazine {
+    struct _OFBulkBlockMagazine *depotLink; // Used by OSAtomicEnqueue() while the magazine sits in the depot
+    size_t count;
+    OFByte *blocks[OFBulkBlockMagazineCapacity];
+} OFBulkBlockMagazine;
+
+typedef struct _OFBulkBlockThreadCache {
+    struct _OFConcurrentBulkBlockPool *pool;
+    struct _OFBulkBlockThreadCache *previousCache, *nextCache; // All of the pool's thread caches, protected by the page lock
+    OFBulkBlockMagazine *loaded;
+    OFBulkBlockMagazine *previous;
+    _Atomic(size_t) cachedBlockCount; // Written only by the owning thread, read when gathering statistics
+} OFBulkBlockThreadCache;
+
+typedef struct _OFConcurrentBulkBlockPage {
+    OFByte *freeList; // Protected by the pool's page lock
+    struct _OFConcurrentBulkBlockPool *pool; // this backpointer allow us to free stuff w/o knowing the pool
+    size_t freeCount;
+    size_t pageIndex; // Our index in pool->pages
+    struct _OFConcurrentBulkBlockPage *previousPartial, *nextPartial; // Links in the list of pages with free blocks
+    BOOL onPartialList;
+    OFByte *data[0];
+} OFConcurrentBulkBlockPage;
+
+struct _OFConcurrentBulkBlockPool {
+    size_t blockSize;
+    size_t allocationSize;
+    size_t blocksPerPage;
+    pthread_key_t threadCacheKey;
+    
+    // The depot. Magazines move in and out of here without taking the page lock.
+    OSQueueHead fullMagazines;
+    OSQueueHead emptyMagazines;
+    _Atomic(size_t) fullMagazineCount;
+    
+    // Everything below is protected by pageLock
+    os_unfair_lock pageLock;
+    OFConcurrentBulkBlockPage **pages;
+    size_t pageCount;
+    size_t pageCapacity;
+    OFConcurrentBulkBlockPage *partialPages;
+    OFBulkBlockThreadCache *threadCaches;
+    size_t reclaimedPageCount;
+};
+
+static void _OFConcurrentBulkBlockPoolThreadCacheDestructor(void *value);
+
+OFConcurrentBulkBlockPool *OFConcurrentBulkBlockPoolCreate(size_t blockSize)
+{
+    OBPRECONDITION(blockSize >= sizeof(void *));
+    OBPRECONDITION(blockSize <= NSPageSize() - sizeof(OFConcurrentBulkBlockPage));
+    
+    _OFBulkBlockPageSize = NSPageSize();
+    
+    OFConcurrentBulkBlockPool *pool = calloc(1, sizeof(*pool));
+    pool->blockSize = blockSize;
+    pool->allocationSize = (blockSize + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+    pool->blocksPerPage = _OFBulkBlockPoolBlocksPerPage(pool->allocationSize, sizeof(OFConcurrentBulkBlockPage));
+    pool->fullMagazines = (OSQueueHead)OS_ATOMIC_QUEUE_INIT;
+    pool->emptyMagazines = (OSQueueHead)OS_ATOMIC_QUEUE_INIT;
+    atomic_init(&pool->fullMagazineCount, 0);
+    pool->pageLock = OS_UNFAIR_LOCK_INIT;
+    
+    int rc = pthread_key_create(&pool->threadCacheKey, _OFConcurrentBulkBlockPoolThreadCacheDestructor);
+    if (rc != 0) {
+        OBASSERT_NOT_REACHED("Unable to create thread cache key: %d", rc);
+        free(pool);
+        return NULL;
+    }
+    
+    return pool;
+}
+
+static void _OFConcurrentBulkBlockPoolFreeMagazines(OSQueueHead *queue)
+{
+    OFBulkBlockMagazine *magazine;
+    while ((magazine = OSAtomicDequeue(queue, offsetof(OFBulkBlockMagazine, depotLink))))
+        free(magazine);
+}
+
+void OFConcurrentBulkBlockPoolDestroy(OFConcurrentBulkBlockPool *pool)
+{
+    if (!pool)
+        return;
+    
+    // Once the key is deleted, exiting threads won't call back into the pool.
+    pthread_key_delete(pool->threadCacheKey);
+    
+    OFBulkBlockThreadCache *cache = pool->threadCaches;
+    while (cache) {
+        OFBulkBlockThreadCache *nextCache = cache->nextCache;
+        free(cache->loaded);
+        free(cache->previous);
+        free(cache);
+        cache = nextCache;
+    }
+    
+    _OFConcurrentBulkBlockPoolFreeMagazines(&pool->fullMagazines);
+    _OFConcurrentBulkBlockPoolFreeMagazines(&pool->emptyMagazines);
+    
+    for (size_t pageIndex = 0; pageIndex < pool->pageCount; pageIndex++)
+        NSDeallocateMemoryPages(pool->pages[pageIndex], _OFBulkBlockPageSize);
+    free(pool->pages);
+    free(pool);
+}
+
+static inline OFConcurrentBulkBlockPage *_OFConcurrentBulkBlockPageForBlock(OFByte *block)
+{
+    return (OFConcurrentBulkBlockPage *)((uintptr_t)block & ~(_OFBulkBlockPageSize-1));
+}
+
+static void _OFConcurrentBulkBlockPoolAddPartialPage_locked(OFConcurrentBulkBlockPool *pool, OFConcurrentBulkBlockPage *page)
+{
+    OBPRECONDITION(!page->onPartialList);
+    
+    page->previousPartial = NULL;
+    page->nextPartial = pool->partialPages;
+    if (pool->partialPages)
+        pool->partialPages->previousPartial = page;
+    pool->partialPages = page;
+    page->onPartialList = YES;
+}
+
+static void _OFConcurrentBulkBlockPoolRemovePartialPage_locked(OFConcurrentBulkBlockPool *pool, OFConcurrentBulkBlockPage *page)
+{
+    OBPRECONDITION(page->onPartialList);
+    
+    if (page->previousPartial)
+        page->previousPartial->nextPartial = page->nextPartial;
+    else
+        pool->partialPages = page->nextPartial;
+    if (page->nextPartial)
+        page->nextPartial->previousPartial = page->previousPartial;
+    page->previousPartial = page->nextPartial = NULL;
+    page->onPartialList = NO;
+}
+
+static OFConcurrentBulkBlockPage *_OFConcurrentBulkBlockPoolNewPage_locked(OFConcurrentBulkBlockPool *pool)
+{
+    if (pool->pageCount == pool->pageCapacity) {
+        pool->pageCapacity = MAX(pool->pageCapacity * 2, (size_t)16);
+        pool->pages = (typeof(pool->pages))realloc(pool->pages, sizeof(*pool->pages) * pool->pageCapacity);
+    }
+    
+    OFConcurrentBulkBlockPage *page = NSAllocateMemoryPages(_OFBulkBlockPageSize);
+    page->pool = pool;
+    page->pageIndex = pool->pageCount;
+    pool->pages[pool->pageCount++] = page;
+    
+    // Thread the free list through the new page
+    OFByte *block = (OFByte *)&page->data[0];
+    OFByte **link = &page->freeList;
+    for (size_t blockIndex = 0; blockIndex < pool->blocksPerPage; blockIndex++) {
+        *link = block;
+        link = (OFByte **)block;
+        block += pool->allocationSize;
+    }
+    *link = NULL;
+    page->freeCount = pool->blocksPerPage;
+    
+    _OFConcurrentBulkBlockPoolAddPartialPage_locked(pool, page);
+    return page;
+}
+
+static void _OFConcurrentBulkBlockPoolReleasePage_locked(OFConcurrentBulkBlockPool *pool, OFConcurrentBulkBlockPage *page)
+{
+    OBPRECONDITION(page->freeCount == pool->blocksPerPage);
+    
+    if (page->onPartialList)
+        _OFConcurrentBulkBlockPoolRemovePartialPage_locked(pool, page);
+    
+    // Move the last page into this page's slot
+    OFConcurrentBulkBlockPage *lastPage = pool->pages[pool->pageCount - 1];
+    pool->pages[page->pageIndex] = lastPage;
+    lastPage->pageIndex = page->pageIndex;
+    pool->pageCount--;
+    pool->reclaimedPageCount++;
+    
+    NSDeallocateMemoryPages(page, _OFBulkBlockPageSize);
+}
+
+// Fills an empty magazine with blocks carved from pages that have free space, allocating a new page if needed.
+static void _OFConcurrentBulkBlockPoolFillMagazine(OFConcurrentBulkBlockPool *pool, OFBulkBlockMagazine *magazine)
+{
+    OBPRECONDITION(magazine->count == 0);
+    
+    os_unfair_lock_lock(&pool->pageLock);
+    while (magazine->count < OFBulkBlockMagazineCapacity) {
+        OFConcurrentBulkBlockPage *page = pool->partialPages;
+        if (!page) {
+            if (magazine->count > 0)
+                break; // Don't allocate a new page just to top off the magazine
+            page = _OFConcurrentBulkBlockPoolNewPage_locked(pool);
+        }
+        
+        while (page->freeList && magazine->count < OFBulkBlockMagazineCapacity) {
+            OFByte *block = page->freeList;
+            page->freeList = *(OFByte **)block;
+            page->freeCount--;
+            magazine->blocks[magazine->count++] = block;
         }
+        
+        if (!page->freeList)
+            _OFConcurrentBulkBlockPoolRemovePartialPage_locked(pool, page);
+    }
+    os_unfair_lock_unlock(&pool->pageLock);
+    
+    OBPOSTCONDITION(magazine->count > 0);
+}
 
-        fprintf(stderr, "  page = %p, free blocks = %" PRIiPTR ", allocated blocks = %" PRIiPTR "\n", (void *)page, freeCount, blocksPerPage - freeCount);
+// Returns every block in the magazine to its page, releasing pages that become completely free.
+static void _OFConcurrentBulkBlockPoolDrainMagazine(OFConcurrentBulkBlockPool *pool, OFBulkBlockMagazine *magazine)
+{
+    if (magazine->count == 0)
+        return;
+    
+    os_unfair_lock_lock(&pool->pageLock);
+    while (magazine->count > 0) {
+        OFByte *block = magazine->blocks[--magazine->count];
+        OFConcurrentBulkBlockPage *page = _OFConcurrentBulkBlockPageForBlock(block);
+        OBASSERT(page->pool == pool);
+        
+        *(OFByte **)block = page->freeList;
+        page->freeList = block;
+        page->freeCount++;
+        
+        if (page->freeCount == pool->blocksPerPage)
+            _OFConcurrentBulkBlockPoolReleasePage_locked(pool, page);
+        else if (!page->onPartialList)
+            _OFConcurrentBulkBlockPoolAddPartialPage_locked(pool, page);
+    }
+    os_unfair_lock_unlock(&pool->pageLock);
+}
+
+static OFBulkBlockMagazine *_OFConcurrentBulkBlockPoolGetEmptyMagazine(OFConcurrentBulkBlockPool *pool)
+{
+    OFBulkBlockMagazine *magazine = OSAtomicDequeue(&pool->emptyMagazines, offsetof(OFBulkBlockMagazine, depotLink));
+    if (!magazine)
+        magazine = calloc(1, sizeof(*magazine));
+    OBASSERT(magazine->count == 0);
+    return magazine;
+}
+
+static OFBulkBlockMagazine *_OFConcurrentBulkBlockPoolGetFullMagazine(OFConcurrentBulkBlockPool *pool)
+{
+    OFBulkBlockMagazine *magazine = OSAtomicDequeue(&pool->fullMagazines, offsetof(OFBulkBlockMagazine, depotLink));
+    if (magazine)
+        atomic_fetch_sub_explicit(&pool->fullMagazineCount, 1, memory_order_relaxed);
+    return magazine;
+}
+
+static void _OFConcurrentBulkBlockPoolPutEmptyMagazine(OFConcurrentBulkBlockPool *pool, OFBulkBlockMagazine *magazine)
+{
+    OBPRECONDITION(magazine->count == 0);
+    OSAtomicEnqueue(&pool->emptyMagazines, magazine, offsetof(OFBulkBlockMagazine, depotLink));
+}
+
+static void _OFConcurrentBulkBlockPoolPutFullMagazine(OFConcurrentBulkBlockPool *pool, OFBulkBlockMagazine *magazine)
+{
+    OBPRECONDITION(magazine->count == OFBulkBlockMagazineCapacity);
+    
+    if (atomic_load_explicit(&pool->fullMagazineCount, memory_order_relaxed) >= OFBulkBlockDepotFullMagazineLimit) {
+        // The depot is already holding plenty of free blocks; give these back to their pages instead.
+        _OFConcurrentBulkBlockPoolDrainMagazine(pool, magazine);
+        _OFConcurrentBulkBlockPoolPutEmptyMagazine(pool, magazine);
+        return;
+    }
+    
+    atomic_fetch_add_explicit(&pool->fullMagazineCount, 1, memory_order_relaxed);
+    OSAtomicEnqueue(&pool->fullMagazines, magazine, offsetof(OFBulkBlockMagazine, depotLink));
+}
+
+static OFBulkBlockThreadCache *_OFConcurrentBulkBlockPoolThreadCache(OFConcurrentBulkBlockPool *pool)
+{
+    OFBulkBlockThreadCache *cache = pthread_getspecific(pool->threadCacheKey);
+    if (__builtin_expect(cache != NULL, 1))
+        return cache;
+    
+    cache = calloc(1, sizeof(*cache));
+    cache->pool = pool;
+    cache->loaded = _OFConcurrentBulkBlockPoolGetEmptyMagazine(pool);
+    cache->previous = _OFConcurrentBulkBlockPoolGetEmptyMagazine(pool);
+    atomic_init(&cache->cachedBlockCount, 0);
+    
+    os_unfair_lock_lock(&pool->pageLock);
+    cache->nextCache = pool->threadCaches;
+    if (pool->threadCaches)
+        pool->threadCaches->previousCache = cache;
+    pool->threadCaches = cache;
+    os_unfair_lock_unlock(&pool->pageLock);
+    
+    pthread_setspecific(pool->threadCacheKey, cache);
+    return cache;
+}
+
+static inline void _OFBulkBlockThreadCacheUpdateCount(OFBulkBlockThreadCache *cache)
+{
+    atomic_store_explicit(&cache->cachedBlockCount, cache->loaded->count + cache->previous->count, memory_order_relaxed);
+}
+
+static inline void _OFBulkBlockThreadCacheSwapMagazines(OFBulkBlockThreadCache *cache)
+{
+    OFBulkBlockMagazine *magazine = cache->loaded;
+    cache->loaded = cache->previous;
+    cache->previous = magazine;
+}
+
+OFByte *OFConcurrentBulkBlockPoolAllocate(OFConcurrentBulkBlockPool *pool)
+{
+    OBPRECONDITION(pool);
+    
+    OFBulkBlockThreadCache *cache = _OFConcurrentBulkBlockPoolThreadCache(pool);
+    
+    if (cache->loaded->count == 0) {
+        if (cache->previous->count > 0) {
+            _OFBulkBlockThreadCacheSwapMagazines(cache);
+        } else {
+            // Both magazines are empty. Trade one for a full magazine from the depot, or refill from the pages.
+            OFBulkBlockMagazine *full = _OFConcurrentBulkBlockPoolGetFullMagazine(pool);
+            if (full) {
+                _OFConcurrentBulkBlockPoolPutEmptyMagazine(pool, cache->previous);
+                cache->previous = cache->loaded;
+                cache->loaded = full;
+            } else {
+                _OFConcurrentBulkBlockPoolFillMagazine(pool, cache->loaded);
+            }
+        }
+    }
+    
+    OFByte *block = cache->loaded->blocks[--cache->loaded->count];
+    _OFBulkBlockThreadCacheUpdateCount(cache);
+    return block;
+}
+
+void OFConcurrentBulkBlockPoolDeallocate(OFByte *block)
+{
+    OBPRECONDITION(block);
+    
+    OFConcurrentBulkBlockPool *pool = _OFConcurrentBulkBlockPageForBlock(block)->pool;
+    OFBulkBlockThreadCache *cache = _OFConcurrentBulkBlockPoolThreadCache(pool);
+    
+    if (cache->loaded->count == OFBulkBlockMagazineCapacity) {
+        if (cache->previous->count == 0) {
+            _OFBulkBlockThreadCacheSwapMagazines(cache);
+        } else {
+            // Both magazines are full. Hand one to the depot and start on an empty one.
+            _OFConcurrentBulkBlockPoolPutFullMagazine(pool, cache->previous);
+            cache->previous = cache->loaded;
+            cache->loaded = _OFConcurrentBulkBlockPoolGetEmptyMagazine(pool);
+        }
     }
+    
+    cache->loaded->blocks[cache->loaded->count++] = block;
+    _OFBulkBlockThreadCacheUpdateCount(cache);
+}
+
+void OFConcurrentBulkBlockPoolTrim(OFConcurrentBulkBlockPool *pool)
+{
+    OFBulkBlockThreadCache *cache = pthread_getspecific(pool->threadCacheKey);
+    if (cache) {
+        _OFConcurrentBulkBlockPoolDrainMagazine(pool, cache->loaded);
+        _OFConcurrentBulkBlockPoolDrainMagazine(pool, cache->previous);
+        _OFBulkBlockThreadCacheUpdateCount(cache);
+    }
+    
+    OFBulkBlockMagazine *magazine;
+    while ((magazine = _OFConcurrentBulkBlockPoolGetFullMagazine(pool))) {
+        _OFConcurrentBulkBlockPoolDrainMagazine(pool, magazine);
+        _OFConcurrentBulkBlockPoolPutEmptyMagazine(pool, magazine);
+    }
+}
+
+static void _OFConcurrentBulkBlockPoolThreadCacheDestructor(void *value)
+{
+    OFBulkBlockThreadCache *cache = value;
+    OFConcurrentBulkBlockPool *pool = cache->pool;
+    
+    // Give our blocks back so that they aren't stranded with the exiting thread
+    _OFConcurrentBulkBlockPoolDrainMagazine(pool, cache->loaded);
+    _OFConcurrentBulkBlockPoolDrainMagazine(pool, cache->previous);
+    _OFConcurrentBulkBlockPoolPutEmptyMagazine(pool, cache->loaded);
+    _OFConcurrentBulkBlockPoolPutEmptyMagazine(pool, cache->previous);
+    
+    os_unfair_lock_lock(&pool->pageLock);
+    if (cache->previousCache)
+        cache->previousCache->nextCache = cache->nextCache;
+    else
+        pool->threadCaches = cache->nextCache;
+    if (cache->nextCache)
+        cache->nextCache->previousCache = cache->previousCache;
+    os_unfair_lock_unlock(&pool->pageLock);
+    
+    free(cache);
+}
+
+void OFConcurrentBulkBlockPoolGetStatistics(OFConcurrentBulkBlockPool *pool, OFBulkBlockPoolStatistics *statistics)
+{
+    memset(statistics, 0, sizeof(*statistics));
+    
+    statistics->blocksPerPage = pool->blocksPerPage;
+    statistics->cachedBlockCount = atomic_load_explicit(&pool->fullMagazineCount, memory_order_relaxed) * OFBulkBlockMagazineCapacity;
+    
+    os_unfair_lock_lock(&pool->pageLock);
+    statistics->pageCount = pool->pageCount;
+    statistics->reclaimedPageCount = pool->reclaimedPageCount;
+    for (size_t pageIndex = 0; pageIndex < pool->pageCount; pageIndex++)
+        statistics->freeBlockCount += pool->pages[pageIndex]->freeCount;
+    for (OFBulkBlockThreadCache *cache = pool->threadCaches; cache; cache = cache->nextCache)
+        statistics->cachedBlockCount += atomic_load_explicit(&cache->cachedBlockCount, memory_order_relaxed);
+    os_unfair_lock_unlock(&pool->pageLock);
+    
+    // Sampling other threads while they run can briefly overcount the cached blocks.
+    size_t capacity = statistics->pageCount * statistics->blocksPerPage;
+    if (statistics->freeBlockCount + statistics->cachedBlockCount > capacity)
+        statistics->cachedBlockCount = capacity - statistics->freeBlockCount;
+    
+    _OFBulkBlockPoolStatisticsFinish(statistics);
+}
+
+void OFConcurrentBulkBlockPoolReportStatistics(OFConcurrentBulkBlockPool *pool)
+{
+    OFBulkBlockPoolStatistics statistics;
+    OFConcurrentBulkBlockPoolGetStatistics(pool, &statistics);
+    
+    fprintf(stderr, "concurrent pool = %p\n", (void *)pool);
+    fprintf(stderr, "  number of pages       = %" PRIiPTR " (%" PRIiPTR " reclaimed)\n", statistics.pageCount, statistics.reclaimedPageCount);
+    fprintf(stderr, "  bytes per block       = %" PRIiPTR " (%" PRIiPTR " allocated)\n", pool->blockSize, pool->allocationSize);
+    fprintf(stderr, "  blocks per page       = %" PRIiPTR "\n", statistics.blocksPerPage);
+    fprintf(stderr, "  cached blocks         = %" PRIiPTR "\n", statistics.cachedBlockCount);
+    _OFBulkBlockPoolReportSummary(&statistics);
 }
 
 #ifdef TEST
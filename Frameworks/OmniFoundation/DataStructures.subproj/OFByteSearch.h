@@ -0,0 +1,41 @@
+// Copyright 2026 Omni Development, Inc. All rights reserved.
+//
+// This software may only be used and reproduced according to the
+// terms in the file OmniSourceLicense.html, which should be
+// distributed with this project and can also be found at
+// <http://www.omnigroup.com/developer/sourcecode/sourcelicense/>.
+
+#import <OmniFoundation/OFByteSet.h>
+
+#include <string.h>
+
+/*"
+Vectorized searches of byte buffers, used by the data cursors to find delimiters. Each returns the offset of the first match, or length if there is none.
+
+Byte set searches look up the low nibble of each byte in a pair of 16-byte tables and test the high nibble's bit in the result, sixteen or thirty-two bytes at a time (SSSE3 or AVX2 on Intel, NEON on ARM). The tables are kept in an OFByteSearchTable, which remembers the set it was built from so that a cursor can keep one around and only rebuild it when it is handed a different set. A zero-filled table is a valid table for the empty set.
+
+Searches for a multi-byte pattern compare the first and last bytes of the pattern at sixteen or thirty-two positions at once, and only compare the rest of the pattern where both match.
+
+The ...Scalar versions check one position at a time; they are here for differential testing and benchmarks.
+"*/
+
+typedef struct {
+    OFByte bitmap[OFByteSetBitmapRepLength]; // The set the rows were built from
+    OFByte rows[2][16]; // Indexed by low nibble; bit N of rows[0] is high nibble N, bit N of rows[1] is high nibble N+8
+} OFByteSearchTable;
+
+extern void OFByteSearchTableInitialize(OFByteSearchTable *table, OFByteSet *byteSet);
+
+static inline void OFByteSearchTableUpdate(OFByteSearchTable *table, OFByteSet *byteSet)
+{
+    if (memcmp(table->bitmap, byteSet->bitmapRep, OFByteSetBitmapRepLength) != 0)
+        OFByteSearchTableInitialize(table, byteSet);
+}
+
+extern size_t OFByteSearchForByte(const void *bytes, size_t length, OFByte byte);
+extern size_t OFByteSearchForByteInSet(const void *bytes, size_t length, const OFByteSearchTable *table);
+extern size_t OFByteSearchForBytes(const void *bytes, size_t length, const void *pattern, size_t patternLength); // Finds the first complete occurrence of the pattern
+
+extern size_t OFByteSearchForByteScalar(const void *bytes, size_t length, OFByte byte);
+extern size_t OFByteSearchForByteInSetScalar(const void *bytes, size_t length, const OFByteSearchTable *table);
+extern size_t OFByteSearchForBytesScalar(const void *bytes, size_t length, const void *pattern, size_t patternLength);
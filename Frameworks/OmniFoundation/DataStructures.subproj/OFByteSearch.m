@@ -0,0 +1,331 @@
+// Copyright 2026 Omni Development, Inc. All rights reserved.
+//
+// This software may only be used and reproduced according to the
+// terms in the file OmniSourceLicense.html, which should be
+// distributed with this project and can also be found at
+// <http://www.omnigroup.com/developer/sourcecode/sourcelicense/>.
+
+#import <OmniFoundation/OFByteSearch.h>
+
+#import <OmniBase/rcsid.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#import <immintrin.h>
+#define BYTE_SEARCH_AVX2 1
+#elif defined(__aarch64__)
+#import <arm_neon.h>
+#define BYTE_SEARCH_NEON 1
+#endif
+
+RCS_ID("$Id$")
+
+/*"
+Byte set membership is tested with the nibble table lookup described by Muła: the low nibble of each byte picks a row, and the high nibble picks a bit in that row. Eight bits per row aren't enough for sixteen high nibbles, so there are two sets of rows, and the byte's own sign bit picks between them. This is exact for any set, unlike the variants that assume the set fits in eight classes.
+
+Every kernel handles the end of the buffer by loading the last full vector again and discarding the positions it has already checked, so only buffers shorter than a vector go through the scalar loops. AVX2 is not part of the baseline for our Intel builds, so those kernels are compiled for it separately and only used when the processor reports it.
+"*/
+
+static inline BOOL _isByteInTable(OFByte byte, const OFByteSearchTable *table)
+{
+    return (table->bitmap[byte >> 3] & (1u << (byte & 7))) != 0;
+}
+
+void OFByteSearchTableInitialize(OFByteSearchTable *table, OFByteSet *byteSet)
+{
+    memcpy(table->bitmap, byteSet->bitmapRep, OFByteSetBitmapRepLength);
+    memset(table->rows, 0, sizeof(table->rows));
+
+    for (unsigned int byte = 0; byte < 256; byte++) {
+        if (_isByteInTable((OFByte)byte, table))
+            table->rows[byte >> 7][byte & 0x0f] |= (OFByte)(1u << ((byte >> 4) & 7));
+    }
+}
+
+#pragma mark - Scalar reference
+
+size_t OFByteSearchForByteScalar(const void *bytes, size_t length, OFByte byte)
+{
+    const OFByte *p = bytes;
+    for (size_t offset = 0; offset < length; offset++) {
+        if (p[offset] == byte)
+            return offset;
+    }
+    return length;
+}
+
+size_t OFByteSearchForByteInSetScalar(const void *bytes, size_t length, const OFByteSearchTable *table)
+{
+    const OFByte *p = bytes;
+    for (size_t offset = 0; offset < length; offset++) {
+        if (_isByteInTable(p[offset], table))
+            return offset;
+    }
+    return length;
+}
+
+size_t OFByteSearchForBytesScalar(const void *bytes, size_t length, const void *pattern, size_t patternLength)
+{
+    if (patternLength == 0)
+        return 0;
+    if (patternLength > length)
+        return length;
+
+    const OFByte *p = bytes;
+    for (size_t offset = 0; offset <= length - patternLength; offset++) {
+        if (memcmp(p + offset, pattern, patternLength) == 0)
+            return offset;
+    }
+    return length;
+}
+
+#pragma mark - SSE2, SSSE3 and AVX2
+
+#if BYTE_SEARCH_AVX2
+
+static BOOL _hasAVX2(void)
+{
+#ifdef __AVX2__
+    return YES;
+#else
+    static int hasAVX2 = -1;
+    if (hasAVX2 < 0)
+        hasAVX2 = __builtin_cpu_supports("avx2") ? 1 : 0;
+    return hasAVX2 != 0;
+#endif
+}
+
+#ifdef __SSSE3__
+
+static inline unsigned int _byteSetMatchesSSSE3(__m128i bytes, __m128i rows0, __m128i rows1)
+{
+    const __m128i nibbleMask = _mm_set1_epi8(0x0f);
+    const __m128i bits = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+
+    __m128i lowNibbles = _mm_and_si128(bytes, nibbleMask);
+    __m128i highNibbles = _mm_and_si128(_mm_srli_epi16(bytes, 4), nibbleMask);
+    __m128i upperHalf = _mm_cmplt_epi8(bytes, _mm_setzero_si128());
+    __m128i row = _mm_or_si128(_mm_andnot_si128(upperHalf, _mm_shuffle_epi8(rows0, lowNibbles)), _mm_and_si128(upperHalf, _mm_shuffle_epi8(rows1, lowNibbles)));
+    __m128i hits = _mm_and_si128(row, _mm_shuffle_epi8(bits, highNibbles));
+
+    return ~(unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(hits, _mm_setzero_si128())) & 0xffff;
+}
+
+static size_t _searchForByteInSetSSSE3(const OFByte *bytes, size_t length, const OFByteSearchTable *table)
+{
+    __m128i rows0 = _mm_loadu_si128((const __m128i *)table->rows[0]);
+    __m128i rows1 = _mm_loadu_si128((const __m128i *)table->rows[1]);
+
+    size_t offset;
+    for (offset = 0; offset + 16 <= length; offset += 16) {
+        unsigned int matches = _byteSetMatchesSSSE3(_mm_loadu_si128((const __m128i *)(bytes + offset)), rows0, rows1);
+        if (matches != 0)
+            return offset + (size_t)__builtin_ctz(matches);
+    }
+    if (offset < length) {
+        unsigned int alreadyChecked = (unsigned int)(16 - (length - offset));
+        unsigned int matches = _byteSetMatchesSSSE3(_mm_loadu_si128((const __m128i *)(bytes + length - 16)), rows0, rows1) >> alreadyChecked;
+        if (matches != 0)
+            return offset + (size_t)__builtin_ctz(matches);
+    }
+    return length;
+}
+
+#endif
+
+__attribute__((target("avx2")))
+static inline uint32_t _byteSetMatchesAVX2(__m256i bytes, __m256i rows0, __m256i rows1)
+{
+    const __m256i nibbleMask = _mm256_set1_epi8(0x0f);
+    const __m256i bits = _mm256_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+
+    __m256i lowNibbles = _mm256_and_si256(bytes, nibbleMask);
+    __m256i highNibbles = _mm256_and_si256(_mm256_srli_epi16(bytes, 4), nibbleMask);
+    __m256i upperHalf = _mm256_cmpgt_epi8(_mm256_setzero_si256(), bytes);
+    __m256i row = _mm256_blendv_epi8(_mm256_shuffle_epi8(rows0, lowNibbles), _mm256_shuffle_epi8(rows1, lowNibbles), upperHalf);
+    __m256i hits = _mm256_and_si256(row, _mm256_shuffle_epi8(bits, highNibbles));
+
+    return ~(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(hits, _mm256_setzero_si256()));
+}
+
+__attribute__((target("avx2")))
+static size_t _searchForByteInSetAVX2(const OFByte *bytes, size_t length, const OFByteSearchTable *table)
+{
+    // The shuffles only look within each 128-bit lane, so each lane gets its own copy of the rows.
+    __m256i rows0 = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)table->rows[0]));
+    __m256i rows1 = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)table->rows[1]));
+
+    size_t offset;
+    for (offset = 0; offset + 32 <= length; offset += 32) {
+        uint32_t matches = _byteSetMatchesAVX2(_mm256_loadu_si256((const __m256i *)(bytes + offset)), rows0, rows1);
+        if (matches != 0)
+            return offset + (size_t)__builtin_ctz(matches);
+    }
+    if (offset < length) {
+        unsigned int alreadyChecked = (unsigned int)(32 - (length - offset));
+        uint32_t matches = _byteSetMatchesAVX2(_mm256_loadu_si256((const __m256i *)(bytes + length - 32)), rows0, rows1) >> alreadyChecked;
+        if (matches != 0)
+            return offset + (size_t)__builtin_ctz(matches);
+    }
+    return length;
+}
+
+#ifdef __SSE2__
+
+static size_t _searchForBytesSSE2(const OFByte *bytes, size_t length, const OFByte *pattern, size_t patternLength)
+{
+    const __m128i first = _mm_set1_epi8((char)pattern[0]);
+    const __m128i last = _mm_set1_epi8((char)pattern[patternLength - 1]);
+    size_t lastIndex = patternLength - 1;
+
+    size_t offset;
+    for (offset = 0; offset + lastIndex + 16 <= length; offset += 16) {
+        __m128i firstMatches = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(bytes + offset)), first);
+        __m128i lastMatches = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(bytes + offset + lastIndex)), last);
+        unsigned int candidates = (unsigned int)_mm_movemask_epi8(_mm_and_si128(firstMatches, lastMatches));
+        while (candidates != 0) {
+            size_t candidate = offset + (size_t)__builtin_ctz(candidates);
+            if (memcmp(bytes + candidate + 1, pattern + 1, patternLength - 2) == 0)
+                return candidate;
+            candidates &= candidates - 1;
+        }
+    }
+    return offset + OFByteSearchForBytesScalar(bytes + offset, length - offset, pattern, patternLength);
+}
+
+#endif
+
+__attribute__((target("avx2")))
+static size_t _searchForBytesAVX2(const OFByte *bytes, size_t length, const OFByte *pattern, size_t patternLength)
+{
+    const __m256i first = _mm256_set1_epi8((char)pattern[0]);
+    const __m256i last = _mm256_set1_epi8((char)pattern[patternLength - 1]);
+    size_t lastIndex = patternLength - 1;
+
+    size_t offset;
+    for (offset = 0; offset + lastIndex + 32 <= length; offset += 32) {
+        __m256i firstMatches = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(bytes + offset)), first);
+        __m256i lastMatches = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(bytes + offset + lastIndex)), last);
+        uint32_t candidates = (uint32_t)_mm256_movemask_epi8(_mm256_and_si256(firstMatches, lastMatches));
+        while (candidates != 0) {
+            size_t candidate = offset + (size_t)__builtin_ctz(candidates);
+            if (memcmp(bytes + candidate + 1, pattern + 1, patternLength - 2) == 0)
+                return candidate;
+            candidates &= candidates - 1;
+        }
+    }
+    return offset + OFByteSearchForBytesScalar(bytes + offset, length - offset, pattern, patternLength);
+}
+
+#endif
+
+#pragma mark - NEON
+
+#if BYTE_SEARCH_NEON
+
+// NEON has no movemask; narrowing each 16-bit lane by four bits leaves four bits per byte in a 64-bit value.
+static inline uint64_t _matchMaskNEON(uint8x16_t matches)
+{
+    return vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(matches), 4)), 0);
+}
+
+static inline uint64_t _byteSetMatchesNEON(uint8x16_t bytes, uint8x16_t rows0, uint8x16_t rows1, uint8x16_t bits)
+{
+    uint8x16_t lowNibbles = vandq_u8(bytes, vdupq_n_u8(0x0f));
+    uint8x16_t highNibbles = vshrq_n_u8(bytes, 4);
+    uint8x16_t upperHalf = vreinterpretq_u8_s8(vshrq_n_s8(vreinterpretq_s8_u8(bytes), 7));
+    uint8x16_t row = vbslq_u8(upperHalf, vqtbl1q_u8(rows1, lowNibbles), vqtbl1q_u8(rows0, lowNibbles));
+
+    return _matchMaskNEON(vtstq_u8(row, vqtbl1q_u8(bits, highNibbles)));
+}
+
+static size_t _searchForByteInSetNEON(const OFByte *bytes, size_t length, const OFByteSearchTable *table)
+{
+    static const OFByte bitValues[16] = {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+    uint8x16_t rows0 = vld1q_u8(table->rows[0]);
+    uint8x16_t rows1 = vld1q_u8(table->rows[1]);
+    uint8x16_t bits = vld1q_u8(bitValues);
+
+    size_t offset;
+    for (offset = 0; offset + 16 <= length; offset += 16) {
+        uint64_t matches = _byteSetMatchesNEON(vld1q_u8(bytes + offset), rows0, rows1, bits);
+        if (matches != 0)
+            return offset + (size_t)(__builtin_ctzll(matches) >> 2);
+    }
+    if (offset < length) {
+        unsigned int alreadyChecked = (unsigned int)(16 - (length - offset));
+        uint64_t matches = _byteSetMatchesNEON(vld1q_u8(bytes + length - 16), rows0, rows1, bits) >> (4 * alreadyChecked);
+        if (matches != 0)
+            return offset + (size_t)(__builtin_ctzll(matches) >> 2);
+    }
+    return length;
+}
+
+static size_t _searchForBytesNEON(const OFByte *bytes, size_t length, const OFByte *pattern, size_t patternLength)
+{
+    const uint8x16_t first = vdupq_n_u8(pattern[0]);
+    const uint8x16_t last = vdupq_n_u8(pattern[patternLength - 1]);
+    size_t lastIndex = patternLength - 1;
+
+    size_t offset;
+    for (offset = 0; offset + lastIndex + 16 <= length; offset += 16) {
+        uint8x16_t firstMatches = vceqq_u8(vld1q_u8(bytes + offset), first);
+        uint8x16_t lastMatches = vceqq_u8(vld1q_u8(bytes + offset + lastIndex), last);
+        uint64_t candidates = _matchMaskNEON(vandq_u8(firstMatches, lastMatches)) & 0x1111111111111111ULL;
+        while (candidates != 0) {
+            size_t candidate = offset + (size_t)(__builtin_ctzll(candidates) >> 2);
+            if (memcmp(bytes + candidate + 1, pattern + 1, patternLength - 2) == 0)
+                return candidate;
+            candidates &= candidates - 1;
+        }
+    }
+    return offset + OFByteSearchForBytesScalar(bytes + offset, length - offset, pattern, patternLength);
+}
+
+#endif
+
+#pragma mark - Dispatch
+
+size_t OFByteSearchForByte(const void *bytes, size_t length, OFByte byte)
+{
+    // The system memchr is already vectorized for every architecture we build for.
+    const OFByte *found = memchr(bytes, byte, length);
+    return found != NULL ? (size_t)(found - (const OFByte *)bytes) : length;
+}
+
+size_t OFByteSearchForByteInSet(const void *bytes, size_t length, const OFByteSearchTable *table)
+{
+#if BYTE_SEARCH_AVX2
+    if (length >= 32 && _hasAVX2())
+        return _searchForByteInSetAVX2(bytes, length, table);
+#endif
+#if defined(__SSSE3__)
+    if (length >= 16)
+        return _searchForByteInSetSSSE3(bytes, length, table);
+#elif BYTE_SEARCH_NEON
+    if (length >= 16)
+        return _searchForByteInSetNEON(bytes, length, table);
+#endif
+    return OFByteSearchForByteInSetScalar(bytes, length, table);
+}
+
+size_t OFByteSearchForBytes(const void *bytes, size_t length, const void *pattern, size_t patternLength)
+{
+    if (patternLength == 0)
+        return 0;
+    if (patternLength > length)
+        return length;
+    if (patternLength == 1)
+        return OFByteSearchForByte(bytes, length, *(const OFByte *)pattern);
+
+#if BYTE_SEARCH_AVX2
+    if (_hasAVX2())
+        return _searchForBytesAVX2(bytes, length, pattern, patternLength);
+#endif
+#if defined(__SSE2__)
+    return _searchForBytesSSE2(bytes, length, pattern, patternLength);
+#elif BYTE_SEARCH_NEON
+    return _searchForBytesNEON(bytes, length, pattern, patternLength);
+#else
+    return OFByteSearchForBytesScalar(bytes, length, pattern, patternLength);
+#endif
+}
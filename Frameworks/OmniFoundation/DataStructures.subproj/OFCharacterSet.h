@@ -67,3 +67,7 @@ static inline void OFCharacterSetRemoveCharacter(OFCharacterSet *unicharSet, uni
 {
     unicharSet->bitmapRep[character >> 3] &= ~(((unsigned)1) << (character & 7));
 }
+
+// Return the first character in [characters, end) that is (or isn't) in the set, or end if there is none. Runs of ASCII are tested sixteen characters at a time.
+extern unichar *OFCharacterSetFindMember(OFCharacterSet *unicharSet, const unichar *characters, const unichar *end);
+extern unichar *OFCharacterSetFindNonMember(OFCharacterSet *unicharSet, const unichar *characters, const unichar *end);
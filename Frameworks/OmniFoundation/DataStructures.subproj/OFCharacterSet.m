@@ -10,6 +10,12 @@
 #import <OmniFoundation/NSString-OFUnicodeCharacters.h>
 #import <OmniBase/OBObject.h>
 
+#if defined(__SSSE3__)
+#import <tmmintrin.h>
+#elif defined(__aarch64__)
+#import <arm_neon.h>
+#endif
+
 RCS_ID("$Id$");
 
 @implementation OFCharacterSet
@@ -245,3 +251,134 @@ RCS_ID("$Id$");
 }
 
 @end
+
+#pragma mark - Scanning
+
+/*"
+The first sixteen bytes of the bitmap are the membership bits for ASCII, so the vector kernels test sixteen characters at a time against them directly: each character's low seven bits pick a byte of the mask (with a shuffle) and a bit within it. Characters outside ASCII are reported as candidates and checked against the full bitmap one at a time, so a run of non-ASCII text costs about what the scalar loop does, while markup and headers never touch the bitmap.
+
+Masks have one bit per character with SSSE3. NEON has no movemask, so there they have four bits per character, of which the low one is used.
+"*/
+
+#if defined(__SSSE3__)
+
+#define VECTOR_LANE_BITS 1
+
+static inline void _classifyCharacters(const unichar *characters, __m128i asciiMask, BOOL wantMember, uint64_t *outCandidates, uint64_t *outASCIILanes)
+{
+    const __m128i bitValues = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+    const __m128i nonASCIIBits = _mm_set1_epi16((short)0xff80);
+    const __m128i asciiBits = _mm_set1_epi16(0x007f);
+
+    __m128i first = _mm_loadu_si128((const __m128i *)characters);
+    __m128i second = _mm_loadu_si128((const __m128i *)(characters + 8));
+
+    __m128i asciiLanes = _mm_packs_epi16(_mm_cmpeq_epi16(_mm_and_si128(first, nonASCIIBits), _mm_setzero_si128()), _mm_cmpeq_epi16(_mm_and_si128(second, nonASCIIBits), _mm_setzero_si128()));
+    __m128i bytes = _mm_packus_epi16(_mm_and_si128(first, asciiBits), _mm_and_si128(second, asciiBits));
+    __m128i maskBytes = _mm_shuffle_epi8(asciiMask, _mm_and_si128(_mm_srli_epi16(bytes, 3), _mm_set1_epi8(0x0f)));
+    __m128i bits = _mm_shuffle_epi8(bitValues, _mm_and_si128(bytes, _mm_set1_epi8(0x07)));
+
+    uint64_t nonMembers = (uint64_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(maskBytes, bits), _mm_setzero_si128()));
+    uint64_t ascii = (uint64_t)_mm_movemask_epi8(asciiLanes);
+    uint64_t matches = wantMember ? ~nonMembers : nonMembers;
+
+    *outCandidates = ((matches & ascii) | ~ascii) & 0xffff;
+    *outASCIILanes = ascii;
+}
+
+#define LOAD_ASCII_MASK(set) _mm_loadu_si128((const __m128i *)(set)->bitmapRep)
+typedef __m128i ASCIIMask;
+
+#elif defined(__aarch64__)
+
+#define VECTOR_LANE_BITS 4
+
+static inline uint64_t _laneMask(uint8x16_t lanes)
+{
+    return vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(lanes), 4)), 0) & 0x1111111111111111ULL;
+}
+
+static inline void _classifyCharacters(const unichar *characters, uint8x16_t asciiMask, BOOL wantMember, uint64_t *outCandidates, uint64_t *outASCIILanes)
+{
+    static const uint8_t bitValues[16] = {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+    const uint16x8_t nonASCIIBits = vdupq_n_u16(0xff80);
+    const uint16x8_t asciiBits = vdupq_n_u16(0x007f);
+
+    uint16x8_t first = vld1q_u16(characters);
+    uint16x8_t second = vld1q_u16(characters + 8);
+
+    uint8x16_t asciiLanes = vcombine_u8(vmovn_u16(vceqq_u16(vandq_u16(first, nonASCIIBits), vdupq_n_u16(0))), vmovn_u16(vceqq_u16(vandq_u16(second, nonASCIIBits), vdupq_n_u16(0))));
+    uint8x16_t bytes = vcombine_u8(vmovn_u16(vandq_u16(first, asciiBits)), vmovn_u16(vandq_u16(second, asciiBits)));
+    uint8x16_t members = vtstq_u8(vqtbl1q_u8(asciiMask, vshrq_n_u8(bytes, 3)), vqtbl1q_u8(vld1q_u8(bitValues), vandq_u8(bytes, vdupq_n_u8(0x07))));
+    uint8x16_t matches = wantMember ? members : vmvnq_u8(members);
+
+    *outCandidates = _laneMask(vorrq_u8(vandq_u8(matches, asciiLanes), vmvnq_u8(asciiLanes)));
+    *outASCIILanes = _laneMask(asciiLanes);
+}
+
+#define LOAD_ASCII_MASK(set) vld1q_u8((set)->bitmapRep)
+typedef uint8x16_t ASCIIMask;
+
+#endif
+
+#ifdef VECTOR_LANE_BITS
+
+static inline const unichar *_firstCandidate(OFCharacterSet *set, const unichar *characters, uint64_t candidates, uint64_t asciiLanes, BOOL wantMember)
+{
+    while (candidates != 0) {
+        unsigned int bit = (unsigned int)__builtin_ctzll(candidates);
+        if ((asciiLanes & (1ULL << bit)) != 0 || OFCharacterSetHasMember(set, characters[bit / VECTOR_LANE_BITS]) == wantMember)
+            return characters + bit / VECTOR_LANE_BITS;
+        candidates &= candidates - 1;
+    }
+    return NULL;
+}
+
+#endif
+
+static inline unichar *_findCharacter(OFCharacterSet *set, const unichar *characters, const unichar *end, BOOL wantMember)
+{
+    OBPRECONDITION(characters <= end);
+
+    const unichar *scan = characters;
+
+#ifdef VECTOR_LANE_BITS
+    if (end - characters >= 16) {
+        ASCIIMask asciiMask = LOAD_ASCII_MASK(set);
+        uint64_t candidates, asciiLanes;
+
+        for (; end - scan >= 16; scan += 16) {
+            _classifyCharacters(scan, asciiMask, wantMember, &candidates, &asciiLanes);
+            const unichar *found = _firstCandidate(set, scan, candidates, asciiLanes, wantMember);
+            if (found != NULL)
+                return (unichar *)found;
+        }
+
+        if (scan < end) {
+            // Look at the last sixteen characters again, ignoring the ones already checked.
+            unsigned int alreadyChecked = (unsigned int)(16 - (end - scan)) * VECTOR_LANE_BITS;
+            _classifyCharacters(end - 16, asciiMask, wantMember, &candidates, &asciiLanes);
+            const unichar *found = _firstCandidate(set, scan, candidates >> alreadyChecked, asciiLanes >> alreadyChecked, wantMember);
+            if (found != NULL)
+                return (unichar *)found;
+        }
+        return (unichar *)end;
+    }
+#endif
+
+    for (; scan < end; scan++) {
+        if (OFCharacterSetHasMember(set, *scan) == wantMember)
+            break;
+    }
+    return (unichar *)scan;
+}
+
+unichar *OFCharacterSetFindMember(OFCharacterSet *set, const unichar *characters, const unichar *end)
+{
+    return _findCharacter(set, characters, end, YES);
+}
+
+unichar *OFCharacterSetFindNonMember(OFCharacterSet *set, const unichar *characters, const unichar *end)
+{
+    return _findCharacter(set, characters, end, NO);
+}
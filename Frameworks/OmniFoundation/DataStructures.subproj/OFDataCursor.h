@@ -20,6 +20,7 @@ typedef enum {
 
 #import <Foundation/NSString.h> // For NSStringEncoding
 #import <OmniFoundation/OFByte.h>
+#import <OmniFoundation/OFByteSearch.h>
 
 @interface OFDataCursor : OFObject
 {
@@ -30,6 +31,8 @@ typedef enum {
     size_t dataLength;
     const OFByte *startPosition, *endPosition;
     const OFByte *currentPosition;
+
+    OFByteSearchTable byteSetSearchTable; // For the last byte set we were asked to scan for
 }
 
 - (instancetype)initWithData:(NSData *)someData;
@@ -210,26 +210,14 @@ static OFByteSet *endOfLineByteSet;
 
 static inline size_t offsetToByte(OFDataCursor *self, OFByte aByte)
 {
-    const OFByte *offset;
-
-    for (offset = self->currentPosition; offset < self->endPosition; offset++)
-        if (*(OFByte *)offset == aByte)
-	    break;
-    return offset - self->currentPosition;
+    return OFByteSearchForByte(self->currentPosition, self->endPosition - self->currentPosition, aByte);
 }
 
 static inline size_t
 offsetToByteInSet(OFDataCursor *self, OFByteSet *byteSet)
 {
-    const OFByte *offset;
-    OFByte aByte;
-
-    for (offset = self->currentPosition; offset < self->endPosition; offset++) {
-        aByte = *(OFByte *)offset;
-	if (isByteInByteSet(aByte, byteSet))
-	    break;
-    }
-    return offset - self->currentPosition;
+    OFByteSearchTableUpdate(&self->byteSetSearchTable, byteSet);
+    return OFByteSearchForByteInSet(self->currentPosition, self->endPosition - self->currentPosition, &self->byteSetSearchTable);
 }
 
 - (size_t)offsetToByte:(OFByte)aByte;
@@ -19,10 +19,16 @@ extern uint64_t OFRandomNextState64(OFRandomState *state);
 extern unsigned int OFRandomNextStateN(OFRandomState *state, unsigned int n);
 extern double OFRandomNextStateDouble(OFRandomState *state);
 
-// Version that use a global shared state. Not thread-safe.
+// Fill a whole array at once; this produces the same values as calling OFRandomNextState64/OFRandomNextStateDouble repeatedly, but generates full blocks with the SIMD version of the generator. Best with 16-byte aligned arrays of a few thousand values or more.
+extern void OFRandomStateFill64(OFRandomState *state, uint64_t *values, size_t count);
+extern void OFRandomStateFillDouble(OFRandomState *state, double *values, size_t count);
+
+// Versions that use a per-thread state, created on first use. Thread-safe and uncontended.
 extern uint32_t OFRandomNext32(void);
 extern uint64_t OFRandomNext64(void);
 extern double OFRandomNextDouble(void);
+extern void OFRandomFill64(uint64_t *values, size_t count);
+extern void OFRandomFillDouble(double *values, size_t count);
 
 extern NSData *OFRandomStateCreateDataOfLength(OFRandomState *state, NSUInteger byteCount) NS_RETURNS_RETAINED;
 extern NSData *OFRandomCreateDataOfLength(NSUInteger byteCount) NS_RETURNS_RETAINED;
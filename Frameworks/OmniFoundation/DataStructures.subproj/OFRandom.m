@@ -9,6 +9,8 @@
 
 #import <OmniBase/system.h>
 #import <inttypes.h> // For PRIu8
+#import <pthread.h>
+#import <stdatomic.h>
 
 RCS_ID("$Id$")
 
@@ -22,13 +24,21 @@ RCS_ID("$Id$")
 
  most of this is for speed, but we'll turn on the defines here and add -fno-strict-aliasing as a per-file compile option.
  
- Note that we do not export the float/batch generators. There are some comments in SFMT that you have to re-seed when switching generation methods and in fact we hit assertions if we might 32 and 64 generation.  So, we always generate 64 here and truncate to 32 if that's all the caller wanted.
+ Note that we do not export the float generators. There are some comments in SFMT that you have to re-seed when switching generation methods and in fact we hit assertions if we might 32 and 64 generation.  So, we always generate 64 here and truncate to 32 if that's all the caller wanted. The batch generator (fill_array64) is only used on block boundaries, where it continues the same sequence as gen_rand64.
+ 
+ The SSE2 version of the recursion is used on Intel; we added a NEON version for ARM.
  */
 #ifndef DEBUG
     #define NDEBUG
 #endif
 #define MEXP 19937
 
+#if defined(__SSE2__)
+    #define HAVE_SSE2
+#elif defined(__ARM_NEON)
+    #define HAVE_NEON
+#endif
+
 // We also added this to make all the functions that would normally be extern be static.
 #define OF_EMBEDDED
 
@@ -37,10 +47,8 @@ RCS_ID("$Id$")
 /*
  Gathers several sources of random state, including some from /dev/urandom. If the entropy pool is low, though, that may not be great, so we gather some from the time.
  */
-OFRandomState *OFRandomStateCreate(void)
+static void _OFRandomGatherSeed(uint32_t seed[4])
 {
-    uint32_t seed[4];
-    
     FILE *urandomDevice = fopen("/dev/urandom", "r");	// use /dev/urandom instead of /dev/random because the latter can block
     if (urandomDevice != NULL) {
         // 64-bits from urandom, to whatever extent it can provide it.
@@ -52,7 +60,12 @@ OFRandomState *OFRandomStateCreate(void)
     CFAbsoluteTime ti = CFAbsoluteTimeGetCurrent();
     OBASSERT(sizeof(ti) == 2*sizeof(uint32_t));
     memcpy(&seed[2], &ti, sizeof(ti));
-    
+}
+
+OFRandomState *OFRandomStateCreate(void)
+{
+    uint32_t seed[4];
+    _OFRandomGatherSeed(seed);
     return OFRandomStateCreateWithSeed32(seed, 4);
 }
 
@@ -112,85 +125,121 @@ double OFRandomNextStateDouble(OFRandomState *state)
     return to_res53(OFRandomNextState64(state)); // same as genrand_res53, but tries to pretend we have state
 }
 
-static void _withDefaultRandomState(void (^block)(OFRandomState *))
+void OFRandomStateFill64(OFRandomState *state_, uint64_t *values, size_t count)
+{
+    SFMTState *state = (SFMTState *)state_;
+
+    // Use up what's left of the current block, so that the rest starts on a block boundary.
+    while (count > 0 && state->idx < N32) {
+        *values++ = gen_rand64(state);
+        count--;
+    }
+
+    // Generate whole blocks straight into the caller's array if it's aligned for the vector unit. Otherwise, generate each block in place and copy it out.
+    if (((uintptr_t)values & (sizeof(w128_t) - 1)) == 0) {
+        while (count >= N64) {
+            size_t runCount = MIN(count, (size_t)INT_MAX) & ~(size_t)1;
+            fill_array64(state, values, (int)runCount);
+            values += runCount;
+            count -= runCount;
+        }
+    } else {
+        while (count >= N64) {
+            gen_rand_all(state);
+            memcpy(values, state->psfmt64, N64 * sizeof(*values));
+            values += N64;
+            count -= N64;
+        }
+    }
+
+    while (count > 0) {
+        *values++ = gen_rand64(state);
+        count--;
+    }
+}
+
+void OFRandomStateFillDouble(OFRandomState *state, double *values, size_t count)
+{
+    OBASSERT(sizeof(double) == sizeof(uint64_t));
+    OFRandomStateFill64(state, (uint64_t *)values, count);
+
+    for (size_t valueIndex = 0; valueIndex < count; valueIndex++) {
+        uint64_t bits;
+        memcpy(&bits, &values[valueIndex], sizeof(bits));
+        values[valueIndex] = to_res53(bits);
+    }
+}
+
+static pthread_key_t _defaultRandomStateKey;
+
+static void _OFRandomDefaultStateDestructor(void *value)
+{
+    OFRandomStateDestroy(value);
+}
+
+static OFRandomState *_OFRandomDefaultState(void)
 {
-    // Serialize on a queue so that this shared state can be used conveniently w/o external locking.
-    static OFRandomState *defaultRandomState = NULL;
-    static dispatch_queue_t queue;
     static dispatch_once_t onceToken;
     dispatch_once(&onceToken, ^{
-        queue = dispatch_queue_create("com.omnigroup.OmniFoundation.OFRandom.DefaultState", DISPATCH_QUEUE_SERIAL);
-        defaultRandomState = OFRandomStateCreate();
+        int rc = pthread_key_create(&_defaultRandomStateKey, _OFRandomDefaultStateDestructor);
+        if (rc != 0)
+            OBASSERT_NOT_REACHED("Unable to create default random state key: %d", rc);
     });
 
-    dispatch_sync(queue, ^{
-        block(defaultRandomState);
-    });
-}
+    OFRandomState *state = pthread_getspecific(_defaultRandomStateKey);
+    if (__builtin_expect(state != NULL, 1))
+        return state;
 
+    // Each thread gets its own state. Besides the usual seed, mix in a sequence number so that no two threads share a seed even if they start at the same instant without /dev/urandom. With a period of 2^19937-1, streams from distinct seeds won't overlap in practice.
+    static _Atomic(uint32_t) threadSequence = 0;
+    uint32_t seed[5];
+    _OFRandomGatherSeed(seed);
+    seed[4] = atomic_fetch_add_explicit(&threadSequence, 1, memory_order_relaxed);
+    state = OFRandomStateCreateWithSeed32(seed, 5);
+
+    pthread_setspecific(_defaultRandomStateKey, state);
+    return state;
+}
 
 uint32_t OFRandomNext32(void)
 {
-    __block uint32_t result = 0;
-    _withDefaultRandomState(^(OFRandomState *state){
-        result = OFRandomNextState32(state);
-    });
-    return result;
+    return OFRandomNextState32(_OFRandomDefaultState());
 }
 
 uint64_t OFRandomNext64(void)
 {
-    __block uint64_t result = 0;
-    _withDefaultRandomState(^(OFRandomState *state){
-        result = OFRandomNextState64(state);
-    });
-    return result;
+    return OFRandomNextState64(_OFRandomDefaultState());
 }
 
 double OFRandomNextDouble(void)
 {
-    __block double result = 0;
-    _withDefaultRandomState(^(OFRandomState *state){
-        result = OFRandomNextStateDouble(state);
-    });
-    return result;
+    return OFRandomNextStateDouble(_OFRandomDefaultState());
 }
 
-NSData *OFRandomStateCreateDataOfLength(OFRandomState *state, NSUInteger byteCount)
+void OFRandomFill64(uint64_t *values, size_t count)
 {
-#if 0 // gen_rand_array version. This doesn't seem to work the way I expect. Passing 1 for the size parameter writes to more than sizeof(w128_t) bytes and corrupts heap. The advantage of gen_rand_array() is that it will use vector instructions if available. We don't currently call this enough to warrant debugging this.
-    // Round up to a multiple of sizeof(w128_t)
-    NSUInteger roundedByteCount = ((byteCount + sizeof(w128_t) - 1) & ~(sizeof(w128_t) - 1));
-    OBASSERT((roundedByteCount % sizeof(w128_t)) == 0);
-    OBASSERT(roundedByteCount >= byteCount);
-    
-    w128_t *buffer = (w128_t *)malloc(roundedByteCount);
-    NSUInteger wordCount = roundedByteCount / sizeof(w128_t);
-    OBASSERT(wordCount <= INT_MAX); // SFMT takes int here.
-    
-    gen_rand_array((SFMTState *)state, buffer, (int)wordCount);
+    OFRandomStateFill64(_OFRandomDefaultState(), values, count);
+}
 
-    return [[NSData alloc] initWithBytesNoCopy:buffer length:byteCount];
-#else
-    // Round up to a multiple of sizeof(uint64_t).
+void OFRandomFillDouble(double *values, size_t count)
+{
+    OFRandomStateFillDouble(_OFRandomDefaultState(), values, count);
+}
+
+NSData *OFRandomStateCreateDataOfLength(OFRandomState *state, NSUInteger byteCount)
+{
+    // Round up to a multiple of sizeof(uint64_t). malloc() returns 16-byte aligned memory, so this takes the vectorized path.
     NSUInteger roundedByteCount = ((byteCount + sizeof(uint64_t) - 1) & ~(sizeof(uint64_t) - 1));
     OBASSERT((roundedByteCount % sizeof(uint64_t)) == 0);
     OBASSERT(roundedByteCount >= byteCount);
     
     uint64_t *buffer = (uint64_t *)malloc(roundedByteCount);
-    NSUInteger wordCount = roundedByteCount / sizeof(uint64_t);
-    for (NSUInteger wordIndex = 0; wordIndex < wordCount; wordIndex++)
-        buffer[wordIndex] = OFRandomNextState64(state);
+    OFRandomStateFill64(state, buffer, roundedByteCount / sizeof(uint64_t));
     
     return [[NSData alloc] initWithBytesNoCopy:buffer length:byteCount];
-#endif
 }
 
 NSData *OFRandomCreateDataOfLength(NSUInteger byteCount)
 {
-    __block NSData *result = nil;
-    _withDefaultRandomState(^(OFRandomState *state){
-        result = OFRandomStateCreateDataOfLength(state, byteCount);
-    });
-    return result;
+    return OFRandomStateCreateDataOfLength(_OFRandomDefaultState(), byteCount);
 }
@@ -0,0 +1,38 @@
+// Copyright 2026 Omni Development, Inc. All rights reserved.
+//
+// This software may only be used and reproduced according to the
+// terms in the file OmniSourceLicense.html, which should be
+// distributed with this project and can also be found at
+// <http://www.omnigroup.com/developer/sourcecode/sourcelicense/>.
+
+#import <Foundation/NSObjCRuntime.h> // NSUInteger and BOOL
+#import <Foundation/NSDate.h> // NSTimeInterval
+
+/*"
+OFTimerWheel is a hierarchical timing wheel: a set of values, each with a deadline, that supports constant time insertion and removal and hands back everything that has come due in one batch. Deadlines are NSTimeIntervals since the reference date, and are bucketed into ticks of tickInterval seconds; values are always returned by OFTimerWheelRemoveDueValues() according to their exact deadline, so the tick only affects performance.
+
+Values are compared by pointer and are not retained. The same value may be added more than once; each removal takes out the earliest added instance still present.
+
+An OFTimerWheel is not thread-safe.
+"*/
+
+typedef struct _OFTimerWheel OFTimerWheel;
+
+extern OFTimerWheel *OFTimerWheelCreate(NSTimeInterval tickInterval);
+extern void OFTimerWheelFree(OFTimerWheel *wheel);
+
+extern NSUInteger OFTimerWheelCount(const OFTimerWheel *wheel);
+
+extern void OFTimerWheelAddValue(OFTimerWheel *wheel, const void *value, NSTimeInterval deadline);
+extern BOOL OFTimerWheelRemoveValue(OFTimerWheel *wheel, const void *value);
+
+// Returns NO if the wheel is empty. The result is cached until the first value is removed, so repeated calls are cheap.
+extern BOOL OFTimerWheelGetFirstValue(OFTimerWheel *wheel, const void **outValue, NSTimeInterval *outDeadline);
+
+// Removes every value whose deadline is at or before 'now', calling the applier for each (in no particular order). The applier must not modify the wheel.
+extern void OFTimerWheelRemoveDueValues(OFTimerWheel *wheel, NSTimeInterval now, void (NS_NOESCAPE ^applier)(const void *value));
+
+// Removes every value for which the predicate returns YES. The predicate must not modify the wheel.
+extern void OFTimerWheelRemoveValuesMatching(OFTimerWheel *wheel, BOOL (NS_NOESCAPE ^predicate)(const void *value, NSTimeInterval deadline));
+
+extern void OFTimerWheelEnumerate(const OFTimerWheel *wheel, void (NS_NOESCAPE ^applier)(const void *value, NSTimeInterval deadline));
@@ -0,0 +1,384 @@
+// Copyright 2026 Omni Development, Inc. All rights reserved.
+//
+// This software may only be used and reproduced according to the
+// terms in the file OmniSourceLicense.html, which should be
+// distributed with this project and can also be found at
+// <http://www.omnigroup.com/developer/sourcecode/sourcelicense/>.
+
+#import <OmniFoundation/OFTimerWheel.h>
+
+#import <CoreFoundation/CoreFoundation.h>
+#import <OmniBase/assertions.h>
+#import <OmniBase/rcsid.h>
+
+RCS_ID("$Id$")
+
+/*"
+The wheel has four levels of 256 slots. Level 0 has one slot per tick; each slot of level N covers a whole turn of level N-1. A value lives at the lowest level whose turn it shares with the current tick, so inserting and removing only ever touch one slot list. As the current tick advances, the next slot of a higher level is cascaded down into the lower levels just as they turn over, and level 0 slots move onto the due list as their tick passes. Deadlines more than 2^32 ticks out wait on an overflow list, which is re-examined each time the top level turns over.
+
+Each level keeps a bitmap of its occupied slots, so advancing over a long idle stretch jumps straight to the next occupied slot rather than stepping through every tick.
+"*/
+
+#define LEVEL_BITS (8)
+#define SLOTS_PER_LEVEL (1u << LEVEL_BITS)
+#define LEVEL_COUNT (4)
+#define WHEEL_BITS (LEVEL_BITS * LEVEL_COUNT)
+#define OCCUPANCY_WORDS (SLOTS_PER_LEVEL / 64)
+
+enum {
+    LocationDue = LEVEL_COUNT,
+    LocationOverflow,
+};
+
+typedef struct _OFTimerWheelNode {
+    struct _OFTimerWheelNode *previous, *next; // Within the list for the node's location
+    struct _OFTimerWheelNode **list; // The head of that list
+    struct _OFTimerWheelNode *nextInstance; // The next node (added later) for the same value
+    const void *value;
+    NSTimeInterval deadline;
+    uint64_t tick;
+    uint8_t level; // 0 ..< LEVEL_COUNT, or one of the Location constants
+    uint8_t slot;
+} OFTimerWheelNode;
+
+struct _OFTimerWheel {
+    NSTimeInterval tickInterval;
+    NSTimeInterval origin;
+    uint64_t currentTick; // Everything at or before this tick is on the due list
+    NSUInteger count;
+
+    OFTimerWheelNode *slots[LEVEL_COUNT][SLOTS_PER_LEVEL];
+    uint64_t occupied[LEVEL_COUNT][OCCUPANCY_WORDS];
+    OFTimerWheelNode *due;
+    OFTimerWheelNode *overflow;
+
+    CFMutableDictionaryRef firstInstanceByValue; // value -> OFTimerWheelNode
+    OFTimerWheelNode *freeNodes;
+
+    OFTimerWheelNode *firstNode;
+    BOOL firstNodeValid;
+};
+
+static uint64_t _tickForDeadline(const OFTimerWheel *wheel, NSTimeInterval deadline)
+{
+    NSTimeInterval ticks = (deadline - wheel->origin) / wheel->tickInterval;
+    if (!(ticks > 0.0)) // Also catches NaN
+        return 0;
+    if (ticks >= 18446744073709549568.0) // The largest double below 2^64
+        return UINT64_MAX;
+    return (uint64_t)ticks;
+}
+
+static unsigned _nextOccupiedSlot(const uint64_t *occupied, unsigned startSlot)
+{
+    for (unsigned wordIndex = startSlot / 64; wordIndex < OCCUPANCY_WORDS; wordIndex++) {
+        uint64_t word = occupied[wordIndex];
+        if (wordIndex == startSlot / 64)
+            word &= ~0ULL << (startSlot % 64);
+        if (word)
+            return wordIndex * 64 + __builtin_ctzll(word);
+    }
+    return SLOTS_PER_LEVEL;
+}
+
+static void _linkNode(OFTimerWheel *wheel, OFTimerWheelNode *node)
+{
+    OFTimerWheelNode **list;
+
+    if (node->tick <= wheel->currentTick) {
+        node->level = LocationDue;
+        list = &wheel->due;
+    } else {
+        uint64_t differingBits = node->tick ^ wheel->currentTick;
+        if (differingBits >> WHEEL_BITS) {
+            node->level = LocationOverflow;
+            list = &wheel->overflow;
+        } else {
+            unsigned level = (63 - __builtin_clzll(differingBits)) / LEVEL_BITS;
+            unsigned slot = (node->tick >> (level * LEVEL_BITS)) & (SLOTS_PER_LEVEL - 1);
+            node->level = level;
+            node->slot = slot;
+            list = &wheel->slots[level][slot];
+            wheel->occupied[level][slot / 64] |= 1ULL << (slot % 64);
+        }
+    }
+
+    node->previous = NULL;
+    node->next = *list;
+    if (*list)
+        (*list)->previous = node;
+    *list = node;
+    node->list = list;
+}
+
+static void _unlinkNode(OFTimerWheel *wheel, OFTimerWheelNode *node)
+{
+    if (node->previous)
+        node->previous->next = node->next;
+    else
+        *node->list = node->next;
+    if (node->next)
+        node->next->previous = node->previous;
+
+    if (node->level < LEVEL_COUNT && wheel->slots[node->level][node->slot] == NULL)
+        wheel->occupied[node->level][node->slot / 64] &= ~(1ULL << (node->slot % 64));
+}
+
+// Relinks every node in the list relative to the current tick, which moves them down a level (or onto the due list).
+static void _cascadeList(OFTimerWheel *wheel, OFTimerWheelNode **list)
+{
+    OFTimerWheelNode *node = *list;
+    *list = NULL;
+    while (node) {
+        OFTimerWheelNode *next = node->next;
+        _linkNode(wheel, node);
+        node = next;
+    }
+}
+
+static void _cascadeSlot(OFTimerWheel *wheel, unsigned level, unsigned slot)
+{
+    wheel->occupied[level][slot / 64] &= ~(1ULL << (slot % 64));
+    _cascadeList(wheel, &wheel->slots[level][slot]);
+}
+
+static void _advanceToTick(OFTimerWheel *wheel, uint64_t targetTick)
+{
+    while (wheel->currentTick < targetTick) {
+        uint64_t currentTick = wheel->currentTick;
+        uint64_t stopTick = MIN(targetTick, currentTick | (SLOTS_PER_LEVEL - 1));
+
+        // Everything in level 0 up through stopTick has come due.
+        wheel->currentTick = stopTick;
+        unsigned lastSlot = stopTick & (SLOTS_PER_LEVEL - 1);
+        unsigned slot = (currentTick & (SLOTS_PER_LEVEL - 1)) + 1;
+        while ((slot = _nextOccupiedSlot(wheel->occupied[0], slot)) <= lastSlot) {
+            _cascadeSlot(wheel, 0, slot);
+            slot++;
+        }
+        if (stopTick == targetTick)
+            break;
+
+        // Level 0 has turned over and is empty. Rather than stepping through the empty turns, jump to the next tick where an occupied slot at a higher level needs to be cascaded.
+        uint64_t boundaryTick = UINT64_MAX;
+        for (unsigned level = 1; level < LEVEL_COUNT; level++) {
+            unsigned occupiedSlot = _nextOccupiedSlot(wheel->occupied[level], 0);
+            if (occupiedSlot < SLOTS_PER_LEVEL) {
+                unsigned shift = level * LEVEL_BITS;
+                boundaryTick = (stopTick & ~((1ULL << (shift + LEVEL_BITS)) - 1)) | ((uint64_t)occupiedSlot << shift);
+                break;
+            }
+        }
+        if (boundaryTick == UINT64_MAX && wheel->overflow && (stopTick >> WHEEL_BITS) < (UINT64_MAX >> WHEEL_BITS))
+            boundaryTick = ((stopTick >> WHEEL_BITS) + 1) << WHEEL_BITS;
+
+        OBASSERT(boundaryTick > stopTick);
+        if (boundaryTick > targetTick) {
+            wheel->currentTick = targetTick;
+            break;
+        }
+
+        wheel->currentTick = boundaryTick;
+        if ((boundaryTick & ((1ULL << WHEEL_BITS) - 1)) == 0)
+            _cascadeList(wheel, &wheel->overflow);
+        for (unsigned level = LEVEL_COUNT - 1; level > 0; level--) {
+            unsigned shift = level * LEVEL_BITS;
+            if ((boundaryTick & ((1ULL << shift) - 1)) == 0)
+                _cascadeSlot(wheel, level, (boundaryTick >> shift) & (SLOTS_PER_LEVEL - 1));
+        }
+    }
+}
+
+static void _removeNode(OFTimerWheel *wheel, OFTimerWheelNode *node)
+{
+    _unlinkNode(wheel, node);
+
+    OFTimerWheelNode *firstInstance = (OFTimerWheelNode *)CFDictionaryGetValue(wheel->firstInstanceByValue, node->value);
+    if (firstInstance == node) {
+        if (node->nextInstance)
+            CFDictionarySetValue(wheel->firstInstanceByValue, node->value, node->nextInstance);
+        else
+            CFDictionaryRemoveValue(wheel->firstInstanceByValue, node->value);
+    } else {
+        OFTimerWheelNode *instance = firstInstance;
+        while (instance->nextInstance != node)
+            instance = instance->nextInstance;
+        instance->nextInstance = node->nextInstance;
+    }
+
+    if (wheel->firstNode == node) {
+        wheel->firstNode = NULL;
+        wheel->firstNodeValid = NO;
+    }
+
+    wheel->count--;
+    node->next = wheel->freeNodes;
+    wheel->freeNodes = node;
+}
+
+static OFTimerWheelNode *_earliestNodeInList(OFTimerWheelNode *node)
+{
+    OFTimerWheelNode *earliest = node;
+    for (; node; node = node->next) {
+        if (node->deadline < earliest->deadline)
+            earliest = node;
+    }
+    return earliest;
+}
+
+static OFTimerWheelNode *_findFirstNode(const OFTimerWheel *wheel)
+{
+    if (wheel->due)
+        return _earliestNodeInList(wheel->due);
+
+    // Occupied slots are always past the current tick's slot on their level, so the first one on the lowest occupied level holds the earliest deadline.
+    for (unsigned level = 0; level < LEVEL_COUNT; level++) {
+        unsigned slot = _nextOccupiedSlot(wheel->occupied[level], 0);
+        if (slot < SLOTS_PER_LEVEL)
+            return _earliestNodeInList(wheel->slots[level][slot]);
+    }
+
+    return _earliestNodeInList(wheel->overflow);
+}
+
+static void _enumerateNodes(const OFTimerWheel *wheel, void (NS_NOESCAPE ^applier)(OFTimerWheelNode *node))
+{
+    OFTimerWheelNode *next;
+    for (OFTimerWheelNode *node = wheel->due; node; node = next) {
+        next = node->next;
+        applier(node);
+    }
+    for (OFTimerWheelNode *node = wheel->overflow; node; node = next) {
+        next = node->next;
+        applier(node);
+    }
+    for (unsigned level = 0; level < LEVEL_COUNT; level++) {
+        for (unsigned slot = _nextOccupiedSlot(wheel->occupied[level], 0); slot < SLOTS_PER_LEVEL; slot = _nextOccupiedSlot(wheel->occupied[level], slot + 1)) {
+            for (OFTimerWheelNode *node = wheel->slots[level][slot]; node; node = next) {
+                next = node->next;
+                applier(node);
+            }
+        }
+    }
+}
+
+#pragma mark - API
+
+OFTimerWheel *OFTimerWheelCreate(NSTimeInterval tickInterval)
+{
+    OBPRECONDITION(tickInterval > 0.0);
+
+    OFTimerWheel *wheel = calloc(1, sizeof(*wheel));
+    wheel->tickInterval = tickInterval;
+    wheel->origin = CFAbsoluteTimeGetCurrent();
+    wheel->firstInstanceByValue = CFDictionaryCreateMutable(kCFAllocatorDefault, 0, NULL, NULL);
+    wheel->firstNodeValid = YES; // Empty
+    return wheel;
+}
+
+void OFTimerWheelFree(OFTimerWheel *wheel)
+{
+    if (!wheel)
+        return;
+
+    _enumerateNodes(wheel, ^(OFTimerWheelNode *node){
+        free(node);
+    });
+    while (wheel->freeNodes) {
+        OFTimerWheelNode *node = wheel->freeNodes;
+        wheel->freeNodes = node->next;
+        free(node);
+    }
+
+    CFRelease(wheel->firstInstanceByValue);
+    free(wheel);
+}
+
+NSUInteger OFTimerWheelCount(const OFTimerWheel *wheel)
+{
+    return wheel->count;
+}
+
+void OFTimerWheelAddValue(OFTimerWheel *wheel, const void *value, NSTimeInterval deadline)
+{
+    OFTimerWheelNode *node = wheel->freeNodes;
+    if (node)
+        wheel->freeNodes = node->next;
+    else
+        node = malloc(sizeof(*node));
+
+    node->value = value;
+    node->deadline = deadline;
+    node->tick = _tickForDeadline(wheel, deadline);
+    node->nextInstance = NULL;
+    _linkNode(wheel, node);
+
+    OFTimerWheelNode *instance = (OFTimerWheelNode *)CFDictionaryGetValue(wheel->firstInstanceByValue, value);
+    if (instance) {
+        while (instance->nextInstance)
+            instance = instance->nextInstance;
+        instance->nextInstance = node;
+    } else
+        CFDictionarySetValue(wheel->firstInstanceByValue, value, node);
+
+    wheel->count++;
+    if (wheel->firstNodeValid && (wheel->firstNode == NULL || deadline < wheel->firstNode->deadline))
+        wheel->firstNode = node;
+}
+
+BOOL OFTimerWheelRemoveValue(OFTimerWheel *wheel, const void *value)
+{
+    OFTimerWheelNode *node = (OFTimerWheelNode *)CFDictionaryGetValue(wheel->firstInstanceByValue, value);
+    if (!node)
+        return NO;
+    _removeNode(wheel, node);
+    return YES;
+}
+
+BOOL OFTimerWheelGetFirstValue(OFTimerWheel *wheel, const void **outValue, NSTimeInterval *outDeadline)
+{
+    if (!wheel->firstNodeValid) {
+        wheel->firstNode = _findFirstNode(wheel);
+        wheel->firstNodeValid = YES;
+    }
+
+    OFTimerWheelNode *node = wheel->firstNode;
+    if (!node)
+        return NO;
+    if (outValue)
+        *outValue = node->value;
+    if (outDeadline)
+        *outDeadline = node->deadline;
+    return YES;
+}
+
+void OFTimerWheelRemoveDueValues(OFTimerWheel *wheel, NSTimeInterval now, void (NS_NOESCAPE ^applier)(const void *value))
+{
+    _advanceToTick(wheel, _tickForDeadline(wheel, now));
+
+    // The due list can still hold values from the current tick whose deadline is a fraction of a tick away; leave those for next time.
+    OFTimerWheelNode *next;
+    for (OFTimerWheelNode *node = wheel->due; node; node = next) {
+        next = node->next;
+        if (node->deadline <= now) {
+            const void *value = node->value;
+            _removeNode(wheel, node);
+            applier(value);
+        }
+    }
+}
+
+void OFTimerWheelRemoveValuesMatching(OFTimerWheel *wheel, BOOL (NS_NOESCAPE ^predicate)(const void *value, NSTimeInterval deadline))
+{
+    _enumerateNodes(wheel, ^(OFTimerWheelNode *node){
+        if (predicate(node->value, node->deadline))
+            _removeNode(wheel, node);
+    });
+}
+
+void OFTimerWheelEnumerate(const OFTimerWheel *wheel, void (NS_NOESCAPE ^applier)(const void *value, NSTimeInterval deadline))
+{
+    _enumerateNodes(wheel, ^(OFTimerWheelNode *node){
+        applier(node->value, node->deadline);
+    });
+}
@@ -189,12 +189,12 @@ static inline BOOL
 scannerScanUpToCharacterInOFCharacterSet(OFCharacterScanner *scanner, OFCharacterSet *delimiterBitmapRep)
 {
     while (scannerHasData(scanner)) {
-        while (scanner->scanLocation < scanner->scanEnd) {
-            if (OFCharacterSetHasMember(delimiterBitmapRep, *scanner->scanLocation))
+        if (scanner->scanLocation < scanner->scanEnd) {
+            scanner->scanLocation = OFCharacterSetFindMember(delimiterBitmapRep, scanner->scanLocation, scanner->scanEnd);
+            if (scanner->scanLocation < scanner->scanEnd)
                 return YES;
-            scanner->scanLocation++;
         }
-    } 
+    }
     return NO;
 }
 
@@ -202,10 +202,10 @@ static inline BOOL
 scannerScanUpToCharacterNotInOFCharacterSet(OFCharacterScanner *scanner, OFCharacterSet *memberBitmapRep)
 {
     while (scannerHasData(scanner)) {
-        while (scanner->scanLocation < scanner->scanEnd) {
-            if (!OFCharacterSetHasMember(memberBitmapRep, *scanner->scanLocation))
+        if (scanner->scanLocation < scanner->scanEnd) {
+            scanner->scanLocation = OFCharacterSetFindNonMember(memberBitmapRep, scanner->scanLocation, scanner->scanEnd);
+            if (scanner->scanLocation < scanner->scanEnd)
                 return YES;
-            scanner->scanLocation++;
         }
     }
     return NO;
@@ -400,11 +400,8 @@ readRetainedTokenFragmentWithDelimiterOFCharacterSet(OFCharacterScanner *self, O
     if (!scannerHasData(self))
 	return nil;
     startLocation = self->scanLocation;
-    while (self->scanLocation < self->scanEnd) {
-	if (OFCharacterSetHasMember(delimiterOFCharacterSet, *self->scanLocation))
-	    break;
-	self->scanLocation++;
-    }
+    if (self->scanLocation < self->scanEnd)
+        self->scanLocation = OFCharacterSetFindMember(delimiterOFCharacterSet, self->scanLocation, self->scanEnd);
 
     NSUInteger length = self->scanLocation - startLocation;
     if (length == 0)
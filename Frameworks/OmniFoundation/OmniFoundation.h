@@ -18,6 +18,7 @@
 #import <OmniFoundation/OFBundleRegistry.h>
 #import <OmniFoundation/OFBundleRegistryTarget.h>
 #import <OmniFoundation/OFByteProviderProtocol.h>
+#import <OmniFoundation/OFByteSearch.h>
 #import <OmniFoundation/OFByteSet.h>
 #import <OmniFoundation/OFCancelErrorRecovery.h>
 #import <OmniFoundation/OFCharacterScanner.h>
@@ -114,9 +115,11 @@
 	#import <OmniFoundation/OFSparseArray.h>
 	#import <OmniFoundation/OFSubjectTargettingScriptCommand.h>
 	#import <OmniFoundation/OFThreeValuedMask.h>
+	#import <OmniFoundation/OFTimerWheel.h>
 	#import <OmniFoundation/OFTrie.h>
 	#import <OmniFoundation/OFTrieBucket.h>
 	#import <OmniFoundation/OFTrieNode.h>
+	#import <OmniFoundation/OFWorkStealingMessageQueue.h>
 #endif
 
 
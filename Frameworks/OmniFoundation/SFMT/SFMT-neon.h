@@ -0,0 +1,117 @@
+/** 
+ * @file  SFMT-neon.h
+ * @brief SIMD oriented Fast Mersenne Twister(SFMT) for ARM NEON
+ *
+ * OmniFoundation: A port of SFMT-sse2.h to NEON intrinsics.
+ *
+ * @note We assume LITTLE ENDIAN in this file
+ *
+ * Copyright (C) 2006, 2007 Mutsuo Saito, Makoto Matsumoto and Hiroshima
+ * University. All rights reserved.
+ *
+ * The new BSD License is applied to this software, see LICENSE.txt
+ */
+
+#ifndef SFMT_NEON_H
+#define SFMT_NEON_H
+
+PRE_ALWAYS static uint32x4_t neon_recursion(uint32x4_t a, uint32x4_t b,
+				   uint32x4_t c, uint32x4_t d, uint32x4_t mask) ALWAYSINLINE;
+
+/**
+ * This function represents the recursion formula.
+ * @param a a 128-bit part of the interal state array
+ * @param b a 128-bit part of the interal state array
+ * @param c a 128-bit part of the interal state array
+ * @param d a 128-bit part of the interal state array
+ * @param mask 128-bit mask
+ * @return output
+ */
+PRE_ALWAYS static uint32x4_t neon_recursion(uint32x4_t a, uint32x4_t b,
+				   uint32x4_t c, uint32x4_t d, uint32x4_t mask) {
+    uint8x16_t zero = vdupq_n_u8(0);
+    uint32x4_t x, y, z, v;
+
+    /* 128-bit shifts by whole bytes are byte rotations against zero */
+    x = vreinterpretq_u32_u8(vextq_u8(zero, vreinterpretq_u8_u32(a), 16 - SL2));
+    y = vandq_u32(vshrq_n_u32(b, SR1), mask);
+    z = vreinterpretq_u32_u8(vextq_u8(vreinterpretq_u8_u32(c), zero, SR2));
+    v = vshlq_n_u32(d, SL1);
+    return veorq_u32(veorq_u32(veorq_u32(a, x), veorq_u32(y, z)), v);
+}
+
+/**
+ * This function fills the internal state array with pseudorandom
+ * integers.
+ */
+inline static void gen_rand_all(SFMTState *state) {
+    int i;
+    uint32x4_t r, r1, r2, mask;
+    static const uint32_t masks[4] = {MSK1, MSK2, MSK3, MSK4};
+    mask = vld1q_u32(masks);
+
+    r1 = sfmt[N - 2].si;
+    r2 = sfmt[N - 1].si;
+    for (i = 0; i < N - POS1; i++) {
+	r = neon_recursion(sfmt[i].si, sfmt[i + POS1].si, r1, r2, mask);
+	sfmt[i].si = r;
+	r1 = r2;
+	r2 = r;
+    }
+    for (; i < N; i++) {
+	r = neon_recursion(sfmt[i].si, sfmt[i + POS1 - N].si, r1, r2, mask);
+	sfmt[i].si = r;
+	r1 = r2;
+	r2 = r;
+    }
+}
+
+/**
+ * This function fills the user-specified array with pseudorandom
+ * integers.
+ *
+ * @param array an 128-bit array to be filled by pseudorandom numbers.  
+ * @param size number of 128-bit pesudorandom numbers to be generated.
+ */
+inline static void gen_rand_array(SFMTState *state, w128_t *array, int size) {
+    int i, j;
+    uint32x4_t r, r1, r2, mask;
+    static const uint32_t masks[4] = {MSK1, MSK2, MSK3, MSK4};
+    mask = vld1q_u32(masks);
+
+    r1 = sfmt[N - 2].si;
+    r2 = sfmt[N - 1].si;
+    for (i = 0; i < N - POS1; i++) {
+	r = neon_recursion(sfmt[i].si, sfmt[i + POS1].si, r1, r2, mask);
+	array[i].si = r;
+	r1 = r2;
+	r2 = r;
+    }
+    for (; i < N; i++) {
+	r = neon_recursion(sfmt[i].si, array[i + POS1 - N].si, r1, r2, mask);
+	array[i].si = r;
+	r1 = r2;
+	r2 = r;
+    }
+    /* main loop */
+    for (; i < size - N; i++) {
+	r = neon_recursion(array[i - N].si, array[i + POS1 - N].si, r1, r2,
+			 mask);
+	array[i].si = r;
+	r1 = r2;
+	r2 = r;
+    }
+    for (j = 0; j < 2 * N - size; j++) {
+	sfmt[j] = array[j + size - N];
+    }
+    for (; i < size; i++) {
+	r = neon_recursion(array[i - N].si, array[i + POS1 - N].si, r1, r2,
+			 mask);
+	array[i].si = r;
+	sfmt[j++].si = r;
+	r1 = r2;
+	r2 = r;
+    }
+}
+
+#endif
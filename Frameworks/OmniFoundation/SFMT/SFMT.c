@@ -53,6 +53,18 @@ union W128_T {
 /** 128-bit data type */
 typedef union W128_T w128_t;
 
+// OmniFoundation: Added an ARM NEON version
+#elif defined(HAVE_NEON)
+  #include <arm_neon.h>
+
+/** 128-bit data structure */
+union W128_T {
+    uint32x4_t si;
+    uint32_t u[4];
+};
+/** 128-bit data type */
+typedef union W128_T w128_t;
+
 #else
 
 /** 128-bit data structure */
@@ -135,6 +147,8 @@ inline static void swap(w128_t *array, int size);
   #include "SFMT-alti.h"
 #elif defined(HAVE_SSE2)
   #include "SFMT-sse2.h"
+#elif defined(HAVE_NEON)
+  #include "SFMT-neon.h"
 #endif
 
 /**
@@ -237,7 +251,7 @@ inline static void lshift128(w128_t *out, w128_t const *in, int shift) {
  * @param c a 128-bit part of the internal state array
  * @param d a 128-bit part of the internal state array
  */
-#if (!defined(HAVE_ALTIVEC)) && (!defined(HAVE_SSE2))
+#if (!defined(HAVE_ALTIVEC)) && (!defined(HAVE_SSE2)) && (!defined(HAVE_NEON))
 #ifdef ONLY64
 inline static void do_recursion(w128_t *r, w128_t *a, w128_t *b, w128_t *c,
 				w128_t *d) {
@@ -275,7 +289,7 @@ inline static void do_recursion(w128_t *r, w128_t *a, w128_t *b, w128_t *c,
 #endif
 #endif
 
-#if (!defined(HAVE_ALTIVEC)) && (!defined(HAVE_SSE2))
+#if (!defined(HAVE_ALTIVEC)) && (!defined(HAVE_SSE2)) && (!defined(HAVE_NEON))
 /**
  * This function fills the internal state array with pseudorandom
  * integers.
@@ -26,6 +26,8 @@
 - (BOOL)hasInvocations;
 - (OFInvocation *)copyNextInvocation;
 - (OFInvocation *)copyNextInvocationWithBlock:(BOOL)shouldBlock;
+- (void)didFinishInvocation:(OFInvocation *)invocation;
+    // Called by OFQueueProcessor after running an invocation returned by -copyNextInvocation. OFMessageQueue itself tracks running invocations through its processors, so this does nothing, but subclasses may need it.
 
 - (void)addQueueEntry:(OFInvocation *)aQueueEntry;
 
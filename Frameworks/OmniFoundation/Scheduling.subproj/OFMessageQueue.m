@@ -231,6 +231,10 @@ static BOOL OFMessageQueueDebug = NO;
     return nextRetainedInvocation;
 }
 
+- (void)didFinishInvocation:(OFInvocation *)invocation;
+{
+}
+
 - (void)addQueueEntry:(OFInvocation *)aQueueEntry;
 {
     OBPRECONDITION(aQueueEntry);
@@ -108,6 +108,8 @@ static OFQueueProcessor *detachingQueueProcessor;
             currentInvocation = nil;
             schedulingInfo = OFMessageQueueSchedulingInfoDefault;
             [currentInvocationLock unlock];
+
+            [messageQueue didFinishInvocation:retainedInvocation];
             
             [retainedInvocation release];
             
@@ -7,15 +7,16 @@
 
 #import <OmniFoundation/OFObject.h>
 #import <OmniFoundation/OFController.h>
+#import <OmniFoundation/OFTimerWheel.h>
 
-@class NSDate, NSRecursiveLock, NSMutableArray;
+@class NSDate, NSRecursiveLock;
 @class OFDedicatedThreadScheduler, OFInvocation, OFScheduledEvent;
 
 #import <Foundation/NSDate.h> // For NSTimeInterval
 
 @interface OFScheduler : NSObject <OFControllerStatusObserver>
 {
-    NSMutableArray *scheduleQueue;
+    OFTimerWheel *scheduleQueue;
     NSRecursiveLock *scheduleLock;
     BOOL terminationSignaled;
 }
@@ -8,8 +8,6 @@
 #import <OmniFoundation/OFScheduler.h>
 
 #import <OmniFoundation/NSDate-OFExtensions.h>
-#import <OmniFoundation/NSMutableArray-OFExtensions.h>
-#import <OmniFoundation/NSArray-OFExtensions.h>
 #import <OmniFoundation/OFDedicatedThreadScheduler.h>
 #import <OmniFoundation/OFInvocation.h>
 #import <OmniFoundation/OFScheduledEvent.h>
@@ -24,6 +22,9 @@ RCS_ID("$Id$")
 
 @implementation OFScheduler
 
+// Events due within the same tick are fired as one batch.
+static const NSTimeInterval OFSchedulerTickInterval = 0.001;
+
 // #define DEBUG_ALLOCATIONS
 
 #ifdef DEBUG_ALLOCATIONS
@@ -69,7 +70,7 @@ static NSLock *instanceCountLock;
     if (!(self = [super init]))
         return nil;
 
-    scheduleQueue = [[NSMutableArray alloc] init];
+    scheduleQueue = OFTimerWheelCreate(OFSchedulerTickInterval);
     scheduleLock = [[NSRecursiveLock alloc] init];
 
     [[OFController sharedController] addStatusObserver:self];
@@ -79,7 +80,10 @@ static NSLock *instanceCountLock;
 
 - (void)dealloc;
 {
-    [scheduleQueue release];
+    OFTimerWheelEnumerate(scheduleQueue, ^(const void *value, NSTimeInterval deadline){
+        [(OFScheduledEvent *)value release];
+    });
+    OFTimerWheelFree(scheduleQueue);
     [scheduleLock release];
 #ifdef DEBUG_ALLOCATIONS
     [instanceCountLock lock];
@@ -102,8 +106,9 @@ static NSLock *instanceCountLock;
     }
     
     [scheduleLock lock];
-    [scheduleQueue insertObject:event inArraySortedUsingSelector:@selector(compare:)];
-    if ([scheduleQueue objectAtIndex:0] == event) {
+    OFTimerWheelAddValue(scheduleQueue, [event retain], [[event date] timeIntervalSinceReferenceDate]);
+    const void *firstEvent = NULL;
+    if (OFTimerWheelGetFirstValue(scheduleQueue, &firstEvent, NULL) && firstEvent == event) {
         [self scheduleEvents];
     }
     [scheduleLock unlock];
@@ -112,27 +117,21 @@ static NSLock *instanceCountLock;
 /*" Removes the specified event from the receiver's schedule, if present.  If the event was present (and thus was removed), returns YES.  Otherwise (if, for example, the event has fired already), NO is returned. "*/
 - (BOOL)abortEvent:(OFScheduledEvent *)event;
 {
-    BOOL eventWasFirstInQueue;
     BOOL wasFound = NO;
     
     if (event == nil)
         return wasFound;
         
     [scheduleLock lock];
-    eventWasFirstInQueue = [scheduleQueue count] != 0 && [scheduleQueue objectAtIndex:0] == event;
-    if (eventWasFirstInQueue) {
-        wasFound = YES;
-        [scheduleQueue removeObjectAtIndex:0];
-	[self scheduleEvents];
-    } else {
-        NSUInteger objectIndex = [scheduleQueue indexOfObjectIdenticalTo:event inArraySortedUsingSelector:@selector(compare:)];
-        if (objectIndex != NSNotFound) {
-            wasFound = YES;
-            [scheduleQueue removeObjectAtIndex:objectIndex];
-        }
-    }
+    const void *firstEvent = NULL;
+    OFTimerWheelGetFirstValue(scheduleQueue, &firstEvent, NULL);
+    wasFound = OFTimerWheelRemoveValue(scheduleQueue, event);
+    if (wasFound && firstEvent == event)
+        [self scheduleEvents];
     [scheduleLock unlock];
     
+    if (wasFound)
+        [event release];
     return wasFound;
 }
 
@@ -140,8 +139,11 @@ static NSLock *instanceCountLock;
 {
     [scheduleLock lock];
     [self cancelScheduledEvents];
-    [scheduleQueue removeAllObjects];
+    NSArray *abortedEvents = [self _removeEventsMatching:^BOOL(OFScheduledEvent *event){
+        return YES;
+    }];
     [scheduleLock unlock];
+    [abortedEvents release];
 }
 
 - (OFScheduler *)subscheduler;
@@ -154,9 +156,9 @@ static NSLock *instanceCountLock;
     NSDate *dateOfFirstEvent;
 
     [scheduleLock lock];
-    if ([scheduleQueue count] != 0) {
-        OFScheduledEvent *firstEvent = [scheduleQueue objectAtIndex:0];
-        dateOfFirstEvent = [[firstEvent date] retain];
+    const void *firstEvent = NULL;
+    if (OFTimerWheelGetFirstValue(scheduleQueue, &firstEvent, NULL)) {
+        dateOfFirstEvent = [[(OFScheduledEvent *)firstEvent date] retain];
     } else {
         dateOfFirstEvent = nil;
     }
@@ -171,8 +173,16 @@ static NSLock *instanceCountLock;
     NSMutableDictionary *debugDictionary;
 
     debugDictionary = [super debugDictionary];
-    if (scheduleQueue)
-        [debugDictionary setObject:scheduleQueue forKey:@"scheduleQueue"];
+    if (scheduleQueue) {
+        NSMutableArray *scheduledEvents = [NSMutableArray array];
+        [scheduleLock lock];
+        OFTimerWheelEnumerate(scheduleQueue, ^(const void *value, NSTimeInterval deadline){
+            [scheduledEvents addObject:(OFScheduledEvent *)value];
+        });
+        [scheduleLock unlock];
+        [scheduledEvents sortUsingSelector:@selector(compare:)];
+        [debugDictionary setObject:scheduledEvents forKey:@"scheduleQueue"];
+    }
     if (scheduleLock)
         [debugDictionary setObject:scheduleLock forKey:@"scheduleLock"];
     return debugDictionary;
@@ -248,18 +258,15 @@ static NSLock *instanceCountLock;
 {
     NSMutableArray *eventsToInvokeNow = [[NSMutableArray alloc] init];
     [scheduleLock lock];
-    NSUInteger remainingEventCount = [scheduleQueue count];
-    while (remainingEventCount--) {
-        OFScheduledEvent *event = [scheduleQueue objectAtIndex:0];
-        if ([[event date] timeIntervalSinceNow] > 0.0) {
-            [self scheduleEvents];
-            remainingEventCount = 0;
-        } else {
-            [eventsToInvokeNow addObject:event];
-            [scheduleQueue removeObjectAtIndex:0];
-        }
-    }
+    OFTimerWheelRemoveDueValues(scheduleQueue, [NSDate timeIntervalSinceReferenceDate], ^(const void *value){
+        [eventsToInvokeNow addObject:(OFScheduledEvent *)value];
+    });
+    for (OFScheduledEvent *event in eventsToInvokeNow)
+        [event release]; // The array still holds a reference
+    if (OFTimerWheelCount(scheduleQueue) != 0)
+        [self scheduleEvents];
     [scheduleLock unlock];
+    [eventsToInvokeNow sortUsingSelector:@selector(compare:)];
     [self invokeEvents:eventsToInvokeNow];
     [eventsToInvokeNow release];
 }
@@ -278,6 +285,24 @@ static NSLock *instanceCountLock;
 
 #pragma mark - Private
 
+// Returns a retained array of the removed events. The scheduled events are released only after the wheel is done with them, in case releasing one aborts another.
+- (NSMutableArray *)_removeEventsMatching:(BOOL (NS_NOESCAPE ^)(OFScheduledEvent *event))predicate;
+{
+    NSMutableArray *removedEvents = [[NSMutableArray alloc] init];
+    [scheduleLock lock];
+    OFTimerWheelRemoveValuesMatching(scheduleQueue, ^BOOL(const void *value, NSTimeInterval deadline){
+        OFScheduledEvent *event = (OFScheduledEvent *)value;
+        if (!predicate(event))
+            return NO;
+        [removedEvents addObject:event];
+        return YES;
+    });
+    for (OFScheduledEvent *event in removedEvents)
+        [event release];
+    [scheduleLock unlock];
+    return removedEvents;
+}
+
 + (void)setDebug:(BOOL)newDebug;
 {
     OFSchedulerDebug = newDebug;
@@ -303,19 +328,10 @@ static NSLock *instanceCountLock;
     if (OFSchedulerDebug)
         NSLog(@"%@: Processing termination events", [self shortDescription]);
 
-    NSMutableArray *terminationEvents = [[NSMutableArray alloc] init];
-    [scheduleLock lock];
-    NSUInteger remainingEventCount = [scheduleQueue count];
-    while (remainingEventCount--) {
-        OFScheduledEvent *event;
-
-        event = [scheduleQueue objectAtIndex:remainingEventCount];
-        if ([event fireOnTermination]) {
-            [terminationEvents addObject:event];
-            [scheduleQueue removeObjectAtIndex:remainingEventCount];
-        }
-    }
-    [scheduleLock unlock];
+    NSMutableArray *terminationEvents = [self _removeEventsMatching:^BOOL(OFScheduledEvent *event){
+        return [event fireOnTermination];
+    }];
+    [terminationEvents sortUsingSelector:@selector(compare:)];
     
     if (OFSchedulerDebug)
         NSLog(@"Invoking termination events: %@", terminationEvents);
@@ -0,0 +1,21 @@
+// Copyright 2026 Omni Development, Inc. All rights reserved.
+//
+// This software may only be used and reproduced according to the
+// terms in the file OmniSourceLicense.html, which should be
+// distributed with this project and can also be found at
+// <http://www.omnigroup.com/developer/sourcecode/sourcelicense/>.
+
+#import <OmniFoundation/OFMessageQueue.h>
+
+/*
+ An OFMessageQueue that doesn't funnel every producer and consumer through one lock. Each background processor has its own lock-free ring of invocations per priority band; invocations queued from a processor thread go on that processor's rings, and invocations queued from other threads go on shared lock-free rings. An idle processor takes from its own rings first, then the shared rings, and then steals from the other processors.
+
+ Scheduling follows OFMessageQueue, with a few approximations:
+  - Priorities are compared in bands of 64 (so OFHighPriority, OFMediumPriority and OFLowPriority are still strictly ordered, but priorities within the same band are FIFO per producer rather than globally sorted).
+  - Groups are still limited to maximumSimultaneousThreadsInGroup running invocations. An invocation whose group is full is parked until one of the group's running invocations finishes, rather than left in place in the queue.
+
+ Consumers other than OFQueueProcessor should call -didFinishInvocation: after running each invocation they copy, so that group limits are released promptly.
+ */
+
+@interface OFWorkStealingMessageQueue : OFMessageQueue
+@end
@@ -0,0 +1,666 @@
+// Copyright 2026 Omni Development, Inc. All rights reserved.
+//
+// This software may only be used and reproduced according to the
+// terms in the file OmniSourceLicense.html, which should be
+// distributed with this project and can also be found at
+// <http://www.omnigroup.com/developer/sourcecode/sourcelicense/>.
+
+#import <OmniFoundation/OFWorkStealingMessageQueue.h>
+
+#import <OmniFoundation/OFInvocation.h>
+#import <OmniFoundation/OFMessageQueuePriorityProtocol.h>
+#import <OmniFoundation/OFQueueProcessor.h>
+
+#include <os/lock.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+RCS_ID("$Id$")
+
+OB_REQUIRE_ARC
+
+#define OFWorkStealingBandWidth (64)
+#define OFWorkStealingBandCount (32)
+#define OFWorkStealingMaximumProcessors (64)
+#define OFWorkStealingProcessorRingCapacity (256) // must be a power of two
+#define OFWorkStealingSharedRingCapacity (1024) // must be a power of two
+#define OFWorkStealingQueuedEntryStripeCount (16)
+
+typedef struct {
+    void *invocation; // +1 reference to an OFInvocation
+} OFWorkStealingEntry;
+
+typedef struct {
+    _Atomic(size_t) sequence;
+    OFWorkStealingEntry entry;
+} OFWorkStealingCell;
+
+// A bounded multi-producer, multi-consumer ring. Each cell's sequence number records whether it is ready to be filled or emptied on the current lap around the ring, so pushing and popping each need only a compare-and-swap on their position.
+typedef struct {
+    _Atomic(size_t) enqueuePosition __attribute__((aligned(64)));
+    _Atomic(size_t) dequeuePosition __attribute__((aligned(64)));
+    size_t mask;
+    OFWorkStealingCell cells[];
+} OFWorkStealingRing;
+
+static OFWorkStealingRing *_OFWorkStealingRingCreate(size_t capacity)
+{
+    OBPRECONDITION((capacity & (capacity - 1)) == 0);
+
+    OFWorkStealingRing *ring = calloc(1, sizeof(*ring) + capacity * sizeof(OFWorkStealingCell));
+    ring->mask = capacity - 1;
+    for (size_t cellIndex = 0; cellIndex < capacity; cellIndex++)
+        atomic_init(&ring->cells[cellIndex].sequence, cellIndex);
+    return ring;
+}
+
+static BOOL _OFWorkStealingRingPush(OFWorkStealingRing *ring, OFWorkStealingEntry entry)
+{
+    size_t position = atomic_load_explicit(&ring->enqueuePosition, memory_order_relaxed);
+    while (YES) {
+        OFWorkStealingCell *cell = &ring->cells[position & ring->mask];
+        size_t sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        intptr_t difference = (intptr_t)sequence - (intptr_t)position;
+
+        if (difference == 0) {
+            if (atomic_compare_exchange_weak_explicit(&ring->enqueuePosition, &position, position + 1, memory_order_relaxed, memory_order_relaxed)) {
+                cell->entry = entry;
+                atomic_store_explicit(&cell->sequence, position + 1, memory_order_release);
+                return YES;
+            }
+        } else if (difference < 0) {
+            return NO; // Full
+        } else {
+            position = atomic_load_explicit(&ring->enqueuePosition, memory_order_relaxed);
+        }
+    }
+}
+
+static BOOL _OFWorkStealingRingPop(OFWorkStealingRing *ring, OFWorkStealingEntry *outEntry)
+{
+    size_t position = atomic_load_explicit(&ring->dequeuePosition, memory_order_relaxed);
+    while (YES) {
+        OFWorkStealingCell *cell = &ring->cells[position & ring->mask];
+        size_t sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        intptr_t difference = (intptr_t)sequence - (intptr_t)(position + 1);
+
+        if (difference == 0) {
+            if (atomic_compare_exchange_weak_explicit(&ring->dequeuePosition, &position, position + 1, memory_order_relaxed, memory_order_relaxed)) {
+                *outEntry = cell->entry;
+                atomic_store_explicit(&cell->sequence, position + ring->mask + 1, memory_order_release);
+                return YES;
+            }
+        } else if (difference < 0) {
+            return NO; // Empty
+        } else {
+            position = atomic_load_explicit(&ring->dequeuePosition, memory_order_relaxed);
+        }
+    }
+}
+
+static void _OFWorkStealingRingDestroy(OFWorkStealingRing *ring)
+{
+    if (!ring)
+        return;
+
+    OFWorkStealingEntry entry;
+    while (_OFWorkStealingRingPop(ring, &entry))
+        CFRelease(entry.invocation);
+    free(ring);
+}
+
+// Lazily creates the ring in 'slot', since most queues only ever see a few of the priority bands.
+static OFWorkStealingRing *_OFWorkStealingRingGet(OFWorkStealingRing * _Atomic *slot, size_t capacity)
+{
+    OFWorkStealingRing *ring = atomic_load_explicit(slot, memory_order_acquire);
+    if (ring)
+        return ring;
+
+    OFWorkStealingRing *newRing = _OFWorkStealingRingCreate(capacity);
+    if (atomic_compare_exchange_strong_explicit(slot, &ring, newRing, memory_order_acq_rel, memory_order_acquire))
+        return newRing;
+
+    free(newRing); // Lost the race; 'ring' now holds the winner.
+    return ring;
+}
+
+// A locked double-ended list used when the rings are full, and for parked invocations being put back at the front of their band.
+typedef struct {
+    OFWorkStealingEntry *entries;
+    NSUInteger head, count, capacity;
+} OFWorkStealingOverflow;
+
+static void _OFWorkStealingOverflowPush(OFWorkStealingOverflow *overflow, OFWorkStealingEntry entry, BOOL atFront)
+{
+    if (overflow->count == overflow->capacity) {
+        NSUInteger newCapacity = MAX(2 * overflow->capacity, 16u);
+        OFWorkStealingEntry *newEntries = malloc(newCapacity * sizeof(*newEntries));
+        for (NSUInteger entryIndex = 0; entryIndex < overflow->count; entryIndex++)
+            newEntries[entryIndex] = overflow->entries[(overflow->head + entryIndex) % overflow->capacity];
+        free(overflow->entries);
+        overflow->entries = newEntries;
+        overflow->head = 0;
+        overflow->capacity = newCapacity;
+    }
+
+    if (atFront) {
+        overflow->head = (overflow->head + overflow->capacity - 1) % overflow->capacity;
+        overflow->entries[overflow->head] = entry;
+    } else {
+        overflow->entries[(overflow->head + overflow->count) % overflow->capacity] = entry;
+    }
+    overflow->count++;
+}
+
+static BOOL _OFWorkStealingOverflowPop(OFWorkStealingOverflow *overflow, OFWorkStealingEntry *outEntry)
+{
+    if (overflow->count == 0)
+        return NO;
+
+    *outEntry = overflow->entries[overflow->head];
+    overflow->head = (overflow->head + 1) % overflow->capacity;
+    overflow->count--;
+    return YES;
+}
+
+typedef struct {
+    OFWorkStealingRing * _Atomic rings[OFWorkStealingBandCount];
+} OFWorkStealingProcessorSlot;
+
+// Invocations whose group was already running its maximum number of threads.
+typedef struct {
+    OFWorkStealingEntry entry;
+    NSUInteger band;
+    const void *group;
+} OFWorkStealingParkedEntry;
+
+// Per-thread state, hung off the queue's thread key.
+typedef struct {
+    NSInteger slot; // Index into _processorSlots, or -1 if this isn't one of our processor threads
+    BOOL triedToClaimSlot;
+    const void *claimedGroup; // Counted in _runningGroups for the invocation this thread is running
+    NSUInteger stealIndex; // Where to start looking for a processor to steal from
+} OFWorkStealingThread;
+
+static void _OFWorkStealingThreadDestructor(void *value)
+{
+    free(value);
+}
+
+// Every queued invocation is counted here until it is taken, so that -addQueueEntryOnce: can tell whether an equal one is already waiting. The set is split by hash, each part with its own lock, so producers and consumers working on unrelated invocations don't contend.
+typedef struct {
+    os_unfair_lock lock;
+    CFMutableBagRef entries;
+} OFWorkStealingQueuedEntryStripe;
+
+@implementation OFWorkStealingMessageQueue
+{
+    __weak NSObject <OFMessageQueueDelegate> *_weak_delegate;
+    BOOL _schedulesBasedOnPriority;
+
+    pthread_key_t _threadKey;
+
+    OFWorkStealingProcessorSlot _processorSlots[OFWorkStealingMaximumProcessors];
+    _Atomic(NSUInteger) _processorSlotCount;
+    OFWorkStealingRing * _Atomic _sharedRings[OFWorkStealingBandCount];
+
+    os_unfair_lock _overflowLock;
+    OFWorkStealingOverflow _overflow[OFWorkStealingBandCount];
+    _Atomic(NSUInteger) _overflowCount;
+
+    // Counts are bumped before an entry is published and dropped after it is taken, so a non-zero count means work is (or is about to be) available in that band.
+    _Atomic(NSInteger) _pendingCountByBand[OFWorkStealingBandCount];
+    _Atomic(NSInteger) _pendingCount;
+
+    dispatch_semaphore_t _wakeSemaphore;
+    _Atomic(NSInteger) _sleepingProcessorCount;
+
+    os_unfair_lock _groupLock;
+    CFMutableDictionaryRef _runningCountByGroup;
+    OFWorkStealingParkedEntry *_parkedEntries;
+    NSUInteger _parkedEntryCount, _parkedEntryCapacity;
+
+    OFWorkStealingQueuedEntryStripe _queuedEntryStripes[OFWorkStealingQueuedEntryStripeCount];
+
+    os_unfair_lock _processorsLock;
+    NSMutableArray <OFQueueProcessor *> *_queueProcessors;
+    _Atomic(NSUInteger) _uncreatedProcessorCount;
+    _Atomic(NSUInteger) _createdProcessorCount;
+}
+
+- init;
+{
+    if (!(self = [super init]))
+        return nil;
+
+    _schedulesBasedOnPriority = YES;
+
+    int rc = pthread_key_create(&_threadKey, _OFWorkStealingThreadDestructor);
+    if (rc != 0) {
+        OBASSERT_NOT_REACHED("Unable to create thread key: %d", rc);
+        return nil;
+    }
+
+    _overflowLock = OS_UNFAIR_LOCK_INIT;
+    _wakeSemaphore = dispatch_semaphore_create(0);
+
+    _groupLock = OS_UNFAIR_LOCK_INIT;
+    _runningCountByGroup = CFDictionaryCreateMutable(kCFAllocatorDefault, 0, NULL, NULL);
+
+    for (NSUInteger stripeIndex = 0; stripeIndex < OFWorkStealingQueuedEntryStripeCount; stripeIndex++) {
+        _queuedEntryStripes[stripeIndex].lock = OS_UNFAIR_LOCK_INIT;
+        _queuedEntryStripes[stripeIndex].entries = CFBagCreateMutable(kCFAllocatorDefault, 0, &kCFTypeBagCallBacks);
+    }
+
+    _processorsLock = OS_UNFAIR_LOCK_INIT;
+    _queueProcessors = [[NSMutableArray alloc] init];
+
+    return self;
+}
+
+- (void)dealloc;
+{
+    // Our processors retain us, so by now there is nobody left to run these.
+    pthread_key_delete(_threadKey);
+
+    for (NSUInteger band = 0; band < OFWorkStealingBandCount; band++) {
+        _OFWorkStealingRingDestroy(atomic_load(&_sharedRings[band]));
+        for (NSUInteger slot = 0; slot < OFWorkStealingMaximumProcessors; slot++)
+            _OFWorkStealingRingDestroy(atomic_load(&_processorSlots[slot].rings[band]));
+
+        OFWorkStealingEntry entry;
+        while (_OFWorkStealingOverflowPop(&_overflow[band], &entry))
+            CFRelease(entry.invocation);
+        free(_overflow[band].entries);
+    }
+
+    for (NSUInteger parkedIndex = 0; parkedIndex < _parkedEntryCount; parkedIndex++)
+        CFRelease(_parkedEntries[parkedIndex].entry.invocation);
+    free(_parkedEntries);
+
+    CFRelease(_runningCountByGroup);
+
+    for (NSUInteger stripeIndex = 0; stripeIndex < OFWorkStealingQueuedEntryStripeCount; stripeIndex++)
+        CFRelease(_queuedEntryStripes[stripeIndex].entries);
+}
+
+#pragma mark - OFMessageQueue subclass
+
+- (void)setDelegate:(id <OFMessageQueueDelegate>)aDelegate;
+{
+    OBPRECONDITION(aDelegate == nil || [(id)aDelegate conformsToProtocol:@protocol(OFMessageQueueDelegate)]);
+    _weak_delegate = aDelegate;
+}
+
+- (void)startBackgroundProcessors:(NSUInteger)processorCount;
+{
+    atomic_fetch_add(&_uncreatedProcessorCount, processorCount);
+
+    // Start enough to handle messages already queued; the rest are started as more work arrives.
+    NSInteger pendingCount = atomic_load(&_pendingCount);
+    for (NSInteger processorIndex = 0; processorIndex < pendingCount; processorIndex++) {
+        if (![self _createProcessorIfNeeded])
+            break;
+    }
+}
+
+- (void)setSchedulesBasedOnPriority:(BOOL)shouldScheduleBasedOnPriority;
+{
+    _schedulesBasedOnPriority = shouldScheduleBasedOnPriority;
+}
+
+- (BOOL)hasInvocations;
+{
+    if (atomic_load(&_pendingCount) > 0)
+        return YES;
+
+    os_unfair_lock_lock(&_groupLock);
+    BOOL hasParkedEntries = (_parkedEntryCount > 0);
+    os_unfair_lock_unlock(&_groupLock);
+
+    return hasParkedEntries;
+}
+
+- (OFInvocation *)copyNextInvocationWithBlock:(BOOL)shouldBlock;
+{
+    OFWorkStealingThread *thread = [self _currentThreadClaimingProcessorSlot:shouldBlock];
+
+    // Callers that don't go through OFQueueProcessor may not have told us they finished their last invocation.
+    if (thread->claimedGroup)
+        [self _releaseClaimedGroupForThread:thread];
+
+    while (YES) {
+        OFWorkStealingEntry entry;
+        NSUInteger band;
+        if ([self _takeEntry:&entry band:&band forThread:thread]) {
+            OFInvocation *invocation = (__bridge_transfer OFInvocation *)entry.invocation;
+            if (![self _claimGroupForInvocation:invocation entry:entry band:band thread:thread])
+                continue;
+
+            OFWorkStealingQueuedEntryStripe *stripe = [self _queuedEntryStripeForInvocation:invocation];
+            os_unfair_lock_lock(&stripe->lock);
+            CFBagRemoveValue(stripe->entries, (__bridge const void *)invocation);
+            os_unfair_lock_unlock(&stripe->lock);
+            return invocation;
+        }
+
+        if (!shouldBlock)
+            return nil;
+
+        // Announce that we are going to sleep before the final check for work, so that a producer publishing concurrently either sees us and signals, or is seen by us.
+        atomic_fetch_add(&_sleepingProcessorCount, 1);
+        if (atomic_load(&_pendingCount) > 0) {
+            NSInteger sleepingCount = atomic_load(&_sleepingProcessorCount);
+            while (sleepingCount > 0 && !atomic_compare_exchange_weak(&_sleepingProcessorCount, &sleepingCount, sleepingCount - 1))
+                ;
+            if (sleepingCount == 0) {
+                // A producer already took our place in the count and is signalling us; absorb that.
+                dispatch_semaphore_wait(_wakeSemaphore, DISPATCH_TIME_FOREVER);
+            }
+            continue;
+        }
+
+        dispatch_semaphore_wait(_wakeSemaphore, DISPATCH_TIME_FOREVER);
+    }
+}
+
+- (void)didFinishInvocation:(OFInvocation *)invocation;
+{
+    OFWorkStealingThread *thread = pthread_getspecific(_threadKey);
+    if (thread && thread->claimedGroup)
+        [self _releaseClaimedGroupForThread:thread];
+}
+
+- (void)addQueueEntry:(OFInvocation *)aQueueEntry;
+{
+    OBPRECONDITION(aQueueEntry);
+    if (!aQueueEntry)
+        return;
+
+    // Log a backtrace buffer for the enqueue site of the delayed invocation (we also log one when it is invoked, so we can match up which one crashed and where it came from).
+    OBRecordBacktraceWithContext(sel_getName(aQueueEntry.selector), OBBacktraceBuffer_PerformSelector, (__bridge void *)aQueueEntry);
+
+    OFWorkStealingQueuedEntryStripe *stripe = [self _queuedEntryStripeForInvocation:aQueueEntry];
+    os_unfair_lock_lock(&stripe->lock);
+    CFBagAddValue(stripe->entries, (__bridge const void *)aQueueEntry);
+    os_unfair_lock_unlock(&stripe->lock);
+
+    OFWorkStealingEntry entry = {.invocation = (__bridge_retained void *)aQueueEntry};
+    [self _publishEntry:entry band:[self _bandForInvocation:aQueueEntry] atFront:NO];
+}
+
+- (void)addQueueEntryOnce:(OFInvocation *)aQueueEntry;
+{
+    OBPRECONDITION(aQueueEntry);
+    if (!aQueueEntry)
+        return;
+
+    // Unlike OFMessageQueue, check and insert under one lock so that two racing callers can't both queue the same invocation. Equal invocations hash to the same stripe, so its lock is enough.
+    OFWorkStealingQueuedEntryStripe *stripe = [self _queuedEntryStripeForInvocation:aQueueEntry];
+    os_unfair_lock_lock(&stripe->lock);
+    BOOL alreadyQueued = CFBagContainsValue(stripe->entries, (__bridge const void *)aQueueEntry);
+    if (!alreadyQueued)
+        CFBagAddValue(stripe->entries, (__bridge const void *)aQueueEntry);
+    os_unfair_lock_unlock(&stripe->lock);
+
+    if (alreadyQueued)
+        return;
+
+    OBRecordBacktraceWithContext(sel_getName(aQueueEntry.selector), OBBacktraceBuffer_PerformSelector, (__bridge void *)aQueueEntry);
+
+    OFWorkStealingEntry entry = {.invocation = (__bridge_retained void *)aQueueEntry};
+    [self _publishEntry:entry band:[self _bandForInvocation:aQueueEntry] atFront:NO];
+}
+
+#pragma mark - Debugging
+
+- (NSMutableDictionary *)debugDictionary;
+{
+    NSMutableDictionary *debugDictionary = [super debugDictionary];
+
+    [debugDictionary setObject:@(atomic_load(&_pendingCount)) forKey:@"pendingCount"];
+    [debugDictionary setObject:@(atomic_load(&_sleepingProcessorCount)) forKey:@"sleepingProcessorCount"];
+    [debugDictionary setObject:@(atomic_load(&_createdProcessorCount)) forKey:@"createdProcessorCount"];
+    [debugDictionary setObject:@(atomic_load(&_uncreatedProcessorCount)) forKey:@"uncreatedProcessorCount"];
+    [debugDictionary setObject:_schedulesBasedOnPriority ? @"YES" : @"NO" forKey:@"schedulesBasedOnPriority"];
+
+    os_unfair_lock_lock(&_groupLock);
+    [debugDictionary setObject:@(_parkedEntryCount) forKey:@"parkedEntryCount"];
+    os_unfair_lock_unlock(&_groupLock);
+
+    id <OFMessageQueueDelegate> strongDelegate = _weak_delegate;
+    if (strongDelegate)
+        [debugDictionary setObject:strongDelegate forKey:@"delegate"];
+
+    return debugDictionary;
+}
+
+#pragma mark - Private
+
+- (NSUInteger)_bandForInvocation:(OFInvocation *)invocation;
+{
+    if (!_schedulesBasedOnPriority)
+        return 0;
+
+    unsigned int priority = [invocation messageQueueSchedulingInfo].priority;
+    OBASSERT(priority != 0);
+    return MIN(priority / OFWorkStealingBandWidth, (unsigned int)OFWorkStealingBandCount - 1);
+}
+
+- (OFWorkStealingQueuedEntryStripe *)_queuedEntryStripeForInvocation:(OFInvocation *)invocation;
+{
+    return &_queuedEntryStripes[[invocation hash] % OFWorkStealingQueuedEntryStripeCount];
+}
+
+- (OFWorkStealingThread *)_currentThreadClaimingProcessorSlot:(BOOL)claimSlot;
+{
+    OFWorkStealingThread *thread = pthread_getspecific(_threadKey);
+    if (!thread) {
+        thread = calloc(1, sizeof(*thread));
+        thread->slot = -1;
+        pthread_setspecific(_threadKey, thread);
+    }
+
+    // Only threads that block waiting for work (that is, our processors) get their own rings. Threads that just drain the queue now and then take from the shared rings and steal.
+    if (claimSlot && !thread->triedToClaimSlot) {
+        thread->triedToClaimSlot = YES;
+
+        NSUInteger slotCount = atomic_load(&_processorSlotCount);
+        while (slotCount < OFWorkStealingMaximumProcessors) {
+            if (atomic_compare_exchange_weak(&_processorSlotCount, &slotCount, slotCount + 1)) {
+                thread->slot = slotCount;
+                break;
+            }
+        }
+    }
+
+    return thread;
+}
+
+- (void)_publishEntry:(OFWorkStealingEntry)entry band:(NSUInteger)band atFront:(BOOL)atFront;
+{
+    atomic_fetch_add(&_pendingCountByBand[band], 1);
+    NSInteger previousPendingCount = atomic_fetch_add(&_pendingCount, 1);
+
+    BOOL published = NO;
+    if (!atFront) {
+        OFWorkStealingThread *thread = pthread_getspecific(_threadKey);
+        if (thread && thread->slot >= 0)
+            published = _OFWorkStealingRingPush(_OFWorkStealingRingGet(&_processorSlots[thread->slot].rings[band], OFWorkStealingProcessorRingCapacity), entry);
+        if (!published)
+            published = _OFWorkStealingRingPush(_OFWorkStealingRingGet(&_sharedRings[band], OFWorkStealingSharedRingCapacity), entry);
+    }
+    if (!published) {
+        os_unfair_lock_lock(&_overflowLock);
+        _OFWorkStealingOverflowPush(&_overflow[band], entry, atFront);
+        atomic_fetch_add(&_overflowCount, 1);
+        os_unfair_lock_unlock(&_overflowLock);
+    }
+
+    // Wake a sleeping processor, if there is one. Otherwise start another if we are allowed.
+    NSInteger sleepingCount = atomic_load(&_sleepingProcessorCount);
+    while (sleepingCount > 0) {
+        if (atomic_compare_exchange_weak(&_sleepingProcessorCount, &sleepingCount, sleepingCount - 1)) {
+            dispatch_semaphore_signal(_wakeSemaphore);
+            break;
+        }
+    }
+    if (sleepingCount == 0 && atomic_load(&_uncreatedProcessorCount) > 0)
+        [self _createProcessorIfNeeded];
+
+    if (previousPendingCount == 0) {
+        id <OFMessageQueueDelegate> strongDelegate = _weak_delegate;
+        [strongDelegate queueHasInvocations:self];
+    }
+}
+
+- (BOOL)_takeEntry:(OFWorkStealingEntry *)outEntry band:(NSUInteger *)outBand forThread:(OFWorkStealingThread *)thread;
+{
+    for (NSUInteger band = 0; band < OFWorkStealingBandCount; band++) {
+        if (atomic_load_explicit(&_pendingCountByBand[band], memory_order_relaxed) <= 0)
+            continue;
+
+        BOOL found = NO;
+
+        // Our own work first, since it is likely to be warm in our caches.
+        if (thread->slot >= 0) {
+            OFWorkStealingRing *ring = atomic_load_explicit(&_processorSlots[thread->slot].rings[band], memory_order_acquire);
+            found = (ring != NULL) && _OFWorkStealingRingPop(ring, outEntry);
+        }
+
+        // Parked invocations are put back in the overflow list, at the front, so look there before newer work.
+        if (!found && atomic_load_explicit(&_overflowCount, memory_order_relaxed) > 0) {
+            os_unfair_lock_lock(&_overflowLock);
+            found = _OFWorkStealingOverflowPop(&_overflow[band], outEntry);
+            if (found)
+                atomic_fetch_sub(&_overflowCount, 1);
+            os_unfair_lock_unlock(&_overflowLock);
+        }
+
+        if (!found) {
+            OFWorkStealingRing *ring = atomic_load_explicit(&_sharedRings[band], memory_order_acquire);
+            found = (ring != NULL) && _OFWorkStealingRingPop(ring, outEntry);
+        }
+
+        if (!found) {
+            NSUInteger slotCount = atomic_load_explicit(&_processorSlotCount, memory_order_relaxed);
+            for (NSUInteger victimOffset = 0; victimOffset < slotCount && !found; victimOffset++) {
+                NSUInteger victim = (thread->stealIndex + victimOffset) % slotCount;
+                if ((NSInteger)victim == thread->slot)
+                    continue;
+
+                OFWorkStealingRing *ring = atomic_load_explicit(&_processorSlots[victim].rings[band], memory_order_acquire);
+                if (ring && _OFWorkStealingRingPop(ring, outEntry)) {
+                    thread->stealIndex = victim; // It probably has more
+                    found = YES;
+                }
+            }
+        }
+
+        if (found) {
+            atomic_fetch_sub(&_pendingCountByBand[band], 1);
+            atomic_fetch_sub(&_pendingCount, 1);
+            *outBand = band;
+            return YES;
+        }
+    }
+
+    return NO;
+}
+
+// Returns NO (having parked the invocation) if its group is already running as many invocations as it allows.
+- (BOOL)_claimGroupForInvocation:(OFInvocation *)invocation entry:(OFWorkStealingEntry)entry band:(NSUInteger)band thread:(OFWorkStealingThread *)thread;
+{
+    OBPRECONDITION(thread->claimedGroup == NULL);
+
+    OFMessageQueueSchedulingInfo schedulingInfo = [invocation messageQueueSchedulingInfo];
+    // Count processors we haven't started yet too, since they are started as work arrives and a group shouldn't get extra threads just because it was queued early.
+    NSUInteger processorCount = atomic_load(&_createdProcessorCount) + atomic_load(&_uncreatedProcessorCount);
+
+    // Null group is special, and can use as many threads as it wants. Likewise for groups allowed as many threads as we have processors.
+    if (schedulingInfo.group == NULL || processorCount == 0 || schedulingInfo.maximumSimultaneousThreadsInGroup >= processorCount)
+        return YES;
+
+    OBASSERT(schedulingInfo.maximumSimultaneousThreadsInGroup > 0);
+
+    os_unfair_lock_lock(&_groupLock);
+
+    intptr_t runningCount = (intptr_t)CFDictionaryGetValue(_runningCountByGroup, schedulingInfo.group);
+    if (runningCount < schedulingInfo.maximumSimultaneousThreadsInGroup) {
+        CFDictionarySetValue(_runningCountByGroup, schedulingInfo.group, (const void *)(runningCount + 1));
+        os_unfair_lock_unlock(&_groupLock);
+
+        thread->claimedGroup = schedulingInfo.group;
+        return YES;
+    }
+
+    if (_parkedEntryCount == _parkedEntryCapacity) {
+        _parkedEntryCapacity = MAX(2 * _parkedEntryCapacity, 16u);
+        _parkedEntries = reallocf(_parkedEntries, _parkedEntryCapacity * sizeof(*_parkedEntries));
+    }
+    entry.invocation = (__bridge_retained void *)invocation; // Our caller's reference goes away when it moves on
+    _parkedEntries[_parkedEntryCount++] = (OFWorkStealingParkedEntry){.entry = entry, .band = band, .group = schedulingInfo.group};
+
+    os_unfair_lock_unlock(&_groupLock);
+    return NO;
+}
+
+- (void)_releaseClaimedGroupForThread:(OFWorkStealingThread *)thread;
+{
+    const void *group = thread->claimedGroup;
+    OBPRECONDITION(group);
+    thread->claimedGroup = NULL;
+
+    os_unfair_lock_lock(&_groupLock);
+
+    intptr_t runningCount = (intptr_t)CFDictionaryGetValue(_runningCountByGroup, group) - 1;
+    OBASSERT(runningCount >= 0);
+    if (runningCount > 0)
+        CFDictionarySetValue(_runningCountByGroup, group, (const void *)runningCount);
+    else
+        CFDictionaryRemoveValue(_runningCountByGroup, group);
+
+    // The group has room for one more now; release its highest priority (and then oldest) parked invocation.
+    NSUInteger bestIndex = NSNotFound;
+    for (NSUInteger parkedIndex = 0; parkedIndex < _parkedEntryCount; parkedIndex++) {
+        if (_parkedEntries[parkedIndex].group != group)
+            continue;
+        if (bestIndex == NSNotFound || _parkedEntries[parkedIndex].band < _parkedEntries[bestIndex].band)
+            bestIndex = parkedIndex;
+    }
+
+    OFWorkStealingParkedEntry released;
+    if (bestIndex != NSNotFound) {
+        released = _parkedEntries[bestIndex];
+        memmove(&_parkedEntries[bestIndex], &_parkedEntries[bestIndex + 1], (_parkedEntryCount - bestIndex - 1) * sizeof(*_parkedEntries));
+        _parkedEntryCount--;
+    }
+
+    os_unfair_lock_unlock(&_groupLock);
+
+    if (bestIndex != NSNotFound)
+        [self _publishEntry:released.entry band:released.band atFront:YES];
+}
+
+- (BOOL)_createProcessorIfNeeded;
+{
+    os_unfair_lock_lock(&_processorsLock);
+
+    NSUInteger uncreatedCount = atomic_load(&_uncreatedProcessorCount);
+    if (uncreatedCount == 0) {
+        os_unfair_lock_unlock(&_processorsLock);
+        return NO;
+    }
+    atomic_store(&_uncreatedProcessorCount, uncreatedCount - 1);
+    atomic_fetch_add(&_createdProcessorCount, 1);
+
+    OFQueueProcessor *newProcessor = [[OFQueueProcessor alloc] initForQueue:self];
+    [_queueProcessors addObject:newProcessor];
+
+    os_unfair_lock_unlock(&_processorsLock);
+
+    [newProcessor startProcessingQueueInNewThread];
+    return YES;
+}
+
+@end
@@ -299,5 +299,203 @@ struct expectedEnumeration {
     free(numbers);
 }
 
+- (void)testBTreeBulkLoadAndCursor
+{
+    for (NSUInteger count = 0; count < 2000; count = (count < 40) ? count + 1 : count * 3) {
+        for (double fill = 0.5; fill <= 1.0; fill += 0.5) {
+            OFBTree btree;
+            OFBTreeInit(&btree, sizeof(int) * 16, sizeof(int), mallocAllocator, mallocDeallocator, testComparator);
+            
+            // Even numbers only, so that we can seek to values that aren't present
+            int *numbers = malloc(sizeof(*numbers) * (count + 1));
+            for (NSUInteger i = 0; i < count; i++)
+                numbers[i] = 2 * (int)i;
+            OFBTreeBulkLoad(&btree, numbers, count, fill);
+            
+            __block NSUInteger position = 0;
+            OFBTreeEnumerate(&btree, ^(const OFBTree *tree, void *element){
+                XCTAssertEqual(*(int *)element, numbers[position], @"count=%lu fill=%f", count, fill);
+                position ++;
+            });
+            XCTAssertEqual(position, count);
+            
+            OFBTreeCursor cursor;
+            int *value = OFBTreeCursorSeekFirst(&btree, &cursor);
+            for (NSUInteger i = 0; i < count; i++) {
+                XCTAssertTrue(value != NULL && *value == numbers[i]);
+                value = OFBTreeCursorNext(&btree, &cursor);
+            }
+            XCTAssertTrue(value == NULL);
+            
+            value = OFBTreeCursorSeekLast(&btree, &cursor);
+            for (NSUInteger i = count; i > 0; i--) {
+                XCTAssertTrue(value != NULL && *value == numbers[i-1]);
+                value = OFBTreeCursorPrevious(&btree, &cursor);
+            }
+            XCTAssertTrue(value == NULL);
+            
+            for (int bound = -1; bound <= 2 * (int)count; bound++) {
+                value = OFBTreeCursorSeek(&btree, &cursor, &bound);
+                int expected = (bound < 0) ? 0 : (bound + 1) & ~1;
+                if (expected >= 2 * (int)count) {
+                    XCTAssertTrue(value == NULL, @"count=%lu bound=%d", count, bound);
+                    continue;
+                }
+                XCTAssertTrue(value != NULL && *value == expected, @"count=%lu bound=%d", count, bound);
+                XCTAssertTrue(OFBTreeCursorCurrent(&btree, &cursor) == value);
+                
+                int *next = OFBTreeCursorNext(&btree, &cursor);
+                if (expected + 2 < 2 * (int)count)
+                    XCTAssertTrue(next != NULL && *next == expected + 2, @"count=%lu bound=%d", count, bound);
+                else
+                    XCTAssertTrue(next == NULL, @"count=%lu bound=%d", count, bound);
+                
+                OFBTreeCursorSeek(&btree, &cursor, &bound);
+                int *previous = OFBTreeCursorPrevious(&btree, &cursor);
+                if (expected > 0)
+                    XCTAssertTrue(previous != NULL && *previous == expected - 2, @"count=%lu bound=%d", count, bound);
+                else
+                    XCTAssertTrue(previous == NULL, @"count=%lu bound=%d", count, bound);
+            }
+            
+            // A bulk loaded tree should still support the normal mutation operations
+            int odd = 1;
+            OFBTreeInsert(&btree, &odd);
+            for (NSUInteger i = 0; i < count; i++)
+                XCTAssertTrue(OFBTreeDelete(&btree, &numbers[i]));
+            CHECK_ENUMERATION(btree, 1);
+            
+            OFBTreeDestroy(&btree);
+            free(numbers);
+        }
+    }
+}
+
+- (void)testBTreeBulkLoadSparseFillStaysWithinCursorDepth
+{
+    // With these tiny nodes and the smallest fill, every level only triples the number of elements, which would need more levels than a cursor can hold.
+    const NSUInteger count = 200000;
+    OFBTree btree;
+    OFBTreeInit(&btree, sizeof(int) * 16, sizeof(int), mallocAllocator, mallocDeallocator, testComparator);
+    
+    int *numbers = malloc(sizeof(*numbers) * count);
+    for (NSUInteger i = 0; i < count; i++)
+        numbers[i] = (int)i;
+    OFBTreeBulkLoad(&btree, numbers, count, 0.01);
+    XCTAssertTrue(btree.height <= sizeof(((OFBTreeCursor *)NULL)->nodeStack) / sizeof(((OFBTreeCursor *)NULL)->nodeStack[0]), @"height=%u", btree.height);
+    
+    OFBTreeCursor cursor;
+    int *value = OFBTreeCursorSeekFirst(&btree, &cursor);
+    for (NSUInteger i = 0; i < count; i++) {
+        if (!(value != NULL && *value == numbers[i])) {
+            XCTFail(@"Element %lu is missing", i);
+            break;
+        }
+        value = OFBTreeCursorNext(&btree, &cursor);
+    }
+    XCTAssertTrue(value == NULL);
+    
+    OFBTreeDestroy(&btree);
+    free(numbers);
+}
+
+#define BENCHMARK_COUNT 1000000
+
+static NSUInteger *_sortedBenchmarkNumbers(void)
+{
+    NSUInteger *numbers = malloc(sizeof(*numbers) * BENCHMARK_COUNT);
+    for (NSUInteger i = 0; i < BENCHMARK_COUNT; i++)
+        numbers[i] = i+1;
+    return numbers;
+}
+
+- (void)testBTreeRepeatedInsertSpeed
+{
+    if (![[self class] shouldRunSlowUnitTests]) {
+        NSLog(@"*** SKIPPING slow test [%@ %@]", [self class], NSStringFromSelector(_cmd));
+        return;
+    }
+    
+    NSUInteger *numbers = _sortedBenchmarkNumbers();
+    [self measureBlock:^{
+        OFBTree btree;
+        OFBTreeInit(&btree, vm_page_size, sizeof(*numbers), pageAllocator, pageDeallocator, testComparator);
+        for (NSUInteger i = 0; i < BENCHMARK_COUNT; i++)
+            OFBTreeInsert(&btree, &numbers[i]);
+        OFBTreeDestroy(&btree);
+    }];
+    free(numbers);
+}
+
+- (void)testBTreeBulkLoadSpeed
+{
+    if (![[self class] shouldRunSlowUnitTests]) {
+        NSLog(@"*** SKIPPING slow test [%@ %@]", [self class], NSStringFromSelector(_cmd));
+        return;
+    }
+    
+    NSUInteger *numbers = _sortedBenchmarkNumbers();
+    [self measureBlock:^{
+        OFBTree btree;
+        OFBTreeInit(&btree, vm_page_size, sizeof(*numbers), pageAllocator, pageDeallocator, testComparator);
+        OFBTreeBulkLoad(&btree, numbers, BENCHMARK_COUNT, 1.0);
+        OFBTreeDestroy(&btree);
+    }];
+    free(numbers);
+}
+
+- (void)testBTreeNextLoopSpeed
+{
+    if (![[self class] shouldRunSlowUnitTests]) {
+        NSLog(@"*** SKIPPING slow test [%@ %@]", [self class], NSStringFromSelector(_cmd));
+        return;
+    }
+    
+    NSUInteger *numbers = _sortedBenchmarkNumbers();
+    OFBTree btree;
+    OFBTreeInit(&btree, vm_page_size, sizeof(*numbers), pageAllocator, pageDeallocator, testComparator);
+    OFBTreeBulkLoad(&btree, numbers, BENCHMARK_COUNT, 1.0);
+    
+    [self measureBlock:^{
+        NSUInteger walked = 0;
+        NSUInteger *value = OFBTreeFindNear(&btree, NULL, 1, NO);
+        while (value) {
+            walked ++;
+            value = OFBTreeNext(&btree, value);
+        }
+        XCTAssertEqual(walked, (NSUInteger)BENCHMARK_COUNT);
+    }];
+    
+    OFBTreeDestroy(&btree);
+    free(numbers);
+}
+
+- (void)testBTreeCursorWalkSpeed
+{
+    if (![[self class] shouldRunSlowUnitTests]) {
+        NSLog(@"*** SKIPPING slow test [%@ %@]", [self class], NSStringFromSelector(_cmd));
+        return;
+    }
+    
+    NSUInteger *numbers = _sortedBenchmarkNumbers();
+    OFBTree btree;
+    OFBTreeInit(&btree, vm_page_size, sizeof(*numbers), pageAllocator, pageDeallocator, testComparator);
+    OFBTreeBulkLoad(&btree, numbers, BENCHMARK_COUNT, 1.0);
+    
+    [self measureBlock:^{
+        NSUInteger walked = 0;
+        OFBTreeCursor cursor;
+        NSUInteger *value = OFBTreeCursorSeekFirst(&btree, &cursor);
+        while (value) {
+            walked ++;
+            value = OFBTreeCursorNext(&btree, &cursor);
+        }
+        XCTAssertEqual(walked, (NSUInteger)BENCHMARK_COUNT);
+    }];
+    
+    OFBTreeDestroy(&btree);
+    free(numbers);
+}
+
 @end
 
@@ -0,0 +1,203 @@
+// Copyright 2026 Omni Development, Inc. All rights reserved.
+//
+// This software may only be used and reproduced according to the
+// terms in the file OmniSourceLicense.html, which should be
+// distributed with this project and can also be found at
+// <http://www.omnigroup.com/developer/sourcecode/sourcelicense/>.
+
+#import "OFTestCase.h"
+
+#import <OmniFoundation/OFBulkBlockPool.h>
+#import <OmniBase/OmniBase.h>
+#import <os/lock.h>
+
+RCS_ID("$Id$");
+
+#define BLOCK_SIZE (24)
+
+@interface OFBulkBlockPoolTests : OFTestCase
+@end
+
+@implementation OFBulkBlockPoolTests
+
+- (void)testSingleThreadedStatistics
+{
+    OFBulkBlockPool pool;
+    OFBulkBlockPoolInitialize(&pool, BLOCK_SIZE);
+    
+    OFByte *blocks[1000];
+    for (NSUInteger blockIndex = 0; blockIndex < 1000; blockIndex++)
+        blocks[blockIndex] = OFBulkBlockPoolAllocate(&pool);
+    for (NSUInteger blockIndex = 0; blockIndex < 1000; blockIndex += 2)
+        OFBulkBlockPoolDeallocate(blocks[blockIndex]);
+    
+    OFBulkBlockPoolStatistics statistics;
+    OFBulkBlockPoolGetStatistics(&pool, &statistics);
+    XCTAssertEqual(statistics.liveBlockCount, (size_t)500);
+    XCTAssertEqual(statistics.pageCount * statistics.blocksPerPage, statistics.liveBlockCount + statistics.freeBlockCount);
+    XCTAssertTrue(statistics.fragmentation > 0.0 && statistics.fragmentation < 1.0);
+    
+    OFBulkBlockPoolDeallocateAllBlocks(&pool);
+}
+
+- (void)testConcurrentCrossThreadFreesReclaimPages
+{
+    OFConcurrentBulkBlockPool *pool = OFConcurrentBulkBlockPoolCreate(BLOCK_SIZE);
+    const NSUInteger blockCount = 100000;
+    OFByte **blocks = malloc(sizeof(*blocks) * blockCount);
+    
+    // Allocate everything on one thread...
+    for (NSUInteger blockIndex = 0; blockIndex < blockCount; blockIndex++) {
+        blocks[blockIndex] = OFConcurrentBulkBlockPoolAllocate(pool);
+        memset(blocks[blockIndex], (int)(blockIndex & 0xff), BLOCK_SIZE);
+    }
+    
+    OFBulkBlockPoolStatistics statistics;
+    OFConcurrentBulkBlockPoolGetStatistics(pool, &statistics);
+    XCTAssertEqual(statistics.liveBlockCount, (size_t)blockCount);
+    
+    // ... and free it on several others.
+    dispatch_apply(8, dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^(size_t worker){
+        for (NSUInteger blockIndex = worker; blockIndex < blockCount; blockIndex += 8) {
+            OFByte *block = blocks[blockIndex];
+            XCTAssertEqual(block[BLOCK_SIZE - 1], (OFByte)(blockIndex & 0xff));
+            OFConcurrentBulkBlockPoolDeallocate(block);
+        }
+        OFConcurrentBulkBlockPoolTrim(pool);
+    });
+    OFConcurrentBulkBlockPoolTrim(pool);
+    
+    OFConcurrentBulkBlockPoolGetStatistics(pool, &statistics);
+    XCTAssertEqual(statistics.liveBlockCount, (size_t)0);
+    XCTAssertTrue(statistics.reclaimedPageCount > 0);
+    
+    free(blocks);
+    OFConcurrentBulkBlockPoolDestroy(pool);
+}
+
+- (void)testConcurrentChurn
+{
+    OFConcurrentBulkBlockPool *pool = OFConcurrentBulkBlockPoolCreate(BLOCK_SIZE);
+    
+    dispatch_apply(8, dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^(size_t worker){
+        OFByte *blocks[512];
+        for (NSUInteger round = 0; round < 200; round++) {
+            for (NSUInteger blockIndex = 0; blockIndex < 512; blockIndex++) {
+                blocks[blockIndex] = OFConcurrentBulkBlockPoolAllocate(pool);
+                memset(blocks[blockIndex], (int)worker, BLOCK_SIZE);
+            }
+            for (NSUInteger blockIndex = 0; blockIndex < 512; blockIndex++) {
+                XCTAssertEqual(blocks[blockIndex][0], (OFByte)worker);
+                OFConcurrentBulkBlockPoolDeallocate(blocks[blockIndex]);
+            }
+        }
+    });
+    
+    OFBulkBlockPoolStatistics statistics;
+    OFConcurrentBulkBlockPoolGetStatistics(pool, &statistics);
+    XCTAssertEqual(statistics.liveBlockCount, (size_t)0);
+    
+    OFConcurrentBulkBlockPoolDestroy(pool);
+}
+
+#pragma mark - Scaling
+
+// Each of these pushes millions of allocations through the pool on every measured pass, so they only run with the other slow tests.
+static const NSUInteger ScalingOperationCount = 4000000;
+
+- (void)_measureLockedPoolWithThreadCount:(NSUInteger)threadCount;
+{
+    OFBulkBlockPool pool;
+    OFBulkBlockPoolInitialize(&pool, BLOCK_SIZE);
+    __block os_unfair_lock lock = OS_UNFAIR_LOCK_INIT;
+    
+    [self measureBlock:^{
+        dispatch_apply(threadCount, dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^(size_t worker){
+            OFByte *blocks[64];
+            for (NSUInteger round = 0; round < ScalingOperationCount / threadCount / 64; round++) {
+                for (NSUInteger blockIndex = 0; blockIndex < 64; blockIndex++) {
+                    os_unfair_lock_lock(&lock);
+                    blocks[blockIndex] = OFBulkBlockPoolAllocate(&pool);
+                    os_unfair_lock_unlock(&lock);
+                }
+                for (NSUInteger blockIndex = 0; blockIndex < 64; blockIndex++) {
+                    os_unfair_lock_lock(&lock);
+                    OFBulkBlockPoolDeallocate(blocks[blockIndex]);
+                    os_unfair_lock_unlock(&lock);
+                }
+            }
+        });
+    }];
+    
+    OFBulkBlockPoolStatistics statistics;
+    OFBulkBlockPoolGetStatistics(&pool, &statistics);
+    XCTAssertEqual(statistics.liveBlockCount, (size_t)0);
+    
+    OFBulkBlockPoolDeallocateAllBlocks(&pool);
+}
+
+- (void)_measureConcurrentPoolWithThreadCount:(NSUInteger)threadCount;
+{
+    OFConcurrentBulkBlockPool *pool = OFConcurrentBulkBlockPoolCreate(BLOCK_SIZE);
+    
+    [self measureBlock:^{
+        dispatch_apply(threadCount, dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^(size_t worker){
+            OFByte *blocks[64];
+            for (NSUInteger round = 0; round < ScalingOperationCount / threadCount / 64; round++) {
+                for (NSUInteger blockIndex = 0; blockIndex < 64; blockIndex++)
+                    blocks[blockIndex] = OFConcurrentBulkBlockPoolAllocate(pool);
+                for (NSUInteger blockIndex = 0; blockIndex < 64; blockIndex++)
+                    OFConcurrentBulkBlockPoolDeallocate(blocks[blockIndex]);
+            }
+        });
+    }];
+    
+    // Every worker frees what it allocates, so nothing should be left live, wherever the free blocks ended up.
+    OFBulkBlockPoolStatistics statistics;
+    OFConcurrentBulkBlockPoolGetStatistics(pool, &statistics);
+    XCTAssertEqual(statistics.liveBlockCount, (size_t)0);
+    
+    OFConcurrentBulkBlockPoolDestroy(pool);
+}
+
+- (void)testLockedPoolSpeed_1Thread;
+{
+    if (![[self class] shouldRunSlowUnitTests]) {
+        NSLog(@"*** SKIPPING slow test [%@ %@]", [self class], NSStringFromSelector(_cmd));
+        return;
+    }
+
+    [self _measureLockedPoolWithThreadCount:1];
+}
+
+- (void)testLockedPoolSpeed_8Threads;
+{
+    if (![[self class] shouldRunSlowUnitTests]) {
+        NSLog(@"*** SKIPPING slow test [%@ %@]", [self class], NSStringFromSelector(_cmd));
+        return;
+    }
+
+    [self _measureLockedPoolWithThreadCount:8];
+}
+
+- (void)testConcurrentPoolSpeed_1Thread;
+{
+    if (![[self class] shouldRunSlowUnitTests]) {
+        NSLog(@"*** SKIPPING slow test [%@ %@]", [self class], NSStringFromSelector(_cmd));
+        return;
+    }
+
+    [self _measureConcurrentPoolWithThreadCount:1];
+}
+
+- (void)testConcurrentPoolSpeed_8Threads;
+{
+    if (![[self class] shouldRunSlowUnitTests]) {
+        NSLog(@"*** SKIPPING slow test [%@ %@]", [self class], NSStringFromSelector(_cmd));
+        return;
+    }
+
+    [self _measureConcurrentPoolWithThreadCount:8];
+}
+
+@end
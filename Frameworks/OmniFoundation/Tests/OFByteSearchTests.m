@@ -0,0 +1,204 @@
+// Copyright 2026 Omni Development, Inc. All rights reserved.
+//
+// This software may only be used and reproduced according to the
+// terms in the file OmniSourceLicense.html, which should be
+// distributed with this project and can also be found at
+// <http://www.omnigroup.com/developer/sourcecode/sourcelicense/>.
+
+#import "OFTestCase.h"
+
+#import <OmniFoundation/OFByteSearch.h>
+#import <OmniFoundation/OFByteSet.h>
+#import <OmniFoundation/OFDataCursor.h>
+#import <OmniFoundation/OFRandom.h>
+
+RCS_ID("$Id$");
+
+@interface OFByteSearchTests : OFTestCase
+@end
+
+@implementation OFByteSearchTests
+
+// Mostly a small alphabet, so that sets and patterns match often, with some high bytes to exercise the upper half of the nibble tables.
+static void _fillBuffer(OFRandomState *state, OFByte *bytes, size_t length, unsigned int alphabetSize)
+{
+    for (size_t byteIndex = 0; byteIndex < length; byteIndex++) {
+        OFByte byte = (OFByte)OFRandomNextStateN(state, alphabetSize);
+        if (OFRandomNextStateN(state, 4) == 0)
+            byte |= 0x80;
+        bytes[byteIndex] = byte;
+    }
+}
+
+static NSData *_lines(NSUInteger length)
+{
+    NSMutableData *data = [NSMutableData dataWithCapacity:length];
+    for (NSUInteger lineIndex = 0; [data length] < length; lineIndex++)
+        [data appendData:[[NSString stringWithFormat:@"X-Header-%lu: the quick brown fox jumps over the lazy dog %lu\r\n", lineIndex % 50, lineIndex] dataUsingEncoding:NSASCIIStringEncoding]];
+    [data setLength:length];
+    return data;
+}
+
+- (void)testMatchesScalarReference;
+{
+    static const size_t maximumLength = 300;
+
+    OFRandomState *state = OFRandomStateCreate();
+    OFByte *buffer = malloc(maximumLength + 32);
+
+    for (NSUInteger iteration = 0; iteration < 100000; iteration++) {
+        // Vary the alignment and length, so that every kernel's tail handling gets used.
+        OFByte *bytes = buffer + OFRandomNextStateN(state, 32);
+        size_t length = OFRandomNextStateN(state, maximumLength + 1);
+        unsigned int alphabetSize = 1 + OFRandomNextStateN(state, 255);
+        _fillBuffer(state, bytes, length, alphabetSize);
+
+        OFByteSet *byteSet = [[OFByteSet alloc] init];
+        unsigned int memberCount = OFRandomNextStateN(state, 10) == 0 ? OFRandomNextStateN(state, 256) : OFRandomNextStateN(state, 6);
+        for (unsigned int memberIndex = 0; memberIndex < memberCount; memberIndex++)
+            [byteSet addByte:(OFByte)OFRandomNextStateN(state, 256)];
+        OFByteSearchTable table;
+        OFByteSearchTableInitialize(&table, byteSet);
+        XCTAssertEqual(OFByteSearchForByteInSet(bytes, length, &table), OFByteSearchForByteInSetScalar(bytes, length, &table));
+
+        OFByte byte = length > 0 ? bytes[OFRandomNextStateN(state, (unsigned int)length)] : 0;
+        XCTAssertEqual(OFByteSearchForByte(bytes, length, byte), OFByteSearchForByteScalar(bytes, length, byte));
+
+        // Patterns that are present, nearly present, or random.
+        OFByte pattern[64];
+        size_t patternLength = OFRandomNextStateN(state, OFRandomNextStateN(state, 8) == 0 ? sizeof(pattern) : 12);
+        if (patternLength <= length && OFRandomNextStateN(state, 2) == 0) {
+            memcpy(pattern, bytes + OFRandomNextStateN(state, (unsigned int)(length - patternLength + 1)), patternLength);
+            if (patternLength > 2 && OFRandomNextStateN(state, 3) == 0)
+                pattern[patternLength / 2] ^= 1;
+        } else {
+            _fillBuffer(state, pattern, patternLength, alphabetSize);
+        }
+        XCTAssertEqual(OFByteSearchForBytes(bytes, length, pattern, patternLength), OFByteSearchForBytesScalar(bytes, length, pattern, patternLength));
+    }
+
+    free(buffer);
+    OFRandomStateDestroy(state);
+}
+
+- (void)testEveryByteValue;
+{
+    OFByte bytes[256];
+    for (unsigned int byte = 0; byte < 256; byte++)
+        bytes[byte] = (OFByte)byte;
+
+    OFByteSearchTable table;
+    for (unsigned int byte = 0; byte < 256; byte++) {
+        OFByteSet *byteSet = [[OFByteSet alloc] init];
+        [byteSet addByte:(OFByte)byte];
+        OFByteSearchTableInitialize(&table, byteSet);
+        XCTAssertEqual(OFByteSearchForByteInSet(bytes, sizeof(bytes), &table), (size_t)byte);
+        XCTAssertEqual(OFByteSearchForBytes(bytes, sizeof(bytes), bytes + byte, sizeof(bytes) - byte), (size_t)byte);
+    }
+
+    // A zero-filled table is the empty set.
+    memset(&table, 0, sizeof(table));
+    XCTAssertEqual(OFByteSearchForByteInSet(bytes, sizeof(bytes), &table), sizeof(bytes));
+}
+
+- (void)testCursorNoticesChangedByteSet;
+{
+    NSData *data = [@"key: value; other=thing\r\nnext" dataUsingEncoding:NSASCIIStringEncoding];
+    OFDataCursor *cursor = [[OFDataCursor alloc] initWithData:data];
+    OFByteSet *byteSet = [[OFByteSet alloc] init];
+
+    [byteSet addByte:';'];
+    XCTAssertEqual([cursor offsetToByteInSet:byteSet], 10UL);
+
+    // The cursor caches tables for the last set it saw, so changing that set in place has to be noticed.
+    [byteSet addByte:':'];
+    XCTAssertEqual([cursor offsetToByteInSet:byteSet], 3UL);
+    [byteSet removeAllBytes];
+    XCTAssertEqual([cursor offsetToByteInSet:byteSet], [data length]);
+
+    XCTAssertEqualObjects([cursor readLine], @"key: value; other=thing");
+    XCTAssertEqualObjects([cursor readLine], @"next");
+    XCTAssertFalse([cursor hasMoreData]);
+}
+
+#pragma mark - Benchmarks
+
+- (void)testByteSetSearchPerformance;
+{
+    if (![[self class] shouldRunSlowUnitTests]) {
+        NSLog(@"*** SKIPPING slow test [%@ %@]", [self class], NSStringFromSelector(_cmd));
+        return;
+    }
+
+    NSData *data = _lines(64 * 1024 * 1024);
+    OFByteSet *byteSet = [[OFByteSet alloc] init];
+    [byteSet addBytesFromString:@"\r\n" encoding:NSASCIIStringEncoding];
+    OFByteSearchTable table;
+    OFByteSearchTableInitialize(&table, byteSet);
+
+    [self measureBlock:^{
+        const OFByte *bytes = [data bytes];
+        size_t length = [data length], offset = 0, lineCount = 0;
+        while (offset < length) {
+            offset += OFByteSearchForByteInSet(bytes + offset, length - offset, &table) + 1;
+            lineCount++;
+        }
+        XCTAssertGreaterThan(lineCount, 0UL);
+    }];
+}
+
+- (void)testByteSetSearchScalarPerformance;
+{
+    if (![[self class] shouldRunSlowUnitTests]) {
+        NSLog(@"*** SKIPPING slow test [%@ %@]", [self class], NSStringFromSelector(_cmd));
+        return;
+    }
+
+    NSData *data = _lines(64 * 1024 * 1024);
+    OFByteSet *byteSet = [[OFByteSet alloc] init];
+    [byteSet addBytesFromString:@"\r\n" encoding:NSASCIIStringEncoding];
+    OFByteSearchTable table;
+    OFByteSearchTableInitialize(&table, byteSet);
+
+    [self measureBlock:^{
+        const OFByte *bytes = [data bytes];
+        size_t length = [data length], offset = 0, lineCount = 0;
+        while (offset < length) {
+            offset += OFByteSearchForByteInSetScalar(bytes + offset, length - offset, &table) + 1;
+            lineCount++;
+        }
+        XCTAssertGreaterThan(lineCount, 0UL);
+    }];
+}
+
+- (void)testBoundarySearchPerformance;
+{
+    if (![[self class] shouldRunSlowUnitTests]) {
+        NSLog(@"*** SKIPPING slow test [%@ %@]", [self class], NSStringFromSelector(_cmd));
+        return;
+    }
+
+    NSData *data = _lines(64 * 1024 * 1024);
+    static const char boundary[] = "\n--OmniBoundary-0123456789abcdef";
+
+    [self measureBlock:^{
+        XCTAssertEqual(OFByteSearchForBytes([data bytes], [data length], boundary, strlen(boundary)), [data length]);
+    }];
+}
+
+- (void)testBoundarySearchScalarPerformance;
+{
+    if (![[self class] shouldRunSlowUnitTests]) {
+        NSLog(@"*** SKIPPING slow test [%@ %@]", [self class], NSStringFromSelector(_cmd));
+        return;
+    }
+
+    NSData *data = _lines(64 * 1024 * 1024);
+    static const char boundary[] = "\n--OmniBoundary-0123456789abcdef";
+
+    [self measureBlock:^{
+        XCTAssertEqual(OFByteSearchForBytesScalar([data bytes], [data length], boundary, strlen(boundary)), [data length]);
+    }];
+}
+
+@end
@@ -0,0 +1,196 @@
+// Copyright 2026 Omni Development, Inc. All rights reserved.
+//
+// This software may only be used and reproduced according to the
+// terms in the file OmniSourceLicense.html, which should be
+// distributed with this project and can also be found at
+// <http://www.omnigroup.com/developer/sourcecode/sourcelicense/>.
+
+#import "OFTestCase.h"
+
+#import <OmniFoundation/OFRandom.h>
+#import <os/lock.h>
+
+RCS_ID("$Id$");
+
+@interface OFRandomTests : OFTestCase
+@end
+
+@implementation OFRandomTests
+
+static OFRandomState *_createState(void)
+{
+    static const uint32_t seed[] = {0x4f6d6e69, 0x47726f75, 0x70000000};
+    return OFRandomStateCreateWithSeed32(seed, sizeof(seed) / sizeof(*seed));
+}
+
+- (void)testFillMatchesSequentialValues;
+{
+    static const size_t maximumCount = 5000;
+    uint64_t *buffer = malloc((maximumCount + 2) * sizeof(uint64_t));
+    OFRandomState *sizes = _createState();
+
+    for (NSUInteger iteration = 0; iteration < 500; iteration++) {
+        OFRandomState *bulk = _createState(), *sequential = _createState();
+
+        // Start partway into a block, fill aligned or not, and use lengths on both sides of a whole block.
+        unsigned int skipCount = OFRandomNextStateN(sizes, 1000);
+        for (unsigned int skipIndex = 0; skipIndex < skipCount; skipIndex++) {
+            OFRandomNextState64(bulk);
+            OFRandomNextState64(sequential);
+        }
+        uint64_t *values = buffer + OFRandomNextStateN(sizes, 2);
+        size_t count = OFRandomNextStateN(sizes, 2) ? OFRandomNextStateN(sizes, 700) : OFRandomNextStateN(sizes, maximumCount + 1);
+
+        OFRandomStateFill64(bulk, values, count);
+        for (size_t valueIndex = 0; valueIndex < count; valueIndex++) {
+            if (values[valueIndex] != OFRandomNextState64(sequential)) {
+                XCTFail(@"Value %zu of %zu differs (skipped %u, offset %td)", valueIndex, count, skipCount, values - buffer);
+                break;
+            }
+        }
+
+        // And both continue the same sequence afterwards.
+        for (NSUInteger valueIndex = 0; valueIndex < 1000; valueIndex++)
+            XCTAssertEqual(OFRandomNextState64(bulk), OFRandomNextState64(sequential));
+
+        OFRandomStateDestroy(bulk);
+        OFRandomStateDestroy(sequential);
+    }
+
+    OFRandomStateDestroy(sizes);
+    free(buffer);
+}
+
+- (void)testFillDouble;
+{
+    static const size_t count = 3000;
+    double *values = malloc(count * sizeof(double));
+    OFRandomState *bulk = _createState(), *sequential = _createState();
+
+    OFRandomStateFillDouble(bulk, values, count);
+    double sum = 0;
+    for (size_t valueIndex = 0; valueIndex < count; valueIndex++) {
+        XCTAssertEqual(values[valueIndex], OFRandomNextStateDouble(sequential));
+        XCTAssertTrue(values[valueIndex] >= 0.0 && values[valueIndex] < 1.0);
+        sum += values[valueIndex];
+    }
+    XCTAssertEqualWithAccuracy(sum / count, 0.5, 0.05);
+
+    OFRandomStateDestroy(bulk);
+    OFRandomStateDestroy(sequential);
+    free(values);
+}
+
+- (void)testThreadsHaveTheirOwnStreams;
+{
+    static const NSUInteger threadCount = 8, valueCount = 10000;
+    uint64_t *values = malloc(threadCount * valueCount * sizeof(uint64_t));
+
+    dispatch_apply(threadCount, dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^(size_t thread){
+        uint64_t *threadValues = values + thread * valueCount;
+        for (NSUInteger valueIndex = 0; valueIndex < valueCount / 2; valueIndex++)
+            threadValues[valueIndex] = OFRandomNext64();
+        OFRandomFill64(threadValues + valueCount / 2, valueCount / 2);
+    });
+
+    // With 64-bit values, any repeat means two threads (or one thread and itself) are sharing a stream.
+    NSMutableSet *seen = [NSMutableSet set];
+    for (NSUInteger valueIndex = 0; valueIndex < threadCount * valueCount; valueIndex++)
+        [seen addObject:@(values[valueIndex])];
+    XCTAssertEqual([seen count], threadCount * valueCount);
+
+    free(values);
+}
+
+- (void)testCreateData;
+{
+    for (NSUInteger length = 0; length < 5100; length += 17) {
+        NSData *data = OFRandomCreateDataOfLength(length);
+        XCTAssertEqual([data length], length);
+    }
+}
+
+#pragma mark - Benchmarks
+
+static const NSUInteger ContendedValueCount = 16000000;
+
+// What every caller used to pay: one shared state, serialized.
+- (void)_measureSharedStateWithThreadCount:(NSUInteger)threadCount;
+{
+    OFRandomState *state = OFRandomStateCreate();
+    __block os_unfair_lock lock = OS_UNFAIR_LOCK_INIT;
+
+    [self measureBlock:^{
+        dispatch_apply(threadCount, dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^(size_t thread){
+            uint64_t total = 0;
+            for (NSUInteger valueIndex = 0; valueIndex < ContendedValueCount / threadCount; valueIndex++) {
+                os_unfair_lock_lock(&lock);
+                total += OFRandomNextState64(state);
+                os_unfair_lock_unlock(&lock);
+            }
+            XCTAssertNotEqual(total, 0ULL);
+        });
+    }];
+
+    OFRandomStateDestroy(state);
+}
+
+- (void)_measurePerThreadStateWithThreadCount:(NSUInteger)threadCount;
+{
+    [self measureBlock:^{
+        dispatch_apply(threadCount, dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^(size_t thread){
+            uint64_t total = 0;
+            for (NSUInteger valueIndex = 0; valueIndex < ContendedValueCount / threadCount; valueIndex++)
+                total += OFRandomNext64();
+            XCTAssertNotEqual(total, 0ULL);
+        });
+    }];
+}
+
+- (void)_measureBulkFillWithThreadCount:(NSUInteger)threadCount;
+{
+    [self measureBlock:^{
+        dispatch_apply(threadCount, dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^(size_t thread){
+            uint64_t *values = malloc(4096 * sizeof(uint64_t));
+            uint64_t total = 0;
+            for (NSUInteger round = 0; round < ContendedValueCount / threadCount / 4096; round++) {
+                OFRandomFill64(values, 4096);
+                total += values[round % 4096];
+            }
+            XCTAssertNotEqual(total, 0ULL);
+            free(values);
+        });
+    }];
+}
+
+- (void)testSharedStateSpeed_1Thread;
+{
+    [self _measureSharedStateWithThreadCount:1];
+}
+
+- (void)testSharedStateSpeed_8Threads;
+{
+    [self _measureSharedStateWithThreadCount:8];
+}
+
+- (void)testPerThreadStateSpeed_1Thread;
+{
+    [self _measurePerThreadStateWithThreadCount:1];
+}
+
+- (void)testPerThreadStateSpeed_8Threads;
+{
+    [self _measurePerThreadStateWithThreadCount:8];
+}
+
+- (void)testBulkFillSpeed_1Thread;
+{
+    [self _measureBulkFillWithThreadCount:1];
+}
+
+- (void)testBulkFillSpeed_8Threads;
+{
+    [self _measureBulkFillWithThreadCount:8];
+}
+
+@end
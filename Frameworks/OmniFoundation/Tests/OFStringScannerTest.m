@@ -9,6 +9,8 @@
 
 #import <OmniFoundation/OFStringScanner.h>
 #import <OmniFoundation/NSScanner-OFExtensions.h>
+#import <OmniFoundation/OFCharacterSet.h>
+#import <OmniFoundation/OFRandom.h>
 #import <OmniBase/OmniBase.h>
 
 RCS_ID("$Id$")
@@ -53,6 +55,114 @@ RCS_ID("$Id$")
     [self scanForPattern:@"fofoo" inText:@"knurd foofoofoo blurfl" expecting: NO : nil];
 }
 
+// Runs of ASCII with some Latin-1, CJK and surrogates mixed in, so that the scanner sees blocks that are all ASCII, all not, and mixed.
+static NSString *_mixedText(OFRandomState *state, NSUInteger length)
+{
+    static const unichar nonASCII[] = {0x00a0, 0x00e9, 0x00ff, 0x0100, 0x20ac, 0x3000, 0x4e2d, 0xd83d, 0xde00, 0xfeff, 0xffff};
+    unichar *characters = malloc(sizeof(*characters) * MAX(length, 1UL));
+    for (NSUInteger characterIndex = 0; characterIndex < length; characterIndex++) {
+        if (OFRandomNextStateN(state, 8) == 0)
+            characters[characterIndex] = nonASCII[OFRandomNextStateN(state, sizeof(nonASCII) / sizeof(*nonASCII))];
+        else
+            characters[characterIndex] = (unichar)(' ' + OFRandomNextStateN(state, 95));
+    }
+    return [[NSString alloc] initWithCharactersNoCopy:characters length:length freeWhenDone:YES];
+}
+
+- (void)testCharacterSetScanningMatchesBitmap
+{
+    OFRandomState *state = OFRandomStateCreate();
+
+    for (NSString *setString in @[@"<&", @" \t\r\n", @"\"'>", @"\u00e9\u20ac", @"<\u4e2d\ufeff", @"abcdefghijklmnopqrstuvwxyz"]) {
+        OFCharacterSet *delimiterSet = [[OFCharacterSet alloc] initWithString:setString];
+        OFCharacterSet *tokenSet = [[OFCharacterSet alloc] initWithOFCharacterSet:delimiterSet];
+        [tokenSet invert];
+
+        for (NSUInteger iteration = 0; iteration < 200; iteration++) {
+            NSString *text = _mixedText(state, OFRandomNextStateN(state, 200));
+            NSUInteger length = [text length], location = 0;
+            OFStringScanner *scanner = [[OFStringScanner alloc] initWithString:text];
+
+            while (location < length) {
+                NSUInteger tokenEnd = location;
+                while (tokenEnd < length && !OFCharacterSetHasMember(delimiterSet, [text characterAtIndex:tokenEnd]))
+                    tokenEnd++;
+                NSString *expectedToken = tokenEnd > location ? [text substringWithRange:NSMakeRange(location, tokenEnd - location)] : nil;
+                XCTAssertEqualObjects([scanner readFullTokenWithDelimiterOFCharacterSet:delimiterSet], expectedToken);
+                XCTAssertEqual([scanner scanLocation], tokenEnd);
+                if (tokenEnd == length)
+                    break;
+
+                NSUInteger delimitersEnd = tokenEnd;
+                while (delimitersEnd < length && OFCharacterSetHasMember(delimiterSet, [text characterAtIndex:delimitersEnd]))
+                    delimitersEnd++;
+                BOOL found = (iteration & 1) ? [scanner scanUpToCharacterNotInOFCharacterSet:delimiterSet] : [scanner scanUpToCharacterInOFCharacterSet:tokenSet];
+                XCTAssertEqual(found, delimitersEnd < length);
+                XCTAssertEqual([scanner scanLocation], delimitersEnd);
+                location = delimitersEnd;
+            }
+        }
+    }
+
+    OFRandomStateDestroy(state);
+}
+
+- (void)testHTMLTokenizingPerformance
+{
+    if (![[self class] shouldRunSlowUnitTests]) {
+        NSLog(@"*** SKIPPING slow test [%@ %@]", [self class], NSStringFromSelector(_cmd));
+        return;
+    }
+
+    // Some real HTML (the SFMT documentation), repeated out to a few megabytes.
+    NSString *corpusPath = [[NSBundle bundleForClass:[self class]] pathForResource:@"_s_f_m_t_8c" ofType:@"html"];
+    NSString *page = [NSString stringWithContentsOfFile:corpusPath encoding:NSUTF8StringEncoding error:NULL];
+    XCTAssertNotNil(page);
+    NSMutableString *corpus = [NSMutableString string];
+    while ([corpus length] < 8 * 1024 * 1024)
+        [corpus appendString:page];
+
+    // Roughly the sets the OWF HTML tokenizer uses.
+    OFCharacterSet *textDelimiterSet = [[OFCharacterSet alloc] initWithString:@"<&"];
+    OFCharacterSet *blankSet = [OFCharacterSet whitespaceOFCharacterSet];
+    OFCharacterSet *attributeEndSet = [[OFCharacterSet alloc] initWithString:@" \t\r\n=>"];
+    OFCharacterSet *doubleQuoteSet = [[OFCharacterSet alloc] initWithString:@"\""];
+    OFCharacterSet *singleQuoteSet = [[OFCharacterSet alloc] initWithString:@"'"];
+    OFCharacterSet *invertedNameSet = [[OFCharacterSet alloc] initWithString:@"abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789-._:!/"];
+    [invertedNameSet invert];
+
+    [self measureBlock:^{
+        OFStringScanner *scanner = [[OFStringScanner alloc] initWithString:corpus];
+        NSUInteger tagCount = 0;
+
+        while (scannerHasData(scanner)) {
+            @autoreleasepool {
+                [scanner readFullTokenWithDelimiterOFCharacterSet:textDelimiterSet];
+                if (scannerReadCharacter(scanner) != '<')
+                    continue; // Entities just run on into the text after them
+                tagCount++;
+
+                [scanner readFullTokenWithDelimiterOFCharacterSet:invertedNameSet forceLowercase:YES];
+                while (scannerScanUpToCharacterNotInOFCharacterSet(scanner, blankSet)) {
+                    unichar character = scannerPeekCharacter(scanner);
+                    if (character == '>') {
+                        scannerSkipPeekedCharacter(scanner);
+                        break;
+                    } else if (character == '"' || character == '\'') {
+                        scannerSkipPeekedCharacter(scanner);
+                        [scanner readFullTokenWithDelimiterOFCharacterSet:character == '"' ? doubleQuoteSet : singleQuoteSet];
+                        scannerSkipPeekedCharacter(scanner);
+                    } else if ([scanner readFullTokenWithDelimiterOFCharacterSet:attributeEndSet forceLowercase:YES] == nil) {
+                        scannerSkipPeekedCharacter(scanner); // '='
+                    }
+                }
+            }
+        }
+
+        XCTAssertGreaterThan(tagCount, 0UL);
+    }];
+}
+
 @end
 
 @implementation OFNSStringScannerTest
@@ -0,0 +1,215 @@
+// Copyright 2026 Omni Development, Inc. All rights reserved.
+//
+// This software may only be used and reproduced according to the
+// terms in the file OmniSourceLicense.html, which should be
+// distributed with this project and can also be found at
+// <http://www.omnigroup.com/developer/sourcecode/sourcelicense/>.
+
+#import "OFTestCase.h"
+
+#import <OmniFoundation/OFRandom.h>
+#import <OmniFoundation/OFScheduledEvent.h>
+#import <OmniFoundation/OFScheduler.h>
+#import <OmniFoundation/OFTimerWheel.h>
+
+RCS_ID("$Id$");
+
+@interface OFTimerWheelTests : OFTestCase
+@end
+
+@implementation OFTimerWheelTests
+
+static NSArray <NSNumber *> *_removeDueValues(OFTimerWheel *wheel, NSTimeInterval now)
+{
+    NSMutableArray <NSNumber *> *values = [NSMutableArray array];
+    OFTimerWheelRemoveDueValues(wheel, now, ^(const void *value){
+        [values addObject:@((uintptr_t)value)];
+    });
+    [values sortUsingSelector:@selector(compare:)];
+    return values;
+}
+
+- (void)testMatchesSortedModel;
+{
+    OFRandomState *state = OFRandomStateCreate();
+    OFTimerWheel *wheel = OFTimerWheelCreate(0.001);
+
+    // value -> deadline for everything we expect to still be in the wheel
+    NSMutableDictionary <NSNumber *, NSNumber *> *model = [NSMutableDictionary dictionary];
+    NSTimeInterval now = [NSDate timeIntervalSinceReferenceDate];
+    uintptr_t nextValue = 1;
+
+    for (NSUInteger step = 0; step < 20000; step++) {
+        unsigned int operation = OFRandomNextStateN(state, 10);
+
+        if (operation < 5) {
+            // Deadlines from slightly in the past out to decades, so that every level and the overflow list get used.
+            double scale = pow(60.0, OFRandomNextStateN(state, 6));
+            NSTimeInterval deadline = now + (OFRandomNextStateDouble(state) - 0.1) * scale;
+            uintptr_t value = nextValue++;
+            OFTimerWheelAddValue(wheel, (const void *)value, deadline);
+            model[@(value)] = @(deadline);
+        } else if (operation < 7) {
+            if ([model count] == 0)
+                continue;
+            NSArray <NSNumber *> *values = [model allKeys];
+            NSNumber *value = values[OFRandomNextStateN(state, (unsigned int)[values count])];
+            XCTAssertTrue(OFTimerWheelRemoveValue(wheel, (const void *)[value unsignedLongValue]));
+            [model removeObjectForKey:value];
+        } else {
+            if (OFRandomNextStateN(state, 5) == 0)
+                now += OFRandomNextStateDouble(state) * pow(60.0, OFRandomNextStateN(state, 7));
+            else
+                now += OFRandomNextStateDouble(state) * 0.01;
+
+            NSMutableArray <NSNumber *> *expected = [NSMutableArray array];
+            [model enumerateKeysAndObjectsUsingBlock:^(NSNumber *value, NSNumber *deadline, BOOL *stop) {
+                if ([deadline doubleValue] <= now)
+                    [expected addObject:value];
+            }];
+            [expected sortUsingSelector:@selector(compare:)];
+            [model removeObjectsForKeys:expected];
+
+            XCTAssertEqualObjects(_removeDueValues(wheel, now), expected);
+        }
+
+        XCTAssertEqual(OFTimerWheelCount(wheel), [model count]);
+
+        const void *firstValue = NULL;
+        NSTimeInterval firstDeadline = 0;
+        if (OFTimerWheelGetFirstValue(wheel, &firstValue, &firstDeadline)) {
+            NSNumber *minimumDeadline = [[model allValues] valueForKeyPath:@"@min.self"];
+            XCTAssertEqual(firstDeadline, [minimumDeadline doubleValue]);
+            XCTAssertEqualObjects(model[@((uintptr_t)firstValue)], minimumDeadline);
+        } else {
+            XCTAssertEqual([model count], 0UL);
+        }
+    }
+
+    OFTimerWheelFree(wheel);
+    OFRandomStateDestroy(state);
+}
+
+- (void)testDuplicateValues;
+{
+    OFTimerWheel *wheel = OFTimerWheelCreate(0.001);
+    NSTimeInterval now = [NSDate timeIntervalSinceReferenceDate];
+
+    OFTimerWheelAddValue(wheel, (const void *)1, now + 1.0);
+    OFTimerWheelAddValue(wheel, (const void *)1, now + 2.0);
+    XCTAssertEqual(OFTimerWheelCount(wheel), 2UL);
+
+    // Removal takes out the earliest added instance.
+    XCTAssertTrue(OFTimerWheelRemoveValue(wheel, (const void *)1));
+    NSTimeInterval firstDeadline = 0;
+    XCTAssertTrue(OFTimerWheelGetFirstValue(wheel, NULL, &firstDeadline));
+    XCTAssertEqual(firstDeadline, now + 2.0);
+
+    XCTAssertEqualObjects(_removeDueValues(wheel, now + 1.5), @[]);
+    XCTAssertEqualObjects(_removeDueValues(wheel, now + 2.0), @[@1]);
+    XCTAssertFalse(OFTimerWheelRemoveValue(wheel, (const void *)1));
+    XCTAssertFalse(OFTimerWheelGetFirstValue(wheel, NULL, NULL));
+
+    OFTimerWheelFree(wheel);
+}
+
+- (void)testFarFutureDeadlines;
+{
+    OFTimerWheel *wheel = OFTimerWheelCreate(0.001);
+    NSTimeInterval now = [NSDate timeIntervalSinceReferenceDate];
+
+    OFTimerWheelAddValue(wheel, (const void *)1, [[NSDate distantFuture] timeIntervalSinceReferenceDate]);
+    OFTimerWheelAddValue(wheel, (const void *)2, now + 100 * 24 * 60 * 60); // Past the end of the wheel proper
+    OFTimerWheelAddValue(wheel, (const void *)3, now + 10);
+
+    XCTAssertEqualObjects(_removeDueValues(wheel, now + 10), @[@3]);
+    XCTAssertEqualObjects(_removeDueValues(wheel, now + 99 * 24 * 60 * 60), @[]);
+    XCTAssertEqualObjects(_removeDueValues(wheel, now + 101 * 24 * 60 * 60), @[@2]);
+    XCTAssertEqual(OFTimerWheelCount(wheel), 1UL);
+
+    OFTimerWheelFree(wheel);
+}
+
+- (void)testSchedulerFirstEventAndAbort;
+{
+    OFScheduler *scheduler = [[OFScheduler dedicatedThreadScheduler] subscheduler];
+    NSDate *now = [NSDate date];
+
+    OFScheduledEvent *laterEvent = [scheduler scheduleSelector:@selector(description) onObject:self afterTime:2000];
+    OFScheduledEvent *soonerEvent = [scheduler scheduleSelector:@selector(description) onObject:self afterTime:1000];
+    XCTAssertEqualObjects([scheduler dateOfFirstEvent], [soonerEvent date]);
+
+    XCTAssertTrue([scheduler abortEvent:soonerEvent]);
+    XCTAssertFalse([scheduler abortEvent:soonerEvent]);
+    XCTAssertEqualObjects([scheduler dateOfFirstEvent], [laterEvent date]);
+    XCTAssertTrue([[scheduler dateOfFirstEvent] timeIntervalSinceDate:now] >= 2000);
+
+    [scheduler abortSchedule];
+    XCTAssertNil([scheduler dateOfFirstEvent]);
+    XCTAssertFalse([scheduler abortEvent:laterEvent]);
+}
+
+- (void)testSchedulingManyTimers;
+{
+    if (![[self class] shouldRunSlowUnitTests]) {
+        NSLog(@"*** SKIPPING slow test [%@ %@]", [self class], NSStringFromSelector(_cmd));
+        return;
+    }
+
+    static const NSUInteger timerCount = 100000;
+
+    OFRandomState *state = OFRandomStateCreate();
+    NSMutableArray <NSDate *> *dates = [NSMutableArray array];
+    for (NSUInteger timerIndex = 0; timerIndex < timerCount; timerIndex++)
+        [dates addObject:[NSDate dateWithTimeIntervalSinceNow:60 + 600 * OFRandomNextStateDouble(state)]];
+    OFRandomStateDestroy(state);
+
+    [self measureBlock:^{
+        OFScheduler *scheduler = [[OFScheduler dedicatedThreadScheduler] subscheduler];
+
+        NSMutableArray <OFScheduledEvent *> *events = [NSMutableArray array];
+        for (NSDate *date in dates)
+            [events addObject:[scheduler scheduleSelector:@selector(description) onObject:self atDate:date]];
+
+        // Cancel half of them, as retry and expiry timers usually are.
+        for (NSUInteger timerIndex = 0; timerIndex < timerCount; timerIndex += 2)
+            XCTAssertTrue([scheduler abortEvent:events[timerIndex]]);
+
+        [scheduler abortSchedule];
+    }];
+}
+
+- (void)testFiringManyTimers;
+{
+    if (![[self class] shouldRunSlowUnitTests]) {
+        NSLog(@"*** SKIPPING slow test [%@ %@]", [self class], NSStringFromSelector(_cmd));
+        return;
+    }
+
+    static const NSUInteger timerCount = 100000;
+
+    [self measureBlock:^{
+        OFRandomState *state = OFRandomStateCreate();
+        OFTimerWheel *wheel = OFTimerWheelCreate(0.001);
+        NSTimeInterval now = [NSDate timeIntervalSinceReferenceDate];
+
+        for (NSUInteger timerIndex = 0; timerIndex < timerCount; timerIndex++)
+            OFTimerWheelAddValue(wheel, (const void *)(timerIndex + 1), now + 600 * OFRandomNextStateDouble(state));
+
+        // Fire in 50ms steps, as a scheduler thread waking for each batch would.
+        __block NSUInteger firedCount = 0;
+        while (OFTimerWheelCount(wheel) > 0) {
+            now += 0.05;
+            OFTimerWheelGetFirstValue(wheel, NULL, NULL);
+            OFTimerWheelRemoveDueValues(wheel, now, ^(const void *value){
+                firedCount++;
+            });
+        }
+        XCTAssertEqual(firedCount, timerCount);
+
+        OFTimerWheelFree(wheel);
+        OFRandomStateDestroy(state);
+    }];
+}
+
+@end
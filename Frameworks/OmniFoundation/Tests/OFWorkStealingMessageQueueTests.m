@@ -0,0 +1,263 @@
+// Copyright 2026 Omni Development, Inc. All rights reserved.
+//
+// This software may only be used and reproduced according to the
+// terms in the file OmniSourceLicense.html, which should be
+// distributed with this project and can also be found at
+// <http://www.omnigroup.com/developer/sourcecode/sourcelicense/>.
+
+#import "OFTestCase.h"
+
+#import <OmniFoundation/OFInvocation.h>
+#import <OmniFoundation/OFMessageQueuePriorityProtocol.h>
+#import <OmniFoundation/OFWorkStealingMessageQueue.h>
+
+#include <stdatomic.h>
+
+RCS_ID("$Id$");
+
+@interface OFWorkStealingMessageQueueTarget : NSObject <OFMessageQueuePriority>
+- initWithName:(NSString *)name schedulingInfo:(OFMessageQueueSchedulingInfo)schedulingInfo log:(NSMutableArray <NSString *> *)log;
+@property(nonatomic,readonly) NSString *name;
+- (void)recordName;
+- (void)runGroupMember;
+- (void)countInvocation;
+@end
+
+static _Atomic(NSInteger) RunningGroupMemberCount;
+static _Atomic(NSInteger) MaximumRunningGroupMemberCount;
+static _Atomic(NSInteger) FinishedInvocationCount;
+
+@implementation OFWorkStealingMessageQueueTarget
+{
+    OFMessageQueueSchedulingInfo _schedulingInfo;
+    NSMutableArray <NSString *> *_log;
+}
+
+- initWithName:(NSString *)name schedulingInfo:(OFMessageQueueSchedulingInfo)schedulingInfo log:(NSMutableArray <NSString *> *)log;
+{
+    if (!(self = [super init]))
+        return nil;
+    _name = [name copy];
+    _schedulingInfo = schedulingInfo;
+    _log = log;
+    return self;
+}
+
+- (OFMessageQueueSchedulingInfo)messageQueueSchedulingInfo;
+{
+    return _schedulingInfo;
+}
+
+- (void)recordName;
+{
+    @synchronized(_log) {
+        [_log addObject:_name];
+    }
+}
+
+- (void)runGroupMember;
+{
+    NSInteger runningCount = atomic_fetch_add(&RunningGroupMemberCount, 1) + 1;
+    NSInteger maximumCount = atomic_load(&MaximumRunningGroupMemberCount);
+    while (runningCount > maximumCount && !atomic_compare_exchange_weak(&MaximumRunningGroupMemberCount, &maximumCount, runningCount))
+        ;
+
+    usleep(2000);
+
+    atomic_fetch_sub(&RunningGroupMemberCount, 1);
+    atomic_fetch_add(&FinishedInvocationCount, 1);
+}
+
+- (void)countInvocation;
+{
+    atomic_fetch_add(&FinishedInvocationCount, 1);
+}
+
+@end
+
+@interface OFWorkStealingMessageQueueTests : OFTestCase
+@end
+
+@implementation OFWorkStealingMessageQueueTests
+
+static OFMessageQueueSchedulingInfo _schedulingInfo(const void *group, unsigned int priority, unsigned int maximumThreads)
+{
+    return (OFMessageQueueSchedulingInfo){.group = group, .priority = priority, .maximumSimultaneousThreadsInGroup = maximumThreads};
+}
+
+static void _drainQueue(OFMessageQueue *queue)
+{
+    OFInvocation *invocation;
+    while ((invocation = [queue copyNextInvocationWithBlock:NO])) {
+        [invocation invoke];
+        [queue didFinishInvocation:invocation];
+    }
+}
+
+static BOOL _waitForFinishedInvocations(NSInteger count)
+{
+    NSDate *timeout = [NSDate dateWithTimeIntervalSinceNow:30];
+    while (atomic_load(&FinishedInvocationCount) < count) {
+        if ([timeout timeIntervalSinceNow] < 0)
+            return NO;
+        usleep(1000);
+    }
+    return YES;
+}
+
+- (void)setUp;
+{
+    [super setUp];
+
+    atomic_store(&RunningGroupMemberCount, 0);
+    atomic_store(&MaximumRunningGroupMemberCount, 0);
+    atomic_store(&FinishedInvocationCount, 0);
+}
+
+- (void)testPriorityOrder;
+{
+    NSMutableArray <NSString *> *log = [NSMutableArray array];
+    OFWorkStealingMessageQueue *queue = [[OFWorkStealingMessageQueue alloc] init];
+
+    NSArray *targets = @[
+        [[OFWorkStealingMessageQueueTarget alloc] initWithName:@"low" schedulingInfo:_schedulingInfo(NULL, OFLowPriority, 255) log:log],
+        [[OFWorkStealingMessageQueueTarget alloc] initWithName:@"high" schedulingInfo:_schedulingInfo(NULL, OFHighPriority, 255) log:log],
+        [[OFWorkStealingMessageQueueTarget alloc] initWithName:@"medium1" schedulingInfo:_schedulingInfo(NULL, OFMediumPriority, 255) log:log],
+        [[OFWorkStealingMessageQueueTarget alloc] initWithName:@"medium2" schedulingInfo:_schedulingInfo(NULL, OFMediumPriority, 255) log:log],
+    ];
+    for (OFWorkStealingMessageQueueTarget *target in targets)
+        [queue queueSelector:@selector(recordName) forObject:target];
+
+    XCTAssertTrue([queue hasInvocations]);
+    _drainQueue(queue);
+    XCTAssertFalse([queue hasInvocations]);
+
+    XCTAssertEqualObjects(log, (@[@"high", @"medium1", @"medium2", @"low"]));
+}
+
+- (void)testWithoutPriorityScheduling;
+{
+    NSMutableArray <NSString *> *log = [NSMutableArray array];
+    OFWorkStealingMessageQueue *queue = [[OFWorkStealingMessageQueue alloc] init];
+    [queue setSchedulesBasedOnPriority:NO];
+
+    [queue queueSelector:@selector(recordName) forObject:[[OFWorkStealingMessageQueueTarget alloc] initWithName:@"low" schedulingInfo:_schedulingInfo(NULL, OFLowPriority, 255) log:log]];
+    [queue queueSelector:@selector(recordName) forObject:[[OFWorkStealingMessageQueueTarget alloc] initWithName:@"high" schedulingInfo:_schedulingInfo(NULL, OFHighPriority, 255) log:log]];
+    _drainQueue(queue);
+
+    XCTAssertEqualObjects(log, (@[@"low", @"high"]));
+}
+
+- (void)testQueueSelectorOnce;
+{
+    NSMutableArray <NSString *> *log = [NSMutableArray array];
+    OFWorkStealingMessageQueue *queue = [[OFWorkStealingMessageQueue alloc] init];
+    OFWorkStealingMessageQueueTarget *target = [[OFWorkStealingMessageQueueTarget alloc] initWithName:@"once" schedulingInfo:_schedulingInfo(NULL, OFMediumPriority, 255) log:log];
+
+    [queue queueSelectorOnce:@selector(recordName) forObject:target];
+    [queue queueSelectorOnce:@selector(recordName) forObject:target];
+    _drainQueue(queue);
+    XCTAssertEqualObjects(log, @[@"once"]);
+
+    // Once it has been taken off the queue, it can be queued again.
+    [queue queueSelectorOnce:@selector(recordName) forObject:target];
+    _drainQueue(queue);
+    XCTAssertEqualObjects(log, (@[@"once", @"once"]));
+
+    // An entry queued with plain -queueSelector: counts as queued too.
+    [queue queueSelector:@selector(recordName) forObject:target];
+    [queue queueSelectorOnce:@selector(recordName) forObject:target];
+    _drainQueue(queue);
+    XCTAssertEqualObjects(log, (@[@"once", @"once", @"once"]));
+}
+
+- (void)testQueueSelectorOnceSeesEarlierPlainEntries;
+{
+    NSMutableArray <NSString *> *log = [NSMutableArray array];
+    OFWorkStealingMessageQueue *queue = [[OFWorkStealingMessageQueue alloc] init];
+    OFWorkStealingMessageQueueTarget *target = [[OFWorkStealingMessageQueueTarget alloc] initWithName:@"plain" schedulingInfo:_schedulingInfo(NULL, OFMediumPriority, 255) log:log];
+
+    // Queued before the queue has seen any -queueSelectorOnce: call.
+    [queue queueSelector:@selector(recordName) forObject:target];
+    [queue queueSelectorOnce:@selector(recordName) forObject:target];
+    _drainQueue(queue);
+    XCTAssertEqualObjects(log, @[@"plain"]);
+}
+
+- (void)testGroupLimit;
+{
+    static const NSInteger invocationCount = 40;
+
+    OFWorkStealingMessageQueue *queue = [[OFWorkStealingMessageQueue alloc] init];
+    [queue startBackgroundProcessors:4];
+
+    static char group;
+    for (NSInteger invocationIndex = 0; invocationIndex < invocationCount; invocationIndex++) {
+        OFWorkStealingMessageQueueTarget *target = [[OFWorkStealingMessageQueueTarget alloc] initWithName:@"member" schedulingInfo:_schedulingInfo(&group, OFMediumPriority, 2) log:nil];
+        [queue queueSelector:@selector(runGroupMember) forObject:target];
+    }
+
+    XCTAssertTrue(_waitForFinishedInvocations(invocationCount));
+    XCTAssertLessThanOrEqual(atomic_load(&MaximumRunningGroupMemberCount), 2);
+    XCTAssertFalse([queue hasInvocations]);
+}
+
+- (void)testManyProducers;
+{
+    static const NSInteger producerCount = 8;
+    static const NSInteger invocationsPerProducer = 5000;
+
+    OFWorkStealingMessageQueue *queue = [[OFWorkStealingMessageQueue alloc] init];
+    [queue startBackgroundProcessors:4];
+
+    OFWorkStealingMessageQueueTarget *target = [[OFWorkStealingMessageQueueTarget alloc] initWithName:@"counter" schedulingInfo:OFMessageQueueSchedulingInfoDefault log:nil];
+    dispatch_apply(producerCount, dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^(size_t producer){
+        for (NSInteger invocationIndex = 0; invocationIndex < invocationsPerProducer; invocationIndex++)
+            [queue queueSelector:@selector(countInvocation) forObject:target];
+    });
+
+    XCTAssertTrue(_waitForFinishedInvocations(producerCount * invocationsPerProducer));
+    XCTAssertEqual(atomic_load(&FinishedInvocationCount), producerCount * invocationsPerProducer);
+}
+
+static void _measureThroughput(OFWorkStealingMessageQueueTests *self, Class queueClass)
+{
+    static const NSInteger producerCount = 8;
+    static const NSInteger invocationsPerProducer = 50000;
+
+    OFMessageQueue *queue = [[queueClass alloc] init];
+    [queue startBackgroundProcessors:8];
+
+    OFWorkStealingMessageQueueTarget *target = [[OFWorkStealingMessageQueueTarget alloc] initWithName:@"counter" schedulingInfo:OFMessageQueueSchedulingInfoDefault log:nil];
+
+    [self measureBlock:^{
+        atomic_store(&FinishedInvocationCount, 0);
+        dispatch_apply(producerCount, dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^(size_t producer){
+            for (NSInteger invocationIndex = 0; invocationIndex < invocationsPerProducer; invocationIndex++)
+                [queue queueSelector:@selector(countInvocation) forObject:target];
+        });
+        XCTAssertTrue(_waitForFinishedInvocations(producerCount * invocationsPerProducer));
+    }];
+}
+
+- (void)testMessageQueueThroughput;
+{
+    if (![[self class] shouldRunSlowUnitTests]) {
+        NSLog(@"*** SKIPPING slow test [%@ %@]", [self class], NSStringFromSelector(_cmd));
+        return;
+    }
+
+    _measureThroughput(self, [OFMessageQueue class]);
+}
+
+- (void)testWorkStealingMessageQueueThroughput;
+{
+    if (![[self class] shouldRunSlowUnitTests]) {
+        NSLog(@"*** SKIPPING slow test [%@ %@]", [self class], NSStringFromSelector(_cmd));
+        return;
+    }
+
+    _measureThroughput(self, [OFWorkStealingMessageQueue class]);
+}
+
+@end
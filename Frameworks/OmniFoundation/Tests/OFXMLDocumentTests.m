@@ -57,6 +57,18 @@ do { \
     XCTAssertEqualObjects(string, expectedString, @"SAVE_AND_COMPARE"); \
 } while (0)
 
+static NSData *_wideDocumentData(NSUInteger childCount)
+{
+    NSMutableString *xmlString = [NSMutableString stringWithString:@"<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<?my-pi foozle?>\n<root-element xmlns=\"urn:root\" xmlns:a=\"urn:a\" version=\"2\">\n"];
+    for (NSUInteger childIndex = 0; childIndex < childCount; childIndex++) {
+        [xmlString appendFormat:@"  <item id=\"i%lu\" a:note=\"x &gt; '&lt;y&gt;'\">text &amp; more<!-- <item> --><child><![CDATA[</root-element>]]></child><empty/></item>\n", childIndex];
+        if ((childIndex % 97) == 0)
+            [xmlString appendString:@"  loose text\n"];
+    }
+    [xmlString appendString:@"</root-element>\n<!-- trailing -->\n"];
+    return [xmlString dataUsingEncoding:NSUTF8StringEncoding];
+}
+
 @interface OFXMLDocumentTests : OFTestCase
 @end
 
@@ -480,4 +492,88 @@ static OFXMLWhitespaceBehavior *_OOXMLWhitespaceBehavior(void)
     XCTAssertTrue(doc == nil);
 }
 
+- (void)testConcurrentLoadMatchesSerialLoad;
+{
+    NSData *inputData = _wideDocumentData(10000);
+    NSError *error = nil;
+
+    OFXMLDocument *serialDocument = [[OFXMLDocument alloc] initWithData:inputData whitespaceBehavior:nil defaultWhitespaceBehavior:OFXMLWhitespaceBehaviorTypePreserve error:&error];
+    OBShouldNotError(serialDocument != nil);
+
+    OFXMLDocument *concurrentDocument = [[OFXMLDocument alloc] initWithData:inputData whitespaceBehavior:nil defaultWhitespaceBehavior:OFXMLWhitespaceBehaviorTypePreserve maximumConcurrency:4 error:&error];
+    OBShouldNotError(concurrentDocument != nil);
+
+    XCTAssertEqual(concurrentDocument.rootElement.childrenCount, serialDocument.rootElement.childrenCount);
+    XCTAssertEqual(concurrentDocument.processingInstructionCount, 1UL);
+    XCTAssertEqualObjects([concurrentDocument.rootElement attributeNamed:@"version"], @"2");
+
+    NSData *serialData = [serialDocument xmlData:&error];
+    OBShouldNotError(serialData != nil);
+    NSData *concurrentData = [concurrentDocument xmlData:&error];
+    OBShouldNotError(concurrentData != nil);
+    XCTAssertEqualObjects(concurrentData, serialData);
+}
+
+- (void)testConcurrentLoadReportsErrors;
+{
+    NSMutableData *inputData = [_wideDocumentData(10000) mutableCopy];
+
+    // Break one of the later items so that the failure happens in a run of siblings parsed off the main thread.
+    NSRange range = [inputData rangeOfData:[@"<item id=\"i9000\"" dataUsingEncoding:NSUTF8StringEncoding] options:0 range:NSMakeRange(0, [inputData length])];
+    XCTAssertNotEqual(range.location, (NSUInteger)NSNotFound);
+    [inputData replaceBytesInRange:NSMakeRange(range.location + 1, 4) withBytes:"itex"];
+
+    NSError *error = nil;
+    OFXMLDocument *document = [[OFXMLDocument alloc] initWithData:inputData whitespaceBehavior:nil defaultWhitespaceBehavior:OFXMLWhitespaceBehaviorTypePreserve maximumConcurrency:4 error:&error];
+    XCTAssertNil(document);
+    XCTAssertNotNil(error);
+}
+
+- (void)testConcurrentLoadFallsBackForUnsplittableInput;
+{
+    NSString *inputString = @"<?xml version=\"1.0\" encoding=\"UTF-16\"?>\n<root-element><a/><b/></root-element>\n";
+    NSData *inputData = [inputString dataUsingEncoding:NSUTF16StringEncoding];
+
+    NSError *error = nil;
+    OFXMLDocument *document = [[OFXMLDocument alloc] initWithData:inputData whitespaceBehavior:IgnoreAllWhitespace() defaultWhitespaceBehavior:OFXMLWhitespaceBehaviorTypeIgnore maximumConcurrency:4 error:&error];
+    OBShouldNotError(document != nil);
+    XCTAssertEqual(document.rootElement.childrenCount, 2UL);
+}
+
+- (void)_measureConcurrentLoadWithMaximumConcurrency:(NSUInteger)maximumConcurrency;
+{
+    if (![[self class] shouldRunSlowUnitTests]) {
+        NSLog(@"*** SKIPPING slow test [%@ %@]", [self class], NSStringFromSelector(_cmd));
+        return;
+    }
+
+    NSData *inputData = _wideDocumentData(200000);
+    [self measureBlock:^{
+        NSError *error = nil;
+        OFXMLDocument *document = [[OFXMLDocument alloc] initWithData:inputData whitespaceBehavior:nil defaultWhitespaceBehavior:OFXMLWhitespaceBehaviorTypeIgnore maximumConcurrency:maximumConcurrency error:&error];
+        OBShouldNotError(document != nil);
+    }];
+}
+
+- (void)testConcurrentLoadSpeed1Thread;
+{
+    [self _measureConcurrentLoadWithMaximumConcurrency:1];
+}
+
+- (void)testConcurrentLoadSpeed2Threads;
+{
+    [self _measureConcurrentLoadWithMaximumConcurrency:2];
+}
+
+- (void)testConcurrentLoadSpeed4Threads;
+{
+    [self _measureConcurrentLoadWithMaximumConcurrency:4];
+}
+
+- (void)testConcurrentLoadSpeed8Threads;
+{
+    [self _measureConcurrentLoadWithMaximumConcurrency:8];
+}
+
 @end
+
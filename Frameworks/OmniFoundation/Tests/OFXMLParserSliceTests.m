@@ -0,0 +1,225 @@
+// Copyright 2026 Omni Development, Inc. All rights reserved.
+//
+// This software may only be used and reproduced according to the
+// terms in the file OmniSourceLicense.html, which should be
+// distributed with this project and can also be found at
+// <http://www.omnigroup.com/developer/sourcecode/sourcelicense/>.
+
+#import "OFTestCase.h"
+
+#import <OmniFoundation/OFErrors.h>
+#import <OmniFoundation/OFXMLParser.h>
+#import <OmniFoundation/OFXMLQName.h>
+#import <OmniFoundation/OFXMLWhitespaceBehavior.h>
+
+RCS_ID("$Id$");
+
+@interface OFXMLParserSliceTarget : NSObject <OFXMLParserTarget>
+@property(nonatomic,readonly) NSMutableArray <NSString *> *events;
+@property(nonatomic) NSUInteger elementCount;
+@property(nonatomic) NSUInteger matchingAttributeCount;
+- (void)stopRecordingEvents;
+@end
+
+@implementation OFXMLParserSliceTarget
+
+- init;
+{
+    if (!(self = [super init]))
+        return nil;
+    _events = [[NSMutableArray alloc] init];
+    return self;
+}
+
+- (void)parser:(OFXMLParser *)parser startElementWithQName:(OFXMLQName *)qname attributeSlices:(const OFXMLParserAttributeSlice *)attributes count:(NSUInteger)attributeCount;
+{
+    _elementCount++;
+
+    if (_events == nil) {
+        // Benchmark mode; only peek at the bytes, as a real target looking for one attribute would.
+        for (NSUInteger attributeIndex = 0; attributeIndex < attributeCount; attributeIndex++) {
+            if (OFXMLParserSliceEqualsCString(attributes[attributeIndex].value, "match"))
+                _matchingAttributeCount++;
+        }
+        return;
+    }
+
+    [_events addObject:[NSString stringWithFormat:@"start %@", qname.name]];
+    for (NSUInteger attributeIndex = 0; attributeIndex < attributeCount; attributeIndex++) {
+        NSString *value = OFXMLParserSliceCopyString(attributes[attributeIndex].value);
+        [_events addObject:[NSString stringWithFormat:@"attr %@={%@}%@", attributes[attributeIndex].qname.name, attributes[attributeIndex].qname.namespace, value]];
+    }
+}
+
+- (void)parser:(OFXMLParser *)parser addTextSlice:(OFXMLParserSlice)text;
+{
+    if (_events == nil)
+        return;
+    [_events addObject:[NSString stringWithFormat:@"text %@", OFXMLParserSliceCopyString(text)]];
+}
+
+- (void)parser:(OFXMLParser *)parser endElementWithQName:(OFXMLQName *)qname;
+{
+    if (_events == nil)
+        return;
+    [_events addObject:[NSString stringWithFormat:@"end %@", qname.name]];
+}
+
+- (void)stopRecordingEvents;
+{
+    _events = nil;
+}
+
+@end
+
+@interface OFXMLParserSliceTests : OFTestCase
+@end
+
+@implementation OFXMLParserSliceTests
+
+// Text may be split across several slices by libxml2 (entities and chunk boundaries do so), so join adjacent text events before comparing.
+static NSArray <NSString *> *_joinedEvents(NSArray <NSString *> *targetEvents)
+{
+    NSMutableArray <NSString *> *events = [NSMutableArray array];
+    for (NSString *event in targetEvents) {
+        NSString *previous = [events lastObject];
+        if ([event hasPrefix:@"text "] && [previous hasPrefix:@"text "])
+            [events replaceObjectAtIndex:[events count] - 1 withObject:[previous stringByAppendingString:[event substringFromIndex:5]]];
+        else
+            [events addObject:event];
+    }
+    return events;
+}
+
+- (void)testSliceCallbacks;
+{
+    NSString *xmlString = @"<root xmlns:a=\"http://a.example.com\" id=\"r\">\n  <a:child a:flag=\"yes\" plain=\"café\">text &amp; more</a:child>\n  <keep>  </keep>\n</root>";
+
+    OFXMLWhitespaceBehavior *whitespaceBehavior = [[OFXMLWhitespaceBehavior alloc] initWithDefaultBehavior:OFXMLWhitespaceBehaviorTypeIgnore];
+    [whitespaceBehavior setBehavior:OFXMLWhitespaceBehaviorTypePreserve forElementName:@"keep"];
+
+    OFXMLParserSliceTarget *target = [[OFXMLParserSliceTarget alloc] init];
+    NSError *error = nil;
+    OFXMLParser *parser = [[OFXMLParser alloc] initWithWhitespaceBehavior:whitespaceBehavior defaultWhitespaceBehavior:OFXMLWhitespaceBehaviorTypeIgnore target:target];
+    OBShouldNotError([parser parseData:[xmlString dataUsingEncoding:NSUTF8StringEncoding] error:&error]);
+
+    NSArray <NSString *> *events = _joinedEvents(target.events);
+    NSArray <NSString *> *expected = @[
+        @"start root",
+        @"attr a={http://www.w3.org/2000/xmlns/}http://a.example.com",
+        @"attr id={}r",
+        @"start child",
+        @"attr flag={http://a.example.com}yes",
+        @"attr plain={}café",
+        @"text text & more",
+        @"end child",
+        @"start keep",
+        @"text   ",
+        @"end keep",
+        @"end root",
+    ];
+    XCTAssertEqualObjects(events, expected);
+}
+
+- (void)testIncrementalParsing;
+{
+    NSMutableString *xmlString = [NSMutableString stringWithString:@"<?xml version=\"1.0\" encoding=\"utf-8\"?>\n<root xmlns:a=\"http://a.example.com\">"];
+    for (NSUInteger elementIndex = 0; elementIndex < 200; elementIndex++)
+        [xmlString appendFormat:@"<a:item n=\"%lu\">café &amp; %lu</a:item>", elementIndex, elementIndex];
+    [xmlString appendString:@"</root>"];
+    NSData *data = [xmlString dataUsingEncoding:NSUTF8StringEncoding];
+
+    NSError *error = nil;
+    OFXMLParserSliceTarget *wholeTarget = [[OFXMLParserSliceTarget alloc] init];
+    OFXMLParser *wholeParser = [[OFXMLParser alloc] initWithWhitespaceBehavior:[OFXMLWhitespaceBehavior ignoreWhitespaceBehavior] defaultWhitespaceBehavior:OFXMLWhitespaceBehaviorTypeIgnore target:wholeTarget];
+    OBShouldNotError([wholeParser parseData:data error:&error]);
+
+    // Small pieces, so that element names, attribute values and multi-byte characters are split across them.
+    OFXMLParserSliceTarget *target = [[OFXMLParserSliceTarget alloc] init];
+    OFXMLParser *parser = [[OFXMLParser alloc] initWithWhitespaceBehavior:[OFXMLWhitespaceBehavior ignoreWhitespaceBehavior] defaultWhitespaceBehavior:OFXMLWhitespaceBehaviorTypeIgnore target:target];
+    NSUInteger offset = 0, pieceLength = 1;
+    while (offset < [data length]) {
+        NSUInteger length = MIN(pieceLength, [data length] - offset);
+        OBShouldNotError([parser parseIncrementalData:[data subdataWithRange:NSMakeRange(offset, length)] error:&error]);
+        offset += length;
+        pieceLength = pieceLength % 7 + 1;
+    }
+    OBShouldNotError([parser finishIncrementalParse:&error]);
+
+    XCTAssertEqualObjects(_joinedEvents(target.events), _joinedEvents(wholeTarget.events));
+    XCTAssertEqualObjects(parser.versionString, @"1.0");
+    XCTAssertEqual(parser.encoding, kCFStringEncodingUTF8);
+
+    // The parser is finished now.
+    error = nil;
+    XCTAssertFalse([parser parseIncrementalData:data error:&error]);
+    XCTAssertTrue([error hasUnderlyingErrorDomain:OFErrorDomain code:OFXMLInvalidateInputError]);
+}
+
+- (void)testIncrementalParsingErrors;
+{
+    NSData *(^dataFromString)(NSString *) = ^(NSString *string){
+        return [string dataUsingEncoding:NSUTF8StringEncoding];
+    };
+    OFXMLParser *(^makeParser)(void) = ^{
+        return [[OFXMLParser alloc] initWithWhitespaceBehavior:[OFXMLWhitespaceBehavior ignoreWhitespaceBehavior] defaultWhitespaceBehavior:OFXMLWhitespaceBehaviorTypeIgnore target:[[OFXMLParserSliceTarget alloc] init]];
+    };
+    NSError *error;
+
+    // Malformed input fails as soon as it is seen, and the parse is over.
+    OFXMLParser *parser = makeParser();
+    OBShouldNotError([parser parseIncrementalData:dataFromString(@"<root><a>") error:&error]);
+    error = nil;
+    XCTAssertFalse([parser parseIncrementalData:dataFromString(@"</b></root>") error:&error]);
+    XCTAssertNotNil(error);
+    XCTAssertFalse([parser finishIncrementalParse:&error]);
+
+    // A truncated document is only noticed at the end.
+    parser = makeParser();
+    OBShouldNotError([parser parseIncrementalData:dataFromString(@"<root><a>text</a>") error:&error]);
+    error = nil;
+    XCTAssertFalse([parser finishIncrementalParse:&error]);
+    XCTAssertNotNil(error);
+
+    // As is no document at all.
+    parser = makeParser();
+    error = nil;
+    XCTAssertFalse([parser finishIncrementalParse:&error]);
+    XCTAssertTrue([error hasUnderlyingErrorDomain:OFErrorDomain code:OFXMLInvalidateInputError]);
+
+    // Abandoning a parse partway through is fine.
+    parser = makeParser();
+    OBShouldNotError([parser parseIncrementalData:dataFromString(@"<root><a>text") error:&error]);
+    parser = nil;
+}
+
+- (void)testSliceEqualsCString;
+{
+    OFXMLParserSlice slice = {.bytes = "matched", .length = 5};
+    XCTAssertTrue(OFXMLParserSliceEqualsCString(slice, "match"));
+    XCTAssertFalse(OFXMLParserSliceEqualsCString(slice, "matc"));
+    XCTAssertFalse(OFXMLParserSliceEqualsCString(slice, "matche"));
+}
+
+- (void)testSliceParsingSpeed;
+{
+    NSMutableString *xmlString = [NSMutableString stringWithString:@"<root>"];
+    for (NSUInteger elementIndex = 0; elementIndex < 100000; elementIndex++)
+        [xmlString appendFormat:@"<item id=\"i%lu\" kind=\"%@\" note=\"some unused attribute text\">body %lu</item>", elementIndex, (elementIndex % 10) ? @"other" : @"match", elementIndex];
+    [xmlString appendString:@"</root>"];
+    NSData *data = [xmlString dataUsingEncoding:NSUTF8StringEncoding];
+
+    [self measureBlock:^{
+        OFXMLParserSliceTarget *target = [[OFXMLParserSliceTarget alloc] init];
+        [target stopRecordingEvents];
+
+        NSError *error = nil;
+        OFXMLParser *parser = [[OFXMLParser alloc] initWithWhitespaceBehavior:[OFXMLWhitespaceBehavior ignoreWhitespaceBehavior] defaultWhitespaceBehavior:OFXMLWhitespaceBehaviorTypeIgnore target:target];
+        OBShouldNotError([parser parseData:data error:&error]);
+
+        XCTAssertEqual(target.elementCount, 100001UL);
+        XCTAssertEqual(target.matchingAttributeCount, 10000UL);
+    }];
+}
+
+@end
@@ -22,10 +22,14 @@
 #import <OmniFoundation/OFNull.h>
 #import <OmniFoundation/NSString-OFSimpleMatching.h>
 
+#import <OmniFoundation/OFXMLInternedStringTable.h>
+
 #import <OmniBase/rcsid.h>
 #import <OmniBase/assertions.h>
 #import <OmniBase/OBUtilities.h>
 
+#include <stdatomic.h>
+
 RCS_ID("$Id$");
 
 #if OB_ARC
@@ -34,6 +38,264 @@ RCS_ID("$Id$");
 
 NS_ASSUME_NONNULL_BEGIN
 
+#pragma mark - Concurrent loading support
+
+// Runs of sibling elements shorter than this aren't worth handing off to another thread.
+static const NSUInteger OFXMLDocumentMinimumSubtreeChunkLength = 64 * 1024;
+
+typedef struct {
+    NSUInteger contentStart; // Just past the '>' of the root element's start tag
+    NSUInteger contentEnd; // The '<' of the root element's end tag
+    NSRange rootNameRange;
+    NSUInteger *childStarts; // The '<' of each of the root element's child elements
+    NSUInteger childCount;
+} OFXMLDocumentRootLayout;
+
+static inline BOOL _isXMLSpace(uint8_t c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static inline BOOL _hasPrefix(const uint8_t *p, const uint8_t *end, const char *prefix)
+{
+    size_t prefixLength = strlen(prefix);
+    return (size_t)(end - p) >= prefixLength && memcmp(p, prefix, prefixLength) == 0;
+}
+
+// Returns the first byte after 'terminator', or NULL if it doesn't appear before 'end'.
+static const uint8_t *_skipPast(const uint8_t *p, const uint8_t *end, const char *terminator)
+{
+    size_t terminatorLength = strlen(terminator);
+    while ((size_t)(end - p) >= terminatorLength) {
+        const uint8_t *candidate = memchr(p, terminator[0], (end - p) - terminatorLength + 1);
+        if (!candidate)
+            return NULL;
+        if (memcmp(candidate, terminator, terminatorLength) == 0)
+            return candidate + terminatorLength;
+        p = candidate + 1;
+    }
+    return NULL;
+}
+
+// 'p' points at the '<' of a tag. Returns its closing '>', skipping quoted attribute values (which may contain '>').
+static const uint8_t *_findTagEnd(const uint8_t *p, const uint8_t *end)
+{
+    uint8_t quote = 0;
+    for (p++; p < end; p++) {
+        uint8_t c = *p;
+        if (quote) {
+            if (c == quote)
+                quote = 0;
+        } else if (c == '"' || c == '\'') {
+            quote = c;
+        } else if (c == '>') {
+            return p;
+        }
+    }
+    return NULL;
+}
+
+// Only encodings where '<', '>' and quotes can't show up inside a multibyte character are safe to scan bytewise.
+static BOOL _xmlDeclarationAllowsSplitting(const uint8_t *p, const uint8_t *declarationEnd)
+{
+    const uint8_t *value = _skipPast(p, declarationEnd, "encoding");
+    if (!value)
+        return YES; // UTF-8 by default
+
+    while (value < declarationEnd && (_isXMLSpace(*value) || *value == '='))
+        value++;
+    if (value >= declarationEnd || (*value != '"' && *value != '\''))
+        return NO;
+
+    uint8_t quote = *value++;
+    const uint8_t *valueEnd = memchr(value, quote, declarationEnd - value);
+    if (!valueEnd)
+        return NO;
+
+    size_t valueLength = valueEnd - value;
+    return (valueLength == 5 && strncasecmp((const char *)value, "UTF-8", valueLength) == 0) || (valueLength == 8 && strncasecmp((const char *)value, "US-ASCII", valueLength) == 0);
+}
+
+// Scans just enough of the document's structure to find where each child of the root element starts. Returns NO for anything this doesn't handle; that input gets parsed serially instead, which also takes care of reporting any errors.
+static BOOL _OFXMLDocumentScanRootLayout(const uint8_t *bytes, NSUInteger length, OFXMLDocumentRootLayout *layout)
+{
+    const uint8_t *p = bytes, *end = bytes + length;
+    memset(layout, 0, sizeof(*layout));
+
+    if (_hasPrefix(p, end, "\xEF\xBB\xBF"))
+        p += 3;
+    else if (_hasPrefix(p, end, "\xFE\xFF") || _hasPrefix(p, end, "\xFF\xFE"))
+        return NO;
+
+    // Prolog
+    while (YES) {
+        while (p < end && _isXMLSpace(*p))
+            p++;
+        if (p >= end || *p != '<')
+            return NO;
+
+        if (_hasPrefix(p, end, "<?")) {
+            const uint8_t *piEnd = _skipPast(p + 2, end, "?>");
+            if (!piEnd)
+                return NO;
+            if (_hasPrefix(p, end, "<?xml") && _isXMLSpace(p[5]) && !_xmlDeclarationAllowsSplitting(p, piEnd))
+                return NO;
+            p = piEnd;
+        } else if (_hasPrefix(p, end, "<!--")) {
+            if (!(p = _skipPast(p + 4, end, "-->")))
+                return NO;
+        } else if (_hasPrefix(p, end, "<!DOCTYPE")) {
+            // An internal subset can declare entities that the parsers for the individual runs of siblings wouldn't know about.
+            const uint8_t *doctypeEnd = _findTagEnd(p, end);
+            if (!doctypeEnd || memchr(p, '[', doctypeEnd - p))
+                return NO;
+            p = doctypeEnd + 1;
+        } else if (_hasPrefix(p, end, "<!")) {
+            return NO;
+        } else {
+            break;
+        }
+    }
+
+    // Root element start tag
+    const uint8_t *nameStart = p + 1, *nameEnd = nameStart;
+    while (nameEnd < end && !_isXMLSpace(*nameEnd) && *nameEnd != '/' && *nameEnd != '>')
+        nameEnd++;
+    const uint8_t *rootTagEnd = _findTagEnd(p, end);
+    if (!rootTagEnd || nameEnd == nameStart || rootTagEnd[-1] == '/')
+        return NO;
+
+    layout->rootNameRange = NSMakeRange(nameStart - bytes, nameEnd - nameStart);
+    layout->contentStart = rootTagEnd + 1 - bytes;
+
+    // Root element content. Text can't contain a bare '<', so we only need to look at markup.
+    NSUInteger childCapacity = 0;
+    NSUInteger depth = 0;
+    p = rootTagEnd + 1;
+    while (p && (p = memchr(p, '<', end - p))) {
+        if (_hasPrefix(p, end, "<!--")) {
+            p = _skipPast(p + 4, end, "-->");
+        } else if (_hasPrefix(p, end, "<![CDATA[")) {
+            p = _skipPast(p + 9, end, "]]>");
+        } else if (_hasPrefix(p, end, "<?")) {
+            p = _skipPast(p + 2, end, "?>");
+        } else if (_hasPrefix(p, end, "<!")) {
+            break;
+        } else if (_hasPrefix(p, end, "</")) {
+            if (depth == 0) {
+                layout->contentEnd = p - bytes;
+                if (layout->childCount > 0)
+                    return YES;
+                break;
+            }
+            depth--;
+
+            const uint8_t *tagEnd = _findTagEnd(p, end);
+            p = tagEnd ? tagEnd + 1 : NULL;
+        } else {
+            if (depth == 0) {
+                if (layout->childCount == childCapacity) {
+                    childCapacity = MAX(childCapacity * 2, 1024u);
+                    layout->childStarts = reallocf(layout->childStarts, childCapacity * sizeof(*layout->childStarts));
+                }
+                layout->childStarts[layout->childCount++] = p - bytes;
+            }
+
+            const uint8_t *tagEnd = _findTagEnd(p, end);
+            if (tagEnd && tagEnd[-1] != '/')
+                depth++;
+            p = tagEnd ? tagEnd + 1 : NULL;
+        }
+    }
+
+    free(layout->childStarts);
+    layout->childStarts = NULL;
+    layout->childCount = 0;
+    return NO;
+}
+
+// Parses one run of the root element's children, wrapped in a copy of the document's prolog and root element so that namespaces, whitespace behavior and entity handling match a serial parse.
+@interface OFXMLDocumentSubtreeParse : NSObject <OFXMLParserTarget, OFXMLElementParserDelegate>
+{
+@public
+    OFXMLDocument *_document; // not retained
+    OFXMLInternedNameTable _nameTable; // not owned
+    OFXMLWhitespaceBehaviorType _defaultWhitespaceBehavior;
+    OFXMLElementParser *_elementParser;
+    NSData *_data;
+
+    NSArray *_children;
+    NSArray *_loadWarnings;
+    NSError *_error;
+}
+- (void)parse;
+@end
+
+@implementation OFXMLDocumentSubtreeParse
+
+- (void)dealloc;
+{
+    [_elementParser release];
+    [_data release];
+    [_children release];
+    [_loadWarnings release];
+    [_error release];
+    [super dealloc];
+}
+
+- (void)parse;
+{
+    @autoreleasepool {
+        OFXMLParser *parser = [[OFXMLParser alloc] initWithWhitespaceBehavior:_document.whitespaceBehavior defaultWhitespaceBehavior:_defaultWhitespaceBehavior target:self];
+
+        _elementParser.delegate = self;
+
+        NSError *error = nil;
+        if ([parser parseData:_data error:&error]) {
+            NSArray *warnings = parser.loadWarnings;
+            if ([warnings count] > 0)
+                _loadWarnings = [warnings copy];
+        } else {
+            _error = [error retain];
+        }
+
+        _elementParser.delegate = nil;
+        [parser release];
+    }
+
+    [_data release];
+    _data = nil;
+}
+
+#pragma mark - OFXMLParserTarget
+
+- (OFXMLInternedNameTable)internedNameTableForParser:(OFXMLParser *)parser;
+{
+    return _nameTable;
+}
+
+- (void)parser:(OFXMLParser *)parser startElementWithQName:(OFXMLQName *)qname multipleAttributeGenerator:(id <OFXMLParserMultipleAttributeGenerator>)multipleAttributeGenerator singleAttributeGenerator:(id <OFXMLParserSingleAttributeGenerator>)singleAttributeGenerator;
+{
+    // As in OFXMLDocument, hand the (wrapper) root element off to the element parser.
+    parser.target = _elementParser;
+    [_elementParser parser:parser startElementWithQName:qname multipleAttributeGenerator:multipleAttributeGenerator singleAttributeGenerator:singleAttributeGenerator];
+}
+
+#pragma mark - OFXMLElementParserDelegate
+
+- (OFXMLParserElementBehavior)elementParser:(OFXMLElementParser *)elementParser behaviorForElementWithQName:(OFXMLQName *)name multipleAttributeGenerator:(id <OFXMLParserMultipleAttributeGenerator>)multipleAttributeGenerator singleAttributeGenerator:(id <OFXMLParserSingleAttributeGenerator>)singleAttributeGenerator;
+{
+    return [_document elementParser:elementParser behaviorForElementWithQName:name multipleAttributeGenerator:multipleAttributeGenerator singleAttributeGenerator:singleAttributeGenerator];
+}
+
+- (void)elementParser:(OFXMLElementParser *)elementParser parser:(OFXMLParser *)parser parsedElement:(OFXMLElement *)element;
+{
+    OBPRECONDITION(_children == nil);
+    _children = [element.children copy];
+}
+
+@end
+
 @implementation OFXMLDocument
 {
     // For the initial XML PI
@@ -195,6 +457,34 @@ NS_ASSUME_NONNULL_BEGIN
     return [self initWithInputStream:inputStream whitespaceBehavior:whitespaceBehavior defaultWhitespaceBehavior:defaultWhitespaceBehavior prepareParser:prepareParser error:outError];
 }
 
+- (nullable instancetype)initWithData:(NSData *)xmlData whitespaceBehavior:(nullable OFXMLWhitespaceBehavior *)whitespaceBehavior defaultWhitespaceBehavior:(OFXMLWhitespaceBehaviorType)defaultWhitespaceBehavior maximumConcurrency:(NSUInteger)maximumConcurrency error:(NSError **)outError;
+{
+    self = [super init];
+
+    if (!xmlData) {
+        OFError(outError, OFXMLDocumentEmptyInputError, @"Cannot create XML document.", @"Nil data passed to create XML document.");
+        [self release];
+        return nil;
+    }
+
+    [self _preInit];
+
+    if (!whitespaceBehavior)
+        whitespaceBehavior = [OFXMLWhitespaceBehavior autoWhitespaceBehavior];
+
+    _whitespaceBehavior = [whitespaceBehavior retain];
+
+    if (maximumConcurrency == 0)
+        maximumConcurrency = [[NSProcessInfo processInfo] activeProcessorCount];
+
+    if (![self _parseDataConcurrently:xmlData defaultWhitespaceBehavior:defaultWhitespaceBehavior maximumConcurrency:maximumConcurrency error:outError]) {
+        [self release];
+        return nil;
+    }
+
+    return [self _commonSetupSuffix:outError];
+}
+
 
 - (nullable instancetype)initWithInputStream:(NSInputStream *)inputStream whitespaceBehavior:(nullable OFXMLWhitespaceBehavior *)whitespaceBehavior error:(NSError **)outError;
 {
@@ -697,6 +987,149 @@ NS_ASSUME_NONNULL_BEGIN
     return YES;    
 }
 
+- (void)_discardParsedContent;
+{
+    // -_parseInputStream:... doesn't clean this up on failure.
+    _elementParser.delegate = nil;
+    [_elementParser release];
+    _elementParser = nil;
+
+    [_rootElement release];
+    _rootElement = nil;
+    [_elementStack removeAllObjects];
+    [_processingInstructions removeAllObjects];
+
+    if (_dtdSystemID) {
+        CFRelease(_dtdSystemID);
+        _dtdSystemID = NULL;
+    }
+    [_dtdPublicID release];
+    _dtdPublicID = nil;
+
+    [_versionString release];
+    _versionString = nil;
+    [_loadWarnings release];
+    _loadWarnings = nil;
+}
+
+- (BOOL)_parseDataSerially:(NSData *)xmlData defaultWhitespaceBehavior:(OFXMLWhitespaceBehaviorType)defaultWhitespaceBehavior error:(NSError **)outError;
+{
+    NSInputStream *inputStream = [[NSInputStream alloc] initWithData:xmlData];
+    BOOL success = [self _parseInputStream:inputStream defaultWhitespaceBehavior:defaultWhitespaceBehavior prepareParser:nil error:outError];
+    [inputStream release];
+    return success;
+}
+
+- (BOOL)_parseDataConcurrently:(NSData *)xmlData defaultWhitespaceBehavior:(OFXMLWhitespaceBehaviorType)defaultWhitespaceBehavior maximumConcurrency:(NSUInteger)maximumConcurrency error:(NSError **)outError;
+{
+    const uint8_t *bytes = [xmlData bytes];
+    NSUInteger length = [xmlData length];
+
+    NSUInteger chunkCount = 0;
+    OFXMLDocumentRootLayout layout;
+    if (maximumConcurrency > 1 && _OFXMLDocumentScanRootLayout(bytes, length, &layout)) {
+        // Several chunks per worker so that one slow run of siblings doesn't leave the other workers idle at the end.
+        chunkCount = MIN(4 * maximumConcurrency, (layout.contentEnd - layout.contentStart) / OFXMLDocumentMinimumSubtreeChunkLength);
+        chunkCount = MIN(chunkCount, layout.childCount);
+        if (chunkCount < 2)
+            free(layout.childStarts);
+    }
+    if (chunkCount < 2)
+        return [self _parseDataSerially:xmlData defaultWhitespaceBehavior:defaultWhitespaceBehavior error:outError];
+
+    // Each run of siblings is wrapped in the prolog and root start tag as written (for the encoding, DOCTYPE and namespace declarations) and a matching end tag.
+    NSMutableData *rootEndTag = [NSMutableData dataWithBytes:"</" length:2];
+    [rootEndTag appendBytes:bytes + layout.rootNameRange.location length:layout.rootNameRange.length];
+    [rootEndTag appendBytes:">" length:1];
+
+    OFXMLInternedNameTable nameTable = OFXMLInternedNameTableCreate(NULL);
+    NSMutableArray <OFXMLDocumentSubtreeParse *> *subtreeParses = [NSMutableArray array];
+    {
+        NSUInteger targetChunkLength = (layout.contentEnd - layout.contentStart) / chunkCount;
+        NSUInteger chunkStart = layout.contentStart;
+
+        for (NSUInteger childIndex = 1; childIndex <= layout.childCount; childIndex++) {
+            NSUInteger chunkEnd = (childIndex < layout.childCount) ? layout.childStarts[childIndex] : layout.contentEnd;
+            if (childIndex < layout.childCount && chunkEnd - chunkStart < targetChunkLength)
+                continue;
+
+            NSMutableData *data = [[NSMutableData alloc] initWithCapacity:layout.contentStart + (chunkEnd - chunkStart) + [rootEndTag length]];
+            [data appendBytes:bytes length:layout.contentStart];
+            [data appendBytes:bytes + chunkStart length:chunkEnd - chunkStart];
+            [data appendData:rootEndTag];
+
+            OFXMLDocumentSubtreeParse *subtreeParse = [[OFXMLDocumentSubtreeParse alloc] init];
+            subtreeParse->_document = self;
+            subtreeParse->_nameTable = nameTable;
+            subtreeParse->_defaultWhitespaceBehavior = defaultWhitespaceBehavior;
+            subtreeParse->_elementParser = [[self makeElementParser] retain]; // Made here since subclasses may not expect this on other threads
+            subtreeParse->_data = data;
+            [subtreeParses addObject:subtreeParse];
+            [subtreeParse release];
+
+            chunkStart = chunkEnd;
+        }
+    }
+
+    NSUInteger subtreeCount = [subtreeParses count];
+    _Atomic(NSUInteger) nextSubtreeIndex = 0;
+    _Atomic(NSUInteger) *nextSubtreeIndexPointer = &nextSubtreeIndex;
+
+    dispatch_apply(MIN(maximumConcurrency, subtreeCount), dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^(size_t worker) {
+        NSUInteger subtreeIndex;
+        while ((subtreeIndex = atomic_fetch_add(nextSubtreeIndexPointer, 1)) < subtreeCount)
+            [subtreeParses[subtreeIndex] parse];
+    });
+
+    BOOL success = YES;
+    for (OFXMLDocumentSubtreeParse *subtreeParse in subtreeParses) {
+        if (subtreeParse->_error) {
+            success = NO;
+            break;
+        }
+    }
+
+    // The prolog, root element and anything following it, without the root's content. This picks up the processing instructions, DOCTYPE, encoding and root element attributes just as a serial parse would.
+    if (success) {
+        NSMutableData *skeleton = [[NSMutableData alloc] initWithBytes:bytes length:layout.contentStart];
+        [skeleton appendBytes:bytes + layout.contentEnd length:length - layout.contentEnd];
+        success = [self _parseDataSerially:skeleton defaultWhitespaceBehavior:defaultWhitespaceBehavior error:NULL];
+        [skeleton release];
+    }
+
+    free(layout.childStarts);
+    OFXMLInternedNameTableFree(nameTable);
+
+    if (!success) {
+        // Reparse serially so that errors (and their line numbers) are reported the same way as in a normal load.
+        [self _discardParsedContent];
+        return [self _parseDataSerially:xmlData defaultWhitespaceBehavior:defaultWhitespaceBehavior error:outError];
+    }
+
+    OBASSERT(_rootElement);
+    OBASSERT([_rootElement childrenCount] == 0);
+
+    NSMutableArray *children = [NSMutableArray array];
+    NSMutableArray *loadWarnings = _loadWarnings ? [NSMutableArray arrayWithArray:_loadWarnings] : nil;
+    for (OFXMLDocumentSubtreeParse *subtreeParse in subtreeParses) {
+        if (subtreeParse->_children)
+            [children addObjectsFromArray:subtreeParse->_children];
+        if (subtreeParse->_loadWarnings) {
+            if (!loadWarnings)
+                loadWarnings = [NSMutableArray array];
+            [loadWarnings addObjectsFromArray:subtreeParse->_loadWarnings];
+        }
+    }
+    [_rootElement setChildren:children];
+
+    if (loadWarnings) {
+        [_loadWarnings release];
+        _loadWarnings = [loadWarnings copy];
+    }
+
+    return YES;
+}
+
 @end
 
 NS_ASSUME_NONNULL_END
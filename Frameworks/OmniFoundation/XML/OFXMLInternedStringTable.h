@@ -13,7 +13,7 @@ extern OFXMLInternedStringTable OFXMLInternedStringTableCreate(NSSet *startingSt
 extern void OFXMLInternedStringTableFree(OFXMLInternedStringTable table);
 extern NSString *OFXMLInternedStringTableGetInternedString(OFXMLInternedStringTable table, const char *str);
 
-// (const char *, const char *) -> OFXMLQName
+// (const char *, const char *) -> OFXMLQName. Lookups are thread-safe, so one table may be shared by several parsers running concurrently.
 @class OFXMLQName;
 typedef struct _OFXMLInternedNameTable *OFXMLInternedNameTable;
 extern OFXMLInternedNameTable OFXMLInternedNameTableCreate(OFXMLInternedNameTable startingQNameTable);
@@ -14,6 +14,7 @@
 
 #import <Foundation/Foundation.h>
 #include <libxml/xmlstring.h>
+#include <os/lock.h>
 
 RCS_ID("$Id$");
 
@@ -98,6 +99,12 @@ NSString *OFXMLInternedStringTableGetInternedString(OFXMLInternedStringTable tab
 
 static const char * const EmptyString = "";
 
+// Unlike the string table, the name table can be shared between parsers running on different threads (for example, when OFXMLDocument parses sibling subtrees concurrently), so lookups take a lock. This is uncontended in the common single parser case.
+struct _OFXMLInternedNameTable {
+    os_unfair_lock lock;
+    CFMutableDictionaryRef dictionary;
+};
+
 typedef struct {
     CFHashCode hash;
     const char *namespace;
@@ -147,11 +154,19 @@ OFXMLInternedNameTable OFXMLInternedNameTableCreate(OFXMLInternedNameTable start
     keyCallbacks.equal = QNameKeyEqual;
     keyCallbacks.hash = QNameKeyHash;
     
-    // Lie about the type.  There is no such struct.
-    OFXMLInternedNameTable table = (struct _OFXMLInternedNameTable *)CFDictionaryCreateMutable(kCFAllocatorDefault, 0, &keyCallbacks, &OFNSObjectDictionaryValueCallbacks);
+    OFXMLInternedNameTable table = malloc(sizeof(*table));
+    table->lock = OS_UNFAIR_LOCK_INIT;
+    table->dictionary = CFDictionaryCreateMutable(kCFAllocatorDefault, 0, &keyCallbacks, &OFNSObjectDictionaryValueCallbacks);
+    
+    NSArray *startingNames = nil;
+    if (startingQNameTable) {
+        os_unfair_lock_lock(&startingQNameTable->lock);
+        startingNames = [(__bridge NSDictionary *)startingQNameTable->dictionary allValues];
+        os_unfair_lock_unlock(&startingQNameTable->lock);
+    }
     
     // We should point at *exactly* these name instances so that users can use == comparison.
-    for (OFXMLQName *qname in [(__bridge NSDictionary *)startingQNameTable allValues]) {
+    for (OFXMLQName *qname in startingNames) {
         QNameKey *key = malloc(sizeof(*key));
         
         // TODO: We are potentially making lots of copies of the same namespace string, one per attribute/element in that namespace.
@@ -162,8 +177,8 @@ OFXMLInternedNameTable OFXMLInternedNameTableCreate(OFXMLInternedNameTable start
         // We upgrade NULL to EmptyString to make this easier.
         key->hash = _stringHash(key->name) ^ _stringHash(key->namespace);
 
-        OBASSERT(CFDictionaryGetValue(TABLE, key) == NULL);
-        CFDictionarySetValue(TABLE, key, (__bridge CFTypeRef)qname);
+        OBASSERT(CFDictionaryGetValue(table->dictionary, key) == NULL);
+        CFDictionarySetValue(table->dictionary, key, (__bridge CFTypeRef)qname);
     }
     
     return table;
@@ -172,8 +187,10 @@ OFXMLInternedNameTable OFXMLInternedNameTableCreate(OFXMLInternedNameTable start
 void OFXMLInternedNameTableFree(OFXMLInternedNameTable table)
 {
     OBPRECONDITION(table);
-    if (TABLE)
-        CFRelease(TABLE);
+    if (table) {
+        CFRelease(table->dictionary);
+        free(table);
+    }
 }
 
 OFXMLQName *OFXMLInternedNameTableGetInternedName(OFXMLInternedNameTable table, const char *namespace, const char *name)
@@ -191,9 +208,13 @@ OFXMLQName *OFXMLInternedNameTableGetInternedName(OFXMLInternedNameTable table,
 
     QNameKey proto = {.hash = hash, .namespace = namespace, .name = name};
     
-    OFXMLQName *interned = (OFXMLQName *)CFDictionaryGetValue(TABLE, &proto);
-    if (interned)
+    os_unfair_lock_lock(&table->lock);
+    
+    OFXMLQName *interned = (OFXMLQName *)CFDictionaryGetValue(table->dictionary, &proto);
+    if (interned) {
+        os_unfair_lock_unlock(&table->lock);
         return interned;
+    }
     
     // TODO: This could lead to a number of repeated copies of namespace names. Enough to care?
     QNameKey *key = malloc(sizeof(*key));
@@ -207,9 +228,11 @@ OFXMLQName *OFXMLInternedNameTableGetInternedName(OFXMLInternedNameTable table,
     [namespaceString release];
     [nameString release];
     
-    CFDictionarySetValue(TABLE, key, (__bridge CFTypeRef)interned);
+    CFDictionarySetValue(table->dictionary, key, (__bridge CFTypeRef)interned);
     [interned release];
     
+    os_unfair_lock_unlock(&table->lock);
+    
     //NSLog(@"XML: Interned qname '%@'", [interned shortDescription]);
     
     return interned;
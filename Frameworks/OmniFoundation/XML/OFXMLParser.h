@@ -31,6 +31,10 @@ NS_ASSUME_NONNULL_BEGIN
 - (BOOL)parseInputStream:(NSInputStream *)inputStream error:(NSError **)outError;
 - (BOOL)parseInputStream:(NSInputStream *)inputStream expectedStreamLength:(NSUInteger)expectedStreamLength error:(NSError **)outError;
 
+// Push-style parsing for documents that arrive in pieces (from a network connection, say). Target callbacks are made synchronously as each piece is parsed, so the whole document never needs to be in memory. Once either method returns NO, the parse is over and the error describes why; otherwise -finishIncrementalParse: must be called after the last piece to check that the document was complete. A parser abandoned partway through is cleaned up when it is deallocated.
+- (BOOL)parseIncrementalData:(NSData *)data error:(NSError **)outError;
+- (BOOL)finishIncrementalParse:(NSError **)outError;
+
 // During the parse, the target can be replaced with a different objects specialized for parsing different portions of the document.
 @property(nonatomic,assign) id <OFXMLParserTarget> target;
 
@@ -42,6 +42,9 @@ typedef struct _OFXMLParserTargetFunctions {
     void (*addCharacterBytes)(id <OFXMLParserTarget> target, SEL _cmd, OFXMLParser *parser, const void *bytes, NSUInteger length);
 
     void (*addComment)(id <OFXMLParserTarget> target, SEL _cmd, OFXMLParser *parser, NSString *string);
+
+    void (*startElementWithAttributeSlices)(id <OFXMLParserTarget> target, SEL _cmd, OFXMLParser *parser, OFXMLQName *elementQName, const OFXMLParserAttributeSlice *attributes, NSUInteger attributeCount);
+    void (*addTextSlice)(id <OFXMLParserTarget> target, SEL _cmd, OFXMLParser *parser, OFXMLParserSlice text);
 } OFXMLParserTargetFunctions;
 
 static void OFXMLParserTargetFunctionsLookup(OFXMLParserTargetFunctions *functions, id <OFXMLParserTarget> target)
@@ -70,6 +73,8 @@ static void OFXMLParserTargetFunctionsLookup(OFXMLParserTargetFunctions *functio
     GET_IMP(addString, @selector(parser:addString:));
     GET_IMP(addCharacterBytes, @selector(parser:addCharacterBytes:length:));
     GET_IMP(addComment, @selector(parser:addComment:));
+    GET_IMP(startElementWithAttributeSlices, @selector(parser:startElementWithQName:attributeSlices:count:));
+    GET_IMP(addTextSlice, @selector(parser:addTextSlice:));
 #undef GET_IMP
 }
 
@@ -107,13 +112,18 @@ static void OFXMLParserTargetFunctionsLookup(OFXMLParserTargetFunctions *functio
     int nb_attributes;
     const xmlChar **attributes;
     const xmlChar *elementURI;
+
+    // Scratch storage for the slice-based callbacks, reused for each element so that we only allocate when an element has more attributes than any before it.
+    OFXMLParserAttributeSlice *attributeSlices;
+    NSUInteger attributeSliceCapacity;
 }
 @end
 
 @interface OFXMLParser ()
 {
 @private
-    OFXMLParserState *_state; // Only set while parsing.
+    OFXMLParserState *_state; // Set from initialization until the end of the parse.
+    int _incrementalParseResult; // The last xmlParseChunk() result, between calls to -parseIncrementalData:error:
 }
 
 @property (nonatomic, strong) NSProgress *progress;
@@ -371,6 +381,60 @@ static void _eachAttributePair(const xmlChar *elementURI,
 
 @end
 
+NSString *OFXMLParserSliceCopyString(OFXMLParserSlice slice)
+{
+    return [[NSString alloc] initWithBytes:slice.bytes length:slice.length encoding:NSUTF8StringEncoding];
+}
+
+// Fills in the state's attribute slice storage from the stashed libxml2 attributes, without creating any objects beyond interned QNames. Returns the number of slices.
+static NSUInteger _fillAttributeSlices(OFXMLParserState *state)
+{
+    NSUInteger attributeCount = (NSUInteger)(state->nb_namespaces + state->nb_attributes);
+    if (attributeCount == 0)
+        return 0;
+    
+    if (attributeCount > state->attributeSliceCapacity) {
+        state->attributeSliceCapacity = MAX(attributeCount, 2 * state->attributeSliceCapacity);
+        state->attributeSlices = reallocf(state->attributeSlices, state->attributeSliceCapacity * sizeof(*state->attributeSlices));
+    }
+    
+    OFXMLParserAttributeSlice *slice = state->attributeSlices;
+    
+    // As with the other attribute paths, namespace declarations are reported first as attributes in the xmlns namespace.
+    for (int namespaceIndex = 0; namespaceIndex < state->nb_namespaces; namespaceIndex++) {
+        const char *prefixCString = (const char *)state->namespaces[2*namespaceIndex + 0];
+        const char *uriCString = (const char *)state->namespaces[2*namespaceIndex + 1];
+        
+        if (!uriCString) {
+            NSLog(@"Bogus namespace; no URI string");
+            continue;
+        }
+        
+        slice->qname = OFXMLInternedNameTableGetInternedName(state->nameTable, OFXMLNamespaceXMLNSCString, prefixCString);
+        slice->value.bytes = uriCString;
+        slice->value.length = strlen(uriCString);
+        slice++;
+    }
+    
+    // Each attribute is given by 5 elements, localname, prefix, URI, value start and value end.
+    for (int attributeIndex = 0; attributeIndex < state->nb_attributes; attributeIndex++) {
+        const char *attributeLocalname = (const char *)state->attributes[5*attributeIndex + 0];
+        const char *attributeNsURI = (const char *)state->attributes[5*attributeIndex + 2];
+        if (attributeNsURI == NULL) {
+            attributeNsURI = (const char *)state->elementURI;
+        }
+        const char *valueStart = (const char *)state->attributes[5*attributeIndex + 3];
+        const char *valueEnd = (const char *)state->attributes[5*attributeIndex + 4];
+        
+        slice->qname = OFXMLInternedNameTableGetInternedName(state->nameTable, attributeNsURI, attributeLocalname);
+        slice->value.bytes = valueStart;
+        slice->value.length = valueEnd - valueStart;
+        slice++;
+    }
+    
+    return slice - state->attributeSlices;
+}
+
 // CFXML only has one callback for this; not sure why there are two.
 static void _internalSubsetSAXFunc(void *ctx, const xmlChar *name, const xmlChar *ExternalID, const xmlChar *SystemID)
 {
@@ -517,7 +581,10 @@ static void _startElementNsSAX2Func(void *ctx, const xmlChar *localname, const x
     // TODO: Maintain our own stack of return values from startElement and pass them to the end call?  Or require all the targets to maintain their own stack if they need it?
     state->elementDepth++;
     
-    if (state->targetImp.startElementWithQName) {
+    if (state->targetImp.startElementWithAttributeSlices) {
+        NSUInteger attributeCount = _fillAttributeSlices(state);
+        state->targetImp.startElementWithAttributeSlices(state->target, @selector(parser:startElementWithQName:attributeSlices:count:), state->parser, elementQName, state->attributeSlices, attributeCount);
+    } else if (state->targetImp.startElementWithQName) {
         id <OFXMLParserMultipleAttributeGenerator> multipleGenerator = nil;
         id <OFXMLParserSingleAttributeGenerator> singleGenerator = nil;
         if (state->nb_namespaces + state->nb_attributes > 1) {
@@ -700,6 +767,17 @@ static OFXMLStringClassification _classifyNSString(NSString *str)
     return OFXMLStringClassificationSomeNonWhitespace;
 }
 
+// For the slice callbacks, which never make an NSString to consult. Only the XML whitespace characters count.
+static BOOL _isXMLWhitespace(const xmlChar *ch, int len)
+{
+    for (int idx = 0; idx < len; idx++) {
+        xmlChar c = ch[idx];
+        if (c != ' ' && c != '\t' && c != '\n' && c != '\r')
+            return NO;
+    }
+    return YES;
+}
+
 static void _charactersSAXFunc(void *ctx, const xmlChar *ch, int len)
 {
     OFXMLParserState *state = (__bridge OFXMLParserState *)ctx;
@@ -718,6 +796,18 @@ static void _charactersSAXFunc(void *ctx, const xmlChar *ch, int len)
     typeof(state->targetImp.addString) addString = state->targetImp.addString;
 
     if (addWhitespace == NULL && addString == NULL) {
+        typeof(state->targetImp.addTextSlice) addTextSlice = state->targetImp.addTextSlice;
+        if (addTextSlice) {
+            if (_isXMLWhitespace(ch, len)) {
+                OFXMLWhitespaceBehaviorType currentBehavior = (OFXMLWhitespaceBehaviorType)[[state->whitespaceBehaviorStack lastObject] unsignedIntegerValue];
+                if (currentBehavior != OFXMLWhitespaceBehaviorTypePreserve)
+                    return;
+            }
+            OFXMLParserSlice text = {.bytes = (const char *)ch, .length = len};
+            addTextSlice(state->target, @selector(parser:addTextSlice:), parser, text);
+            return;
+        }
+        
         typeof(state->targetImp.addCharacterBytes) addCharacterBytes = state->targetImp.addCharacterBytes;
         if (addCharacterBytes) {
             addCharacterBytes(state->target, @selector(parser:addCharacterBytes:length:), parser, ch, len);
@@ -820,10 +910,27 @@ static void _OFXMLParserStateCleanUp(OFXMLParserState *state)
     [state->whitespaceBehaviorStack release];
     [state->loadWarnings release];
     
+    if (state->attributeSlices) {
+        free(state->attributeSlices);
+        state->attributeSlices = NULL;
+        state->attributeSliceCapacity = 0;
+    }
+    
     if (state->ownsNameTable && state->nameTable)
         OFXMLInternedNameTableFree(state->nameTable);
 }
 
+static BOOL _shouldStopParsing(OFXMLParserState *state, int rc)
+{
+    // We should exit early unconditionally for any error code other than XML_ERR_USER_STOP.
+    // XML_ERR_USER_STOP can occur in two situations:
+    //   - the parser encountered a premature EOF (if so, we should read the next chunk from the input stream)
+    //   - we called xmlStopParser() after generating an error
+    //
+    // The way we distinguish these cases is by looking at state->error.
+    return rc != 0 && (rc != XML_ERR_USER_STOP || state->error != nil);
+}
+
 #pragma mark -
 
 @implementation OFXMLParser
@@ -889,6 +996,18 @@ static const NSUInteger OFXMLParserDefaultMaximumParseChunkSize = 1024 * 1024 *
 
 - (void)dealloc;
 {
+    // Never parsed, or an incremental parse was abandoned partway through.
+    if (_state) {
+        if (_state->ctxt) {
+            xmlFreeParserCtxt(_state->ctxt);
+            _state->ctxt = NULL;
+        }
+        [_state->error release];
+        _state->error = nil;
+        _OFXMLParserStateCleanUp(_state);
+        [_state release];
+    }
+
     [_versionString release];
     [_loadWarnings release];
     [_progress release];
@@ -935,6 +1054,134 @@ static const NSUInteger OFXMLParserDefaultMaximumParseChunkSize = 1024 * 1024 *
 
 - (BOOL)parseInputStream:(NSInputStream *)inputStream expectedStreamLength:(NSUInteger)expectedStreamLength error:(NSError **)outError;
 {
+    [inputStream open];
+    if (inputStream.streamStatus == NSStreamStatusError) {
+        OBASSERT(inputStream.streamError != nil);
+        if (outError != NULL) {
+            *outError = [[inputStream.streamError copy] autorelease];
+        }
+        return NO;
+    }
+    
+    [self _beginParse];
+
+    if (expectedStreamLength != NSNotFound) {
+        _progress.totalUnitCount = expectedStreamLength;
+    } else {
+        _progress.totalUnitCount = -1;
+    }
+
+    int rc = 0;
+    
+    NSUInteger maxChunkSize = self.maximumParseChunkSize;
+    OBASSERT(maxChunkSize > 0);
+
+    // Allocating and deallocating our buffer (in particular deallocation) is slow, at least in 10.14.4, spending a bunch of time in free_large -> madvise. Keep around one buffer (of the default size) to reuse.
+    static uint8_t * _Atomic AvailableBuffer = NULL;
+
+    uint8_t *buffer = NULL;
+    if (maxChunkSize == OFXMLParserDefaultMaximumParseChunkSize) {
+        buffer = atomic_exchange(&AvailableBuffer, NULL);
+    }
+    if (buffer == NULL) {
+        buffer = malloc(maxChunkSize);
+    }
+    
+    do @autoreleasepool {
+        NSInteger bytesRead = [inputStream read:buffer maxLength:maxChunkSize];
+        if (bytesRead > 0) {
+            rc = [self _parseBytes:buffer length:bytesRead];
+            if (_shouldStopParsing(_state, rc))
+                break;
+        }
+    } while (inputStream.streamStatus == NSStreamStatusOpen);
+    
+    if (maxChunkSize == OFXMLParserDefaultMaximumParseChunkSize) {
+        // Try putting the buffer back for another parser to use. If there already was a free buffer, dispose of it.
+        uint8_t *oldBuffer = atomic_exchange(&AvailableBuffer, buffer);
+        if (oldBuffer) {
+            free(oldBuffer);
+        }
+    } else {
+        free(buffer);
+    }
+
+    BOOL result;
+    if (inputStream.streamStatus == NSStreamStatusError) {
+        OBASSERT(inputStream.streamError != nil);
+        if (outError != NULL) {
+            *outError = [[inputStream.streamError copy] autorelease];
+        }
+        [self _finishParseWithResultCode:rc error:NULL];
+        [_progress cancel];
+        result = NO;
+    } else {
+        result = [self _finishParseWithResultCode:rc error:outError];
+    }
+    
+    [inputStream close];
+    if (inputStream.streamStatus == NSStreamStatusError) {
+        NSLog(@"Error closing input stream in %s: %@", __func__, inputStream.streamError);
+    }
+    
+    return result;
+}
+
+- (BOOL)parseIncrementalData:(NSData *)data error:(NSError **)outError;
+{
+    if (_state == nil) {
+        // Already finished, successfully or not.
+        OFError(outError, OFXMLInvalidateInputError, nil, nil);
+        return NO;
+    }
+    
+    if (_state->ctxt == NULL) {
+        [self _beginParse];
+        _progress.totalUnitCount = -1;
+        _incrementalParseResult = 0;
+    }
+
+    NSUInteger maxChunkSize = self.maximumParseChunkSize;
+    __block int rc = _incrementalParseResult;
+    
+    [data enumerateByteRangesUsingBlock:^(const void *bytes, NSRange byteRange, BOOL *stop) {
+        // xmlParseChunk() takes an int length, and we promise not to hand it more than maximumParseChunkSize at once in any case.
+        for (NSUInteger offset = 0; offset < byteRange.length; offset += maxChunkSize) {
+            rc = [self _parseBytes:(const uint8_t *)bytes + offset length:MIN(maxChunkSize, byteRange.length - offset)];
+            if (_shouldStopParsing(_state, rc)) {
+                *stop = YES;
+                return;
+            }
+        }
+    }];
+    
+    _incrementalParseResult = rc;
+    if (_shouldStopParsing(_state, rc)) {
+        BOOL success = [self _finishParseWithResultCode:rc error:outError];
+        OBASSERT(success == NO);
+        return success;
+    }
+    return YES;
+}
+
+- (BOOL)finishIncrementalParse:(NSError **)outError;
+{
+    if (_state == nil || _state->ctxt == NULL) {
+        // Already finished (which will have reported any error), or never given any data at all.
+        OFError(outError, OFXMLInvalidateInputError, nil, nil);
+        return NO;
+    }
+    
+    return [self _finishParseWithResultCode:_incrementalParseResult error:outError];
+}
+
+#pragma mark - Private
+
+- (void)_beginParse;
+{
+    OBPRECONDITION(_state != nil, "Parsers can only be used once");
+    OBPRECONDITION(_state->ctxt == NULL);
+
     // TODO: Add support for passing along the source URL
     // We want whitespace reported since we may or may not keep it depending on our whitespaceBehavior input.
 
@@ -978,98 +1225,47 @@ static const NSUInteger OFXMLParserDefaultMaximumParseChunkSize = 1024 * 1024 *
         NSLog(@"Unsupported xml parser options: 0x%08x", options);
     }
     
-    [inputStream open];
-    if (inputStream.streamStatus == NSStreamStatusError) {
-        OBASSERT(inputStream.streamError != nil);
-        if (outError != NULL) {
-            *outError = [[inputStream.streamError copy] autorelease];
-        }
-        return NO;
-    }
-    
     // Encoding isn't set until after the terminate.
+}
 
-    if (expectedStreamLength != NSNotFound) {
-        _progress.totalUnitCount = expectedStreamLength;
-    } else {
-        _progress.totalUnitCount = -1;
-    }
-
-    int rc = 0;
-    
-    NSUInteger maxChunkSize = self.maximumParseChunkSize;
-    OBASSERT(maxChunkSize > 0);
-
-    // Allocating and deallocating our buffer (in particular deallocation) is slow, at least in 10.14.4, spending a bunch of time in free_large -> madvise. Keep around one buffer (of the default size) to reuse.
-    static uint8_t * _Atomic AvailableBuffer = NULL;
+- (int)_parseBytes:(const uint8_t *)bytes length:(NSUInteger)length;
+{
+    OBPRECONDITION(_state->ctxt != NULL);
+    OBPRECONDITION(length <= self.maximumParseChunkSize);
 
-    uint8_t *buffer = NULL;
-    if (maxChunkSize == OFXMLParserDefaultMaximumParseChunkSize) {
-        buffer = atomic_exchange(&AvailableBuffer, NULL);
+    int rc = xmlParseChunk(_state->ctxt, (const char *)bytes, (int)length, FALSE);
+    if (_shouldStopParsing(_state, rc)) {
+        // stop processing immediately
+        [_progress cancel];
+        return rc;
     }
-    if (buffer == NULL) {
-        buffer = malloc(maxChunkSize);
+
+    // If we are in the middle of processing an unparsed element, copy the rest of this chunk into unparsedElementData and advance unparsedBlockStart
+    if (_state->unparsedBlockStart >= (off_t)_state->ctxt->input->consumed) {
+        OBASSERT(_state->unparsedElementData != nil);
+        const xmlChar *unparsedElementPtr = _state->ctxt->input->base + _state->unparsedBlockStart - _state->ctxt->input->consumed;
+        NSUInteger unparsedLength = _state->ctxt->input->end - unparsedElementPtr;
+        [_state->unparsedElementData appendBytes:unparsedElementPtr length:unparsedLength];
+        _state->unparsedBlockStart += unparsedLength;
     }
     
-    do @autoreleasepool {
-        NSInteger bytesRead = [inputStream read:buffer maxLength:maxChunkSize];
-        if (bytesRead > 0) {
-            rc = xmlParseChunk(_state->ctxt, (const char *)buffer, (int)bytesRead, FALSE);
-            if (rc != 0) {
-                // We should exit early unconditionally for any error code other than XML_ERR_USER_STOP.
-                // XML_ERR_USER_STOP can occur in two situations:
-                //   - the parser encountered a premature EOF (if so, we should read the next chunk from the input stream)
-                //   - we called xmlStopParser() after generating an error
-                //
-                // The way we distinguish these cases is by looking at _state->error.
-                
-                if (rc == XML_ERR_USER_STOP && _state->error == nil) {
-                    // fall through
-                } else {
-                    // stop processing immediately
-                    [_progress cancel];
-                    break;
-                }
-            }
+    _progress.completedUnitCount += length;
+    return rc;
+}
 
-            // If we are in the middle of processing an unparsed element, copy the rest of this chunk into unparsedElementData and advance unparsedBlockStart
-            if (_state->unparsedBlockStart >= (off_t)_state->ctxt->input->consumed) {
-                OBASSERT(_state->unparsedElementData != nil);
-                const xmlChar *unparsedElementPtr = _state->ctxt->input->base + _state->unparsedBlockStart - _state->ctxt->input->consumed;
-                NSUInteger length = _state->ctxt->input->end - unparsedElementPtr;
-                [_state->unparsedElementData appendBytes:unparsedElementPtr length:length];
-                _state->unparsedBlockStart += length;
-            }
-            
-            _progress.completedUnitCount += bytesRead;
-        }
-    } while (inputStream.streamStatus == NSStreamStatusOpen);
-    
-    if (rc == 0) {
-        xmlParseChunk(_state->ctxt, NULL, 0, TRUE);
-    }
+// Terminates the parse (if it didn't already fail), records the document properties, and tears down the parser state. Returns NO and fills in outError if the parse failed.
+- (BOOL)_finishParseWithResultCode:(int)rc error:(NSError **)outError;
+{
+    OBPRECONDITION(_state->ctxt != NULL);
 
-    if (maxChunkSize == OFXMLParserDefaultMaximumParseChunkSize) {
-        // Try putting the buffer back for another parser to use. If there already was a free buffer, dispose of it.
-        uint8_t *oldBuffer = atomic_exchange(&AvailableBuffer, buffer);
-        if (oldBuffer) {
-            free(oldBuffer);
-        }
-    } else {
-        free(buffer);
+    if (rc == 0) {
+        rc = xmlParseChunk(_state->ctxt, NULL, 0, TRUE);
     }
 
     OBASSERT((rc == 0) == (_state->error == nil));
     
     BOOL result = YES;
-    if (inputStream.streamStatus == NSStreamStatusError) {
-        OBASSERT(inputStream.streamError != nil);
-        if (outError != NULL) {
-            *outError = [[inputStream.streamError copy] autorelease];
-        }
-        [_progress cancel];
-        result = NO;
-    } else if (rc != 0 || _state->error) {
+    if (rc != 0 || _state->error) {
         if (outError) {
             *outError = [[_state->error retain] autorelease];
         }
@@ -1110,11 +1306,6 @@ static const NSUInteger OFXMLParserDefaultMaximumParseChunkSize = 1024 * 1024 *
         OBASSERT(![NSString isEmptyString:_versionString]);
     }
     
-    [inputStream close];
-    if (inputStream.streamStatus == NSStreamStatusError) {
-        NSLog(@"Error closing input stream in %s: %@", __func__, inputStream.streamError);
-    }
-    
     xmlFreeParserCtxt(_state->ctxt);
     _state->ctxt = NULL;
     
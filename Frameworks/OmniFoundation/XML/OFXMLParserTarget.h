@@ -7,6 +7,7 @@
 
 #import <OmniFoundation/OFXMLInternedStringTable.h>
 #import <OmniBase/OBUtilities.h>
+#import <string.h>
 
 @class OFXMLParser, OFXMLQName;
 @class NSData, NSMutableArray, NSURL;
@@ -33,6 +34,25 @@
 
 @end
 
+// A run of UTF-8 bytes owned by the parser. It is not NUL terminated, and is only valid for the duration of the callback it is passed to.
+typedef struct {
+    const char *bytes;
+    NSUInteger length;
+} OFXMLParserSlice;
+
+// An attribute as reported by the slice-based callbacks. The QName is interned (so it can be compared by pointer with names returned by -[OFXMLParser getQNameWithNamespace:name:]), and the value points into the parser's buffers.
+typedef struct {
+    OFXMLQName *qname;
+    OFXMLParserSlice value;
+} OFXMLParserAttributeSlice;
+
+static inline BOOL OFXMLParserSliceEqualsCString(OFXMLParserSlice slice, const char *string)
+{
+    return strncmp(slice.bytes, string, slice.length) == 0 && string[slice.length] == '\0';
+}
+
+extern NSString *OFXMLParserSliceCopyString(OFXMLParserSlice slice) NS_RETURNS_RETAINED;
+
 typedef enum {
     OFXMLParserElementBehaviorParse, // Descend into this element as normal
     OFXMLParserElementBehaviorUnparsed, // Return this entire element as an unparsed data block
@@ -65,6 +85,12 @@ typedef enum {
 
 - (void)parser:(OFXMLParser *)parser addComment:(NSString *)string;
 
+// Zero-copy alternatives for targets that only look at a few attributes or bytes of text in very large documents. When implemented, these are called instead of their object-based counterparts above, so no strings, arrays or attribute generators are created for each element. The attribute array lives in a scratch area owned by the parser that is reused for the next element, so copy out anything that needs to outlive the callback (OFXMLParserSliceCopyString() does this).
+- (void)parser:(OFXMLParser *)parser startElementWithQName:(OFXMLQName *)qname attributeSlices:(const OFXMLParserAttributeSlice *)attributes count:(NSUInteger)attributeCount;
+
+// Only used if neither -parser:addWhitespace: nor -parser:addString: are implemented. Whitespace-only runs (where whitespace is restricted to the four XML whitespace characters) are only reported when the current element's whitespace behavior is OFXMLWhitespaceBehaviorTypePreserve. A single run of text may be reported in several pieces.
+- (void)parser:(OFXMLParser *)parser addTextSlice:(OFXMLParserSlice)text;
+
 // Deprecated
 - (OFXMLParserElementBehavior)parser:(OFXMLParser *)parser behaviorForElementWithQName:(OFXMLQName *)name attributeQNames:(NSMutableArray *)attributeQNames attributeValues:(NSMutableArray *)attributeValues OB_DEPRECATED_ATTRIBUTE;
 - (void)parser:(OFXMLParser *)parser startElementWithQName:(OFXMLQName *)qname attributeQNames:(NSMutableArray <OFXMLQName *> *)attributeQNames attributeValues:(NSMutableArray <NSString *> *)attributeValues OB_DEPRECATED_ATTRIBUTE;
@@ -35,6 +35,11 @@ extern NSString * const OUUnzipArchiveFilePathErrorKey;
 @property (readonly, nonatomic) NSArray <OUUnzipEntry *> *entries;
 @property (readonly, nonatomic) NSString *archiveDescription;
 
+/// The number of entries that -unzipArchiveToURL:error:, -URLByWritingTemporaryCopyOfTopLevelEntryNamed:error: and the file wrapper methods inflate at once. Defaults to 1, which extracts entries one after another; 0 means one per active processor.
+///
+/// Each concurrent extraction reads through its own handle on the archive, so an archive created from a byte provider must allow reads from several threads at once (NSData does). CRCs are verified for every entry, and the first error stops the extraction.
+@property (nonatomic) NSUInteger maximumConcurrentExtractionCount;
+
 - (nullable OUUnzipEntry *)entryNamed:(NSString *)name;
 - (NSArray <OUUnzipEntry *> *)entriesWithNamePrefix:(NSString * _Nullable)prefix;
 
@@ -11,7 +11,9 @@
 #import <OmniUnzip/OUUnzipEntryInputStream.h>
 #import <OmniUnzip/OUErrors.h>
 #import <OmniBase/NSError-OBExtensions.h>
+#import <OmniBase/NSError-OBUtilities.h>
 #import <OmniBase/system.h> // S_IFMT, etc
+#import <stdatomic.h>
 
 @import OmniFoundation;
 
@@ -79,6 +81,8 @@ static _Nullable id _unzipError(id self, const char *func, int err, NSError **ou
     }
     
     _path = [path copy];
+    _displayName = [displayName copy];
+    _maximumConcurrentExtractionCount = 1;
     
     unzFile unzip;
     if (store) {
@@ -315,6 +319,9 @@ static _Nullable id _unzipError(id self, const char *func, int err, NSError **ou
     }
 
     NSArray <OUUnzipEntry *> *entries = [self entriesWithNamePrefix:prefix];
+    if (_maximumConcurrentExtractionCount != 1)
+        return [self _writeEntriesConcurrently:entries toURL:writeURL error:outError];
+    
     for (OUUnzipEntry *entry in entries) {
         NSString *entryName = [entry name];
         if ([entryName hasPrefix:@"__MACOSX/"])
@@ -397,6 +404,11 @@ static _Nullable id _unzipError(id self, const char *func, int err, NSError **ou
         return nil;
     }
     
+    return [self _wrapperForUnzipEntry:entry data:data];
+}
+
+- (NSFileWrapper *)_wrapperForUnzipEntry:(OUUnzipEntry *)entry data:(NSData *)data;
+{
     NSString *name = [entry name];
     NSString *fileType = [entry fileType];
 #ifdef DEBUG_kc0
@@ -451,13 +463,26 @@ static NSFileWrapper *_rootWrapperForWrapperWithPath(NSMutableDictionary *wrappe
     if (!entries)
         return nil;
 
+    // When extracting concurrently, inflate everything up front; the wrappers themselves still have to be assembled in order.
+    NSArray <NSData *> *entryContents = nil;
+    if (_maximumConcurrentExtractionCount != 1) {
+        entryContents = [self _contentsOfEntriesConcurrently:entries error:outError];
+        if (!entryContents)
+            return nil;
+    }
+
     NSMutableDictionary *wrappers = [NSMutableDictionary dictionary];
     NSMutableDictionary *rootWrappers = [NSMutableDictionary dictionary];
-    for (OUUnzipEntry *entry in entries) {
+    for (NSUInteger entryIndex = 0; entryIndex < entries.count; entryIndex++) {
+        OUUnzipEntry *entry = entries[entryIndex];
         NSString *path = entry.name;
         if ([path hasSuffix:@"/"])
             path = [path stringByRemovingSuffix:@"/"];
-        NSFileWrapper *wrapper = [self _wrapperForUnzipEntry:entry inArchive:self error:outError];
+        NSFileWrapper *wrapper;
+        if (entryContents)
+            wrapper = [self _wrapperForUnzipEntry:entry data:entryContents[entryIndex]];
+        else
+            wrapper = [self _wrapperForUnzipEntry:entry inArchive:self error:outError];
         if (wrapper == nil)
             return nil;
         NSFileWrapper *rootWrapper = _rootWrapperForWrapperWithPath(wrappers, wrapper, path);
@@ -473,6 +498,252 @@ static NSFileWrapper *_rootWrapperForWrapperWithPath(NSMutableDictionary *wrappe
     }
 }
 
+#pragma mark - Concurrent extraction
+
+// Wraps the error from _unzipError() in one naming the entry being read.
+static void _unzipEntryError(OUUnzipArchive *self, OUUnzipEntry *entry, const char *func, int err, NSError **outError)
+{
+    _unzipError(self, func, err, outError);
+    
+    NSString *description = NSLocalizedStringFromTableInBundle(@"Unable to read zip data.", @"OmniUnzip", OMNI_BUNDLE, @"error description");
+    NSString *reason = [NSString stringWithFormat:NSLocalizedStringFromTableInBundle(@"The zip library function %s returned %d when trying to read the data for entry \"%@\" in \"%@\".", @"OmniUnzip", OMNI_BUNDLE, @"error reason"),  func, err, entry.name, self.archiveDescription];
+    OmniUnzipError(outError, OmniUnzipUnableToReadZipFileContents, description, reason);
+}
+#define UNZIP_ENTRY_ERROR(f) _unzipEntryError(self, entry, #f, err, outError)
+
+typedef BOOL (^OUUnzipEntryDataConsumer)(const void *bytes, size_t length, NSError **outError);
+typedef BOOL (^OUUnzipEntryExtractor)(NSUInteger entryIndex, unzFile unzip, NSError **outError);
+
+// Each worker gets its own handle, since minizip keeps the current entry and read position in the handle.
+- (nullable unzFile)_openReadHandle:(NSError **)outError;
+{
+    unzFile unzip;
+    if (_store)
+        unzip = unzOpen2((__bridge void *)_store, &OUReadIOImpl);
+    else
+        unzip = unzOpen([[NSFileManager defaultManager] fileSystemRepresentationWithPath:_path]);
+    
+    if (!unzip) {
+        NSString *description = NSLocalizedStringFromTableInBundle(@"Unable to open zip archive.", @"OmniUnzip", OMNI_BUNDLE, @"error description");
+        NSString *reason = [NSString stringWithFormat:NSLocalizedStringFromTableInBundle(@"The unzip library failed to open %@.", @"OmniUnzip", OMNI_BUNDLE, @"error reason"), _displayName];
+        OmniUnzipError(outError, OmniUnzipUnableToOpenZipFile, description, reason);
+    }
+    
+    return unzip;
+}
+
+// Inflates an entry through the given handle, passing it to the consumer a buffer at a time. minizip checks the CRC when the entry is closed after having been read to its end.
+- (BOOL)_readEntry:(OUUnzipEntry *)entry fromHandle:(unzFile)unzip consumer:(NS_NOESCAPE OUUnzipEntryDataConsumer)consumer error:(NSError **)outError;
+{
+    unz_file_pos position;
+    memset(&position, 0, sizeof(position));
+    position.pos_in_zip_directory = entry.positionInFile;
+    position.num_of_file = entry.fileNumber;
+    
+    int err = unzGoToFilePos(unzip, &position);
+    if (err != UNZ_OK) {
+        UNZIP_ENTRY_ERROR(unzGoToFilePos);
+        return NO;
+    }
+    
+    err = unzOpenCurrentFile(unzip);
+    if (err != UNZ_OK) {
+        UNZIP_ENTRY_ERROR(unzOpenCurrentFile);
+        return NO;
+    }
+    
+    const size_t bufferSize = 256 * 1024;
+    uint8_t *buffer = malloc(bufferSize);
+    size_t totalLength = 0;
+    BOOL ok = YES;
+    
+    while (ok) {
+        int copied = unzReadCurrentFile(unzip, buffer, (unsigned)bufferSize);
+        if (copied == 0)
+            break;
+        if (copied < 0) {
+            err = copied;
+            UNZIP_ENTRY_ERROR(unzReadCurrentFile);
+            ok = NO;
+            break;
+        }
+        totalLength += copied;
+        ok = consumer(buffer, copied, outError);
+    }
+    
+    free(buffer);
+    
+    err = unzCloseCurrentFile(unzip); // UNZ_CRCERROR if the inflated data doesn't match
+    if (ok && err != UNZ_OK) {
+        UNZIP_ENTRY_ERROR(unzCloseCurrentFile);
+        ok = NO;
+    }
+    if (ok && totalLength != entry.uncompressedSize) {
+        err = UNZ_BADZIPFILE;
+        UNZIP_ENTRY_ERROR(unzReadCurrentFile);
+        ok = NO;
+    }
+    
+    return ok;
+}
+
+// Runs the extractor over every entry on up to maximumConcurrentExtractionCount threads, each with its own read handle. Entries are handed out largest first, so that a few huge entries don't end up running alone after everything else is done.
+- (BOOL)_extractEntries:(NSArray <OUUnzipEntry *> *)entries withExtractor:(OUUnzipEntryExtractor)extractor error:(NSError **)outError;
+{
+    NSUInteger entryCount = [entries count];
+    if (entryCount == 0)
+        return YES;
+    
+    NSUInteger workerCount = _maximumConcurrentExtractionCount;
+    if (workerCount == 0)
+        workerCount = [[NSProcessInfo processInfo] activeProcessorCount];
+    workerCount = MIN(workerCount, entryCount);
+    
+    NSMutableArray <NSNumber *> *order = [NSMutableArray arrayWithCapacity:entryCount];
+    for (NSUInteger entryIndex = 0; entryIndex < entryCount; entryIndex++)
+        [order addObject:@(entryIndex)];
+    [order sortWithOptions:NSSortStable usingComparator:^NSComparisonResult(NSNumber *index1, NSNumber *index2) {
+        size_t size1 = entries[[index1 unsignedIntegerValue]].uncompressedSize;
+        size_t size2 = entries[[index2 unsignedIntegerValue]].uncompressedSize;
+        if (size1 > size2)
+            return NSOrderedAscending;
+        if (size1 < size2)
+            return NSOrderedDescending;
+        return NSOrderedSame;
+    }];
+    
+    __block atomic_size_t nextPosition = 0;
+    __block atomic_bool failed = false;
+    __block NSError *firstError = nil;
+    
+    dispatch_apply(workerCount, dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^(size_t workerIndex){
+        @autoreleasepool {
+            NSError *error = nil;
+            __autoreleasing NSError *openError = nil;
+            unzFile unzip = [self _openReadHandle:&openError];
+            BOOL ok = (unzip != NULL);
+            if (!ok)
+                error = openError;
+            
+            while (ok && !atomic_load(&failed)) {
+                size_t position = atomic_fetch_add(&nextPosition, 1);
+                if (position >= entryCount)
+                    break;
+                
+                @autoreleasepool {
+                    __autoreleasing NSError *entryError = nil;
+                    ok = extractor([order[position] unsignedIntegerValue], unzip, &entryError);
+                    if (!ok)
+                        error = entryError;
+                }
+            }
+            
+            if (unzip)
+                unzClose(unzip);
+            
+            if (!ok) {
+                @synchronized(order) {
+                    if (!atomic_exchange(&failed, true))
+                        firstError = error;
+                }
+            }
+        }
+    });
+    
+    if (atomic_load(&failed)) {
+        if (outError)
+            *outError = firstError;
+        return NO;
+    }
+    
+    return YES;
+}
+
+- (BOOL)_writeEntriesConcurrently:(NSArray <OUUnzipEntry *> *)entries toURL:(NSURL *)writeURL error:(NSError **)outError;
+{
+    NSFileManager *defaultManager = [NSFileManager defaultManager];
+    
+    // Create the folders first (in order, as -_writeEntriesWithPrefix:toURL:error: would), so that the files can then be written in any order.
+    NSMutableArray <OUUnzipEntry *> *fileEntries = [NSMutableArray array];
+    for (OUUnzipEntry *entry in entries) {
+        NSString *entryName = [entry name];
+        if ([entryName hasPrefix:@"__MACOSX/"])
+            continue; // Skip over any __MACOSX metadata (resource forks, etc.)
+        
+        if (([entryName hasSuffix:@"/"] && ([entry uncompressedSize] == 0))) {
+            NSURL *entryTempURL = [writeURL URLByAppendingPathComponent:entryName];
+            if (![defaultManager fileExistsAtPath:[entryTempURL path]]) {
+                if (![defaultManager createDirectoryAtURL:entryTempURL withIntermediateDirectories:YES attributes:nil error:outError])
+                    return NO;
+            }
+        } else {
+            [fileEntries addObject:entry];
+        }
+    }
+    
+    return [self _extractEntries:fileEntries withExtractor:^BOOL(NSUInteger entryIndex, unzFile unzip, NSError **outEntryError) {
+        OUUnzipEntry *entry = fileEntries[entryIndex];
+        NSString *entryPath = [[writeURL URLByAppendingPathComponent:[entry name]] path];
+        
+        int fd = open([defaultManager fileSystemRepresentationWithPath:entryPath], O_WRONLY|O_CREAT|O_TRUNC, 0666);
+        if (fd < 0) {
+            OBErrorWithErrno(outEntryError, errno, "open", entryPath, nil);
+            return NO;
+        }
+        
+        BOOL ok = [self _readEntry:entry fromHandle:unzip consumer:^BOOL(const void *buffer, size_t length, NSError **outWriteError) {
+            const uint8_t *bytes = buffer;
+            while (length > 0) {
+                ssize_t written = write(fd, bytes, length);
+                if (written < 0) {
+                    if (errno == EINTR)
+                        continue;
+                    OBErrorWithErrno(outWriteError, errno, "write", entryPath, nil);
+                    return NO;
+                }
+                bytes += written;
+                length -= written;
+            }
+            return YES;
+        } error:outEntryError];
+        
+        if (close(fd) != 0 && ok) {
+            OBErrorWithErrno(outEntryError, errno, "close", entryPath, nil);
+            ok = NO;
+        }
+        
+        return ok;
+    } error:outError];
+}
+
+- (nullable NSArray <NSData *> *)_contentsOfEntriesConcurrently:(NSArray <OUUnzipEntry *> *)entries error:(NSError **)outError;
+{
+    NSMutableArray *contents = [NSMutableArray arrayWithCapacity:[entries count]];
+    for (NSUInteger entryIndex = 0; entryIndex < [entries count]; entryIndex++)
+        [contents addObject:[NSNull null]];
+    
+    BOOL ok = [self _extractEntries:entries withExtractor:^BOOL(NSUInteger entryIndex, unzFile unzip, NSError **outEntryError) {
+        OUUnzipEntry *entry = entries[entryIndex];
+        NSMutableData *data = [NSMutableData dataWithCapacity:entry.uncompressedSize];
+        
+        BOOL entryOK = [self _readEntry:entry fromHandle:unzip consumer:^BOOL(const void *bytes, size_t length, NSError **outAppendError) {
+            [data appendBytes:bytes length:length];
+            return YES;
+        } error:outEntryError];
+        if (!entryOK)
+            return NO;
+        
+        @synchronized(contents) {
+            [contents replaceObjectAtIndex:entryIndex withObject:data];
+        }
+        return YES;
+    } error:outError];
+    
+    return ok ? contents : nil;
+}
+
+#undef UNZIP_ENTRY_ERROR
+
 @end
 
 NS_ASSUME_NONNULL_END
@@ -0,0 +1,42 @@
+// Copyright 2026 Omni Development, Inc. All rights reserved.
+//
+// This software may only be used and reproduced according to the
+// terms in the file OmniSourceLicense.html, which should be
+// distributed with this project and can also be found at
+// <http://www.omnigroup.com/developer/sourcecode/sourcelicense/>.
+
+#import <OmniFoundation/OFObject.h>
+
+@protocol OFByteAcceptor, OFByteProvider;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// Writes a zip archive one member at a time without holding any member's contents in memory.
+///
+/// Unlike OUZipArchive, members can be read from a byte provider or an input stream. Each member is split into 128 KiB chunks that are deflated on several threads at once (each chunk is primed with the 32 KiB of input before it, so the result is nearly as small as a single-threaded deflate), and the sizes and CRC are written in a data descriptor after the compressed data, so the output is never rewound. Members and archives larger than 4 GB are written using the zip64 extensions.
+///
+/// Memory use is bounded by a couple of chunks per thread plus a central directory record per member. A writer is not thread-safe; append members from one thread at a time.
+@interface OUZipStreamWriter : OFObject
+
+- (instancetype)init NS_UNAVAILABLE;
+- (instancetype _Nullable)initWithPath:(NSString *)path error:(NSError **)outError;
+- (instancetype _Nullable)initWithByteAcceptor:(NSObject <OFByteAcceptor> *)byteAcceptor error:(NSError **)outError;
+
+/// The number of chunks deflated at once. Defaults to 0, which means one per active processor. Must be set before the first member is appended.
+@property (nonatomic) NSUInteger maximumConcurrency;
+
+/// A zlib compression level. Defaults to Z_DEFAULT_COMPRESSION. Must be set before the first member is appended.
+@property (nonatomic) int compressionLevel;
+
+- (BOOL)appendEntryNamed:(NSString *)name fileType:(NSString *)fileType contents:(NSData *)contents date:(NSDate * _Nullable)date error:(NSError **)outError;
+- (BOOL)appendEntryNamed:(NSString *)name fileType:(NSString *)fileType contentsOfByteProvider:(NSObject <OFByteProvider> *)byteProvider date:(NSDate * _Nullable)date error:(NSError **)outError;
+
+/// Reads the stream until it reports the end. The stream is opened if necessary, and closed again afterwards if it was opened here. Since the length isn't known up front, the member is always given a zip64 local header.
+- (BOOL)appendEntryNamed:(NSString *)name fileType:(NSString *)fileType contentsOfInputStream:(NSInputStream *)inputStream date:(NSDate * _Nullable)date error:(NSError **)outError;
+
+/// Writes the central directory. No members can be appended afterwards.
+- (BOOL)close:(NSError **)outError;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,788 @@
+// Copyright 2026 Omni Development, Inc. All rights reserved.
+//
+// This software may only be used and reproduced according to the
+// terms in the file OmniSourceLicense.html, which should be
+// distributed with this project and can also be found at
+// <http://www.omnigroup.com/developer/sourcecode/sourcelicense/>.
+
+#import <OmniUnzip/OUZipStreamWriter.h>
+
+#import <OmniUnzip/OUErrors.h>
+#import <OmniBase/NSError-OBUtilities.h>
+#import <OmniBase/system.h> // S_IFDIR, etc.
+#import <OmniFoundation/OFByteProviderProtocol.h>
+#import <libkern/OSByteOrder.h>
+#import <zlib.h>
+
+OB_REQUIRE_ARC
+
+RCS_ID("$Id$");
+
+NS_ASSUME_NONNULL_BEGIN
+
+#define OUZipStreamChunkSize (128 * 1024)
+#define OUZipStreamDictionarySize (32 * 1024) // The deflate window
+#define OUZipStreamOutputBufferSize (1024 * 1024)
+#define OUZipStreamMemoryLevel 8 // zlib's default
+
+// The local header has to say up front whether the sizes in the data descriptor are 64-bit. Members whose length we know to be comfortably under 4 GB (allowing for deflate's expansion of incompressible data) get the plain format, so that readers without zip64 support can still open them.
+#define OUZipStreamZip64Threshold 0xF0000000ULL
+
+#define ZIP_VERSION_DEFAULT 20
+#define ZIP_VERSION_ZIP64 45
+#define ZIP_FLAG_DATA_DESCRIPTOR 0x0008
+#define ZIP_FLAG_UTF8 0x0800
+#define ZIP_METHOD_STORED 0
+
+#define ZIP_LOCAL_HEADER_LENGTH 30
+#define ZIP_CENTRAL_HEADER_LENGTH 46
+#define ZIP64_EXTRA_MAX_LENGTH (4 + 3 * 8)
+#define ZIP_DATA_DESCRIPTOR_MAX_LENGTH (4 + 4 + 2 * 8)
+#define ZIP_END_RECORDS_MAX_LENGTH (56 + 20 + 22)
+
+typedef struct {
+    uint16_t versionNeeded;
+    uint16_t flags;
+    uint16_t method;
+    uint16_t dosTime;
+    uint16_t dosDate;
+    uint32_t crc;
+    uint32_t externalAttributes;
+    uint64_t compressedSize;
+    uint64_t uncompressedSize;
+    uint64_t localHeaderOffset;
+} OUZipStreamEntryInfo;
+
+typedef NSInteger (^OUZipStreamReader)(uint8_t *buffer, NSUInteger maximumLength, NSError **outError); // Returns 0 at the end of the member and -1 on error
+
+static BOOL _zipStreamError(NSError **outError, NSString *reason) __attribute__((cold));
+static NSData * _Nullable _readChunk(OUZipStreamReader reader, NSError **outError);
+static NSData * _Nullable _deflateChunk(z_stream *deflater, NSData *input, NSData * _Nullable dictionary, BOOL last);
+static size_t _writeLocalHeader(uint8_t *buffer, const OUZipStreamEntryInfo *info, const void *name, uint16_t nameLength, BOOL zip64);
+static size_t _writeDataDescriptor(uint8_t *buffer, const OUZipStreamEntryInfo *info, BOOL zip64);
+static size_t _writeCentralDirectoryHeader(uint8_t *buffer, const OUZipStreamEntryInfo *info, const void *name, uint16_t nameLength);
+static size_t _writeEndRecords(uint8_t *buffer, uint64_t entryCount, uint64_t directoryOffset, uint64_t directoryLength);
+
+@interface OUZipDeflateChunk : NSObject
+{
+@public
+    NSData *_input;
+    NSData * _Nullable _dictionary;
+    BOOL _last;
+    NSData * _Nullable _output;
+    uLong _crc;
+    BOOL _busy;
+    dispatch_semaphore_t _finished;
+}
+@end
+
+@implementation OUZipDeflateChunk
+@end
+
+@implementation OUZipStreamWriter
+{
+    NSString *_path;
+    int _fd;
+    NSObject <OFByteAcceptor> *_byteAcceptor;
+
+    NSMutableData *_outputBuffer;
+    uint64_t _flushedLength;
+    NSError *_writeError; // Once the output fails, every later write fails the same way
+
+    NSMutableData *_centralDirectory;
+    uint64_t _entryCount;
+    BOOL _closed;
+
+    // Set up when the first member is appended. Chunk N is deflated on queue N % _workerCount with the matching z_stream, and _chunks is a window of twice that many chunks in flight.
+    NSUInteger _workerCount;
+    NSArray <dispatch_queue_t> *_workQueues;
+    z_stream *_deflaters;
+    NSArray <OUZipDeflateChunk *> *_chunks;
+}
+
+- (instancetype)init NS_UNAVAILABLE;
+{
+    OBRejectUnusedImplementation(self, _cmd);
+    return nil;
+}
+
+- (instancetype _Nullable)_initWithPath:(NSString * _Nullable)path fileDescriptor:(int)fd byteAcceptor:(NSObject <OFByteAcceptor> * _Nullable)byteAcceptor;
+{
+    if (!(self = [super init]))
+        return nil;
+
+    _path = [path copy];
+    _fd = fd;
+    _byteAcceptor = byteAcceptor;
+    _outputBuffer = [[NSMutableData alloc] initWithCapacity:OUZipStreamOutputBufferSize];
+    _centralDirectory = [[NSMutableData alloc] init];
+    _compressionLevel = Z_DEFAULT_COMPRESSION;
+
+    return self;
+}
+
+- (instancetype _Nullable)initWithPath:(NSString *)path error:(NSError **)outError;
+{
+    OBPRECONDITION(![NSString isEmptyString:path]);
+
+    int fd = open([[NSFileManager defaultManager] fileSystemRepresentationWithPath:path], O_WRONLY|O_CREAT|O_TRUNC, 0666);
+    if (fd < 0) {
+        OBErrorWithErrno(outError, errno, "open", path, nil);
+        return nil;
+    }
+
+    return [self _initWithPath:path fileDescriptor:fd byteAcceptor:nil];
+}
+
+- (instancetype _Nullable)initWithByteAcceptor:(NSObject <OFByteAcceptor> *)byteAcceptor error:(NSError **)outError;
+{
+    if (!byteAcceptor)
+        OBRejectInvalidCall(self, _cmd, @"Byte acceptor must not be nil");
+
+    [byteAcceptor setLength:0];
+    return [self _initWithPath:nil fileDescriptor:-1 byteAcceptor:byteAcceptor];
+}
+
+- (void)dealloc;
+{
+    OBPRECONDITION(_closed); // Owner should have closed it, even if there is an error appending.
+
+    if (_fd >= 0)
+        close(_fd);
+
+    if (_deflaters) {
+        for (NSUInteger workerIndex = 0; workerIndex < _workerCount; workerIndex++)
+            deflateEnd(&_deflaters[workerIndex]);
+        free(_deflaters);
+    }
+}
+
+- (void)setMaximumConcurrency:(NSUInteger)maximumConcurrency;
+{
+    OBPRECONDITION(_deflaters == NULL, "Must be set before the first member is appended");
+    _maximumConcurrency = maximumConcurrency;
+}
+
+- (void)setCompressionLevel:(int)compressionLevel;
+{
+    OBPRECONDITION(_deflaters == NULL, "Must be set before the first member is appended");
+    _compressionLevel = compressionLevel;
+}
+
+- (BOOL)appendEntryNamed:(NSString *)name fileType:(NSString *)fileType contents:(NSData *)contents date:(NSDate * _Nullable)date error:(NSError **)outError;
+{
+    return [self appendEntryNamed:name fileType:fileType contentsOfByteProvider:contents date:date error:outError];
+}
+
+- (BOOL)appendEntryNamed:(NSString *)name fileType:(NSString *)fileType contentsOfByteProvider:(NSObject <OFByteProvider> *)byteProvider date:(NSDate * _Nullable)date error:(NSError **)outError;
+{
+    NSUInteger length = [byteProvider length];
+    BOOL reportsErrors = [byteProvider respondsToSelector:@selector(error)];
+
+    __block NSUInteger offset = 0;
+    OUZipStreamReader reader = ^NSInteger(uint8_t *buffer, NSUInteger maximumLength, NSError **outReadError) {
+        NSRange range = NSMakeRange(offset, MIN(maximumLength, length - offset));
+        [byteProvider getBytes:buffer range:range];
+        if (reportsErrors) {
+            NSError *providerError = [byteProvider error];
+            if (providerError) {
+                if (outReadError)
+                    *outReadError = providerError;
+                return -1;
+            }
+        }
+        offset += range.length;
+        return (NSInteger)range.length;
+    };
+
+    return [self _appendEntryNamed:name fileType:fileType date:date expectedLength:length reader:reader error:outError];
+}
+
+- (BOOL)appendEntryNamed:(NSString *)name fileType:(NSString *)fileType contentsOfInputStream:(NSInputStream *)inputStream date:(NSDate * _Nullable)date error:(NSError **)outError;
+{
+    BOOL shouldClose = NO;
+    if ([inputStream streamStatus] == NSStreamStatusNotOpen) {
+        [inputStream open];
+        shouldClose = YES;
+    }
+
+    OUZipStreamReader reader = ^NSInteger(uint8_t *buffer, NSUInteger maximumLength, NSError **outReadError) {
+        NSInteger count = [inputStream read:buffer maxLength:maximumLength];
+        if (count < 0) {
+            NSError *streamError = [inputStream streamError];
+            if (streamError) {
+                if (outReadError)
+                    *outReadError = streamError;
+            } else
+                _zipStreamError(outReadError, [NSString stringWithFormat:@"Unable to read the contents of \"%@\".", name]);
+        }
+        return count;
+    };
+
+    BOOL ok = [self _appendEntryNamed:name fileType:fileType date:date expectedLength:UINT64_MAX reader:reader error:outError];
+
+    if (shouldClose)
+        [inputStream close];
+
+    return ok;
+}
+
+- (BOOL)close:(NSError **)outError;
+{
+    OBPRECONDITION(!_closed);
+
+    if (_closed)
+        return _zipStreamError(outError, @"Zip file already closed.");
+    _closed = YES;
+
+    uint64_t directoryOffset = [self _position];
+    uint64_t directoryLength = [_centralDirectory length];
+    uint8_t endRecords[ZIP_END_RECORDS_MAX_LENGTH];
+    size_t endRecordsLength = _writeEndRecords(endRecords, _entryCount, directoryOffset, directoryLength);
+
+    BOOL ok = [self _writeBytes:[_centralDirectory bytes] length:directoryLength error:outError] && [self _writeBytes:endRecords length:endRecordsLength error:outError] && [self _flushOutput:outError];
+    _centralDirectory = nil;
+
+    if (_fd >= 0) {
+        if (close(_fd) != 0 && ok) {
+            OBErrorWithErrno(outError, errno, "close", _path, nil);
+            ok = NO;
+        }
+        _fd = -1;
+    } else if (ok && [_byteAcceptor respondsToSelector:@selector(flushByteAcceptor)]) {
+        [_byteAcceptor flushByteAcceptor];
+    }
+
+    return ok;
+}
+
+#pragma mark - Private
+
+static BOOL _zipStreamError(NSError **outError, NSString *reason)
+{
+    NSString *description = NSLocalizedStringFromTableInBundle(@"Unable to write zip file.", @"OmniUnzip", OMNI_BUNDLE, @"error description");
+    OmniUnzipError(outError, OmniUnzipUnableToCreateZipFile, description, reason);
+    return NO;
+}
+
+static uint16_t _fileMode(NSString *fileType)
+{
+    if ([fileType isEqualToString:NSFileTypeDirectory])
+        return S_IFDIR | 0755;
+    else if ([fileType isEqualToString:NSFileTypeSymbolicLink])
+        return S_IFLNK | 0644;
+    else
+        return S_IFREG | 0644;
+}
+
+static void _getDOSDateAndTime(NSDate *date, uint16_t *outDate, uint16_t *outTime)
+{
+    NSDateComponents *components = [[NSCalendar currentCalendar] components:NSCalendarUnitYear|NSCalendarUnitMonth|NSCalendarUnitDay|NSCalendarUnitHour|NSCalendarUnitMinute|NSCalendarUnitSecond fromDate:date];
+
+    // DOS dates start in 1980.
+    if ([components year] < 1980) {
+        *outDate = (1 << 5) | 1;
+        *outTime = 0;
+        return;
+    }
+
+    *outDate = (uint16_t)((([components year] - 1980) << 9) | ([components month] << 5) | [components day]);
+    *outTime = (uint16_t)(([components hour] << 11) | ([components minute] << 5) | ([components second] / 2));
+}
+
+- (uint64_t)_position;
+{
+    return _flushedLength + [_outputBuffer length];
+}
+
+- (BOOL)_writeThroughBytes:(const void *)bytes length:(size_t)length error:(NSError **)outError;
+{
+    if (_byteAcceptor) {
+        NSRange range = NSMakeRange((NSUInteger)_flushedLength, length);
+        [_byteAcceptor setLength:NSMaxRange(range)];
+        [_byteAcceptor replaceBytesInRange:range withBytes:bytes];
+
+        if ([_byteAcceptor respondsToSelector:@selector(error)])
+            _writeError = [_byteAcceptor error];
+    } else {
+        const uint8_t *remainingBytes = bytes;
+        size_t remainingLength = length;
+        while (remainingLength > 0) {
+            ssize_t written = write(_fd, remainingBytes, remainingLength);
+            if (written < 0) {
+                if (errno == EINTR)
+                    continue;
+                NSError *error = nil;
+                OBErrorWithErrno(&error, errno, "write", _path, nil);
+                _writeError = error;
+                break;
+            }
+            remainingBytes += written;
+            remainingLength -= written;
+        }
+    }
+
+    if (_writeError) {
+        if (outError)
+            *outError = _writeError;
+        return NO;
+    }
+
+    _flushedLength += length;
+    return YES;
+}
+
+- (BOOL)_flushOutput:(NSError **)outError;
+{
+    if ([_outputBuffer length] == 0)
+        return YES;
+
+    BOOL ok = [self _writeThroughBytes:[_outputBuffer bytes] length:[_outputBuffer length] error:outError];
+    [_outputBuffer setLength:0];
+    return ok;
+}
+
+- (BOOL)_writeBytes:(const void *)bytes length:(size_t)length error:(NSError **)outError;
+{
+    if (_writeError) {
+        if (outError)
+            *outError = _writeError;
+        return NO;
+    }
+
+    if ([_outputBuffer length] + length > OUZipStreamOutputBufferSize) {
+        if (![self _flushOutput:outError])
+            return NO;
+        if (length >= OUZipStreamOutputBufferSize)
+            return [self _writeThroughBytes:bytes length:length error:outError];
+    }
+
+    [_outputBuffer appendBytes:bytes length:length];
+    return YES;
+}
+
+- (BOOL)_startWorkers:(NSError **)outError;
+{
+    if (_deflaters)
+        return YES;
+
+    NSUInteger workerCount = _maximumConcurrency;
+    if (workerCount == 0)
+        workerCount = [[NSProcessInfo processInfo] activeProcessorCount];
+
+    z_stream *deflaters = calloc(workerCount, sizeof(*deflaters));
+    for (NSUInteger workerIndex = 0; workerIndex < workerCount; workerIndex++) {
+        int err = deflateInit2(&deflaters[workerIndex], _compressionLevel, Z_DEFLATED, -MAX_WBITS, OUZipStreamMemoryLevel, Z_DEFAULT_STRATEGY);
+        if (err != Z_OK) {
+            while (workerIndex--)
+                deflateEnd(&deflaters[workerIndex]);
+            free(deflaters);
+            return _zipStreamError(outError, [NSString stringWithFormat:@"deflateInit2 returned %d.", err]);
+        }
+    }
+
+    NSMutableArray <dispatch_queue_t> *workQueues = [NSMutableArray arrayWithCapacity:workerCount];
+    for (NSUInteger workerIndex = 0; workerIndex < workerCount; workerIndex++)
+        [workQueues addObject:dispatch_queue_create("com.omnigroup.OmniUnzip.ZipStreamWriter", DISPATCH_QUEUE_SERIAL)];
+
+    NSMutableArray <OUZipDeflateChunk *> *chunks = [NSMutableArray arrayWithCapacity:2 * workerCount];
+    for (NSUInteger chunkIndex = 0; chunkIndex < 2 * workerCount; chunkIndex++) {
+        OUZipDeflateChunk *chunk = [[OUZipDeflateChunk alloc] init];
+        chunk->_finished = dispatch_semaphore_create(0);
+        [chunks addObject:chunk];
+    }
+
+    _workerCount = workerCount;
+    _deflaters = deflaters;
+    _workQueues = workQueues;
+    _chunks = chunks;
+    return YES;
+}
+
+- (BOOL)_writeDeflatedChunk:(NSData * _Nullable)output crc:(uLong)crc inputLength:(NSUInteger)inputLength info:(OUZipStreamEntryInfo *)info error:(NSError **)outError;
+{
+    if (!output)
+        return _zipStreamError(outError, @"deflate failed.");
+
+    info->crc = (uint32_t)crc32_combine(info->crc, crc, inputLength);
+    info->uncompressedSize += inputLength;
+    info->compressedSize += [output length];
+    return [self _writeBytes:[output bytes] length:[output length] error:outError];
+}
+
+- (BOOL)_finishChunk:(OUZipDeflateChunk *)chunk info:(OUZipStreamEntryInfo * _Nullable)info error:(NSError **)outError;
+{
+    if (!chunk->_busy)
+        return YES;
+
+    dispatch_semaphore_wait(chunk->_finished, DISPATCH_TIME_FOREVER);
+    chunk->_busy = NO;
+
+    BOOL ok = info ? [self _writeDeflatedChunk:chunk->_output crc:chunk->_crc inputLength:[chunk->_input length] info:info error:outError] : YES;
+    chunk->_input = nil;
+    chunk->_dictionary = nil;
+    chunk->_output = nil;
+    return ok;
+}
+
+/* Deflates the member in chunks, pigz-style: each chunk is compressed independently, primed with the tail of the chunk before it, and ends with a sync flush so that the compressed chunks can simply be concatenated. Only the last chunk finishes the deflate stream, so we read one chunk ahead to know which one that is. The chunk CRCs are combined in order as the compressed chunks are written. */
+- (BOOL)_writeDeflatedContentsFromReader:(OUZipStreamReader)reader info:(OUZipStreamEntryInfo *)info error:(NSError **)outError;
+{
+    if (![self _startWorkers:outError])
+        return NO;
+
+    NSUInteger windowSize = [_chunks count];
+    NSError *failure = nil;
+    NSData *previousInput = nil;
+    NSData *input = _readChunk(reader, &failure);
+    NSUInteger chunkIndex = 0;
+
+    while (input) {
+        BOOL keepGoing = YES;
+
+        @autoreleasepool {
+            NSError * __autoreleasing localError = nil;
+
+            // A short read means the reader is done; otherwise peek at the next chunk.
+            NSData *nextInput = nil;
+            BOOL last = ([input length] < OUZipStreamChunkSize);
+            if (!last) {
+                nextInput = _readChunk(reader, &localError);
+                last = (nextInput != nil && [nextInput length] == 0);
+            }
+
+            OUZipDeflateChunk *chunk = _chunks[chunkIndex % windowSize];
+            if (!last && !nextInput) {
+                failure = localError;
+                keepGoing = NO;
+            } else if (![self _finishChunk:chunk info:info error:&localError]) {
+                failure = localError;
+                keepGoing = NO;
+            } else if (chunkIndex == 0 && last) {
+                // Small members aren't worth a trip to another thread.
+                NSData *output = _deflateChunk(&_deflaters[0], input, nil, YES);
+                if (![self _writeDeflatedChunk:output crc:crc32(0, [input bytes], (uInt)[input length]) inputLength:[input length] info:info error:&localError])
+                    failure = localError;
+                keepGoing = NO;
+            } else {
+                chunk->_input = input;
+                chunk->_dictionary = previousInput;
+                chunk->_last = last;
+                chunk->_busy = YES;
+
+                z_stream *deflater = &_deflaters[chunkIndex % _workerCount];
+                dispatch_async(_workQueues[chunkIndex % _workerCount], ^{
+                    chunk->_crc = crc32(0, [chunk->_input bytes], (uInt)[chunk->_input length]);
+                    chunk->_output = _deflateChunk(deflater, chunk->_input, chunk->_dictionary, chunk->_last);
+                    dispatch_semaphore_signal(chunk->_finished);
+                });
+
+                previousInput = input;
+                input = nextInput;
+                chunkIndex++;
+                keepGoing = !last;
+            }
+        }
+
+        if (!keepGoing)
+            break;
+    }
+
+    /* Write whatever is still in flight, oldest first. After a failure, we still wait for the workers, but don't write anything further. */
+    for (NSUInteger drainIndex = 0; drainIndex < windowSize; drainIndex++) {
+        @autoreleasepool {
+            NSError * __autoreleasing localError = nil;
+            if (![self _finishChunk:_chunks[(chunkIndex + drainIndex) % windowSize] info:failure ? NULL : info error:&localError])
+                failure = localError;
+        }
+    }
+
+    if (failure) {
+        if (outError)
+            *outError = failure;
+        return NO;
+    }
+
+    return YES;
+}
+
+- (BOOL)_appendEntryNamed:(NSString *)name fileType:(NSString *)fileType date:(NSDate * _Nullable)date expectedLength:(uint64_t)expectedLength reader:(OUZipStreamReader)reader error:(NSError **)outError;
+{
+    OBPRECONDITION(!_closed);
+
+    if (_closed)
+        return _zipStreamError(outError, @"Zip file already closed.");
+
+    BOOL isDirectory = [fileType isEqualToString:NSFileTypeDirectory];
+    if (isDirectory && ![name hasSuffix:@"/"])
+        name = [name stringByAppendingString:@"/"];
+
+    NSData *nameData = [name dataUsingEncoding:NSUTF8StringEncoding];
+    if ([nameData length] > UINT16_MAX)
+        return _zipStreamError(outError, [NSString stringWithFormat:@"The name \"%@\" is too long.", name]);
+    uint16_t nameLength = (uint16_t)[nameData length];
+
+    OUZipStreamEntryInfo info;
+    memset(&info, 0, sizeof(info));
+    info.versionNeeded = ZIP_VERSION_DEFAULT;
+    info.flags = ZIP_FLAG_UTF8;
+    info.externalAttributes = ((uint32_t)_fileMode(fileType)) << 16; // UNIX mode is stored in the upper word.  (The lowest byte is for DOS attributes.)
+    info.localHeaderOffset = [self _position];
+    _getDOSDateAndTime(date ?: [NSDate date], &info.dosDate, &info.dosTime);
+
+    // Directories have no contents, so they are stored with their (zero) sizes in the local header.
+    BOOL zip64 = NO;
+    if (isDirectory) {
+        info.method = ZIP_METHOD_STORED;
+    } else {
+        zip64 = (expectedLength >= OUZipStreamZip64Threshold);
+        if (zip64)
+            info.versionNeeded = ZIP_VERSION_ZIP64;
+        info.flags |= ZIP_FLAG_DATA_DESCRIPTOR;
+        info.method = Z_DEFLATED;
+    }
+
+    NSMutableData *header = [NSMutableData dataWithLength:ZIP_LOCAL_HEADER_LENGTH + nameLength + ZIP64_EXTRA_MAX_LENGTH];
+    size_t headerLength = _writeLocalHeader([header mutableBytes], &info, [nameData bytes], nameLength, zip64);
+    if (![self _writeBytes:[header bytes] length:headerLength error:outError])
+        return NO;
+
+    if (!isDirectory) {
+        if (![self _writeDeflatedContentsFromReader:reader info:&info error:outError])
+            return NO;
+
+        // Only possible if a byte provider grew after we asked for its length.
+        if (!zip64 && (info.compressedSize >= UINT32_MAX || info.uncompressedSize >= UINT32_MAX))
+            return _zipStreamError(outError, [NSString stringWithFormat:@"The contents of \"%@\" grew past 4 GB while being written.", name]);
+
+        uint8_t descriptor[ZIP_DATA_DESCRIPTOR_MAX_LENGTH];
+        size_t descriptorLength = _writeDataDescriptor(descriptor, &info, zip64);
+        if (![self _writeBytes:descriptor length:descriptorLength error:outError])
+            return NO;
+    }
+
+    NSUInteger directoryLength = [_centralDirectory length];
+    [_centralDirectory increaseLengthBy:ZIP_CENTRAL_HEADER_LENGTH + nameLength + ZIP64_EXTRA_MAX_LENGTH];
+    directoryLength += _writeCentralDirectoryHeader((uint8_t *)[_centralDirectory mutableBytes] + directoryLength, &info, [nameData bytes], nameLength);
+    [_centralDirectory setLength:directoryLength];
+    _entryCount++;
+
+    return YES;
+}
+
+#pragma mark - Deflating
+
+static NSData * _Nullable _readChunk(OUZipStreamReader reader, NSError **outError)
+{
+    NSMutableData *chunk = [NSMutableData dataWithLength:OUZipStreamChunkSize];
+    uint8_t *bytes = [chunk mutableBytes];
+
+    NSUInteger length = 0;
+    while (length < OUZipStreamChunkSize) {
+        NSInteger count = reader(bytes + length, OUZipStreamChunkSize - length, outError);
+        if (count < 0)
+            return nil;
+        if (count == 0)
+            break;
+        length += (NSUInteger)count;
+    }
+
+    [chunk setLength:length];
+    return chunk;
+}
+
+static NSData * _Nullable _deflateChunk(z_stream *deflater, NSData *input, NSData * _Nullable dictionary, BOOL last)
+{
+    if (deflateReset(deflater) != Z_OK)
+        return nil;
+
+    // Raw deflate streams allow a dictionary after a reset, which lets this chunk refer back into the previous one just as a single-threaded deflate would.
+    if (dictionary) {
+        NSUInteger dictionaryLength = MIN([dictionary length], (NSUInteger)OUZipStreamDictionarySize);
+        const Bytef *dictionaryBytes = (const Bytef *)[dictionary bytes] + [dictionary length] - dictionaryLength;
+        if (deflateSetDictionary(deflater, dictionaryBytes, (uInt)dictionaryLength) != Z_OK)
+            return nil;
+    }
+
+    NSMutableData *output = [NSMutableData dataWithLength:deflateBound(deflater, [input length]) + 16];
+    deflater->next_in = (Bytef *)[input bytes];
+    deflater->avail_in = (uInt)[input length];
+
+    // A sync flush ends on a byte boundary without marking the last block, so the next chunk's output can follow directly.
+    int flush = last ? Z_FINISH : Z_SYNC_FLUSH;
+    for (;;) {
+        deflater->next_out = (Bytef *)[output mutableBytes] + deflater->total_out;
+        deflater->avail_out = (uInt)([output length] - deflater->total_out);
+
+        int err = deflate(deflater, flush);
+        if (err == Z_STREAM_END)
+            break;
+        if (err != Z_OK && err != Z_BUF_ERROR)
+            return nil;
+        if (deflater->avail_out == 0) {
+            [output increaseLengthBy:OUZipStreamChunkSize];
+            continue;
+        }
+        if (last)
+            return nil; // Z_FINISH had room and still didn't finish
+        break;
+    }
+
+    [output setLength:deflater->total_out];
+    return output;
+}
+
+#pragma mark - Zip structures
+
+static uint8_t *_put16(uint8_t *p, uint16_t value)
+{
+    OSWriteLittleInt16(p, 0, value);
+    return p + 2;
+}
+
+static uint8_t *_put32(uint8_t *p, uint32_t value)
+{
+    OSWriteLittleInt32(p, 0, value);
+    return p + 4;
+}
+
+static uint8_t *_put64(uint8_t *p, uint64_t value)
+{
+    OSWriteLittleInt64(p, 0, value);
+    return p + 8;
+}
+
+static uint32_t _clamp32(uint64_t value)
+{
+    return value >= UINT32_MAX ? UINT32_MAX : (uint32_t)value;
+}
+
+// The sizes always follow the data in a descriptor. A zip64 member gets an extra field with room for 64-bit sizes, which is what tells readers that its descriptor has 64-bit sizes too.
+static size_t _writeLocalHeader(uint8_t *buffer, const OUZipStreamEntryInfo *info, const void *name, uint16_t nameLength, BOOL zip64)
+{
+    uint8_t *p = buffer;
+    p = _put32(p, 0x04034b50);
+    p = _put16(p, info->versionNeeded);
+    p = _put16(p, info->flags);
+    p = _put16(p, info->method);
+    p = _put16(p, info->dosTime);
+    p = _put16(p, info->dosDate);
+    p = _put32(p, 0); // crc
+    p = _put32(p, zip64 ? UINT32_MAX : 0); // compressed size
+    p = _put32(p, zip64 ? UINT32_MAX : 0); // uncompressed size
+    p = _put16(p, nameLength);
+    p = _put16(p, zip64 ? 4 + 2 * 8 : 0); // extra field length
+    memcpy(p, name, nameLength);
+    p += nameLength;
+
+    if (zip64) {
+        p = _put16(p, 0x0001);
+        p = _put16(p, 2 * 8);
+        p = _put64(p, 0); // uncompressed size
+        p = _put64(p, 0); // compressed size
+    }
+
+    return p - buffer;
+}
+
+static size_t _writeDataDescriptor(uint8_t *buffer, const OUZipStreamEntryInfo *info, BOOL zip64)
+{
+    uint8_t *p = buffer;
+    p = _put32(p, 0x08074b50);
+    p = _put32(p, info->crc);
+    if (zip64) {
+        p = _put64(p, info->compressedSize);
+        p = _put64(p, info->uncompressedSize);
+    } else {
+        p = _put32(p, (uint32_t)info->compressedSize);
+        p = _put32(p, (uint32_t)info->uncompressedSize);
+    }
+    return p - buffer;
+}
+
+// The zip64 extra field only holds the values that don't fit in the header proper, in this order.
+static size_t _writeCentralDirectoryHeader(uint8_t *buffer, const OUZipStreamEntryInfo *info, const void *name, uint16_t nameLength)
+{
+    uint64_t extraValues[3];
+    uint16_t extraCount = 0;
+    if (info->uncompressedSize >= UINT32_MAX)
+        extraValues[extraCount++] = info->uncompressedSize;
+    if (info->compressedSize >= UINT32_MAX)
+        extraValues[extraCount++] = info->compressedSize;
+    if (info->localHeaderOffset >= UINT32_MAX)
+        extraValues[extraCount++] = info->localHeaderOffset;
+
+    uint16_t versionNeeded = extraCount > 0 ? MAX(info->versionNeeded, ZIP_VERSION_ZIP64) : info->versionNeeded;
+
+    uint8_t *p = buffer;
+    p = _put32(p, 0x02014b50);
+    p = _put16(p, (3 << 8) | versionNeeded); // Made by UNIX
+    p = _put16(p, versionNeeded);
+    p = _put16(p, info->flags);
+    p = _put16(p, info->method);
+    p = _put16(p, info->dosTime);
+    p = _put16(p, info->dosDate);
+    p = _put32(p, info->crc);
+    p = _put32(p, _clamp32(info->compressedSize));
+    p = _put32(p, _clamp32(info->uncompressedSize));
+    p = _put16(p, nameLength);
+    p = _put16(p, extraCount > 0 ? 4 + 8 * extraCount : 0); // extra field length
+    p = _put16(p, 0); // comment length
+    p = _put16(p, 0); // disk number
+    p = _put16(p, 0); // internal attributes
+    p = _put32(p, info->externalAttributes);
+    p = _put32(p, _clamp32(info->localHeaderOffset));
+    memcpy(p, name, nameLength);
+    p += nameLength;
+
+    if (extraCount > 0) {
+        p = _put16(p, 0x0001);
+        p = _put16(p, 8 * extraCount);
+        for (uint16_t extraIndex = 0; extraIndex < extraCount; extraIndex++)
+            p = _put64(p, extraValues[extraIndex]);
+    }
+
+    return p - buffer;
+}
+
+// Writes the zip64 end of central directory record and its locator if anything overflows the classic record, and then the classic record, with overflowing values saturated.
+static size_t _writeEndRecords(uint8_t *buffer, uint64_t entryCount, uint64_t directoryOffset, uint64_t directoryLength)
+{
+    uint8_t *p = buffer;
+
+    if (entryCount >= UINT16_MAX || directoryOffset >= UINT32_MAX || directoryLength >= UINT32_MAX) {
+        uint64_t zip64RecordOffset = directoryOffset + directoryLength;
+
+        p = _put32(p, 0x06064b50);
+        p = _put64(p, 56 - 12); // size of the rest of the record
+        p = _put16(p, (3 << 8) | ZIP_VERSION_ZIP64);
+        p = _put16(p, ZIP_VERSION_ZIP64);
+        p = _put32(p, 0); // this disk
+        p = _put32(p, 0); // disk with the central directory
+        p = _put64(p, entryCount); // on this disk
+        p = _put64(p, entryCount);
+        p = _put64(p, directoryLength);
+        p = _put64(p, directoryOffset);
+
+        p = _put32(p, 0x07064b50);
+        p = _put32(p, 0); // disk with the zip64 record
+        p = _put64(p, zip64RecordOffset);
+        p = _put32(p, 1); // total disks
+    }
+
+    uint16_t shortEntryCount = entryCount >= UINT16_MAX ? UINT16_MAX : (uint16_t)entryCount;
+    p = _put32(p, 0x06054b50);
+    p = _put16(p, 0); // this disk
+    p = _put16(p, 0); // disk with the central directory
+    p = _put16(p, shortEntryCount); // on this disk
+    p = _put16(p, shortEntryCount);
+    p = _put32(p, _clamp32(directoryLength));
+    p = _put32(p, _clamp32(directoryOffset));
+    p = _put16(p, 0); // comment length
+
+    return p - buffer;
+}
+
+@end
+
+NS_ASSUME_NONNULL_END
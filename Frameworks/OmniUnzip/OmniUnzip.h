@@ -14,4 +14,5 @@
 #import <OmniUnzip/OUZipLinkMember.h>
 #import <OmniUnzip/OUZipMember.h>
 #import <OmniUnzip/OUZipRawFileMember.h>
+#import <OmniUnzip/OUZipStreamWriter.h>
 #import <OmniUnzip/NSFileWrapper-Extensions.h>
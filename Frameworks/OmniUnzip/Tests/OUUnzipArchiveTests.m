@@ -7,6 +7,7 @@
 
 #import <XCTest/XCTest.h>
 
+#import "OBTestCase.h"
 #import <OmniUnzip/OmniUnzip.h>
 
 #import <OmniFoundation/NSData-OFExtensions.h>
@@ -124,4 +125,134 @@ RCS_ID("$Id$");
     XCTAssert(inputStream.streamStatus == NSStreamStatusClosed);
 }
 
+static NSFileWrapper *_directoryWrapperWithEntries(NSUInteger smallEntryCount, NSUInteger largeEntryCount, NSUInteger largeEntryLength)
+{
+    NSMutableDictionary <NSString *, NSFileWrapper *> *smallWrappers = [NSMutableDictionary dictionary];
+    for (NSUInteger entryIndex = 0; entryIndex < smallEntryCount; entryIndex++) {
+        NSString *name = [NSString stringWithFormat:@"small-%lu.txt", entryIndex];
+        NSData *contents = [[NSString stringWithFormat:@"Entry %lu: %@", entryIndex, [[NSUUID UUID] UUIDString]] dataUsingEncoding:NSUTF8StringEncoding];
+        smallWrappers[name] = [[NSFileWrapper alloc] initRegularFileWithContents:contents];
+    }
+    
+    NSMutableDictionary <NSString *, NSFileWrapper *> *wrappers = [NSMutableDictionary dictionary];
+    wrappers[@"small"] = [[NSFileWrapper alloc] initDirectoryWithFileWrappers:smallWrappers];
+    for (NSUInteger entryIndex = 0; entryIndex < largeEntryCount; entryIndex++) {
+        NSString *name = [NSString stringWithFormat:@"large-%lu.dat", entryIndex];
+        wrappers[name] = [[NSFileWrapper alloc] initRegularFileWithContents:[NSData randomDataOfLength:largeEntryLength]];
+    }
+    
+    NSFileWrapper *directoryWrapper = [[NSFileWrapper alloc] initDirectoryWithFileWrappers:wrappers];
+    directoryWrapper.preferredFilename = @"TEST";
+    return directoryWrapper;
+}
+
+static NSString *_temporaryPathWithExtension(NSString *extension)
+{
+    NSString *temporaryPath = [[NSFileManager defaultManager] temporaryDirectoryForFileSystemContainingPath:@"/" error:NULL];
+    return [temporaryPath stringByAppendingPathComponent:[[[NSUUID UUID] UUIDString] stringByAppendingPathExtension:extension]];
+}
+
+- (void)testConcurrentExtraction;
+{
+    NSError *error = nil;
+    NSFileWrapper *directoryWrapper = _directoryWrapperWithEntries(200, 3, 1024 * 1024);
+    
+    NSString *zipPath = _temporaryPathWithExtension(@"zip");
+    XCTAssertTrue([OUZipArchive createZipFile:zipPath fromFileWrappers:@[directoryWrapper] error:&error]);
+    
+    for (NSUInteger concurrency = 0; concurrency < 5; concurrency += 4) {
+        OUUnzipArchive *archive = [[OUUnzipArchive alloc] initWithPath:zipPath error:&error];
+        XCTAssertNotNil(archive);
+        archive.maximumConcurrentExtractionCount = concurrency;
+        
+        NSString *unzipPath = _temporaryPathWithExtension(@"unzipped");
+        XCTAssertTrue([archive unzipArchiveToURL:[NSURL fileURLWithPath:unzipPath] error:&error]);
+        NSFileWrapper *unzippedWrapper = [[NSFileWrapper alloc] initWithURL:[NSURL fileURLWithPath:[unzipPath stringByAppendingPathComponent:@"TEST"]] options:0 error:&error];
+        XCTAssertTrue([[unzippedWrapper fileWrappers][@"small"] fileWrappers].count == 200);
+        for (NSString *name in [directoryWrapper fileWrappers]) {
+            NSFileWrapper *original = [directoryWrapper fileWrappers][name];
+            if (original.regularFile)
+                XCTAssertEqualObjects(original.regularFileContents, [unzippedWrapper fileWrappers][name].regularFileContents);
+        }
+        [[NSFileManager defaultManager] removeItemAtPath:unzipPath error:NULL];
+        
+        NSFileWrapper *extractedWrapper = [archive fileWrapperWithError:&error];
+        XCTAssertNotNil(extractedWrapper);
+        NSDictionary <NSString *, NSFileWrapper *> *smallWrappers = [[directoryWrapper fileWrappers][@"small"] fileWrappers];
+        for (NSString *name in smallWrappers)
+            XCTAssertEqualObjects(smallWrappers[name].regularFileContents, [[extractedWrapper fileWrappers][@"small"] fileWrappers][name].regularFileContents);
+    }
+    
+    [[NSFileManager defaultManager] removeItemAtPath:zipPath error:NULL];
+}
+
+- (void)testConcurrentExtractionDetectsCorruption;
+{
+    NSError *error = nil;
+    NSData *contents = [NSData randomDataOfLength:256 * 1024];
+    NSFileWrapper *fileWrapper = [[NSFileWrapper alloc] initRegularFileWithContents:contents];
+    fileWrapper.preferredFilename = @"TEST_DATA";
+    
+    NSData *zipData = [OUZipArchive zipDataFromFileWrappers:@[_directoryWrapperWithEntries(20, 0, 0), fileWrapper] error:&error];
+    XCTAssertNotNil(zipData);
+    
+    // Random data is stored rather than compressed, so we can find it in the archive and damage it without upsetting the deflate stream.
+    NSRange contentsRange = { NSNotFound, 0 };
+    for (NSUInteger probe = 100 * 1024; contentsRange.location == NSNotFound && probe < 200 * 1024; probe += 1000) // Skip past any stored-block header
+        contentsRange = [zipData rangeOfData:[contents subdataWithRange:(NSRange){probe, 64}] options:0 range:(NSRange){0, [zipData length]}];
+    XCTAssertNotEqual(contentsRange.location, (NSUInteger)NSNotFound);
+    NSMutableData *damagedZipData = [zipData mutableCopy];
+    ((uint8_t *)[damagedZipData mutableBytes])[contentsRange.location] ^= 0x10;
+    
+    OUUnzipArchive *archive = [[OUUnzipArchive alloc] initWithPath:nil data:damagedZipData description:@"damaged" error:&error];
+    XCTAssertNotNil(archive);
+    archive.maximumConcurrentExtractionCount = 4;
+    
+    error = nil;
+    XCTAssertNil([archive fileWrapperWithTopLevelWrapper:YES error:&error]);
+    XCTAssertEqualObjects(error.domain, OmniUnzipErrorDomain);
+}
+
+static void _measureExtraction(OUUnzipArchiveTests *self, NSUInteger smallEntryCount, NSUInteger largeEntryCount, NSUInteger largeEntryLength)
+{
+    NSError *error = nil;
+    NSString *zipPath = _temporaryPathWithExtension(@"zip");
+    XCTAssertTrue([OUZipArchive createZipFile:zipPath fromFileWrappers:@[_directoryWrapperWithEntries(smallEntryCount, largeEntryCount, largeEntryLength)] error:&error]);
+    
+    for (NSUInteger concurrency = 1; concurrency <= 8; concurrency *= 2) {
+        OUUnzipArchive *archive = [[OUUnzipArchive alloc] initWithPath:zipPath error:&error];
+        archive.maximumConcurrentExtractionCount = concurrency;
+        
+        NSString *unzipPath = _temporaryPathWithExtension(@"unzipped");
+        NSTimeInterval start = [NSDate timeIntervalSinceReferenceDate];
+        XCTAssertTrue([archive unzipArchiveToURL:[NSURL fileURLWithPath:unzipPath] error:&error]);
+        NSTimeInterval elapsed = [NSDate timeIntervalSinceReferenceDate] - start;
+        NSLog(@"%lu small and %lu large entries, %lu threads: %.3fs", smallEntryCount, largeEntryCount, concurrency, elapsed);
+        
+        [[NSFileManager defaultManager] removeItemAtPath:unzipPath error:NULL];
+    }
+    
+    [[NSFileManager defaultManager] removeItemAtPath:zipPath error:NULL];
+}
+
+- (void)testConcurrentExtractionOfManySmallEntriesPerformance;
+{
+    if (![OBTestCase shouldRunSlowUnitTests]) {
+        NSLog(@"*** SKIPPING slow test [%@ %@]", [self class], NSStringFromSelector(_cmd));
+        return;
+    }
+    
+    _measureExtraction(self, 5000, 0, 0);
+}
+
+- (void)testConcurrentExtractionOfFewLargeEntriesPerformance;
+{
+    if (![OBTestCase shouldRunSlowUnitTests]) {
+        NSLog(@"*** SKIPPING slow test [%@ %@]", [self class], NSStringFromSelector(_cmd));
+        return;
+    }
+    
+    _measureExtraction(self, 2000, 4, 64 * 1024 * 1024);
+}
+
 @end
@@ -0,0 +1,237 @@
+// Copyright 2026 Omni Development, Inc. All rights reserved.
+//
+// This software may only be used and reproduced according to the
+// terms in the file OmniSourceLicense.html, which should be
+// distributed with this project and can also be found at
+// <http://www.omnigroup.com/developer/sourcecode/sourcelicense/>.
+
+#import <XCTest/XCTest.h>
+
+#import "OBTestCase.h"
+#import <OmniUnzip/OmniUnzip.h>
+
+#import <OmniFoundation/NSData-OFCompression.h>
+#import <OmniFoundation/NSData-OFExtensions.h>
+#import <OmniFoundation/NSFileManager-OFTemporaryPath.h>
+#import <OmniFoundation/OFByteProviderProtocol.h>
+
+RCS_ID("$Id$");
+
+// A byte provider of any length that doesn't need the memory to hold it.
+@interface OUZipStreamWriterZeroes : NSObject <OFByteProvider>
+- initWithLength:(NSUInteger)length;
+@end
+
+@implementation OUZipStreamWriterZeroes
+
+@synthesize length = _length;
+
+- initWithLength:(NSUInteger)length;
+{
+    if (!(self = [super init]))
+        return nil;
+    _length = length;
+    return self;
+}
+
+- (void)getBytes:(void *)buffer range:(NSRange)range;
+{
+    memset(buffer, 0, range.length);
+}
+
+@end
+
+@interface OUZipStreamWriterTests : XCTestCase
+@end
+
+@implementation OUZipStreamWriterTests
+
+static NSString *_temporaryPathWithExtension(NSString *extension)
+{
+    NSString *temporaryPath = [[NSFileManager defaultManager] temporaryDirectoryForFileSystemContainingPath:@"/" error:NULL];
+    return [temporaryPath stringByAppendingPathComponent:[[[NSUUID UUID] UUIDString] stringByAppendingPathExtension:extension]];
+}
+
+// Text with plenty of matches that reach back across chunk boundaries.
+static NSData *_compressibleDataOfLength(NSUInteger length)
+{
+    NSMutableData *data = [NSMutableData dataWithCapacity:length];
+    for (NSUInteger lineIndex = 0; [data length] < length; lineIndex++)
+        [data appendData:[[NSString stringWithFormat:@"line %lu of the quick brown fox %lu\n", lineIndex % 500, lineIndex] dataUsingEncoding:NSUTF8StringEncoding]];
+    [data setLength:length];
+    return data;
+}
+
+static NSDictionary <NSString *, NSData *> *_testContents(void)
+{
+    return @{
+        @"empty" : [NSData data],
+        @"small" : [@"hello" dataUsingEncoding:NSUTF8StringEncoding],
+        @"one-chunk" : [NSData randomDataOfLength:128 * 1024],
+        @"random" : [NSData randomDataOfLength:3 * 1024 * 1024 + 17],
+        @"text" : _compressibleDataOfLength(5 * 1024 * 1024),
+    };
+}
+
+static NSData *_writeArchive(NSDictionary <NSString *, NSData *> *contents, NSUInteger maximumConcurrency, BOOL useStreams, NSDate *date)
+{
+    NSError *error = nil;
+    NSMutableData *zipData = [NSMutableData data];
+    OUZipStreamWriter *writer = [[OUZipStreamWriter alloc] initWithByteAcceptor:zipData error:&error];
+    writer.maximumConcurrency = maximumConcurrency;
+
+    if (![writer appendEntryNamed:@"folder" fileType:NSFileTypeDirectory contents:[NSData data] date:date error:&error])
+        return nil;
+    for (NSString *name in [[contents allKeys] sortedArrayUsingSelector:@selector(compare:)]) {
+        NSString *entryName = [@"folder/" stringByAppendingString:name];
+        BOOL ok;
+        if (useStreams)
+            ok = [writer appendEntryNamed:entryName fileType:NSFileTypeRegular contentsOfInputStream:[NSInputStream inputStreamWithData:contents[name]] date:date error:&error];
+        else
+            ok = [writer appendEntryNamed:entryName fileType:NSFileTypeRegular contents:contents[name] date:date error:&error];
+        if (!ok)
+            return nil;
+    }
+    if (![writer appendEntryNamed:@"link" fileType:NSFileTypeSymbolicLink contents:[@"folder/small" dataUsingEncoding:NSUTF8StringEncoding] date:date error:&error])
+        return nil;
+
+    if (![writer close:&error])
+        return nil;
+    return zipData;
+}
+
+static void _checkArchive(OUZipStreamWriterTests *self, NSData *zipData, NSDictionary <NSString *, NSData *> *contents)
+{
+    NSError *error = nil;
+    OUUnzipArchive *archive = [[OUUnzipArchive alloc] initWithPath:nil data:zipData description:@"stream" error:&error];
+    XCTAssertNotNil(archive);
+    XCTAssertEqual([[archive entries] count], [contents count] + 2);
+
+    XCTAssertEqualObjects([[archive entryNamed:@"folder/"] fileType], NSFileTypeDirectory);
+    OUUnzipEntry *linkEntry = [archive entryNamed:@"link"];
+    XCTAssertEqualObjects([linkEntry fileType], NSFileTypeSymbolicLink);
+    XCTAssertEqualObjects([archive dataForEntry:linkEntry error:&error], [@"folder/small" dataUsingEncoding:NSUTF8StringEncoding]);
+
+    for (NSString *name in contents) {
+        OUUnzipEntry *entry = [archive entryNamed:[@"folder/" stringByAppendingString:name]];
+        XCTAssertNotNil(entry);
+        XCTAssertEqualObjects([entry fileType], NSFileTypeRegular);
+        XCTAssertEqual([entry uncompressedSize], [contents[name] length]);
+        XCTAssertEqualObjects([archive dataForEntry:entry error:&error], contents[name], @"%@", name); // Also checks the CRC
+    }
+}
+
+- (void)testRoundTrip;
+{
+    NSDictionary <NSString *, NSData *> *contents = _testContents();
+    NSData *zipData = _writeArchive(contents, 4, NO, nil);
+    XCTAssertNotNil(zipData);
+    _checkArchive(self, zipData, contents);
+
+    // Priming each chunk with the one before keeps the compression close to single-threaded deflate.
+    OUUnzipArchive *archive = [[OUUnzipArchive alloc] initWithPath:nil data:zipData description:@"stream" error:NULL];
+    OUUnzipEntry *textEntry = [archive entryNamed:@"folder/text"];
+    XCTAssertLessThan([textEntry compressedSize], [[contents[@"text"] compressedDataWithGzipHeader:NO compressionLevel:6 error:NULL] length] * 11 / 10);
+}
+
+- (void)testInputStreams;
+{
+    NSDictionary <NSString *, NSData *> *contents = _testContents();
+    NSData *zipData = _writeArchive(contents, 0, YES, nil);
+    XCTAssertNotNil(zipData);
+    _checkArchive(self, zipData, contents);
+}
+
+- (void)testOutputDoesNotDependOnConcurrency;
+{
+    NSDictionary <NSString *, NSData *> *contents = _testContents();
+    NSDate *date = [NSDate dateWithTimeIntervalSinceReferenceDate:0];
+
+    NSData *serialZipData = _writeArchive(contents, 1, NO, date);
+    XCTAssertNotNil(serialZipData);
+    XCTAssertEqualObjects(_writeArchive(contents, 3, NO, date), serialZipData);
+    XCTAssertEqualObjects(_writeArchive(contents, 8, NO, date), serialZipData);
+}
+
+- (void)testWritingToPath;
+{
+    NSError *error = nil;
+    NSString *zipPath = _temporaryPathWithExtension(@"zip");
+    NSData *contents = _compressibleDataOfLength(3 * 1024 * 1024);
+
+    OUZipStreamWriter *writer = [[OUZipStreamWriter alloc] initWithPath:zipPath error:&error];
+    XCTAssertNotNil(writer);
+    XCTAssertTrue([writer appendEntryNamed:@"text" fileType:NSFileTypeRegular contents:contents date:nil error:&error]);
+    XCTAssertTrue([writer close:&error]);
+
+    OUUnzipArchive *archive = [[OUUnzipArchive alloc] initWithPath:zipPath error:&error];
+    XCTAssertEqualObjects([archive dataForEntry:[archive entryNamed:@"text"] error:&error], contents);
+
+    [[NSFileManager defaultManager] removeItemAtPath:zipPath error:NULL];
+}
+
+- (void)testStreamReadErrorsAreReported;
+{
+    NSError *error = nil;
+    NSMutableData *zipData = [NSMutableData data];
+    OUZipStreamWriter *writer = [[OUZipStreamWriter alloc] initWithByteAcceptor:zipData error:&error];
+
+    NSInputStream *missingFileStream = [NSInputStream inputStreamWithFileAtPath:_temporaryPathWithExtension(@"missing")];
+    XCTAssertFalse([writer appendEntryNamed:@"missing" fileType:NSFileTypeRegular contentsOfInputStream:missingFileStream date:nil error:&error]);
+    XCTAssertNotNil(error);
+
+    XCTAssertTrue([writer close:&error]);
+}
+
+- (void)testZip64;
+{
+    if (![OBTestCase shouldRunSlowUnitTests]) {
+        NSLog(@"*** SKIPPING slow test [%@ %@]", [self class], NSStringFromSelector(_cmd));
+        return;
+    }
+
+    NSError *error = nil;
+    NSString *zipPath = _temporaryPathWithExtension(@"zip");
+
+    // Store the zeroes uncompressed so that the archive itself passes 4 GB, and the entry after them needs a 64-bit offset.
+    OUZipStreamWriter *writer = [[OUZipStreamWriter alloc] initWithPath:zipPath error:&error];
+    writer.compressionLevel = 0;
+    XCTAssertTrue([writer appendEntryNamed:@"small" fileType:NSFileTypeRegular contents:[@"hello" dataUsingEncoding:NSUTF8StringEncoding] date:nil error:&error]);
+    XCTAssertTrue([writer appendEntryNamed:@"zeroes" fileType:NSFileTypeRegular contentsOfByteProvider:[[OUZipStreamWriterZeroes alloc] initWithLength:4500000000ULL] date:nil error:&error]);
+    XCTAssertTrue([writer appendEntryNamed:@"after" fileType:NSFileTypeRegular contents:_compressibleDataOfLength(1024 * 1024) date:nil error:&error]);
+    XCTAssertTrue([writer close:&error]);
+
+    // The bundled unzip code predates zip64, so check the archive with Info-ZIP.
+    NSTask *unzipTask = [NSTask launchedTaskWithLaunchPath:@"/usr/bin/unzip" arguments:@[@"-tq", zipPath]];
+    [unzipTask waitUntilExit];
+    XCTAssertEqual([unzipTask terminationStatus], 0);
+
+    [[NSFileManager defaultManager] removeItemAtPath:zipPath error:NULL];
+}
+
+- (void)testCompressionPerformance;
+{
+    if (![OBTestCase shouldRunSlowUnitTests]) {
+        NSLog(@"*** SKIPPING slow test [%@ %@]", [self class], NSStringFromSelector(_cmd));
+        return;
+    }
+
+    NSData *contents = _compressibleDataOfLength(256 * 1024 * 1024);
+
+    for (NSUInteger concurrency = 1; concurrency <= 8; concurrency *= 2) {
+        NSError *error = nil;
+        NSString *zipPath = _temporaryPathWithExtension(@"zip");
+        OUZipStreamWriter *writer = [[OUZipStreamWriter alloc] initWithPath:zipPath error:&error];
+        writer.maximumConcurrency = concurrency;
+
+        NSTimeInterval start = [NSDate timeIntervalSinceReferenceDate];
+        XCTAssertTrue([writer appendEntryNamed:@"text" fileType:NSFileTypeRegular contents:contents date:nil error:&error]);
+        XCTAssertTrue([writer close:&error]);
+        NSTimeInterval elapsed = [NSDate timeIntervalSinceReferenceDate] - start;
+        NSLog(@"%lu threads: %.1f MB/s", concurrency, [contents length] / elapsed / (1024 * 1024));
+
+        [[NSFileManager defaultManager] removeItemAtPath:zipPath error:NULL];
+    }
+}
+
+@end